@@ -71,6 +71,7 @@ namespace barefoot {
   };
   auto bf_chassis_manager =
       BfChassisManager::CreateInstance(mode, phal, bf_sde_wrapper);
+  bf_chassis_manager->SetDeviceToBfrtNodeMap({{device_id, bfrt_node.get()}});
   auto bfrt_switch = BfrtSwitch::CreateInstance(
       phal, bf_chassis_manager.get(), bf_sde_wrapper, device_id_to_bfrt_node);
 
@@ -7,12 +7,15 @@
 #include <memory>
 #include <set>
 #include <utility>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "absl/types/optional.h"
+#include "gflags/gflags.h"
 #include "stratum/glue/integral_types.h"
 #include "stratum/hal/lib/barefoot/bfrt_constants.h"
 #include "stratum/hal/lib/common/constants.h"
@@ -25,6 +28,11 @@
 #include "stratum/lib/macros.h"
 #include "stratum/lib/utils.h"
 
+DEFINE_int32(bf_queue_counters_max_age_ms, 100,
+             "Reads of TM queue counters reuse the last snapshot of all queues "
+             "of a node if it was taken within this many milliseconds, "
+             "instead of reading the queues from the SDE again.");
+
 namespace stratum {
 namespace hal {
 namespace barefoot {
@@ -39,6 +47,73 @@ constexpr int BfChassisManager::kMaxPortStatusEventDepth;
 /* static */
 constexpr int BfChassisManager::kMaxXcvrEventDepth;
 
+namespace {
+
+// A row of the media policy table. The first row that matches the inserted
+// transceiver and the port speed gives the autoneg and FEC defaults of the
+// port.
+struct MediaPolicy {
+  // Connector of the port, i.e. the cage the transceiver is inserted in.
+  PhysicalPortType connector;
+  MediaType media_type;
+  // Cable length in meters up to which the row applies, 0 matches any length.
+  // Only rows matching any length apply to an unknown cable length.
+  int32 max_cable_length;
+  // Port speed to which the row applies, 0 matches any speed.
+  uint64 speed_bps;
+  TriState autoneg;
+  FecMode fec_mode;
+};
+
+constexpr PhysicalPortType kQsfp = PHYSICAL_PORT_TYPE_QSFP_CAGE;
+
+constexpr MediaPolicy kMediaPolicies[] = {
+    // Short 100G DACs run without FEC, longer ones need RS-FEC.
+    {kQsfp, MEDIA_TYPE_QSFP_COPPER, 3, kHundredGigBps, TRI_STATE_TRUE,
+     FEC_MODE_OFF},
+    {kQsfp, MEDIA_TYPE_QSFP_COPPER, 0, kHundredGigBps, TRI_STATE_TRUE,
+     FEC_MODE_ON},
+    {kQsfp, MEDIA_TYPE_QSFP_CCR4, 3, kHundredGigBps, TRI_STATE_TRUE,
+     FEC_MODE_OFF},
+    {kQsfp, MEDIA_TYPE_QSFP_CCR4, 0, kHundredGigBps, TRI_STATE_TRUE,
+     FEC_MODE_ON},
+    {kQsfp, MEDIA_TYPE_QSFP_COPPER, 0, 0, TRI_STATE_TRUE, FEC_MODE_OFF},
+    // Optics do not autonegotiate. 100G SR4 and PSM4 optics need RS-FEC.
+    {kQsfp, MEDIA_TYPE_QSFP_SR4, 0, kHundredGigBps, TRI_STATE_FALSE,
+     FEC_MODE_ON},
+    {kQsfp, MEDIA_TYPE_QSFP_CSR4, 0, kHundredGigBps, TRI_STATE_FALSE,
+     FEC_MODE_ON},
+    {kQsfp, MEDIA_TYPE_QSFP_PSM4, 0, kHundredGigBps, TRI_STATE_FALSE,
+     FEC_MODE_ON},
+    {kQsfp, MEDIA_TYPE_QSFP_SR4, 0, 0, TRI_STATE_FALSE, FEC_MODE_OFF},
+    {kQsfp, MEDIA_TYPE_QSFP_CSR4, 0, 0, TRI_STATE_FALSE, FEC_MODE_OFF},
+    {kQsfp, MEDIA_TYPE_QSFP_PSM4, 0, 0, TRI_STATE_FALSE, FEC_MODE_OFF},
+    {kQsfp, MEDIA_TYPE_QSFP_LR4, 0, 0, TRI_STATE_FALSE, FEC_MODE_OFF},
+    {kQsfp, MEDIA_TYPE_QSFP_CLR4, 0, 0, TRI_STATE_FALSE, FEC_MODE_OFF},
+};
+
+// Returns the first row of the media policy table that matches the given
+// transceiver and port speed, or nullptr if there is none.
+const MediaPolicy* FindMediaPolicy(const FrontPanelPortInfo& fp_port_info,
+                                   uint64 speed_bps) {
+  for (const auto& policy : kMediaPolicies) {
+    if (policy.connector != fp_port_info.physical_port_type() ||
+        policy.media_type != fp_port_info.media_type()) {
+      continue;
+    }
+    if (policy.max_cable_length != 0 &&
+        (fp_port_info.cable_length() <= 0 ||
+         fp_port_info.cable_length() > policy.max_cable_length)) {
+      continue;
+    }
+    if (policy.speed_bps != 0 && policy.speed_bps != speed_bps) continue;
+    return &policy;
+  }
+  return nullptr;
+}
+
+}  // namespace
+
 BfChassisManager::BfChassisManager(OperationMode mode,
                                    PhalInterface* phal_interface,
                                    BfSdeInterface* bf_sde_interface)
@@ -59,6 +134,8 @@ BfChassisManager::BfChassisManager(OperationMode mode,
       node_id_to_deflect_on_drop_config_(),
       node_id_to_qos_config_(),
       xcvr_port_key_to_xcvr_state_(),
+      node_id_to_queue_counters_(),
+      device_to_bfrt_node_(),
       phal_interface_(ABSL_DIE_IF_NULL(phal_interface)),
       bf_sde_interface_(ABSL_DIE_IF_NULL(bf_sde_interface)) {}
 
@@ -80,6 +157,8 @@ BfChassisManager::BfChassisManager()
       node_id_to_deflect_on_drop_config_(),
       node_id_to_qos_config_(),
       xcvr_port_key_to_xcvr_state_(),
+      node_id_to_queue_counters_(),
+      device_to_bfrt_node_(),
       phal_interface_(nullptr),
       bf_sde_interface_(nullptr) {}
 
@@ -90,6 +169,8 @@ BfChassisManager::~BfChassisManager() = default;
     const SingletonPort& singleton_port /* desired config */,
     /* out */ PortConfig* config /* new config */) {
   config->admin_state = ADMIN_STATE_UNKNOWN;
+  config->media_autoneg.reset();
+  config->media_fec_mode.reset();
   // SingletonPort ID is the SDN/Stratum port ID
   uint32 port_id = singleton_port.id();
 
@@ -241,6 +322,14 @@ BfChassisManager::~BfChassisManager() = default;
             << " for port " << port_id << " in node " << node_id
             << " (SDK Port " << sdk_port_id << ").";
   }
+  // A media default no longer applies once the config sets the value, and
+  // must not be replayed over it.
+  if (config_params.autoneg() != TRI_STATE_UNKNOWN) {
+    config->media_autoneg.reset();
+  }
+  if (config_params.fec_mode() != FEC_MODE_UNKNOWN) {
+    config->media_fec_mode.reset();
+  }
   if (config_params.loopback_mode() != config_old.loopback_mode) {
     RETURN_IF_ERROR(bf_sde_interface_->SetPortLoopbackMode(
         device, sdk_port_id, config_params.loopback_mode()));
@@ -587,6 +676,10 @@ BfChassisManager::~BfChassisManager() = default;
   node_id_to_deflect_on_drop_config_ = node_id_to_deflect_on_drop_config;
   node_id_to_qos_config_ = node_id_to_qos_config;
   xcvr_port_key_to_xcvr_state_ = xcvr_port_key_to_xcvr_state;
+  {
+    absl::MutexLock l(&queue_counters_lock_);
+    node_id_to_queue_counters_.clear();
+  }
   initialized_ = true;
 
   return ::util::OkStatus();
@@ -627,8 +720,6 @@ BfChassisManager::~BfChassisManager() = default;
 
 ::util::Status BfChassisManager::VerifyChassisConfig(
     const ChassisConfig& config) {
-  RET_CHECK(config.trunk_ports_size() == 0)
-      << "Trunk ports are not supported on Tofino.";
   RET_CHECK(config.port_groups_size() == 0)
       << "Port groups are not supported on Tofino.";
   RET_CHECK(config.nodes_size() > 0)
@@ -738,6 +829,40 @@ BfChassisManager::~BfChassisManager() = default;
     node_id_to_sdk_port_id_to_port_id[node_id][sdk_port] = port_id;
   }
 
+  // Go over all the trunk ports in the config. Trunk ports are only used as
+  // multicast LAGs in the PRE, their membership is given by the config:
+  // 1- Make sure IDs of the trunk ports are unique per node, across singleton
+  //    and trunk ports.
+  // 2- Make sure no trunk port ID is an SDK port ID of the node, as both are
+  //    used as the egress port of multicast replicas.
+  // 3- Make sure all members are singleton ports of the same node.
+  for (const auto& trunk_port : config.trunk_ports()) {
+    RET_CHECK(trunk_port.id() > 0)
+        << "No positive ID in " << PrintTrunkPort(trunk_port) << ".";
+    RET_CHECK(trunk_port.type() != TrunkPort::UNKNOWN_TRUNK)
+        << "No valid type in " << PrintTrunkPort(trunk_port) << ".";
+    const uint64 node_id = trunk_port.node();
+    RET_CHECK(node_id_to_device.count(node_id))
+        << "Node ID " << node_id << " given for TrunkPort "
+        << PrintTrunkPort(trunk_port)
+        << " has not been given to any Node in the config.";
+    RET_CHECK(!node_id_to_port_ids[node_id].count(trunk_port.id()))
+        << "The id for TrunkPort " << PrintTrunkPort(trunk_port)
+        << " was already recorded for another port for node with ID "
+        << node_id << ".";
+    RET_CHECK(
+        !node_id_to_sdk_port_id_to_port_id[node_id].count(trunk_port.id()))
+        << "The id for TrunkPort " << PrintTrunkPort(trunk_port)
+        << " is also an SDK port ID on node with ID " << node_id << ".";
+    node_id_to_port_ids[node_id].insert(trunk_port.id());
+    for (const uint32 member : trunk_port.members()) {
+      RET_CHECK(node_id_to_port_id_to_sdk_port_id[node_id].count(member))
+          << "Member " << member << " of TrunkPort "
+          << PrintTrunkPort(trunk_port) << " is not a SingletonPort on node "
+          << "with ID " << node_id << ".";
+    }
+  }
+
   // Verify the QoS configuration.
   if (config.has_vendor_config() &&
       config.vendor_config().has_tofino_config()) {
@@ -807,6 +932,155 @@ BfChassisManager::~BfChassisManager() = default;
   return ::util::OkStatus();
 }
 
+::util::Status BfChassisManager::PlanChassisConfig(
+    const ChassisConfig& config, ChassisConfigPlan* plan) {
+  ::util::Status status = VerifyChassisConfig(config);
+  if (status.error_code() == ERR_REBOOT_REQUIRED) {
+    plan->set_reboot_required(true);
+    plan->set_disruptive(true);
+  } else {
+    RETURN_IF_ERROR(status);
+  }
+
+  std::set<uint64> node_ids;
+  for (const auto& node : config.nodes()) {
+    node_ids.insert(node.id());
+    if (!node_id_to_device_.count(node.id())) {
+      AddChassisConfigPlanOperation(ChassisConfigPlan::Operation::ADD,
+                                    node.id(), 0, false, plan);
+    }
+  }
+  for (const auto& e : node_id_to_device_) {
+    if (!node_ids.count(e.first)) {
+      AddChassisConfigPlanOperation(ChassisConfigPlan::Operation::REMOVE,
+                                    e.first, 0, true, plan);
+    }
+  }
+
+  // The diff below follows the one in PushChassisConfig() and
+  // UpdatePortHelper(): a speed change deletes and re-adds the port, and an
+  // MTU, autoneg or loopback change flaps an enabled port.
+  std::map<uint64, std::set<uint32>> node_id_to_port_ids;
+  for (const auto& singleton_port : config.singleton_ports()) {
+    const uint64 node_id = singleton_port.node();
+    const uint32 port_id = singleton_port.id();
+    const auto& config_params = singleton_port.config_params();
+    node_id_to_port_ids[node_id].insert(port_id);
+
+    const TofinoConfig::BfPortShapingConfig::BfPerPortShapingConfig*
+        shaping_config = nullptr;
+    if (const auto* port_shaping_config = gtl::FindOrNull(
+            config.vendor_config()
+                .tofino_config()
+                .node_id_to_port_shaping_config(),
+            node_id)) {
+      shaping_config = gtl::FindOrNull(
+          port_shaping_config->per_port_shaping_configs(), port_id);
+    }
+
+    const PortConfig* config_old = nullptr;
+    if (const auto* port_id_to_port_config =
+            gtl::FindOrNull(node_id_to_port_id_to_port_config_, node_id)) {
+      config_old = gtl::FindOrNull(*port_id_to_port_config, port_id);
+    }
+    if (config_old == nullptr) {
+      auto* operation = AddChassisConfigPlanOperation(
+          ChassisConfigPlan::Operation::ADD, node_id, port_id, false, plan);
+      AddChassisConfigPlanChange(
+          "speed_bps", "", absl::StrCat(singleton_port.speed_bps()), false,
+          operation, plan);
+      AddChassisConfigPlanChange("admin_state", "",
+                                 AdminState_Name(config_params.admin_state()),
+                                 false, operation, plan);
+      continue;
+    }
+    if (config_old->admin_state == ADMIN_STATE_UNKNOWN) {
+      // The port is deleted and added again.
+      auto* operation = AddChassisConfigPlanOperation(
+          ChassisConfigPlan::Operation::MODIFY, node_id, port_id, true, plan);
+      AddChassisConfigPlanChange(
+          "admin_state", AdminState_Name(ADMIN_STATE_UNKNOWN),
+          AdminState_Name(config_params.admin_state()), true, operation, plan);
+      continue;
+    }
+
+    ChassisConfigPlan::Operation* operation = nullptr;
+    auto add_change = [&](const std::string& field,
+                          const std::string& old_value,
+                          const std::string& new_value, bool disruptive) {
+      if (operation == nullptr) {
+        operation = AddChassisConfigPlanOperation(
+            ChassisConfigPlan::Operation::MODIFY, node_id, port_id, false,
+            plan);
+      }
+      AddChassisConfigPlanChange(field, old_value, new_value, disruptive,
+                                 operation, plan);
+    };
+    const bool readd = singleton_port.speed_bps() != config_old->speed_bps;
+    if (readd) {
+      add_change("speed_bps", absl::StrCat(*config_old->speed_bps),
+                 absl::StrCat(singleton_port.speed_bps()), true);
+    }
+    if (config_params.fec_mode() != config_old->fec_mode) {
+      if (!readd) {
+        return MAKE_ERROR(ERR_UNIMPLEMENTED)
+               << "The FEC mode for port " << port_id << " in node "
+               << node_id << " has changed; you need to delete the port and "
+               << "add it again.";
+      }
+      add_change("fec_mode",
+                 config_old->fec_mode ? FecMode_Name(*config_old->fec_mode)
+                                      : "",
+                 FecMode_Name(config_params.fec_mode()), true);
+    }
+    if (config_params.admin_state() != config_old->admin_state) {
+      add_change("admin_state", AdminState_Name(config_old->admin_state),
+                 AdminState_Name(config_params.admin_state()),
+                 readd || config_params.admin_state() != ADMIN_STATE_ENABLED);
+    }
+    const bool flap =
+        readd || config_old->admin_state == ADMIN_STATE_ENABLED;
+    if (config_params.mtu() != config_old->mtu) {
+      add_change("mtu",
+                 config_old->mtu ? absl::StrCat(*config_old->mtu) : "",
+                 absl::StrCat(config_params.mtu()), flap);
+    }
+    if (config_params.autoneg() != config_old->autoneg) {
+      add_change("autoneg",
+                 config_old->autoneg ? TriState_Name(*config_old->autoneg) : "",
+                 TriState_Name(config_params.autoneg()), flap);
+    }
+    if (config_params.loopback_mode() != config_old->loopback_mode) {
+      add_change("loopback_mode",
+                 config_old->loopback_mode
+                     ? LoopbackState_Name(*config_old->loopback_mode)
+                     : "",
+                 LoopbackState_Name(config_params.loopback_mode()), flap);
+    }
+    if (config_old->shaping_config.has_value() != (shaping_config != nullptr) ||
+        (shaping_config != nullptr &&
+         !ProtoEqual(*config_old->shaping_config, *shaping_config))) {
+      add_change("shaping_config",
+                 config_old->shaping_config
+                     ? config_old->shaping_config->ShortDebugString()
+                     : "",
+                 shaping_config ? shaping_config->ShortDebugString() : "",
+                 false);
+    }
+  }
+
+  for (const auto& node_ports_old : node_id_to_port_id_to_port_config_) {
+    const uint64 node_id = node_ports_old.first;
+    for (const auto& port_old : node_ports_old.second) {
+      if (node_id_to_port_ids[node_id].count(port_old.first)) continue;
+      AddChassisConfigPlanOperation(ChassisConfigPlan::Operation::REMOVE,
+                                    node_id, port_old.first, true, plan);
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
 ::util::Status BfChassisManager::RegisterEventNotifyWriter(
     const std::shared_ptr<WriterInterface<GnmiEventPtr>>& writer) {
   absl::WriterMutexLock l(&gnmi_event_lock_);
@@ -923,6 +1197,14 @@ BfChassisManager::GetPortConfig(uint64 node_id, uint32 port_id) const {
                                       resp.mutable_port_counters()));
       break;
     }
+    case Request::kPortQosCounters: {
+      RETURN_IF_ERROR(GetPortQosCounters(
+          request.port_qos_counters().node_id(),
+          request.port_qos_counters().port_id(),
+          request.port_qos_counters().queue_id(),
+          resp.mutable_port_qos_counters()));
+      break;
+    }
     case Request::kAutonegStatus: {
       ASSIGN_OR_RETURN(auto* config,
                        GetPortConfig(request.autoneg_status().node_id(),
@@ -1032,6 +1314,60 @@ BfChassisManager::GetPortConfig(uint64 node_id, uint32 port_id) const {
   return bf_sde_interface_->GetPortCounters(device, sdk_port_id, counters);
 }
 
+::util::Status BfChassisManager::GetPortQosCounters(uint64 node_id,
+                                                    uint32 port_id,
+                                                    uint32 queue_id,
+                                                    PortQosCounters* counters) {
+  if (!initialized_) {
+    return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
+  }
+  ASSIGN_OR_RETURN(auto device, GetDeviceFromNodeId(node_id));
+  RETURN_IF_ERROR(GetSdkPortId(node_id, port_id).status());
+
+  absl::MutexLock l(&queue_counters_lock_);
+  QueueCountersSnapshot& snapshot = node_id_to_queue_counters_[node_id];
+  const absl::Time now = absl::Now();
+  if (now - snapshot.timestamp >
+      absl::Milliseconds(FLAGS_bf_queue_counters_max_age_ms)) {
+    // Read the queues of all ports of the node in one call, so that the
+    // remaining leafs of a gNMI sample are served from the same snapshot.
+    const auto& sdk_port_id_to_port_id =
+        gtl::FindOrDie(node_id_to_sdk_port_id_to_port_id_, node_id);
+    std::vector<int> sdk_ports;
+    sdk_ports.reserve(sdk_port_id_to_port_id.size());
+    for (const auto& e : sdk_port_id_to_port_id) {
+      sdk_ports.push_back(e.first);
+    }
+    std::map<int, std::vector<PortQosCounters>> sdk_port_to_counters;
+    RETURN_IF_ERROR(bf_sde_interface_->GetQueueCounters(
+        device, sdk_ports, &sdk_port_to_counters));
+    snapshot.port_id_to_queue_id_to_counters.clear();
+    for (const auto& e : sdk_port_to_counters) {
+      const uint32* sdn_port_id =
+          gtl::FindOrNull(sdk_port_id_to_port_id, e.first);
+      if (sdn_port_id == nullptr) continue;
+      auto& queue_id_to_counters =
+          snapshot.port_id_to_queue_id_to_counters[*sdn_port_id];
+      for (const auto& queue_counters : e.second) {
+        queue_id_to_counters[queue_counters.queue_id()] = queue_counters;
+      }
+    }
+    snapshot.timestamp = now;
+  }
+
+  const auto* queue_id_to_counters =
+      gtl::FindOrNull(snapshot.port_id_to_queue_id_to_counters, port_id);
+  const PortQosCounters* queue_counters =
+      queue_id_to_counters ? gtl::FindOrNull(*queue_id_to_counters, queue_id)
+                           : nullptr;
+  RET_CHECK(queue_counters != nullptr)
+      << "Queue " << queue_id << " is not known on port " << port_id
+      << " of node " << node_id << ".";
+  *counters = *queue_counters;
+
+  return ::util::OkStatus();
+}
+
 ::util::StatusOr<std::map<uint64, int>> BfChassisManager::GetNodeIdToDeviceMap()
     const {
   if (!initialized_) {
@@ -1075,12 +1411,20 @@ BfChassisManager::GetPortConfig(uint64 node_id, uint32 port_id) const {
                 "should contain a value";
     }
 
+    // The media defaults are only replayed for the settings the config still
+    // leaves unset.
     ASSIGN_OR_RETURN(auto sdk_port_id, GetSdkPortId(node_id, port_id));
+    const bool replay_media_fec_mode =
+        config.media_fec_mode && *config.fec_mode == FEC_MODE_UNKNOWN;
     RETURN_IF_ERROR(bf_sde_interface_->AddPort(
-        device, sdk_port_id, *config.speed_bps, *config.fec_mode));
+        device, sdk_port_id, *config.speed_bps,
+        replay_media_fec_mode ? *config.media_fec_mode : *config.fec_mode));
     config_new->speed_bps = *config.speed_bps;
     config_new->admin_state = ADMIN_STATE_DISABLED;
     config_new->fec_mode = *config.fec_mode;
+    if (replay_media_fec_mode) {
+      config_new->media_fec_mode = *config.media_fec_mode;
+    }
 
     if (config.mtu) {
       RETURN_IF_ERROR(
@@ -1097,6 +1441,12 @@ BfChassisManager::GetPortConfig(uint64 node_id, uint32 port_id) const {
               << " for port " << port_id << " in node " << node_id
               << " (SDK Port " << sdk_port_id << ").";
     }
+    if (config.media_autoneg &&
+        (!config.autoneg || *config.autoneg == TRI_STATE_UNKNOWN)) {
+      RETURN_IF_ERROR(bf_sde_interface_->SetPortAutonegPolicy(
+          device, sdk_port_id, *config.media_autoneg));
+      config_new->media_autoneg = *config.media_autoneg;
+    }
     if (config.loopback_mode) {
       RETURN_IF_ERROR(bf_sde_interface_->SetPortLoopbackMode(
           device, sdk_port_id, *config.loopback_mode));
@@ -1186,6 +1536,11 @@ BfChassisManager::GetPortConfig(uint64 node_id, uint32 port_id) const {
                                                 fp_port_info);
 }
 
+void BfChassisManager::SetDeviceToBfrtNodeMap(
+    const std::map<int, BfrtNode*>& device_to_bfrt_node) {
+  device_to_bfrt_node_ = device_to_bfrt_node;
+}
+
 std::unique_ptr<BfChassisManager> BfChassisManager::CreateInstance(
     OperationMode mode, PhalInterface* phal_interface,
     BfSdeInterface* bf_sde_interface) {
@@ -1251,41 +1606,69 @@ void BfChassisManager::ReadPortStatusEvents(
 void BfChassisManager::PortStatusEventHandler(int device, int port,
                                               PortState new_state,
                                               absl::Time time_last_changed) {
-  absl::WriterMutexLock l(&chassis_lock);
   // TODO(max): check for shutdown here
   // if (shutdown) {
   //   VLOG(1) << "The class is already shutdown. Exiting.";
   //   return;
   // }
 
-  // Update the state.
-  const uint64* node_id = gtl::FindOrNull(device_to_node_id_, device);
-  if (node_id == nullptr) {
-    LOG(ERROR) << "Inconsistent state. Device " << device << " is not known!";
-    return;
-  }
-  const uint32* port_id =
-      gtl::FindOrNull(node_id_to_sdk_port_id_to_port_id_[*node_id], port);
-  if (port_id == nullptr) {
-    // We get a notification for all ports, even ports that were not added,
-    // when doing a Fast Refresh, which can be confusing, so we use VLOG
-    // instead.
-    VLOG(1)
-        << "Ignored an unknown SdkPort " << port << " on node " << *node_id
-        << ". Most probably this is a non-configured channel of a flex port.";
-    return;
+  // Look up the port with a shared lock only. Taking chassis_lock exclusively
+  // would wait for all in-flight P4Runtime and gNMI requests to finish, which
+  // would delay the data plane failover below.
+  uint64 node_id;
+  uint32 port_id;
+  {
+    absl::ReaderMutexLock l(&chassis_lock);
+    const uint64* node_id_ptr = gtl::FindOrNull(device_to_node_id_, device);
+    if (node_id_ptr == nullptr) {
+      LOG(ERROR) << "Inconsistent state. Device " << device
+                 << " is not known!";
+      return;
+    }
+    node_id = *node_id_ptr;
+    const auto* sdk_port_id_to_port_id =
+        gtl::FindOrNull(node_id_to_sdk_port_id_to_port_id_, node_id);
+    const uint32* port_id_ptr =
+        sdk_port_id_to_port_id == nullptr
+            ? nullptr
+            : gtl::FindOrNull(*sdk_port_id_to_port_id, port);
+    if (port_id_ptr == nullptr) {
+      // We get a notification for all ports, even ports that were not added,
+      // when doing a Fast Refresh, which can be confusing, so we use VLOG
+      // instead.
+      VLOG(1) << "Ignored an unknown SdkPort " << port << " on node "
+              << node_id
+              << ". Most probably this is a non-configured channel of a flex "
+              << "port.";
+      return;
+    }
+    port_id = *port_id_ptr;
   }
-  node_id_to_port_id_to_port_state_[*node_id][*port_id] = new_state;
-  node_id_to_port_id_to_time_last_changed_[*node_id][*port_id] =
-      time_last_changed;
 
   // Notify the managers about the change of port state.
-  // Nothing to do for now.
+  BfrtNode* bfrt_node = gtl::FindPtrOrNull(device_to_bfrt_node_, device);
+  if (bfrt_node != nullptr) {
+    auto status = bfrt_node->UpdatePortState(port_id, new_state);
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to update managers on node " << node_id
+                 << " on port " << port_id << " state change to "
+                 << PrintPortState(new_state) << " with error: " << status
+                 << ".";
+    }
+  }
+
+  // Update the state.
+  {
+    absl::WriterMutexLock l(&chassis_lock);
+    node_id_to_port_id_to_port_state_[node_id][port_id] = new_state;
+    node_id_to_port_id_to_time_last_changed_[node_id][port_id] =
+        time_last_changed;
+  }
 
   // Notify gNMI about the change of logical port state.
-  SendPortOperStateGnmiEvent(*node_id, *port_id, new_state, time_last_changed);
+  SendPortOperStateGnmiEvent(node_id, port_id, new_state, time_last_changed);
 
-  LOG(INFO) << "State of port " << *port_id << " in node " << *node_id
+  LOG(INFO) << "State of port " << port_id << " in node " << node_id
             << " (SDK port " << port << "): " << PrintPortState(new_state)
             << ".";
 }
@@ -1328,12 +1711,21 @@ void BfChassisManager::ReadTransceiverEvents(
 
 void BfChassisManager::TransceiverEventHandler(int slot, int port,
                                                HwState new_state) {
-  absl::WriterMutexLock l(&chassis_lock);
-
   PortKey xcvr_port_key(slot, port);
   LOG(INFO) << "Transceiver event for port " << xcvr_port_key.ToString() << ": "
             << HwState_Name(new_state) << ".";
 
+  // Reading the module info can take a while, so get it from the PHAL before
+  // taking chassis_lock. This keeps an insertion burst from stalling other
+  // chassis_lock users.
+  FrontPanelPortInfo fp_port_info;
+  ::util::Status status = ::util::OkStatus();
+  if (new_state == HW_STATE_PRESENT) {
+    status = phal_interface_->GetFrontPanelPortInfo(slot, port, &fp_port_info);
+  }
+
+  absl::WriterMutexLock l(&chassis_lock);
+
   // See if we know about this transceiver module. Find a mutable state pointer
   // so we can override it later.
   HwState* mutable_state =
@@ -1368,15 +1760,26 @@ void BfChassisManager::TransceiverEventHandler(int slot, int port,
   }
   *mutable_state = new_state;
 
-  // TODO(antonin): set autoneg based on media type...
-  FrontPanelPortInfo fp_port_info;
-  auto status =
-      phal_interface_->GetFrontPanelPortInfo(slot, port, &fp_port_info);
   if (!status.ok()) {
     LOG(ERROR) << "Failure in TransceiverEventHandler: " << status;
     return;
   }
 
+  // Apply the media defaults to all the ports (channels) of the transceiver.
+  if (new_state == HW_STATE_PRESENT) {
+    for (const auto& node_ports : node_id_to_port_id_to_singleton_port_key_) {
+      for (const auto& e : node_ports.second) {
+        if (e.second.slot != slot || e.second.port != port) continue;
+        ::util::Status error =
+            ApplyMediaPolicy(node_ports.first, e.first, fp_port_info);
+        if (!error.ok()) {
+          LOG(ERROR) << "Failed to apply the media policy to port " << e.first
+                     << " in node " << node_ports.first << ": " << error;
+        }
+      }
+    }
+  }
+
   // Finally, before we exit we make sure if the port was HW_STATE_PRESENT,
   // it is set to HW_STATE_READY to show it has been configured and ready.
   if (*mutable_state == HW_STATE_PRESENT) {
@@ -1385,6 +1788,84 @@ void BfChassisManager::TransceiverEventHandler(int slot, int port,
   }
 }
 
+::util::Status BfChassisManager::ApplyMediaPolicy(
+    uint64 node_id, uint32 port_id, const FrontPanelPortInfo& fp_port_info) {
+  const int* device = gtl::FindOrNull(node_id_to_device_, node_id);
+  const auto* port_id_to_port_key =
+      gtl::FindOrNull(node_id_to_port_id_to_singleton_port_key_, node_id);
+  auto* port_id_to_port_config =
+      gtl::FindOrNull(node_id_to_port_id_to_port_config_, node_id);
+  RET_CHECK(device != nullptr && port_id_to_port_key != nullptr &&
+            port_id_to_port_config != nullptr)
+      << "Unknown node " << node_id << ".";
+  const PortKey* port_key = gtl::FindOrNull(*port_id_to_port_key, port_id);
+  PortConfig* config = gtl::FindOrNull(*port_id_to_port_config, port_id);
+  RET_CHECK(port_key != nullptr && config != nullptr)
+      << "Unknown port " << port_id << " in node " << node_id << ".";
+  // Ports whose last configuration failed are left alone.
+  if (config->admin_state == ADMIN_STATE_UNKNOWN || !config->speed_bps ||
+      !config->fec_mode || !config->autoneg) {
+    return ::util::OkStatus();
+  }
+  const MediaPolicy* policy = FindMediaPolicy(fp_port_info, *config->speed_bps);
+  if (policy == nullptr) {
+    VLOG(1) << "No media policy for "
+            << MediaType_Name(fp_port_info.media_type()) << " on port "
+            << port_id << " in node " << node_id << ".";
+    return ::util::OkStatus();
+  }
+  ASSIGN_OR_RETURN(auto sdk_port_id, GetSdkPortId(node_id, port_id));
+
+  // The SDE can only change the FEC mode by adding the port again. The SDE
+  // treats FEC_MODE_UNKNOWN as FEC_MODE_OFF.
+  FecMode fec_mode =
+      config->media_fec_mode ? *config->media_fec_mode : FEC_MODE_OFF;
+  if (*config->fec_mode == FEC_MODE_UNKNOWN && policy->fec_mode != fec_mode) {
+    SingletonPort singleton_port =
+        BuildSingletonPort(port_key->slot, port_key->port, port_key->channel,
+                           *config->speed_bps);
+    singleton_port.set_id(port_id);
+    auto* config_params = singleton_port.mutable_config_params();
+    config_params->set_admin_state(config->admin_state);
+    config_params->set_fec_mode(policy->fec_mode);
+    config_params->set_autoneg(*config->autoneg);
+    if (config->mtu) config_params->set_mtu(*config->mtu);
+    if (config->loopback_mode) {
+      config_params->set_loopback_mode(*config->loopback_mode);
+    }
+    auto shaping_config = config->shaping_config;
+    RETURN_IF_ERROR(bf_sde_interface_->DisablePort(*device, sdk_port_id));
+    RETURN_IF_ERROR(bf_sde_interface_->DeletePort(*device, sdk_port_id));
+    RETURN_IF_ERROR(
+        AddPortHelper(node_id, *device, sdk_port_id, singleton_port, config));
+    config->fec_mode = FEC_MODE_UNKNOWN;
+    config->media_fec_mode = policy->fec_mode;
+    if (shaping_config) {
+      RETURN_IF_ERROR(ApplyPortShapingConfig(node_id, *device, sdk_port_id,
+                                             *shaping_config));
+      config->shaping_config = shaping_config;
+    }
+    LOG(INFO) << "Set FEC mode " << FecMode_Name(policy->fec_mode)
+              << " for " << MediaType_Name(fp_port_info.media_type())
+              << " on port " << port_id << " in node " << node_id
+              << " (SDK Port " << sdk_port_id << ").";
+  }
+
+  if (*config->autoneg == TRI_STATE_UNKNOWN &&
+      policy->autoneg != TRI_STATE_UNKNOWN &&
+      config->media_autoneg != policy->autoneg) {
+    RETURN_IF_ERROR(bf_sde_interface_->SetPortAutonegPolicy(
+        *device, sdk_port_id, policy->autoneg));
+    config->media_autoneg = policy->autoneg;
+    LOG(INFO) << "Set autoneg policy " << TriState_Name(policy->autoneg)
+              << " for " << MediaType_Name(fp_port_info.media_type())
+              << " on port " << port_id << " in node " << node_id
+              << " (SDK Port " << sdk_port_id << ").";
+  }
+
+  return ::util::OkStatus();
+}
+
 ::util::Status BfChassisManager::RegisterEventWriters() {
   if (initialized_) {
     return MAKE_ERROR(ERR_INTERNAL)
@@ -1512,6 +1993,8 @@ void BfChassisManager::CleanupInternalState() {
   node_id_to_deflect_on_drop_config_.clear();
   node_id_to_qos_config_.clear();
   xcvr_port_key_to_xcvr_state_.clear();
+  absl::MutexLock l(&queue_counters_lock_);
+  node_id_to_queue_counters_.clear();
 }
 
 ::util::Status BfChassisManager::Shutdown() {
@@ -14,11 +14,13 @@
 #include "absl/types/optional.h"
 #include "stratum/glue/integral_types.h"
 #include "stratum/hal/lib/barefoot/bf_sde_interface.h"
+#include "stratum/hal/lib/barefoot/bfrt_node.h"
 #include "stratum/hal/lib/common/gnmi_events.h"
 #include "stratum/hal/lib/common/phal_interface.h"
 #include "stratum/hal/lib/common/utils.h"
 #include "stratum/hal/lib/common/writer_interface.h"
 #include "stratum/lib/channel/channel.h"
+#include "stratum/public/proto/gnmi_extensions.pb.h"
 
 namespace stratum {
 namespace hal {
@@ -48,6 +50,15 @@ class BfChassisManager {
   virtual ::util::Status VerifyChassisConfig(const ChassisConfig& config)
       SHARED_LOCKS_REQUIRED(chassis_lock);
 
+  // Computes the node and port operations that PushChassisConfig() would
+  // perform for the given config, by the same diff against the current port
+  // configs, without changing the switch. A config which needs a reboot is
+  // reported in the plan instead of as an error. QoS and deflect-on-drop
+  // configs are reapplied on every push and are not part of the plan.
+  virtual ::util::Status PlanChassisConfig(const ChassisConfig& config,
+                                           ChassisConfigPlan* plan)
+      SHARED_LOCKS_REQUIRED(chassis_lock);
+
   virtual ::util::Status Shutdown() LOCKS_EXCLUDED(chassis_lock);
 
   virtual ::util::Status RegisterEventNotifyWriter(
@@ -68,6 +79,14 @@ class BfChassisManager {
                                          PortCounters* counters)
       SHARED_LOCKS_REQUIRED(chassis_lock);
 
+  // Returns the counters of an egress queue of a port. They are served from a
+  // snapshot of the TM counters of all ports of the node, which is read in a
+  // single pass when it is older than FLAGS_bf_queue_counters_max_age_ms.
+  virtual ::util::Status GetPortQosCounters(uint64 node_id, uint32 port_id,
+                                            uint32 queue_id,
+                                            PortQosCounters* counters)
+      SHARED_LOCKS_REQUIRED(chassis_lock) LOCKS_EXCLUDED(queue_counters_lock_);
+
   // Replays the current configuration onto the ASIC. This function is called by
   // the switch after a pipeline push (PushForwardingPipelineConfig), as the
   // push resets most device state, including port configuration.
@@ -84,6 +103,13 @@ class BfChassisManager {
   virtual ::util::StatusOr<int> GetDeviceFromNodeId(uint64 node_id) const
       SHARED_LOCKS_REQUIRED(chassis_lock);
 
+  // Initializes the device -> BfrtNode* map. This is not part of the
+  // constructor, to keep the creation order of the chassis manager and the
+  // nodes independent. The nodes are notified about port status changes.
+  virtual void SetDeviceToBfrtNodeMap(
+      const std::map<int, BfrtNode*>& device_to_bfrt_node)
+      LOCKS_EXCLUDED(chassis_lock);
+
   // Factory function for creating the instance of the class.
   static std::unique_ptr<BfChassisManager> CreateInstance(
       OperationMode mode, PhalInterface* phal_interface,
@@ -120,10 +146,23 @@ class BfChassisManager {
     // empty if no shaping config given
     absl::optional<TofinoConfig::BfPortShapingConfig::BfPerPortShapingConfig>
         shaping_config;
+    // The autoneg policy and FEC mode applied from the media policy table
+    // when the config leaves them unset. Empty if no media default applies.
+    absl::optional<TriState> media_autoneg;
+    absl::optional<FecMode> media_fec_mode;
 
     PortConfig() : admin_state(ADMIN_STATE_UNKNOWN) {}
   };
 
+  // A snapshot of the TM queue counters of all ports of a node.
+  struct QueueCountersSnapshot {
+    // The time the snapshot was read, InfinitePast if it never was.
+    absl::Time timestamp = absl::InfinitePast();
+    // Map from port ID to another map from queue ID to the queue counters.
+    std::map<uint32, std::map<uint32, PortQosCounters>>
+        port_id_to_queue_id_to_counters;
+  };
+
   // Maximum depth of port status change event channel.
   static constexpr int kMaxPortStatusEventDepth = 1024;
   static constexpr int kMaxXcvrEventDepth = 1024;
@@ -163,7 +202,8 @@ class BfChassisManager {
 
   // Transceiver module insert/removal event handler. This method is executed by
   // a ChannelReader thread which processes transceiver module insert/removal
-  // events. Port is the 1-based frontpanel port number.
+  // events. Port is the 1-based frontpanel port number. The module info is
+  // read from the PHAL before chassis_lock is taken.
   // NOTE: This method should never be executed directly from a context which
   // first accesses the internal structures of a class below BfChassisManager
   // as this may result in deadlock.
@@ -218,6 +258,13 @@ class BfChassisManager {
       const TofinoConfig::BfPortShapingConfig::BfPerPortShapingConfig&
           shaping_config);
 
+  // Applies the autoneg and FEC defaults of the media policy table for the
+  // inserted transceiver to a port whose config leaves them unset. A FEC
+  // change deletes and re-adds the port with the SDE.
+  ::util::Status ApplyMediaPolicy(uint64 node_id, uint32 port_id,
+                                  const FrontPanelPortInfo& fp_port_info)
+      EXCLUSIVE_LOCKS_REQUIRED(chassis_lock);
+
   // Determines the mode of operation:
   // - OPERATION_MODE_STANDALONE: when Stratum stack runs independently and
   // therefore needs to do all the SDK initialization itself.
@@ -303,6 +350,20 @@ class BfChassisManager {
   std::map<PortKey, HwState> xcvr_port_key_to_xcvr_state_
       GUARDED_BY(chassis_lock);
 
+  // Lock which protects the queue counter snapshots. Readers of port data only
+  // hold chassis_lock in shared mode, but a stale snapshot is refreshed by the
+  // reader which finds it. Acquired after chassis_lock.
+  mutable absl::Mutex queue_counters_lock_ ACQUIRED_AFTER(chassis_lock);
+
+  // Map from node ID to the snapshot of its TM queue counters. Cleared on
+  // every config push, as the port layout may have changed.
+  std::map<uint64, QueueCountersSnapshot> node_id_to_queue_counters_
+      GUARDED_BY(queue_counters_lock_);
+
+  // Map from device number to BfrtNode instance. Set once at startup, before
+  // any port status events can be received.
+  std::map<int, BfrtNode*> device_to_bfrt_node_;  // not owned by this class.
+
   // Pointer to a PhalInterface implementation.
   PhalInterface* phal_interface_;  // not owned by this class.
 
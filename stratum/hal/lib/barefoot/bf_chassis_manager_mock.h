@@ -20,6 +20,8 @@ class BfChassisManagerMock : public BfChassisManager {
   MOCK_METHOD1(PushChassisConfig, ::util::Status(const ChassisConfig& config));
   MOCK_METHOD1(VerifyChassisConfig,
                ::util::Status(const ChassisConfig& config));
+  MOCK_METHOD2(PlanChassisConfig, ::util::Status(const ChassisConfig& config,
+                                                 ChassisConfigPlan* plan));
   MOCK_METHOD0(Shutdown, ::util::Status());
 
   MOCK_METHOD1(
@@ -33,6 +35,9 @@ class BfChassisManagerMock : public BfChassisManager {
                ::util::StatusOr<absl::Time>(uint64 node_id, uint32 port_id));
   MOCK_METHOD3(GetPortCounters, ::util::Status(uint64 node_id, uint32 port_id,
                                                PortCounters* counters));
+  MOCK_METHOD4(GetPortQosCounters,
+               ::util::Status(uint64 node_id, uint32 port_id, uint32 queue_id,
+                              PortQosCounters* counters));
   MOCK_METHOD1(ReplayChassisConfig, ::util::Status(uint64 node_id));
   MOCK_METHOD3(GetFrontPanelPortInfo,
                ::util::Status(uint64 node_id, uint32 port_id,
@@ -41,6 +46,8 @@ class BfChassisManagerMock : public BfChassisManager {
                      ::util::StatusOr<std::map<uint64, int>>());
   MOCK_CONST_METHOD1(GetDeviceFromNodeId,
                      ::util::StatusOr<int>(uint64 node_id));
+  MOCK_METHOD1(SetDeviceToBfrtNodeMap,
+               void(const std::map<int, BfrtNode*>& device_to_bfrt_node));
 };
 
 }  // namespace barefoot
@@ -3,27 +3,35 @@
 
 #include "stratum/hal/lib/barefoot/bf_chassis_manager.h"
 
+#include <map>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/strings/match.h"
 #include "absl/synchronization/notification.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
+#include "gflags/gflags.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "stratum/glue/gtl/map_util.h"
 #include "stratum/glue/integral_types.h"
 #include "stratum/glue/status/status.h"
 #include "stratum/glue/status/status_test_util.h"
 #include "stratum/glue/status/statusor.h"
 #include "stratum/hal/lib/barefoot/bf_sde_mock.h"
+#include "stratum/hal/lib/barefoot/bfrt_node_mock.h"
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/hal/lib/common/phal_mock.h"
 #include "stratum/hal/lib/common/writer_mock.h"
+#include "stratum/hal/lib/phal/phal_sim.h"
 #include "stratum/lib/constants.h"
 #include "stratum/lib/test_utils/matchers.h"
 #include "stratum/lib/utils.h"
 
+DECLARE_int32(bf_queue_counters_max_age_ms);
+
 namespace stratum {
 namespace hal {
 namespace barefoot {
@@ -34,6 +42,7 @@ using ::testing::_;
 using ::testing::AtLeast;
 using ::testing::AtMost;
 using ::testing::DoAll;
+using ::testing::ElementsAre;
 using ::testing::HasSubstr;
 using ::testing::Invoke;
 using ::testing::Matcher;
@@ -142,6 +151,14 @@ class BfChassisManagerTest : public ::testing::Test {
             WithArg<1>(Invoke([](uint32 id) { return id > kSdkPortOffset; })));
   }
 
+  // Makes the class under test get the transceiver events from a PhalSim
+  // instead of the PHAL mock.
+  void UsePhalSim() {
+    phal_sim_ = PhalSim::CreateInstance();
+    bf_chassis_manager_ = BfChassisManager::CreateInstance(
+        OPERATION_MODE_STANDALONE, phal_sim_.get(), bf_sde_mock_.get());
+  }
+
   void RegisterSdkPortId(uint32 port_id, int slot, int port, int channel,
                          int device) {
     PortKey port_key(slot, port, channel);
@@ -177,6 +194,12 @@ class BfChassisManagerTest : public ::testing::Test {
     return bf_chassis_manager_->VerifyChassisConfig(config);
   }
 
+  ::util::Status PlanChassisConfig(const ChassisConfigBuilder& builder,
+                                   ChassisConfigPlan* plan) {
+    absl::ReaderMutexLock l(&chassis_lock);
+    return bf_chassis_manager_->PlanChassisConfig(builder.Get(), plan);
+  }
+
   ::util::Status PushChassisConfig(const ChassisConfig& config) {
     absl::WriterMutexLock l(&chassis_lock);
     return bf_chassis_manager_->PushChassisConfig(config);
@@ -203,13 +226,15 @@ class BfChassisManagerTest : public ::testing::Test {
                                        kDefaultSpeedBps, kDefaultFecMode));
     EXPECT_CALL(*bf_sde_mock_, EnablePort(kDevice, kPortId + kSdkPortOffset));
 
-    EXPECT_CALL(*phal_mock_,
-                RegisterTransceiverEventWriter(
-                    _, PhalInterface::kTransceiverEventWriterPriorityHigh))
-        .WillOnce(Return(kTestTransceiverWriterId));
-    EXPECT_CALL(*phal_mock_,
-                UnregisterTransceiverEventWriter(kTestTransceiverWriterId))
-        .WillOnce(Return(::util::OkStatus()));
+    if (phal_sim_ == nullptr) {
+      EXPECT_CALL(*phal_mock_,
+                  RegisterTransceiverEventWriter(
+                      _, PhalInterface::kTransceiverEventWriterPriorityHigh))
+          .WillOnce(Return(kTestTransceiverWriterId));
+      EXPECT_CALL(*phal_mock_,
+                  UnregisterTransceiverEventWriter(kTestTransceiverWriterId))
+          .WillOnce(Return(::util::OkStatus()));
+    }
 
     RETURN_IF_ERROR(PushChassisConfig(builder->Get()));
     auto device = GetDeviceFromNodeId(kNodeId);
@@ -261,6 +286,13 @@ class BfChassisManagerTest : public ::testing::Test {
         bf_chassis_manager_->xcvr_event_channel_);
   }
 
+  HwState GetTransceiverState(int slot, int port) {
+    absl::ReaderMutexLock l(&chassis_lock);
+    return gtl::FindWithDefault(
+        bf_chassis_manager_->xcvr_port_key_to_xcvr_state_, PortKey(slot, port),
+        HW_STATE_UNKNOWN);
+  }
+
   void TriggerPortStatusEvent(int device, int port, PortState state,
                               absl::Time time_last_changed) {
     PortStatusEvent event;
@@ -272,6 +304,7 @@ class BfChassisManagerTest : public ::testing::Test {
   }
 
   std::unique_ptr<PhalMock> phal_mock_;
+  std::unique_ptr<PhalSim> phal_sim_;  // Only set by UsePhalSim().
   std::unique_ptr<BfSdeMock> bf_sde_mock_;
   std::unique_ptr<ChannelWriter<PortStatusEvent>> sde_event_writer_;
   std::unique_ptr<BfChassisManager> bf_chassis_manager_;
@@ -644,6 +677,117 @@ TEST_F(BfChassisManagerTest, TransceiverEvent) {
   ASSERT_OK(ShutdownAndTestCleanState());
 }
 
+TEST_F(BfChassisManagerTest, TransceiverInsertionAppliesMediaPolicy) {
+  ChassisConfigBuilder builder;
+  // A second channel with an explicit FEC mode and autoneg policy must keep
+  // its config.
+  const uint32 sdk_port_id = kPortId + kSdkPortOffset;
+  const uint32 explicit_port_id = kPortId + 1;
+  const uint32 explicit_sdk_port_id = explicit_port_id + kSdkPortOffset;
+  SingletonPort* explicit_port =
+      builder.AddPort(explicit_port_id, kPort, ADMIN_STATE_ENABLED,
+                      kDefaultSpeedBps, FEC_MODE_OFF, TRI_STATE_TRUE);
+  explicit_port->set_channel(1);
+  RegisterSdkPortId(explicit_port);
+  EXPECT_CALL(*bf_sde_mock_, AddPort(kDevice, explicit_sdk_port_id,
+                                     kDefaultSpeedBps, FEC_MODE_OFF));
+  EXPECT_CALL(*bf_sde_mock_, SetPortAutonegPolicy(kDevice, explicit_sdk_port_id,
+                                                  TRI_STATE_TRUE));
+  EXPECT_CALL(*bf_sde_mock_, EnablePort(kDevice, explicit_sdk_port_id));
+  ASSERT_OK(PushBaseChassisConfig(&builder));
+  auto xcvr_event_writer = GetTransceiverEventWriter();
+
+  // The module info must be read while chassis_lock is free.
+  FrontPanelPortInfo fp_port_info;
+  fp_port_info.set_physical_port_type(PHYSICAL_PORT_TYPE_QSFP_CAGE);
+  fp_port_info.set_media_type(MEDIA_TYPE_QSFP_SR4);
+  fp_port_info.set_hw_state(HW_STATE_PRESENT);
+  bool chassis_lock_free = false;
+  EXPECT_CALL(*phal_mock_, GetFrontPanelPortInfo(kSlot, kPort, _))
+      .WillOnce([&](int slot, int port, FrontPanelPortInfo* info) {
+        chassis_lock_free = chassis_lock.WriterTryLock();
+        if (chassis_lock_free) chassis_lock.WriterUnlock();
+        *info = fp_port_info;
+        return ::util::OkStatus();
+      });
+
+  // 100G SR4 optics need RS-FEC, so the port is added again with FEC on,
+  // then autoneg is disabled.
+  absl::Notification media_policy_applied;
+  {
+    Sequence s;
+    EXPECT_CALL(*bf_sde_mock_, DisablePort(kDevice, sdk_port_id))
+        .InSequence(s);
+    EXPECT_CALL(*bf_sde_mock_, DeletePort(kDevice, sdk_port_id)).InSequence(s);
+    EXPECT_CALL(*bf_sde_mock_,
+                AddPort(kDevice, sdk_port_id, kDefaultSpeedBps, FEC_MODE_ON))
+        .InSequence(s);
+    EXPECT_CALL(*bf_sde_mock_, EnablePort(kDevice, sdk_port_id)).InSequence(s);
+    EXPECT_CALL(*bf_sde_mock_,
+                SetPortAutonegPolicy(kDevice, sdk_port_id, TRI_STATE_FALSE))
+        .InSequence(s)
+        .WillOnce(DoAll([&media_policy_applied] {
+                          media_policy_applied.Notify();
+                        },
+                        Return(::util::OkStatus())));
+  }
+  EXPECT_CALL(*bf_sde_mock_, DeletePort(kDevice, explicit_sdk_port_id))
+      .Times(0);
+
+  EXPECT_OK(
+      xcvr_event_writer->Write(TransceiverEvent{kSlot, kPort, HW_STATE_PRESENT},
+                               absl::InfiniteDuration()));
+  ASSERT_TRUE(
+      media_policy_applied.WaitForNotificationWithTimeout(absl::Seconds(5)));
+  EXPECT_TRUE(chassis_lock_free);
+
+  ASSERT_OK(ShutdownAndTestCleanState());
+}
+
+TEST_F(BfChassisManagerTest, ConfiguredAutonegOverridesMediaPolicyOnReplay) {
+  ChassisConfigBuilder builder;
+  ASSERT_OK(PushBaseChassisConfig(&builder));
+  auto xcvr_event_writer = GetTransceiverEventWriter();
+  const uint32 sdk_port_id = kPortId + kSdkPortOffset;
+
+  // LR4 optics get autoneg disabled, and keep FEC off.
+  FrontPanelPortInfo fp_port_info;
+  fp_port_info.set_physical_port_type(PHYSICAL_PORT_TYPE_QSFP_CAGE);
+  fp_port_info.set_media_type(MEDIA_TYPE_QSFP_LR4);
+  fp_port_info.set_hw_state(HW_STATE_PRESENT);
+  EXPECT_CALL(*phal_mock_, GetFrontPanelPortInfo(kSlot, kPort, _))
+      .WillOnce(DoAll(SetArgPointee<2>(fp_port_info),
+                      Return(::util::OkStatus())));
+  absl::Notification media_policy_applied;
+  EXPECT_CALL(*bf_sde_mock_,
+              SetPortAutonegPolicy(kDevice, sdk_port_id, TRI_STATE_FALSE))
+      .WillOnce(DoAll([&media_policy_applied] {
+                        media_policy_applied.Notify();
+                      },
+                      Return(::util::OkStatus())));
+  EXPECT_OK(
+      xcvr_event_writer->Write(TransceiverEvent{kSlot, kPort, HW_STATE_PRESENT},
+                               absl::InfiniteDuration()));
+  ASSERT_TRUE(
+      media_policy_applied.WaitForNotificationWithTimeout(absl::Seconds(5)));
+
+  // The configured autoneg policy replaces the media default, which is not
+  // replayed over it.
+  builder.GetPort(kPortId)->mutable_config_params()->set_autoneg(
+      TRI_STATE_TRUE);
+  EXPECT_CALL(*bf_sde_mock_,
+              SetPortAutonegPolicy(kDevice, sdk_port_id, TRI_STATE_TRUE))
+      .Times(2);
+  EXPECT_CALL(*bf_sde_mock_, EnablePort(kDevice, sdk_port_id)).Times(2);
+  ASSERT_OK(PushChassisConfig(builder));
+
+  EXPECT_CALL(*bf_sde_mock_,
+              AddPort(kDevice, sdk_port_id, kDefaultSpeedBps, kDefaultFecMode));
+  EXPECT_OK(ReplayChassisConfig(kNodeId));
+
+  ASSERT_OK(ShutdownAndTestCleanState());
+}
+
 template <typename T>
 T GetPortData(BfChassisManager* bf_chassis_manager_, uint64 node_id,
               int port_id,
@@ -900,6 +1044,106 @@ TEST_F(BfChassisManagerTest, GetPortData) {
   ASSERT_OK(ShutdownAndTestCleanState());
 }
 
+TEST_F(BfChassisManagerTest, GetPortQosCountersFromSnapshot) {
+  ::gflags::FlagSaver flag_saver;
+  FLAGS_bf_queue_counters_max_age_ms = 60 * 1000;
+  ChassisConfigBuilder builder;
+  ASSERT_OK(PushBaseChassisConfig(&builder));
+
+  const uint32 portId = kPortId + 1;
+  const uint32 sdkPortId = portId + kSdkPortOffset;
+  RegisterSdkPortId(builder.AddPort(portId, kPort + 1, ADMIN_STATE_ENABLED));
+  EXPECT_CALL(*bf_sde_mock_,
+              AddPort(kDevice, sdkPortId, kDefaultSpeedBps, kDefaultFecMode));
+  EXPECT_CALL(*bf_sde_mock_, EnablePort(kDevice, sdkPortId));
+  ASSERT_OK(PushChassisConfig(builder));
+
+  std::map<int, std::vector<PortQosCounters>> sdk_port_to_counters;
+  for (const int sdk_port : {kPortId + kSdkPortOffset, sdkPortId}) {
+    for (uint32 queue_id = 0; queue_id < 2; ++queue_id) {
+      PortQosCounters counters;
+      counters.set_queue_id(queue_id);
+      counters.set_out_dropped_pkts(sdk_port - kSdkPortOffset + queue_id);
+      counters.set_watermark_cells(queue_id + 10);
+      sdk_port_to_counters[sdk_port].push_back(counters);
+    }
+  }
+  // All queues of all ports are read once, for both ports.
+  EXPECT_CALL(*bf_sde_mock_,
+              GetQueueCounters(
+                  kDevice, ElementsAre(kPortId + kSdkPortOffset, sdkPortId), _))
+      .WillOnce(DoAll(SetArgPointee<2>(sdk_port_to_counters),
+                      Return(::util::OkStatus())));
+
+  for (const uint32 port_id : {kPortId, portId}) {
+    for (uint32 queue_id = 0; queue_id < 2; ++queue_id) {
+      DataRequest::Request req;
+      req.mutable_port_qos_counters()->set_node_id(kNodeId);
+      req.mutable_port_qos_counters()->set_port_id(port_id);
+      req.mutable_port_qos_counters()->set_queue_id(queue_id);
+      auto resp = bf_chassis_manager_->GetPortData(req);
+      ASSERT_OK(resp);
+      PortQosCounters expected;
+      expected.set_queue_id(queue_id);
+      expected.set_out_dropped_pkts(port_id + queue_id);
+      expected.set_watermark_cells(queue_id + 10);
+      EXPECT_THAT(resp.ValueOrDie().port_qos_counters(),
+                  EqualsProto(expected));
+    }
+  }
+
+  // Unknown queue.
+  PortQosCounters counters;
+  {
+    absl::ReaderMutexLock l(&chassis_lock);
+    ::util::Status status =
+        bf_chassis_manager_->GetPortQosCounters(kNodeId, portId, 7, &counters);
+    EXPECT_EQ(ERR_INVALID_PARAM, status.error_code());
+    EXPECT_THAT(status.error_message(), HasSubstr("Queue 7 is not known"));
+  }
+
+  // A stale snapshot is read again.
+  FLAGS_bf_queue_counters_max_age_ms = 0;
+  absl::SleepFor(absl::Milliseconds(1));
+  sdk_port_to_counters[sdkPortId][1].set_out_dropped_pkts(1234);
+  EXPECT_CALL(*bf_sde_mock_, GetQueueCounters(kDevice, _, _))
+      .WillOnce(DoAll(SetArgPointee<2>(sdk_port_to_counters),
+                      Return(::util::OkStatus())));
+  {
+    absl::ReaderMutexLock l(&chassis_lock);
+    ASSERT_OK(
+        bf_chassis_manager_->GetPortQosCounters(kNodeId, portId, 1, &counters));
+  }
+  EXPECT_EQ(1234, counters.out_dropped_pkts());
+
+  ASSERT_OK(ShutdownAndTestCleanState());
+}
+
+TEST_F(BfChassisManagerTest, PortStatusEventNotifiesNodeWithoutExclusiveLock) {
+  ASSERT_OK(PushBaseChassisConfig());
+  BfrtNodeMock bfrt_node_mock;
+  bf_chassis_manager_->SetDeviceToBfrtNodeMap({{kDevice, &bfrt_node_mock}});
+
+  // The node must be notified with the SDN port ID, while chassis_lock is not
+  // held exclusively, i.e. while other readers can still make progress.
+  absl::Notification node_notified;
+  bool chassis_lock_shareable = false;
+  EXPECT_CALL(bfrt_node_mock, UpdatePortState(kPortId, PORT_STATE_DOWN))
+      .WillOnce([&](uint32 port_id, PortState new_state) {
+        chassis_lock_shareable = chassis_lock.ReaderTryLock();
+        if (chassis_lock_shareable) chassis_lock.ReaderUnlock();
+        node_notified.Notify();
+        return ::util::OkStatus();
+      });
+
+  TriggerPortStatusEvent(kDevice, kPortId + kSdkPortOffset, PORT_STATE_DOWN,
+                         absl::FromUnixSeconds(1234));
+  ASSERT_TRUE(node_notified.WaitForNotificationWithTimeout(absl::Seconds(5)));
+  EXPECT_TRUE(chassis_lock_shareable);
+
+  ASSERT_OK(ShutdownAndTestCleanState());
+}
+
 TEST_F(BfChassisManagerTest, UpdateInvalidPort) {
   ASSERT_OK(PushBaseChassisConfig());
   ChassisConfigBuilder builder;
@@ -931,6 +1175,99 @@ TEST_F(BfChassisManagerTest, UpdateInvalidPort) {
   ASSERT_OK(ShutdownAndTestCleanState());
 }
 
+TEST_F(BfChassisManagerTest, PlanPortChanges) {
+  ChassisConfigBuilder builder;
+  ASSERT_OK(PushBaseChassisConfig(&builder));
+
+  // Planning must not touch the ports.
+  EXPECT_CALL(*bf_sde_mock_, AddPort(_, _, _, _)).Times(0);
+  EXPECT_CALL(*bf_sde_mock_, DeletePort(_, _)).Times(0);
+  EXPECT_CALL(*bf_sde_mock_, DisablePort(_, _)).Times(0);
+  EXPECT_CALL(*bf_sde_mock_, SetPortMtu(_, _, _)).Times(0);
+
+  // An unchanged config has an empty plan.
+  ChassisConfigPlan plan;
+  ASSERT_OK(PlanChassisConfig(builder, &plan));
+  EXPECT_EQ(0, plan.operations_size());
+  EXPECT_FALSE(plan.disruptive());
+
+  // A speed change deletes and adds the port again.
+  SingletonPort* sport = builder.GetPort(kPortId);
+  sport->set_speed_bps(kFortyGigBps);
+  plan.Clear();
+  ASSERT_OK(PlanChassisConfig(builder, &plan));
+  ASSERT_EQ(1, plan.operations_size());
+  EXPECT_EQ(ChassisConfigPlan::Operation::MODIFY, plan.operations(0).type());
+  EXPECT_EQ(kPortId, plan.operations(0).port_id());
+  ASSERT_EQ(1, plan.operations(0).changes_size());
+  EXPECT_EQ("speed_bps", plan.operations(0).changes(0).field());
+  EXPECT_TRUE(plan.operations(0).changes(0).disruptive());
+  EXPECT_TRUE(plan.disruptive());
+  EXPECT_FALSE(plan.reboot_required());
+
+  // An MTU change flaps the enabled port.
+  sport->set_speed_bps(kDefaultSpeedBps);
+  sport->mutable_config_params()->set_mtu(9000);
+  plan.Clear();
+  ASSERT_OK(PlanChassisConfig(builder, &plan));
+  ASSERT_EQ(1, plan.operations_size());
+  EXPECT_EQ("mtu", plan.operations(0).changes(0).field());
+  EXPECT_TRUE(plan.disruptive());
+
+  // A FEC change cannot be applied without re-adding the port.
+  sport->mutable_config_params()->clear_mtu();
+  sport->mutable_config_params()->set_fec_mode(FEC_MODE_ON);
+  plan.Clear();
+  EXPECT_EQ(ERR_UNIMPLEMENTED, PlanChassisConfig(builder, &plan).error_code());
+
+  // A removed port changes the port layout.
+  builder.RemoveLastPort();
+  plan.Clear();
+  ASSERT_OK(PlanChassisConfig(builder, &plan));
+  EXPECT_TRUE(plan.reboot_required());
+  ASSERT_EQ(1, plan.operations_size());
+  EXPECT_EQ(ChassisConfigPlan::Operation::REMOVE, plan.operations(0).type());
+
+  ASSERT_OK(ShutdownAndTestCleanState());
+}
+
+TEST_F(BfChassisManagerTest, PlanPortShapingIsNotDisruptive) {
+  const std::string kVendorConfigText = R"pb(
+    tofino_config {
+      node_id_to_port_shaping_config {
+        key: 7654321
+        value {
+          per_port_shaping_configs {
+            key: 12345
+            value {
+              byte_shaping {
+                rate_bps: 10000000000 # 10G
+                burst_bytes: 16384 # 2x jumbo frame
+              }
+            }
+          }
+        }
+      }
+    }
+  )pb";
+
+  ChassisConfigBuilder builder;
+  ASSERT_OK(PushBaseChassisConfig(&builder));
+
+  VendorConfig vendor_config;
+  ASSERT_OK(ParseProtoFromString(kVendorConfigText, &vendor_config));
+  builder.SetVendorConfig(vendor_config);
+  EXPECT_CALL(*bf_sde_mock_, SetPortShapingRate(_, _, _, _, _)).Times(0);
+  ChassisConfigPlan plan;
+  ASSERT_OK(PlanChassisConfig(builder, &plan));
+  ASSERT_EQ(1, plan.operations_size());
+  ASSERT_EQ(1, plan.operations(0).changes_size());
+  EXPECT_EQ("shaping_config", plan.operations(0).changes(0).field());
+  EXPECT_FALSE(plan.disruptive());
+
+  ASSERT_OK(ShutdownAndTestCleanState());
+}
+
 TEST_F(BfChassisManagerTest, VerifyChassisConfigSuccess) {
   const std::string kConfigText1 = R"(
       description: "Sample Generic Tofino config 2x25G ports."
@@ -977,6 +1314,56 @@ TEST_F(BfChassisManagerTest, VerifyChassisConfigSuccess) {
   ASSERT_OK(VerifyChassisConfig(config1));
 }
 
+TEST_F(BfChassisManagerTest, TransceiverInsertionStormFromPhalSimScenario) {
+  constexpr int kNumPorts = 32;
+  UsePhalSim();
+  ASSERT_OK(phal_sim_->PushChassisConfig(ChassisConfig()));
+  ChassisConfigBuilder builder;
+  for (int port = kPort + 1; port <= kNumPorts; ++port) {
+    const uint32 port_id = kPortId + port - kPort;
+    RegisterSdkPortId(builder.AddPort(port_id, port, ADMIN_STATE_ENABLED));
+    EXPECT_CALL(*bf_sde_mock_, AddPort(kDevice, port_id + kSdkPortOffset,
+                                       kDefaultSpeedBps, kDefaultFecMode));
+    EXPECT_CALL(*bf_sde_mock_, EnablePort(kDevice, port_id + kSdkPortOffset));
+  }
+  ASSERT_OK(PushBaseChassisConfig(&builder));
+  // The 100G SR4 modules of the scenario turn RS-FEC on, which adds each port
+  // again.
+  for (int port = kPort; port <= kNumPorts; ++port) {
+    const uint32 sdk_port_id = kPortId + port - kPort + kSdkPortOffset;
+    EXPECT_CALL(*bf_sde_mock_, DisablePort(kDevice, sdk_port_id));
+    EXPECT_CALL(*bf_sde_mock_, DeletePort(kDevice, sdk_port_id));
+    EXPECT_CALL(*bf_sde_mock_,
+                AddPort(kDevice, sdk_port_id, kDefaultSpeedBps, FEC_MODE_ON));
+    EXPECT_CALL(*bf_sde_mock_, EnablePort(kDevice, sdk_port_id));
+    EXPECT_CALL(*bf_sde_mock_,
+                SetPortAutonegPolicy(kDevice, sdk_port_id, TRI_STATE_FALSE));
+  }
+  PhalSimScenario scenario;
+  ASSERT_OK(ReadProtoFromTextFile(
+      "stratum/hal/lib/phal/sim_scenarios/insertion_storm.pb.txt", &scenario));
+
+  // All the modules are inserted within 32ms, the class must process all the
+  // events and get the info of each module from PhalSim.
+  ASSERT_OK(phal_sim_->RunScenario(scenario, 1));
+  absl::Time deadline = absl::Now() + absl::Seconds(10);
+  int num_ready_ports = 0;
+  while (absl::Now() < deadline) {
+    num_ready_ports = 0;
+    for (int port = 1; port <= kNumPorts; ++port) {
+      if (GetTransceiverState(kSlot, port) == HW_STATE_READY) {
+        ++num_ready_ports;
+      }
+    }
+    if (num_ready_ports == kNumPorts) break;
+    absl::SleepFor(absl::Milliseconds(10));
+  }
+  EXPECT_EQ(kNumPorts, num_ready_ports);
+
+  ASSERT_OK(ShutdownAndTestCleanState());
+  ASSERT_OK(phal_sim_->Shutdown());
+}
+
 }  // namespace barefoot
 }  // namespace hal
 }  // namespace stratum
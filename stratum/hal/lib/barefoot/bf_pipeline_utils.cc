@@ -5,8 +5,10 @@
 
 #include <arpa/inet.h>
 
+#include <algorithm>
 #include <string>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/strip.h"
 #include "gflags/gflags.h"
 #include "nlohmann/json.hpp"
@@ -27,6 +29,41 @@ std::string Uint32ToLeByteStream(uint32 val) {
   bytes.assign(reinterpret_cast<char*>(&tmp), sizeof(uint32));
   return bytes;
 }
+
+// Returns true if both repeated fields hold the same messages, in order.
+template <typename T>
+bool RepeatedProtoEqual(const ::google::protobuf::RepeatedPtrField<T>& a,
+                        const ::google::protobuf::RepeatedPtrField<T>& b) {
+  if (a.size() != b.size()) return false;
+  for (int i = 0; i < a.size(); ++i) {
+    if (!ProtoEqual(a.Get(i), b.Get(i))) return false;
+  }
+  return true;
+}
+
+// Returns true if the actions referenced by the table have the same name and
+// parameters in both P4Infos.
+bool TableActionsUnchanged(
+    const ::p4::config::v1::Table& table,
+    const absl::flat_hash_map<uint32, const ::p4::config::v1::Action*>&
+        old_actions,
+    const absl::flat_hash_map<uint32, const ::p4::config::v1::Action*>&
+        new_actions) {
+  for (const auto& action_ref : table.action_refs()) {
+    auto old_it = old_actions.find(action_ref.id());
+    auto new_it = new_actions.find(action_ref.id());
+    if (old_it == old_actions.end() || new_it == new_actions.end()) {
+      return false;
+    }
+    const auto& old_action = *old_it->second;
+    const auto& new_action = *new_it->second;
+    if (old_action.preamble().name() != new_action.preamble().name() ||
+        !RepeatedProtoEqual(old_action.params(), new_action.params())) {
+      return false;
+    }
+  }
+  return true;
+}
 }  // namespace
 
 ::util::Status ExtractBfPipelineConfig(
@@ -43,6 +80,61 @@ std::string Uint32ToLeByteStream(uint32 val) {
          << "Unknown format for p4_device_config.";
 }
 
+std::vector<uint32> GetTablesWithUnchangedSchema(
+    const ::p4::config::v1::P4Info& old_p4info,
+    const ::p4::config::v1::P4Info& new_p4info) {
+  absl::flat_hash_map<uint32, const ::p4::config::v1::Table*> new_tables;
+  for (const auto& table : new_p4info.tables()) {
+    new_tables[table.preamble().id()] = &table;
+  }
+  absl::flat_hash_map<uint32, const ::p4::config::v1::Action*> old_actions;
+  for (const auto& action : old_p4info.actions()) {
+    old_actions[action.preamble().id()] = &action;
+  }
+  absl::flat_hash_map<uint32, const ::p4::config::v1::Action*> new_actions;
+  for (const auto& action : new_p4info.actions()) {
+    new_actions[action.preamble().id()] = &action;
+  }
+
+  std::vector<uint32> table_ids;
+  for (const auto& old_table : old_p4info.tables()) {
+    auto it = new_tables.find(old_table.preamble().id());
+    if (it == new_tables.end()) continue;
+    const auto& new_table = *it->second;
+    if (old_table.is_const_table() || new_table.is_const_table() ||
+        old_table.implementation_id() != 0 ||
+        new_table.implementation_id() != 0) {
+      continue;
+    }
+    if (old_table.preamble().name() != new_table.preamble().name() ||
+        !RepeatedProtoEqual(old_table.match_fields(),
+                            new_table.match_fields()) ||
+        !std::is_permutation(old_table.direct_resource_ids().begin(),
+                             old_table.direct_resource_ids().end(),
+                             new_table.direct_resource_ids().begin(),
+                             new_table.direct_resource_ids().end())) {
+      continue;
+    }
+    // The new table may reference more actions, but all the actions of the
+    // old table must still be valid.
+    if (!TableActionsUnchanged(old_table, old_actions, new_actions)) continue;
+    bool all_actions_referenced = std::all_of(
+        old_table.action_refs().begin(), old_table.action_refs().end(),
+        [&new_table](const ::p4::config::v1::ActionRef& old_ref) {
+          return std::any_of(
+              new_table.action_refs().begin(), new_table.action_refs().end(),
+              [&old_ref](const ::p4::config::v1::ActionRef& new_ref) {
+                return new_ref.id() == old_ref.id();
+              });
+        });
+    if (!all_actions_referenced) continue;
+    table_ids.push_back(old_table.preamble().id());
+  }
+  std::sort(table_ids.begin(), table_ids.end());
+
+  return table_ids;
+}
+
 }  // namespace barefoot
 }  // namespace hal
 }  // namespace stratum
@@ -5,8 +5,11 @@
 #define STRATUM_HAL_LIB_BAREFOOT_BF_PIPELINE_UTILS_H_
 
 #include <string>
+#include <vector>
 
+#include "p4/config/v1/p4info.pb.h"
 #include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/integral_types.h"
 #include "stratum/glue/status/status.h"
 #include "stratum/hal/lib/barefoot/bf.pb.h"
 
@@ -23,6 +26,16 @@ namespace barefoot {
     const ::p4::v1::ForwardingPipelineConfig& config,
     BfPipelineConfig* bf_config);
 
+// Returns the IDs, in ascending order, of the tables whose entries can be
+// written as-is to a pipeline with the new P4Info after being read from a
+// pipeline with the old one. These are the tables present in both P4Infos with
+// the same name, match fields, direct resources and action definitions. Const
+// tables and tables with an action profile are never included, as their
+// entries are not owned by the table itself.
+std::vector<uint32> GetTablesWithUnchangedSchema(
+    const ::p4::config::v1::P4Info& old_p4info,
+    const ::p4::config::v1::P4Info& new_p4info);
+
 }  // namespace barefoot
 }  // namespace hal
 }  // namespace stratum
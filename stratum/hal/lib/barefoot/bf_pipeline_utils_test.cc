@@ -5,6 +5,8 @@
 
 #include "stratum/hal/lib/barefoot/bf_pipeline_utils.h"
 
+#include <vector>
+
 #include "absl/strings/escaping.h"
 #include "gflags/gflags.h"
 #include "gtest/gtest.h"
@@ -79,6 +81,117 @@ TEST(ExtractBfPipelineTest, ExtractBfPipelineConfigFromRandomBytesFail) {
   EXPECT_FALSE(ExtractBfPipelineConfig(p4_config, &extracted_bf_config).ok());
 }
 
+// Tables 1 and 2 are unchanged, 3 is removed, 4 has a changed match field, 5
+// uses an action with a changed parameter and 6 uses an action profile.
+static constexpr char old_p4info_str[] = R"pb(
+  tables {
+    preamble { id: 1 name: "table1" }
+    match_fields { id: 1 name: "field1" bitwidth: 9 match_type: EXACT }
+    action_refs { id: 101 }
+    direct_resource_ids: 301
+  }
+  tables {
+    preamble { id: 2 name: "table2" }
+    match_fields { id: 1 name: "field1" bitwidth: 32 match_type: LPM }
+    action_refs { id: 101 }
+  }
+  tables {
+    preamble { id: 3 name: "table3" }
+    match_fields { id: 1 name: "field1" bitwidth: 9 match_type: EXACT }
+    action_refs { id: 101 }
+  }
+  tables {
+    preamble { id: 4 name: "table4" }
+    match_fields { id: 1 name: "field1" bitwidth: 9 match_type: EXACT }
+    action_refs { id: 101 }
+  }
+  tables {
+    preamble { id: 5 name: "table5" }
+    match_fields { id: 1 name: "field1" bitwidth: 9 match_type: EXACT }
+    action_refs { id: 102 }
+  }
+  tables {
+    preamble { id: 6 name: "table6" }
+    match_fields { id: 1 name: "field1" bitwidth: 9 match_type: EXACT }
+    action_refs { id: 101 }
+    implementation_id: 401
+  }
+  actions {
+    preamble { id: 101 name: "action1" }
+    params { id: 1 name: "port" bitwidth: 9 }
+  }
+  actions {
+    preamble { id: 102 name: "action2" }
+    params { id: 1 name: "vlan" bitwidth: 12 }
+  }
+)pb";
+
+// Also adds table 7 and a new action to table 2.
+static constexpr char new_p4info_str[] = R"pb(
+  tables {
+    preamble { id: 1 name: "table1" }
+    match_fields { id: 1 name: "field1" bitwidth: 9 match_type: EXACT }
+    action_refs { id: 101 }
+    direct_resource_ids: 301
+  }
+  tables {
+    preamble { id: 2 name: "table2" }
+    match_fields { id: 1 name: "field1" bitwidth: 32 match_type: LPM }
+    action_refs { id: 101 }
+    action_refs { id: 103 }
+  }
+  tables {
+    preamble { id: 4 name: "table4" }
+    match_fields { id: 1 name: "field1" bitwidth: 9 match_type: TERNARY }
+    action_refs { id: 101 }
+  }
+  tables {
+    preamble { id: 5 name: "table5" }
+    match_fields { id: 1 name: "field1" bitwidth: 9 match_type: EXACT }
+    action_refs { id: 102 }
+  }
+  tables {
+    preamble { id: 6 name: "table6" }
+    match_fields { id: 1 name: "field1" bitwidth: 9 match_type: EXACT }
+    action_refs { id: 101 }
+    implementation_id: 401
+  }
+  tables {
+    preamble { id: 7 name: "table7" }
+    match_fields { id: 1 name: "field1" bitwidth: 9 match_type: EXACT }
+    action_refs { id: 101 }
+  }
+  actions {
+    preamble { id: 101 name: "action1" }
+    params { id: 1 name: "port" bitwidth: 9 }
+  }
+  actions {
+    preamble { id: 102 name: "action2" }
+    params { id: 1 name: "vlan" bitwidth: 16 }
+  }
+  actions {
+    preamble { id: 103 name: "action3" }
+  }
+)pb";
+
+TEST(GetTablesWithUnchangedSchemaTest, AddedRemovedAndChangedTables) {
+  ::p4::config::v1::P4Info old_p4info;
+  ::p4::config::v1::P4Info new_p4info;
+  ASSERT_OK(ParseProtoFromString(old_p4info_str, &old_p4info));
+  ASSERT_OK(ParseProtoFromString(new_p4info_str, &new_p4info));
+
+  EXPECT_EQ(std::vector<uint32>({1, 2}),
+            GetTablesWithUnchangedSchema(old_p4info, new_p4info));
+  // Table 2 of the new P4Info references an action unknown to the old one.
+  EXPECT_EQ(std::vector<uint32>({1}),
+            GetTablesWithUnchangedSchema(new_p4info, old_p4info));
+  EXPECT_EQ(std::vector<uint32>({1, 2, 3, 4, 5}),
+            GetTablesWithUnchangedSchema(old_p4info, old_p4info));
+  EXPECT_TRUE(
+      GetTablesWithUnchangedSchema(old_p4info, ::p4::config::v1::P4Info())
+          .empty());
+}
+
 }  // namespace barefoot
 }  // namespace hal
 }  // namespace stratum
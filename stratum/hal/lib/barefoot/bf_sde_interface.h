@@ -4,6 +4,7 @@
 #ifndef STRATUM_HAL_LIB_BAREFOOT_BF_SDE_INTERFACE_H_
 #define STRATUM_HAL_LIB_BAREFOOT_BF_SDE_INTERFACE_H_
 
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -204,6 +205,13 @@ class BfSdeInterface {
   virtual ::util::Status GetPortCounters(int device, int port,
                                          PortCounters* counters) = 0;
 
+  // Get the TM counters of all egress queues of the given ports, keyed by
+  // port. All ports are read in a single pass, which is not interleaved with
+  // a QoS configuration change.
+  virtual ::util::Status GetQueueCounters(
+      int device, const std::vector<int>& ports,
+      std::map<int, std::vector<PortQosCounters>>* counters) = 0;
+
   // Set the auto negotiation policy on a port.
   virtual ::util::Status SetPortAutonegPolicy(int device, int port,
                                               TriState autoneg) = 0;
@@ -305,6 +313,30 @@ class BfSdeInterface {
       uint32 group_id, std::vector<uint32>* group_ids,
       std::vector<std::vector<uint32>>* mc_node_ids) = 0;
 
+  // Inserts a multicast LAG with the given member ports ($pre.lag table).
+  // Multicast nodes which replicate to the LAG send one copy to a member port
+  // picked by the PRE.
+  virtual ::util::Status InsertMulticastLag(
+      int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      uint32 mc_lag_id, const std::vector<uint32>& ports) = 0;
+
+  // Modifies the member ports of a multicast LAG ($pre.lag table).
+  virtual ::util::Status ModifyMulticastLag(
+      int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      uint32 mc_lag_id, const std::vector<uint32>& ports) = 0;
+
+  // Deletes a multicast LAG ($pre.lag table).
+  virtual ::util::Status DeleteMulticastLag(
+      int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      uint32 mc_lag_id) = 0;
+
+  // Sets the multicast forwarding state of a port ($pre.port table). The PRE
+  // does not replicate to a port whose forwarding state is false, in any
+  // multicast group.
+  virtual ::util::Status SetMulticastPortForwardState(
+      int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      uint32 port, bool forward) = 0;
+
   // Inserts a clone session ($mirror.cfg table).
   virtual ::util::Status InsertCloneSession(
       int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
@@ -497,6 +529,12 @@ class BfSdeInterface {
       int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
       uint32 table_id, absl::Duration timeout) = 0;
 
+  // Returns the maximum number of entries the SDE can hold in a given BfRt
+  // table.
+  virtual ::util::StatusOr<uint32> GetTableSize(
+      int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      uint32 table_id) = 0;
+
   // Returns the equivalent BfRt ID for the given P4RT ID.
   virtual ::util::StatusOr<uint32> GetBfRtId(uint32 p4info_id) const = 0;
 
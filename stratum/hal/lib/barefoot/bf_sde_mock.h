@@ -4,6 +4,7 @@
 #ifndef STRATUM_HAL_LIB_BAREFOOT_BF_SDE_MOCK_H_
 #define STRATUM_HAL_LIB_BAREFOOT_BF_SDE_MOCK_H_
 
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -78,6 +79,10 @@ class BfSdeMock : public BfSdeInterface {
   MOCK_METHOD2(GetPortState, ::util::StatusOr<PortState>(int device, int port));
   MOCK_METHOD3(GetPortCounters,
                ::util::Status(int device, int port, PortCounters* counters));
+  MOCK_METHOD3(
+      GetQueueCounters,
+      ::util::Status(int device, const std::vector<int>& ports,
+                     std::map<int, std::vector<PortQosCounters>>* counters));
   MOCK_METHOD1(
       RegisterPortStatusEventWriter,
       ::util::Status(std::unique_ptr<ChannelWriter<PortStatusEvent>> writer));
@@ -156,6 +161,26 @@ class BfSdeMock : public BfSdeInterface {
                      std::shared_ptr<BfSdeInterface::SessionInterface> session,
                      uint32 group_id, std::vector<uint32>* group_ids,
                      std::vector<std::vector<uint32>>* mc_node_ids));
+  MOCK_METHOD4(
+      InsertMulticastLag,
+      ::util::Status(int device,
+                     std::shared_ptr<BfSdeInterface::SessionInterface> session,
+                     uint32 mc_lag_id, const std::vector<uint32>& ports));
+  MOCK_METHOD4(
+      ModifyMulticastLag,
+      ::util::Status(int device,
+                     std::shared_ptr<BfSdeInterface::SessionInterface> session,
+                     uint32 mc_lag_id, const std::vector<uint32>& ports));
+  MOCK_METHOD3(
+      DeleteMulticastLag,
+      ::util::Status(int device,
+                     std::shared_ptr<BfSdeInterface::SessionInterface> session,
+                     uint32 mc_lag_id));
+  MOCK_METHOD4(
+      SetMulticastPortForwardState,
+      ::util::Status(int device,
+                     std::shared_ptr<BfSdeInterface::SessionInterface> session,
+                     uint32 port, bool forward));
   MOCK_METHOD7(
       InsertCloneSession,
       ::util::Status(int device,
@@ -337,6 +362,11 @@ class BfSdeMock : public BfSdeInterface {
       ::util::Status(int device,
                      std::shared_ptr<BfSdeInterface::SessionInterface> session,
                      uint32 table_id, absl::Duration timeout));
+  MOCK_METHOD3(
+      GetTableSize,
+      ::util::StatusOr<uint32>(
+          int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+          uint32 table_id));
   MOCK_CONST_METHOD1(GetBfRtId, ::util::StatusOr<uint32>(uint32 p4info_id));
   MOCK_CONST_METHOD1(GetP4InfoId, ::util::StatusOr<uint32>(uint32 bfrt_id));
   MOCK_CONST_METHOD1(GetActionSelectorBfRtId,
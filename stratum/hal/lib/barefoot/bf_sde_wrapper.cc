@@ -45,6 +45,11 @@ int switch_pci_sysfs_str_get(char* name, size_t name_size);
 
 DEFINE_string(bfrt_sde_config_dir, "/var/run/stratum/bfrt_config",
               "The dir used by the SDE to load the device configuration.");
+DEFINE_int32(bfrt_hw_sync_freshness_ms, 0,
+             "Counter and register syncs of a table completed within this "
+             "many milliseconds are reused by later reads of the same table "
+             "instead of syncing again. Concurrent reads always share a "
+             "single sync.");
 DEFINE_bool(incompatible_enable_bfrt_legacy_bytestring_responses, false,
             "Enables the legacy padded byte string format in P4Runtime "
             "responses for Stratum-bfrt. The strings are left unchanged from "
@@ -1056,7 +1061,10 @@ BfSdeWrapper* BfSdeWrapper::singleton_ = nullptr;
 ABSL_CONST_INIT absl::Mutex BfSdeWrapper::init_lock_(absl::kConstInit);
 
 BfSdeWrapper::BfSdeWrapper()
-    : port_status_event_writer_(nullptr), device_to_ppg_handles_() {}
+    : port_status_event_writer_(nullptr),
+      device_to_ppg_handles_(),
+      sync_coordinator_(BfrtSyncCoordinator::CreateInstance(
+          absl::Milliseconds(FLAGS_bfrt_hw_sync_freshness_ms))) {}
 
 ::util::StatusOr<PortState> BfSdeWrapper::GetPortState(int device, int port) {
   int state;
@@ -1095,6 +1103,45 @@ BfSdeWrapper::BfSdeWrapper()
   return ::util::OkStatus();
 }
 
+::util::Status BfSdeWrapper::GetQueueCounters(
+    int device, const std::vector<int>& ports,
+    std::map<int, std::vector<PortQosCounters>>* counters) {
+  RET_CHECK(counters);
+  // Upper bound of the egress queues of a port on all Tofino generations.
+  constexpr int kMaxQueuesPerPort = 128;
+  // Hold the lock across all ports, to not race with ConfigureQos.
+  absl::ReaderMutexLock l(&data_lock_);
+  counters->clear();
+  for (const int port : ports) {
+    const bf_dev_port_t dev_port = static_cast<bf_dev_port_t>(port);
+    const bf_dev_pipe_t pipe = DEV_PORT_TO_PIPE(dev_port);
+    uint8_t queue_count = 0;
+    uint8_t queue_mapping[kMaxQueuesPerPort] = {};
+    RETURN_IF_BFRT_ERROR(bf_tm_port_q_mapping_get(
+        static_cast<bf_dev_id_t>(device), dev_port, &queue_count,
+        queue_mapping));
+    auto& port_counters = (*counters)[port];
+    for (int queue = 0; queue < queue_count; ++queue) {
+      uint64_t drop_pkts = 0;
+      RETURN_IF_BFRT_ERROR(
+          bf_tm_q_drop_get(device, pipe, dev_port, queue, &drop_pkts));
+      uint32_t usage_cells = 0;
+      uint32_t watermark_cells = 0;
+      RETURN_IF_BFRT_ERROR(bf_tm_q_usage_get(
+          device, pipe, dev_port, queue, &usage_cells, &watermark_cells));
+      PortQosCounters queue_counters;
+      queue_counters.set_queue_id(queue);
+      queue_counters.set_out_octets(0);  // stat not available
+      queue_counters.set_out_pkts(0);    // stat not available
+      queue_counters.set_out_dropped_pkts(drop_pkts);
+      queue_counters.set_watermark_cells(watermark_cells);
+      port_counters.push_back(queue_counters);
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
 ::util::Status BfSdeWrapper::OnPortStatusEvent(int device, int port, bool up,
                                                absl::Time timestamp) {
   // Create PortStatusEvent message.
@@ -1868,6 +1915,8 @@ std::string BfSdeWrapper::GetSdeVersion() const {
   bfrt_id_mapper_ = BfrtIdMapper::CreateInstance();
   RETURN_IF_ERROR(
       bfrt_id_mapper_->PushForwardingPipelineConfig(device_config, bfrt_info_));
+  // Table IDs may refer to different tables in the new pipeline.
+  sync_coordinator_->Reset();
 
   return ::util::OkStatus();
 }
@@ -2407,6 +2456,102 @@ namespace {
   return ::util::OkStatus();
 }
 
+::util::Status BfSdeWrapper::WriteMulticastLag(
+    int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    uint32 mc_lag_id, const std::vector<uint32>& ports, bool insert) {
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+
+  const bfrt::BfRtTable* table;  // PRE LAG table.
+  RETURN_IF_BFRT_ERROR(bfrt_info_->bfrtTableFromNameGet(kPreLagTable, &table));
+  std::unique_ptr<bfrt::BfRtTableKey> table_key;
+  std::unique_ptr<bfrt::BfRtTableData> table_data;
+  RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
+  RETURN_IF_BFRT_ERROR(table->dataAllocate(&table_data));
+
+  // Key: $MULTICAST_LAG_ID
+  RETURN_IF_ERROR(SetField(table_key.get(), kMcNodeLagId, mc_lag_id));
+  // Data: $DEV_PORT
+  RETURN_IF_ERROR(SetField(table_data.get(), kMcNodeDevPort, ports));
+
+  auto bf_dev_tgt = GetDeviceTarget(device);
+  if (insert) {
+    RETURN_IF_BFRT_ERROR(table->tableEntryAdd(
+        *real_session->bfrt_session_, bf_dev_tgt, *table_key, *table_data));
+  } else {
+    RETURN_IF_BFRT_ERROR(table->tableEntryMod(
+        *real_session->bfrt_session_, bf_dev_tgt, *table_key, *table_data));
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status BfSdeWrapper::InsertMulticastLag(
+    int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    uint32 mc_lag_id, const std::vector<uint32>& ports) {
+  ::absl::ReaderMutexLock l(&data_lock_);
+  return WriteMulticastLag(device, session, mc_lag_id, ports, true);
+}
+
+::util::Status BfSdeWrapper::ModifyMulticastLag(
+    int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    uint32 mc_lag_id, const std::vector<uint32>& ports) {
+  ::absl::ReaderMutexLock l(&data_lock_);
+  return WriteMulticastLag(device, session, mc_lag_id, ports, false);
+}
+
+::util::Status BfSdeWrapper::DeleteMulticastLag(
+    int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    uint32 mc_lag_id) {
+  ::absl::ReaderMutexLock l(&data_lock_);
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+
+  auto bf_dev_tgt = GetDeviceTarget(device);
+  const bfrt::BfRtTable* table;  // PRE LAG table.
+  RETURN_IF_BFRT_ERROR(bfrt_info_->bfrtTableFromNameGet(kPreLagTable, &table));
+  std::unique_ptr<bfrt::BfRtTableKey> table_key;
+  RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
+  // Key: $MULTICAST_LAG_ID
+  RETURN_IF_ERROR(SetField(table_key.get(), kMcNodeLagId, mc_lag_id));
+  RETURN_IF_BFRT_ERROR(table->tableEntryDel(*real_session->bfrt_session_,
+                                            bf_dev_tgt, *table_key));
+
+  return ::util::OkStatus();
+}
+
+::util::Status BfSdeWrapper::SetMulticastPortForwardState(
+    int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    uint32 port, bool forward) {
+  ::absl::ReaderMutexLock l(&data_lock_);
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+
+  const bfrt::BfRtTable* table;  // PRE port table.
+  RETURN_IF_BFRT_ERROR(bfrt_info_->bfrtTableFromNameGet(kPrePortTable, &table));
+  std::unique_ptr<bfrt::BfRtTableKey> table_key;
+  std::unique_ptr<bfrt::BfRtTableData> table_data;
+  RETURN_IF_BFRT_ERROR(table->keyAllocate(&table_key));
+  // Only the forwarding state is written, the other port attributes are left
+  // unchanged.
+  bf_rt_id_t field_id;
+  RETURN_IF_BFRT_ERROR(table->dataFieldIdGet(kMcPortForwardState, &field_id));
+  RETURN_IF_BFRT_ERROR(table->dataAllocate({field_id}, &table_data));
+
+  // Key: $DEV_PORT
+  RETURN_IF_ERROR(SetField(table_key.get(), kMcNodeDevPort, port));
+  // Data: $FORWARD_STATE
+  RETURN_IF_ERROR(
+      SetFieldBool(table_data.get(), kMcPortForwardState, forward));
+
+  // Entries of the port table always exist, they can only be modified.
+  auto bf_dev_tgt = GetDeviceTarget(device);
+  RETURN_IF_BFRT_ERROR(table->tableEntryMod(
+      *real_session->bfrt_session_, bf_dev_tgt, *table_key, *table_data));
+
+  return ::util::OkStatus();
+}
+
 ::util::Status BfSdeWrapper::WriteCloneSession(
     int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
     uint32 session_id, int egress_port, int egress_queue, int cos,
@@ -3569,6 +3714,23 @@ namespace {
   return DoSynchronizeCounters(device, session, table_id, timeout);
 }
 
+::util::StatusOr<uint32> BfSdeWrapper::GetTableSize(
+    int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    uint32 table_id) {
+  ::absl::ReaderMutexLock l(&data_lock_);
+  auto real_session = std::dynamic_pointer_cast<Session>(session);
+  RET_CHECK(real_session);
+  const bfrt::BfRtTable* table;
+  RETURN_IF_BFRT_ERROR(bfrt_info_->bfrtTableFromIdGet(table_id, &table));
+
+  auto bf_dev_tgt = GetDeviceTarget(device);
+  size_t table_size;
+  RETURN_IF_BFRT_ERROR(table->tableSizeGet(*real_session->bfrt_session_,
+                                           bf_dev_tgt, &table_size));
+
+  return static_cast<uint32>(table_size);
+}
+
 ::util::Status BfSdeWrapper::DoSynchronizeCounters(
     int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
     uint32 table_id, absl::Duration timeout) {
@@ -3582,7 +3744,10 @@ namespace {
   // Sync table counter
   std::set<bfrt::TableOperationsType> supported_ops;
   RETURN_IF_BFRT_ERROR(table->tableOperationsSupported(&supported_ops));
-  if (supported_ops.count(bfrt::TableOperationsType::COUNTER_SYNC)) {
+  if (!supported_ops.count(bfrt::TableOperationsType::COUNTER_SYNC)) {
+    return ::util::OkStatus();
+  }
+  auto sync_counters = [&]() -> ::util::Status {
     auto sync_notifier = std::make_shared<absl::Notification>();
     std::weak_ptr<absl::Notification> weak_ref(sync_notifier);
     std::unique_ptr<bfrt::BfRtTableOperations> table_op;
@@ -3607,9 +3772,11 @@ namespace {
              << "Timeout while syncing (indirect) table counters of table "
              << table_id << ".";
     }
-  }
-
-  return ::util::OkStatus();
+    return ::util::OkStatus();
+  };
+  // Concurrent readers of the same table share a single sync.
+  return sync_coordinator_->Synchronize(
+      device, table_id, BfrtSyncCoordinator::kCounters, sync_counters);
 }
 
 ::util::Status BfSdeWrapper::SynchronizeRegisters(
@@ -3625,7 +3792,10 @@ namespace {
   // Sync table registers.
   std::set<bfrt::TableOperationsType> supported_ops;
   RETURN_IF_BFRT_ERROR(table->tableOperationsSupported(&supported_ops));
-  if (supported_ops.count(bfrt::TableOperationsType::REGISTER_SYNC)) {
+  if (!supported_ops.count(bfrt::TableOperationsType::REGISTER_SYNC)) {
+    return ::util::OkStatus();
+  }
+  auto sync_registers = [&]() -> ::util::Status {
     auto sync_notifier = std::make_shared<absl::Notification>();
     std::weak_ptr<absl::Notification> weak_ref(sync_notifier);
     std::unique_ptr<bfrt::BfRtTableOperations> table_op;
@@ -3650,9 +3820,11 @@ namespace {
              << "Timeout while syncing (indirect) table registers of table "
              << table_id << ".";
     }
-  }
-
-  return ::util::OkStatus();
+    return ::util::OkStatus();
+  };
+  // Concurrent readers of the same table share a single sync.
+  return sync_coordinator_->Synchronize(
+      device, table_id, BfrtSyncCoordinator::kRegisters, sync_registers);
 }
 
 BfSdeWrapper* BfSdeWrapper::CreateSingleton() {
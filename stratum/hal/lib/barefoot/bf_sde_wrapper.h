@@ -4,6 +4,7 @@
 #ifndef STRATUM_HAL_LIB_BAREFOOT_BF_SDE_WRAPPER_H_
 #define STRATUM_HAL_LIB_BAREFOOT_BF_SDE_WRAPPER_H_
 
+#include <map>
 #include <memory>
 #include <string>
 #include <utility>
@@ -21,6 +22,7 @@
 #include "stratum/glue/status/statusor.h"
 #include "stratum/hal/lib/barefoot/bf_sde_interface.h"
 #include "stratum/hal/lib/barefoot/bfrt_id_mapper.h"
+#include "stratum/hal/lib/barefoot/bfrt_sync_coordinator.h"
 #include "stratum/hal/lib/barefoot/macros.h"
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/lib/channel/channel.h"
@@ -154,6 +156,10 @@ class BfSdeWrapper : public BfSdeInterface {
   ::util::StatusOr<PortState> GetPortState(int device, int port) override;
   ::util::Status GetPortCounters(int device, int port,
                                  PortCounters* counters) override;
+  ::util::Status GetQueueCounters(
+      int device, const std::vector<int>& ports,
+      std::map<int, std::vector<PortQosCounters>>* counters) override
+      LOCKS_EXCLUDED(data_lock_);
   ::util::Status RegisterPortStatusEventWriter(
       std::unique_ptr<ChannelWriter<PortStatusEvent>> writer) override
       LOCKS_EXCLUDED(port_status_event_writer_lock_);
@@ -224,6 +230,20 @@ class BfSdeWrapper : public BfSdeInterface {
       uint32 group_id, std::vector<uint32>* group_ids,
       std::vector<std::vector<uint32>>* mc_node_ids) override
       LOCKS_EXCLUDED(data_lock_);
+  ::util::Status InsertMulticastLag(
+      int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      uint32 mc_lag_id, const std::vector<uint32>& ports) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status ModifyMulticastLag(
+      int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      uint32 mc_lag_id, const std::vector<uint32>& ports) override
+      LOCKS_EXCLUDED(data_lock_);
+  ::util::Status DeleteMulticastLag(
+      int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      uint32 mc_lag_id) override LOCKS_EXCLUDED(data_lock_);
+  ::util::Status SetMulticastPortForwardState(
+      int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      uint32 port, bool forward) override LOCKS_EXCLUDED(data_lock_);
   ::util::Status InsertCloneSession(
       int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
       uint32 session_id, int egress_port, int egress_queue, int cos,
@@ -315,6 +335,9 @@ class BfSdeWrapper : public BfSdeInterface {
       int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
       uint32 table_id, absl::Duration timeout) override
       LOCKS_EXCLUDED(data_lock_);
+  ::util::StatusOr<uint32> GetTableSize(
+      int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      uint32 table_id) override LOCKS_EXCLUDED(data_lock_);
   ::util::Status InsertTableEntry(
       int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
       uint32 table_id, const TableKeyInterface* table_key,
@@ -433,6 +456,12 @@ class BfSdeWrapper : public BfSdeInterface {
       uint32 group_id, const std::vector<uint32>& mc_node_ids, bool insert)
       SHARED_LOCKS_REQUIRED(data_lock_);
 
+  // Common code for multicast LAG handling.
+  ::util::Status WriteMulticastLag(
+      int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      uint32 mc_lag_id, const std::vector<uint32>& ports, bool insert)
+      SHARED_LOCKS_REQUIRED(data_lock_);
+
   // Common code for clone session handling.
   ::util::Status WriteCloneSession(
       int device, std::shared_ptr<BfSdeInterface::SessionInterface> session,
@@ -501,6 +530,10 @@ class BfSdeWrapper : public BfSdeInterface {
 
   // Pointer to the bfrt device manager. Not owned by this class.
   bfrt::BfRtDevMgr* bfrt_device_manager_ GUARDED_BY(data_lock_);
+
+  // Coordinator coalescing the counter and register syncs of concurrent
+  // readers. Internally synchronized.
+  const std::unique_ptr<BfrtSyncCoordinator> sync_coordinator_;
 };
 
 }  // namespace barefoot
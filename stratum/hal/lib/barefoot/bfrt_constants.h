@@ -24,8 +24,11 @@ constexpr char kMcNodeL1XidValid[] = "$MULTICAST_NODE_L1_XID_VALID";
 constexpr char kMcNodeLagId[] = "$MULTICAST_LAG_ID";
 constexpr char kMcReplicationId[] = "$MULTICAST_RID";
 constexpr char kMgid[] = "$MGID";
+constexpr char kMcPortForwardState[] = "$FORWARD_STATE";
+constexpr char kPreLagTable[] = "$pre.lag";
 constexpr char kPreMgidTable[] = "$pre.mgid";
 constexpr char kPreNodeTable[] = "$pre.node";
+constexpr char kPrePortTable[] = "$pre.port";
 constexpr char kRegisterIndex[] = "$REGISTER_INDEX";
 constexpr char kMeterIndex[] = "$METER_INDEX";
 constexpr char kMeterCirKbps[] = "$METER_SPEC_CIR_KBPS";
@@ -48,6 +51,7 @@ constexpr char kActionMemberStatus[] = "$ACTION_MEMBER_STATUS";
 // TNA specific limits
 constexpr uint16 kMaxCloneSessionId = 1015;
 constexpr uint16 kMaxMulticastGroupId = 65535;
+constexpr uint32 kMaxMulticastLagId = 254;
 constexpr uint32 kMaxMulticastNodeId = 0x1000000;
 constexpr uint64 kMaxPriority = (1u << 24) - 1;
 
@@ -5,11 +5,14 @@
 
 #include <unistd.h>
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <utility>
 
 #include "absl/memory/memory.h"
+#include "gflags/gflags.h"
+#include "google/protobuf/arena.h"
 #include "stratum/glue/status/status_macros.h"
 #include "stratum/hal/lib/barefoot/bf_pipeline_utils.h"
 #include "stratum/hal/lib/barefoot/bf_sde_interface.h"
@@ -20,10 +23,57 @@
 #include "stratum/lib/utils.h"
 #include "stratum/public/proto/error.pb.h"
 
+DEFINE_bool(bfrt_migrate_table_entries_on_pipeline_push, false,
+            "Preserve the table entries across forwarding pipeline pushes. The "
+            "entries of the tables whose match fields and actions are "
+            "unchanged in the new P4Info are read before the push and "
+            "written back afterwards. Entries of other tables, action profile "
+            "members and groups, PRE entries, default actions and counter "
+            "values are not migrated.");
+DEFINE_int32(bfrt_table_entry_migration_batch_size, 1000,
+             "Number of table entries written back per batched session when "
+             "migrating the table entries across a pipeline push.");
+
 namespace stratum {
 namespace hal {
 namespace barefoot {
 
+namespace {
+
+// Size of the first block of the per-request arenas. Large enough for the
+// temporaries of a few hundred table entries, so that most requests need a
+// single allocation. Nothing is allocated until the arena is first used.
+constexpr size_t kRequestArenaStartBlockSize = 64 * 1024;
+
+::google::protobuf::ArenaOptions RequestArenaOptions() {
+  ::google::protobuf::ArenaOptions options;
+  options.start_block_size = kRequestArenaStartBlockSize;
+  return options;
+}
+
+// Max number of failed entries logged individually on a migration.
+constexpr size_t kMaxLoggedMigrationFailures = 10;
+
+// A writer collecting the table entries of read responses.
+class TableEntryCollector : public WriterInterface<::p4::v1::ReadResponse> {
+ public:
+  explicit TableEntryCollector(std::vector<::p4::v1::TableEntry>* entries)
+      : entries_(entries) {}
+
+  bool Write(const ::p4::v1::ReadResponse& resp) override {
+    for (const auto& entity : resp.entities()) {
+      if (entity.has_table_entry()) entries_->push_back(entity.table_entry());
+    }
+    return true;
+  }
+
+ private:
+  // Not owned by this class.
+  std::vector<::p4::v1::TableEntry>* entries_;
+};
+
+}  // namespace
+
 BfrtNode::BfrtNode(BfrtTableManager* bfrt_table_manager,
                    BfrtPacketioManager* bfrt_packetio_manager,
                    BfrtPreManager* bfrt_pre_manager,
@@ -74,10 +124,11 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
                                            uint64 node_id) {
   absl::WriterMutexLock l(&lock_);
   node_id_ = node_id;
-  // RETURN_IF_ERROR(bfrt_table_manager_->PushChassisConfig(config, node_id));
+  RETURN_IF_ERROR(bfrt_table_manager_->PushChassisConfig(config, node_id));
   RETURN_IF_ERROR(bfrt_packetio_manager_->PushChassisConfig(config, node_id));
   RETURN_IF_ERROR(
       bfrt_p4runtime_translator_->PushChassisConfig(config, node_id));
+  RETURN_IF_ERROR(bfrt_pre_manager_->PushChassisConfig(config, node_id));
   initialized_ = true;
 
   return ::util::OkStatus();
@@ -133,12 +184,26 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
   RET_CHECK(bfrt_config_.programs_size() > 0);
+  const auto& p4info = bfrt_config_.programs(0).p4info();
+
+  // Calling AddDevice() below wipes all the table entries. The ones to be
+  // migrated are read beforehand, while the managers still hold the old
+  // pipeline.
+  const bool migrate_table_entries =
+      FLAGS_bfrt_migrate_table_entries_on_pipeline_push &&
+      pipeline_initialized_;
+  TableEntryMigrationReport migration_report;
+  std::vector<::p4::v1::TableEntry> table_entries;
+  if (migrate_table_entries) {
+    migration_report.table_ids =
+        GetTablesWithUnchangedSchema(committed_p4info_, p4info);
+    table_entries = SnapshotTableEntries(&migration_report);
+  }
 
   // Calling AddDevice() overwrites any previous pipeline.
   RETURN_IF_ERROR(bf_sde_interface_->AddDevice(device_id_, bfrt_config_));
 
   // Push pipeline config to the managers.
-  const auto& p4info = bfrt_config_.programs(0).p4info();
   RETURN_IF_ERROR(
       bfrt_p4runtime_translator_->PushForwardingPipelineConfig(p4info));
   RETURN_IF_ERROR(
@@ -150,9 +215,103 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
   RETURN_IF_ERROR(
       bfrt_counter_manager_->PushForwardingPipelineConfig(bfrt_config_));
   pipeline_initialized_ = true;
+  committed_p4info_ = p4info;
+  write_validator_ = absl::make_unique<P4WriteValidator>(p4info);
+
+  if (migrate_table_entries) {
+    ReplayTableEntries(table_entries, &migration_report);
+    LOG(INFO) << "Migrated " << migration_report.num_migrated_entries << " of "
+              << table_entries.size() << " table entries from "
+              << migration_report.table_ids.size()
+              << " tables to the new pipeline on node " << node_id_ << ". "
+              << migration_report.failed_entries.size()
+              << " entries could not be written back and "
+              << migration_report.unreadable_table_ids.size()
+              << " tables could not be read.";
+  }
+  migration_report_ = std::move(migration_report);
+
+  return ::util::OkStatus();
+}
+
+std::vector<::p4::v1::TableEntry> BfrtNode::SnapshotTableEntries(
+    TableEntryMigrationReport* report) {
+  std::vector<::p4::v1::TableEntry> entries;
+  auto session = bf_sde_interface_->CreateSession();
+  if (!session.ok()) {
+    LOG(ERROR) << "Failed to create a session to read the table entries to "
+               << "migrate: " << session.status();
+    report->unreadable_table_ids = report->table_ids;
+    return entries;
+  }
+  TableEntryCollector collector(&entries);
+  for (uint32 table_id : report->table_ids) {
+    ::p4::v1::TableEntry wildcard_entry;
+    wildcard_entry.set_table_id(table_id);
+    ::google::protobuf::Arena arena(RequestArenaOptions());
+    const size_t num_entries = entries.size();
+    ::util::Status status = bfrt_table_manager_->ReadTableEntry(
+        session.ValueOrDie(), wildcard_entry, &collector, &arena);
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to read the entries of table " << table_id
+                 << ", they will not be migrated: " << status;
+      entries.resize(num_entries);
+      report->unreadable_table_ids.push_back(table_id);
+    }
+  }
+
+  return entries;
+}
+
+void BfrtNode::ReplayTableEntries(
+    const std::vector<::p4::v1::TableEntry>& entries,
+    TableEntryMigrationReport* report) {
+  const size_t batch_size =
+      std::max(1, FLAGS_bfrt_table_entry_migration_batch_size);
+  for (size_t begin = 0; begin < entries.size(); begin += batch_size) {
+    const size_t end = std::min(entries.size(), begin + batch_size);
+    std::vector<::util::Status> results;
+    ::util::Status batch_status =
+        WriteTableEntryBatch(entries, begin, end, &results);
+    for (size_t i = begin; i < end; ++i) {
+      // A failed batch fails all its entries, as none is known to be written.
+      ::util::Status status =
+          batch_status.ok() ? results[i - begin] : batch_status;
+      if (status.ok()) {
+        ++report->num_migrated_entries;
+        continue;
+      }
+      if (report->failed_entries.size() < kMaxLoggedMigrationFailures) {
+        LOG(WARNING) << "Failed to migrate table entry "
+                     << entries[i].ShortDebugString() << ": " << status;
+      }
+      report->failed_entries.emplace_back(entries[i], status);
+    }
+  }
+}
+
+::util::Status BfrtNode::WriteTableEntryBatch(
+    const std::vector<::p4::v1::TableEntry>& entries, size_t begin,
+    size_t end, std::vector<::util::Status>* results) {
+  results->clear();
+  ::google::protobuf::Arena arena(RequestArenaOptions());
+  ASSIGN_OR_RETURN(auto session, bf_sde_interface_->CreateSession());
+  RETURN_IF_ERROR(session->BeginBatch());
+  for (size_t i = begin; i < end; ++i) {
+    results->push_back(bfrt_table_manager_->WriteTableEntry(
+        session, ::p4::v1::Update::INSERT, entries[i], &arena));
+  }
+  RETURN_IF_ERROR(session->EndBatch());
+
   return ::util::OkStatus();
 }
 
+BfrtNode::TableEntryMigrationReport BfrtNode::GetTableEntryMigrationReport()
+    const {
+  absl::ReaderMutexLock l(&lock_);
+  return migration_report_;
+}
+
 ::util::Status BfrtNode::VerifyForwardingPipelineConfig(
     const ::p4::v1::ForwardingPipelineConfig& config) const {
   RET_CHECK(config.has_p4info()) << "Missing P4 info";
@@ -196,15 +355,35 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
 
+  // The temporaries of the whole request (e.g. translated entries) are
+  // allocated on a single arena and freed at once when the request is done.
+  ::google::protobuf::Arena arena(RequestArenaOptions());
   bool success = true;
+  // All updates are validated before any SDE call, so that invalid updates
+  // neither open a session nor touch the device.
+  const size_t num_results = results->size();
+  bool any_valid = false;
+  for (const auto& update : req.updates()) {
+    ::util::Status status = write_validator_->ValidateUpdate(update);
+    success &= status.ok();
+    any_valid |= status.ok();
+    results->push_back(status);
+  }
+  if (!success && !any_valid) {
+    return MAKE_ERROR(ERR_AT_LEAST_ONE_OPER_FAILED)
+           << "One or more write operations failed.";
+  }
+
   ASSIGN_OR_RETURN(auto session, bf_sde_interface_->CreateSession());
   RETURN_IF_ERROR(session->BeginBatch());
-  for (const auto& update : req.updates()) {
-    ::util::Status status = ::util::OkStatus();
+  for (int i = 0; i < req.updates_size(); ++i) {
+    ::util::Status& status = (*results)[num_results + i];
+    if (!status.ok()) continue;
+    const auto& update = req.updates(i);
     switch (update.entity().entity_case()) {
       case ::p4::v1::Entity::kTableEntry:
         status = bfrt_table_manager_->WriteTableEntry(
-            session, update.type(), update.entity().table_entry());
+            session, update.type(), update.entity().table_entry(), &arena);
         break;
       case ::p4::v1::Entity::kExternEntry:
         status = WriteExternEntry(session, update.type(),
@@ -250,7 +429,6 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
         break;
     }
     success &= status.ok();
-    results->push_back(status);
   }
   RETURN_IF_ERROR(session->EndBatch());
 
@@ -277,14 +455,18 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
   if (!initialized_ || !pipeline_initialized_) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
-  ::p4::v1::ReadResponse resp;
+  // Like for writes, the responses and temporaries of the whole request are
+  // allocated on a single arena.
+  ::google::protobuf::Arena arena(RequestArenaOptions());
+  auto* resp =
+      ::google::protobuf::Arena::CreateMessage<::p4::v1::ReadResponse>(&arena);
   bool success = true;
   ASSIGN_OR_RETURN(auto session, bf_sde_interface_->CreateSession());
   for (const auto& entity : req.entities()) {
     switch (entity.entity_case()) {
       case ::p4::v1::Entity::kTableEntry: {
         auto status = bfrt_table_manager_->ReadTableEntry(
-            session, entity.table_entry(), writer);
+            session, entity.table_entry(), writer, &arena);
         success &= status.ok();
         details->push_back(status);
         break;
@@ -324,7 +506,7 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
           details->push_back(status.status());
           break;
         }
-        resp.add_entities()->mutable_direct_counter_entry()->CopyFrom(
+        resp->add_entities()->mutable_direct_counter_entry()->CopyFrom(
             status.ValueOrDie());
         break;
       }
@@ -361,7 +543,7 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
       }
     }
   }
-  RET_CHECK(writer->Write(resp)) << "Write to stream channel failed.";
+  RET_CHECK(writer->Write(*resp)) << "Write to stream channel failed.";
   if (!success) {
     return MAKE_ERROR(ERR_AT_LEAST_ONE_OPER_FAILED)
            << "One or more read operations failed.";
@@ -411,6 +593,31 @@ std::unique_ptr<BfrtNode> BfrtNode::CreateInstance(
   }
 }
 
+::util::Status BfrtNode::UpdatePortState(uint32 port_id,
+                                        PortState new_state) {
+  // The managers protect their own state. Reacting to port events must not
+  // wait for the node lock, which is held exclusively for whole write batches.
+  ::util::Status status = ::util::OkStatus();
+  APPEND_STATUS_IF_ERROR(
+      status, bfrt_table_manager_->UpdatePortState(port_id, new_state));
+  APPEND_STATUS_IF_ERROR(
+      status, bfrt_pre_manager_->UpdatePortState(port_id, new_state));
+  return status;
+}
+
+::util::Status BfrtNode::RegisterEventNotifyWriter(
+    const std::shared_ptr<WriterInterface<GnmiEventPtr>>& writer) {
+  return bfrt_table_manager_->RegisterEventNotifyWriter(writer);
+}
+
+::util::Status BfrtNode::UnregisterEventNotifyWriter() {
+  return bfrt_table_manager_->UnregisterEventNotifyWriter();
+}
+
+TableOccupancy BfrtNode::GetTableOccupancy() const {
+  return bfrt_table_manager_->GetTableOccupancy();
+}
+
 ::util::Status BfrtNode::WriteExternEntry(
     std::shared_ptr<BfSdeInterface::SessionInterface> session,
     const ::p4::v1::Update::Type type, const ::p4::v1::ExternEntry& entry) {
@@ -5,9 +5,11 @@
 #define STRATUM_HAL_LIB_BAREFOOT_BFRT_NODE_H_
 
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include "absl/synchronization/mutex.h"
+#include "p4/config/v1/p4info.pb.h"
 #include "p4/v1/p4runtime.grpc.pb.h"
 #include "p4/v1/p4runtime.pb.h"
 #include "stratum/glue/integral_types.h"
@@ -20,6 +22,7 @@
 #include "stratum/hal/lib/barefoot/bfrt_table_manager.h"
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/hal/lib/common/writer_interface.h"
+#include "stratum/hal/lib/p4/p4_write_validator.h"
 
 namespace stratum {
 namespace hal {
@@ -30,6 +33,23 @@ namespace barefoot {
 // processed and passed through to the BfRt API.
 class BfrtNode {
  public:
+  // Outcome of the migration of the table entries across a pipeline push, see
+  // the bfrt_migrate_table_entries_on_pipeline_push flag.
+  struct TableEntryMigrationReport {
+    // The tables present in both pipelines with an unchanged schema, whose
+    // entries were migrated.
+    std::vector<uint32> table_ids;
+    // The tables (out of table_ids) which could not be read from the old
+    // pipeline. Their entries are lost.
+    std::vector<uint32> unreadable_table_ids;
+    // Number of entries written back to the new pipeline.
+    int num_migrated_entries = 0;
+    // The entries which could not be written back to the new pipeline, with
+    // the reason.
+    std::vector<std::pair<::p4::v1::TableEntry, ::util::Status>>
+        failed_entries;
+  };
+
   virtual ~BfrtNode();
 
   virtual ::util::Status PushChassisConfig(const ChassisConfig& config,
@@ -62,6 +82,22 @@ class BfrtNode {
       LOCKS_EXCLUDED(lock_);
   virtual ::util::Status HandleStreamMessageRequest(
       const ::p4::v1::StreamMessageRequest& req) LOCKS_EXCLUDED(lock_);
+  // Notifies the managers about a change of the operational state of a port.
+  // Does not take the node lock, to not delay data plane failover behind
+  // in-flight P4Runtime writes.
+  virtual ::util::Status UpdatePortState(uint32 port_id, PortState new_state)
+      LOCKS_EXCLUDED(lock_);
+  // Registers a writer for the gNMI events of the node managers.
+  virtual ::util::Status RegisterEventNotifyWriter(
+      const std::shared_ptr<WriterInterface<GnmiEventPtr>>& writer);
+  virtual ::util::Status UnregisterEventNotifyWriter();
+  // Returns the number of entries and the capacity of every table and action
+  // profile in the current pipeline.
+  virtual TableOccupancy GetTableOccupancy() const;
+  // Returns the report of the table entry migration done by the last pipeline
+  // push. Empty if no migration was done.
+  virtual TableEntryMigrationReport GetTableEntryMigrationReport() const
+      LOCKS_EXCLUDED(lock_);
   // Factory function for creating the instance of the class.
   static std::unique_ptr<BfrtNode> CreateInstance(
       BfrtTableManager* bfrt_table_manager,
@@ -102,6 +138,24 @@ class BfrtNode {
       const ::p4::v1::ExternEntry& entry,
       WriterInterface<::p4::v1::ReadResponse>* writer);
 
+  // Reads all the entries of the tables listed in the report, from the current
+  // pipeline. The tables which cannot be read are added to the report.
+  std::vector<::p4::v1::TableEntry> SnapshotTableEntries(
+      TableEntryMigrationReport* report) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Inserts the given entries in the current pipeline, in batched sessions,
+  // and adds the outcome to the report.
+  void ReplayTableEntries(const std::vector<::p4::v1::TableEntry>& entries,
+                          TableEntryMigrationReport* report)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Inserts the entries in [begin, end) in a single batch. Returns the status
+  // of the batch itself, results gets the status of each entry.
+  ::util::Status WriteTableEntryBatch(
+      const std::vector<::p4::v1::TableEntry>& entries, size_t begin,
+      size_t end, std::vector<::util::Status>* results)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
   // Callback registered with DeviceMgr to receive stream messages.
   friend void StreamMessageCb(uint64 node_id,
                               p4::v1::StreamMessageResponse* msg, void* cookie);
@@ -121,6 +175,17 @@ class BfrtNode {
   // Stores pipeline information for this node.
   BfrtDeviceConfig bfrt_config_ GUARDED_BY(lock_);
 
+  // The P4Info of the pipeline currently running on the device, i.e. of the
+  // last committed config. Used to find the table entries to be migrated.
+  ::p4::config::v1::P4Info committed_p4info_ GUARDED_BY(lock_);
+
+  // The table entry migration report of the last pipeline push.
+  TableEntryMigrationReport migration_report_ GUARDED_BY(lock_);
+
+  // Checks the updates of each write request against the committed P4Info
+  // before they reach the managers. Recreated on every pipeline push.
+  std::unique_ptr<P4WriteValidator> write_validator_ GUARDED_BY(lock_);
+
   // Pointer to a BfSdeInterface implementation that wraps all the SDE calls.
   // Not owned by this class.
   BfSdeInterface* bf_sde_interface_ = nullptr;
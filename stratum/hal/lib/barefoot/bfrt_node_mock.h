@@ -42,6 +42,15 @@ class BfrtNodeMock : public BfrtNode {
                                   ::p4::v1::StreamMessageResponse>>& writer));
   MOCK_METHOD1(HandleStreamMessageRequest,
                ::util::Status(const ::p4::v1::StreamMessageRequest& req));
+  MOCK_METHOD2(UpdatePortState,
+               ::util::Status(uint32 port_id, PortState new_state));
+  MOCK_METHOD1(
+      RegisterEventNotifyWriter,
+      ::util::Status(
+          const std::shared_ptr<WriterInterface<GnmiEventPtr>>& writer));
+  MOCK_METHOD0(UnregisterEventNotifyWriter, ::util::Status());
+  MOCK_CONST_METHOD0(GetTableOccupancy, TableOccupancy());
+  MOCK_CONST_METHOD0(GetTableEntryMigrationReport, TableEntryMigrationReport());
 };
 
 }  // namespace barefoot
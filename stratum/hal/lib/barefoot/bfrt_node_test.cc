@@ -8,6 +8,7 @@
 
 #include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
+#include "gflags/gflags.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "stratum/glue/status/canonical_errors.h"
@@ -22,6 +23,9 @@
 #include "stratum/hal/lib/common/writer_mock.h"
 #include "stratum/lib/utils.h"
 
+DECLARE_bool(bfrt_migrate_table_entries_on_pipeline_push);
+DECLARE_int32(bfrt_table_entry_migration_batch_size);
+
 namespace stratum {
 namespace hal {
 namespace barefoot {
@@ -32,6 +36,7 @@ using ::testing::Eq;
 using ::testing::HasSubstr;
 using ::testing::InSequence;
 using ::testing::Invoke;
+using ::testing::NotNull;
 using ::testing::Return;
 using ::testing::WithArgs;
 
@@ -121,18 +126,18 @@ class BfrtNodeTest : public ::testing::Test {
       // EXPECT_CALL(*p4_table_mapper_mock_,
       //             PushChassisConfig(EqualsProto(config), kNodeId))
       //     .WillOnce(Return(::util::OkStatus()));
-      // EXPECT_CALL(*bfrt_table_manager_mock_,
-      //             PushChassisConfig(EqualsProto(config), kNodeId))
-      //     .WillOnce(Return(::util::OkStatus()));
+      EXPECT_CALL(*bfrt_table_manager_mock_,
+                  PushChassisConfig(EqualsProto(config), kNodeId))
+          .WillOnce(Return(::util::OkStatus()));
       EXPECT_CALL(*bfrt_packetio_manager_mock_,
                   PushChassisConfig(EqualsProto(config), kNodeId))
           .WillOnce(Return(::util::OkStatus()));
       EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
                   PushChassisConfig(EqualsProto(config), kNodeId))
           .WillOnce(Return(::util::OkStatus()));
-      // EXPECT_CALL(*bfrt_pre_manager_mock_,
-      //             PushChassisConfig(EqualsProto(config), kNodeId))
-      //     .WillOnce(Return(::util::OkStatus()));
+      EXPECT_CALL(*bfrt_pre_manager_mock_,
+                  PushChassisConfig(EqualsProto(config), kNodeId))
+          .WillOnce(Return(::util::OkStatus()));
       // EXPECT_CALL(*bfrt_counter_manager_mock_,
       //             PushChassisConfig(EqualsProto(config), kNodeId))
       //     .WillOnce(Return(::util::OkStatus()));
@@ -142,8 +147,11 @@ class BfrtNodeTest : public ::testing::Test {
   }
 
   void PushForwardingPipelineConfigWithCheck() {
-    ::p4::v1::ForwardingPipelineConfig config =
-        GetDefaultForwardingPipelineConfig();
+    PushForwardingPipelineConfigWithCheck(GetDefaultForwardingPipelineConfig());
+  }
+
+  void PushForwardingPipelineConfigWithCheck(
+      const ::p4::v1::ForwardingPipelineConfig& config) {
     {
       InSequence sequence;
       // TODO(max): match on passed config
@@ -877,6 +885,142 @@ TEST_F(BfrtNodeTest, PushForwardingPipelineConfigSuccess2) {
 //               DerivedFromStatus(DefaultError()));
 // }
 
+// The entries of the tables with an unchanged schema are preserved across
+// pipeline pushes.
+TEST_F(BfrtNodeTest, PushForwardingPipelineConfigMigratesTableEntries) {
+  ::gflags::FlagSaver flag_saver;
+  FLAGS_bfrt_migrate_table_entries_on_pipeline_push = true;
+  FLAGS_bfrt_table_entry_migration_batch_size = 2;
+  // Besides the unchanged table of the default P4Info, the old pipeline has a
+  // table which is removed and one which is changed by the new pipeline. The
+  // new pipeline also adds a table.
+  constexpr char kOldTablesString[] = R"pb(
+    tables {
+      preamble { id: 33583790 name: "Ingress.control.removed_table" }
+      match_fields { id: 1 name: "field1" bitwidth: 9 match_type: EXACT }
+      action_refs { id: 16794911 }
+    }
+    tables {
+      preamble { id: 33583791 name: "Ingress.control.changed_table" }
+      match_fields { id: 1 name: "field1" bitwidth: 9 match_type: EXACT }
+      action_refs { id: 16794911 }
+    }
+  )pb";
+  constexpr char kNewTablesString[] = R"pb(
+    tables {
+      preamble { id: 33583791 name: "Ingress.control.changed_table" }
+      match_fields { id: 1 name: "field1" bitwidth: 16 match_type: EXACT }
+      action_refs { id: 16794911 }
+    }
+    tables {
+      preamble { id: 33583792 name: "Ingress.control.added_table" }
+      match_fields { id: 1 name: "field1" bitwidth: 9 match_type: EXACT }
+      action_refs { id: 16794911 }
+    }
+  )pb";
+  ::p4::v1::ForwardingPipelineConfig old_config =
+      GetDefaultForwardingPipelineConfig();
+  ::p4::v1::ForwardingPipelineConfig new_config =
+      GetDefaultForwardingPipelineConfig();
+  {
+    ::p4::config::v1::P4Info tables;
+    ASSERT_OK(ParseProtoFromString(kOldTablesString, &tables));
+    old_config.mutable_p4info()->MergeFrom(tables);
+    ASSERT_OK(ParseProtoFromString(kNewTablesString, &tables));
+    new_config.mutable_p4info()->MergeFrom(tables);
+  }
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+  // Nothing to migrate on the first push.
+  EXPECT_CALL(*bfrt_table_manager_mock_, ReadTableEntry(_, _, _, _)).Times(0);
+  ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck(old_config));
+  EXPECT_TRUE(bfrt_node_->GetTableEntryMigrationReport().table_ids.empty());
+  ::testing::Mock::VerifyAndClearExpectations(bfrt_table_manager_mock_.get());
+
+  ::p4::v1::ReadResponse resp;
+  for (int i = 0; i < 3; ++i) {
+    auto* table_entry = resp.add_entities()->mutable_table_entry();
+    table_entry->set_table_id(33583783);
+    auto* match = table_entry->add_match();
+    match->set_field_id(1);
+    match->mutable_exact()->set_value(std::string(1, i));
+  }
+  ::p4::v1::TableEntry wildcard_entry;
+  wildcard_entry.set_table_id(33583783);
+  using SessionPtr = std::shared_ptr<BfSdeInterface::SessionInterface>;
+  SessionPtr read_session_mock = std::make_shared<SessionMock>();
+  auto write_session_mock1 = std::make_shared<SessionMock>();
+  auto write_session_mock2 = std::make_shared<SessionMock>();
+  {
+    InSequence sequence;
+    EXPECT_CALL(*bfrt_table_manager_mock_, VerifyForwardingPipelineConfig(_))
+        .WillOnce(Return(::util::OkStatus()));
+    // Only the unchanged table is read, before the pipeline is replaced.
+    EXPECT_CALL(*bf_sde_mock_, CreateSession())
+        .WillOnce(Return(read_session_mock));
+    EXPECT_CALL(*bfrt_table_manager_mock_,
+                ReadTableEntry(Eq(read_session_mock),
+                               EqualsProto(wildcard_entry), NotNull(),
+                               NotNull()))
+        .WillOnce(
+            DoAll(WithArgs<2>(Invoke(
+                      [&resp](WriterInterface<::p4::v1::ReadResponse>* w) {
+                        w->Write(resp);
+                      })),
+                  Return(::util::OkStatus())));
+    EXPECT_CALL(*bf_sde_mock_, AddDevice(kDeviceId, _))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+                PushForwardingPipelineConfig(EqualsProto(new_config.p4info())))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bfrt_packetio_manager_mock_, PushForwardingPipelineConfig(_))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bfrt_table_manager_mock_, PushForwardingPipelineConfig(_))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bfrt_pre_manager_mock_, PushForwardingPipelineConfig(_))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bfrt_counter_manager_mock_, PushForwardingPipelineConfig(_))
+        .WillOnce(Return(::util::OkStatus()));
+    // The entries are written back in batches of 2.
+    EXPECT_CALL(*bf_sde_mock_, CreateSession())
+        .WillOnce(Return(SessionPtr(write_session_mock1)));
+    EXPECT_CALL(*write_session_mock1, BeginBatch())
+        .WillOnce(Return(::util::OkStatus()));
+    for (int i = 0; i < 2; ++i) {
+      EXPECT_CALL(*bfrt_table_manager_mock_,
+                  WriteTableEntry(Eq(write_session_mock1),
+                                  ::p4::v1::Update::INSERT,
+                                  EqualsProto(resp.entities(i).table_entry()),
+                                  NotNull()))
+          .WillOnce(Return(::util::OkStatus()));
+    }
+    EXPECT_CALL(*write_session_mock1, EndBatch())
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bf_sde_mock_, CreateSession())
+        .WillOnce(Return(SessionPtr(write_session_mock2)));
+    EXPECT_CALL(*write_session_mock2, BeginBatch())
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bfrt_table_manager_mock_,
+                WriteTableEntry(Eq(write_session_mock2),
+                                ::p4::v1::Update::INSERT,
+                                EqualsProto(resp.entities(2).table_entry()),
+                                NotNull()))
+        .WillOnce(Return(DefaultError()));
+    EXPECT_CALL(*write_session_mock2, EndBatch())
+        .WillOnce(Return(::util::OkStatus()));
+  }
+  EXPECT_OK(PushForwardingPipelineConfig(new_config));
+
+  auto report = bfrt_node_->GetTableEntryMigrationReport();
+  EXPECT_EQ(std::vector<uint32>({33583783}), report.table_ids);
+  EXPECT_TRUE(report.unreadable_table_ids.empty());
+  EXPECT_EQ(2, report.num_migrated_entries);
+  ASSERT_EQ(1U, report.failed_entries.size());
+  EXPECT_THAT(report.failed_entries[0].first,
+              EqualsProto(resp.entities(2).table_entry()));
+  EXPECT_THAT(report.failed_entries[0].second,
+              DerivedFromStatus(DefaultError()));
+}
+
 // VerifyForwardingPipelineConfig() should verify the config.
 TEST_F(BfrtNodeTest, VerifyForwardingPipelineConfigSuccess) {
   ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
@@ -919,12 +1063,30 @@ TEST_F(BfrtNodeTest, VerifyForwardingPipelineConfigSuccess) {
 
 namespace {
 
+// Fills in an entry of the table in kValidP4InfoString that passes the write
+// validation. Deletes only need the match key.
+void FillValidTableEntry(::p4::v1::TableEntry* table_entry, bool with_action) {
+  table_entry->set_table_id(33583783);
+  auto* match = table_entry->add_match();
+  match->set_field_id(1);
+  match->mutable_exact()->set_value("\x01");
+  table_entry->set_priority(10);
+  if (with_action) {
+    auto* action = table_entry->mutable_action()->mutable_action();
+    action->set_action_id(16794911);
+    auto* param = action->add_params();
+    param->set_param_id(1);
+    param->set_value("\x0a");
+  }
+}
+
 ::p4::v1::TableEntry* SetupTableEntryToInsert(::p4::v1::WriteRequest* req,
                                               uint64 node_id) {
   req->set_device_id(node_id);
   auto* update = req->add_updates();
   update->set_type(::p4::v1::Update::INSERT);
   auto* entity = update->mutable_entity();
+  FillValidTableEntry(entity->mutable_table_entry(), true);
   return entity->mutable_table_entry();
 }
 
@@ -934,6 +1096,7 @@ namespace {
   auto* update = req->add_updates();
   update->set_type(::p4::v1::Update::MODIFY);
   auto* entity = update->mutable_entity();
+  FillValidTableEntry(entity->mutable_table_entry(), true);
   return entity->mutable_table_entry();
 }
 
@@ -943,6 +1106,7 @@ namespace {
   auto* update = req->add_updates();
   update->set_type(::p4::v1::Update::DELETE);
   auto* entity = update->mutable_entity();
+  FillValidTableEntry(entity->mutable_table_entry(), false);
   return entity->mutable_table_entry();
 }
 
@@ -967,7 +1131,7 @@ TEST_F(BfrtNodeTest, WriteForwardingEntriesSuccess_InsertTableEntry) {
   EXPECT_CALL(*bf_sde_mock_, CreateSession()).WillOnce(Return(session_mock));
   EXPECT_CALL(*bfrt_table_manager_mock_,
               WriteTableEntry(session_mock, ::p4::v1::Update::INSERT,
-                              EqualsProto(*table_entry)))
+                              EqualsProto(*table_entry), NotNull()))
       .WillOnce(Return(::util::OkStatus()));
 
   std::vector<::util::Status> results = {};
@@ -987,7 +1151,7 @@ TEST_F(BfrtNodeTest, WriteForwardingEntriesSuccess_ModifyTableEntry) {
   EXPECT_CALL(*bf_sde_mock_, CreateSession()).WillOnce(Return(session_mock));
   EXPECT_CALL(*bfrt_table_manager_mock_,
               WriteTableEntry(session_mock, ::p4::v1::Update::MODIFY,
-                              EqualsProto(*table_entry)))
+                              EqualsProto(*table_entry), NotNull()))
       .WillOnce(Return(::util::OkStatus()));
 
   std::vector<::util::Status> results = {};
@@ -1007,7 +1171,7 @@ TEST_F(BfrtNodeTest, WriteForwardingEntriesSuccess_DeleteTableEntry) {
   EXPECT_CALL(*bf_sde_mock_, CreateSession()).WillOnce(Return(session_mock));
   EXPECT_CALL(*bfrt_table_manager_mock_,
               WriteTableEntry(session_mock, ::p4::v1::Update::DELETE,
-                              EqualsProto(*table_entry)))
+                              EqualsProto(*table_entry), NotNull()))
       .WillOnce(Return(::util::OkStatus()));
 
   std::vector<::util::Status> results = {};
@@ -1015,6 +1179,51 @@ TEST_F(BfrtNodeTest, WriteForwardingEntriesSuccess_DeleteTableEntry) {
   EXPECT_EQ(1U, results.size());
 }
 
+// Invalid updates are rejected before any SDE call.
+TEST_F(BfrtNodeTest, WriteForwardingEntriesFailure_InvalidTableEntry) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+  ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
+
+  ::p4::v1::WriteRequest req;
+  SetupTableEntryToInsert(&req, kNodeId)->set_table_id(12345);
+  SetupTableEntryToInsert(&req, kNodeId)->clear_priority();
+
+  EXPECT_CALL(*bf_sde_mock_, CreateSession()).Times(0);
+  EXPECT_CALL(*bfrt_table_manager_mock_, WriteTableEntry(_, _, _, _)).Times(0);
+
+  std::vector<::util::Status> results = {};
+  ::util::Status status = WriteForwardingEntries(req, &results);
+  EXPECT_EQ(ERR_AT_LEAST_ONE_OPER_FAILED, status.error_code());
+  ASSERT_EQ(2U, results.size());
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, results[0].error_code());
+  EXPECT_EQ(ERR_INVALID_PARAM, results[1].error_code());
+}
+
+// Only the valid updates of a request reach the managers.
+TEST_F(BfrtNodeTest, WriteForwardingEntriesFailure_SkipsInvalidTableEntry) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+  ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
+
+  ::p4::v1::WriteRequest req;
+  SetupTableEntryToInsert(&req, kNodeId)->set_table_id(12345);
+  auto* table_entry = SetupTableEntryToInsert(&req, kNodeId);
+
+  std::shared_ptr<BfSdeInterface::SessionInterface> session_mock =
+      std::make_shared<SessionMock>();
+  EXPECT_CALL(*bf_sde_mock_, CreateSession()).WillOnce(Return(session_mock));
+  EXPECT_CALL(*bfrt_table_manager_mock_,
+              WriteTableEntry(session_mock, ::p4::v1::Update::INSERT,
+                              EqualsProto(*table_entry), NotNull()))
+      .WillOnce(Return(::util::OkStatus()));
+
+  std::vector<::util::Status> results = {};
+  ::util::Status status = WriteForwardingEntries(req, &results);
+  EXPECT_EQ(ERR_AT_LEAST_ONE_OPER_FAILED, status.error_code());
+  ASSERT_EQ(2U, results.size());
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, results[0].error_code());
+  EXPECT_OK(results[1]);
+}
+
 TEST_F(BfrtNodeTest, WriteForwardingEntriesSuccess_InsertActionProfileMember) {
   ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
   ASSERT_NO_FATAL_FAILURE(PushForwardingPipelineConfigWithCheck());
@@ -1403,7 +1612,8 @@ TEST_F(BfrtNodeTest, ReadForwardingEntriesSuccess_TableEntry) {
   EXPECT_CALL(*bf_sde_mock_, CreateSession()).WillOnce(Return(session_mock));
   EXPECT_CALL(
       *bfrt_table_manager_mock_,
-      ReadTableEntry(session_mock, EqualsProto(*table_entry), &writer_mock))
+      ReadTableEntry(session_mock, EqualsProto(*table_entry), &writer_mock,
+                     NotNull()))
       .WillOnce(Return(::util::OkStatus()));
   std::vector<::util::Status> results = {};
   EXPECT_OK(ReadForwardingEntries(req, &writer_mock, &results));
@@ -49,6 +49,10 @@ namespace barefoot {
     singleton_port_to_sdk_port_[singleton_port_id] = sdk_port_id;
     sdk_port_to_singleton_port_[sdk_port_id] = singleton_port_id;
   }
+  trunk_ports_.clear();
+  for (const auto& trunk_port : config.trunk_ports()) {
+    if (trunk_port.node() == node_id) trunk_ports_.insert(trunk_port.id());
+  }
 
   return ::util::OkStatus();
 }
@@ -225,18 +229,47 @@ BfrtP4RuntimeTranslator::TranslateTableEntry(const ::p4::v1::TableEntry& entry,
   if (!pipeline_require_translation_) {
     return entry;
   }
-  return TranslateTableEntryInternal(entry, to_sdk);
+  ::p4::v1::TableEntry translated_entry;
+  RETURN_IF_ERROR(
+      TranslateTableEntryInternal(entry, to_sdk, &translated_entry));
+  return translated_entry;
 }
 
-::util::StatusOr<::p4::v1::TableEntry>
-BfrtP4RuntimeTranslator::TranslateTableEntryInternal(
-    const ::p4::v1::TableEntry& entry, bool to_sdk) {
-  ::p4::v1::TableEntry translated_entry(entry);
-  const auto& table_id = translated_entry.table_id();
+::util::StatusOr<const ::p4::v1::TableEntry*>
+BfrtP4RuntimeTranslator::TranslateTableEntry(const ::p4::v1::TableEntry& entry,
+                                             bool to_sdk,
+                                             ::google::protobuf::Arena* arena) {
+  RET_CHECK(arena) << "Null arena.";
+  absl::ReaderMutexLock l(&lock_);
+  if (!pipeline_require_translation_) {
+    return &entry;
+  }
+  auto* translated_entry =
+      ::google::protobuf::Arena::CreateMessage<::p4::v1::TableEntry>(arena);
+  RETURN_IF_ERROR(
+      TranslateTableEntryInternal(entry, to_sdk, translated_entry));
+  return translated_entry;
+}
+
+::util::Status BfrtP4RuntimeTranslator::TranslateTableEntryInPlace(
+    ::p4::v1::TableEntry* entry, bool to_sdk) {
+  RET_CHECK(entry) << "Null entry.";
+  absl::ReaderMutexLock l(&lock_);
+  if (!pipeline_require_translation_) {
+    return ::util::OkStatus();
+  }
+  return TranslateTableEntryInternal(*entry, to_sdk, entry);
+}
+
+::util::Status BfrtP4RuntimeTranslator::TranslateTableEntryInternal(
+    const ::p4::v1::TableEntry& entry, bool to_sdk,
+    ::p4::v1::TableEntry* translated_entry) {
+  if (translated_entry != &entry) *translated_entry = entry;
+  const auto& table_id = translated_entry->table_id();
   if (table_to_field_to_type_uri_.contains(table_id) &&
       table_to_field_to_bit_width_.contains(table_id)) {
     for (::p4::v1::FieldMatch& field_match :
-         *translated_entry.mutable_match()) {
+         *translated_entry->mutable_match()) {
       const auto& field_id = field_match.field_id();
       std::string* uri =
           gtl::FindOrNull(table_to_field_to_type_uri_[table_id], field_id);
@@ -316,15 +349,15 @@ BfrtP4RuntimeTranslator::TranslateTableEntryInternal(
     }
   }
 
-  switch (translated_entry.action().type_case()) {
+  switch (translated_entry->action().type_case()) {
     case ::p4::v1::TableAction::kAction: {
       ASSIGN_OR_RETURN(
-          *(translated_entry.mutable_action()->mutable_action()),
-          TranslateAction(translated_entry.action().action(), to_sdk));
+          *(translated_entry->mutable_action()->mutable_action()),
+          TranslateAction(translated_entry->action().action(), to_sdk));
       break;
     }
     case ::p4::v1::TableAction::kActionProfileActionSet: {
-      auto* action_set = translated_entry.mutable_action()
+      auto* action_set = translated_entry->mutable_action()
                              ->mutable_action_profile_action_set();
       for (::p4::v1::ActionProfileAction& action_profile_action :
            *action_set->mutable_action_profile_actions()) {
@@ -337,7 +370,7 @@ BfrtP4RuntimeTranslator::TranslateTableEntryInternal(
     default:
       break;
   }
-  return translated_entry;
+  return ::util::OkStatus();
 }
 
 ::util::StatusOr<::p4::v1::ActionProfileMember>
@@ -380,8 +413,8 @@ BfrtP4RuntimeTranslator::TranslateDirectMeterEntry(
     return entry;
   }
   ::p4::v1::DirectMeterEntry translated_entry(entry);
-  ASSIGN_OR_RETURN(*translated_entry.mutable_table_entry(),
-                   TranslateTableEntryInternal(entry.table_entry(), to_sdk));
+  RETURN_IF_ERROR(TranslateTableEntryInternal(
+      entry.table_entry(), to_sdk, translated_entry.mutable_table_entry()));
   return translated_entry;
 }
 
@@ -435,8 +468,8 @@ BfrtP4RuntimeTranslator::TranslateDirectCounterEntry(
     return entry;
   }
   ::p4::v1::DirectCounterEntry translated_entry(entry);
-  ASSIGN_OR_RETURN(*translated_entry.mutable_table_entry(),
-                   TranslateTableEntryInternal(entry.table_entry(), to_sdk));
+  RETURN_IF_ERROR(TranslateTableEntryInternal(
+      entry.table_entry(), to_sdk, translated_entry.mutable_table_entry()));
   return translated_entry;
 }
 
@@ -460,6 +493,7 @@ BfrtP4RuntimeTranslator::TranslateRegisterEntry(
 ::util::StatusOr<::p4::v1::Replica> BfrtP4RuntimeTranslator::TranslateReplica(
     const ::p4::v1::Replica& replica, bool to_sdk) {
   ::p4::v1::Replica translated_replica(replica);
+  if (trunk_ports_.contains(replica.egress_port())) return translated_replica;
   // Since we know we are always translating the port number, we can simply
   // use the port map here.
   if (to_sdk) {
@@ -8,8 +8,10 @@
 #include <string>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
+#include "google/protobuf/arena.h"
 #include "p4/v1/p4runtime.pb.h"
 #include "stratum/glue/integral_types.h"
 #include "stratum/glue/status/status.h"
@@ -42,6 +44,17 @@ class BfrtP4RuntimeTranslator {
       const ::p4::config::v1::P4Info& p4info) LOCKS_EXCLUDED(lock_);
   virtual ::util::StatusOr<::p4::v1::TableEntry> TranslateTableEntry(
       const ::p4::v1::TableEntry& entry, bool to_sdk) LOCKS_EXCLUDED(lock_);
+  // Same as above, without copying the entry when the pipeline requires no
+  // translation: returns the given entry itself in that case, or else a
+  // translated copy allocated on the given (non-null) arena.
+  virtual ::util::StatusOr<const ::p4::v1::TableEntry*> TranslateTableEntry(
+      const ::p4::v1::TableEntry& entry, bool to_sdk,
+      ::google::protobuf::Arena* arena) LOCKS_EXCLUDED(lock_);
+  // Same as above, translating the given entry in place. Meant for entries
+  // built by Stratum itself, e.g. the entries read back from the SDE.
+  virtual ::util::Status TranslateTableEntryInPlace(::p4::v1::TableEntry* entry,
+                                                    bool to_sdk)
+      LOCKS_EXCLUDED(lock_);
   virtual ::util::StatusOr<::p4::v1::ActionProfileMember>
   TranslateActionProfileMember(const ::p4::v1::ActionProfileMember& entry,
                                bool to_sdk) LOCKS_EXCLUDED(lock_);
@@ -97,9 +110,9 @@ class BfrtP4RuntimeTranslator {
         pipeline_require_translation_(false),
         bf_sde_interface_(bf_sde_interface),
         device_id_(device_id) {}
-  virtual ::util::StatusOr<::p4::v1::TableEntry> TranslateTableEntryInternal(
-      const ::p4::v1::TableEntry& entry, bool to_sdk)
-      SHARED_LOCKS_REQUIRED(lock_);
+  virtual ::util::Status TranslateTableEntryInternal(
+      const ::p4::v1::TableEntry& entry, bool to_sdk,
+      ::p4::v1::TableEntry* translated_entry) SHARED_LOCKS_REQUIRED(lock_);
   virtual ::util::StatusOr<::p4::v1::PacketMetadata> TranslatePacketMetadata(
       const p4::v1::PacketMetadata& packet_metadata, const std::string& uri,
       int32 bit_width, bool to_sdk) SHARED_LOCKS_REQUIRED(lock_);
@@ -140,6 +153,10 @@ class BfrtP4RuntimeTranslator {
   absl::flat_hash_map<uint32, uint32> sdk_port_to_singleton_port_
       GUARDED_BY(lock_);
 
+  // IDs of the trunk ports. Multicast replicas to trunk ports are not
+  // translated, the PRE manager maps them to multicast LAGs.
+  absl::flat_hash_set<uint32> trunk_ports_ GUARDED_BY(lock_);
+
   // P4Runtime translation information
   absl::flat_hash_map<uint32, absl::flat_hash_map<uint32, std::string>>
       table_to_field_to_type_uri_ GUARDED_BY(lock_);
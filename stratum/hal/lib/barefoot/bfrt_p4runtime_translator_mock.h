@@ -22,6 +22,12 @@ class BfrtP4RuntimeTranslatorMock : public BfrtP4RuntimeTranslator {
   MOCK_METHOD2(TranslateTableEntry,
                ::util::StatusOr<::p4::v1::TableEntry>(
                    const ::p4::v1::TableEntry& entry, bool to_sdk));
+  MOCK_METHOD3(TranslateTableEntry,
+               ::util::StatusOr<const ::p4::v1::TableEntry*>(
+                   const ::p4::v1::TableEntry& entry, bool to_sdk,
+                   ::google::protobuf::Arena* arena));
+  MOCK_METHOD2(TranslateTableEntryInPlace,
+               ::util::Status(::p4::v1::TableEntry* entry, bool to_sdk));
   MOCK_METHOD2(TranslateActionProfileMember,
                ::util::StatusOr<::p4::v1::ActionProfileMember>(
                    const ::p4::v1::ActionProfileMember& entry, bool to_sdk));
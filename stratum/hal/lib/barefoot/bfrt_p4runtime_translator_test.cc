@@ -714,6 +714,50 @@ TEST_F(BfrtP4RuntimeTranslatorTest, WriteTableEntry_ActionProfileActionSet) {
                        &BfrtP4RuntimeTranslator::TranslateTableEntry);
 }
 
+TEST_F(BfrtP4RuntimeTranslatorTest, WriteTableEntry_Arena) {
+  constexpr char table_entry_str[] = R"pb(
+    table_id: 33583783
+    match {
+      field_id: 1
+      exact { value: "\x01" }
+    }
+  )pb";
+  constexpr char expected_table_entry_str[] = R"pb(
+    table_id: 33583783
+    match {
+      field_id: 1
+      exact { value: "\x01\x2C" }
+    }
+  )pb";
+  ::p4::v1::TableEntry table_entry;
+  ::p4::v1::TableEntry expected_table_entry;
+  ASSERT_OK(ParseProtoFromString(table_entry_str, &table_entry));
+  ASSERT_OK(
+      ParseProtoFromString(expected_table_entry_str, &expected_table_entry));
+  ::google::protobuf::Arena arena;
+
+  // Without a pipeline requiring translation, the entry is not copied.
+  auto res = bfrt_p4runtime_translator_->TranslateTableEntry(table_entry,
+                                                             true, &arena);
+  ASSERT_OK(res.status());
+  EXPECT_EQ(&table_entry, res.ValueOrDie());
+
+  // Otherwise the translated entry is allocated on the arena.
+  EXPECT_OK(PushChassisConfig());
+  EXPECT_OK(PushForwardingPipelineConfig());
+  res = bfrt_p4runtime_translator_->TranslateTableEntry(table_entry, true,
+                                                        &arena);
+  ASSERT_OK(res.status());
+  const ::p4::v1::TableEntry* translated = res.ValueOrDie();
+  EXPECT_NE(&table_entry, translated);
+  EXPECT_EQ(&arena, translated->GetArena());
+  EXPECT_THAT(*translated, EqualsProto(expected_table_entry));
+
+  EXPECT_FALSE(bfrt_p4runtime_translator_
+                   ->TranslateTableEntry(table_entry, true, nullptr)
+                   .ok());
+}
+
 TEST_F(BfrtP4RuntimeTranslatorTest, ReadTableEntry) {
   EXPECT_OK(PushChassisConfig());
   EXPECT_OK(PushForwardingPipelineConfig());
@@ -791,6 +835,44 @@ TEST_F(BfrtP4RuntimeTranslatorTest, ReadTableEntry) {
                        &BfrtP4RuntimeTranslator::TranslateTableEntry);
 }
 
+TEST_F(BfrtP4RuntimeTranslatorTest, ReadTableEntry_InPlace) {
+  constexpr char table_entry_str[] = R"pb(
+    table_id: 33583783
+    match {
+      field_id: 1
+      exact { value: "\x01\x2C" }
+    }
+  )pb";
+  constexpr char expected_table_entry_str[] = R"pb(
+    table_id: 33583783
+    match {
+      field_id: 1
+      exact { value: "\x01" }
+    }
+  )pb";
+  ::p4::v1::TableEntry table_entry;
+  ::p4::v1::TableEntry expected_table_entry;
+  ASSERT_OK(ParseProtoFromString(table_entry_str, &table_entry));
+  ASSERT_OK(
+      ParseProtoFromString(expected_table_entry_str, &expected_table_entry));
+
+  // Without a pipeline requiring translation, the entry is left untouched.
+  ::p4::v1::TableEntry entry = table_entry;
+  EXPECT_OK(bfrt_p4runtime_translator_->TranslateTableEntryInPlace(&entry,
+                                                                   false));
+  EXPECT_THAT(entry, EqualsProto(table_entry));
+
+  EXPECT_OK(PushChassisConfig());
+  EXPECT_OK(PushForwardingPipelineConfig());
+  EXPECT_OK(bfrt_p4runtime_translator_->TranslateTableEntryInPlace(&entry,
+                                                                   false));
+  EXPECT_THAT(entry, EqualsProto(expected_table_entry));
+
+  EXPECT_FALSE(
+      bfrt_p4runtime_translator_->TranslateTableEntryInPlace(nullptr, false)
+          .ok());
+}
+
 TEST_F(BfrtP4RuntimeTranslatorTest, ReadTableEntry_ActionProfileActionSet) {
   EXPECT_OK(PushChassisConfig());
   EXPECT_OK(PushForwardingPipelineConfig());
@@ -1988,6 +2070,66 @@ TEST_F(BfrtP4RuntimeTranslatorTest, TranslationDisabled) {
                        &BfrtP4RuntimeTranslator::TranslateP4Info);
 }
 
+#ifdef BENCHMARK
+// Runs the test fixture setup outside of a test, so that the benchmarks below
+// can reuse it. BfSdeMock stands in for the SDE, as there is no in-memory SDE
+// implementation.
+class BfrtP4RuntimeTranslatorBenchmark : public BfrtP4RuntimeTranslatorTest {
+ public:
+  void TestBody() override {}
+
+  // Translates a write request entry iters times, either into a new message
+  // on the heap or into one on the given arena. The arena is reset every
+  // kEntriesPerRequest iterations, like the per-request arena of a P4Runtime
+  // Write.
+  void TranslateWriteEntries(int iters, bool use_arena) {
+    constexpr int kEntriesPerRequest = 1000;
+    SetUp();
+    CHECK_OK(PushChassisConfig());
+    CHECK_OK(PushForwardingPipelineConfig());
+    ::p4::v1::TableEntry entry;
+    CHECK_OK(ParseProtoFromString(R"pb(
+                                    table_id: 33583783
+                                    match {
+                                      field_id: 1
+                                      exact { value: "\x01" }
+                                    }
+                                  )pb",
+                                  &entry));
+    ::google::protobuf::Arena arena;
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; ++i) {
+      if (use_arena) {
+        auto res = bfrt_p4runtime_translator_->TranslateTableEntry(
+            entry, /*to_sdk=*/true, &arena);
+        CHECK(res.ok()) << res.status();
+        if ((i + 1) % kEntriesPerRequest == 0) arena.Reset();
+      } else {
+        auto res = bfrt_p4runtime_translator_->TranslateTableEntry(
+            entry, /*to_sdk=*/true);
+        CHECK(res.ok()) << res.status();
+      }
+    }
+    StopBenchmarkTiming();
+  }
+};
+
+static void BM_TranslateWriteTableEntry(int iters) {
+  StopBenchmarkTiming();
+  BfrtP4RuntimeTranslatorBenchmark benchmark;
+  benchmark.TranslateWriteEntries(iters, /*use_arena=*/false);
+}
+BENCHMARK(BM_TranslateWriteTableEntry);
+
+static void BM_TranslateWriteTableEntryOnArena(int iters) {
+  StopBenchmarkTiming();
+  BfrtP4RuntimeTranslatorBenchmark benchmark;
+  benchmark.TranslateWriteEntries(iters, /*use_arena=*/true);
+}
+BENCHMARK(BM_TranslateWriteTableEntryOnArena);
+#endif  // BENCHMARK
+
 }  // namespace barefoot
 }  // namespace hal
 }  // namespace stratum
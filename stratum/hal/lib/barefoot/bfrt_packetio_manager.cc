@@ -12,9 +12,11 @@
 #include <deque>
 #include <string>
 
+#include "absl/strings/str_cat.h"
 #include "stratum/glue/gtl/map_util.h"
 #include "stratum/hal/lib/common/constants.h"
 #include "stratum/hal/lib/p4/utils.h"
+#include "stratum/lib/liveness_watchdog.h"
 #include "stratum/lib/utils.h"
 
 DECLARE_bool(incompatible_enable_bfrt_legacy_bytestring_responses);
@@ -316,14 +318,16 @@ class BitBuffer {
     reader = ChannelReader<std::string>::Create(packet_receive_channel_);
   }
 
+  auto worker = LivenessWatchdog::GetInstance()->RegisterWorker(
+      absl::StrCat("BfrtPacketioManager RX (device ", device_, ")"));
   while (true) {
+    worker->Heartbeat();
     std::string buffer;
-    int code = reader->Read(&buffer, absl::InfiniteDuration()).error_code();
+    // The read times out periodically so that the thread keeps heartbeating
+    // while there is no packet to receive.
+    int code = reader->Read(&buffer, absl::Seconds(1)).error_code();
     if (code == ERR_CANCELLED) break;
-    if (code == ERR_ENTRY_NOT_FOUND) {
-      LOG(ERROR) << "Read with infinite timeout failed with ENTRY_NOT_FOUND.";
-      continue;
-    }
+    if (code == ERR_ENTRY_NOT_FOUND) continue;
 
     ::p4::v1::PacketIn packet_in;
     ::util::Status status = ParsePacketIn(buffer, &packet_in);
@@ -342,6 +346,7 @@ class BitBuffer {
       rx_writer_->Write(translated_packet_in.ValueOrDie());
     }
     VLOG(1) << "Handled PacketIn: " << packet_in.ShortDebugString();
+    worker->ReportProgress(1);
   }
 
   return ::util::OkStatus();
@@ -11,6 +11,8 @@
 #include "stratum/glue/gtl/map_util.h"
 #include "stratum/glue/status/status_macros.h"
 #include "stratum/hal/lib/barefoot/bfrt_constants.h"
+#include "stratum/hal/lib/common/utils.h"
+#include "stratum/lib/macros.h"
 #include "stratum/public/lib/error.h"
 
 namespace stratum {
@@ -22,17 +24,190 @@ BfrtPreManager::BfrtPreManager(
     BfrtP4RuntimeTranslator* bfrt_p4runtime_translator, int device)
     : bf_sde_interface_(ABSL_DIE_IF_NULL(bf_sde_interface)),
       bfrt_p4runtime_translator_(ABSL_DIE_IF_NULL(bfrt_p4runtime_translator)),
-      device_(device) {}
+      device_(device),
+      pipeline_initialized_(false) {}
 
 BfrtPreManager::BfrtPreManager()
     : bf_sde_interface_(nullptr),
       bfrt_p4runtime_translator_(nullptr),
-      device_(-1) {}
+      device_(-1),
+      pipeline_initialized_(false) {}
+
+::util::Status BfrtPreManager::PushChassisConfig(const ChassisConfig& config,
+                                                 uint64 node_id) {
+  absl::WriterMutexLock l(&lock_);
+  absl::flat_hash_map<uint32, uint32> port_id_to_sdk_port_id;
+  absl::flat_hash_set<uint32> sdk_port_ids;
+  for (const auto& singleton_port : config.singleton_ports()) {
+    if (singleton_port.node() != node_id) continue;
+    PortKey port_key(singleton_port.slot(), singleton_port.port(),
+                     singleton_port.channel());
+    ASSIGN_OR_RETURN(
+        uint32 sdk_port_id,
+        bf_sde_interface_->GetPortIdFromPortKey(device_, port_key));
+    port_id_to_sdk_port_id[singleton_port.id()] = sdk_port_id;
+    sdk_port_ids.insert(sdk_port_id);
+  }
+
+  // Collect the members of the trunk ports. Existing trunks keep their LAG ID,
+  // so the multicast nodes which replicate to them stay valid.
+  std::map<uint32, MulticastLag> trunk_id_to_mc_lag;
+  std::vector<uint32> new_trunk_ids;
+  for (const auto& trunk_port : config.trunk_ports()) {
+    if (trunk_port.node() != node_id) continue;
+    // Replicas name trunks and ports by the same egress port field.
+    RET_CHECK(!sdk_port_ids.contains(trunk_port.id()))
+        << "The ID of trunk port " << trunk_port.id() << " on node " << node_id
+        << " is also an SDK port ID, multicast replicas to it would be "
+        << "ambiguous.";
+    MulticastLag lag;
+    for (const uint32 member : trunk_port.members()) {
+      const uint32* sdk_port_id =
+          gtl::FindOrNull(port_id_to_sdk_port_id, member);
+      RET_CHECK(sdk_port_id != nullptr)
+          << "Member " << member << " of trunk port " << trunk_port.id()
+          << " is not a singleton port on node " << node_id << ".";
+      lag.member_ports.push_back(*sdk_port_id);
+    }
+    std::sort(lag.member_ports.begin(), lag.member_ports.end());
+    const MulticastLag* old_lag =
+        gtl::FindOrNull(trunk_id_to_mc_lag_, trunk_port.id());
+    if (old_lag != nullptr) {
+      lag.mc_lag_id = old_lag->mc_lag_id;
+    } else {
+      new_trunk_ids.push_back(trunk_port.id());
+    }
+    trunk_id_to_mc_lag[trunk_port.id()] = lag;
+  }
+  // New trunks get the lowest LAG IDs not used before this push. The LAG IDs
+  // of removed trunks are not reused in the same push, and stay reserved
+  // after it as long as multicast nodes replicate to them, so that a new
+  // trunk does not receive the copies meant for the removed one.
+  absl::flat_hash_set<uint32> referenced_mc_lag_ids;
+  for (const auto& e : mc_node_id_to_mc_lag_ids_) {
+    referenced_mc_lag_ids.insert(e.second.begin(), e.second.end());
+  }
+  uint32 mc_lag_id = 0;
+  for (const uint32 trunk_id : new_trunk_ids) {
+    while (mc_lag_id_to_trunk_id_.count(mc_lag_id) ||
+           referenced_mc_lag_ids.contains(mc_lag_id)) {
+      ++mc_lag_id;
+    }
+    if (mc_lag_id > kMaxMulticastLagId) {
+      return MAKE_ERROR(ERR_TABLE_FULL)
+             << "No free multicast LAG ID for trunk port " << trunk_id
+             << " on node " << node_id << ".";
+    }
+    trunk_id_to_mc_lag[trunk_id].mc_lag_id = mc_lag_id++;
+  }
+
+  // Only the removed, added and changed LAGs are written.
+  std::vector<uint32> removed_mc_lag_ids;
+  for (const auto& e : trunk_id_to_mc_lag_) {
+    if (!trunk_id_to_mc_lag.count(e.first)) {
+      removed_mc_lag_ids.push_back(e.second.mc_lag_id);
+    }
+  }
+  std::vector<const MulticastLag*> added_lags;
+  std::vector<const MulticastLag*> changed_lags;
+  for (const auto& e : trunk_id_to_mc_lag) {
+    const MulticastLag* old_lag = gtl::FindOrNull(trunk_id_to_mc_lag_, e.first);
+    if (old_lag == nullptr) {
+      added_lags.push_back(&e.second);
+    } else if (old_lag->member_ports != e.second.member_ports) {
+      changed_lags.push_back(&e.second);
+    }
+  }
+  ::util::Status status = ::util::OkStatus();
+  if (pipeline_initialized_ &&
+      (!removed_mc_lag_ids.empty() || !added_lags.empty() ||
+       !changed_lags.empty())) {
+    ASSIGN_OR_RETURN(auto session, bf_sde_interface_->CreateSession());
+    RETURN_IF_ERROR(session->BeginBatch());
+    for (const uint32 removed_mc_lag_id : removed_mc_lag_ids) {
+      APPEND_STATUS_IF_ERROR(status,
+                             bf_sde_interface_->DeleteMulticastLag(
+                                 device_, session, removed_mc_lag_id));
+    }
+    for (const MulticastLag* lag : added_lags) {
+      APPEND_STATUS_IF_ERROR(status, bf_sde_interface_->InsertMulticastLag(
+                                         device_, session, lag->mc_lag_id,
+                                         GetUpMemberPorts(*lag)));
+    }
+    for (const MulticastLag* lag : changed_lags) {
+      APPEND_STATUS_IF_ERROR(status, bf_sde_interface_->ModifyMulticastLag(
+                                         device_, session, lag->mc_lag_id,
+                                         GetUpMemberPorts(*lag)));
+    }
+    APPEND_STATUS_IF_ERROR(status, session->EndBatch());
+  }
+
+  trunk_id_to_mc_lag_ = std::move(trunk_id_to_mc_lag);
+  port_id_to_sdk_port_id_ = std::move(port_id_to_sdk_port_id);
+  mc_lag_id_to_trunk_id_.clear();
+  sdk_port_id_to_trunk_ids_.clear();
+  for (const auto& e : trunk_id_to_mc_lag_) {
+    mc_lag_id_to_trunk_id_[e.second.mc_lag_id] = e.first;
+    for (const uint32 sdk_port_id : e.second.member_ports) {
+      sdk_port_id_to_trunk_ids_[sdk_port_id].push_back(e.first);
+    }
+  }
+
+  return status;
+}
 
 ::util::Status BfrtPreManager::PushForwardingPipelineConfig(
     const BfrtDeviceConfig& config) {
   absl::WriterMutexLock l(&lock_);
-  return ::util::OkStatus();
+  pipeline_initialized_ = true;
+  // The pipeline push removed all multicast nodes.
+  mc_node_id_to_mc_lag_ids_.clear();
+  return ProgramMulticastLagsAndPortStates();
+}
+
+::util::Status BfrtPreManager::UpdatePortState(uint32 port_id,
+                                              PortState new_state) {
+  absl::WriterMutexLock l(&lock_);
+  const uint32* sdk_port_id = gtl::FindOrNull(port_id_to_sdk_port_id_, port_id);
+  if (sdk_port_id == nullptr) return ::util::OkStatus();
+  const bool is_down = new_state != PORT_STATE_UP;
+  if (is_down == down_sdk_ports_.contains(*sdk_port_id)) {
+    return ::util::OkStatus();
+  }
+  if (is_down) {
+    down_sdk_ports_.insert(*sdk_port_id);
+  } else {
+    down_sdk_ports_.erase(*sdk_port_id);
+  }
+  if (!pipeline_initialized_) return ::util::OkStatus();
+
+  // The forwarding state prunes the port from all multicast groups at once.
+  // LAGs are rewritten to their up members, so that the PRE picks another
+  // member for the copies the down port would have received. We continue on
+  // errors so that a failing LAG does not prevent the update of the others.
+  ASSIGN_OR_RETURN(auto session, bf_sde_interface_->CreateSession());
+  RETURN_IF_ERROR(session->BeginBatch());
+  ::util::Status status = ::util::OkStatus();
+  APPEND_STATUS_IF_ERROR(status,
+                         bf_sde_interface_->SetMulticastPortForwardState(
+                             device_, session, *sdk_port_id, !is_down));
+  const auto* trunk_ids =
+      gtl::FindOrNull(sdk_port_id_to_trunk_ids_, *sdk_port_id);
+  if (trunk_ids != nullptr) {
+    for (const uint32 trunk_id : *trunk_ids) {
+      const MulticastLag& lag = gtl::FindOrDie(trunk_id_to_mc_lag_, trunk_id);
+      APPEND_STATUS_IF_ERROR(
+          status, bf_sde_interface_->ModifyMulticastLag(
+                      device_, session, lag.mc_lag_id, GetUpMemberPorts(lag)));
+    }
+  }
+  APPEND_STATUS_IF_ERROR(status, session->EndBatch());
+  VLOG(1) << "Updated the multicast forwarding state of SDK port "
+          << *sdk_port_id << " and " << (trunk_ids ? trunk_ids->size() : 0)
+          << " multicast LAGs on device " << device_ << " after port "
+          << port_id << " went " << (is_down ? "down" : "up") << ".";
+
+  return status;
 }
 
 BfrtPreManager::~BfrtPreManager() = default;
@@ -94,34 +269,138 @@ std::unique_ptr<BfrtPreManager> BfrtPreManager::CreateInstance(
       new BfrtPreManager(bf_sde_interface, bfrt_p4runtime_translator, device));
 }
 
+::util::StatusOr<absl::flat_hash_map<uint32,
+                                     BfrtPreManager::MulticastNodeReplicas>>
+BfrtPreManager::GetMulticastNodeReplicas(
+    const ::p4::v1::MulticastGroupEntry& entry) const {
+  absl::flat_hash_map<uint32, MulticastNodeReplicas> instance_to_replicas;
+  for (const auto& replica : entry.replicas()) {
+    RET_CHECK(replica.instance() <= UINT16_MAX);
+    auto& node_replicas = instance_to_replicas[replica.instance()];
+    const MulticastLag* lag =
+        gtl::FindOrNull(trunk_id_to_mc_lag_, replica.egress_port());
+    if (lag != nullptr) {
+      node_replicas.mc_lag_ids.push_back(lag->mc_lag_id);
+    } else {
+      node_replicas.ports.push_back(replica.egress_port());
+    }
+  }
+  for (auto& e : instance_to_replicas) {
+    std::sort(e.second.ports.begin(), e.second.ports.end());
+    std::sort(e.second.mc_lag_ids.begin(), e.second.mc_lag_ids.end());
+  }
+
+  return instance_to_replicas;
+}
+
+std::vector<uint32> BfrtPreManager::GetUpMemberPorts(
+    const MulticastLag& lag) const {
+  std::vector<uint32> ports;
+  for (const uint32 port : lag.member_ports) {
+    if (!down_sdk_ports_.contains(port)) ports.push_back(port);
+  }
+  return ports;
+}
+
+::util::Status BfrtPreManager::ProgramMulticastLagsAndPortStates() {
+  if (trunk_id_to_mc_lag_.empty() && down_sdk_ports_.empty()) {
+    return ::util::OkStatus();
+  }
+  ASSIGN_OR_RETURN(auto session, bf_sde_interface_->CreateSession());
+  RETURN_IF_ERROR(session->BeginBatch());
+  ::util::Status status = ::util::OkStatus();
+  for (const auto& e : trunk_id_to_mc_lag_) {
+    APPEND_STATUS_IF_ERROR(
+        status, bf_sde_interface_->InsertMulticastLag(
+                    device_, session, e.second.mc_lag_id,
+                    GetUpMemberPorts(e.second)));
+  }
+  for (const uint32 sdk_port_id : down_sdk_ports_) {
+    APPEND_STATUS_IF_ERROR(status,
+                           bf_sde_interface_->SetMulticastPortForwardState(
+                               device_, session, sdk_port_id, false));
+  }
+  APPEND_STATUS_IF_ERROR(status, session->EndBatch());
+
+  return status;
+}
+
 ::util::StatusOr<std::vector<uint32>> BfrtPreManager::InsertMulticastNodes(
     std::shared_ptr<BfSdeInterface::SessionInterface> session,
     const ::p4::v1::MulticastGroupEntry& entry) {
   const uint32 group_id = entry.multicast_group_id();
   RET_CHECK(group_id <= kMaxMulticastGroupId);
 
-  // Collect instance (rid) -> egress ports mapping
-  absl::flat_hash_map<uint32, std::vector<uint32>> instance_to_egress_ports;
-  for (const auto& replica : entry.replicas()) {
-    RET_CHECK(replica.instance() <= UINT16_MAX);
-    instance_to_egress_ports[replica.instance()].push_back(
-        replica.egress_port());
-  }
+  // Collect instance (rid) -> egress ports and LAGs mapping
+  ASSIGN_OR_RETURN(const auto instance_to_replicas,
+                   GetMulticastNodeReplicas(entry));
   std::vector<uint32> new_nodes = {};
   // FIXME: We need to revert partial modifications in case of failures.
-  for (const auto& replica : instance_to_egress_ports) {
+  for (const auto& replica : instance_to_replicas) {
     const uint32 instance = replica.first;
-    const std::vector<uint32>& egress_ports = replica.second;
-    std::vector<uint32> mc_lag_ids;
+    const MulticastNodeReplicas& node_replicas = replica.second;
     ASSIGN_OR_RETURN(uint32 mc_node_id,
                      bf_sde_interface_->CreateMulticastNode(
-                         device_, session, instance, mc_lag_ids, egress_ports));
+                         device_, session, instance, node_replicas.mc_lag_ids,
+                         node_replicas.ports));
+    if (!node_replicas.mc_lag_ids.empty()) {
+      mc_node_id_to_mc_lag_ids_[mc_node_id] = node_replicas.mc_lag_ids;
+    }
     new_nodes.push_back(mc_node_id);
   }
 
   return new_nodes;
 }
 
+::util::StatusOr<std::vector<uint32>> BfrtPreManager::UpdateMulticastNodes(
+    std::shared_ptr<BfSdeInterface::SessionInterface> session,
+    const ::p4::v1::MulticastGroupEntry& entry,
+    const std::vector<uint32>& current_node_ids,
+    std::vector<uint32>* stale_node_ids) {
+  const uint32 group_id = entry.multicast_group_id();
+  RET_CHECK(group_id <= kMaxMulticastGroupId);
+
+  // Collect instance (rid) -> egress ports and LAGs mapping, sorted so they
+  // can be compared to the ports and LAGs of the current nodes.
+  ASSIGN_OR_RETURN(auto instance_to_replicas, GetMulticastNodeReplicas(entry));
+
+  // Keep the current nodes whose instance, ports and LAGs are unchanged. A
+  // node is reused at most once, as the instance is removed from the map.
+  std::vector<uint32> node_ids = {};
+  for (const uint32 mc_node_id : current_node_ids) {
+    int replication_id;
+    std::vector<uint32> lag_ids;
+    std::vector<uint32> ports;
+    RETURN_IF_ERROR(bf_sde_interface_->GetMulticastNode(
+        device_, session, mc_node_id, &replication_id, &lag_ids, &ports));
+    std::sort(ports.begin(), ports.end());
+    std::sort(lag_ids.begin(), lag_ids.end());
+    auto it = instance_to_replicas.find(replication_id);
+    if (it != instance_to_replicas.end() &&
+        it->second.mc_lag_ids == lag_ids && it->second.ports == ports) {
+      node_ids.push_back(mc_node_id);
+      instance_to_replicas.erase(it);
+    } else {
+      stale_node_ids->push_back(mc_node_id);
+    }
+  }
+
+  // Create the nodes of the new and changed instances.
+  // FIXME: We need to revert partial modifications in case of failures.
+  for (const auto& replica : instance_to_replicas) {
+    ASSIGN_OR_RETURN(uint32 mc_node_id,
+                     bf_sde_interface_->CreateMulticastNode(
+                         device_, session, replica.first,
+                         replica.second.mc_lag_ids, replica.second.ports));
+    if (!replica.second.mc_lag_ids.empty()) {
+      mc_node_id_to_mc_lag_ids_[mc_node_id] = replica.second.mc_lag_ids;
+    }
+    node_ids.push_back(mc_node_id);
+  }
+
+  return node_ids;
+}
+
 // FIXME: We need to revert partial modifications in case of failures.
 ::util::Status BfrtPreManager::WriteMulticastGroupEntry(
     std::shared_ptr<BfSdeInterface::SessionInterface> session,
@@ -142,19 +421,35 @@ std::unique_ptr<BfrtPreManager> BfrtPreManager::CreateInstance(
       ASSIGN_OR_RETURN(auto current_node_ids,
                        bf_sde_interface_->GetNodesInMulticastGroup(
                            device_, session, entry.multicast_group_id()));
+      // Only the changed replicas are written: the group is moved to the
+      // new node list before the stale nodes are deleted, so unchanged
+      // replicas keep forwarding throughout the update.
+      std::vector<uint32> stale_node_ids;
       ASSIGN_OR_RETURN(std::vector<uint32> new_node_ids,
-                       InsertMulticastNodes(session, entry));
+                       UpdateMulticastNodes(session, entry, current_node_ids,
+                                            &stale_node_ids));
+      if (new_node_ids.size() == current_node_ids.size() &&
+          stale_node_ids.empty()) {
+        VLOG(1) << "Multicast group " << entry.multicast_group_id()
+                << " is unchanged.";
+        break;
+      }
       RETURN_IF_ERROR_WITH_APPEND(
           bf_sde_interface_->ModifyMulticastGroup(
               device_, session, entry.multicast_group_id(), new_node_ids))
               .with_logging()
           << "Failed to write multicast group for request "
           << entry.ShortDebugString() << ".";
-      RETURN_IF_ERROR_WITH_APPEND(bf_sde_interface_->DeleteMulticastNodes(
-                                      device_, session, current_node_ids))
-              .with_logging()
-          << "Failed to delete multicast nodes for request "
-          << entry.ShortDebugString() << ".";
+      if (!stale_node_ids.empty()) {
+        RETURN_IF_ERROR_WITH_APPEND(bf_sde_interface_->DeleteMulticastNodes(
+                                        device_, session, stale_node_ids))
+                .with_logging()
+            << "Failed to delete multicast nodes for request "
+            << entry.ShortDebugString() << ".";
+        for (const uint32 mc_node_id : stale_node_ids) {
+          mc_node_id_to_mc_lag_ids_.erase(mc_node_id);
+        }
+      }
       break;
     }
     case ::p4::v1::Update::DELETE: {
@@ -175,6 +470,9 @@ std::unique_ptr<BfrtPreManager> BfrtPreManager::CreateInstance(
               .with_logging()
           << "Failed to delete multicast nodes for request "
           << entry.ShortDebugString() << ".";
+      for (const uint32 mc_node_id : node_ids) {
+        mc_node_id_to_mc_lag_ids_.erase(mc_node_id);
+      }
       break;
     }
     default:
@@ -217,6 +515,23 @@ std::unique_ptr<BfrtPreManager> BfrtPreManager::CreateInstance(
         replica.set_instance(replication_id);
         *result.add_replicas() = replica;
       }
+      // Replicas to a LAG are reported with the ID of its trunk port. LAGs
+      // without a trunk port, e.g. of a trunk removed from the chassis config,
+      // have no members and do not replicate.
+      for (const auto& lag_id : lag_ids) {
+        const uint32* trunk_id =
+            gtl::FindOrNull(mc_lag_id_to_trunk_id_, lag_id);
+        if (trunk_id == nullptr) {
+          LOG(WARNING) << "Multicast node " << mc_node_id << " of group "
+                       << group_id << " replicates to unknown multicast LAG "
+                       << lag_id << ".";
+          continue;
+        }
+        ::p4::v1::Replica replica;
+        replica.set_egress_port(*trunk_id);
+        replica.set_instance(replication_id);
+        *result.add_replicas() = replica;
+      }
     }
     // Sort replicas by instance and port.
     std::sort(result.mutable_replicas()->begin(),
@@ -3,9 +3,11 @@
 #ifndef STRATUM_HAL_LIB_BAREFOOT_BFRT_PRE_MANAGER_H_
 #define STRATUM_HAL_LIB_BAREFOOT_BFRT_PRE_MANAGER_H_
 
+#include <map>
 #include <memory>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/synchronization/mutex.h"
 #include "p4/v1/p4runtime.grpc.pb.h"
@@ -29,10 +31,29 @@ class BfrtPreManager {
  public:
   virtual ~BfrtPreManager();
 
-  // Pushes a ForwardingPipelineConfig.
+  // Pushes the chassis config. The trunk ports of the node become multicast
+  // LAGs in the PRE: a replica whose egress port is the ID of a trunk port is
+  // sent to one of the trunk members. Membership changes of existing trunks
+  // are applied in place, the multicast groups are not rewritten. The LAG ID
+  // of a removed trunk is not given to a new trunk while multicast nodes
+  // still replicate to it.
+  virtual ::util::Status PushChassisConfig(const ChassisConfig& config,
+                                           uint64 node_id)
+      LOCKS_EXCLUDED(lock_);
+
+  // Pushes a ForwardingPipelineConfig. The pipeline push resets the PRE, so
+  // the multicast LAGs and the forwarding state of the down ports are
+  // programmed again.
   virtual ::util::Status PushForwardingPipelineConfig(
       const BfrtDeviceConfig& config) LOCKS_EXCLUDED(lock_);
 
+  // Updates the PRE after a port state change. The PRE stops replicating to a
+  // down port in all multicast groups with a single write of its forwarding
+  // state, and the LAGs which contain the port are rewritten to their up
+  // members. The port ID is the SDN port ID of a singleton port.
+  virtual ::util::Status UpdatePortState(uint32 port_id, PortState new_state)
+      LOCKS_EXCLUDED(lock_);
+
   // Writes a PRE entry.
   virtual ::util::Status WritePreEntry(
       std::shared_ptr<BfSdeInterface::SessionInterface> session,
@@ -95,9 +116,79 @@ class BfrtPreManager {
       const ::p4::v1::MulticastGroupEntry& entry)
       EXCLUSIVE_LOCKS_REQUIRED(lock_);
 
+  // Updates the multicast nodes of a group to the replicas in the entry.
+  // Current nodes that already replicate an instance to the same set of ports
+  // are reused, only the nodes for new or changed instances are created. The
+  // current nodes that are no longer needed are returned in stale_node_ids
+  // and must be deleted after the group has been moved to the new nodes.
+  ::util::StatusOr<std::vector<uint32>> UpdateMulticastNodes(
+      std::shared_ptr<BfSdeInterface::SessionInterface> session,
+      const ::p4::v1::MulticastGroupEntry& entry,
+      const std::vector<uint32>& current_node_ids,
+      std::vector<uint32>* stale_node_ids) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Multicast egress ports of a multicast node.
+  struct MulticastNodeReplicas {
+    std::vector<uint32> ports;
+    std::vector<uint32> mc_lag_ids;
+  };
+
+  // A trunk port programmed as a multicast LAG.
+  struct MulticastLag {
+    uint32 mc_lag_id = 0;
+    // SDK port IDs of the trunk members, sorted.
+    std::vector<uint32> member_ports;
+  };
+
+  // Groups the replicas of a multicast group entry by instance (rid). Egress
+  // ports which are trunk ports are replaced by their multicast LAG ID. The
+  // ports and LAG IDs are sorted.
+  ::util::StatusOr<absl::flat_hash_map<uint32, MulticastNodeReplicas>>
+  GetMulticastNodeReplicas(const ::p4::v1::MulticastGroupEntry& entry) const
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Returns the members of a multicast LAG which are not down.
+  std::vector<uint32> GetUpMemberPorts(const MulticastLag& lag) const
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Writes all multicast LAGs and the forwarding state of all down ports,
+  // after the PRE was reset.
+  ::util::Status ProgramMulticastLagsAndPortStates()
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
   // Reader-writer lock used to protect access to pipeline state.
   mutable absl::Mutex lock_;
 
+  // Whether a pipeline has been pushed. The PRE can only be programmed after
+  // the first pipeline push.
+  bool pipeline_initialized_ GUARDED_BY(lock_);
+
+  // Map from trunk port ID to the multicast LAG programmed for it.
+  std::map<uint32, MulticastLag> trunk_id_to_mc_lag_ GUARDED_BY(lock_);
+
+  // Map from multicast LAG ID to trunk port ID. This contains the inverse
+  // mapping of trunk_id_to_mc_lag_.
+  std::map<uint32, uint32> mc_lag_id_to_trunk_id_ GUARDED_BY(lock_);
+
+  // Map from multicast node ID to the multicast LAG IDs the node replicates
+  // to, for the nodes written since the last pipeline push which replicate to
+  // at least one LAG.
+  absl::flat_hash_map<uint32, std::vector<uint32>> mc_node_id_to_mc_lag_ids_
+      GUARDED_BY(lock_);
+
+  // Map from (SDN) singleton port ID to SDK port ID, updated as part of each
+  // chassis config push.
+  absl::flat_hash_map<uint32, uint32> port_id_to_sdk_port_id_
+      GUARDED_BY(lock_);
+
+  // Map from SDK port ID to the IDs of the trunks which contain the port.
+  absl::flat_hash_map<uint32, std::vector<uint32>> sdk_port_id_to_trunk_ids_
+      GUARDED_BY(lock_);
+
+  // SDK port IDs of the ports which are down. The PRE does not replicate to
+  // these ports.
+  absl::flat_hash_set<uint32> down_sdk_ports_ GUARDED_BY(lock_);
+
   // Pointer to a BfSdeInterface implementation that wraps all the SDE calls.
   BfSdeInterface* bf_sde_interface_ = nullptr;  // not owned by this class.
 
@@ -15,15 +15,16 @@ namespace barefoot {
 
 class BfrtPreManagerMock : public BfrtPreManager {
  public:
-  // MOCK_METHOD1(PushChassisConfig,
-  //              ::util::Status(const BfrtDeviceConfig& config, uint64
-  //              node_id));
+  MOCK_METHOD2(PushChassisConfig,
+               ::util::Status(const ChassisConfig& config, uint64 node_id));
   // MOCK_METHOD2(VerifyChassisConfig,
   //              ::util::Status(const ChassisConfig& config, uint64 node_id));
   MOCK_METHOD1(PushForwardingPipelineConfig,
                ::util::Status(const BfrtDeviceConfig& config));
   MOCK_METHOD1(VerifyForwardingPipelineConfig,
                ::util::Status(const BfrtDeviceConfig& config));
+  MOCK_METHOD2(UpdatePortState,
+               ::util::Status(uint32 port_id, PortState new_state));
   MOCK_METHOD3(WritePreEntry,
                ::util::Status(
                    std::shared_ptr<BfSdeInterface::SessionInterface> session,
@@ -3,7 +3,9 @@
 
 #include "stratum/hal/lib/barefoot/bfrt_pre_manager.h"
 
+#include <map>
 #include <string>
+#include <vector>
 
 #include "absl/memory/memory.h"
 #include "gmock/gmock.h"
@@ -14,6 +16,7 @@
 #include "stratum/hal/lib/common/writer_mock.h"
 #include "stratum/lib/test_utils/matchers.h"
 #include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
 
 namespace stratum {
 namespace hal {
@@ -22,9 +25,11 @@ namespace barefoot {
 using test_utils::EqualsProto;
 using ::testing::_;
 using ::testing::DoAll;
+using ::testing::ElementsAre;
 using ::testing::HasSubstr;
 using ::testing::Invoke;
 using ::testing::InvokeWithoutArgs;
+using ::testing::NotNull;
 using ::testing::Return;
 using ::testing::SetArgPointee;
 using ::testing::StrictMock;
@@ -41,7 +46,103 @@ class BfrtPreManagerTest : public ::testing::Test {
         kDevice1);
   }
 
+  // A multicast node as reported by the SDE.
+  struct MulticastNode {
+    uint32 node_id;
+    int instance;
+    std::vector<uint32> ports;
+  };
+
+  // Sets up the SDE mock to report the given nodes in a multicast group.
+  void ExpectMulticastNodes(uint32 group_id,
+                            const std::vector<MulticastNode>& nodes) {
+    std::vector<uint32> node_ids;
+    for (const auto& node : nodes) {
+      node_ids.push_back(node.node_id);
+      EXPECT_CALL(*bf_sde_wrapper_mock_,
+                  GetMulticastNode(kDevice1, _, node.node_id, NotNull(),
+                                   NotNull(), NotNull()))
+          .WillOnce(DoAll(SetArgPointee<3>(node.instance),
+                          SetArgPointee<4>(std::vector<uint32>{}),
+                          SetArgPointee<5>(node.ports),
+                          Return(::util::OkStatus())));
+    }
+    EXPECT_CALL(*bf_sde_wrapper_mock_,
+                GetNodesInMulticastGroup(kDevice1, _, group_id))
+        .WillOnce(Return(node_ids));
+  }
+
+  // Writes a MODIFY of the given multicast group entry.
+  ::util::Status ModifyMulticastGroup(
+      const ::p4::v1::PacketReplicationEngineEntry& entry) {
+    EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+                TranslatePacketReplicationEngineEntry(EqualsProto(entry), true))
+        .WillOnce(Return(
+            ::util::StatusOr<::p4::v1::PacketReplicationEngineEntry>(entry)));
+    return bfrt_pre_manager_->WritePreEntry(std::make_shared<SessionMock>(),
+                                            ::p4::v1::Update::MODIFY, entry);
+  }
+
+  // Pushes a chassis config with kNumPorts singleton ports and the given trunk
+  // ports, as a map from trunk port ID to member port IDs. The SDK port ID of
+  // a singleton port is its ID plus kSdkPortOffset.
+  ::util::Status PushChassisConfig(
+      const std::map<uint32, std::vector<uint32>>& trunks) {
+    ChassisConfig config;
+    config.add_nodes()->set_id(kNodeId);
+    for (uint32 port = 1; port <= kNumPorts; ++port) {
+      auto* singleton_port = config.add_singleton_ports();
+      singleton_port->set_id(port);
+      singleton_port->set_node(kNodeId);
+      singleton_port->set_slot(1);
+      singleton_port->set_port(port);
+    }
+    for (const auto& trunk : trunks) {
+      auto* trunk_port = config.add_trunk_ports();
+      trunk_port->set_id(trunk.first);
+      trunk_port->set_node(kNodeId);
+      trunk_port->set_type(TrunkPort::STATIC_TRUNK);
+      for (const uint32 member : trunk.second) trunk_port->add_members(member);
+    }
+    EXPECT_CALL(*bf_sde_wrapper_mock_, GetPortIdFromPortKey(kDevice1, _))
+        .Times(kNumPorts)
+        .WillRepeatedly(Invoke(
+            [](int device,
+               const PortKey& port_key) -> ::util::StatusOr<uint32> {
+              return port_key.port + kSdkPortOffset;
+            }));
+    return bfrt_pre_manager_->PushChassisConfig(config, kNodeId);
+  }
+
+  // Expects a new session with one batch of writes.
+  void ExpectBatchSession() {
+    auto session_mock = std::make_shared<SessionMock>();
+    EXPECT_CALL(*bf_sde_wrapper_mock_, CreateSession())
+        .WillOnce(Return(
+            std::shared_ptr<BfSdeInterface::SessionInterface>(session_mock)));
+    EXPECT_CALL(*session_mock, BeginBatch())
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*session_mock, EndBatch())
+        .WillOnce(Return(::util::OkStatus()));
+  }
+
+  // Pushes a chassis config with the given trunk ports and a pipeline, which
+  // programs the multicast LAGs.
+  void PushChassisAndPipelineConfig(
+      const std::map<uint32, std::vector<uint32>>& trunks) {
+    ASSERT_OK(PushChassisConfig(trunks));
+    ExpectBatchSession();
+    EXPECT_CALL(*bf_sde_wrapper_mock_, InsertMulticastLag(kDevice1, _, _, _))
+        .Times(trunks.size())
+        .WillRepeatedly(Return(::util::OkStatus()));
+    ASSERT_OK(bfrt_pre_manager_->PushForwardingPipelineConfig(
+        BfrtDeviceConfig()));
+  }
+
   static constexpr int kDevice1 = 0;
+  static constexpr uint64 kNodeId = 1;
+  static constexpr uint32 kNumPorts = 8;
+  static constexpr uint32 kSdkPortOffset = 100;
 
   // Strict mock to ensure we capture all SDE calls.
   std::unique_ptr<StrictMock<BfSdeMock>> bf_sde_wrapper_mock_;
@@ -50,6 +151,9 @@ class BfrtPreManagerTest : public ::testing::Test {
 };
 
 constexpr int BfrtPreManagerTest::kDevice1;
+constexpr uint64 BfrtPreManagerTest::kNodeId;
+constexpr uint32 BfrtPreManagerTest::kNumPorts;
+constexpr uint32 BfrtPreManagerTest::kSdkPortOffset;
 
 TEST_F(BfrtPreManagerTest, PushForwardingPipelineConfigSuccess) {
   BfrtDeviceConfig config;
@@ -133,9 +237,8 @@ TEST_F(BfrtPreManagerTest, ModifyMulticastGroupSuccess) {
   const std::vector<uint32> new_mc_node_ids = {6543, 3210};
   auto session_mock = std::make_shared<SessionMock>();
 
-  EXPECT_CALL(*bf_sde_wrapper_mock_,
-              GetNodesInMulticastGroup(kDevice1, _, kGroupId))
-      .WillOnce(Return(old_mc_node_ids));
+  ExpectMulticastNodes(kGroupId, {{old_mc_node_ids[0], 432, {5}},
+                                  {old_mc_node_ids[1], 123, {7}}});
   EXPECT_CALL(*bf_sde_wrapper_mock_,
               DeleteMulticastNodes(kDevice1, _,
                                    UnorderedElementsAreArray(old_mc_node_ids)))
@@ -165,6 +268,156 @@ TEST_F(BfrtPreManagerTest, ModifyMulticastGroupSuccess) {
                                              ::p4::v1::Update::MODIFY, entry));
 }
 
+// Adding a replica creates only the node of the new instance.
+TEST_F(BfrtPreManagerTest, ModifyMulticastGroupAddReplicaSuccess) {
+  const std::string kMulticastGroupEntryText = R"pb(
+    multicast_group_entry {
+      multicast_group_id: 55
+      replicas { egress_port: 1 instance: 1 }
+      replicas { egress_port: 2 instance: 1 }
+      replicas { egress_port: 3 instance: 2 }
+      replicas { egress_port: 4 instance: 3 }
+    }
+  )pb";
+  constexpr int kGroupId = 55;
+  const std::vector<uint32> new_egress_ports = {4};
+  const std::vector<uint32> mc_node_ids = {100, 101, 102};
+
+  ExpectMulticastNodes(kGroupId, {{100, 1, {1, 2}}, {101, 2, {3}}});
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              CreateMulticastNode(kDevice1, _, 3, _,
+                                  UnorderedElementsAreArray(new_egress_ports)))
+      .WillOnce(Return(102));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              ModifyMulticastGroup(kDevice1, _, kGroupId,
+                                   UnorderedElementsAreArray(mc_node_ids)))
+      .WillOnce(Return(::util::OkStatus()));
+
+  ::p4::v1::PacketReplicationEngineEntry entry;
+  ASSERT_OK(ParseProtoFromString(kMulticastGroupEntryText, &entry));
+  EXPECT_OK(ModifyMulticastGroup(entry));
+}
+
+// Removing a replica deletes only the node of the removed instance, after the
+// group no longer uses it.
+TEST_F(BfrtPreManagerTest, ModifyMulticastGroupRemoveReplicaSuccess) {
+  const std::string kMulticastGroupEntryText = R"pb(
+    multicast_group_entry {
+      multicast_group_id: 55
+      replicas { egress_port: 1 instance: 1 }
+      replicas { egress_port: 2 instance: 1 }
+    }
+  )pb";
+  constexpr int kGroupId = 55;
+  const std::vector<uint32> mc_node_ids = {100};
+  const std::vector<uint32> stale_mc_node_ids = {101};
+
+  ExpectMulticastNodes(kGroupId, {{100, 1, {1, 2}}, {101, 2, {3}}});
+  ::testing::InSequence sequence;
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              ModifyMulticastGroup(kDevice1, _, kGroupId,
+                                   UnorderedElementsAreArray(mc_node_ids)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(
+      *bf_sde_wrapper_mock_,
+      DeleteMulticastNodes(kDevice1, _,
+                           UnorderedElementsAreArray(stale_mc_node_ids)))
+      .WillOnce(Return(::util::OkStatus()));
+
+  ::p4::v1::PacketReplicationEngineEntry entry;
+  ASSERT_OK(ParseProtoFromString(kMulticastGroupEntryText, &entry));
+  EXPECT_OK(ModifyMulticastGroup(entry));
+}
+
+// Changing the ports of an instance replaces only the node of that instance.
+TEST_F(BfrtPreManagerTest, ModifyMulticastGroupChangePortsSuccess) {
+  const std::string kMulticastGroupEntryText = R"pb(
+    multicast_group_entry {
+      multicast_group_id: 55
+      replicas { egress_port: 1 instance: 1 }
+      replicas { egress_port: 5 instance: 1 }
+      replicas { egress_port: 3 instance: 2 }
+    }
+  )pb";
+  constexpr int kGroupId = 55;
+  const std::vector<uint32> new_egress_ports = {1, 5};
+  const std::vector<uint32> mc_node_ids = {101, 102};
+  const std::vector<uint32> stale_mc_node_ids = {100};
+
+  ExpectMulticastNodes(kGroupId, {{100, 1, {1, 2}}, {101, 2, {3}}});
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              CreateMulticastNode(kDevice1, _, 1, _,
+                                  UnorderedElementsAreArray(new_egress_ports)))
+      .WillOnce(Return(102));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              ModifyMulticastGroup(kDevice1, _, kGroupId,
+                                   UnorderedElementsAreArray(mc_node_ids)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(
+      *bf_sde_wrapper_mock_,
+      DeleteMulticastNodes(kDevice1, _,
+                           UnorderedElementsAreArray(stale_mc_node_ids)))
+      .WillOnce(Return(::util::OkStatus()));
+
+  ::p4::v1::PacketReplicationEngineEntry entry;
+  ASSERT_OK(ParseProtoFromString(kMulticastGroupEntryText, &entry));
+  EXPECT_OK(ModifyMulticastGroup(entry));
+}
+
+// Reordered replicas leave the group untouched.
+TEST_F(BfrtPreManagerTest, ModifyMulticastGroupReorderReplicasSuccess) {
+  const std::string kMulticastGroupEntryText = R"pb(
+    multicast_group_entry {
+      multicast_group_id: 55
+      replicas { egress_port: 3 instance: 2 }
+      replicas { egress_port: 2 instance: 1 }
+      replicas { egress_port: 1 instance: 1 }
+    }
+  )pb";
+  constexpr int kGroupId = 55;
+
+  ExpectMulticastNodes(kGroupId, {{100, 1, {1, 2}}, {101, 2, {3}}});
+
+  ::p4::v1::PacketReplicationEngineEntry entry;
+  ASSERT_OK(ParseProtoFromString(kMulticastGroupEntryText, &entry));
+  EXPECT_OK(ModifyMulticastGroup(entry));
+}
+
+// A one-replica change to a large group costs one node creation and one node
+// deletion.
+TEST_F(BfrtPreManagerTest, ModifyLargeMulticastGroupSuccess) {
+  constexpr int kGroupId = 55;
+  constexpr int kNumReplicas = 500;
+  const std::vector<uint32> new_egress_ports = {2};
+  const std::vector<uint32> stale_mc_node_ids = {1000 + kNumReplicas};
+
+  std::vector<MulticastNode> nodes;
+  ::p4::v1::PacketReplicationEngineEntry entry;
+  auto* group_entry = entry.mutable_multicast_group_entry();
+  group_entry->set_multicast_group_id(kGroupId);
+  for (int i = 1; i <= kNumReplicas; ++i) {
+    nodes.push_back({static_cast<uint32>(1000 + i), i, {1}});
+    auto* replica = group_entry->add_replicas();
+    replica->set_instance(i);
+    replica->set_egress_port(i == kNumReplicas ? 2 : 1);
+  }
+  ExpectMulticastNodes(kGroupId, nodes);
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              CreateMulticastNode(kDevice1, _, kNumReplicas, _,
+                                  UnorderedElementsAreArray(new_egress_ports)))
+      .WillOnce(Return(2000));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              ModifyMulticastGroup(kDevice1, _, kGroupId, _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(
+      *bf_sde_wrapper_mock_,
+      DeleteMulticastNodes(kDevice1, _,
+                           UnorderedElementsAreArray(stale_mc_node_ids)))
+      .WillOnce(Return(::util::OkStatus()));
+
+  EXPECT_OK(ModifyMulticastGroup(entry));
+}
+
 TEST_F(BfrtPreManagerTest, DeleteMulticastGroupSuccess) {
   const std::string kMulticastGroupEntryText = R"pb(
     multicast_group_entry {
@@ -772,6 +1025,321 @@ TEST_F(BfrtPreManagerTest, ReadCloneSessionWildcardSuccess) {
   EXPECT_OK(bfrt_pre_manager_->ReadPreEntry(session_mock, entry, &writer_mock));
 }
 
+TEST_F(BfrtPreManagerTest, PushChassisConfigProgramsLagsOnPipelinePush) {
+  // The PRE cannot be programmed before the first pipeline push.
+  ASSERT_OK(PushChassisConfig({{1000, {2, 1}}, {1001, {3, 4}}}));
+
+  ExpectBatchSession();
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              InsertMulticastLag(kDevice1, _, 0, ElementsAre(101, 102)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              InsertMulticastLag(kDevice1, _, 1, ElementsAre(103, 104)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_OK(
+      bfrt_pre_manager_->PushForwardingPipelineConfig(BfrtDeviceConfig()));
+}
+
+TEST_F(BfrtPreManagerTest, PushChassisConfigUpdatesChangedLagsOnly) {
+  PushChassisAndPipelineConfig(
+      {{1000, {1, 2}}, {1001, {3, 4}}, {1002, {5, 6}}});
+
+  // Trunk 1000 is unchanged, 1001 loses a member, 1002 is removed and 1003 is
+  // added. The LAG ID of the removed trunk is not reused right away.
+  ExpectBatchSession();
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              ModifyMulticastLag(kDevice1, _, 1, ElementsAre(103)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, DeleteMulticastLag(kDevice1, _, 2))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              InsertMulticastLag(kDevice1, _, 3, ElementsAre(107, 108)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_OK(PushChassisConfig({{1000, {1, 2}}, {1001, {3}}, {1003, {7, 8}}}));
+}
+
+TEST_F(BfrtPreManagerTest, PushChassisConfigKeepsReferencedLagIdsReserved) {
+  PushChassisAndPipelineConfig({{1000, {1, 2}}, {1001, {3, 4}}});
+  const std::string kMulticastGroupEntryText = R"pb(
+    multicast_group_entry {
+      multicast_group_id: 55
+      replicas { egress_port: 1001 instance: 1 }
+    }
+  )pb";
+  ::p4::v1::PacketReplicationEngineEntry entry;
+  ASSERT_OK(ParseProtoFromString(kMulticastGroupEntryText, &entry));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TranslatePacketReplicationEngineEntry(EqualsProto(entry), true))
+      .Times(2)
+      .WillRepeatedly(Return(
+          ::util::StatusOr<::p4::v1::PacketReplicationEngineEntry>(entry)));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              CreateMulticastNode(kDevice1, _, 1, ElementsAre(1),
+                                  ElementsAre()))
+      .WillOnce(Return(7));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              InsertMulticastGroup(kDevice1, _, 55, ElementsAre(7)))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(bfrt_pre_manager_->WritePreEntry(std::make_shared<SessionMock>(),
+                                             ::p4::v1::Update::INSERT, entry));
+
+  // Trunk 1001 is removed while node 7 still replicates to its LAG.
+  ExpectBatchSession();
+  EXPECT_CALL(*bf_sde_wrapper_mock_, DeleteMulticastLag(kDevice1, _, 1))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(PushChassisConfig({{1000, {1, 2}}}));
+
+  // A new trunk does not get the LAG ID of node 7.
+  ExpectBatchSession();
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              InsertMulticastLag(kDevice1, _, 2, ElementsAre(105, 106)))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(PushChassisConfig({{1000, {1, 2}}, {1002, {5, 6}}}));
+
+  // Once the group and its node are deleted, the LAG ID is free again.
+  EXPECT_CALL(*bf_sde_wrapper_mock_, GetNodesInMulticastGroup(kDevice1, _, 55))
+      .WillOnce(Return(std::vector<uint32>{7}));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, DeleteMulticastGroup(kDevice1, _, 55))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              DeleteMulticastNodes(kDevice1, _, ElementsAre(7)))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(bfrt_pre_manager_->WritePreEntry(std::make_shared<SessionMock>(),
+                                             ::p4::v1::Update::DELETE, entry));
+  ExpectBatchSession();
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              InsertMulticastLag(kDevice1, _, 1, ElementsAre(107, 108)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_OK(
+      PushChassisConfig({{1000, {1, 2}}, {1002, {5, 6}}, {1003, {7, 8}}}));
+}
+
+TEST_F(BfrtPreManagerTest, PushChassisConfigInvalidTrunkMemberFail) {
+  PushChassisAndPipelineConfig({{1000, {1, 2}}});
+
+  ::util::Status status = PushChassisConfig({{1000, {1, 2, 9}}});
+  EXPECT_EQ(ERR_INVALID_PARAM, status.error_code());
+  EXPECT_THAT(status.error_message(),
+              HasSubstr("Member 9 of trunk port 1000 is not a singleton port"));
+
+  // The failed push did not change the trunks.
+  EXPECT_OK(PushChassisConfig({{1000, {1, 2}}}));
+}
+
+TEST_F(BfrtPreManagerTest, PushChassisConfigTrunkIdIsSdkPortFail) {
+  ::util::Status status = PushChassisConfig({{101, {1, 2}}});
+  EXPECT_EQ(ERR_INVALID_PARAM, status.error_code());
+  EXPECT_THAT(status.error_message(), HasSubstr("is also an SDK port ID"));
+}
+
+TEST_F(BfrtPreManagerTest, InsertMulticastGroupWithTrunkReplicasSuccess) {
+  PushChassisAndPipelineConfig({{1000, {1, 2}}, {1001, {3, 4}}});
+  const std::string kMulticastGroupEntryText = R"pb(
+    multicast_group_entry {
+      multicast_group_id: 55
+      replicas { egress_port: 1001 instance: 1 }
+      replicas { egress_port: 105 instance: 1 }
+      replicas { egress_port: 1000 instance: 1 }
+    }
+  )pb";
+  ::p4::v1::PacketReplicationEngineEntry entry;
+  ASSERT_OK(ParseProtoFromString(kMulticastGroupEntryText, &entry));
+
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              CreateMulticastNode(kDevice1, _, 1, ElementsAre(0, 1),
+                                  ElementsAre(105)))
+      .WillOnce(Return(7));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              InsertMulticastGroup(kDevice1, _, 55, ElementsAre(7)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TranslatePacketReplicationEngineEntry(EqualsProto(entry), true))
+      .WillOnce(Return(
+          ::util::StatusOr<::p4::v1::PacketReplicationEngineEntry>(entry)));
+  EXPECT_OK(bfrt_pre_manager_->WritePreEntry(std::make_shared<SessionMock>(),
+                                             ::p4::v1::Update::INSERT, entry));
+
+  // A modify which only changes the order of the replicas keeps the node.
+  ::p4::v1::PacketReplicationEngineEntry reordered_entry = entry;
+  auto* replicas =
+      reordered_entry.mutable_multicast_group_entry()->mutable_replicas();
+  replicas->SwapElements(0, 2);
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              GetMulticastNode(kDevice1, _, 7, NotNull(), NotNull(), NotNull()))
+      .WillOnce(DoAll(SetArgPointee<3>(1),
+                      SetArgPointee<4>(std::vector<uint32>{1, 0}),
+                      SetArgPointee<5>(std::vector<uint32>{105}),
+                      Return(::util::OkStatus())));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, GetNodesInMulticastGroup(kDevice1, _, 55))
+      .WillOnce(Return(std::vector<uint32>{7}));
+  EXPECT_OK(ModifyMulticastGroup(reordered_entry));
+}
+
+TEST_F(BfrtPreManagerTest, ReadMulticastGroupWithLagSuccess) {
+  PushChassisAndPipelineConfig({{1000, {1, 2}}});
+  auto session_mock = std::make_shared<SessionMock>();
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  const std::string kMulticastGroupResponseText = R"pb(
+    entities {
+      packet_replication_engine_entry {
+        multicast_group_entry {
+          multicast_group_id: 55
+          replicas { instance: 1 egress_port: 105 }
+          replicas { instance: 1 egress_port: 1000 }
+        }
+      }
+    }
+  )pb";
+  ::p4::v1::ReadResponse resp;
+  ASSERT_OK(ParseProtoFromString(kMulticastGroupResponseText, &resp));
+  ::p4::v1::PacketReplicationEngineEntry entry;
+  entry.mutable_multicast_group_entry()->set_multicast_group_id(55);
+
+  EXPECT_CALL(*bf_sde_wrapper_mock_, GetMulticastGroups(kDevice1, _, 55, _, _))
+      .WillOnce(DoAll(
+          SetArgPointee<3>(std::vector<uint32>{55}),
+          SetArgPointee<4>(std::vector<std::vector<uint32>>{{7}}),
+          Return(::util::OkStatus())));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, GetMulticastNode(kDevice1, _, 7, _, _, _))
+      .WillOnce(DoAll(SetArgPointee<3>(1),
+                      SetArgPointee<4>(std::vector<uint32>{0}),
+                      SetArgPointee<5>(std::vector<uint32>{105}),
+                      Return(::util::OkStatus())));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TranslatePacketReplicationEngineEntry(EqualsProto(entry), true))
+      .WillOnce(Return(
+          ::util::StatusOr<::p4::v1::PacketReplicationEngineEntry>(entry)));
+  const auto& resp_pre_entry =
+      resp.entities(0).packet_replication_engine_entry();
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TranslatePacketReplicationEngineEntry(
+                  EqualsProto(resp_pre_entry), false))
+      .WillOnce(Return(::util::StatusOr<::p4::v1::PacketReplicationEngineEntry>(
+          resp_pre_entry)));
+  EXPECT_CALL(writer_mock, Write(EqualsProto(resp))).WillOnce(Return(true));
+
+  EXPECT_OK(bfrt_pre_manager_->ReadPreEntry(session_mock, entry, &writer_mock));
+}
+
+TEST_F(BfrtPreManagerTest, PortStateChangesDoNotRewriteMulticastGroups) {
+  PushChassisAndPipelineConfig({{1000, {1, 2, 3}}, {1001, {3, 4}}});
+
+  // Thousands of groups replicate to trunk 1000 and to port 5.
+  constexpr int kNumGroups = 4096;
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TranslatePacketReplicationEngineEntry(_, true))
+      .WillRepeatedly(Invoke(
+          [](const ::p4::v1::PacketReplicationEngineEntry& entry, bool to_sdk)
+              -> ::util::StatusOr<::p4::v1::PacketReplicationEngineEntry> {
+            return entry;
+          }));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              CreateMulticastNode(kDevice1, _, 1, ElementsAre(0),
+                                  ElementsAre(105)))
+      .Times(kNumGroups)
+      .WillRepeatedly(Return(7));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, InsertMulticastGroup(kDevice1, _, _, _))
+      .Times(kNumGroups)
+      .WillRepeatedly(Return(::util::OkStatus()));
+  for (int group_id = 1; group_id <= kNumGroups; ++group_id) {
+    ::p4::v1::PacketReplicationEngineEntry entry;
+    auto* group = entry.mutable_multicast_group_entry();
+    group->set_multicast_group_id(group_id);
+    auto* replica = group->add_replicas();
+    replica->set_egress_port(1000);
+    replica->set_instance(1);
+    replica = group->add_replicas();
+    replica->set_egress_port(105);
+    replica->set_instance(1);
+    ASSERT_OK(bfrt_pre_manager_->WritePreEntry(
+        std::make_shared<SessionMock>(), ::p4::v1::Update::INSERT, entry));
+  }
+
+  // Each port event is one forwarding state write, plus one write for each
+  // LAG of the port. The strict SDE mock fails on any group or node write.
+  ExpectBatchSession();
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              SetMulticastPortForwardState(kDevice1, _, 105, false))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_OK(bfrt_pre_manager_->UpdatePortState(5, PORT_STATE_DOWN));
+
+  ExpectBatchSession();
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              SetMulticastPortForwardState(kDevice1, _, 103, false))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              ModifyMulticastLag(kDevice1, _, 0, ElementsAre(101, 102)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              ModifyMulticastLag(kDevice1, _, 1, ElementsAre(104)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_OK(bfrt_pre_manager_->UpdatePortState(3, PORT_STATE_DOWN));
+
+  ExpectBatchSession();
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              SetMulticastPortForwardState(kDevice1, _, 101, false))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              ModifyMulticastLag(kDevice1, _, 0, ElementsAre(102)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_OK(bfrt_pre_manager_->UpdatePortState(1, PORT_STATE_DOWN));
+
+  // Repeated events and events of unknown ports do not write anything.
+  EXPECT_OK(bfrt_pre_manager_->UpdatePortState(1, PORT_STATE_DOWN));
+  EXPECT_OK(bfrt_pre_manager_->UpdatePortState(42, PORT_STATE_DOWN));
+
+  ExpectBatchSession();
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              SetMulticastPortForwardState(kDevice1, _, 103, true))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              ModifyMulticastLag(kDevice1, _, 0, ElementsAre(102, 103)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              ModifyMulticastLag(kDevice1, _, 1, ElementsAre(103, 104)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_OK(bfrt_pre_manager_->UpdatePortState(3, PORT_STATE_UP));
+}
+
+TEST_F(BfrtPreManagerTest, PortStateChangeContinuesOnLagWriteFailure) {
+  PushChassisAndPipelineConfig({{1000, {1, 2}}, {1001, {1, 3}}});
+
+  ExpectBatchSession();
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              SetMulticastPortForwardState(kDevice1, _, 101, false))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              ModifyMulticastLag(kDevice1, _, 0, ElementsAre(102)))
+      .WillOnce(Return(::util::Status(StratumErrorSpace(), ERR_INTERNAL,
+                                      "Some error")));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              ModifyMulticastLag(kDevice1, _, 1, ElementsAre(103)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_FALSE(bfrt_pre_manager_->UpdatePortState(1, PORT_STATE_DOWN).ok());
+}
+
+TEST_F(BfrtPreManagerTest, PipelinePushReprogramsLagsAndDownPorts) {
+  ASSERT_OK(PushChassisConfig({{1000, {1, 2}}}));
+  // Port events before the first pipeline push are only recorded.
+  EXPECT_OK(bfrt_pre_manager_->UpdatePortState(1, PORT_STATE_DOWN));
+  EXPECT_OK(bfrt_pre_manager_->UpdatePortState(4, PORT_STATE_DOWN));
+
+  for (int i = 0; i < 2; ++i) {
+    ExpectBatchSession();
+    EXPECT_CALL(*bf_sde_wrapper_mock_,
+                InsertMulticastLag(kDevice1, _, 0, ElementsAre(102)))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bf_sde_wrapper_mock_,
+                SetMulticastPortForwardState(kDevice1, _, 101, false))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bf_sde_wrapper_mock_,
+                SetMulticastPortForwardState(kDevice1, _, 104, false))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_OK(
+        bfrt_pre_manager_->PushForwardingPipelineConfig(BfrtDeviceConfig()));
+  }
+}
+
 }  // namespace barefoot
 }  // namespace hal
 }  // namespace stratum
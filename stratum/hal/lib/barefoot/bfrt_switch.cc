@@ -67,6 +67,18 @@ BfrtSwitch::~BfrtSwitch() {}
   return DoVerifyChassisConfig(config);
 }
 
+::util::Status BfrtSwitch::PlanChassisConfig(const ChassisConfig& config,
+                                             ChassisConfigPlan* plan) {
+  absl::ReaderMutexLock l(&chassis_lock);
+  // A config which needs a reboot is still planned. The chassis manager
+  // reports it in the plan.
+  ::util::Status status = DoVerifyChassisConfig(config);
+  if (!status.ok() && status.error_code() != ERR_REBOOT_REQUIRED) {
+    return status;
+  }
+  return bf_chassis_manager_->PlanChassisConfig(config, plan);
+}
+
 ::util::Status BfrtSwitch::PushForwardingPipelineConfig(
     uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
   absl::WriterMutexLock l(&chassis_lock);
@@ -175,11 +187,22 @@ BfrtSwitch::~BfrtSwitch() {}
 
 ::util::Status BfrtSwitch::RegisterEventNotifyWriter(
     std::shared_ptr<WriterInterface<GnmiEventPtr>> writer) {
-  return bf_chassis_manager_->RegisterEventNotifyWriter(writer);
+  RETURN_IF_ERROR(bf_chassis_manager_->RegisterEventNotifyWriter(writer));
+  for (const auto& entry : device_id_to_bfrt_node_) {
+    RETURN_IF_ERROR(entry.second->RegisterEventNotifyWriter(writer));
+  }
+  return ::util::OkStatus();
 }
 
 ::util::Status BfrtSwitch::UnregisterEventNotifyWriter() {
-  return bf_chassis_manager_->UnregisterEventNotifyWriter();
+  ::util::Status status = ::util::OkStatus();
+  APPEND_STATUS_IF_ERROR(status,
+                         bf_chassis_manager_->UnregisterEventNotifyWriter());
+  for (const auto& entry : device_id_to_bfrt_node_) {
+    APPEND_STATUS_IF_ERROR(status,
+                           entry.second->UnregisterEventNotifyWriter());
+  }
+  return status;
 }
 
 ::util::Status BfrtSwitch::RetrieveValue(uint64 node_id,
@@ -198,6 +221,7 @@ BfrtSwitch::~BfrtSwitch() {}
       case DataRequest::Request::kNegotiatedPortSpeed:
       case DataRequest::Request::kLacpRouterMac:
       case DataRequest::Request::kPortCounters:
+      case DataRequest::Request::kPortQosCounters:
       case DataRequest::Request::kForwardingViability:
       case DataRequest::Request::kHealthIndicator:
       case DataRequest::Request::kAutonegStatus:
@@ -225,6 +249,17 @@ BfrtSwitch::~BfrtSwitch() {}
         }
         break;
       }
+      case DataRequest::Request::kTableOccupancy: {
+        auto bfrt_node =
+            GetBfrtNodeFromNodeId(req.table_occupancy().node_id());
+        if (!bfrt_node.ok()) {
+          status.Update(bfrt_node.status());
+        } else {
+          *resp.mutable_table_occupancy() =
+              bfrt_node.ValueOrDie()->GetTableOccupancy();
+        }
+        break;
+      }
       default:
         status =
             MAKE_ERROR(ERR_UNIMPLEMENTED)
@@ -29,6 +29,9 @@ class BfrtSwitch : public SwitchInterface {
       LOCKS_EXCLUDED(chassis_lock);
   ::util::Status VerifyChassisConfig(const ChassisConfig& config) override
       LOCKS_EXCLUDED(chassis_lock);
+  ::util::Status PlanChassisConfig(const ChassisConfig& config,
+                                   ChassisConfigPlan* plan) override
+      LOCKS_EXCLUDED(chassis_lock);
   ::util::Status PushForwardingPipelineConfig(
       uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) override
       LOCKS_EXCLUDED(chassis_lock);
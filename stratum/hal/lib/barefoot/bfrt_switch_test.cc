@@ -381,6 +381,8 @@ TEST_F(BfrtSwitchTest, RegisterEventNotifyWriterTest) {
   EXPECT_CALL(*bf_chassis_manager_mock_, RegisterEventNotifyWriter(writer))
       .WillOnce(Return(::util::OkStatus()))
       .WillOnce(Return(DefaultError()));
+  EXPECT_CALL(*bfrt_node_mock_, RegisterEventNotifyWriter(writer))
+      .WillOnce(Return(::util::OkStatus()));
 
   // Successful BfChassisManager registration.
   EXPECT_OK(bfrt_switch_->RegisterEventNotifyWriter(writer));
@@ -440,6 +442,38 @@ TEST_F(BfrtSwitchTest, RetrieveValueNodeInfo) {
   EXPECT_EQ(error.ToString(), details.at(0).ToString());
 }
 
+TEST_F(BfrtSwitchTest, RetrieveValueTableOccupancy) {
+  PushChassisConfigSuccess();
+
+  WriterMock<DataResponse> writer;
+  DataResponse resp;
+  TableOccupancy occupancy;
+  auto* table = occupancy.add_tables();
+  table->set_id(33583783);
+  table->set_name("Ingress.control.table1");
+  table->set_entries(10);
+  table->set_capacity(1024);
+  EXPECT_CALL(*bfrt_node_mock_, GetTableOccupancy())
+      .WillOnce(Return(occupancy));
+  ExpectMockWriteDataResponse(&writer, &resp);
+
+  DataRequest req;
+  req.add_requests()->mutable_table_occupancy()->set_node_id(kNodeId);
+  std::vector<::util::Status> details;
+
+  EXPECT_OK(bfrt_switch_->RetrieveValue(kNodeId, req, &writer, &details));
+  EXPECT_THAT(resp.table_occupancy(), EqualsProto(occupancy));
+  ASSERT_EQ(details.size(), 1);
+  EXPECT_OK(details.at(0));
+
+  // An unknown node is reported in the details.
+  details.clear();
+  req.mutable_requests(0)->mutable_table_occupancy()->set_node_id(kNodeId + 1);
+  EXPECT_OK(bfrt_switch_->RetrieveValue(kNodeId, req, &writer, &details));
+  ASSERT_EQ(details.size(), 1);
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, details.at(0).error_code());
+}
+
 // TODO(max): add more tests, use BcmSwitch as a reference.
 
 }  // namespace
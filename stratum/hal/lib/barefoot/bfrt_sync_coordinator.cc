@@ -0,0 +1,83 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/barefoot/bfrt_sync_coordinator.h"
+
+#include "absl/memory/memory.h"
+#include "absl/time/clock.h"
+#include "stratum/glue/logging.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+BfrtSyncCoordinator::BfrtSyncCoordinator(absl::Duration freshness)
+    : freshness_(freshness),
+      sync_states_(),
+      sync_count_(0),
+      num_waiters_(0) {}
+
+std::unique_ptr<BfrtSyncCoordinator> BfrtSyncCoordinator::CreateInstance(
+    absl::Duration freshness) {
+  return absl::WrapUnique(new BfrtSyncCoordinator(freshness));
+}
+
+::util::Status BfrtSyncCoordinator::Synchronize(
+    int device, uint32 table_id, SyncType sync_type,
+    const std::function<::util::Status()>& sync_func) {
+  const absl::Time now = absl::Now();
+  std::shared_ptr<SyncState> state;
+  absl::Time start;
+  {
+    absl::MutexLock l(&lock_);
+    std::shared_ptr<SyncState>& entry =
+        sync_states_[std::make_tuple(device, table_id, sync_type)];
+    if (entry == nullptr) entry = std::make_shared<SyncState>();
+    state = entry;
+    if (state->in_flight) {
+      // Join the sync in flight and share its result.
+      const uint64 generation = state->generation;
+      ++num_waiters_;
+      while (state->generation == generation) sync_done_.Wait(&lock_);
+      --num_waiters_;
+      VLOG(2) << "Joined sync of table " << table_id << " on device "
+              << device << ".";
+      return state->last_status;
+    }
+    if (freshness_ > absl::ZeroDuration() &&
+        now - state->last_success_start <= freshness_) {
+      VLOG(2) << "Reusing sync of table " << table_id << " on device "
+              << device << ".";
+      return ::util::OkStatus();
+    }
+    state->in_flight = true;
+    ++sync_count_;
+    start = absl::Now();
+  }
+
+  // Run the sync ourselves, without holding the lock.
+  ::util::Status status = sync_func();
+
+  absl::MutexLock l(&lock_);
+  state->in_flight = false;
+  ++state->generation;
+  state->last_status = status;
+  if (status.ok()) state->last_success_start = start;
+  sync_done_.SignalAll();
+
+  return status;
+}
+
+uint64 BfrtSyncCoordinator::GetSyncCount() const {
+  absl::MutexLock l(&lock_);
+  return sync_count_;
+}
+
+void BfrtSyncCoordinator::Reset() {
+  absl::MutexLock l(&lock_);
+  sync_states_.clear();
+}
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
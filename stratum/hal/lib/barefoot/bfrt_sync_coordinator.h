@@ -0,0 +1,112 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_BAREFOOT_BFRT_SYNC_COORDINATOR_H_
+#define STRATUM_HAL_LIB_BAREFOOT_BFRT_SYNC_COORDINATOR_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <tuple>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+// A helper class that coalesces hardware syncs (e.g. counter or register
+// syncs) of BfRt tables. A sync of a given (device, table, sync type) is only
+// ever in flight once: callers arriving while a sync is in flight wait for it
+// to complete and share its result, instead of issuing a sync of their own.
+// In addition, a successful sync started within the freshness bound of a new
+// call is reused without touching the hardware again.
+class BfrtSyncCoordinator {
+ public:
+  // The kind of state a sync brings up to date.
+  enum SyncType {
+    kCounters,
+    kRegisters,
+  };
+
+  // Runs sync_func to synchronize the given table, unless the sync can be
+  // joined or reused as described above. Returns the status of the sync that
+  // was run or joined. Failed syncs are never reused by later calls.
+  ::util::Status Synchronize(int device, uint32 table_id, SyncType sync_type,
+                             const std::function<::util::Status()>& sync_func)
+      LOCKS_EXCLUDED(lock_);
+
+  // Returns the number of syncs actually run by this instance.
+  uint64 GetSyncCount() const LOCKS_EXCLUDED(lock_);
+
+  // Drops all the recorded syncs, e.g. after a pipeline change. Callers
+  // waiting on a sync in flight still get its result, but later callers do not
+  // join or reuse it.
+  void Reset() LOCKS_EXCLUDED(lock_);
+
+  // Creates a coordinator instance. Back-to-back syncs of the same table
+  // within the given freshness bound are reused. A zero freshness only
+  // coalesces concurrent syncs.
+  static std::unique_ptr<BfrtSyncCoordinator> CreateInstance(
+      absl::Duration freshness);
+
+  // BfrtSyncCoordinator is neither copyable nor movable.
+  BfrtSyncCoordinator(const BfrtSyncCoordinator&) = delete;
+  BfrtSyncCoordinator& operator=(const BfrtSyncCoordinator&) = delete;
+
+ private:
+  // The key identifying a table sync: (device, table_id, sync_type).
+  typedef std::tuple<int, uint32, SyncType> SyncKey;
+
+  // The state of the syncs of a table.
+  struct SyncState {
+    // Whether a sync is currently running.
+    bool in_flight;
+    // Incremented every time a sync completes, used by the waiting callers to
+    // detect the completion of the sync they joined.
+    uint64 generation;
+    // The status of the last completed sync.
+    ::util::Status last_status;
+    // Start time of the last successful sync.
+    absl::Time last_success_start;
+    SyncState()
+        : in_flight(false),
+          generation(0),
+          last_status(),
+          last_success_start(absl::InfinitePast()) {}
+  };
+
+  // Private constructor, we can create the instance by using `CreateInstance`
+  // function only.
+  explicit BfrtSyncCoordinator(absl::Duration freshness);
+
+  // The freshness bound used to reuse previous syncs.
+  const absl::Duration freshness_;
+
+  // Mutex protecting the sync states. Never held while running a sync.
+  mutable absl::Mutex lock_;
+
+  // Signalled every time a sync completes.
+  absl::CondVar sync_done_;
+
+  // Map from sync key to its state. The states are shared with the callers
+  // running or waiting on a sync, so that they outlive a Reset().
+  std::map<SyncKey, std::shared_ptr<SyncState>> sync_states_ GUARDED_BY(lock_);
+
+  // Number of syncs run so far.
+  uint64 sync_count_ GUARDED_BY(lock_);
+
+  // Number of callers currently waiting on a sync in flight.
+  int num_waiters_ GUARDED_BY(lock_);
+
+  friend class BfrtSyncCoordinatorTest;
+};
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_BAREFOOT_BFRT_SYNC_COORDINATOR_H_
@@ -0,0 +1,196 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/barefoot/bfrt_sync_coordinator.h"
+
+#include <memory>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+namespace barefoot {
+
+using ::testing::Invoke;
+using ::testing::MockFunction;
+using ::testing::Return;
+
+class BfrtSyncCoordinatorTest : public ::testing::Test {
+ protected:
+  // Synchronizes the counters of a table through the coordinator, issuing the
+  // sync to sync_mock_ if needed.
+  ::util::Status SyncCounters(BfrtSyncCoordinator* coordinator,
+                              uint32 table_id) {
+    return coordinator->Synchronize(
+        kDevice, table_id, BfrtSyncCoordinator::kCounters,
+        [this, table_id]() { return sync_mock_.Call(table_id); });
+  }
+
+  // Blocks until num_waiters callers are waiting on a sync in flight.
+  static void WaitForWaiters(BfrtSyncCoordinator* coordinator,
+                             int num_waiters) {
+    std::pair<BfrtSyncCoordinator*, int> arg(coordinator, num_waiters);
+    absl::MutexLock l(&coordinator->lock_);
+    coordinator->lock_.Await(absl::Condition(&HasWaiters, &arg));
+  }
+
+  // Called by Await() with the lock of the coordinator held.
+  static bool HasWaiters(std::pair<BfrtSyncCoordinator*, int>* arg) {
+    return arg->first->num_waiters_ >= arg->second;
+  }
+
+  // Spawns num_readers threads reading the counters of the given table. Once
+  // the first sync is started and all the other readers have joined it, the
+  // sync is unblocked. Returns the read statuses.
+  std::vector<::util::Status> ConcurrentReads(BfrtSyncCoordinator* coordinator,
+                                              uint32 table_id, int num_readers,
+                                              absl::Notification* sync_started,
+                                              absl::Notification* release) {
+    std::vector<::util::Status> results(num_readers);
+    std::vector<std::thread> readers;
+    readers.emplace_back(
+        [&]() { results[0] = SyncCounters(coordinator, table_id); });
+    sync_started->WaitForNotification();
+    for (int i = 1; i < num_readers; ++i) {
+      readers.emplace_back(
+          [&, i]() { results[i] = SyncCounters(coordinator, table_id); });
+    }
+    WaitForWaiters(coordinator, num_readers - 1);
+    release->Notify();
+    for (auto& reader : readers) reader.join();
+    return results;
+  }
+
+  static constexpr int kDevice = 0;
+  static constexpr uint32 kTableId1 = 11111;
+  static constexpr uint32 kTableId2 = 22222;
+
+  // Stands in for the SDE sync issued by BfSdeWrapper, which needs a real
+  // device.
+  MockFunction<::util::Status(uint32)> sync_mock_;
+};
+
+constexpr int BfrtSyncCoordinatorTest::kDevice;
+constexpr uint32 BfrtSyncCoordinatorTest::kTableId1;
+constexpr uint32 BfrtSyncCoordinatorTest::kTableId2;
+
+TEST_F(BfrtSyncCoordinatorTest, ConcurrentReadersShareOneSync) {
+  constexpr int kNumReaders = 16;
+  auto coordinator = BfrtSyncCoordinator::CreateInstance(absl::ZeroDuration());
+  absl::Notification sync_started, release;
+  EXPECT_CALL(sync_mock_, Call(kTableId1))
+      .WillOnce(Invoke([&](uint32) {
+        sync_started.Notify();
+        release.WaitForNotification();
+        return ::util::OkStatus();
+      }));
+
+  auto results = ConcurrentReads(coordinator.get(), kTableId1, kNumReaders,
+                                 &sync_started, &release);
+  for (const auto& status : results) EXPECT_OK(status);
+  EXPECT_EQ(1, coordinator->GetSyncCount());
+}
+
+TEST_F(BfrtSyncCoordinatorTest, JoinedReadersGetSyncError) {
+  constexpr int kNumReaders = 4;
+  auto coordinator = BfrtSyncCoordinator::CreateInstance(absl::Hours(1));
+  absl::Notification sync_started, release;
+  EXPECT_CALL(sync_mock_, Call(kTableId1))
+      .WillOnce(Invoke([&](uint32) -> ::util::Status {
+        sync_started.Notify();
+        release.WaitForNotification();
+        return MAKE_ERROR(ERR_OPER_TIMEOUT) << "Sync timeout.";
+      }))
+      .WillOnce(Return(::util::OkStatus()));
+
+  auto results = ConcurrentReads(coordinator.get(), kTableId1, kNumReaders,
+                                 &sync_started, &release);
+  for (const auto& status : results) {
+    EXPECT_EQ(ERR_OPER_TIMEOUT, status.error_code());
+  }
+  // A failed sync is not reused, even within the freshness bound.
+  EXPECT_OK(SyncCounters(coordinator.get(), kTableId1));
+  EXPECT_EQ(2, coordinator->GetSyncCount());
+}
+
+TEST_F(BfrtSyncCoordinatorTest, BackToBackReadsWithoutFreshnessSyncAgain) {
+  auto coordinator = BfrtSyncCoordinator::CreateInstance(absl::ZeroDuration());
+  EXPECT_CALL(sync_mock_, Call(kTableId1))
+      .Times(3)
+      .WillRepeatedly(Return(::util::OkStatus()));
+
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_OK(SyncCounters(coordinator.get(), kTableId1));
+  }
+  EXPECT_EQ(3, coordinator->GetSyncCount());
+}
+
+TEST_F(BfrtSyncCoordinatorTest, BackToBackReadsWithinFreshnessReuseSync) {
+  constexpr absl::Duration kFreshness = absl::Milliseconds(200);
+  auto coordinator = BfrtSyncCoordinator::CreateInstance(kFreshness);
+  EXPECT_CALL(sync_mock_, Call(kTableId1))
+      .Times(2)
+      .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(sync_mock_, Call(kTableId2))
+      .WillOnce(Return(::util::OkStatus()));
+
+  // Reads within the freshness bound reuse the first sync.
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_OK(SyncCounters(coordinator.get(), kTableId1));
+  }
+  EXPECT_EQ(1, coordinator->GetSyncCount());
+  // Other tables are synced independently.
+  EXPECT_OK(SyncCounters(coordinator.get(), kTableId2));
+  EXPECT_EQ(2, coordinator->GetSyncCount());
+  // Once the last sync is stale, the table is synced again.
+  absl::SleepFor(2 * kFreshness);
+  EXPECT_OK(SyncCounters(coordinator.get(), kTableId1));
+  EXPECT_EQ(3, coordinator->GetSyncCount());
+}
+
+TEST_F(BfrtSyncCoordinatorTest, SyncTypesAreIndependent) {
+  auto coordinator = BfrtSyncCoordinator::CreateInstance(absl::Hours(1));
+  EXPECT_CALL(sync_mock_, Call(kTableId1))
+      .WillOnce(Return(::util::OkStatus()));
+  int register_syncs = 0;
+  auto sync_registers = [&register_syncs]() {
+    ++register_syncs;
+    return ::util::OkStatus();
+  };
+
+  EXPECT_OK(SyncCounters(coordinator.get(), kTableId1));
+  EXPECT_OK(coordinator->Synchronize(
+      kDevice, kTableId1, BfrtSyncCoordinator::kRegisters, sync_registers));
+  EXPECT_OK(coordinator->Synchronize(
+      kDevice, kTableId1, BfrtSyncCoordinator::kRegisters, sync_registers));
+  EXPECT_EQ(1, register_syncs);
+  EXPECT_EQ(2, coordinator->GetSyncCount());
+}
+
+TEST_F(BfrtSyncCoordinatorTest, ResetDropsPreviousSyncs) {
+  auto coordinator = BfrtSyncCoordinator::CreateInstance(absl::Hours(1));
+  EXPECT_CALL(sync_mock_, Call(kTableId1))
+      .Times(2)
+      .WillRepeatedly(Return(::util::OkStatus()));
+
+  EXPECT_OK(SyncCounters(coordinator.get(), kTableId1));
+  EXPECT_OK(SyncCounters(coordinator.get(), kTableId1));
+  coordinator->Reset();
+  EXPECT_OK(SyncCounters(coordinator.get(), kTableId1));
+  EXPECT_EQ(2, coordinator->GetSyncCount());
+}
+
+}  // namespace barefoot
+}  // namespace hal
+}  // namespace stratum
@@ -12,10 +12,12 @@
 #include "absl/synchronization/notification.h"
 #include "gflags/gflags.h"
 #include "p4/config/v1/p4info.pb.h"
+#include "stratum/glue/gtl/map_util.h"
 #include "stratum/glue/status/status_macros.h"
 #include "stratum/hal/lib/barefoot/bfrt_constants.h"
 #include "stratum/hal/lib/barefoot/utils.h"
 #include "stratum/hal/lib/p4/utils.h"
+#include "stratum/lib/macros.h"
 #include "stratum/lib/utils.h"
 
 DEFINE_uint32(
@@ -34,6 +36,8 @@ BfrtTableManager::BfrtTableManager(
       bf_sde_interface_(ABSL_DIE_IF_NULL(bf_sde_interface)),
       bfrt_p4runtime_translator_(ABSL_DIE_IF_NULL(bfrt_p4runtime_translator)),
       p4_info_manager_(nullptr),
+      gnmi_event_writer_(nullptr),
+      node_id_(0),
       device_(device) {}
 
 BfrtTableManager::BfrtTableManager()
@@ -41,6 +45,8 @@ BfrtTableManager::BfrtTableManager()
       bf_sde_interface_(nullptr),
       bfrt_p4runtime_translator_(nullptr),
       p4_info_manager_(nullptr),
+      gnmi_event_writer_(nullptr),
+      node_id_(0),
       device_(-1) {}
 
 BfrtTableManager::~BfrtTableManager() = default;
@@ -52,6 +58,14 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
       mode, bf_sde_interface, bfrt_p4runtime_translator, device));
 }
 
+::util::Status BfrtTableManager::PushChassisConfig(const ChassisConfig& config,
+                                                  uint64 node_id) {
+  absl::WriterMutexLock l(&gnmi_event_lock_);
+  node_id_ = node_id;
+
+  return ::util::OkStatus();
+}
+
 ::util::Status BfrtTableManager::PushForwardingPipelineConfig(
     const BfrtDeviceConfig& config) {
   absl::WriterMutexLock l(&lock_);
@@ -62,6 +76,12 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
       absl::make_unique<P4InfoManager>(p4_info);
   RETURN_IF_ERROR(p4_info_manager->InitializeAndVerify());
   p4_info_manager_ = std::move(p4_info_manager);
+  // A pipeline push wipes all action profile groups. Port states stay valid.
+  watch_port_groups_.clear();
+  watch_port_to_group_keys_.clear();
+  // The pipeline push also wipes all table entries.
+  occupancy_tracker_.Reset(p4_info);
+  ReadTableCapacities();
 
   return ::util::OkStatus();
 }
@@ -243,13 +263,15 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
 ::util::Status BfrtTableManager::WriteTableEntry(
     std::shared_ptr<BfSdeInterface::SessionInterface> session,
     const ::p4::v1::Update::Type type,
-    const ::p4::v1::TableEntry& table_entry) {
+    const ::p4::v1::TableEntry& table_entry,
+    ::google::protobuf::Arena* arena) {
   RET_CHECK(type != ::p4::v1::Update::UNSPECIFIED)
       << "Invalid update type " << type;
   absl::ReaderMutexLock l(&lock_);
-  ASSIGN_OR_RETURN(const auto& translated_table_entry,
+  ASSIGN_OR_RETURN(const ::p4::v1::TableEntry* translated,
                    bfrt_p4runtime_translator_->TranslateTableEntry(
-                       table_entry, /*to_sdk=*/true));
+                       table_entry, /*to_sdk=*/true, arena));
+  const ::p4::v1::TableEntry& translated_table_entry = *translated;
 
   ASSIGN_OR_RETURN(auto table, p4_info_manager_->FindTableByID(
                                    translated_table_entry.table_id()));
@@ -292,6 +314,7 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
                << "Unsupported update type: " << type << " in table entry "
                << translated_table_entry.ShortDebugString() << ".";
     }
+    UpdateTableOccupancy(translated_table_entry.table_id(), type);
   } else {
     RET_CHECK(type == ::p4::v1::Update::MODIFY)
         << "The table default entry can only be modified.";
@@ -319,27 +342,28 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
 
 // TODO(max): the need for the original request might go away when the table
 // data is correctly initialized with only the fields we care about.
-::util::StatusOr<::p4::v1::TableEntry> BfrtTableManager::BuildP4TableEntry(
+::util::Status BfrtTableManager::BuildP4TableEntry(
     const ::p4::v1::TableEntry& request,
     const BfSdeInterface::TableKeyInterface* table_key,
-    const BfSdeInterface::TableDataInterface* table_data) {
-  ::p4::v1::TableEntry result;
-
+    const BfSdeInterface::TableDataInterface* table_data,
+    ::p4::v1::TableEntry* result) {
   ASSIGN_OR_RETURN(auto table,
                    p4_info_manager_->FindTableByID(request.table_id()));
-  result.set_table_id(request.table_id());
+  result->set_table_id(request.table_id());
 
   bool has_priority_field = false;
   // Match keys
   for (const auto& expected_match_field : table.match_fields()) {
-    ::p4::v1::FieldMatch match;  // Added to the entry later.
-    match.set_field_id(expected_match_field.id());
+    // Removed from the entry later if it is a don't care match.
+    ::p4::v1::FieldMatch* match = result->add_match();
+    match->set_field_id(expected_match_field.id());
     switch (expected_match_field.match_type()) {
       case ::p4::config::v1::MatchField::EXACT: {
-        RETURN_IF_ERROR(table_key->GetExact(
-            expected_match_field.id(), match.mutable_exact()->mutable_value()));
-        if (!IsDontCareMatch(match.exact())) {
-          *result.add_match() = match;
+        RETURN_IF_ERROR(
+            table_key->GetExact(expected_match_field.id(),
+                                match->mutable_exact()->mutable_value()));
+        if (IsDontCareMatch(match->exact())) {
+          result->mutable_match()->RemoveLast();
         }
         break;
       }
@@ -348,10 +372,10 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
         std::string value, mask;
         RETURN_IF_ERROR(
             table_key->GetTernary(expected_match_field.id(), &value, &mask));
-        match.mutable_ternary()->set_value(value);
-        match.mutable_ternary()->set_mask(mask);
-        if (!IsDontCareMatch(match.ternary())) {
-          *result.add_match() = match;
+        match->mutable_ternary()->set_value(value);
+        match->mutable_ternary()->set_mask(mask);
+        if (IsDontCareMatch(match->ternary())) {
+          result->mutable_match()->RemoveLast();
         }
         break;
       }
@@ -360,10 +384,10 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
         uint16 prefix_length;
         RETURN_IF_ERROR(table_key->GetLpm(expected_match_field.id(), &prefix,
                                           &prefix_length));
-        match.mutable_lpm()->set_value(prefix);
-        match.mutable_lpm()->set_prefix_len(prefix_length);
-        if (!IsDontCareMatch(match.lpm())) {
-          *result.add_match() = match;
+        match->mutable_lpm()->set_value(prefix);
+        match->mutable_lpm()->set_prefix_len(prefix_length);
+        if (IsDontCareMatch(match->lpm())) {
+          result->mutable_match()->RemoveLast();
         }
         break;
       }
@@ -372,10 +396,10 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
         std::string low, high;
         RETURN_IF_ERROR(
             table_key->GetRange(expected_match_field.id(), &low, &high));
-        match.mutable_range()->set_low(low);
-        match.mutable_range()->set_high(high);
-        if (!IsDontCareMatch(match.range(), expected_match_field.bitwidth())) {
-          *result.add_match() = match;
+        match->mutable_range()->set_low(low);
+        match->mutable_range()->set_high(high);
+        if (IsDontCareMatch(match->range(), expected_match_field.bitwidth())) {
+          result->mutable_match()->RemoveLast();
         }
         break;
       }
@@ -400,7 +424,7 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
     RETURN_IF_ERROR(table_key->GetPriority(&bf_priority));
     ASSIGN_OR_RETURN(uint64 p4rt_priority,
                      ConvertPriorityFromBfrtToP4rt(bf_priority));
-    result.set_priority(p4rt_priority);
+    result->set_priority(p4rt_priority);
   }
 
   // Action and action data
@@ -409,11 +433,11 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
   // TODO(max): perform check if action id is valid for this table.
   if (action_id) {
     ASSIGN_OR_RETURN(auto action, p4_info_manager_->FindActionByID(action_id));
-    result.mutable_action()->mutable_action()->set_action_id(action_id);
+    result->mutable_action()->mutable_action()->set_action_id(action_id);
     for (const auto& expected_param : action.params()) {
       std::string value;
       RETURN_IF_ERROR(table_data->GetParam(expected_param.id(), &value));
-      auto* param = result.mutable_action()->mutable_action()->add_params();
+      auto* param = result->mutable_action()->mutable_action()->add_params();
       param->set_param_id(expected_param.id());
       param->set_value(value);
     }
@@ -422,24 +446,30 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
   // Action profile member id
   uint64 action_member_id;
   if (table_data->GetActionMemberId(&action_member_id).ok()) {
-    result.mutable_action()->set_action_profile_member_id(action_member_id);
+    result->mutable_action()->set_action_profile_member_id(action_member_id);
   }
 
   // Action profile group id
   uint64 selector_group_id;
   if (table_data->GetSelectorGroupId(&selector_group_id).ok()) {
-    result.mutable_action()->set_action_profile_group_id(selector_group_id);
+    result->mutable_action()->set_action_profile_group_id(selector_group_id);
   }
 
   // Counter data, if applicable.
   uint64 bytes, packets;
   if (request.has_counter_data() &&
       table_data->GetCounterData(&bytes, &packets).ok()) {
-    result.mutable_counter_data()->set_byte_count(bytes);
-    result.mutable_counter_data()->set_packet_count(packets);
+    result->mutable_counter_data()->set_byte_count(bytes);
+    result->mutable_counter_data()->set_packet_count(packets);
   }
 
-  return result;
+  return ::util::OkStatus();
+}
+
+::util::Status BfrtTableManager::TranslateReadTableEntry(
+    ::p4::v1::TableEntry* entry) {
+  return bfrt_p4runtime_translator_->TranslateTableEntryInPlace(
+      entry, /*to_sdk=*/false);
 }
 
 ::util::Status BfrtTableManager::ReadSingleTableEntry(
@@ -455,13 +485,11 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
   RETURN_IF_ERROR(BuildTableKey(table_entry, table_key.get()));
   RETURN_IF_ERROR(bf_sde_interface_->GetTableEntry(
       device_, session, table_id, table_key.get(), table_data.get()));
-  ASSIGN_OR_RETURN(
-      ::p4::v1::TableEntry result,
-      BuildP4TableEntry(table_entry, table_key.get(), table_data.get()));
   ::p4::v1::ReadResponse resp;
-  ASSIGN_OR_RETURN(*resp.add_entities()->mutable_table_entry(),
-                   bfrt_p4runtime_translator_->TranslateTableEntry(
-                       result, /*to_sdk=*/false));
+  ::p4::v1::TableEntry* result = resp.add_entities()->mutable_table_entry();
+  RETURN_IF_ERROR(BuildP4TableEntry(table_entry, table_key.get(),
+                                    table_data.get(), result));
+  RETURN_IF_ERROR(TranslateReadTableEntry(result));
   VLOG(1) << "ReadSingleTableEntry resp " << resp.DebugString();
   if (!writer->Write(resp)) {
     return MAKE_ERROR(ERR_INTERNAL) << "Write to stream for failed.";
@@ -486,17 +514,14 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
                        table_id, table_entry.action().action().action_id()));
   RETURN_IF_ERROR(bf_sde_interface_->GetDefaultTableEntry(
       device_, session, table_id, table_data.get()));
-  // FIXME: BuildP4TableEntry is not suitable for default entries.
-  ASSIGN_OR_RETURN(
-      ::p4::v1::TableEntry result,
-      BuildP4TableEntry(table_entry, table_key.get(), table_data.get()));
-  result.set_is_default_action(true);
-  result.clear_match();
-
   ::p4::v1::ReadResponse resp;
-  ASSIGN_OR_RETURN(*resp.add_entities()->mutable_table_entry(),
-                   bfrt_p4runtime_translator_->TranslateTableEntry(
-                       result, /*to_sdk=*/false));
+  ::p4::v1::TableEntry* result = resp.add_entities()->mutable_table_entry();
+  // FIXME: BuildP4TableEntry is not suitable for default entries.
+  RETURN_IF_ERROR(BuildP4TableEntry(table_entry, table_key.get(),
+                                    table_data.get(), result));
+  result->set_is_default_action(true);
+  result->clear_match();
+  RETURN_IF_ERROR(TranslateReadTableEntry(result));
   VLOG(1) << "ReadDefaultTableEntry resp " << resp.DebugString();
   if (!writer->Write(resp)) {
     return MAKE_ERROR(ERR_INTERNAL) << "Write to stream for failed.";
@@ -527,17 +552,16 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
   RETURN_IF_ERROR(bf_sde_interface_->GetAllTableEntries(
       device_, session, table_id, &keys, &datas));
   ::p4::v1::ReadResponse resp;
+  resp.mutable_entities()->Reserve(keys.size());
   for (size_t i = 0; i < keys.size(); ++i) {
     const std::unique_ptr<BfSdeInterface::TableKeyInterface>& table_key =
         keys[i];
     const std::unique_ptr<BfSdeInterface::TableDataInterface>& table_data =
         datas[i];
-    ASSIGN_OR_RETURN(
-        auto result,
-        BuildP4TableEntry(table_entry, table_key.get(), table_data.get()));
-    ASSIGN_OR_RETURN(*resp.add_entities()->mutable_table_entry(),
-                     bfrt_p4runtime_translator_->TranslateTableEntry(
-                         result, /*to_sdk=*/false));
+    ::p4::v1::TableEntry* result = resp.add_entities()->mutable_table_entry();
+    RETURN_IF_ERROR(BuildP4TableEntry(table_entry, table_key.get(),
+                                      table_data.get(), result));
+    RETURN_IF_ERROR(TranslateReadTableEntry(result));
   }
 
   VLOG(1) << "ReadAllTableEntries resp " << resp.DebugString();
@@ -551,12 +575,14 @@ std::unique_ptr<BfrtTableManager> BfrtTableManager::CreateInstance(
 ::util::Status BfrtTableManager::ReadTableEntry(
     std::shared_ptr<BfSdeInterface::SessionInterface> session,
     const ::p4::v1::TableEntry& table_entry,
-    WriterInterface<::p4::v1::ReadResponse>* writer) {
+    WriterInterface<::p4::v1::ReadResponse>* writer,
+    ::google::protobuf::Arena* arena) {
   RET_CHECK(writer) << "Null writer.";
   absl::ReaderMutexLock l(&lock_);
-  ASSIGN_OR_RETURN(const auto& translated_table_entry,
+  ASSIGN_OR_RETURN(const ::p4::v1::TableEntry* translated,
                    bfrt_p4runtime_translator_->TranslateTableEntry(
-                       table_entry, /*to_sdk=*/true));
+                       table_entry, /*to_sdk=*/true, arena));
+  const ::p4::v1::TableEntry& translated_table_entry = *translated;
 
   // We have four cases to handle:
   // 1. table id not set: return all table entries from all tables
@@ -970,6 +996,8 @@ BfrtTableManager::ReadDirectCounterEntry(
       return MAKE_ERROR(ERR_INVALID_PARAM)
              << "Unsupported update type: " << type;
   }
+  UpdateTableOccupancy(translated_action_profile_member.action_profile_id(),
+                       type);
 
   return ::util::OkStatus();
 }
@@ -1051,19 +1079,18 @@ BfrtTableManager::ReadDirectCounterEntry(
       bf_sde_interface_->GetActionSelectorBfRtId(bfrt_act_prof_table_id));
 
   std::vector<uint32> member_ids;
-  std::vector<bool> member_status;
   for (const auto& member : action_profile_group.members()) {
-    RET_CHECK(member.watch_kind_case() ==
-              ::p4::v1::ActionProfileGroup::Member::WATCH_KIND_NOT_SET)
-        << "Watch ports are not supported.";
     RET_CHECK(member.weight() != 0) << "Zero member weights are not allowed.";
     if (member.weight() != 1) {
       return MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
              << "Member weights greater than 1 are not supported.";
     }
     member_ids.push_back(member.member_id());
-    member_status.push_back(true);  // Activate the member.
   }
+  // Members with a watch port are deactivated as long as the port is down.
+  const std::vector<bool> member_status = GetMemberStatus(action_profile_group);
+  const ActionProfileGroupKey key = {bfrt_act_sel_table_id,
+                                     action_profile_group.group_id()};
 
   switch (type) {
     case ::p4::v1::Update::INSERT: {
@@ -1071,6 +1098,7 @@ BfrtTableManager::ReadDirectCounterEntry(
           device_, session, bfrt_act_sel_table_id,
           action_profile_group.group_id(), action_profile_group.max_size(),
           member_ids, member_status));
+      RETURN_IF_ERROR(AddWatchPortGroup(key, action_profile_group));
       break;
     }
     case ::p4::v1::Update::MODIFY: {
@@ -1078,12 +1106,14 @@ BfrtTableManager::ReadDirectCounterEntry(
           device_, session, bfrt_act_sel_table_id,
           action_profile_group.group_id(), action_profile_group.max_size(),
           member_ids, member_status));
+      RETURN_IF_ERROR(AddWatchPortGroup(key, action_profile_group));
       break;
     }
     case ::p4::v1::Update::DELETE: {
       RETURN_IF_ERROR(bf_sde_interface_->DeleteActionProfileGroup(
           device_, session, bfrt_act_sel_table_id,
           action_profile_group.group_id()));
+      RemoveWatchPortGroup(key);
       break;
     }
     default:
@@ -1134,11 +1164,19 @@ BfrtTableManager::ReadDirectCounterEntry(
     result.set_group_id(group_id);
     // Maximum group size
     result.set_max_size(max_group_size);
-    // Members
-    for (const auto& member_id : members) {
-      auto* member = result.add_members();
-      member->set_member_id(member_id);
-      member->set_weight(1);
+    // Members. For groups with watch ports we report the members as written by
+    // the controller, independent of their current status in the SDE.
+    const auto* watch_port_group = gtl::FindOrNull(
+        watch_port_groups_, std::make_pair(bfrt_act_sel_table_id,
+                                           static_cast<uint32>(group_id)));
+    if (watch_port_group != nullptr) {
+      *result.mutable_members() = watch_port_group->members();
+    } else {
+      for (const auto& member_id : members) {
+        auto* member = result.add_members();
+        member->set_member_id(member_id);
+        member->set_weight(1);
+      }
     }
     *resp.add_entities()->mutable_action_profile_group() = result;
   }
@@ -1150,6 +1188,180 @@ BfrtTableManager::ReadDirectCounterEntry(
   return ::util::OkStatus();
 }
 
+::util::Status BfrtTableManager::UpdatePortState(uint32 port_id,
+                                                PortState new_state) {
+  absl::WriterMutexLock l(&lock_);
+  const bool is_down = new_state != PORT_STATE_UP;
+  if (is_down == down_ports_.contains(port_id)) return ::util::OkStatus();
+  if (is_down) {
+    down_ports_.insert(port_id);
+  } else {
+    down_ports_.erase(port_id);
+  }
+
+  const auto* group_keys = gtl::FindOrNull(watch_port_to_group_keys_, port_id);
+  if (group_keys == nullptr || group_keys->empty()) return ::util::OkStatus();
+
+  // Update all affected groups in one batch. We continue on errors so that a
+  // single failing group does not prevent the failover of the others.
+  ASSIGN_OR_RETURN(auto session, bf_sde_interface_->CreateSession());
+  RETURN_IF_ERROR(session->BeginBatch());
+  ::util::Status status = ::util::OkStatus();
+  for (const auto& key : *group_keys) {
+    const auto& action_profile_group = gtl::FindOrDie(watch_port_groups_, key);
+    std::vector<uint32> member_ids;
+    for (const auto& member : action_profile_group.members()) {
+      member_ids.push_back(member.member_id());
+    }
+    APPEND_STATUS_IF_ERROR(
+        status, bf_sde_interface_->ModifyActionProfileGroup(
+                    device_, session, key.first, key.second,
+                    action_profile_group.max_size(), member_ids,
+                    GetMemberStatus(action_profile_group)));
+  }
+  APPEND_STATUS_IF_ERROR(status, session->EndBatch());
+  VLOG(1) << "Updated " << group_keys->size() << " action profile groups "
+          << "watching port " << port_id << " on device " << device_
+          << " after it went " << (is_down ? "down" : "up") << ".";
+
+  return status;
+}
+
+std::vector<bool> BfrtTableManager::GetMemberStatus(
+    const ::p4::v1::ActionProfileGroup& action_profile_group) const {
+  std::vector<bool> member_status;
+  member_status.reserve(action_profile_group.members_size());
+  for (const auto& member : action_profile_group.members()) {
+    bool active = true;
+    switch (member.watch_kind_case()) {
+      case ::p4::v1::ActionProfileGroup::Member::kWatch:
+        active = !down_ports_.contains(member.watch());
+        break;
+      case ::p4::v1::ActionProfileGroup::Member::kWatchPort:
+        active = !down_ports_.contains(
+            ByteStreamToUint<uint32>(member.watch_port()));
+        break;
+      default:
+        break;
+    }
+    member_status.push_back(active);
+  }
+
+  return member_status;
+}
+
+::util::Status BfrtTableManager::RegisterEventNotifyWriter(
+    const std::shared_ptr<WriterInterface<GnmiEventPtr>>& writer) {
+  absl::WriterMutexLock l(&gnmi_event_lock_);
+  gnmi_event_writer_ = writer;
+  return ::util::OkStatus();
+}
+
+::util::Status BfrtTableManager::UnregisterEventNotifyWriter() {
+  absl::WriterMutexLock l(&gnmi_event_lock_);
+  gnmi_event_writer_ = nullptr;
+  return ::util::OkStatus();
+}
+
+TableOccupancy BfrtTableManager::GetTableOccupancy() const {
+  return occupancy_tracker_.GetOccupancy();
+}
+
+void BfrtTableManager::ReadTableCapacities() {
+  auto session = bf_sde_interface_->CreateSession();
+  if (!session.ok()) {
+    LOG(WARNING) << "Failed to read the table capacities from the SDE: "
+                 << session.status();
+    return;
+  }
+  for (uint32 p4_id : occupancy_tracker_.GetIds()) {
+    auto bfrt_id = bf_sde_interface_->GetBfRtId(p4_id);
+    if (!bfrt_id.ok()) continue;
+    auto size = bf_sde_interface_->GetTableSize(device_, session.ValueOrDie(),
+                                                bfrt_id.ValueOrDie());
+    if (!size.ok()) {
+      VLOG(1) << "No SDE capacity for P4 ID " << p4_id << ": "
+              << size.status();
+      continue;
+    }
+    occupancy_tracker_.SetCapacity(p4_id, size.ValueOrDie());
+  }
+}
+
+void BfrtTableManager::UpdateTableOccupancy(uint32 p4_id,
+                                            ::p4::v1::Update::Type type) {
+  TableOccupancy::Table table;
+  bool crossed = false;
+  if (type == ::p4::v1::Update::INSERT) {
+    crossed = occupancy_tracker_.RecordInsert(p4_id, &table);
+  } else if (type == ::p4::v1::Update::DELETE) {
+    crossed = occupancy_tracker_.RecordDelete(p4_id, &table);
+  }
+  if (!crossed) return;
+
+  absl::ReaderMutexLock l(&gnmi_event_lock_);
+  if (!gnmi_event_writer_) return;
+  if (!gnmi_event_writer_->Write(
+          GnmiEventPtr(new TableOccupancyChangedEvent(node_id_, table)))) {
+    // Remove WriterInterface if it is no longer operational.
+    gnmi_event_writer_.reset();
+  }
+}
+
+::util::Status BfrtTableManager::AddWatchPortGroup(
+    const ActionProfileGroupKey& key,
+    const ::p4::v1::ActionProfileGroup& action_profile_group) {
+  RemoveWatchPortGroup(key);
+  bool has_watch_port = false;
+  for (const auto& member : action_profile_group.members()) {
+    uint32 port_id;
+    switch (member.watch_kind_case()) {
+      case ::p4::v1::ActionProfileGroup::Member::kWatch:
+        RET_CHECK(member.watch() >= 0)
+            << "Invalid watch port in member " << member.ShortDebugString()
+            << ".";
+        port_id = member.watch();
+        break;
+      case ::p4::v1::ActionProfileGroup::Member::kWatchPort:
+        RET_CHECK(member.watch_port().size() <= sizeof(uint32))
+            << "Invalid watch port in member " << member.ShortDebugString()
+            << ".";
+        port_id = ByteStreamToUint<uint32>(member.watch_port());
+        break;
+      default:
+        continue;
+    }
+    watch_port_to_group_keys_[port_id].insert(key);
+    has_watch_port = true;
+  }
+  if (has_watch_port) watch_port_groups_[key] = action_profile_group;
+
+  return ::util::OkStatus();
+}
+
+void BfrtTableManager::RemoveWatchPortGroup(const ActionProfileGroupKey& key) {
+  auto it = watch_port_groups_.find(key);
+  if (it == watch_port_groups_.end()) return;
+  for (const auto& member : it->second.members()) {
+    uint32 port_id;
+    switch (member.watch_kind_case()) {
+      case ::p4::v1::ActionProfileGroup::Member::kWatch:
+        port_id = member.watch();
+        break;
+      case ::p4::v1::ActionProfileGroup::Member::kWatchPort:
+        port_id = ByteStreamToUint<uint32>(member.watch_port());
+        break;
+      default:
+        continue;
+    }
+    auto keys_it = watch_port_to_group_keys_.find(port_id);
+    if (keys_it == watch_port_to_group_keys_.end()) continue;
+    keys_it->second.erase(key);
+    if (keys_it->second.empty()) watch_port_to_group_keys_.erase(keys_it);
+  }
+  watch_port_groups_.erase(it);
+}
+
 }  // namespace barefoot
 }  // namespace hal
 }  // namespace stratum
@@ -4,10 +4,13 @@
 #define STRATUM_HAL_LIB_BAREFOOT_BFRT_TABLE_MANAGER_H_
 
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/synchronization/mutex.h"
+#include "google/protobuf/arena.h"
 #include "p4/v1/p4runtime.grpc.pb.h"
 #include "p4/v1/p4runtime.pb.h"
 #include "stratum/glue/integral_types.h"
@@ -17,8 +20,10 @@
 #include "stratum/hal/lib/barefoot/bf_sde_interface.h"
 #include "stratum/hal/lib/barefoot/bfrt_p4runtime_translator.h"
 #include "stratum/hal/lib/common/common.pb.h"
+#include "stratum/hal/lib/common/gnmi_events.h"
 #include "stratum/hal/lib/common/writer_interface.h"
 #include "stratum/hal/lib/p4/p4_info_manager.h"
+#include "stratum/hal/lib/p4/table_occupancy_tracker.h"
 
 namespace stratum {
 namespace hal {
@@ -28,6 +33,12 @@ class BfrtTableManager {
  public:
   virtual ~BfrtTableManager();
 
+  // Saves the ID of the node managed by this class, which is reported in the
+  // table occupancy events.
+  virtual ::util::Status PushChassisConfig(const ChassisConfig& config,
+                                           uint64 node_id)
+      LOCKS_EXCLUDED(gnmi_event_lock_);
+
   // Pushes the pipline info.
   virtual ::util::Status PushForwardingPipelineConfig(
       const BfrtDeviceConfig& config) LOCKS_EXCLUDED(lock_);
@@ -38,17 +49,22 @@ class BfrtTableManager {
       const ::p4::v1::ForwardingPipelineConfig& config) const
       LOCKS_EXCLUDED(lock_);
 
-  // Writes a table entry.
+  // Writes a table entry. Temporary messages are allocated on the given
+  // (non-null) arena, which is meant to be shared by a whole P4Runtime request.
   virtual ::util::Status WriteTableEntry(
       std::shared_ptr<BfSdeInterface::SessionInterface> session,
       const ::p4::v1::Update::Type type,
-      const ::p4::v1::TableEntry& table_entry) LOCKS_EXCLUDED(lock_);
+      const ::p4::v1::TableEntry& table_entry,
+      ::google::protobuf::Arena* arena) LOCKS_EXCLUDED(lock_);
 
-  // Reads the P4 TableEntry(s) matched by the given table entry.
+  // Reads the P4 TableEntry(s) matched by the given table entry. The given
+  // (non-null) arena only holds the translated request; the responses of each
+  // table are built on the stack and released once written.
   virtual ::util::Status ReadTableEntry(
       std::shared_ptr<BfSdeInterface::SessionInterface> session,
       const ::p4::v1::TableEntry& table_entry,
-      WriterInterface<::p4::v1::ReadResponse>* writer) LOCKS_EXCLUDED(lock_);
+      WriterInterface<::p4::v1::ReadResponse>* writer,
+      ::google::protobuf::Arena* arena) LOCKS_EXCLUDED(lock_);
 
   // Modify the counter data of a table entry.
   virtual ::util::Status WriteDirectCounterEntry(
@@ -95,6 +111,13 @@ class BfrtTableManager {
       const ::p4::v1::ActionProfileGroup& action_profile_group,
       WriterInterface<::p4::v1::ReadResponse>* writer) LOCKS_EXCLUDED(lock_);
 
+  // Updates the member status of all action profile groups with members
+  // watching the given port. All affected groups are modified in a single
+  // batched session. The port ID is the SDN port ID, as used in the watch_port
+  // field of P4Runtime action profile group members.
+  virtual ::util::Status UpdatePortState(uint32 port_id, PortState new_state)
+      LOCKS_EXCLUDED(lock_);
+
   // Read the counter data of a table entry.
   virtual ::util::StatusOr<::p4::v1::DirectCounterEntry> ReadDirectCounterEntry(
       std::shared_ptr<BfSdeInterface::SessionInterface> session,
@@ -113,6 +136,20 @@ class BfrtTableManager {
       const ::p4::v1::MeterEntry& meter_entry,
       WriterInterface<::p4::v1::ReadResponse>* writer) LOCKS_EXCLUDED(lock_);
 
+  // Registers a writer for the TableOccupancyChangedEvents sent when a table
+  // or action profile crosses one of the --table_occupancy_thresholds.
+  virtual ::util::Status RegisterEventNotifyWriter(
+      const std::shared_ptr<WriterInterface<GnmiEventPtr>>& writer)
+      LOCKS_EXCLUDED(gnmi_event_lock_);
+
+  // Unregisters the table occupancy event writer.
+  virtual ::util::Status UnregisterEventNotifyWriter()
+      LOCKS_EXCLUDED(gnmi_event_lock_);
+
+  // Returns the number of entries and the capacity of every table and action
+  // profile in the current pipeline. Action profiles count their members.
+  virtual TableOccupancy GetTableOccupancy() const;
+
   // Creates a table manager instance.
   static std::unique_ptr<BfrtTableManager> CreateInstance(
       OperationMode mode, BfSdeInterface* bf_sde_interface,
@@ -162,13 +199,48 @@ class BfrtTableManager {
       SHARED_LOCKS_REQUIRED(lock_);
 
   // Construct a P4RT table entry from a table entry request, table key and
-  // table data.
-  ::util::StatusOr<::p4::v1::TableEntry> BuildP4TableEntry(
+  // table data. The entry is built in place, so that it can live on an arena.
+  ::util::Status BuildP4TableEntry(
       const ::p4::v1::TableEntry& request,
       const BfSdeInterface::TableKeyInterface* table_key,
-      const BfSdeInterface::TableDataInterface* table_data)
+      const BfSdeInterface::TableDataInterface* table_data,
+      ::p4::v1::TableEntry* result) SHARED_LOCKS_REQUIRED(lock_);
+
+  // Translates (from SDK) the entry of a read response in place, without
+  // copying it.
+  ::util::Status TranslateReadTableEntry(::p4::v1::TableEntry* entry)
       SHARED_LOCKS_REQUIRED(lock_);
 
+  // Queries the SDE for the capacity of every table and action profile in the
+  // occupancy tracker. Tables without an SDE capacity keep their P4Info size.
+  void ReadTableCapacities() EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Updates the occupancy of a table or action profile after a successful
+  // write, and sends a TableOccupancyChangedEvent on threshold crossings.
+  void UpdateTableOccupancy(uint32 p4_id, ::p4::v1::Update::Type type)
+      LOCKS_EXCLUDED(gnmi_event_lock_);
+
+  // Identifies an action profile group by (BfRt action selector table ID,
+  // group ID).
+  using ActionProfileGroupKey = std::pair<uint32, uint32>;
+
+  // Returns the SDE member status of each member of the given group. A member
+  // is active unless its watch port is currently down.
+  std::vector<bool> GetMemberStatus(
+      const ::p4::v1::ActionProfileGroup& action_profile_group) const
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Adds the group to the watch port index, if any of its members has a watch
+  // port. Replaces any previous state of the group.
+  ::util::Status AddWatchPortGroup(
+      const ActionProfileGroupKey& key,
+      const ::p4::v1::ActionProfileGroup& action_profile_group)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Removes the group from the watch port index, if present.
+  void RemoveWatchPortGroup(const ActionProfileGroupKey& key)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
   // Determines the mode of operation:
   // - OPERATION_MODE_STANDALONE: when Stratum stack runs independently and
   // therefore needs to do all the SDK initialization itself.
@@ -194,6 +266,32 @@ class BfrtTableManager {
   // to all feature managers.
   std::unique_ptr<P4InfoManager> p4_info_manager_ GUARDED_BY(lock_);
 
+  // Map from group key to the action profile group as written by the
+  // controller, for all groups with at least one watch port member. Used to
+  // recompute member status on port events and to report the original intent
+  // on reads.
+  absl::flat_hash_map<ActionProfileGroupKey, ::p4::v1::ActionProfileGroup>
+      watch_port_groups_ GUARDED_BY(lock_);
+
+  // Reverse index from SDN port ID to the keys of all groups with at least one
+  // member watching the port.
+  absl::flat_hash_map<uint32, absl::flat_hash_set<ActionProfileGroupKey>>
+      watch_port_to_group_keys_ GUARDED_BY(lock_);
+
+  // Set of SDN port IDs which are currently not operationally up.
+  absl::flat_hash_set<uint32> down_ports_ GUARDED_BY(lock_);
+
+  // Counts the entries of every table and action profile. It has its own lock,
+  // as table entries are written under a shared lock_.
+  TableOccupancyTracker occupancy_tracker_;
+
+  // WriterInterface<GnmiEventPtr> object for sending table occupancy events,
+  // and the node ID reported in these events.
+  mutable absl::Mutex gnmi_event_lock_;
+  std::shared_ptr<WriterInterface<GnmiEventPtr>> gnmi_event_writer_
+      GUARDED_BY(gnmi_event_lock_);
+  uint64 node_id_ GUARDED_BY(gnmi_event_lock_);
+
   // Fixed zero-based Tofino device number corresponding to the node/ASIC
   // managed by this class instance. Assigned in the class constructor.
   const int device_;
@@ -15,9 +15,8 @@ namespace barefoot {
 
 class BfrtTableManagerMock : public BfrtTableManager {
  public:
-  // MOCK_METHOD1(PushChassisConfig,
-  //              ::util::Status(const BfrtDeviceConfig& config, uint64
-  //              node_id));
+  MOCK_METHOD2(PushChassisConfig,
+               ::util::Status(const ChassisConfig& config, uint64 node_id));
   // MOCK_METHOD2(VerifyChassisConfig,
   //              ::util::Status(const ChassisConfig& config, uint64 node_id));
   MOCK_METHOD1(PushForwardingPipelineConfig,
@@ -25,16 +24,18 @@ class BfrtTableManagerMock : public BfrtTableManager {
   MOCK_CONST_METHOD1(
       VerifyForwardingPipelineConfig,
       ::util::Status(const ::p4::v1::ForwardingPipelineConfig& config));
-  MOCK_METHOD3(
+  MOCK_METHOD4(
       WriteTableEntry,
       ::util::Status(std::shared_ptr<BfSdeInterface::SessionInterface> session,
                      const ::p4::v1::Update::Type type,
-                     const ::p4::v1::TableEntry& table_entry));
-  MOCK_METHOD3(
+                     const ::p4::v1::TableEntry& table_entry,
+                     ::google::protobuf::Arena* arena));
+  MOCK_METHOD4(
       ReadTableEntry,
       ::util::Status(std::shared_ptr<BfSdeInterface::SessionInterface> session,
                      const ::p4::v1::TableEntry& table_entry,
-                     WriterInterface<::p4::v1::ReadResponse>* writer));
+                     WriterInterface<::p4::v1::ReadResponse>* writer,
+                     ::google::protobuf::Arena* arena));
   MOCK_METHOD3(
       WriteDirectCounterEntry,
       ::util::Status(std::shared_ptr<BfSdeInterface::SessionInterface> session,
@@ -71,6 +72,8 @@ class BfrtTableManagerMock : public BfrtTableManager {
       ::util::Status(std::shared_ptr<BfSdeInterface::SessionInterface> session,
                      const ::p4::v1::ActionProfileGroup& action_profile_group,
                      WriterInterface<::p4::v1::ReadResponse>* writer));
+  MOCK_METHOD2(UpdatePortState,
+               ::util::Status(uint32 port_id, PortState new_state));
   MOCK_METHOD2(ReadDirectCounterEntry,
                ::util::StatusOr<::p4::v1::DirectCounterEntry>(
                    std::shared_ptr<BfSdeInterface::SessionInterface> session,
@@ -85,6 +88,12 @@ class BfrtTableManagerMock : public BfrtTableManager {
       ::util::Status(std::shared_ptr<BfSdeInterface::SessionInterface> session,
                      const ::p4::v1::MeterEntry& meter_entry,
                      WriterInterface<::p4::v1::ReadResponse>* writer));
+  MOCK_METHOD1(
+      RegisterEventNotifyWriter,
+      ::util::Status(
+          const std::shared_ptr<WriterInterface<GnmiEventPtr>>& writer));
+  MOCK_METHOD0(UnregisterEventNotifyWriter, ::util::Status());
+  MOCK_CONST_METHOD0(GetTableOccupancy, TableOccupancy());
 };
 
 }  // namespace barefoot
@@ -3,10 +3,14 @@
 
 #include "stratum/hal/lib/barefoot/bfrt_table_manager.h"
 
+#include <map>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "stratum/glue/status/status_test_util.h"
@@ -14,6 +18,7 @@
 #include "stratum/hal/lib/barefoot/bfrt_constants.h"
 #include "stratum/hal/lib/barefoot/bfrt_p4runtime_translator_mock.h"
 #include "stratum/hal/lib/common/writer_mock.h"
+#include "stratum/hal/lib/p4/utils.h"
 #include "stratum/lib/test_utils/matchers.h"
 #include "stratum/lib/utils.h"
 
@@ -28,12 +33,14 @@ namespace barefoot {
 using test_utils::EqualsProto;
 using ::testing::_;
 using ::testing::ByMove;
+using ::testing::AnyNumber;
 using ::testing::DoAll;
 using ::testing::HasSubstr;
 using ::testing::Invoke;
 using ::testing::InvokeWithoutArgs;
 using ::testing::Optional;
 using ::testing::Return;
+using ::testing::SaveArg;
 using ::testing::SetArgPointee;
 
 class BfrtTableManagerTest : public ::testing::Test {
@@ -157,6 +164,8 @@ class BfrtTableManagerTest : public ::testing::Test {
   std::unique_ptr<BfSdeMock> bf_sde_wrapper_mock_;
   std::unique_ptr<BfrtP4RuntimeTranslatorMock> bfrt_p4runtime_translator_mock_;
   std::unique_ptr<BfrtTableManager> bfrt_table_manager_;
+  // The per-request arena passed to the manager.
+  ::google::protobuf::Arena arena_;
 };
 
 constexpr int BfrtTableManagerTest::kDevice1;
@@ -479,11 +488,12 @@ TEST_F(BfrtTableManagerTest, RejectTableEntryWithDontCareRangeMatch) {
   ::p4::v1::TableEntry entry;
   ASSERT_OK(ParseProtoFromString(kTableEntryText, &entry));
   EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
-              TranslateTableEntry(EqualsProto(entry), true))
-      .WillOnce(Return(::util::StatusOr<::p4::v1::TableEntry>(entry)));
+              TranslateTableEntry(EqualsProto(entry), true, &arena_))
+      .WillOnce(Return(::util::StatusOr<const ::p4::v1::TableEntry*>(&entry)));
 
   ::util::Status ret =
-      bfrt_table_manager_->ReadTableEntry(session_mock, entry, &writer_mock);
+      bfrt_table_manager_->ReadTableEntry(session_mock, entry, &writer_mock,
+                                          &arena_);
   ASSERT_FALSE(ret.ok());
   EXPECT_EQ(ERR_INVALID_PARAM, ret.error_code());
 }
@@ -514,10 +524,10 @@ TEST_F(BfrtTableManagerTest, WriteTableEntryTest) {
   ::p4::v1::TableEntry entry;
   ASSERT_OK(ParseProtoFromString(kTableEntryText, &entry));
   EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
-              TranslateTableEntry(EqualsProto(entry), true))
-      .WillOnce(Return(::util::StatusOr<::p4::v1::TableEntry>(entry)));
+              TranslateTableEntry(EqualsProto(entry), true, &arena_))
+      .WillOnce(Return(::util::StatusOr<const ::p4::v1::TableEntry*>(&entry)));
   EXPECT_OK(bfrt_table_manager_->WriteTableEntry(
-      session_mock, ::p4::v1::Update::INSERT, entry));
+      session_mock, ::p4::v1::Update::INSERT, entry, &arena_));
 }
 
 TEST_F(BfrtTableManagerTest, ModifyTableEntryTest) {
@@ -546,10 +556,10 @@ TEST_F(BfrtTableManagerTest, ModifyTableEntryTest) {
   ::p4::v1::TableEntry entry;
   ASSERT_OK(ParseProtoFromString(kTableEntryText, &entry));
   EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
-              TranslateTableEntry(EqualsProto(entry), true))
-      .WillOnce(Return(::util::StatusOr<::p4::v1::TableEntry>(entry)));
+              TranslateTableEntry(EqualsProto(entry), true, &arena_))
+      .WillOnce(Return(::util::StatusOr<const ::p4::v1::TableEntry*>(&entry)));
   EXPECT_OK(bfrt_table_manager_->WriteTableEntry(
-      session_mock, ::p4::v1::Update::MODIFY, entry));
+      session_mock, ::p4::v1::Update::MODIFY, entry, &arena_));
 }
 
 TEST_F(BfrtTableManagerTest, DeleteTableEntryTest) {
@@ -577,10 +587,138 @@ TEST_F(BfrtTableManagerTest, DeleteTableEntryTest) {
   ::p4::v1::TableEntry entry;
   ASSERT_OK(ParseProtoFromString(kTableEntryText, &entry));
   EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
-              TranslateTableEntry(EqualsProto(entry), true))
-      .WillOnce(Return(::util::StatusOr<::p4::v1::TableEntry>(entry)));
+              TranslateTableEntry(EqualsProto(entry), true, &arena_))
+      .WillOnce(Return(::util::StatusOr<const ::p4::v1::TableEntry*>(&entry)));
+  EXPECT_OK(bfrt_table_manager_->WriteTableEntry(
+      session_mock, ::p4::v1::Update::DELETE, entry, &arena_));
+}
+
+TEST_F(BfrtTableManagerTest, TableOccupancyUnderWriteChurnTest) {
+  ASSERT_OK(PushTestConfig());
+  constexpr int kP4TableId = 33583783;
+  constexpr int kBfRtTableId = 20;
+  auto session_mock = std::make_shared<SessionMock>();
+
+  EXPECT_CALL(*bf_sde_wrapper_mock_, GetBfRtId(kP4TableId))
+      .WillRepeatedly(Return(kBfRtTableId));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, CreateTableKey(kBfRtTableId))
+      .WillRepeatedly(InvokeWithoutArgs([]() {
+        return ::util::StatusOr<
+            std::unique_ptr<BfSdeInterface::TableKeyInterface>>(
+            absl::make_unique<TableKeyMock>());
+      }));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, CreateTableData(kBfRtTableId, _))
+      .WillRepeatedly(InvokeWithoutArgs([]() {
+        return ::util::StatusOr<
+            std::unique_ptr<BfSdeInterface::TableDataInterface>>(
+            absl::make_unique<TableDataMock>());
+      }));
+  // The fourth insert fails in the SDE and must not be counted.
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              InsertTableEntry(kDevice1, _, kBfRtTableId, _, _))
+      .WillOnce(Return(::util::OkStatus()))
+      .WillOnce(Return(::util::OkStatus()))
+      .WillOnce(Return(::util::OkStatus()))
+      .WillOnce(Return(
+          ::util::Status(StratumErrorSpace(), ERR_NO_RESOURCE, "Table full")));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              ModifyTableEntry(kDevice1, _, kBfRtTableId, _, _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              DeleteTableEntry(kDevice1, _, kBfRtTableId, _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  ::p4::v1::TableEntry entry;
+  ASSERT_OK(ParseProtoFromString(kTableEntryText, &entry));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TranslateTableEntry(EqualsProto(entry), true, &arena_))
+      .WillRepeatedly(
+          Return(::util::StatusOr<const ::p4::v1::TableEntry*>(&entry)));
+
+  auto get_entries = [this]() {
+    TableOccupancy occupancy = bfrt_table_manager_->GetTableOccupancy();
+    EXPECT_EQ(1, occupancy.tables_size());
+    EXPECT_EQ(1024U, occupancy.tables(0).capacity());
+    return occupancy.tables(0).entries();
+  };
+  const std::vector<std::pair<::p4::v1::Update::Type, uint64>> kWrites = {
+      {::p4::v1::Update::INSERT, 1}, {::p4::v1::Update::INSERT, 2},
+      {::p4::v1::Update::MODIFY, 2}, {::p4::v1::Update::DELETE, 1},
+      {::p4::v1::Update::MODIFY, 1}, {::p4::v1::Update::INSERT, 2},
+  };
+  for (const auto& write : kWrites) {
+    EXPECT_OK(bfrt_table_manager_->WriteTableEntry(session_mock, write.first,
+                                                   entry, &arena_));
+    EXPECT_EQ(write.second, get_entries());
+  }
+  EXPECT_FALSE(bfrt_table_manager_
+                   ->WriteTableEntry(session_mock, ::p4::v1::Update::INSERT,
+                                     entry, &arena_)
+                   .ok());
+  EXPECT_EQ(2U, get_entries());
+
+  // A pipeline push wipes all entries.
+  ASSERT_OK(PushTestConfig());
+  EXPECT_EQ(0U, get_entries());
+}
+
+TEST_F(BfrtTableManagerTest, TableOccupancyThresholdEventTest) {
+  constexpr uint64 kNodeId = 1;
+  constexpr int kP4TableId = 33583783;
+  constexpr int kBfRtTableId = 20;
+  auto session_mock = std::make_shared<SessionMock>();
+
+  // The SDE capacity replaces the P4Info size of 1024.
+  EXPECT_CALL(*bf_sde_wrapper_mock_, CreateSession())
+      .WillOnce(Return(session_mock));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, GetBfRtId(kP4TableId))
+      .WillRepeatedly(Return(kBfRtTableId));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, GetTableSize(kDevice1, _, kBfRtTableId))
+      .WillOnce(Return(2));
+  ASSERT_OK(bfrt_table_manager_->PushChassisConfig(ChassisConfig(), kNodeId));
+  ASSERT_OK(PushTestConfig());
+
+  auto writer_mock = std::make_shared<WriterMock<GnmiEventPtr>>();
+  ASSERT_OK(bfrt_table_manager_->RegisterEventNotifyWriter(writer_mock));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, CreateTableKey(kBfRtTableId))
+      .WillRepeatedly(InvokeWithoutArgs([]() {
+        return ::util::StatusOr<
+            std::unique_ptr<BfSdeInterface::TableKeyInterface>>(
+            absl::make_unique<TableKeyMock>());
+      }));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, CreateTableData(kBfRtTableId, _))
+      .WillRepeatedly(InvokeWithoutArgs([]() {
+        return ::util::StatusOr<
+            std::unique_ptr<BfSdeInterface::TableDataInterface>>(
+            absl::make_unique<TableDataMock>());
+      }));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              InsertTableEntry(kDevice1, _, kBfRtTableId, _, _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  ::p4::v1::TableEntry entry;
+  ASSERT_OK(ParseProtoFromString(kTableEntryText, &entry));
+  EXPECT_CALL(*bfrt_p4runtime_translator_mock_,
+              TranslateTableEntry(EqualsProto(entry), true, &arena_))
+      .WillRepeatedly(
+          Return(::util::StatusOr<const ::p4::v1::TableEntry*>(&entry)));
+
+  // The first entry fills the table to 50%, below all default thresholds.
+  EXPECT_CALL(*writer_mock, Write(_)).Times(0);
   EXPECT_OK(bfrt_table_manager_->WriteTableEntry(
-      session_mock, ::p4::v1::Update::DELETE, entry));
+      session_mock, ::p4::v1::Update::INSERT, entry, &arena_));
+  ::testing::Mock::VerifyAndClearExpectations(writer_mock.get());
+
+  // The second entry fills the table.
+  GnmiEventPtr event;
+  EXPECT_CALL(*writer_mock, Write(_))
+      .WillOnce(DoAll(SaveArg<0>(&event), Return(true)));
+  EXPECT_OK(bfrt_table_manager_->WriteTableEntry(
+      session_mock, ::p4::v1::Update::INSERT, entry, &arena_));
+  auto* change = dynamic_cast<TableOccupancyChangedEvent*>(event.get());
+  ASSERT_NE(nullptr, change);
+  EXPECT_EQ(kNodeId, change->GetNodeId());
+  EXPECT_EQ("Ingress.control.table1", change->GetTable().name());
+  EXPECT_EQ(2U, change->GetTable().entries());
+  EXPECT_EQ(2U, change->GetTable().capacity());
 }
 
 TEST_F(BfrtTableManagerTest, RejectWriteTableUnspecifiedTypeTest) {
@@ -589,7 +727,7 @@ TEST_F(BfrtTableManagerTest, RejectWriteTableUnspecifiedTypeTest) {
   ::p4::v1::TableEntry entry;
   ASSERT_OK(ParseProtoFromString(kTableEntryText, &entry));
   ::util::Status ret = bfrt_table_manager_->WriteTableEntry(
-      session_mock, ::p4::v1::Update::UNSPECIFIED, entry);
+      session_mock, ::p4::v1::Update::UNSPECIFIED, entry, &arena_);
   ASSERT_FALSE(ret.ok());
   EXPECT_EQ(ERR_INVALID_PARAM, ret.error_code());
   EXPECT_THAT(ret.error_message(), HasSubstr("Invalid update type"));
@@ -601,7 +739,8 @@ TEST_F(BfrtTableManagerTest, RejectReadTableEntryWriteSessionNullTest) {
   ::p4::v1::TableEntry entry;
   ASSERT_OK(ParseProtoFromString(kTableEntryText, &entry));
   ::util::Status ret =
-      bfrt_table_manager_->ReadTableEntry(session_mock, entry, nullptr);
+      bfrt_table_manager_->ReadTableEntry(session_mock, entry, nullptr,
+                                          &arena_);
   ASSERT_FALSE(ret.ok());
   EXPECT_EQ(ERR_INVALID_PARAM, ret.error_code());
   EXPECT_THAT(ret.error_message(), HasSubstr("Null writer."));
@@ -641,6 +780,196 @@ TEST_F(BfrtTableManagerTest, RejectWriteDirectCounterEntryTypeInsertTest) {
               HasSubstr("Update type of DirectCounterEntry"));
 }
 
+TEST_F(BfrtTableManagerTest, WriteActionProfileGroupWithWatchPortTest) {
+  ASSERT_OK(PushTestConfig());
+  constexpr int kP4ActionProfileId = 285261835;
+  constexpr int kBfrtActionProfileId = 1001;
+  constexpr int kBfrtActionSelectorId = 1002;
+  auto session_mock = std::make_shared<SessionMock>();
+
+  EXPECT_CALL(*bf_sde_wrapper_mock_, GetBfRtId(kP4ActionProfileId))
+      .WillRepeatedly(Return(kBfrtActionProfileId));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              GetActionSelectorBfRtId(kBfrtActionProfileId))
+      .WillRepeatedly(Return(kBfrtActionSelectorId));
+
+  // Port 2 is down before the group is written, so the member watching it
+  // must be inserted as inactive.
+  EXPECT_OK(bfrt_table_manager_->UpdatePortState(2, PORT_STATE_DOWN));
+  const std::vector<uint32> kMemberIds = {1, 2, 3};
+  const std::vector<bool> kMemberStatus = {true, false, true};
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              InsertActionProfileGroup(kDevice1, _, kBfrtActionSelectorId, 55,
+                                       8, kMemberIds, kMemberStatus))
+      .WillOnce(Return(::util::OkStatus()));
+
+  const std::string kActionProfileGroupText = R"pb(
+    action_profile_id: 285261835
+    group_id: 55
+    members { member_id: 1 weight: 1 watch_port: "\001" }
+    members { member_id: 2 weight: 1 watch_port: "\002" }
+    members { member_id: 3 weight: 1 }
+    max_size: 8
+  )pb";
+  ::p4::v1::ActionProfileGroup group;
+  ASSERT_OK(ParseProtoFromString(kActionProfileGroupText, &group));
+  EXPECT_OK(bfrt_table_manager_->WriteActionProfileGroup(
+      session_mock, ::p4::v1::Update::INSERT, group));
+}
+
+TEST_F(BfrtTableManagerTest, WatchPortFailoverUpdatesAllGroupsInOneBatchTest) {
+  ASSERT_OK(PushTestConfig());
+  constexpr int kP4ActionProfileId = 285261835;
+  constexpr int kBfrtActionProfileId = 1001;
+  constexpr int kBfrtActionSelectorId = 1002;
+  constexpr int kNumGroups = 4096;
+  constexpr uint32 kFailingPort = 7;
+  constexpr uint32 kOtherPort = 8;
+  auto session_mock = std::make_shared<SessionMock>();
+
+  EXPECT_CALL(*bf_sde_wrapper_mock_, GetBfRtId(kP4ActionProfileId))
+      .WillRepeatedly(Return(kBfrtActionProfileId));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              GetActionSelectorBfRtId(kBfrtActionProfileId))
+      .WillRepeatedly(Return(kBfrtActionSelectorId));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              InsertActionProfileGroup(kDevice1, _, kBfrtActionSelectorId, _,
+                                       _, _, _))
+      .Times(kNumGroups)
+      .WillRepeatedly(Return(::util::OkStatus()));
+
+  // Even groups watch the failing port with their first member, odd groups
+  // only watch an unrelated port.
+  for (int i = 1; i <= kNumGroups; ++i) {
+    ::p4::v1::ActionProfileGroup group;
+    group.set_action_profile_id(kP4ActionProfileId);
+    group.set_group_id(i);
+    group.set_max_size(4);
+    auto* member = group.add_members();
+    member->set_member_id(1);
+    member->set_weight(1);
+    member->set_watch_port(
+        Uint32ToByteStream(i % 2 == 0 ? kFailingPort : kOtherPort));
+    member = group.add_members();
+    member->set_member_id(2);
+    member->set_weight(1);
+    member->set_watch_port(Uint32ToByteStream(kOtherPort));
+    ASSERT_OK(bfrt_table_manager_->WriteActionProfileGroup(
+        session_mock, ::p4::v1::Update::INSERT, group));
+  }
+
+  // The port down event must result in exactly one batch, updating exactly
+  // the groups watching the port.
+  std::map<int, std::vector<bool>> status_updates;
+  EXPECT_CALL(*bf_sde_wrapper_mock_, CreateSession())
+      .WillOnce(Return(
+          std::shared_ptr<BfSdeInterface::SessionInterface>(session_mock)));
+  EXPECT_CALL(*session_mock, BeginBatch())
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*session_mock, EndBatch()).WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              ModifyActionProfileGroup(kDevice1, _, kBfrtActionSelectorId, _,
+                                       4, std::vector<uint32>{1, 2}, _))
+      .WillRepeatedly(
+          Invoke([&status_updates](
+                     int device,
+                     std::shared_ptr<BfSdeInterface::SessionInterface> session,
+                     uint32 table_id, int group_id, int max_group_size,
+                     const std::vector<uint32>& member_ids,
+                     const std::vector<bool>& member_status) {
+            status_updates[group_id] = member_status;
+            return ::util::OkStatus();
+          }));
+
+  const absl::Time start = absl::Now();
+  EXPECT_OK(
+      bfrt_table_manager_->UpdatePortState(kFailingPort, PORT_STATE_DOWN));
+  const absl::Duration failover_latency = absl::Now() - start;
+  LOG(INFO) << "Failover of " << kNumGroups / 2 << " groups took "
+            << failover_latency << ".";
+  EXPECT_LT(failover_latency, absl::Seconds(1));
+
+  ASSERT_EQ(kNumGroups / 2, status_updates.size());
+  for (const auto& e : status_updates) {
+    EXPECT_EQ(0, e.first % 2) << "Group " << e.first << " was updated.";
+    EXPECT_EQ(std::vector<bool>({false, true}), e.second);
+  }
+
+  // Repeated events for the same state are no-ops.
+  EXPECT_OK(
+      bfrt_table_manager_->UpdatePortState(kFailingPort, PORT_STATE_DOWN));
+}
+
+TEST_F(BfrtTableManagerTest, ReadActionProfileGroupReportsWatchPortIntentTest) {
+  ASSERT_OK(PushTestConfig());
+  constexpr int kP4ActionProfileId = 285261835;
+  constexpr int kBfrtActionProfileId = 1001;
+  constexpr int kBfrtActionSelectorId = 1002;
+  auto session_mock = std::make_shared<SessionMock>();
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+
+  EXPECT_CALL(*bf_sde_wrapper_mock_, GetBfRtId(kP4ActionProfileId))
+      .WillRepeatedly(Return(kBfrtActionProfileId));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              GetActionSelectorBfRtId(kBfrtActionProfileId))
+      .WillRepeatedly(Return(kBfrtActionSelectorId));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              GetActionProfileBfRtId(kBfrtActionSelectorId))
+      .WillRepeatedly(Return(kBfrtActionProfileId));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, GetP4InfoId(kBfrtActionProfileId))
+      .WillRepeatedly(Return(kP4ActionProfileId));
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              InsertActionProfileGroup(_, _, _, _, _, _, _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bf_sde_wrapper_mock_, CreateSession())
+      .WillOnce(Return(
+          std::shared_ptr<BfSdeInterface::SessionInterface>(session_mock)));
+  EXPECT_CALL(*session_mock, BeginBatch()).Times(AnyNumber());
+  EXPECT_CALL(*session_mock, EndBatch()).Times(AnyNumber());
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              ModifyActionProfileGroup(kDevice1, _, kBfrtActionSelectorId, 55,
+                                       8, std::vector<uint32>{1, 2},
+                                       std::vector<bool>{false, true}))
+      .WillOnce(Return(::util::OkStatus()));
+
+  const std::string kActionProfileGroupText = R"pb(
+    action_profile_id: 285261835
+    group_id: 55
+    members { member_id: 1 weight: 1 watch_port: "\001" }
+    members { member_id: 2 weight: 1 watch_port: "\002" }
+    max_size: 8
+  )pb";
+  ::p4::v1::ActionProfileGroup group;
+  ASSERT_OK(ParseProtoFromString(kActionProfileGroupText, &group));
+  ASSERT_OK(bfrt_table_manager_->WriteActionProfileGroup(
+      session_mock, ::p4::v1::Update::INSERT, group));
+  ASSERT_OK(bfrt_table_manager_->UpdatePortState(1, PORT_STATE_DOWN));
+
+  // The SDE reports the deactivated member, but the read must return the
+  // group as written by the controller.
+  const std::vector<int> kGroupIds = {55};
+  const std::vector<int> kMaxGroupSizes = {8};
+  const std::vector<std::vector<uint32>> kMemberIds = {{1, 2}};
+  const std::vector<std::vector<bool>> kMemberStatus = {{false, true}};
+  EXPECT_CALL(*bf_sde_wrapper_mock_,
+              GetActionProfileGroups(kDevice1, _, kBfrtActionSelectorId, 55, _,
+                                     _, _, _))
+      .WillOnce(DoAll(SetArgPointee<4>(kGroupIds),
+                      SetArgPointee<5>(kMaxGroupSizes),
+                      SetArgPointee<6>(kMemberIds),
+                      SetArgPointee<7>(kMemberStatus),
+                      Return(::util::OkStatus())));
+  ::p4::v1::ReadResponse resp;
+  *resp.add_entities()->mutable_action_profile_group() = group;
+  EXPECT_CALL(writer_mock, Write(EqualsProto(resp))).WillOnce(Return(true));
+
+  ::p4::v1::ActionProfileGroup request;
+  request.set_action_profile_id(kP4ActionProfileId);
+  request.set_group_id(55);
+  EXPECT_OK(bfrt_table_manager_->ReadActionProfileGroup(session_mock, request,
+                                                        &writer_mock));
+}
+
 }  // namespace barefoot
 }  // namespace hal
 }  // namespace stratum
@@ -25,6 +25,9 @@ int main(int argc, char** argv) {
     LOG(INFO) << "Created FLAGS_test_tmpdir " << FLAGS_test_tmpdir;
   }
 
+#ifdef BENCHMARK
+  RunSpecifiedBenchmarks();
+#endif  // BENCHMARK
   int result = RUN_ALL_TESTS();
 
   if (tmpdir_created) {
@@ -12,7 +12,9 @@
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
 #include "gflags/gflags.h"
 #include "google/protobuf/message.h"
 #include "stratum/glue/gtl/map_util.h"
@@ -24,6 +26,7 @@
 #include "stratum/hal/lib/common/constants.h"
 #include "stratum/hal/lib/common/utils.h"
 #include "stratum/lib/constants.h"
+#include "stratum/lib/liveness_watchdog.h"
 #include "stratum/lib/macros.h"
 #include "stratum/lib/utils.h"
 #include "stratum/public/lib/error.h"
@@ -43,6 +46,17 @@ DEFINE_string(bcm_sdk_shell_log_file, "/var/log/stratum/bcm.log",
 DEFINE_string(bcm_sdk_checkpoint_dir, "",
               "The dir used by SDK to save checkpoints. Default is empty and "
               "it is expected to be explicitly given by flags.");
+DEFINE_int32(bcm_port_counters_max_age_ms, 0,
+             "Max age of the per-unit port counters snapshot used to serve "
+             "port counter requests. The default 0 reads the counters of each "
+             "port from the SDK on every request. A positive value trades "
+             "counter freshness for far fewer SDK calls when polling many "
+             "ports.");
+DEFINE_int32(bcm_queue_counters_max_age_ms, 100,
+             "Reads of CoS queue counters reuse the last snapshot of all "
+             "queues of a unit if it was taken within this many milliseconds, "
+             "instead of reading the queues from the SDK again. A value of 0 "
+             "takes a new snapshot of the whole unit on every request.");
 
 namespace stratum {
 namespace hal {
@@ -215,6 +229,115 @@ BcmChassisManager::~BcmChassisManager() {
   return ::util::OkStatus();
 }
 
+::util::Status BcmChassisManager::PlanChassisConfig(
+    const ChassisConfig& config, ChassisConfigPlan* plan) {
+  ::util::Status status = VerifyChassisConfig(config);
+  if (status.error_code() == ERR_REBOOT_REQUIRED) {
+    plan->set_reboot_required(true);
+    plan->set_disruptive(true);
+  } else {
+    RETURN_IF_ERROR(status);
+  }
+
+  std::set<uint64> node_ids;
+  for (const auto& node : config.nodes()) {
+    node_ids.insert(node.id());
+    if (!node_id_to_port_ids_.count(node.id())) {
+      AddChassisConfigPlanOperation(ChassisConfigPlan::Operation::ADD,
+                                    node.id(), 0, false, plan);
+    }
+  }
+  for (const auto& e : node_id_to_port_ids_) {
+    if (!node_ids.count(e.first)) {
+      AddChassisConfigPlanOperation(ChassisConfigPlan::Operation::REMOVE,
+                                    e.first, 0, true, plan);
+    }
+  }
+
+  // The diff below follows SyncInternalState() and ConfigurePortGroups().
+  std::map<uint64, std::set<uint32>> node_id_to_port_ids;
+  for (const auto& singleton_port : config.singleton_ports()) {
+    const uint64 node_id = singleton_port.node();
+    const uint32 port_id = singleton_port.id();
+    const auto& config_params = singleton_port.config_params();
+    node_id_to_port_ids[node_id].insert(port_id);
+
+    const PortKey* singleton_port_key = nullptr;
+    if (const auto* port_id_to_singleton_port_key = gtl::FindOrNull(
+            node_id_to_port_id_to_singleton_port_key_, node_id)) {
+      singleton_port_key =
+          gtl::FindOrNull(*port_id_to_singleton_port_key, port_id);
+    }
+    if (singleton_port_key == nullptr) {
+      auto* operation = AddChassisConfigPlanOperation(
+          ChassisConfigPlan::Operation::ADD, node_id, port_id, false, plan);
+      AddChassisConfigPlanChange(
+          "speed_bps", "", absl::StrCat(singleton_port.speed_bps()), false,
+          operation, plan);
+      AddChassisConfigPlanChange("admin_state", "",
+                                 AdminState_Name(config_params.admin_state()),
+                                 false, operation, plan);
+      continue;
+    }
+
+    ChassisConfigPlan::Operation* operation = nullptr;
+    auto add_change = [&](const std::string& field,
+                          const std::string& old_value,
+                          const std::string& new_value, bool disruptive) {
+      if (operation == nullptr) {
+        operation = AddChassisConfigPlanOperation(
+            ChassisConfigPlan::Operation::MODIFY, node_id, port_id, false,
+            plan);
+      }
+      AddChassisConfigPlanChange(field, old_value, new_value, disruptive,
+                                 operation, plan);
+    };
+    const BcmPort* bcm_port =
+        gtl::FindPtrOrNull(singleton_port_key_to_bcm_port_,
+                           *singleton_port_key);
+    if (bcm_port != nullptr &&
+        bcm_port->speed_bps() != singleton_port.speed_bps()) {
+      add_change("speed_bps", absl::StrCat(bcm_port->speed_bps()),
+                 absl::StrCat(singleton_port.speed_bps()), true);
+    }
+    // Unknown admin and loopback states in the config keep the old states.
+    const AdminState* admin_state = nullptr;
+    if (const auto* port_id_to_admin_state =
+            gtl::FindOrNull(node_id_to_port_id_to_admin_state_, node_id)) {
+      admin_state = gtl::FindOrNull(*port_id_to_admin_state, port_id);
+    }
+    if (admin_state != nullptr &&
+        config_params.admin_state() != ADMIN_STATE_UNKNOWN &&
+        config_params.admin_state() != *admin_state) {
+      add_change("admin_state", AdminState_Name(*admin_state),
+                 AdminState_Name(config_params.admin_state()),
+                 config_params.admin_state() != ADMIN_STATE_ENABLED);
+    }
+    const LoopbackState* loopback_state = nullptr;
+    if (const auto* port_id_to_loopback_state =
+            gtl::FindOrNull(node_id_to_port_id_to_loopback_state_, node_id)) {
+      loopback_state = gtl::FindOrNull(*port_id_to_loopback_state, port_id);
+    }
+    if (loopback_state != nullptr &&
+        config_params.loopback_mode() != LOOPBACK_STATE_UNKNOWN &&
+        config_params.loopback_mode() != *loopback_state) {
+      add_change("loopback_mode", LoopbackState_Name(*loopback_state),
+                 LoopbackState_Name(config_params.loopback_mode()), true);
+    }
+  }
+
+  for (const auto& e : node_id_to_port_ids_) {
+    const uint64 node_id = e.first;
+    for (const uint32 port_id : e.second) {
+      if (node_id_to_port_ids[node_id].count(port_id)) continue;
+      AddChassisConfigPlanOperation(ChassisConfigPlan::Operation::REMOVE,
+                                    node_id, port_id, true, plan);
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
 ::util::Status BcmChassisManager::Shutdown() {
   ::util::Status status = ::util::OkStatus();
   APPEND_STATUS_IF_ERROR(status, UnregisterEventWriters());
@@ -457,7 +580,68 @@ BcmChassisManager::GetTrunkIdToSdkTrunkMap(uint64 node_id) const {
   }
   ASSIGN_OR_RETURN(auto unit, GetUnitFromNodeId(node_id));
   ASSIGN_OR_RETURN(auto bcm_port, GetBcmPort(node_id, port_id));
-  return bcm_sdk_interface_->GetPortCounters(unit, bcm_port.logical_port(), pc);
+  if (FLAGS_bcm_port_counters_max_age_ms <= 0) {
+    return bcm_sdk_interface_->GetPortCounters(unit, bcm_port.logical_port(),
+                                               pc);
+  }
+  absl::MutexLock l(&port_counters_lock_);
+  auto& snapshot = unit_to_port_counters_snapshot_[unit];
+  absl::Time now = absl::Now();
+  if (now - snapshot.timestamp >
+      absl::Milliseconds(FLAGS_bcm_port_counters_max_age_ms)) {
+    ASSIGN_OR_RETURN(snapshot.logical_port_to_counters,
+                     bcm_sdk_interface_->GetAllPortCounters(unit));
+    snapshot.timestamp = now;
+  }
+  const auto* counters = gtl::FindOrNull(snapshot.logical_port_to_counters,
+                                         bcm_port.logical_port());
+  if (counters == nullptr) {
+    // Not part of the snapshot, e.g. a port which was just added or a port
+    // whose counters could not be read. The direct read reports the error of
+    // the latter.
+    return bcm_sdk_interface_->GetPortCounters(unit, bcm_port.logical_port(),
+                                               pc);
+  }
+  *pc = *counters;
+
+  return ::util::OkStatus();
+}
+
+::util::Status BcmChassisManager::GetPortQosCounters(
+    uint64 node_id, uint32 port_id, uint32 queue_id,
+    PortQosCounters* qc) const {
+  if (!initialized_) {
+    return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
+  }
+  ASSIGN_OR_RETURN(auto unit, GetUnitFromNodeId(node_id));
+  ASSIGN_OR_RETURN(auto bcm_port, GetBcmPort(node_id, port_id));
+  absl::MutexLock l(&port_counters_lock_);
+  auto& snapshot = unit_to_queue_counters_snapshot_[unit];
+  absl::Time now = absl::Now();
+  if (FLAGS_bcm_queue_counters_max_age_ms <= 0 ||
+      now - snapshot.timestamp >
+          absl::Milliseconds(FLAGS_bcm_queue_counters_max_age_ms)) {
+    ASSIGN_OR_RETURN(snapshot.logical_port_to_counters,
+                     bcm_sdk_interface_->GetPortQueueCounters(unit));
+    snapshot.timestamp = now;
+  }
+  const auto* queue_counters = gtl::FindOrNull(
+      snapshot.logical_port_to_counters, bcm_port.logical_port());
+  if (queue_counters == nullptr) {
+    // Not part of the snapshot, e.g. a port which was just added or a port
+    // whose queue counters could not be read.
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND).without_logging()
+           << "No queue counters for port " << port_id << " on node "
+           << node_id << ".";
+  }
+  if (queue_id >= queue_counters->size()) {
+    return MAKE_ERROR(ERR_INVALID_PARAM).without_logging()
+           << "Unknown queue " << queue_id << " of port " << port_id
+           << " on node " << node_id << ".";
+  }
+  *qc = (*queue_counters)[queue_id];
+
+  return ::util::OkStatus();
 }
 
 ::util::Status BcmChassisManager::SetTrunkMemberBlockState(
@@ -1577,6 +1761,9 @@ void BcmChassisManager::CleanupInternalState() {
   node_id_to_port_id_to_loopback_state_.clear();
   base_bcm_chassis_map_ = nullptr;
   applied_bcm_chassis_map_ = nullptr;
+  absl::MutexLock l(&port_counters_lock_);
+  unit_to_port_counters_snapshot_.clear();
+  unit_to_queue_counters_snapshot_.clear();
 }
 
 ::util::Status BcmChassisManager::ReadBaseBcmChassisMapFromFile(
@@ -1752,24 +1939,26 @@ void* BcmChassisManager::LinkscanEventHandlerThreadFunc(void* arg) {
 
 void* BcmChassisManager::ReadLinkscanEvents(
     const std::unique_ptr<ChannelReader<LinkscanEvent>>& reader) {
+  auto worker = LivenessWatchdog::GetInstance()->RegisterWorker(
+      "BcmChassisManager linkscan");
   do {
+    worker->Heartbeat();
     // Check switch shutdown.
     {
       absl::ReaderMutexLock l(&chassis_lock);
       if (shutdown) break;
     }
     LinkscanEvent event;
-    // Block on the next linkscan event message from the Channel.
-    int code = reader->Read(&event, absl::InfiniteDuration()).error_code();
+    // Block on the next linkscan event message from the Channel. The read
+    // times out periodically so that the thread keeps heartbeating while
+    // there is no event.
+    int code = reader->Read(&event, absl::Seconds(1)).error_code();
     // Exit if the Channel is closed.
     if (code == ERR_CANCELLED) break;
-    // Read should never timeout.
-    if (code == ERR_ENTRY_NOT_FOUND) {
-      LOG(ERROR) << "Read with infinite timeout failed with ENTRY_NOT_FOUND.";
-      continue;
-    }
+    if (code == ERR_ENTRY_NOT_FOUND) continue;
     // Handle received message.
     LinkscanEventHandler(event.unit, event.port, event.state);
+    worker->ReportProgress(1);
   } while (true);
   return nullptr;
 }
@@ -16,6 +16,7 @@
 
 #include "absl/base/thread_annotations.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "stratum/glue/integral_types.h"
 #include "stratum/glue/status/status.h"
 #include "stratum/glue/status/statusor.h"
@@ -30,6 +31,7 @@
 #include "stratum/hal/lib/common/phal_interface.h"
 #include "stratum/hal/lib/common/writer_interface.h"
 #include "stratum/lib/channel/channel.h"
+#include "stratum/public/proto/gnmi_extensions.pb.h"
 
 namespace stratum {
 namespace hal {
@@ -81,6 +83,15 @@ class BcmChassisManager : public BcmChassisRoInterface {
   virtual ::util::Status VerifyChassisConfig(const ChassisConfig& config)
       SHARED_LOCKS_REQUIRED(chassis_lock);
 
+  // Computes the node and port operations that PushChassisConfig() would
+  // perform for the given config without changing the switch. Speed changes
+  // reconfigure the flex port groups, while admin state and loopback changes
+  // are applied per port. A config which needs a reboot is reported in the
+  // plan instead of as an error.
+  virtual ::util::Status PlanChassisConfig(const ChassisConfig& config,
+                                           ChassisConfigPlan* plan)
+      SHARED_LOCKS_REQUIRED(chassis_lock);
+
   // Performs coldboot shutdown sequence (detaching all attached unit and
   // clearing the maps). Note that there is no public Initialize().
   // Initialization is done as part of PushChassisConfig() if the class is not
@@ -143,6 +154,10 @@ class BcmChassisManager : public BcmChassisRoInterface {
   ::util::Status GetPortCounters(uint64 node_id, uint32 port_id,
                                  PortCounters* pc) const override
       SHARED_LOCKS_REQUIRED(chassis_lock);
+  ::util::Status GetPortQosCounters(uint64 node_id, uint32 port_id,
+                                    uint32 queue_id,
+                                    PortQosCounters* qc) const override
+      SHARED_LOCKS_REQUIRED(chassis_lock);
 
   // Sets the block state of a trunk member on a node specified by node_id. The
   // id of the member is given by port_id. The ID of the trunk which the port is
@@ -588,6 +603,38 @@ class BcmChassisManager : public BcmChassisRoInterface {
   std::shared_ptr<Channel<BcmSdkInterface::LinkscanEvent>>
       linkscan_event_channel_;
 
+  // A snapshot of the counters of all the ports of a unit, as returned by
+  // BcmSdkInterface::GetAllPortCounters(), and the time it was taken.
+  struct PortCountersSnapshot {
+    absl::Time timestamp = absl::InfinitePast();
+    std::map<int, PortCounters> logical_port_to_counters;
+  };
+
+  // Map from unit to the last counters snapshot of the unit. GetPortCounters()
+  // serves the counters from here and takes a new snapshot of the whole unit
+  // when the last one is too old, so that polling all the ports of a unit
+  // costs a single pass over the HW counters. The map is protected by its own
+  // lock, as it is updated while holding chassis_lock as a reader.
+  mutable absl::Mutex port_counters_lock_;
+  mutable std::map<int, PortCountersSnapshot> unit_to_port_counters_snapshot_
+      GUARDED_BY(port_counters_lock_);
+
+  // A snapshot of the CoS queue counters of all the ports of a unit, as
+  // returned by BcmSdkInterface::GetPortQueueCounters(), and the time it was
+  // taken.
+  struct QueueCountersSnapshot {
+    absl::Time timestamp = absl::InfinitePast();
+    std::map<int, std::vector<PortQosCounters>> logical_port_to_counters;
+  };
+
+  // Map from unit to the last CoS queue counters snapshot of the unit.
+  // GetPortQosCounters() serves the counters from here, with the same max age
+  // as the port counters, so that the queue leafs of all the ports polled in
+  // one gNMI sample share a single bulk read. Also protected by
+  // port_counters_lock_.
+  mutable std::map<int, QueueCountersSnapshot> unit_to_queue_counters_snapshot_
+      GUARDED_BY(port_counters_lock_);
+
   // WriterInterface<GnmiEventPtr> object for sending event notifications.
   mutable absl::Mutex gnmi_event_lock_;
   std::shared_ptr<WriterInterface<GnmiEventPtr>> gnmi_event_writer_
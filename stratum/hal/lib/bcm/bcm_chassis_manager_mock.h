@@ -20,6 +20,8 @@ class BcmChassisManagerMock : public BcmChassisManager {
   MOCK_METHOD1(PushChassisConfig, ::util::Status(const ChassisConfig& config));
   MOCK_METHOD1(VerifyChassisConfig,
                ::util::Status(const ChassisConfig& config));
+  MOCK_METHOD2(PlanChassisConfig, ::util::Status(const ChassisConfig& config,
+                                                 ChassisConfigPlan* plan));
   MOCK_METHOD0(Shutdown, ::util::Status());
   MOCK_METHOD1(SetUnitToBcmNodeMap,
                void(const std::map<int, BcmNode*>& unit_to_bcm_node));
@@ -44,6 +46,9 @@ class BcmChassisManagerMock : public BcmChassisManager {
                                                      uint32 port_id));
   MOCK_CONST_METHOD0(GetNodeIdToUnitMap,
                      ::util::StatusOr<std::map<uint64, int>>());
+  MOCK_CONST_METHOD4(GetPortQosCounters,
+                     ::util::Status(uint64 node_id, uint32 port_id,
+                                    uint32 queue_id, PortQosCounters* qc));
 };
 
 }  // namespace bcm
@@ -4,6 +4,7 @@
 
 #include "stratum/hal/lib/bcm/bcm_chassis_manager.h"
 
+#include <map>
 #include <memory>
 #include <string>
 #include <tuple>
@@ -15,9 +16,12 @@
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "gflags/gflags.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "stratum/glue/gtl/map_util.h"
 #include "stratum/glue/logging.h"
 #include "stratum/glue/status/status_test_util.h"
 #include "stratum/hal/lib/bcm/bcm_node_mock.h"
@@ -26,6 +30,7 @@
 #include "stratum/hal/lib/common/constants.h"
 #include "stratum/hal/lib/common/phal_mock.h"
 #include "stratum/hal/lib/common/writer_mock.h"
+#include "stratum/hal/lib/phal/phal_sim.h"
 #include "stratum/lib/channel/channel_mock.h"
 #include "stratum/lib/constants.h"
 #include "stratum/lib/utils.h"
@@ -38,15 +43,19 @@ DECLARE_string(bcm_sdk_config_flush_file);
 DECLARE_string(bcm_sdk_shell_log_file);
 DECLARE_string(bcm_sdk_checkpoint_dir);
 DECLARE_string(test_tmpdir);
+DECLARE_int32(bcm_port_counters_max_age_ms);
+DECLARE_int32(bcm_queue_counters_max_age_ms);
 
 namespace stratum {
 namespace hal {
 namespace bcm {
 
 using ::testing::_;
+using ::testing::AtLeast;
 using ::testing::DoAll;
 using ::testing::HasSubstr;
 using ::testing::Invoke;
+using ::testing::InvokeWithoutArgs;
 using ::testing::Matcher;
 using ::testing::Mock;
 using ::testing::Return;
@@ -84,22 +93,37 @@ class BcmChassisManagerTest : public ::testing::TestWithParam<OperationMode> {
     FLAGS_bcm_sdk_checkpoint_dir = FLAGS_test_tmpdir + "/sdk_checkpoint/";
   }
 
-  void SetUp() override {
-    mode_ = GetParam();
+  void SetUp() override { SetUpWithMode(GetParam()); }
+
+  void SetUpWithMode(OperationMode mode) {
+    mode_ = mode;
     phal_mock_ = absl::make_unique<PhalMock>();
     bcm_sdk_mock_ = absl::make_unique<BcmSdkMock>();
     bcm_serdes_db_manager_mock_ = absl::make_unique<BcmSerdesDbManagerMock>();
+    for (int i = 0; i < 4; ++i) {
+      bcm_node_mocks_[i] = absl::make_unique<BcmNodeMock>();
+    }
+    CreateBcmChassisManager(phal_mock_.get());
+  }
+
+  void CreateBcmChassisManager(PhalInterface* phal_interface) {
     bcm_chassis_manager_ = BcmChassisManager::CreateInstance(
-        mode_, phal_mock_.get(), bcm_sdk_mock_.get(),
+        mode_, phal_interface, bcm_sdk_mock_.get(),
         bcm_serdes_db_manager_mock_.get());
     std::map<int, BcmNode*> unit_to_node_map;
     for (int i = 0; i < 4; ++i) {
-      bcm_node_mocks_[i] = absl::make_unique<BcmNodeMock>();
       unit_to_node_map[i] = bcm_node_mocks_[i].get();
     }
     bcm_chassis_manager_->SetUnitToBcmNodeMap(unit_to_node_map);
   }
 
+  // Makes the class under test get the transceiver events from a PhalSim
+  // instead of the PHAL mock.
+  void UsePhalSim() {
+    phal_sim_ = PhalSim::CreateInstance();
+    CreateBcmChassisManager(phal_sim_.get());
+  }
+
   bool Initialized() { return bcm_chassis_manager_->initialized_; }
 
   ::util::Status InitializeBcmChips(BcmChassisMap base_bcm_chassis_map,
@@ -145,6 +169,11 @@ class BcmChassisManagerTest : public ::testing::TestWithParam<OperationMode> {
     RET_CHECK(bcm_chassis_manager_->applied_bcm_chassis_map_ == nullptr);
     RET_CHECK(bcm_chassis_manager_->xcvr_event_channel_ == nullptr);
     RET_CHECK(bcm_chassis_manager_->linkscan_event_channel_ == nullptr);
+    {
+      absl::MutexLock l(&bcm_chassis_manager_->port_counters_lock_);
+      RET_CHECK(
+          bcm_chassis_manager_->unit_to_port_counters_snapshot_.empty());
+    }
 
     return ::util::OkStatus();
   }
@@ -160,6 +189,12 @@ class BcmChassisManagerTest : public ::testing::TestWithParam<OperationMode> {
     return bcm_chassis_manager_->VerifyChassisConfig(config);
   }
 
+  ::util::Status PlanChassisConfig(const ChassisConfig& config,
+                                   ChassisConfigPlan* plan) {
+    absl::ReaderMutexLock l(&chassis_lock);
+    return bcm_chassis_manager_->PlanChassisConfig(config, plan);
+  }
+
   ::util::Status Shutdown() {
     {
       absl::WriterMutexLock l(&chassis_lock);
@@ -177,6 +212,13 @@ class BcmChassisManagerTest : public ::testing::TestWithParam<OperationMode> {
     return bcm_chassis_manager_->UnregisterEventNotifyWriter();
   }
 
+  HwState GetTransceiverState(int slot, int port) const {
+    absl::ReaderMutexLock l(&chassis_lock);
+    return gtl::FindWithDefault(
+        bcm_chassis_manager_->xcvr_port_key_to_xcvr_state_,
+        PortKey(slot, port), HW_STATE_UNKNOWN);
+  }
+
   ::util::StatusOr<BcmChip> GetBcmChip(int unit) const {
     absl::ReaderMutexLock l(&chassis_lock);
     return bcm_chassis_manager_->GetBcmChip(unit);
@@ -255,6 +297,19 @@ class BcmChassisManagerTest : public ::testing::TestWithParam<OperationMode> {
     return bcm_chassis_manager_->GetPortLoopbackState(node_id, port_id);
   }
 
+  ::util::Status GetPortCounters(uint64 node_id, uint32 port_id,
+                                 PortCounters* pc) {
+    absl::ReaderMutexLock l(&chassis_lock);
+    return bcm_chassis_manager_->GetPortCounters(node_id, port_id, pc);
+  }
+
+  ::util::Status GetPortQosCounters(uint64 node_id, uint32 port_id,
+                                    uint32 queue_id, PortQosCounters* qc) {
+    absl::ReaderMutexLock l(&chassis_lock);
+    return bcm_chassis_manager_->GetPortQosCounters(node_id, port_id, queue_id,
+                                                    qc);
+  }
+
   ::util::Status SetTrunkMemberBlockState(uint64 node_id, uint32 trunk_id,
                                           uint32 port_id,
                                           TrunkMemberBlockState state) {
@@ -427,10 +482,12 @@ class BcmChassisManagerTest : public ::testing::TestWithParam<OperationMode> {
                 RegisterLinkscanEventWriter(
                     _, BcmSdkInterface::kLinkscanEventWriterPriorityHigh))
         .WillOnce(Return(kTestLinkscanWriterId));
-    EXPECT_CALL(*phal_mock_,
-                RegisterTransceiverEventWriter(
-                    _, PhalInterface::kTransceiverEventWriterPriorityHigh))
-        .WillOnce(Return(kTestTransceiverWriterId));
+    if (phal_sim_ == nullptr) {
+      EXPECT_CALL(*phal_mock_,
+                  RegisterTransceiverEventWriter(
+                      _, PhalInterface::kTransceiverEventWriterPriorityHigh))
+          .WillOnce(Return(kTestTransceiverWriterId));
+    }
     EXPECT_CALL(*bcm_sdk_mock_, StartLinkscan(0))
         .WillOnce(Return(::util::OkStatus()));
 
@@ -449,13 +506,138 @@ class BcmChassisManagerTest : public ::testing::TestWithParam<OperationMode> {
     return ::util::OkStatus();
   }
 
+  // Pushes a config with num_ports 100G ports on unit 0. Port i, in [1,
+  // num_ports], has port ID i and logical port i.
+  ::util::Status PushTestConfigWithPorts(int num_ports) {
+    std::string bcm_chassis_map_list_text = R"(
+        bcm_chassis_maps {
+          bcm_chips {
+            type: TOMAHAWK
+            slot: 1
+            unit: 0
+            module: 0
+            pci_bus: 7
+            pci_slot: 1
+            is_oversubscribed: true
+          }
+    )";
+    std::string config_text = R"(
+        description: "Sample Generic Tomahawk config."
+        chassis {
+          platform: PLT_GENERIC_TOMAHAWK
+          name: "standalone"
+        }
+        nodes {
+          id: 7654321
+          slot: 1
+        }
+    )";
+    for (int i = 1; i <= num_ports; ++i) {
+      absl::StrAppend(&bcm_chassis_map_list_text, "bcm_ports { type: CE ",
+                      "slot: 1 port: ", i, " unit: 0 ",
+                      "speed_bps: 100000000000 logical_port: ", i,
+                      " physical_port: ", i, " diag_port: ", i,
+                      " serdes_lane: 0 num_serdes_lanes: 4 }\n");
+      absl::StrAppend(&config_text, "singleton_ports { id: ", i,
+                      " slot: 1 port: ", i, " speed_bps: 100000000000 ",
+                      "node: 7654321 }\n");
+    }
+    bcm_chassis_map_list_text += "}\n";
+
+    // Expectations for the mock objects on initialization.
+    EXPECT_CALL(*bcm_serdes_db_manager_mock_, Load())
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bcm_sdk_mock_, InitializeSdk(FLAGS_bcm_sdk_config_file,
+                                              FLAGS_bcm_sdk_config_flush_file,
+                                              FLAGS_bcm_sdk_shell_log_file))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bcm_sdk_mock_, GenerateBcmConfigFile(_, _, _))
+        .WillRepeatedly(Return(std::string("")));
+    EXPECT_CALL(*bcm_sdk_mock_, FindUnit(0, 7, 1, BcmChip::TOMAHAWK))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bcm_sdk_mock_, InitializeUnit(0, false))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bcm_sdk_mock_, SetModuleId(0, 0))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bcm_sdk_mock_, InitializePort(0, _))
+        .Times(num_ports)
+        .WillRepeatedly(Return(::util::OkStatus()));
+    EXPECT_CALL(*bcm_sdk_mock_, StartDiagShellServer())
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bcm_sdk_mock_, GetPortOptions(0, _, _))
+        .WillRepeatedly(Return(::util::OkStatus()));
+    EXPECT_CALL(*bcm_sdk_mock_, SetPortOptions(0, _, _))
+        .WillRepeatedly(Return(::util::OkStatus()));
+    EXPECT_CALL(*bcm_sdk_mock_,
+                RegisterLinkscanEventWriter(
+                    _, BcmSdkInterface::kLinkscanEventWriterPriorityHigh))
+        .WillOnce(Return(kTestLinkscanWriterId));
+    EXPECT_CALL(*phal_mock_,
+                RegisterTransceiverEventWriter(
+                    _, PhalInterface::kTransceiverEventWriterPriorityHigh))
+        .WillOnce(Return(kTestTransceiverWriterId));
+    EXPECT_CALL(*bcm_sdk_mock_, StartLinkscan(0))
+        .WillOnce(Return(::util::OkStatus()));
+
+    RETURN_IF_ERROR(WriteStringToFile(bcm_chassis_map_list_text,
+                                      FLAGS_base_bcm_chassis_map_file));
+    ChassisConfig config;
+    RETURN_IF_ERROR(ParseProtoFromString(config_text, &config));
+    RET_CHECK(!Initialized()) << "Class is initialized before push!";
+    RETURN_IF_ERROR(PushChassisConfig(config));
+    RET_CHECK(Initialized()) << "Class is not initialized after push!";
+
+    return ::util::OkStatus();
+  }
+
+  // Polls the counters of all the ports pushed by PushTestConfigWithPorts(),
+  // the way a gNMI subscription sampling all the ports does, and checks the
+  // number of SDK calls this costs, with and without the per-unit snapshot.
+  void PollAllPortCountersAndCheckSdkCalls(int num_ports) {
+    ::gflags::FlagSaver flag_saver;
+    ASSERT_OK(PushTestConfigWithPorts(num_ports));
+
+    std::map<int, PortCounters> logical_port_to_counters;
+    for (int i = 1; i <= num_ports; ++i) {
+      logical_port_to_counters[i].set_in_octets(1000 * i);
+    }
+
+    // A single bulk read serves all the ports.
+    FLAGS_bcm_port_counters_max_age_ms = 60 * 1000;
+    EXPECT_CALL(*bcm_sdk_mock_, GetAllPortCounters(0))
+        .WillOnce(Return(logical_port_to_counters));
+    EXPECT_CALL(*bcm_sdk_mock_, GetPortCounters(_, _, _)).Times(0);
+    for (int i = 1; i <= num_ports; ++i) {
+      PortCounters pc;
+      ASSERT_OK(GetPortCounters(kNodeId, i, &pc));
+      EXPECT_EQ(1000U * i, pc.in_octets());
+    }
+    ASSERT_TRUE(Mock::VerifyAndClearExpectations(bcm_sdk_mock_.get()));
+
+    // Without the snapshot, each port costs one SDK call.
+    FLAGS_bcm_port_counters_max_age_ms = 0;
+    EXPECT_CALL(*bcm_sdk_mock_, GetAllPortCounters(_)).Times(0);
+    EXPECT_CALL(*bcm_sdk_mock_, GetPortCounters(0, _, _))
+        .Times(num_ports)
+        .WillRepeatedly(Return(::util::OkStatus()));
+    for (int i = 1; i <= num_ports; ++i) {
+      PortCounters pc;
+      ASSERT_OK(GetPortCounters(kNodeId, i, &pc));
+    }
+    ASSERT_TRUE(Mock::VerifyAndClearExpectations(bcm_sdk_mock_.get()));
+
+    ASSERT_OK(ShutdownAndTestCleanState());
+  }
+
   ::util::Status ShutdownAndTestCleanState() {
     EXPECT_CALL(*bcm_sdk_mock_,
                 UnregisterLinkscanEventWriter(kTestLinkscanWriterId))
         .WillOnce(Return(::util::OkStatus()));
-    EXPECT_CALL(*phal_mock_,
-                UnregisterTransceiverEventWriter(kTestTransceiverWriterId))
-        .WillOnce(Return(::util::OkStatus()));
+    if (phal_sim_ == nullptr) {
+      EXPECT_CALL(*phal_mock_,
+                  UnregisterTransceiverEventWriter(kTestTransceiverWriterId))
+          .WillOnce(Return(::util::OkStatus()));
+    }
     EXPECT_CALL(*bcm_sdk_mock_, ShutdownAllUnits())
         .WillOnce(Return(::util::OkStatus()));
 
@@ -467,6 +649,7 @@ class BcmChassisManagerTest : public ::testing::TestWithParam<OperationMode> {
 
   OperationMode mode_;
   std::unique_ptr<PhalMock> phal_mock_;
+  std::unique_ptr<PhalSim> phal_sim_;  // Only set by UsePhalSim().
   std::unique_ptr<BcmSdkMock> bcm_sdk_mock_;
   std::unique_ptr<BcmSerdesDbManagerMock> bcm_serdes_db_manager_mock_;
   std::unique_ptr<BcmNodeMock> bcm_node_mocks_[4];
@@ -5276,6 +5459,46 @@ TEST_P(BcmChassisManagerTest, TestSetPortLoopbackStateViaConfigPush) {
   ASSERT_OK(ShutdownAndTestCleanState());
 }
 
+TEST_P(BcmChassisManagerTest, PlanChassisConfigPortChanges) {
+  ChassisConfig config;
+  ASSERT_OK(PushTestConfig(&config));
+
+  // An unchanged config has an empty plan.
+  ChassisConfigPlan plan;
+  ASSERT_OK(PlanChassisConfig(config, &plan));
+  EXPECT_EQ(0, plan.operations_size());
+  EXPECT_FALSE(plan.disruptive());
+
+  // Disabling the port and enabling loopback are both disruptive. Planning
+  // them does not touch the port.
+  for (auto& singleton_port : *config.mutable_singleton_ports()) {
+    singleton_port.mutable_config_params()->set_admin_state(
+        ADMIN_STATE_DISABLED);
+    singleton_port.mutable_config_params()->set_loopback_mode(
+        LOOPBACK_STATE_MAC);
+  }
+  ASSERT_OK(PlanChassisConfig(config, &plan));
+  ASSERT_EQ(1, plan.operations_size());
+  const auto& operation = plan.operations(0);
+  EXPECT_EQ(ChassisConfigPlan::Operation::MODIFY, operation.type());
+  EXPECT_EQ(kNodeId, operation.node_id());
+  EXPECT_EQ(kPortId, operation.port_id());
+  ASSERT_EQ(2, operation.changes_size());
+  EXPECT_EQ("admin_state", operation.changes(0).field());
+  EXPECT_EQ("ADMIN_STATE_ENABLED", operation.changes(0).old_value());
+  EXPECT_EQ("ADMIN_STATE_DISABLED", operation.changes(0).new_value());
+  EXPECT_EQ("loopback_mode", operation.changes(1).field());
+  EXPECT_TRUE(operation.disruptive());
+  EXPECT_TRUE(plan.disruptive());
+  EXPECT_FALSE(plan.reboot_required());
+
+  auto admin_state = GetPortAdminState(kNodeId, kPortId);
+  ASSERT_TRUE(admin_state.ok());
+  EXPECT_EQ(ADMIN_STATE_ENABLED, admin_state.ValueOrDie());
+
+  ASSERT_OK(ShutdownAndTestCleanState());
+}
+
 TEST_P(BcmChassisManagerTest, TestSetPortAdminStateByController) {
   ASSERT_OK(PushTestConfig());
 
@@ -5314,6 +5537,292 @@ TEST_P(BcmChassisManagerTest, TestSetPortHealthStateByController) {
   ASSERT_OK(ShutdownAndTestCleanState());
 }
 
+TEST_P(BcmChassisManagerTest, GetPortCountersFromUnitSnapshot1Port) {
+  PollAllPortCountersAndCheckSdkCalls(1);
+}
+
+TEST_P(BcmChassisManagerTest, GetPortCountersFromUnitSnapshot32Ports) {
+  PollAllPortCountersAndCheckSdkCalls(32);
+}
+
+TEST_P(BcmChassisManagerTest, GetPortCountersFromUnitSnapshot128Ports) {
+  PollAllPortCountersAndCheckSdkCalls(128);
+}
+
+TEST_P(BcmChassisManagerTest, GetPortCountersRefreshesExpiredSnapshot) {
+  ::gflags::FlagSaver flag_saver;
+  FLAGS_bcm_port_counters_max_age_ms = 1;
+  ASSERT_OK(PushTestConfig());
+
+  std::map<int, PortCounters> old_counters, new_counters;
+  old_counters[34].set_in_octets(1);
+  new_counters[34].set_in_octets(2);
+  EXPECT_CALL(*bcm_sdk_mock_, GetAllPortCounters(0))
+      .WillOnce(Return(old_counters))
+      .WillOnce(Return(new_counters))
+      .WillOnce(
+          Return(::util::Status(StratumErrorSpace(), ERR_INTERNAL, "Test")));
+
+  PortCounters pc;
+  ASSERT_OK(GetPortCounters(kNodeId, kPortId, &pc));
+  EXPECT_EQ(1U, pc.in_octets());
+  absl::SleepFor(absl::Milliseconds(5));
+  ASSERT_OK(GetPortCounters(kNodeId, kPortId, &pc));
+  EXPECT_EQ(2U, pc.in_octets());
+  absl::SleepFor(absl::Milliseconds(5));
+  EXPECT_FALSE(GetPortCounters(kNodeId, kPortId, &pc).ok());
+
+  ASSERT_OK(ShutdownAndTestCleanState());
+}
+
+TEST_P(BcmChassisManagerTest, GetPortCountersOfPortMissingFromSnapshot) {
+  ::gflags::FlagSaver flag_saver;
+  FLAGS_bcm_port_counters_max_age_ms = 60 * 1000;
+  ASSERT_OK(PushTestConfigWithPorts(2));
+
+  // The counters of port 2 could not be read, the other ports are still
+  // served from the snapshot and port 2 reports the error of a direct read.
+  std::map<int, PortCounters> logical_port_to_counters;
+  logical_port_to_counters[1].set_in_octets(1000);
+  EXPECT_CALL(*bcm_sdk_mock_, GetAllPortCounters(0))
+      .WillOnce(Return(logical_port_to_counters));
+  EXPECT_CALL(*bcm_sdk_mock_, GetPortCounters(0, 1, _)).Times(0);
+  EXPECT_CALL(*bcm_sdk_mock_, GetPortCounters(0, 2, _))
+      .WillOnce(
+          Return(::util::Status(StratumErrorSpace(), ERR_INTERNAL, "Test")));
+
+  PortCounters pc;
+  ASSERT_OK(GetPortCounters(kNodeId, 1, &pc));
+  EXPECT_EQ(1000U, pc.in_octets());
+  ::util::Status status = GetPortCounters(kNodeId, 2, &pc);
+  EXPECT_EQ(ERR_INTERNAL, status.error_code());
+  ASSERT_TRUE(Mock::VerifyAndClearExpectations(bcm_sdk_mock_.get()));
+
+  ASSERT_OK(ShutdownAndTestCleanState());
+}
+
+TEST_P(BcmChassisManagerTest, GetPortQosCountersFromUnitSnapshot) {
+  ::gflags::FlagSaver flag_saver;
+  constexpr int kNumPorts = 32;
+  constexpr int kNumQueues = 8;
+  ASSERT_OK(PushTestConfigWithPorts(kNumPorts));
+
+  std::map<int, std::vector<PortQosCounters>> logical_port_to_counters;
+  for (int i = 1; i <= kNumPorts; ++i) {
+    for (int q = 0; q < kNumQueues; ++q) {
+      PortQosCounters qc;
+      qc.set_queue_id(q);
+      qc.set_out_dropped_pkts(100 * i + q);
+      logical_port_to_counters[i].push_back(qc);
+    }
+  }
+
+  // A single bulk read serves all the queues of all the ports.
+  FLAGS_bcm_queue_counters_max_age_ms = 60 * 1000;
+  EXPECT_CALL(*bcm_sdk_mock_, GetPortQueueCounters(0))
+      .WillOnce(Return(logical_port_to_counters));
+  for (int i = 1; i <= kNumPorts; ++i) {
+    for (int q = 0; q < kNumQueues; ++q) {
+      PortQosCounters qc;
+      ASSERT_OK(GetPortQosCounters(kNodeId, i, q, &qc));
+      EXPECT_EQ(static_cast<uint32>(q), qc.queue_id());
+      EXPECT_EQ(100U * i + q, qc.out_dropped_pkts());
+    }
+  }
+  PortQosCounters qc;
+  ::util::Status status = GetPortQosCounters(kNodeId, 1, kNumQueues, &qc);
+  EXPECT_EQ(ERR_INVALID_PARAM, status.error_code());
+  EXPECT_THAT(status.error_message(), HasSubstr("Unknown queue"));
+  ASSERT_TRUE(Mock::VerifyAndClearExpectations(bcm_sdk_mock_.get()));
+
+  // Without the snapshot, each request costs a bulk read.
+  FLAGS_bcm_queue_counters_max_age_ms = 0;
+  EXPECT_CALL(*bcm_sdk_mock_, GetPortQueueCounters(0))
+      .Times(kNumQueues)
+      .WillRepeatedly(Return(logical_port_to_counters));
+  for (int q = 0; q < kNumQueues; ++q) {
+    ASSERT_OK(GetPortQosCounters(kNodeId, 1, q, &qc));
+  }
+  ASSERT_TRUE(Mock::VerifyAndClearExpectations(bcm_sdk_mock_.get()));
+
+  // A port left out of the snapshot, e.g. because its queue counters could
+  // not be read, does not fail the other ports.
+  logical_port_to_counters.erase(2);
+  EXPECT_CALL(*bcm_sdk_mock_, GetPortQueueCounters(0))
+      .Times(2)
+      .WillRepeatedly(Return(logical_port_to_counters));
+  ASSERT_OK(GetPortQosCounters(kNodeId, 1, 0, &qc));
+  status = GetPortQosCounters(kNodeId, 2, 0, &qc);
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, status.error_code());
+  ASSERT_TRUE(Mock::VerifyAndClearExpectations(bcm_sdk_mock_.get()));
+
+  // A failed read is reported to the caller.
+  EXPECT_CALL(*bcm_sdk_mock_, GetPortQueueCounters(0))
+      .WillOnce(
+          Return(::util::Status(StratumErrorSpace(), ERR_INTERNAL, "Test")));
+  EXPECT_FALSE(GetPortQosCounters(kNodeId, 1, 0, &qc).ok());
+
+  ASSERT_OK(ShutdownAndTestCleanState());
+}
+
+TEST_P(BcmChassisManagerTest, FlappingTransceiverFromPhalSimScenario) {
+  UsePhalSim();
+  ASSERT_OK(phal_sim_->PushChassisConfig(ChassisConfig()));
+  ASSERT_OK(PushTestConfig());
+  PhalSimScenario scenario;
+  ASSERT_OK(ReadProtoFromTextFile(
+      "stratum/hal/lib/phal/sim_scenarios/flapping_module.pb.txt", &scenario));
+
+  // The events are handled asynchronously and a slow handler may lose some
+  // of them, so the number of insertions and removals handled is not
+  // asserted on. Each insertion handled makes the class reconfigure the
+  // serdes using the module info PhalSim reports, and every event handled
+  // updates the port options.
+  absl::Mutex mu;
+  absl::CondVar cond_var;
+  int num_port_options_updates = 0;
+  std::string last_vendor_name;
+  EXPECT_CALL(*bcm_serdes_db_manager_mock_, LookupSerdesConfigForPort(_, _, _))
+      .Times(AtLeast(1))
+      .WillRepeatedly(DoAll(
+          Invoke([&](const BcmPort&, const FrontPanelPortInfo& info,
+                     BcmSerdesLaneConfig*) {
+            absl::MutexLock l(&mu);
+            last_vendor_name = info.vendor_name();
+          }),
+          Return(::util::OkStatus())));
+  EXPECT_CALL(*bcm_sdk_mock_, ConfigSerdesForPort(0, 34, kHundredGigBps, _, _,
+                                                  4, _, _, _))
+      .Times(AtLeast(1))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, SetPortOptions(0, 34, _))
+      .Times(AtLeast(1))
+      .WillRepeatedly(
+          DoAll(Invoke([&](int, int, const BcmPortOptions&) {
+                  absl::MutexLock l(&mu);
+                  ++num_port_options_updates;
+                  cond_var.SignalAll();
+                }),
+                Return(::util::OkStatus())));
+
+  // Compress the 2s of the scenario to 100ms. The last event is an insertion,
+  // so the module ends up ready. Each port options update notifies the
+  // completion of a handled event, after which the state is checked again.
+  ASSERT_OK(phal_sim_->RunScenario(scenario, 20));
+  absl::Time deadline = absl::Now() + absl::Seconds(10);
+  while (true) {
+    int num_seen_updates;
+    {
+      absl::MutexLock l(&mu);
+      num_seen_updates = num_port_options_updates;
+    }
+    if (GetTransceiverState(1, 1) == HW_STATE_READY) break;
+    absl::MutexLock l(&mu);
+    while (num_port_options_updates == num_seen_updates) {
+      ASSERT_FALSE(cond_var.WaitWithDeadline(&mu, deadline))
+          << "Timeout waiting for the module to be ready.";
+    }
+  }
+  {
+    absl::MutexLock l(&mu);
+    EXPECT_EQ("SimVendor", last_vendor_name);
+  }
+
+  ASSERT_OK(ShutdownAndTestCleanState());
+  ASSERT_OK(phal_sim_->Shutdown());
+}
+
+#ifdef BENCHMARK
+// Runs the test fixture setup outside of a test, so that the benchmarks below
+// can reuse it.
+class BcmChassisManagerBenchmark : public BcmChassisManagerTest {
+ public:
+  void TestBody() override {}
+
+  // Polls the counters of num_ports ports iters times, the way a gNMI
+  // subscription sampling all the ports does, with the given max snapshot
+  // age. The SDK is mocked, so this measures the chassis manager overhead and
+  // logs the number of SDK calls per poll.
+  void PollAllPortCounters(int iters, int num_ports, int max_age_ms) {
+    ::gflags::FlagSaver flag_saver;
+    FLAGS_bcm_port_counters_max_age_ms = max_age_ms;
+    SetUpWithMode(OPERATION_MODE_STANDALONE);
+    CHECK_OK(PushTestConfigWithPorts(num_ports));
+    std::map<int, PortCounters> logical_port_to_counters;
+    for (int i = 1; i <= num_ports; ++i) {
+      logical_port_to_counters[i].set_in_octets(1000 * i);
+    }
+    int num_sdk_calls = 0;
+    EXPECT_CALL(*bcm_sdk_mock_, GetAllPortCounters(0))
+        .WillRepeatedly(Invoke([&](int) {
+          ++num_sdk_calls;
+          return logical_port_to_counters;
+        }));
+    EXPECT_CALL(*bcm_sdk_mock_, GetPortCounters(0, _, _))
+        .WillRepeatedly(InvokeWithoutArgs([&]() {
+          ++num_sdk_calls;
+          return ::util::OkStatus();
+        }));
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; ++i) {
+      for (int port_id = 1; port_id <= num_ports; ++port_id) {
+        PortCounters pc;
+        ::util::Status status = GetPortCounters(kNodeId, port_id, &pc);
+        CHECK(status.ok()) << status;
+      }
+    }
+    StopBenchmarkTiming();
+    LOG(INFO) << num_sdk_calls << " SDK calls for " << iters << " polls of "
+              << num_ports << " ports with a max snapshot age of "
+              << max_age_ms << "ms.";
+    CHECK_OK(ShutdownAndTestCleanState());
+  }
+};
+
+static void BM_PollPortCounters1Port(int iters) {
+  StopBenchmarkTiming();
+  BcmChassisManagerBenchmark benchmark;
+  benchmark.PollAllPortCounters(iters, 1, 0);
+}
+BENCHMARK(BM_PollPortCounters1Port);
+
+static void BM_PollPortCounters32Ports(int iters) {
+  StopBenchmarkTiming();
+  BcmChassisManagerBenchmark benchmark;
+  benchmark.PollAllPortCounters(iters, 32, 0);
+}
+BENCHMARK(BM_PollPortCounters32Ports);
+
+static void BM_PollPortCounters128Ports(int iters) {
+  StopBenchmarkTiming();
+  BcmChassisManagerBenchmark benchmark;
+  benchmark.PollAllPortCounters(iters, 128, 0);
+}
+BENCHMARK(BM_PollPortCounters128Ports);
+
+static void BM_PollPortCountersFromSnapshot1Port(int iters) {
+  StopBenchmarkTiming();
+  BcmChassisManagerBenchmark benchmark;
+  benchmark.PollAllPortCounters(iters, 1, 60 * 1000);
+}
+BENCHMARK(BM_PollPortCountersFromSnapshot1Port);
+
+static void BM_PollPortCountersFromSnapshot32Ports(int iters) {
+  StopBenchmarkTiming();
+  BcmChassisManagerBenchmark benchmark;
+  benchmark.PollAllPortCounters(iters, 32, 60 * 1000);
+}
+BENCHMARK(BM_PollPortCountersFromSnapshot32Ports);
+
+static void BM_PollPortCountersFromSnapshot128Ports(int iters) {
+  StopBenchmarkTiming();
+  BcmChassisManagerBenchmark benchmark;
+  benchmark.PollAllPortCounters(iters, 128, 60 * 1000);
+}
+BENCHMARK(BM_PollPortCountersFromSnapshot128Ports);
+#endif  // BENCHMARK
+
 INSTANTIATE_TEST_SUITE_P(BcmChassisManagerTestWithMode, BcmChassisManagerTest,
                          ::testing::Values(OPERATION_MODE_STANDALONE));
 
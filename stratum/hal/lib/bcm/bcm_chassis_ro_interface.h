@@ -90,6 +90,12 @@ class BcmChassisRoInterface {
   virtual ::util::Status GetPortCounters(uint64 node_id, uint32 port_id,
                                          PortCounters* pc) const = 0;
 
+  // Gets the counters of a CoS queue of a given singleton port. Returns
+  // ERR_INVALID_PARAM if the port has no such queue.
+  virtual ::util::Status GetPortQosCounters(uint64 node_id, uint32 port_id,
+                                            uint32 queue_id,
+                                            PortQosCounters* qc) const = 0;
+
  protected:
   // Default constructor.
   BcmChassisRoInterface() {}
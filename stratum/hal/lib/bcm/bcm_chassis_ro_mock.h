@@ -53,6 +53,9 @@ class BcmChassisRoMock : public BcmChassisRoInterface {
   MOCK_CONST_METHOD3(GetPortCounters,
                      ::util::Status(uint64 node_id, uint32 port_id,
                                     PortCounters* pc));
+  MOCK_CONST_METHOD4(GetPortQosCounters,
+                     ::util::Status(uint64 node_id, uint32 port_id,
+                                    uint32 queue_id, PortQosCounters* qc));
 };
 
 }  // namespace bcm
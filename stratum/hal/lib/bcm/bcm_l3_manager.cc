@@ -5,6 +5,9 @@
 #include "stratum/hal/lib/bcm/bcm_l3_manager.h"
 
 #include <algorithm>
+#include <map>
+#include <set>
+#include <utility>
 #include <vector>
 
 #include "absl/memory/memory.h"
@@ -425,15 +428,32 @@ BcmL3Manager::~BcmL3Manager() {}
   return ::util::OkStatus();
 }
 
-::util::Status BcmL3Manager::UpdateMultipathGroupsForPort(uint32 port_id) {
+::util::Status BcmL3Manager::UpdateMultipathGroupsForPorts(
+    const std::set<uint32>& port_ids) {
   // Generate map from BCM multipath group id to data for all groups which
-  // reference the given port.
+  // reference any of the given ports.
   ASSIGN_OR_RETURN(
       auto nexthops,
-      bcm_table_manager_->FillBcmMultipathNexthopsWithPort(port_id));
-  for (const auto& nexthop : nexthops) {
-    RETURN_IF_ERROR(ModifyMultipathNexthop(nexthop.first, nexthop.second));
+      bcm_table_manager_->FillBcmMultipathNexthopsWithPorts(port_ids));
+  if (nexthops.empty()) return ::util::OkStatus();
+  std::map<int, std::vector<int>> egress_intf_id_to_member_ids;
+  for (const auto& e : nexthops) {
+    RET_CHECK(e.first > 0) << "Invalid egress_intf_id: " << e.first << ".";
+    RET_CHECK(e.second.unit() == unit_)
+        << "Received multipath nexthop for unit " << e.second.unit()
+        << " on unit " << unit_ << ".";
+    ASSIGN_OR_RETURN(std::vector<int> member_ids,
+                     FindEcmpGroupMembers(e.second));
+    // Same workaround for single member groups as in ModifyMultipathNexthop().
+    if (member_ids.size() == 1) member_ids.push_back(member_ids[0]);
+    egress_intf_id_to_member_ids.emplace(e.first, std::move(member_ids));
   }
+  RETURN_IF_ERROR(bcm_sdk_interface_->ModifyEcmpEgressIntfs(
+      unit_, egress_intf_id_to_member_ids));
+  VLOG(1) << "Updated " << egress_intf_id_to_member_ids.size()
+          << " multipath groups on unit " << unit_ << " for "
+          << port_ids.size() << " port(s).";
+
   return ::util::OkStatus();
 }
 
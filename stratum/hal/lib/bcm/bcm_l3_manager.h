@@ -5,7 +5,9 @@
 #ifndef STRATUM_HAL_LIB_BCM_BCM_L3_MANAGER_H_
 #define STRATUM_HAL_LIB_BCM_BCM_L3_MANAGER_H_
 
+#include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
@@ -125,12 +127,15 @@ class BcmL3Manager {
   // not needed).
   virtual ::util::Status DeleteTableEntry(const ::p4::v1::TableEntry& entry);
 
-  // Updates any ECMP/WCMP groups which include a member pointing to the given
-  // singleton port. Adds or removes the port to or from all groups referencing
-  // it based on whether the port is UP or not, respectively. In the case that
-  // a group becomes empty, a drop egress interface will be substituted in
-  // as the SDK does not support ECMP groups programmed with no nexthops.
-  virtual ::util::Status UpdateMultipathGroupsForPort(uint32 port_id);
+  // Updates any ECMP/WCMP groups which include a member pointing to any of the
+  // given singleton ports. Adds or removes the ports to or from all groups
+  // referencing them based on whether each port is UP or not, respectively. In
+  // the case that a group becomes empty, a drop egress interface will be
+  // substituted in as the SDK does not support ECMP groups programmed with no
+  // nexthops. Each affected group is reprogrammed once, and all the groups are
+  // handed to the SDK in a single batch.
+  virtual ::util::Status UpdateMultipathGroupsForPorts(
+      const std::set<uint32>& port_ids);
 
   // Factory function for creating the instance of the class.
   static std::unique_ptr<BcmL3Manager> CreateInstance(
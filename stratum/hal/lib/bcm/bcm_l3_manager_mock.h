@@ -5,6 +5,8 @@
 #ifndef STRATUM_HAL_LIB_BCM_BCM_L3_MANAGER_MOCK_H_
 #define STRATUM_HAL_LIB_BCM_BCM_L3_MANAGER_MOCK_H_
 
+#include <set>
+
 #include "gmock/gmock.h"
 #include "stratum/hal/lib/bcm/bcm_l3_manager.h"
 
@@ -37,7 +39,8 @@ class BcmL3ManagerMock : public BcmL3Manager {
                ::util::Status(const ::p4::v1::TableEntry& entry));
   MOCK_METHOD1(DeleteTableEntry,
                ::util::Status(const ::p4::v1::TableEntry& entry));
-  MOCK_METHOD1(UpdateMultipathGroupsForPort, ::util::Status(uint32 port_id));
+  MOCK_METHOD1(UpdateMultipathGroupsForPorts,
+               ::util::Status(const std::set<uint32>& port_ids));
 };
 
 }  // namespace bcm
@@ -39,7 +39,11 @@ BcmNode::BcmNode(BcmAclManager* bcm_acl_manager, BcmL2Manager* bcm_l2_manager,
       bcm_tunnel_manager_(ABSL_DIE_IF_NULL(bcm_tunnel_manager)),
       p4_table_mapper_(ABSL_DIE_IF_NULL(p4_table_mapper)),
       node_id_(0),
-      unit_(unit) {}
+      unit_(unit),
+      pending_repair_port_ids_(),
+      repair_thread_running_(false),
+      repair_thread_joinable_(false),
+      repair_thread_id_() {}
 
 BcmNode::BcmNode()
     : initialized_(false),
@@ -51,9 +55,13 @@ BcmNode::BcmNode()
       bcm_tunnel_manager_(nullptr),
       p4_table_mapper_(nullptr),
       node_id_(0),
-      unit_(-1) {}
+      unit_(-1),
+      pending_repair_port_ids_(),
+      repair_thread_running_(false),
+      repair_thread_joinable_(false),
+      repair_thread_id_() {}
 
-BcmNode::~BcmNode() {}
+BcmNode::~BcmNode() { StopMultipathRepairThread(); }
 
 ::util::Status BcmNode::PushChassisConfig(const ChassisConfig& config,
                                           uint64 node_id) {
@@ -66,6 +74,7 @@ BcmNode::~BcmNode() {}
   RETURN_IF_ERROR(bcm_acl_manager_->PushChassisConfig(config, node_id));
   RETURN_IF_ERROR(bcm_tunnel_manager_->PushChassisConfig(config, node_id));
   RETURN_IF_ERROR(bcm_packetio_manager_->PushChassisConfig(config, node_id));
+  RETURN_IF_ERROR(StartMultipathRepairThread());
   initialized_ = true;
 
   return ::util::OkStatus();
@@ -113,6 +122,7 @@ BcmNode::~BcmNode() {}
       << node_id_ << ".";
   RETURN_IF_ERROR(StaticEntryWrite(p4_pipeline_config, /*post_push=*/false));
   RETURN_IF_ERROR(p4_table_mapper_->PushForwardingPipelineConfig(config));
+  RETURN_IF_ERROR(bcm_table_manager_->PushForwardingPipelineConfig(config));
   RETURN_IF_ERROR(bcm_acl_manager_->PushForwardingPipelineConfig(config));
   RETURN_IF_ERROR(bcm_tunnel_manager_->PushForwardingPipelineConfig(config));
   RETURN_IF_ERROR(StaticEntryWrite(p4_pipeline_config, /*post_push=*/true));
@@ -135,6 +145,8 @@ BcmNode::~BcmNode() {}
 }
 
 ::util::Status BcmNode::Shutdown() {
+  // The repair thread acquires lock_, so it needs to be stopped first.
+  StopMultipathRepairThread();
   absl::WriterMutexLock l(&lock_);
   auto status = ::util::OkStatus();
   APPEND_STATUS_IF_ERROR(status, bcm_packetio_manager_->Shutdown());
@@ -363,15 +375,31 @@ BcmNode::~BcmNode() {}
 }
 
 ::util::Status BcmNode::UpdatePortState(uint32 port_id) {
-  absl::WriterMutexLock l(&lock_);
-  if (!initialized_) {
+  absl::MutexLock l(&repair_lock_);
+  if (!repair_thread_running_) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
-  // Reprogram all multipath groups referencing this port.
-  RETURN_IF_ERROR(bcm_l3_manager_->UpdateMultipathGroupsForPort(port_id));
+  // Reprogramming all multipath groups referencing this port is left to the
+  // repair thread. If the port is already pending, the repair will pick up its
+  // latest state anyway.
+  pending_repair_port_ids_.insert(port_id);
+  repair_cond_var_.Signal();
   return ::util::OkStatus();
 }
 
+::util::Status BcmNode::RegisterEventNotifyWriter(
+    const std::shared_ptr<WriterInterface<GnmiEventPtr>>& writer) {
+  return bcm_table_manager_->RegisterEventNotifyWriter(writer);
+}
+
+::util::Status BcmNode::UnregisterEventNotifyWriter() {
+  return bcm_table_manager_->UnregisterEventNotifyWriter();
+}
+
+TableOccupancy BcmNode::GetTableOccupancy() const {
+  return bcm_table_manager_->GetTableOccupancy();
+}
+
 std::unique_ptr<BcmNode> BcmNode::CreateInstance(
     BcmAclManager* bcm_acl_manager, BcmL2Manager* bcm_l2_manager,
     BcmL3Manager* bcm_l3_manager, BcmPacketioManager* bcm_packetio_manager,
@@ -382,6 +410,80 @@ std::unique_ptr<BcmNode> BcmNode::CreateInstance(
       bcm_table_manager, bcm_tunnel_manager, p4_table_mapper, unit));
 }
 
+::util::Status BcmNode::StartMultipathRepairThread() {
+  absl::MutexLock l(&repair_lock_);
+  if (repair_thread_running_) return ::util::OkStatus();
+  // Reap a previous thread which exited on its own on shutdown.
+  if (repair_thread_joinable_) {
+    pthread_join(repair_thread_id_, nullptr);
+    repair_thread_joinable_ = false;
+  }
+  int ret = pthread_create(&repair_thread_id_, nullptr,
+                           MultipathRepairThreadFunc, this);
+  if (ret != 0) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to create multipath repair thread for node " << node_id_
+           << ". Err: " << ret << ".";
+  }
+  repair_thread_running_ = true;
+  repair_thread_joinable_ = true;
+
+  return ::util::OkStatus();
+}
+
+void BcmNode::StopMultipathRepairThread() {
+  bool joinable = false;
+  {
+    absl::MutexLock l(&repair_lock_);
+    repair_thread_running_ = false;
+    std::swap(joinable, repair_thread_joinable_);
+    pending_repair_port_ids_.clear();
+    repair_cond_var_.SignalAll();
+  }
+  if (joinable) pthread_join(repair_thread_id_, nullptr);
+}
+
+void* BcmNode::MultipathRepairThreadFunc(void* arg) {
+  CHECK(arg != nullptr);
+  static_cast<BcmNode*>(arg)->MultipathRepairLoop();
+  return nullptr;
+}
+
+void BcmNode::MultipathRepairLoop() {
+  while (true) {
+    // Take all the ports which changed state since the last round. Any change
+    // arriving while the repair below is in progress is left for the next
+    // round, so a flapping port costs at most one extra repair.
+    std::set<uint32> port_ids;
+    {
+      absl::MutexLock l(&repair_lock_);
+      while (repair_thread_running_ && pending_repair_port_ids_.empty()) {
+        repair_cond_var_.Wait(&repair_lock_);
+      }
+      if (!repair_thread_running_) break;
+      port_ids.swap(pending_repair_port_ids_);
+    }
+    // Same lock order as the forwarding entry writes.
+    absl::ReaderMutexLock chassis_l(&chassis_lock);
+    if (shutdown) {
+      // Stop accepting port state changes, as nothing would repair them.
+      absl::MutexLock l(&repair_lock_);
+      repair_thread_running_ = false;
+      pending_repair_port_ids_.clear();
+      break;
+    }
+    absl::WriterMutexLock l(&lock_);
+    if (!initialized_) continue;
+    ::util::Status status =
+        bcm_l3_manager_->UpdateMultipathGroupsForPorts(port_ids);
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to update multipath groups on node " << node_id_
+                 << " for " << port_ids.size()
+                 << " port(s) with error: " << status << ".";
+    }
+  }
+}
+
 ::util::Status BcmNode::StaticEntryWrite(const P4PipelineConfig& config,
                                          bool post_push) {
   ::p4::v1::WriteRequest static_write_request;
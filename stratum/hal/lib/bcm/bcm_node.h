@@ -5,7 +5,10 @@
 #ifndef STRATUM_HAL_LIB_BCM_BCM_NODE_H_
 #define STRATUM_HAL_LIB_BCM_BCM_NODE_H_
 
+#include <pthread.h>
+
 #include <memory>
+#include <set>
 #include <vector>
 
 #include "absl/synchronization/mutex.h"
@@ -102,9 +105,27 @@ class BcmNode {
       SHARED_LOCKS_REQUIRED(chassis_lock) LOCKS_EXCLUDED(lock_);
 
   // Updates any managers which rely on current port state. This is generally
-  // invoked by BcmChassisManager in the linkscan event handler.
+  // invoked by BcmChassisManager in the linkscan event handler. The update is
+  // only scheduled here and performed asynchronously by the multipath repair
+  // thread, so that the linkscan event handler is not blocked on
+  // reprogramming a possibly large number of ECMP/WCMP groups. Repeated state
+  // changes of ports which are still pending a repair are coalesced.
   virtual ::util::Status UpdatePortState(uint32 port_id)
-      SHARED_LOCKS_REQUIRED(chassis_lock) LOCKS_EXCLUDED(lock_);
+      SHARED_LOCKS_REQUIRED(chassis_lock) LOCKS_EXCLUDED(lock_, repair_lock_);
+
+  // Registers a writer for the gNMI events of the node managers.
+  virtual ::util::Status RegisterEventNotifyWriter(
+      const std::shared_ptr<WriterInterface<GnmiEventPtr>>& writer)
+      SHARED_LOCKS_REQUIRED(chassis_lock);
+
+  // Unregisters writer registered in RegisterEventNotifyWriter().
+  virtual ::util::Status UnregisterEventNotifyWriter()
+      SHARED_LOCKS_REQUIRED(chassis_lock);
+
+  // Returns the number of entries and the capacity of every table and action
+  // profile in the current pipeline.
+  virtual TableOccupancy GetTableOccupancy() const
+      SHARED_LOCKS_REQUIRED(chassis_lock);
 
   // Factory function for creating a BcmNode instance.
   static std::unique_ptr<BcmNode> CreateInstance(
@@ -161,6 +182,22 @@ class BcmNode {
       const ::p4::v1::PacketReplicationEngineEntry& entry,
       ::p4::v1::Update::Type type);
 
+  // Starts the multipath repair thread if it is not running yet.
+  ::util::Status StartMultipathRepairThread() LOCKS_EXCLUDED(repair_lock_);
+
+  // Stops the multipath repair thread, if running, and waits for it to exit.
+  // Any pending repair is dropped.
+  void StopMultipathRepairThread() LOCKS_EXCLUDED(lock_, repair_lock_);
+
+  // Thread function for the multipath repair thread. Invoked with "this" as
+  // the argument in pthread_create.
+  static void* MultipathRepairThreadFunc(void* arg);
+
+  // Waits for ports pending a repair and updates all the multipath groups
+  // referencing them in one batch. Runs until StopMultipathRepairThread() is
+  // called. Called by MultipathRepairThreadFunc.
+  void MultipathRepairLoop() LOCKS_EXCLUDED(chassis_lock, lock_, repair_lock_);
+
   // Reader-writer lock used to protect access to node-specific state.
   mutable absl::Mutex lock_;
 
@@ -188,6 +225,24 @@ class BcmNode {
   // this class instance. Assigned in the class constructor.
   const int unit_;
 
+  // Mutex and CondVar protecting the state shared with the multipath repair
+  // thread. Never held while acquiring chassis_lock or lock_.
+  absl::Mutex repair_lock_;
+  absl::CondVar repair_cond_var_;
+
+  // IDs of the ports whose state changed since the last multipath repair.
+  std::set<uint32> pending_repair_port_ids_ GUARDED_BY(repair_lock_);
+
+  // Set while the multipath repair thread is running. Cleared to ask the
+  // thread to exit, and by the thread itself when it exits on shutdown.
+  bool repair_thread_running_ GUARDED_BY(repair_lock_);
+
+  // Set from the creation of the multipath repair thread until it is joined.
+  bool repair_thread_joinable_ GUARDED_BY(repair_lock_);
+
+  // The multipath repair thread.
+  pthread_t repair_thread_id_;
+
   friend class BcmNodeTest;
 };
 
@@ -43,6 +43,12 @@ class BcmNodeMock : public BcmNode {
   MOCK_METHOD1(HandleStreamMessageRequest,
                ::util::Status(const ::p4::v1::StreamMessageRequest& req));
   MOCK_METHOD1(UpdatePortState, ::util::Status(uint32 port_id));
+  MOCK_METHOD1(
+      RegisterEventNotifyWriter,
+      ::util::Status(
+          const std::shared_ptr<WriterInterface<GnmiEventPtr>>& writer));
+  MOCK_METHOD0(UnregisterEventNotifyWriter, ::util::Status());
+  MOCK_CONST_METHOD0(GetTableOccupancy, TableOccupancy());
 };
 
 }  // namespace bcm
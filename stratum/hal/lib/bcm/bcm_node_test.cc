@@ -4,15 +4,20 @@
 
 #include "stratum/hal/lib/bcm/bcm_node.h"
 
+#include <set>
 #include <string>
 
 #include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "stratum/glue/status/canonical_errors.h"
 #include "stratum/glue/status/status_test_util.h"
 #include "stratum/hal/lib/bcm/bcm_acl_manager_mock.h"
+#include "stratum/hal/lib/bcm/bcm_global_vars.h"
 #include "stratum/hal/lib/bcm/bcm_l2_manager_mock.h"
 #include "stratum/hal/lib/bcm/bcm_l3_manager_mock.h"
 #include "stratum/hal/lib/bcm/bcm_packetio_manager_mock.h"
@@ -731,6 +736,9 @@ TEST_F(BcmNodeTest, PushForwardingPipelineConfigSuccess) {
     EXPECT_CALL(*p4_table_mapper_mock_,
                 PushForwardingPipelineConfig(EqualsProto(config)))
         .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bcm_table_manager_mock_,
+                PushForwardingPipelineConfig(EqualsProto(config)))
+        .WillOnce(Return(::util::OkStatus()));
     EXPECT_CALL(*bcm_acl_manager_mock_,
                 PushForwardingPipelineConfig(EqualsProto(config)))
         .WillOnce(Return(::util::OkStatus()));
@@ -758,6 +766,10 @@ TEST_F(BcmNodeTest, PushForwardingPipelineConfigFailueOnAnyManagerPushFailure) {
               PushForwardingPipelineConfig(EqualsProto(config)))
       .WillOnce(Return(DefaultError()))
       .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_table_manager_mock_,
+              PushForwardingPipelineConfig(EqualsProto(config)))
+      .WillOnce(Return(DefaultError()))
+      .WillRepeatedly(Return(::util::OkStatus()));
   EXPECT_CALL(*bcm_acl_manager_mock_,
               PushForwardingPipelineConfig(EqualsProto(config)))
       .WillOnce(Return(DefaultError()))
@@ -780,6 +792,8 @@ TEST_F(BcmNodeTest, PushForwardingPipelineConfigFailueOnAnyManagerPushFailure) {
               DerivedFromStatus(DefaultError()));
   EXPECT_THAT(PushForwardingPipelineConfig(config),
               DerivedFromStatus(DefaultError()));
+  EXPECT_THAT(PushForwardingPipelineConfig(config),
+              DerivedFromStatus(DefaultError()));
 }
 
 // VerifyForwardingPipelineConfig() should verify the config.
@@ -1653,20 +1667,85 @@ TEST_F(BcmNodeTest, UnregisterStreamMessageResponseWriter) {
               DerivedFromStatus(DefaultError()));
 }
 
-// Check functions invoked on UpdatePortState() call.
+// Check functions invoked on UpdatePortState() call. The multipath groups are
+// updated asynchronously, and an error in one update does not prevent the
+// following ones.
 TEST_F(BcmNodeTest, TestUpdatePortState) {
+  auto status = UpdatePortState(kPortId);
+  EXPECT_EQ(ERR_NOT_INITIALIZED, status.error_code());
+
   ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
 
   ::util::Status expected_error = ::util::UnknownErrorBuilder(GTL_LOC)
                                   << "error";
-  EXPECT_CALL(*bcm_l3_manager_mock_, UpdateMultipathGroupsForPort(kPortId))
-      .WillOnce(Return(::util::OkStatus()))
-      .WillOnce(Return(expected_error));
+  absl::Notification first_done, second_done;
+  EXPECT_CALL(*bcm_l3_manager_mock_,
+              UpdateMultipathGroupsForPorts(std::set<uint32>({kPortId})))
+      .WillOnce(DoAll(Invoke([&first_done](const std::set<uint32>&) {
+                        first_done.Notify();
+                      }),
+                      Return(expected_error)))
+      .WillOnce(DoAll(Invoke([&second_done](const std::set<uint32>&) {
+                        second_done.Notify();
+                      }),
+                      Return(::util::OkStatus())));
 
   EXPECT_OK(UpdatePortState(kPortId));
-  auto status = UpdatePortState(kPortId);
-  EXPECT_FALSE(status.ok());
-  EXPECT_EQ(expected_error.ToString(), status.ToString());
+  ASSERT_TRUE(first_done.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  EXPECT_OK(UpdatePortState(kPortId));
+  ASSERT_TRUE(second_done.WaitForNotificationWithTimeout(absl::Seconds(10)));
+}
+
+// Port state changes arriving while a multipath update is in progress are
+// coalesced into a single update covering all the ports.
+TEST_F(BcmNodeTest, TestUpdatePortStateCoalescesFlaps) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+
+  constexpr uint32 kOtherPortId = kPortId + 1;
+  absl::Notification first_started, first_release, second_done;
+  {
+    InSequence sequence;
+    EXPECT_CALL(*bcm_l3_manager_mock_,
+                UpdateMultipathGroupsForPorts(std::set<uint32>({kPortId})))
+        .WillOnce(DoAll(
+            Invoke([&first_started, &first_release](const std::set<uint32>&) {
+              first_started.Notify();
+              first_release.WaitForNotification();
+            }),
+            Return(::util::OkStatus())));
+    EXPECT_CALL(*bcm_l3_manager_mock_,
+                UpdateMultipathGroupsForPorts(
+                    std::set<uint32>({kPortId, kOtherPortId})))
+        .WillOnce(DoAll(Invoke([&second_done](const std::set<uint32>&) {
+                          second_done.Notify();
+                        }),
+                        Return(::util::OkStatus())));
+  }
+
+  EXPECT_OK(UpdatePortState(kPortId));
+  ASSERT_TRUE(first_started.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_OK(UpdatePortState(kPortId));
+    EXPECT_OK(UpdatePortState(kOtherPortId));
+  }
+  first_release.Notify();
+  ASSERT_TRUE(second_done.WaitForNotificationWithTimeout(absl::Seconds(10)));
+}
+
+// The multipath repair thread exits on shutdown, after which port state
+// changes are rejected instead of being queued for a thread that is gone.
+TEST_F(BcmNodeTest, TestUpdatePortStateAfterShutdown) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+
+  shutdown = true;
+  EXPECT_OK(UpdatePortState(kPortId));
+  ::util::Status status;
+  for (int i = 0; i < 1000 && status.ok(); ++i) {
+    absl::SleepFor(absl::Milliseconds(10));
+    status = UpdatePortState(kPortId);
+  }
+  shutdown = false;
+  EXPECT_EQ(ERR_NOT_INITIALIZED, status.error_code());
 }
 
 // TODO(unknown): Complete unit test coverage.
@@ -29,6 +29,7 @@
 #include "stratum/glue/gtl/stl_util.h"
 #include "stratum/glue/integral_types.h"
 #include "stratum/glue/logging.h"
+#include "stratum/lib/liveness_watchdog.h"
 #include "stratum/lib/macros.h"
 #include "stratum/lib/utils.h"
 
@@ -1017,7 +1018,11 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
     return MAKE_ERROR(ERR_INTERNAL)
            << "epoll_ctl() failed. errno: " << errno << ".";
   }
+  auto worker = LivenessWatchdog::GetInstance()->RegisterWorker(
+      absl::Substitute("BcmPacketioManager RX $0 (unit $1)",
+                       GoogleConfig::BcmKnetIntfPurpose_Name(purpose), unit_));
   while (true) {
+    worker->Heartbeat();
     {
       absl::ReaderMutexLock l(&chassis_lock);
       if (shutdown) break;
@@ -1125,6 +1130,7 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
           }
         }
       }
+      worker->ReportProgress(packets.size());
     }
   }
 
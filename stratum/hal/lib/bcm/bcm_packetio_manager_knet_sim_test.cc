@@ -0,0 +1,353 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+// Packet I/O tests and benchmarks of BcmPacketioManager running on top of the
+// emulated KNET netifs of SimKnetLibcProxy.
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/substitute.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gflags/gflags.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/bcm/bcm_chassis_ro_mock.h"
+#include "stratum/hal/lib/bcm/bcm_packetio_manager.h"
+#include "stratum/hal/lib/bcm/bcm_sdk_mock.h"
+#include "stratum/hal/lib/bcm/sim_knet_libc_proxy.h"
+#include "stratum/hal/lib/common/writer_interface.h"
+#include "stratum/hal/lib/p4/p4_table_mapper_mock.h"
+#include "stratum/lib/libcproxy/libcwrapper.h"
+#include "stratum/lib/macros.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+DECLARE_int32(knet_rx_buf_size);
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::Invoke;
+using ::testing::Return;
+using ::testing::SetArgPointee;
+
+namespace {
+
+// A packet-in writer counting the packets, which can be blocked to emulate a
+// slow controller.
+class CountingWriter : public WriterInterface<::p4::v1::PacketIn> {
+ public:
+  CountingWriter() : blocked_(false), num_packets_(0) {}
+
+  bool Write(const ::p4::v1::PacketIn& msg) override {
+    absl::MutexLock l(&lock_);
+    lock_.Await(absl::Condition(this, &CountingWriter::IsUnblocked));
+    ++num_packets_;
+    return true;
+  }
+
+  void Block() {
+    absl::MutexLock l(&lock_);
+    blocked_ = true;
+  }
+
+  void Unblock() {
+    absl::MutexLock l(&lock_);
+    blocked_ = false;
+  }
+
+  uint64 GetNumPackets() const {
+    absl::MutexLock l(&lock_);
+    return num_packets_;
+  }
+
+ private:
+  bool IsUnblocked() const EXCLUSIVE_LOCKS_REQUIRED(lock_) {
+    return !blocked_;
+  }
+
+  mutable absl::Mutex lock_;
+  bool blocked_ GUARDED_BY(lock_);
+  uint64 num_packets_ GUARDED_BY(lock_);
+};
+
+// Waits up to 10 seconds for the condition to be true.
+bool WaitFor(const std::function<bool()>& condition) {
+  const absl::Time deadline = absl::Now() + absl::Seconds(10);
+  while (!condition()) {
+    if (absl::Now() > deadline) return false;
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  return true;
+}
+
+}  // namespace
+
+class BcmPacketioManagerKnetSimTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    saved_knet_rx_buf_size_ = FLAGS_knet_rx_buf_size;
+    sim_ = SimKnetLibcProxy::CreateInstance(SimKnetLibcProxy::Options());
+    saved_proxy_ = LibcWrapper::GetLibcProxy();
+    LibcWrapper::SetLibcProxy(sim_.get());
+    bcm_chassis_ro_mock_ = absl::make_unique<BcmChassisRoMock>();
+    p4_table_mapper_mock_ = absl::make_unique<P4TableMapperMock>();
+    bcm_sdk_mock_ = absl::make_unique<BcmSdkMock>();
+    bcm_packetio_manager_ = BcmPacketioManager::CreateInstance(
+        OPERATION_MODE_STANDALONE, bcm_chassis_ro_mock_.get(),
+        p4_table_mapper_mock_.get(), bcm_sdk_mock_.get(), kUnit);
+    {
+      absl::WriterMutexLock l(&chassis_lock);
+      shutdown = false;
+    }
+  }
+
+  void TearDown() override {
+    bcm_packetio_manager_.reset();
+    LibcWrapper::SetLibcProxy(saved_proxy_);
+    FLAGS_knet_rx_buf_size = saved_knet_rx_buf_size_;
+  }
+
+  // Pushes a config with a single port and the default controller KNET
+  // interface, backed by an emulated netif.
+  void PushChassisConfig() {
+    const std::string config_text = absl::Substitute(
+        R"(
+          chassis { platform: PLT_GENERIC_TOMAHAWK name: "standalone" }
+          nodes { id: $0 slot: 1 }
+          singleton_ports { id: $1 slot: 1 port: 1 speed_bps: 100000000000 }
+        )",
+        kNodeId, kPortId);
+    ChassisConfig config;
+    ASSERT_OK(ParseProtoFromString(config_text, &config));
+
+    EXPECT_CALL(*bcm_chassis_ro_mock_, GetPortIdToSdkPortMap(kNodeId))
+        .WillOnce(Return(std::map<uint32, SdkPort>(
+            {{kPortId, SdkPort(kUnit, kLogicalPort)}})));
+    EXPECT_CALL(*bcm_sdk_mock_, StartRx(kUnit, _))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bcm_sdk_mock_, CreateKnetIntf(kUnit, _, _, _))
+        .WillOnce(Invoke([this](int unit, int vlan, std::string* netif_name,
+                                int* netif_id) {
+          // Like the KNET module, create the netif.
+          *netif_name = kNetifName;
+          *netif_id = kNetifId;
+          sim_->AddNetif(kNetifName, kNetifMac);
+          return ::util::OkStatus();
+        }));
+    EXPECT_CALL(*bcm_sdk_mock_, CreateKnetFilter(kUnit, kNetifId, _))
+        .WillOnce(Return(kFilterId));
+    EXPECT_CALL(*bcm_sdk_mock_, GetKnetHeaderSizeForRx(kUnit))
+        .WillRepeatedly(Return(SimKnetLibcProxy::kRxKnetHeaderSize));
+    EXPECT_CALL(*bcm_sdk_mock_, ParseKnetHeaderForRx(kUnit, _, _, _, _))
+        .WillRepeatedly(Invoke([](int unit, const std::string& header,
+                                  int* ingress_logical_port,
+                                  int* egress_logical_port,
+                                  int* cos) -> ::util::Status {
+          SimKnetLibcProxy::RxMetadata meta;
+          RETURN_IF_ERROR(SimKnetLibcProxy::ParseRxKnetHeader(header, &meta));
+          *ingress_logical_port = meta.src_port;
+          *egress_logical_port = meta.op_code == 1 ? meta.dst_port : 0;
+          *cos = meta.cos;
+          return ::util::OkStatus();
+        }));
+    EXPECT_CALL(*bcm_chassis_ro_mock_, GetParentTrunkId(kNodeId, kPortId))
+        .WillRepeatedly(Return(::util::Status(StratumErrorSpace(),
+                                              ERR_ENTRY_NOT_FOUND, "")));
+    EXPECT_CALL(*p4_table_mapper_mock_, DeparsePacketInMetadata(_, _))
+        .WillRepeatedly(Return(::util::OkStatus()));
+
+    absl::WriterMutexLock l(&chassis_lock);
+    ASSERT_OK(bcm_packetio_manager_->PushChassisConfig(config, kNodeId));
+  }
+
+  void Shutdown() {
+    EXPECT_CALL(*bcm_sdk_mock_, DestroyKnetFilter(kUnit, kFilterId))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bcm_sdk_mock_, DestroyKnetIntf(kUnit, kNetifId))
+        .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bcm_sdk_mock_, StopRx(kUnit))
+        .WillOnce(Return(::util::OkStatus()));
+    {
+      absl::WriterMutexLock l(&chassis_lock);
+      shutdown = true;
+    }
+    ASSERT_OK(bcm_packetio_manager_->Shutdown());
+  }
+
+  // Returns a packet punted to the CPU from the test port.
+  static std::string RxPacket() {
+    SimKnetLibcProxy::RxMetadata meta;
+    meta.src_port = kLogicalPort;
+    meta.cos = 1;
+    return SimKnetLibcProxy::BuildRxKnetPacket(
+        meta, std::string(kTestPacket, sizeof(kTestPacket) - 1));
+  }
+
+  BcmKnetRxStats GetRxStats() {
+    auto ret = bcm_packetio_manager_->GetRxStats(kPurpose);
+    EXPECT_OK(ret.status());
+    return ret.ok() ? ret.ValueOrDie() : BcmKnetRxStats();
+  }
+
+  // A test IPv4 packet. See bcm_packetio_manager_test.cc.
+  static constexpr char kTestPacket[] =
+      "\x02\x32\x00\x00\x00\x01\x00\x00\x00\x00\x00\x01\x81\x00\x00\x01\x08\x00"
+      "\x45\x00\x00\x2d\x00\x01\x00\x00\x40\xfe\x62\xd1\x0a\x00\x01\x01\x0a\x00"
+      "\x02\x01\x54\x65\x73\x74\x2c\x20\x54\x65\x73\x74\x2c\x20\x54\x65\x73\x74"
+      "\x2c\x20\x54\x65\x73\x74\x21\x21\x21";
+  static constexpr char kNetifName[] = "knet-0-1";
+  static constexpr GoogleConfig::BcmKnetIntfPurpose kPurpose =
+      GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER;
+  static constexpr uint64 kNodeId = 123123123;
+  static constexpr int kUnit = 0;
+  static constexpr uint32 kPortId = 1111;
+  static constexpr int kLogicalPort = 33;
+  static constexpr int kNetifId = 199;
+  static constexpr uint64 kNetifMac = 0x021122334455ULL;
+  static constexpr int kFilterId = 10000;
+
+  int32 saved_knet_rx_buf_size_;
+  PassthroughLibcProxy* saved_proxy_;
+  std::unique_ptr<SimKnetLibcProxy> sim_;
+  std::unique_ptr<BcmChassisRoMock> bcm_chassis_ro_mock_;
+  std::unique_ptr<P4TableMapperMock> p4_table_mapper_mock_;
+  std::unique_ptr<BcmSdkMock> bcm_sdk_mock_;
+  std::unique_ptr<BcmPacketioManager> bcm_packetio_manager_;
+};
+
+constexpr char BcmPacketioManagerKnetSimTest::kTestPacket[];
+constexpr char BcmPacketioManagerKnetSimTest::kNetifName[];
+constexpr GoogleConfig::BcmKnetIntfPurpose
+    BcmPacketioManagerKnetSimTest::kPurpose;
+constexpr uint64 BcmPacketioManagerKnetSimTest::kNodeId;
+constexpr int BcmPacketioManagerKnetSimTest::kUnit;
+constexpr uint32 BcmPacketioManagerKnetSimTest::kPortId;
+constexpr int BcmPacketioManagerKnetSimTest::kLogicalPort;
+constexpr int BcmPacketioManagerKnetSimTest::kNetifId;
+constexpr uint64 BcmPacketioManagerKnetSimTest::kNetifMac;
+constexpr int BcmPacketioManagerKnetSimTest::kFilterId;
+
+TEST_F(BcmPacketioManagerKnetSimTest, PacketInRate) {
+  constexpr uint64 kNumPackets = 20000;
+  // Large enough a receive buffer for the whole burst, so nothing is dropped.
+  FLAGS_knet_rx_buf_size = 4 << 20;
+  PushChassisConfig();
+  auto writer = std::make_shared<CountingWriter>();
+  ASSERT_OK(bcm_packetio_manager_->RegisterPacketReceiveWriter(kPurpose,
+                                                               writer));
+
+  const absl::Time start = absl::Now();
+  ASSERT_OK(sim_->StartTrafficGenerator(kNetifName, RxPacket(), kNumPackets,
+                                        /*rate_pps=*/0));
+  EXPECT_EQ(static_cast<int64>(kNumPackets),
+            sim_->StopTrafficGenerator(absl::Seconds(10)));
+  ASSERT_TRUE(
+      WaitFor([&writer]() { return writer->GetNumPackets() == kNumPackets; }))
+      << writer->GetNumPackets() << " packets received.";
+  const absl::Duration elapsed = absl::Now() - start;
+  LOG(INFO) << "Packet-in rate: "
+            << kNumPackets / absl::ToDoubleSeconds(elapsed) << " pps.";
+
+  auto sim_stats = sim_->GetNetifStats(kNetifName);
+  EXPECT_EQ(kNumPackets, sim_stats.rx_delivered);
+  EXPECT_EQ(0U, sim_stats.rx_dropped);
+  auto rx_stats = GetRxStats();
+  EXPECT_EQ(kNumPackets, rx_stats.all_rx);
+  EXPECT_EQ(kNumPackets, rx_stats.rx_accepts);
+  EXPECT_EQ(0U, rx_stats.rx_drops_knet_header_parse_error);
+  EXPECT_EQ(0U, rx_stats.rx_drops_unknown_ingress_port);
+  EXPECT_EQ(0U, rx_stats.rx_errors_invalid_packet);
+
+  Shutdown();
+}
+
+TEST_F(BcmPacketioManagerKnetSimTest, PacketInDropsWhenControllerIsSlow) {
+  constexpr uint64 kNumPackets = 1000;
+  // Room for a few tens of packets only.
+  FLAGS_knet_rx_buf_size = 4096;
+  PushChassisConfig();
+  auto writer = std::make_shared<CountingWriter>();
+  writer->Block();
+  ASSERT_OK(bcm_packetio_manager_->RegisterPacketReceiveWriter(kPurpose,
+                                                               writer));
+
+  // The RX thread gets stuck writing the first packets, while the generator
+  // overflows the socket receive buffer.
+  ASSERT_OK(sim_->StartTrafficGenerator(kNetifName, RxPacket(), kNumPackets,
+                                        /*rate_pps=*/0));
+  EXPECT_EQ(static_cast<int64>(kNumPackets),
+            sim_->StopTrafficGenerator(absl::Seconds(10)));
+  writer->Unblock();
+
+  // Every packet is either dropped by the socket, or makes it to the writer.
+  SimKnetLibcProxy::NetifStats sim_stats;
+  ASSERT_TRUE(WaitFor([&]() {
+    sim_stats = sim_->GetNetifStats(kNetifName);
+    return writer->GetNumPackets() + sim_stats.rx_dropped == kNumPackets;
+  })) << writer->GetNumPackets() << " packets received, "
+      << sim_stats.rx_dropped << " dropped.";
+  EXPECT_GT(sim_stats.rx_dropped, 0U);
+  EXPECT_EQ(sim_stats.rx_delivered, writer->GetNumPackets());
+  EXPECT_EQ(sim_stats.rx_delivered, GetRxStats().rx_accepts);
+
+  Shutdown();
+}
+
+TEST_F(BcmPacketioManagerKnetSimTest, PacketOutRate) {
+  constexpr uint64 kNumPackets = 20000;
+  const std::string kTxHeader(64, '\x01');
+  PushChassisConfig();
+
+  ::p4::v1::PacketOut packet;
+  packet.set_payload(kTestPacket, sizeof(kTestPacket) - 1);
+  packet.add_metadata()->set_metadata_id(1);
+  EXPECT_CALL(*p4_table_mapper_mock_, ParsePacketOutMetadata(_, _))
+      .WillRepeatedly(Invoke([](const ::p4::v1::PacketMetadata& m,
+                                MappedPacketMetadata* mapped) {
+        mapped->set_type(P4_FIELD_TYPE_EGRESS_PORT);
+        mapped->set_u32(kPortId);
+        return ::util::OkStatus();
+      }));
+  EXPECT_CALL(*bcm_chassis_ro_mock_, GetPortState(kNodeId, kPortId))
+      .WillRepeatedly(Return(PORT_STATE_UP));
+  EXPECT_CALL(*bcm_sdk_mock_,
+              GetKnetHeaderForDirectTx(kUnit, kLogicalPort, _, _, _, _))
+      .WillRepeatedly(
+          DoAll(SetArgPointee<5>(kTxHeader), Return(::util::OkStatus())));
+
+  const absl::Time start = absl::Now();
+  for (uint64 i = 0; i < kNumPackets; ++i) {
+    absl::ReaderMutexLock l(&chassis_lock);
+    ASSERT_OK(bcm_packetio_manager_->TransmitPacket(kPurpose, packet));
+  }
+  const absl::Duration elapsed = absl::Now() - start;
+  LOG(INFO) << "Packet-out rate: "
+            << kNumPackets / absl::ToDoubleSeconds(elapsed) << " pps.";
+
+  auto sim_stats = sim_->GetNetifStats(kNetifName);
+  EXPECT_EQ(kNumPackets, sim_stats.tx_packets);
+  auto tx_packets = sim_->GetTxPackets(kNetifName);
+  ASSERT_FALSE(tx_packets.empty());
+  EXPECT_EQ(kTxHeader + packet.payload(), tx_packets.back());
+  auto tx_stats = bcm_packetio_manager_->GetTxStats(kPurpose);
+  ASSERT_OK(tx_stats.status());
+  EXPECT_EQ(kNumPackets, tx_stats.ValueOrDie().tx_accepts_direct);
+  EXPECT_EQ(0U, tx_stats.ValueOrDie().tx_errors_internal_send_failures);
+
+  Shutdown();
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
@@ -224,6 +224,20 @@ class BcmSdkInterface {
   virtual ::util::Status GetPortCounters(int unit, int port,
                                          PortCounters* pc) = 0;
 
+  // Gets the counters of all the front panel ports of a unit in one pass, as a
+  // map from logical port to counters. Much cheaper than one GetPortCounters()
+  // call per port on units with many ports. Ports whose counters cannot be
+  // read are logged and left out of the map, instead of failing the call.
+  virtual ::util::StatusOr<std::map<int, PortCounters>> GetAllPortCounters(
+      int unit) = 0;
+
+  // Gets the counters of all the CoS queues of all the front panel ports of a
+  // unit in one pass, as a map from logical port to the counters of its
+  // queues, indexed by CoS queue number. Ports whose queue counters cannot be
+  // read are logged and left out of the map, instead of failing the call.
+  virtual ::util::StatusOr<std::map<int, std::vector<PortQosCounters>>>
+  GetPortQueueCounters(int unit) = 0;
+
   // Starts the diag shell server for listening to client telnet connections.
   virtual ::util::Status StartDiagShellServer() = 0;
 
@@ -343,6 +357,16 @@ class BcmSdkInterface {
   virtual ::util::Status ModifyEcmpEgressIntf(
       int unit, int egress_intf_id, const std::vector<int>& member_ids) = 0;
 
+  // Modifies the members of a batch of existing ECMP/WCMP egress intfs on a
+  // unit. The given map is keyed by the ECMP/WCMP egress intf ID and holds the
+  // new list of member egress intf IDs for each group. All the groups are
+  // attempted even if some of them fail, and the returned status includes all
+  // the errors. Used to repair a large number of groups at once, e.g. after a
+  // port goes down.
+  virtual ::util::Status ModifyEcmpEgressIntfs(
+      int unit,
+      const std::map<int, std::vector<int>>& egress_intf_id_to_member_ids) = 0;
+
   // Deletes an L3 ECMP/WCMP egress intf given its ID from a given unit.
   virtual ::util::Status DeleteEcmpEgressIntf(int unit, int egress_intf_id) = 0;
 
@@ -5,6 +5,7 @@
 #ifndef STRATUM_HAL_LIB_BCM_BCM_SDK_MOCK_H_
 #define STRATUM_HAL_LIB_BCM_BCM_SDK_MOCK_H_
 
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -40,6 +41,11 @@ class BcmSdkMock : public BcmSdkInterface {
                ::util::Status(int unit, int port, BcmPortOptions* options));
   MOCK_METHOD3(GetPortCounters,
                ::util::Status(int unit, int port, PortCounters* pc));
+  MOCK_METHOD1(GetAllPortCounters,
+               ::util::StatusOr<std::map<int, PortCounters>>(int unit));
+  MOCK_METHOD1(
+      GetPortQueueCounters,
+      ::util::StatusOr<std::map<int, std::vector<PortQosCounters>>>(int unit));
   MOCK_METHOD0(StartDiagShellServer, ::util::Status());
   MOCK_METHOD1(StartLinkscan, ::util::Status(int unit));
   MOCK_METHOD1(StopLinkscan, ::util::Status(int unit));
@@ -83,6 +89,10 @@ class BcmSdkMock : public BcmSdkInterface {
   MOCK_METHOD3(ModifyEcmpEgressIntf,
                ::util::Status(int unit, int egress_intf_id,
                               const std::vector<int>& member_ids));
+  MOCK_METHOD2(ModifyEcmpEgressIntfs,
+               ::util::Status(int unit,
+                              const std::map<int, std::vector<int>>&
+                                  egress_intf_id_to_member_ids));
   MOCK_METHOD2(DeleteEcmpEgressIntf,
                ::util::Status(int unit, int egress_intf_id));
   MOCK_METHOD7(AddL3RouteIpv4,
@@ -74,6 +74,21 @@ BcmSwitch::~BcmSwitch() {}
   return DoVerifyChassisConfig(config);
 }
 
+::util::Status BcmSwitch::PlanChassisConfig(const ChassisConfig& config,
+                                            ChassisConfigPlan* plan) {
+  absl::ReaderMutexLock l(&chassis_lock);
+  if (shutdown) {
+    return MAKE_ERROR(ERR_CANCELLED) << "Switch is shutdown.";
+  }
+  // A config which needs a reboot is still planned. The chassis manager
+  // reports it in the plan.
+  ::util::Status status = DoVerifyChassisConfig(config);
+  if (!status.ok() && status.error_code() != ERR_REBOOT_REQUIRED) {
+    return status;
+  }
+  return bcm_chassis_manager_->PlanChassisConfig(config, plan);
+}
+
 ::util::Status BcmSwitch::PushForwardingPipelineConfig(
     uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
   absl::ReaderMutexLock l(&chassis_lock);
@@ -228,8 +243,10 @@ BcmSwitch::~BcmSwitch() {}
   if (shutdown) {
     return MAKE_ERROR(ERR_CANCELLED) << "Switch is shutdown.";
   }
-  RETURN_IF_ERROR(
-      bcm_chassis_manager_->RegisterEventNotifyWriter(std::move(writer)));
+  RETURN_IF_ERROR(bcm_chassis_manager_->RegisterEventNotifyWriter(writer));
+  for (const auto& entry : unit_to_bcm_node_) {
+    RETURN_IF_ERROR(entry.second->RegisterEventNotifyWriter(writer));
+  }
   return ::util::OkStatus();
 }
 
@@ -238,8 +255,14 @@ BcmSwitch::~BcmSwitch() {}
   if (shutdown) {
     return MAKE_ERROR(ERR_CANCELLED) << "Switch is shutdown.";
   }
-  RETURN_IF_ERROR(bcm_chassis_manager_->UnregisterEventNotifyWriter());
-  return ::util::OkStatus();
+  ::util::Status status = ::util::OkStatus();
+  APPEND_STATUS_IF_ERROR(status,
+                         bcm_chassis_manager_->UnregisterEventNotifyWriter());
+  for (const auto& entry : unit_to_bcm_node_) {
+    APPEND_STATUS_IF_ERROR(status,
+                           entry.second->UnregisterEventNotifyWriter());
+  }
+  return status;
 }
 
 ::util::Status BcmSwitch::RetrieveValue(uint64 /*node_id*/,
@@ -378,21 +401,25 @@ BcmSwitch::~BcmSwitch() {}
         break;
       }
       case DataRequest::Request::kPortQosCounters: {
-        // Find current counters for port's qos queue located at:
-        // - node_id: req.port_qos_counters().node_id()
-        // - port_id: req.port_qos_counters().port_id()
-        // - queue_id: req.port_qos_counters().queue_id()
-        // and then write it into the response.
         auto* counters = resp.mutable_port_qos_counters();
-        // To simulate the counters being incremented the current time expressed
-        // in nanoseconds since Jan 1st, 1970 is used.
-        // TODO(unknown) Remove this hack once the real counters are
-        // available.
-        uint64 now = absl::GetCurrentTimeNanos();
-        counters->set_out_octets(now);
-        counters->set_out_pkts(now);
-        counters->set_out_dropped_pkts(now);
-        counters->set_queue_id(req.port_qos_counters().queue_id());
+        ::util::Status qos_status = bcm_chassis_manager_->GetPortQosCounters(
+            req.port_qos_counters().node_id(),
+            req.port_qos_counters().port_id(),
+            req.port_qos_counters().queue_id(), counters);
+        if (qos_status.error_code() == ERR_UNIMPLEMENTED) {
+          // The SDK cannot read the CoS queue counters yet (SDKLT). To
+          // simulate the counters being incremented the current time
+          // expressed in nanoseconds since Jan 1st, 1970 is used.
+          // TODO(unknown) Remove this hack once the real counters are
+          // available on all SDKs.
+          uint64 now = absl::GetCurrentTimeNanos();
+          counters->set_out_octets(now);
+          counters->set_out_pkts(now);
+          counters->set_out_dropped_pkts(now);
+          counters->set_queue_id(req.port_qos_counters().queue_id());
+          break;
+        }
+        status.Update(qos_status);
         break;
       }
       case DataRequest::Request::kNodePacketioDebugInfo:
@@ -431,6 +458,16 @@ BcmSwitch::~BcmSwitch() {}
         // Return the requested port ID because port translation is performed.
         resp.mutable_sdn_port_id()->set_port_id(req.sdn_port_id().port_id());
         break;
+      case DataRequest::Request::kTableOccupancy: {
+        auto bcm_node = GetBcmNodeFromNodeId(req.table_occupancy().node_id());
+        if (!bcm_node.ok()) {
+          status.Update(bcm_node.status());
+        } else {
+          *resp.mutable_table_occupancy() =
+              bcm_node.ValueOrDie()->GetTableOccupancy();
+        }
+        break;
+      }
       default:
         status =
             MAKE_ERROR(ERR_UNIMPLEMENTED)
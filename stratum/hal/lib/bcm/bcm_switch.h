@@ -33,6 +33,9 @@ class BcmSwitch : public SwitchInterface {
       LOCKS_EXCLUDED(chassis_lock);
   ::util::Status VerifyChassisConfig(const ChassisConfig& config) override
       LOCKS_EXCLUDED(chassis_lock);
+  ::util::Status PlanChassisConfig(const ChassisConfig& config,
+                                   ChassisConfigPlan* plan) override
+      LOCKS_EXCLUDED(chassis_lock);
   ::util::Status PushForwardingPipelineConfig(
       uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) override
       LOCKS_EXCLUDED(chassis_lock);
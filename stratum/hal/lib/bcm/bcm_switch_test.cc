@@ -33,6 +33,7 @@ using ::testing::Invoke;
 using ::testing::Pointee;
 using ::testing::Return;
 using ::testing::Sequence;
+using ::testing::SetArgPointee;
 using ::testing::WithArg;
 using ::testing::WithArgs;
 
@@ -405,6 +406,8 @@ TEST_F(BcmSwitchTest, RegisterEventNotifyWriterTest) {
   EXPECT_CALL(*bcm_chassis_manager_mock_, RegisterEventNotifyWriter(writer))
       .WillOnce(Return(::util::OkStatus()))
       .WillOnce(Return(DefaultError()));
+  EXPECT_CALL(*bcm_node_mock_, RegisterEventNotifyWriter(writer))
+      .WillOnce(Return(::util::OkStatus()));
 
   // Successful BcmChassisManager registration.
   EXPECT_OK(bcm_switch_->RegisterEventNotifyWriter(writer));
@@ -616,21 +619,70 @@ TEST_F(BcmSwitchTest, GetForwardingViablePass) {
   EXPECT_THAT(details.at(0), ::util::OkStatus());
 }
 
-TEST_F(BcmSwitchTest, GetQosQueueCountersPass) {
+TEST_F(BcmSwitchTest, GetQosQueueCounters) {
+  PushChassisConfigSuccess();
+
   WriterMock<DataResponse> writer;
   DataResponse resp;
-  // Expect Write() call and store data in resp.
+
+  // Expect successful retrieval followed by failure.
+  PortQosCounters counters;
+  counters.set_queue_id(4);
+  counters.set_out_octets(1000);
+  counters.set_out_pkts(10);
+  counters.set_out_dropped_pkts(2);
+  ::util::Status error = ::util::UnknownErrorBuilder(GTL_LOC) << "error";
+  EXPECT_CALL(*bcm_chassis_manager_mock_,
+              GetPortQosCounters(kNodeId, kPortId, 4, _))
+      .WillOnce(DoAll(SetArgPointee<3>(counters), Return(::util::OkStatus())))
+      .WillOnce(Return(error));
   ExpectMockWriteDataResponse(&writer, &resp);
 
   DataRequest req;
   auto* request = req.add_requests()->mutable_port_qos_counters();
-  request->set_node_id(1);
-  request->set_port_id(2);
+  request->set_node_id(kNodeId);
+  request->set_port_id(kPortId);
   request->set_queue_id(4);
+  std::vector<::util::Status> details;
+
+  EXPECT_OK(bcm_switch_->RetrieveValue(kNodeId, req, &writer, &details));
+  EXPECT_TRUE(resp.has_port_qos_counters());
+  EXPECT_THAT(resp.port_qos_counters(), EqualsProto(counters));
+  ASSERT_EQ(details.size(), 1);
+  EXPECT_THAT(details.at(0), ::util::OkStatus());
+
+  details.clear();
+  resp.Clear();
+  EXPECT_OK(bcm_switch_->RetrieveValue(kNodeId, req, &writer, &details));
+  EXPECT_FALSE(resp.has_port_qos_counters());
+  ASSERT_EQ(details.size(), 1);
+  EXPECT_EQ(error.ToString(), details.at(0).ToString());
+}
 
+TEST_F(BcmSwitchTest, GetQosQueueCountersUnimplementedBySdk) {
+  PushChassisConfigSuccess();
+
+  WriterMock<DataResponse> writer;
+  DataResponse resp;
+
+  // SDKs which cannot read the CoS queue counters still get a response.
+  EXPECT_CALL(*bcm_chassis_manager_mock_,
+              GetPortQosCounters(kNodeId, kPortId, 4, _))
+      .WillOnce(Return(::util::Status(StratumErrorSpace(), ERR_UNIMPLEMENTED,
+                                      "not implemented")));
+  ExpectMockWriteDataResponse(&writer, &resp);
+
+  DataRequest req;
+  auto* request = req.add_requests()->mutable_port_qos_counters();
+  request->set_node_id(kNodeId);
+  request->set_port_id(kPortId);
+  request->set_queue_id(4);
   std::vector<::util::Status> details;
+
   EXPECT_OK(bcm_switch_->RetrieveValue(kNodeId, req, &writer, &details));
   EXPECT_TRUE(resp.has_port_qos_counters());
+  EXPECT_EQ(4, resp.port_qos_counters().queue_id());
+  EXPECT_GT(resp.port_qos_counters().out_pkts(), 0);
   ASSERT_EQ(details.size(), 1);
   EXPECT_THAT(details.at(0), ::util::OkStatus());
 }
@@ -707,6 +759,38 @@ TEST_F(BcmSwitchTest, GetSdnPortId) {
   EXPECT_THAT(details.at(0), ::util::OkStatus());
 }
 
+TEST_F(BcmSwitchTest, GetTableOccupancy) {
+  PushChassisConfigSuccess();
+
+  WriterMock<DataResponse> writer;
+  DataResponse resp;
+  TableOccupancy occupancy;
+  auto* table = occupancy.add_tables();
+  table->set_id(33583783);
+  table->set_name("ingress.table1");
+  table->set_entries(10);
+  table->set_capacity(1024);
+  EXPECT_CALL(*bcm_node_mock_, GetTableOccupancy()).WillOnce(Return(occupancy));
+  // Expect Write() call and store data in resp.
+  ExpectMockWriteDataResponse(&writer, &resp);
+
+  DataRequest req;
+  req.add_requests()->mutable_table_occupancy()->set_node_id(kNodeId);
+  std::vector<::util::Status> details;
+
+  EXPECT_OK(bcm_switch_->RetrieveValue(kNodeId, req, &writer, &details));
+  EXPECT_THAT(resp.table_occupancy(), EqualsProto(occupancy));
+  ASSERT_EQ(details.size(), 1);
+  EXPECT_THAT(details.at(0), ::util::OkStatus());
+
+  // An unknown node is reported in the details.
+  details.clear();
+  req.mutable_requests(0)->mutable_table_occupancy()->set_node_id(kNodeId + 1);
+  EXPECT_OK(bcm_switch_->RetrieveValue(kNodeId, req, &writer, &details));
+  ASSERT_EQ(details.size(), 1);
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, details.at(0).error_code());
+}
+
 TEST_F(BcmSwitchTest, SetPortAdminStatusPass) {
   SetRequest req;
   auto* request = req.add_requests()->mutable_port();
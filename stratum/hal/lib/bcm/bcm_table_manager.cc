@@ -272,6 +272,7 @@ BcmTableManager::BcmTableManager(
       groups_(),
       bcm_chassis_ro_interface_(ABSL_DIE_IF_NULL(bcm_chassis_ro_interface)),
       p4_table_mapper_(ABSL_DIE_IF_NULL(p4_table_mapper)),
+      gnmi_event_writer_(nullptr),
       node_id_(0),
       unit_(unit) {}
 
@@ -284,6 +285,7 @@ BcmTableManager::BcmTableManager()
       groups_(),
       bcm_chassis_ro_interface_(nullptr),
       p4_table_mapper_(nullptr),
+      gnmi_event_writer_(nullptr),
       node_id_(0),
       unit_(-1) {}
 
@@ -347,7 +349,23 @@ BcmTableManager::~BcmTableManager() {}
 
 ::util::Status BcmTableManager::PushForwardingPipelineConfig(
     const ::p4::v1::ForwardingPipelineConfig& config) {
-  // TODO(unknown): Implement this function if needed.
+  // The entries programmed on the node survive the push, so the occupancy of
+  // the new pipeline starts from the entries already stored here.
+  occupancy_tracker_.Reset(config.p4info());
+  for (const auto& e : generic_flow_tables_) {
+    for (int i = 0; i < e.second.EntryCount(); ++i) {
+      occupancy_tracker_.RecordInsert(e.first, nullptr);
+    }
+  }
+  for (const auto& e : acl_tables_) {
+    for (int i = 0; i < e.second.EntryCount(); ++i) {
+      occupancy_tracker_.RecordInsert(e.first, nullptr);
+    }
+  }
+  for (const auto& e : members_) {
+    occupancy_tracker_.RecordInsert(e.second.action_profile_id(), nullptr);
+  }
+
   return ::util::OkStatus();
 }
 
@@ -910,6 +928,15 @@ namespace {
       action_profile_group, &unused_mapped_action));
 
   // Action profile entry -> BCM multipath nexthop mapping.
+  absl::flat_hash_map<int, PortState> port_states;
+  return FillLiveBcmMultipathNexthopMembers(action_profile_group, &port_states,
+                                            bcm_multipath_nexthop);
+}
+
+::util::Status BcmTableManager::FillLiveBcmMultipathNexthopMembers(
+    const ::p4::v1::ActionProfileGroup& action_profile_group,
+    absl::flat_hash_map<int, PortState>* port_states,
+    BcmMultipathNexthop* bcm_multipath_nexthop) const {
   for (const auto& member : action_profile_group.members()) {
     uint32 member_id = member.member_id();
     uint32 weight = std::max(member.weight(), 1);
@@ -921,11 +948,15 @@ namespace {
     if (member_nexthop_info->type ==
         BcmNonMultipathNexthop::NEXTHOP_TYPE_PORT) {
       int port = member_nexthop_info->bcm_port;
-      ASSIGN_OR_RETURN(
-          PortState port_state,
-          bcm_chassis_ro_interface_->GetPortState(SdkPort(unit_, port)));
+      const PortState* port_state = gtl::FindOrNull(*port_states, port);
+      if (port_state == nullptr) {
+        ASSIGN_OR_RETURN(
+            PortState state,
+            bcm_chassis_ro_interface_->GetPortState(SdkPort(unit_, port)));
+        port_state = &port_states->emplace(port, state).first->second;
+      }
       // Only add member if port is UP.
-      if (port_state != PORT_STATE_UP) continue;
+      if (*port_state != PORT_STATE_UP) continue;
     }
     auto* nexthop_member = bcm_multipath_nexthop->add_members();
     nexthop_member->set_egress_intf_id(member_nexthop_info->egress_intf_id);
@@ -959,6 +990,7 @@ namespace {
     }
     RETURN_IF_ERROR(table_result.first->second.InsertEntry(table_entry));
   }
+  UpdateTableOccupancy(table_id, ::p4::v1::Update::INSERT);
 
   // Update the flow_ref_count for the member or group.
   uint32 member_id = table_entry.action().action_profile_member_id();
@@ -1012,6 +1044,7 @@ namespace {
   ASSIGN_OR_RETURN(BcmFlowTable* table, GetMutableFlowTable(table_id));
   ASSIGN_OR_RETURN(::p4::v1::TableEntry old_entry,
                    table->DeleteEntry(table_entry));
+  UpdateTableOccupancy(table_id, ::p4::v1::Update::DELETE);
 
   // Update the flow_ref_count for the member or group.
   uint32 member_id = old_entry.action().action_profile_member_id();
@@ -1099,6 +1132,8 @@ namespace {
            << "Inconsistent state. Member with ID " << member_id << " already "
            << "exists in members_.";
   }
+  UpdateTableOccupancy(action_profile_member.action_profile_id(),
+                       ::p4::v1::Update::INSERT);
 
   return ::util::OkStatus();
 }
@@ -1328,9 +1363,13 @@ namespace {
   member_id_to_nexthop_info_.erase(member_id);
 
   // Delete the copy of P4 ActionProfileMember matching the input.
-  RET_CHECK(members_.erase(member_id) == 1)
+  auto member_iter = members_.find(member_id);
+  RET_CHECK(member_iter != members_.end())
       << "Inconsistent state. Old member with ID " << member_id << " did not "
       << "exist in members_.";
+  uint32 action_profile_id = member_iter->second.action_profile_id();
+  members_.erase(member_iter);
+  UpdateTableOccupancy(action_profile_id, ::p4::v1::Update::DELETE);
 
   return ::util::OkStatus();
 }
@@ -1398,21 +1437,35 @@ namespace {
 }
 
 ::util::StatusOr<absl::flat_hash_map<int, BcmMultipathNexthop>>
-BcmTableManager::FillBcmMultipathNexthopsWithPort(uint32 port_id) const {
-  auto* port = gtl::FindOrNull(port_id_to_logical_port_, port_id);
-  RET_CHECK(port != nullptr);
-  auto* group_ids = gtl::FindOrNull(port_to_group_ids_, *port);
-  if (!group_ids) return absl::flat_hash_map<int, BcmMultipathNexthop>();
+BcmTableManager::FillBcmMultipathNexthopsWithPorts(
+    const std::set<uint32>& port_ids) const {
+  // Collect the union of the groups referencing any of the ports first, so
+  // that a group referencing several of them is filled only once.
+  absl::flat_hash_set<uint32> group_ids;
+  for (uint32 port_id : port_ids) {
+    auto* port = gtl::FindOrNull(port_id_to_logical_port_, port_id);
+    RET_CHECK(port != nullptr) << "Unknown port " << port_id << ".";
+    auto* port_group_ids = gtl::FindOrNull(port_to_group_ids_, *port);
+    if (port_group_ids == nullptr) continue;
+    group_ids.insert(port_group_ids->begin(), port_group_ids->end());
+  }
   absl::flat_hash_map<int, BcmMultipathNexthop> nexthops;
-  for (const auto& group_id : *group_ids) {
+  nexthops.reserve(group_ids.size());
+  // Port states shared by all the groups in this batch.
+  absl::flat_hash_map<int, PortState> port_states;
+  for (const auto& group_id : group_ids) {
     // Get nexthop info for the BCM egress_intf_id.
     ASSIGN_OR_RETURN(auto* nexthop_info, GetBcmMultipathNexthopInfo(group_id));
     auto& nexthop =
         gtl::LookupOrInsert(&nexthops, nexthop_info->egress_intf_id, {});
-    // Populate the BcmMultipathNexthopInfo.
+    nexthop.set_unit(unit_);
+    // Populate the BcmMultipathNexthop with the members which are still live.
+    // The group was already validated against the P4 pipeline when it was
+    // programmed, so there is no need to map it again.
     const auto* group = gtl::FindOrNull(groups_, group_id);
     RET_CHECK(group != nullptr);
-    RETURN_IF_ERROR(FillBcmMultipathNexthop(*group, &nexthop));
+    RETURN_IF_ERROR(
+        FillLiveBcmMultipathNexthopMembers(*group, &port_states, &nexthop));
   }
   return std::move(nexthops);
 }
@@ -1695,6 +1748,23 @@ std::set<uint32> BcmTableManager::GetAllAclTableIDs() const {
   return ::util::OkStatus();
 }
 
+::util::Status BcmTableManager::RegisterEventNotifyWriter(
+    const std::shared_ptr<WriterInterface<GnmiEventPtr>>& writer) {
+  absl::WriterMutexLock l(&gnmi_event_lock_);
+  gnmi_event_writer_ = writer;
+  return ::util::OkStatus();
+}
+
+::util::Status BcmTableManager::UnregisterEventNotifyWriter() {
+  absl::WriterMutexLock l(&gnmi_event_lock_);
+  gnmi_event_writer_ = nullptr;
+  return ::util::OkStatus();
+}
+
+TableOccupancy BcmTableManager::GetTableOccupancy() const {
+  return occupancy_tracker_.GetOccupancy();
+}
+
 ::util::Status BcmTableManager::MapFlowEntry(
     const ::p4::v1::TableEntry& table_entry, ::p4::v1::Update::Type type,
     CommonFlowEntry* flow_entry) const {
@@ -2302,6 +2372,26 @@ BcmTableManager::GetBcmMultipathNexthopInfo(uint32 group_id) const {
          << "Table " << table_id << " not present.";
 }
 
+void BcmTableManager::UpdateTableOccupancy(uint32 p4_id,
+                                           ::p4::v1::Update::Type type) {
+  TableOccupancy::Table table;
+  bool crossed = false;
+  if (type == ::p4::v1::Update::INSERT) {
+    crossed = occupancy_tracker_.RecordInsert(p4_id, &table);
+  } else if (type == ::p4::v1::Update::DELETE) {
+    crossed = occupancy_tracker_.RecordDelete(p4_id, &table);
+  }
+  if (!crossed) return;
+
+  absl::ReaderMutexLock l(&gnmi_event_lock_);
+  if (!gnmi_event_writer_) return;
+  if (!gnmi_event_writer_->Write(
+          GnmiEventPtr(new TableOccupancyChangedEvent(node_id_, table)))) {
+    // Remove WriterInterface if it is no longer operational.
+    gnmi_event_writer_.reset();
+  }
+}
+
 bool BcmTableManager::HasTable(uint32 table_id) const {
   if (generic_flow_tables_.count(table_id)) return true;
   if (acl_tables_.count(table_id)) return true;
@@ -14,6 +14,7 @@
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
 #include "p4/config/v1/p4info.pb.h"
 #include "p4/v1/p4runtime.pb.h"
 #include "stratum/glue/integral_types.h"
@@ -24,9 +25,11 @@
 #include "stratum/hal/lib/bcm/bcm_chassis_ro_interface.h"
 #include "stratum/hal/lib/bcm/bcm_flow_table.h"
 #include "stratum/hal/lib/common/common.pb.h"
+#include "stratum/hal/lib/common/gnmi_events.h"
 #include "stratum/hal/lib/common/writer_interface.h"
 #include "stratum/hal/lib/p4/common_flow_entry.pb.h"
 #include "stratum/hal/lib/p4/p4_table_mapper.h"
+#include "stratum/hal/lib/p4/table_occupancy_tracker.h"
 #include "stratum/lib/utils.h"
 
 namespace stratum {
@@ -143,13 +146,16 @@ class BcmTableManager {
       BcmMultipathNexthop* bcm_multipath_nexthop) const;
 
   // Populates and returns the BCM id and configuration for all existing
-  // ActionProfileGroups with members referencing the given port_id. This does
-  // not modify BcmTableManager state, as this is an internal functionality with
-  // the purpose of mitigating blackholing. This function is generally invoked
-  // on a LinkscanEvent with the purpose of adding or removing the relevant port
-  // to or from any referencing groups.
+  // ActionProfileGroups with members referencing any of the given port_ids.
+  // A group referencing more than one of the ports is returned only once. This
+  // does not modify BcmTableManager state, as this is an internal
+  // functionality with the purpose of mitigating blackholing. This function is
+  // generally invoked after LinkscanEvents with the purpose of adding or
+  // removing the relevant ports to or from any referencing groups. The groups
+  // are not re-validated against the P4 pipeline, as this was done when they
+  // were programmed, and the state of each port is looked up only once.
   virtual ::util::StatusOr<absl::flat_hash_map<int, BcmMultipathNexthop>>
-  FillBcmMultipathNexthopsWithPort(uint32 port_id) const;
+  FillBcmMultipathNexthopsWithPorts(const std::set<uint32>& port_ids) const;
 
   // Transer meter configuration from P4 MeterConfig to BcmMeterConfig.
   // TODO(max): Why is this function not virtual like the rest
@@ -352,6 +358,20 @@ class BcmTableManager {
       const std::set<uint32>& clone_session_ids,
       WriterInterface<::p4::v1::ReadResponse>* writer) const;
 
+  // Registers a writer for the TableOccupancyChangedEvents sent when a table
+  // or action profile crosses one of the --table_occupancy_thresholds.
+  virtual ::util::Status RegisterEventNotifyWriter(
+      const std::shared_ptr<WriterInterface<GnmiEventPtr>>& writer)
+      LOCKS_EXCLUDED(gnmi_event_lock_);
+
+  // Unregisters the table occupancy event writer.
+  virtual ::util::Status UnregisterEventNotifyWriter()
+      LOCKS_EXCLUDED(gnmi_event_lock_);
+
+  // Returns the number of entries and the capacity of every table and action
+  // profile in the current pipeline. Action profiles count their members.
+  virtual TableOccupancy GetTableOccupancy() const;
+
   // Takes the input P4 table_entry for the given node and maps it to the output
   // flow_entry.
   virtual ::util::Status MapFlowEntry(const ::p4::v1::TableEntry& table_entry,
@@ -393,6 +413,15 @@ class BcmTableManager {
   ::util::StatusOr<BcmMultipathNexthopInfo*> GetBcmMultipathNexthopInfo(
       uint32 group_id) const;
 
+  // Adds the members of the given P4 ActionProfileGroup which are currently
+  // live to the given BcmMultipathNexthop. Members pointing to a singleton port
+  // which is not UP are skipped. The state of each port is looked up at most
+  // once and memoized in port_states, which can be shared across groups.
+  ::util::Status FillLiveBcmMultipathNexthopMembers(
+      const ::p4::v1::ActionProfileGroup& action_profile_group,
+      absl::flat_hash_map<int, PortState>* port_states,
+      BcmMultipathNexthop* bcm_multipath_nexthop) const;
+
   // Construct an egress port action from a port_id. Verify the port against the
   // node_id_. The bcm_action parameter type will indicate if the port is a
   // logical port or a trunk port.
@@ -470,6 +499,11 @@ class BcmTableManager {
   // Returns true if the given table id refers to a known ACL table.
   bool IsAclTable(uint32 table_id) const;
 
+  // Updates the occupancy of a table or action profile after a successful
+  // write, and sends a TableOccupancyChangedEvent on threshold crossings.
+  void UpdateTableOccupancy(uint32 p4_id, ::p4::v1::Update::Type type)
+      LOCKS_EXCLUDED(gnmi_event_lock_);
+
   // ***************************************************************************
   // Port/trunk Maps
   // ***************************************************************************
@@ -536,6 +570,15 @@ class BcmTableManager {
   // Pointer to P4TableMapper. In charge of PI to vender-agnostic entry mapping.
   P4TableMapper* p4_table_mapper_;  // not owned by this class.
 
+  // Counts the entries of every table and action profile. The capacities are
+  // the P4Info sizes, as the SDK does not report the size of a P4 table.
+  TableOccupancyTracker occupancy_tracker_;
+
+  // WriterInterface<GnmiEventPtr> object for sending table occupancy events.
+  mutable absl::Mutex gnmi_event_lock_;
+  std::shared_ptr<WriterInterface<GnmiEventPtr>> gnmi_event_writer_
+      GUARDED_BY(gnmi_event_lock_);
+
   // Logical node ID corresponding to the node/ASIC managed by this class
   // instance. Assigned on PushChassisConfig() and might change during the
   // lifetime of the class.
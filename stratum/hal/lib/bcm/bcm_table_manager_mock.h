@@ -5,6 +5,7 @@
 #ifndef STRATUM_HAL_LIB_BCM_BCM_TABLE_MANAGER_MOCK_H_
 #define STRATUM_HAL_LIB_BCM_BCM_TABLE_MANAGER_MOCK_H_
 
+#include <memory>
 #include <set>
 #include <vector>
 
@@ -48,9 +49,9 @@ class BcmTableManagerMock : public BcmTableManager {
       ::util::Status(const ::p4::v1::ActionProfileGroup& action_profile_group,
                      BcmMultipathNexthop* bcm_multipath_nexthop));
   MOCK_CONST_METHOD1(
-      FillBcmMultipathNexthopsWithPort,
+      FillBcmMultipathNexthopsWithPorts,
       ::util::StatusOr<absl::flat_hash_map<int, BcmMultipathNexthop>>(
-          uint32 port_id));
+          const std::set<uint32>& port_ids));
   MOCK_CONST_METHOD2(FillBcmMeterConfig,
                      ::util::Status(const ::p4::v1::MeterConfig& p4_meter,
                                     BcmMeterConfig* bcm_meter));
@@ -121,6 +122,12 @@ class BcmTableManagerMock : public BcmTableManager {
       ReadActionProfileGroups,
       ::util::Status(const std::set<uint32>& action_profile_ids,
                      WriterInterface<::p4::v1::ReadResponse>* writer));
+  MOCK_METHOD1(
+      RegisterEventNotifyWriter,
+      ::util::Status(
+          const std::shared_ptr<WriterInterface<GnmiEventPtr>>& writer));
+  MOCK_METHOD0(UnregisterEventNotifyWriter, ::util::Status());
+  MOCK_CONST_METHOD0(GetTableOccupancy, TableOccupancy());
   MOCK_CONST_METHOD3(MapFlowEntry,
                      ::util::Status(const ::p4::v1::TableEntry& table_entry,
                                     ::p4::v1::Update::Type type,
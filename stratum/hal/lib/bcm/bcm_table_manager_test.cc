@@ -5,6 +5,7 @@
 #include "stratum/hal/lib/bcm/bcm_table_manager.h"
 
 #include <memory>
+#include <set>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -15,6 +16,8 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/strip.h"
 #include "absl/strings/substitute.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "p4/config/v1/p4info.pb.h"
@@ -42,8 +45,10 @@ using test_utils::UnorderedEqualsProto;
 using ::testing::_;
 using ::testing::DoAll;
 using ::testing::HasSubstr;
+using ::testing::InvokeWithoutArgs;
 using ::testing::Pair;
 using ::testing::Return;
+using ::testing::SaveArg;
 using ::testing::SetArgPointee;
 using ::testing::UnorderedElementsAre;
 
@@ -3175,7 +3180,7 @@ TEST_F(BcmTableManagerTest, FillBcmMultipathNexthopFailure) {
   EXPECT_EQ("error2", status.error_message());
 }
 
-TEST_F(BcmTableManagerTest, FillBcmMultipathNexthopsWithPortSuccess) {
+TEST_F(BcmTableManagerTest, FillBcmMultipathNexthopsWithPortsSuccess) {
   ASSERT_NO_FATAL_FAILURE(PushTestConfig());
 
   // Set up P4 members and groups, with one member, shared by 2 groups, pointing
@@ -3238,24 +3243,19 @@ TEST_F(BcmTableManagerTest, FillBcmMultipathNexthopsWithPortSuccess) {
       {{kMemberId2, std::make_tuple(1, 2, kTrunkPort1)},
        {kMemberId3, std::make_tuple(1, 2, kLogicalPort2)}}));
 
-  // Set up expectations for the FillBcmMultipathNexthop() calls. This should
-  // only be called for group1 and group2 which share kLogicalPort1.
-  EXPECT_CALL(*p4_table_mapper_mock_,
-              MapActionProfileGroup(EqualsProto(group1), _))
-      .WillOnce(Return(::util::OkStatus()));
-  EXPECT_CALL(*p4_table_mapper_mock_,
-              MapActionProfileGroup(EqualsProto(group2), _))
-      .WillOnce(Return(::util::OkStatus()));
+  // Set up expectations for the port state lookups. Only group1 and group2,
+  // which share kLogicalPort1, are filled. The groups are not mapped again and
+  // the state of each port is looked up only once.
+  EXPECT_CALL(*p4_table_mapper_mock_, MapActionProfileGroup(_, _)).Times(0);
   EXPECT_CALL(*bcm_chassis_ro_mock_,
               GetPortState(SdkPortEq(SdkPort(kUnit, kLogicalPort1))))
-      .Times(2)
-      .WillRepeatedly(Return(PORT_STATE_UP));
+      .WillOnce(Return(PORT_STATE_UP));
   EXPECT_CALL(*bcm_chassis_ro_mock_,
               GetPortState(SdkPortEq(SdkPort(kUnit, kLogicalPort2))))
       .WillOnce(Return(PORT_STATE_UP));
 
   auto status_or_nexthops =
-      bcm_table_manager_->FillBcmMultipathNexthopsWithPort(kPortId1);
+      bcm_table_manager_->FillBcmMultipathNexthopsWithPorts({kPortId1});
   ASSERT_TRUE(status_or_nexthops.ok());
   auto nexthops = std::move(status_or_nexthops).ValueOrDie();
 
@@ -3285,21 +3285,134 @@ TEST_F(BcmTableManagerTest, FillBcmMultipathNexthopsWithPortSuccess) {
   EXPECT_TRUE(nexthop2_ok);
 }
 
-TEST_F(BcmTableManagerTest, FillBcmMultipathNexthopsWithPortFailure) {
+TEST_F(BcmTableManagerTest, FillBcmMultipathNexthopsWithPortsFailure) {
   ASSERT_NO_FATAL_FAILURE(PushTestConfig());
 
   // Failure due to unknown port.
   auto status_or_nexthops =
-      bcm_table_manager_->FillBcmMultipathNexthopsWithPort(10493232);
+      bcm_table_manager_->FillBcmMultipathNexthopsWithPorts({10493232});
   EXPECT_FALSE(status_or_nexthops.ok());
   EXPECT_EQ(ERR_INVALID_PARAM, status_or_nexthops.status().error_code());
   // No groups reference the port. Empty map should be returned.
   status_or_nexthops =
-      bcm_table_manager_->FillBcmMultipathNexthopsWithPort(kPortId1);
+      bcm_table_manager_->FillBcmMultipathNexthopsWithPorts({kPortId1});
   EXPECT_TRUE(status_or_nexthops.ok());
   EXPECT_TRUE(status_or_nexthops.ValueOrDie().empty());
 }
 
+TEST_F(BcmTableManagerTest, FillBcmMultipathNexthopsWithPortsMultiplePorts) {
+  ASSERT_NO_FATAL_FAILURE(PushTestConfig());
+
+  // Two groups referencing both ports and one group referencing only one.
+  ::p4::v1::ActionProfileMember member1, member2;
+  ::p4::v1::ActionProfileGroup group1, group2, group3;
+  member1.set_member_id(kMemberId1);
+  member1.set_action_profile_id(kActionProfileId1);
+  member2.set_member_id(kMemberId2);
+  member2.set_action_profile_id(kActionProfileId1);
+  group1.set_group_id(kGroupId1);
+  group1.set_action_profile_id(kActionProfileId1);
+  group1.add_members()->set_member_id(kMemberId1);
+  group1.add_members()->set_member_id(kMemberId2);
+  group2.set_group_id(kGroupId2);
+  group2.set_action_profile_id(kActionProfileId1);
+  group2.add_members()->set_member_id(kMemberId2);
+  group2.add_members()->set_member_id(kMemberId1);
+  group3.set_group_id(kGroupId3);
+  group3.set_action_profile_id(kActionProfileId1);
+  group3.add_members()->set_member_id(kMemberId2);
+  ASSERT_OK(bcm_table_manager_->AddActionProfileMember(
+      member1, BcmNonMultipathNexthop::NEXTHOP_TYPE_PORT, kEgressIntfId1,
+      kLogicalPort1));
+  ASSERT_OK(bcm_table_manager_->AddActionProfileMember(
+      member2, BcmNonMultipathNexthop::NEXTHOP_TYPE_PORT, kEgressIntfId2,
+      kLogicalPort2));
+  ASSERT_OK(bcm_table_manager_->AddActionProfileGroup(group1, kEgressIntfId4));
+  ASSERT_OK(bcm_table_manager_->AddActionProfileGroup(group2, kEgressIntfId5));
+  ASSERT_OK(bcm_table_manager_->AddActionProfileGroup(group3, kEgressIntfId6));
+
+  // kLogicalPort1 went down, kLogicalPort2 is still up.
+  EXPECT_CALL(*bcm_chassis_ro_mock_,
+              GetPortState(SdkPortEq(SdkPort(kUnit, kLogicalPort1))))
+      .WillOnce(Return(PORT_STATE_DOWN));
+  EXPECT_CALL(*bcm_chassis_ro_mock_,
+              GetPortState(SdkPortEq(SdkPort(kUnit, kLogicalPort2))))
+      .WillOnce(Return(PORT_STATE_UP));
+
+  ASSERT_OK_AND_ASSIGN(
+      auto nexthops,
+      bcm_table_manager_->FillBcmMultipathNexthopsWithPorts(
+          {kPortId1, kPortId2}));
+  ASSERT_EQ(3, nexthops.size());
+  for (int egress_intf_id : {kEgressIntfId4, kEgressIntfId5, kEgressIntfId6}) {
+    const BcmMultipathNexthop* nexthop =
+        gtl::FindOrNull(nexthops, egress_intf_id);
+    ASSERT_NE(nullptr, nexthop);
+    EXPECT_EQ(kUnit, nexthop->unit());
+    ASSERT_EQ(1, nexthop->members_size());
+    EXPECT_EQ(kEgressIntfId2, nexthop->members(0).egress_intf_id());
+  }
+}
+
+// A port referenced by a large number of groups flapping repeatedly. Each
+// flap must look up the port state once, regardless of the number of groups.
+TEST_F(BcmTableManagerTest, FillBcmMultipathNexthopsWithPortsFlappingScale) {
+  ASSERT_NO_FATAL_FAILURE(PushTestConfig());
+
+  constexpr int kNumGroups = 50000;
+  constexpr int kNumFlaps = 5;
+  constexpr int kBaseEgressIntfId = 200000;
+  ::p4::v1::ActionProfileMember member1, member2;
+  member1.set_member_id(kMemberId1);
+  member1.set_action_profile_id(kActionProfileId1);
+  member2.set_member_id(kMemberId2);
+  member2.set_action_profile_id(kActionProfileId1);
+  ASSERT_OK(bcm_table_manager_->AddActionProfileMember(
+      member1, BcmNonMultipathNexthop::NEXTHOP_TYPE_PORT, kEgressIntfId1,
+      kLogicalPort1));
+  ASSERT_OK(bcm_table_manager_->AddActionProfileMember(
+      member2, BcmNonMultipathNexthop::NEXTHOP_TYPE_PORT, kEgressIntfId2,
+      kLogicalPort2));
+  for (int i = 1; i <= kNumGroups; ++i) {
+    ::p4::v1::ActionProfileGroup group;
+    group.set_group_id(i);
+    group.set_action_profile_id(kActionProfileId1);
+    group.add_members()->set_member_id(kMemberId1);
+    group.add_members()->set_member_id(kMemberId2);
+    ASSERT_OK(bcm_table_manager_->AddActionProfileGroup(
+        group, kBaseEgressIntfId + i));
+  }
+
+  // The port goes down on even iterations and comes back up on odd ones.
+  int num_lookups = 0;
+  EXPECT_CALL(*bcm_chassis_ro_mock_,
+              GetPortState(SdkPortEq(SdkPort(kUnit, kLogicalPort1))))
+      .Times(2 * kNumFlaps)
+      .WillRepeatedly(InvokeWithoutArgs([&num_lookups]() {
+        return (num_lookups++ % 2) ? PORT_STATE_UP : PORT_STATE_DOWN;
+      }));
+  EXPECT_CALL(*bcm_chassis_ro_mock_,
+              GetPortState(SdkPortEq(SdkPort(kUnit, kLogicalPort2))))
+      .Times(2 * kNumFlaps)
+      .WillRepeatedly(Return(PORT_STATE_UP));
+
+  absl::Duration total_duration;
+  for (int i = 0; i < 2 * kNumFlaps; ++i) {
+    const absl::Time start = absl::Now();
+    ASSERT_OK_AND_ASSIGN(
+        auto nexthops,
+        bcm_table_manager_->FillBcmMultipathNexthopsWithPorts({kPortId1}));
+    total_duration += absl::Now() - start;
+    ASSERT_EQ(kNumGroups, nexthops.size());
+    const int expected_members = (i % 2) ? 2 : 1;
+    for (const auto& e : nexthops) {
+      ASSERT_EQ(expected_members, e.second.members_size());
+    }
+  }
+  LOG(INFO) << "Filled " << kNumGroups << " groups " << 2 * kNumFlaps
+            << " times in " << total_duration << ".";
+}
+
 TEST_F(BcmTableManagerTest, AddTableEntrySuccess) {
   ASSERT_NO_FATAL_FAILURE(PushTestConfig());
 
@@ -3401,6 +3514,113 @@ TEST_F(BcmTableManagerTest, AddTableEntryFailureWhenReferencedMemberNotFound) {
   EXPECT_THAT(status.error_message(), HasSubstr("Unknown member_id"));
 }
 
+// Verifies the table occupancy through a churn of table entry and action
+// profile member writes, and its recount on a pipeline push.
+TEST_F(BcmTableManagerTest, TableOccupancyUnderWriteChurn) {
+  ASSERT_NO_FATAL_FAILURE(PushTestConfig());
+  ::p4::v1::ForwardingPipelineConfig config;
+  const std::string kP4InfoText = absl::Substitute(R"pb(
+    tables {
+      preamble { id: $0 name: "ingress.table1" }
+      size: 4
+    }
+    action_profiles {
+      preamble { id: $1 name: "ingress.profile1" }
+      size: 8
+    }
+  )pb", kTableId1, kActionProfileId1);
+  ASSERT_OK(ParseProtoFromString(kP4InfoText, config.mutable_p4info()));
+  ASSERT_OK(bcm_table_manager_->PushForwardingPipelineConfig(config));
+
+  ::p4::v1::ActionProfileMember member1, member2;
+  ::p4::v1::TableEntry entry1, entry2;
+  member1.set_member_id(kMemberId1);
+  member1.set_action_profile_id(kActionProfileId1);
+  member2.set_member_id(kMemberId2);
+  member2.set_action_profile_id(kActionProfileId1);
+  entry1.set_table_id(kTableId1);
+  entry1.add_match()->set_field_id(kFieldId1);
+  entry1.mutable_action()->set_action_profile_member_id(kMemberId1);
+  entry2.set_table_id(kTableId1);
+  entry2.add_match()->set_field_id(kFieldId2);
+  entry2.mutable_action()->set_action_profile_member_id(kMemberId1);
+
+  ASSERT_OK(bcm_table_manager_->AddActionProfileMember(
+      member1, BcmNonMultipathNexthop::NEXTHOP_TYPE_PORT, kEgressIntfId1,
+      kLogicalPort1));
+  ASSERT_OK(bcm_table_manager_->AddActionProfileMember(
+      member2, BcmNonMultipathNexthop::NEXTHOP_TYPE_PORT, kEgressIntfId2,
+      kLogicalPort2));
+  ASSERT_OK(bcm_table_manager_->AddTableEntry(entry1));
+  ASSERT_OK(bcm_table_manager_->AddTableEntry(entry2));
+  // A modify does not change the occupancy, and neither does a failed insert.
+  entry1.mutable_action()->set_action_profile_member_id(kMemberId2);
+  ASSERT_OK(bcm_table_manager_->UpdateTableEntry(entry1));
+  ASSERT_OK(bcm_table_manager_->DeleteTableEntry(entry2));
+  EXPECT_FALSE(bcm_table_manager_->AddTableEntry(entry1).ok());
+
+  // The occupancy is ordered by ID, so the action profile comes first.
+  TableOccupancy occupancy = bcm_table_manager_->GetTableOccupancy();
+  ASSERT_EQ(2, occupancy.tables_size());
+  EXPECT_EQ(kActionProfileId1, occupancy.tables(0).id());
+  EXPECT_EQ(2U, occupancy.tables(0).entries());
+  EXPECT_EQ(8U, occupancy.tables(0).capacity());
+  EXPECT_EQ(kTableId1, occupancy.tables(1).id());
+  EXPECT_EQ(1U, occupancy.tables(1).entries());
+  EXPECT_EQ(4U, occupancy.tables(1).capacity());
+
+  // The entries survive a pipeline push and are counted again.
+  ASSERT_OK(bcm_table_manager_->PushForwardingPipelineConfig(config));
+  occupancy = bcm_table_manager_->GetTableOccupancy();
+  ASSERT_EQ(2, occupancy.tables_size());
+  EXPECT_EQ(2U, occupancy.tables(0).entries());
+  EXPECT_EQ(1U, occupancy.tables(1).entries());
+
+  ASSERT_OK(bcm_table_manager_->DeleteTableEntry(entry1));
+  ASSERT_OK(bcm_table_manager_->DeleteActionProfileMember(member2));
+  occupancy = bcm_table_manager_->GetTableOccupancy();
+  ASSERT_EQ(2, occupancy.tables_size());
+  EXPECT_EQ(1U, occupancy.tables(0).entries());
+  EXPECT_EQ(0U, occupancy.tables(1).entries());
+}
+
+// Verifies that filling a table sends a TableOccupancyChangedEvent.
+TEST_F(BcmTableManagerTest, TableOccupancyThresholdEvent) {
+  ASSERT_NO_FATAL_FAILURE(PushTestConfig());
+  ::p4::v1::ForwardingPipelineConfig config;
+  auto* table = config.mutable_p4info()->add_tables();
+  table->mutable_preamble()->set_id(kTableId1);
+  table->mutable_preamble()->set_name("ingress.table1");
+  table->set_size(2);
+  ASSERT_OK(bcm_table_manager_->PushForwardingPipelineConfig(config));
+  auto writer_mock = std::make_shared<WriterMock<GnmiEventPtr>>();
+  ASSERT_OK(bcm_table_manager_->RegisterEventNotifyWriter(writer_mock));
+
+  ::p4::v1::TableEntry entry1, entry2;
+  entry1.set_table_id(kTableId1);
+  entry1.add_match()->set_field_id(kFieldId1);
+  entry2.set_table_id(kTableId1);
+  entry2.add_match()->set_field_id(kFieldId2);
+
+  // The first entry fills the table to 50%, below all default thresholds.
+  EXPECT_CALL(*writer_mock, Write(_)).Times(0);
+  ASSERT_OK(bcm_table_manager_->AddTableEntry(entry1));
+  ::testing::Mock::VerifyAndClearExpectations(writer_mock.get());
+
+  // The second entry fills the table.
+  GnmiEventPtr event;
+  EXPECT_CALL(*writer_mock, Write(_))
+      .WillOnce(DoAll(SaveArg<0>(&event), Return(true)));
+  ASSERT_OK(bcm_table_manager_->AddTableEntry(entry2));
+  auto* change = dynamic_cast<TableOccupancyChangedEvent*>(event.get());
+  ASSERT_NE(nullptr, change);
+  EXPECT_EQ(kNodeId, change->GetNodeId());
+  EXPECT_EQ("ingress.table1", change->GetTable().name());
+  EXPECT_EQ(2U, change->GetTable().entries());
+  EXPECT_EQ(2U, change->GetTable().capacity());
+  ASSERT_OK(bcm_table_manager_->UnregisterEventNotifyWriter());
+}
+
 TEST_F(BcmTableManagerTest, UpdateTableEntrySuccess) {
   ASSERT_NO_FATAL_FAILURE(PushTestConfig());
 
@@ -4560,6 +4780,72 @@ INSTANTIATE_TEST_SUITE_P(BcmTableManagerTest, ConstConditionTest,
                                            P4_HEADER_GRE, P4_HEADER_ICMP),
                          ParamName);
 
+#ifdef BENCHMARK
+// Runs the test fixture setup outside of a test, so that the benchmark below
+// can reuse it.
+class BcmTableManagerBenchmark : public BcmTableManagerTest {
+ public:
+  void TestBody() override {}
+
+  // Looks up num_groups multipath groups which all reference a port going
+  // down on even iterations and coming back up on odd ones.
+  void FillFlappingPort(int iters, int num_groups) {
+    SetUp();
+    PushTestConfig();
+    constexpr int kBaseEgressIntfId = 200000;
+    ::p4::v1::ActionProfileMember member1, member2;
+    member1.set_member_id(kMemberId1);
+    member1.set_action_profile_id(kActionProfileId1);
+    member2.set_member_id(kMemberId2);
+    member2.set_action_profile_id(kActionProfileId1);
+    CHECK(bcm_table_manager_
+              ->AddActionProfileMember(
+                  member1, BcmNonMultipathNexthop::NEXTHOP_TYPE_PORT,
+                  kEgressIntfId1, kLogicalPort1)
+              .ok());
+    CHECK(bcm_table_manager_
+              ->AddActionProfileMember(
+                  member2, BcmNonMultipathNexthop::NEXTHOP_TYPE_PORT,
+                  kEgressIntfId2, kLogicalPort2)
+              .ok());
+    for (int i = 1; i <= num_groups; ++i) {
+      ::p4::v1::ActionProfileGroup group;
+      group.set_group_id(i);
+      group.set_action_profile_id(kActionProfileId1);
+      group.add_members()->set_member_id(kMemberId1);
+      group.add_members()->set_member_id(kMemberId2);
+      CHECK(bcm_table_manager_
+                ->AddActionProfileGroup(group, kBaseEgressIntfId + i)
+                .ok());
+    }
+    int num_lookups = 0;
+    EXPECT_CALL(*bcm_chassis_ro_mock_,
+                GetPortState(SdkPortEq(SdkPort(kUnit, kLogicalPort1))))
+        .WillRepeatedly(InvokeWithoutArgs([&num_lookups]() {
+          return (num_lookups++ % 2) ? PORT_STATE_UP : PORT_STATE_DOWN;
+        }));
+    EXPECT_CALL(*bcm_chassis_ro_mock_,
+                GetPortState(SdkPortEq(SdkPort(kUnit, kLogicalPort2))))
+        .WillRepeatedly(Return(PORT_STATE_UP));
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; ++i) {
+      CHECK(bcm_table_manager_->FillBcmMultipathNexthopsWithPorts({kPortId1})
+                .ok());
+    }
+    StopBenchmarkTiming();
+    TearDown();
+  }
+};
+
+static void BM_FillBcmMultipathNexthopsWithFlappingPort(int iters) {
+  StopBenchmarkTiming();
+  BcmTableManagerBenchmark benchmark;
+  benchmark.FillFlappingPort(iters, 50000);
+}
+BENCHMARK(BM_FillBcmMultipathNexthopsWithFlappingPort);
+#endif  // BENCHMARK
+
 }  // namespace bcm
 }  // namespace hal
 }  // namespace stratum
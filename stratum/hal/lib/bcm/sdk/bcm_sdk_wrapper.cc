@@ -27,6 +27,7 @@
 #include <algorithm>
 #include <csignal>
 #include <iomanip>
+#include <iterator>
 #include <sstream>  // IWYU pragma: keep
 #include <string>
 #include <thread>  // NOLINT
@@ -41,6 +42,7 @@ extern "C" {
 // TODO(bocon) we might be able to prune some of these includes
 #include "appl/diag/bslmgmt.h"
 #include "appl/diag/opennsa_diag.h"
+#include "bcm/cosq.h"
 #include "bcm/error.h"
 #include "bcm/init.h"
 #include "bcm/knet.h"
@@ -880,6 +882,87 @@ bool SobFieldSizeVerify(uint32 value) {
   return (value <= max_value);
 }
 
+// The SDK stats read into the PortCounters of a port, in the order in which
+// they are passed to bcm_stat_multi_get.
+const bcm_stat_val_t kPortCounterStats[] = {
+    snmpIfInOctets,         snmpIfInUcastPkts,      snmpIfInMulticastPkts,
+    snmpIfInBroadcastPkts,  snmpIfInDiscards,       snmpIfInErrors,
+    snmpIfInUnknownProtos,  snmpIfOutOctets,        snmpIfOutUcastPkts,
+    snmpIfOutMulticastPkts, snmpIfOutBroadcastPkts, snmpIfOutDiscards,
+    snmpIfOutErrors,
+};
+
+constexpr int kNumPortCounterStats =
+    sizeof(kPortCounterStats) / sizeof(kPortCounterStats[0]);
+
+// Reads all the kPortCounterStats of a port with a single SDK call.
+::util::Status ReadPortCounters(int unit, int port, PortCounters* pc) {
+  // bcm_stat_multi_get takes a non-const array.
+  bcm_stat_val_t stats[kNumPortCounterStats];
+  uint64 values[kNumPortCounterStats];
+  std::copy(std::begin(kPortCounterStats), std::end(kPortCounterStats),
+            stats);
+  RETURN_IF_BCM_ERROR(
+      bcm_stat_multi_get(unit, port, kNumPortCounterStats, stats, values))
+      << "Failed to read the counters of port " << port << " on unit "
+      << unit << ".";
+  pc->Clear();
+  int i = 0;
+  // in
+  pc->set_in_octets(values[i++]);
+  pc->set_in_unicast_pkts(values[i++]);
+  pc->set_in_multicast_pkts(values[i++]);
+  pc->set_in_broadcast_pkts(values[i++]);
+  pc->set_in_discards(values[i++]);
+  pc->set_in_errors(values[i++]);
+  pc->set_in_unknown_protos(values[i++]);
+  // out
+  pc->set_out_octets(values[i++]);
+  pc->set_out_unicast_pkts(values[i++]);
+  pc->set_out_multicast_pkts(values[i++]);
+  pc->set_out_broadcast_pkts(values[i++]);
+  pc->set_out_discards(values[i++]);
+  pc->set_out_errors(values[i++]);
+
+  return ::util::OkStatus();
+}
+
+// The SDK CoS queue stats read into the PortQosCounters of a queue, in the
+// order in which they are passed to bcm_cosq_stat_multi_get.
+const bcm_cosq_stat_t kQueueCounterStats[] = {
+    bcmCosqStatOutBytes,
+    bcmCosqStatOutPackets,
+    bcmCosqStatDroppedPackets,
+};
+
+constexpr int kNumQueueCounterStats =
+    sizeof(kQueueCounterStats) / sizeof(kQueueCounterStats[0]);
+
+// Reads all the kQueueCounterStats of a CoS queue of a port with a single SDK
+// call.
+::util::Status ReadQueueCounters(int unit, int port, int queue,
+                                 PortQosCounters* qc) {
+  // bcm_cosq_stat_multi_get takes a non-const array.
+  bcm_cosq_stat_t stats[kNumQueueCounterStats];
+  uint64 values[kNumQueueCounterStats];
+  std::copy(std::begin(kQueueCounterStats), std::end(kQueueCounterStats),
+            stats);
+  bcm_gport_t gport;
+  BCM_GPORT_LOCAL_SET(gport, port);
+  RETURN_IF_BCM_ERROR(bcm_cosq_stat_multi_get(
+      unit, gport, queue, kNumQueueCounterStats, stats, values))
+      << "Failed to read the counters of queue " << queue << " of port "
+      << port << " on unit " << unit << ".";
+  qc->Clear();
+  qc->set_queue_id(queue);
+  int i = 0;
+  qc->set_out_octets(values[i++]);
+  qc->set_out_pkts(values[i++]);
+  qc->set_out_dropped_pkts(values[i++]);
+
+  return ::util::OkStatus();
+}
+
 }  // namespace
 
 BcmSdkWrapper* BcmSdkWrapper::singleton_ = nullptr;
@@ -1427,42 +1510,77 @@ BcmSdkWrapper::~BcmSdkWrapper() { ShutdownAllUnits().IgnoreError(); }
 ::util::Status BcmSdkWrapper::GetPortCounters(int unit, int port,
                                               PortCounters* pc) {
   RET_CHECK(pc);
-  pc->Clear();
-  uint64 val;
-  // in
-  RETURN_IF_BCM_ERROR(bcm_stat_get(unit, port, snmpIfInOctets, &val));
-  pc->set_in_octets(val);
-  RETURN_IF_BCM_ERROR(bcm_stat_get(unit, port, snmpIfInUcastPkts, &val));
-  pc->set_in_unicast_pkts(val);
-  RETURN_IF_BCM_ERROR(bcm_stat_get(unit, port, snmpIfInMulticastPkts, &val));
-  pc->set_in_multicast_pkts(val);
-  RETURN_IF_BCM_ERROR(bcm_stat_get(unit, port, snmpIfInBroadcastPkts, &val));
-  pc->set_in_broadcast_pkts(val);
-  RETURN_IF_BCM_ERROR(bcm_stat_get(unit, port, snmpIfInDiscards, &val));
-  pc->set_in_discards(val);
-  RETURN_IF_BCM_ERROR(bcm_stat_get(unit, port, snmpIfInErrors, &val));
-  pc->set_in_errors(val);
-  RETURN_IF_BCM_ERROR(bcm_stat_get(unit, port, snmpIfInUnknownProtos, &val));
-  pc->set_in_unknown_protos(val);
-  // out
-  RETURN_IF_BCM_ERROR(bcm_stat_get(unit, port, snmpIfOutOctets, &val));
-  pc->set_out_octets(val);
-  RETURN_IF_BCM_ERROR(bcm_stat_get(unit, port, snmpIfOutUcastPkts, &val));
-  pc->set_out_unicast_pkts(val);
-  RETURN_IF_BCM_ERROR(bcm_stat_get(unit, port, snmpIfOutMulticastPkts, &val));
-  pc->set_out_multicast_pkts(val);
-  RETURN_IF_BCM_ERROR(bcm_stat_get(unit, port, snmpIfOutBroadcastPkts, &val));
-  pc->set_out_broadcast_pkts(val);
-  RETURN_IF_BCM_ERROR(bcm_stat_get(unit, port, snmpIfOutDiscards, &val));
-  pc->set_out_discards(val);
-  RETURN_IF_BCM_ERROR(bcm_stat_get(unit, port, snmpIfOutErrors, &val));
-  pc->set_out_errors(val);
+  RETURN_IF_ERROR(ReadPortCounters(unit, port, pc));
 
   VLOG(2) << "Port counter from port " << port << ":\n" << pc->DebugString();
 
   return ::util::OkStatus();
 }
 
+::util::StatusOr<std::map<int, PortCounters>>
+BcmSdkWrapper::GetAllPortCounters(int unit) {
+  bcm_port_config_t port_cfg;
+  RETURN_IF_BCM_ERROR(bcm_port_config_get(unit, &port_cfg));
+  // Bring the SDK counter table of all the ports in sync with the HW once,
+  // instead of letting each read go to the HW.
+  RETURN_IF_BCM_ERROR(bcm_stat_sync(unit))
+      << "Failed to sync the counters of unit " << unit << ".";
+  std::map<int, PortCounters> port_to_counters;
+  bcm_port_t port;
+  BCM_PBMP_ITER(port_cfg.port, port) {
+    PortCounters pc;
+    ::util::Status status = ReadPortCounters(unit, port, &pc);
+    if (!status.ok()) {
+      // Leave the port out, so that a single failing port does not fail the
+      // counters of the whole unit.
+      LOG(ERROR) << "Failed to read the counters of port " << port
+                 << " on unit " << unit << ": " << status;
+      continue;
+    }
+    port_to_counters[port] = pc;
+  }
+
+  VLOG(2) << "Read the counters of " << port_to_counters.size()
+          << " ports on unit " << unit << ".";
+
+  return port_to_counters;
+}
+
+::util::StatusOr<std::map<int, std::vector<PortQosCounters>>>
+BcmSdkWrapper::GetPortQueueCounters(int unit) {
+  bcm_port_config_t port_cfg;
+  RETURN_IF_BCM_ERROR(bcm_port_config_get(unit, &port_cfg));
+  int num_queues = 0;
+  RETURN_IF_BCM_ERROR(bcm_cosq_config_get(unit, &num_queues));
+  // The CoS queue counters are collected by the same SDK counter thread as the
+  // port counters. Sync them all with the HW once, so that the multi-gets
+  // below are served from the SDK counter table.
+  RETURN_IF_BCM_ERROR(bcm_stat_sync(unit))
+      << "Failed to sync the counters of unit " << unit << ".";
+  std::map<int, std::vector<PortQosCounters>> port_to_counters;
+  bcm_port_t port;
+  BCM_PBMP_ITER(port_cfg.port, port) {
+    std::vector<PortQosCounters> queue_counters(num_queues);
+    ::util::Status status = ::util::OkStatus();
+    for (int queue = 0; queue < num_queues && status.ok(); ++queue) {
+      status = ReadQueueCounters(unit, port, queue, &queue_counters[queue]);
+    }
+    if (!status.ok()) {
+      // Leave the port out, so that a single failing port does not fail the
+      // queue counters of the whole unit.
+      LOG(ERROR) << "Failed to read the queue counters of port " << port
+                 << " on unit " << unit << ": " << status;
+      continue;
+    }
+    port_to_counters[port] = std::move(queue_counters);
+  }
+
+  VLOG(2) << "Read the counters of " << num_queues << " queues of "
+          << port_to_counters.size() << " ports on unit " << unit << ".";
+
+  return port_to_counters;
+}
+
 ::util::Status BcmSdkWrapper::StartDiagShellServer() {
   if (bcm_diag_shell_ == nullptr) return ::util::OkStatus();  // sim mode
 
@@ -1789,6 +1907,37 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   return ::util::OkStatus();
 }
 
+::util::Status BcmSdkWrapper::ModifyEcmpEgressIntfs(
+    int unit,
+    const std::map<int, std::vector<int>>& egress_intf_id_to_member_ids) {
+  // The member array and the ECMP struct are reused for all the groups in the
+  // batch, so the per-group cost is a single SDK call.
+  int members_array[kMaxEcmpGroupSize];
+  bcm_l3_egress_ecmp_t l3_egress_ecmp;
+  ::util::Status status = ::util::OkStatus();
+  for (const auto& e : egress_intf_id_to_member_ids) {
+    const std::vector<int>& member_ids = e.second;
+    int members_count = static_cast<int>(member_ids.size());
+    if (members_count > kMaxEcmpGroupSize) {
+      ::util::Status error = MAKE_ERROR(ERR_INVALID_PARAM)
+                             << "ECMP group " << e.first << " has "
+                             << members_count << " members, more than "
+                             << kMaxEcmpGroupSize << ".";
+      APPEND_STATUS_IF_ERROR(status, error);
+      continue;
+    }
+    std::copy(member_ids.begin(), member_ids.end(), members_array);
+    bcm_l3_egress_ecmp_t_init(&l3_egress_ecmp);
+    l3_egress_ecmp.max_paths = members_count;
+    l3_egress_ecmp.ecmp_intf = e.first;
+    APPEND_STATUS_IF_BCM_ERROR(
+        status, ModifyEcmpEgressIntfHelper(unit, &l3_egress_ecmp,
+                                           members_count, members_array));
+  }
+
+  return status;
+}
+
 ::util::Status BcmSdkWrapper::DeleteEcmpEgressIntf(int unit,
                                                    int egress_intf_id) {
   bcm_l3_egress_ecmp_t l3_egress_ecmp;
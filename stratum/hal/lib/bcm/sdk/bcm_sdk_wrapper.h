@@ -17,6 +17,7 @@
 #include <pthread.h>
 
 #include <functional>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
@@ -139,6 +140,10 @@ class BcmSdkWrapper : public BcmSdkInterface {
   ::util::Status GetPortOptions(int unit, int port,
                                 BcmPortOptions* options) override;
   ::util::Status GetPortCounters(int unit, int port, PortCounters* pc) override;
+  ::util::StatusOr<std::map<int, PortCounters>> GetAllPortCounters(
+      int unit) override;
+  ::util::StatusOr<std::map<int, std::vector<PortQosCounters>>>
+  GetPortQueueCounters(int unit) override;
   ::util::Status StartDiagShellServer() override;
   ::util::Status StartLinkscan(int unit) override;
   ::util::Status StopLinkscan(int unit) override;
@@ -178,6 +183,9 @@ class BcmSdkWrapper : public BcmSdkInterface {
   ::util::Status ModifyEcmpEgressIntf(
       int unit, int egress_intf_id,
       const std::vector<int>& member_ids) override;
+  ::util::Status ModifyEcmpEgressIntfs(
+      int unit, const std::map<int, std::vector<int>>&
+                    egress_intf_id_to_member_ids) override;
   ::util::Status DeleteEcmpEgressIntf(int unit, int egress_intf_id) override;
   ::util::Status AddL3RouteIpv4(int unit, int vrf, uint32 subnet, uint32 mask,
                                 int class_id, int egress_intf_id,
@@ -1973,6 +1973,44 @@ BcmSdkWrapper::~BcmSdkWrapper() { ShutdownAllUnits().IgnoreError(); }
   return ::util::OkStatus();
 }
 
+::util::StatusOr<std::map<int, PortCounters>>
+BcmSdkWrapper::GetAllPortCounters(int unit) {
+  RETURN_IF_BCM_ERROR(CheckIfUnitExists(unit));
+  std::vector<int> ports;
+  {
+    absl::ReaderMutexLock l(&data_lock_);
+    auto logical_ports_map = gtl::FindOrNull(unit_to_logical_ports_, unit);
+    RET_CHECK(logical_ports_map != nullptr)
+        << "Logical ports are not identified on the Unit " << unit << ".";
+    for (const auto& port : *logical_ports_map) ports.push_back(port.first);
+  }
+  // The counter LTs are kept in sync with the HW by the SDKLT counter thread,
+  // so there is no explicit sync step here and each lookup is served from SW.
+  std::map<int, PortCounters> port_to_counters;
+  for (int port : ports) {
+    PortCounters pc;
+    ::util::Status status = GetPortCounters(unit, port, &pc);
+    if (!status.ok()) {
+      // Leave the port out, so that a single failing port does not fail the
+      // counters of the whole unit.
+      LOG(ERROR) << "Failed to read the counters of port " << port
+                 << " on unit " << unit << ": " << status;
+      continue;
+    }
+    port_to_counters[port] = pc;
+  }
+
+  return port_to_counters;
+}
+
+::util::StatusOr<std::map<int, std::vector<PortQosCounters>>>
+BcmSdkWrapper::GetPortQueueCounters(int unit) {
+  // TODO(unknown): Read the CoS queue counter LTs. Until then BcmSwitch falls
+  // back to placeholder queue counters. This is called on every queue counter
+  // request, so do not log.
+  return MAKE_ERROR(ERR_UNIMPLEMENTED).without_logging() << "not implemented";
+}
+
 ::util::Status BcmSdkWrapper::InitCLI() {
   // Initialize system log output
   RETURN_IF_BCM_ERROR(bcma_bslmgmt_init());
@@ -3003,6 +3041,72 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   return ::util::OkStatus();
 }
 
+::util::Status BcmSdkWrapper::ModifyEcmpEgressIntfs(
+    int unit,
+    const std::map<int, std::vector<int>>& egress_intf_id_to_member_ids) {
+  // Check if the unit is valid
+  RETURN_IF_BCM_ERROR(CheckIfUnitExists(unit));
+  if (egress_intf_id_to_member_ids.empty()) return ::util::OkStatus();
+
+  InUseMap* ecmp_intfs = gtl::FindOrNull(l3_ecmp_egress_interface_ids_, unit);
+  RET_CHECK(ecmp_intfs != nullptr)
+      << "Unit " << unit << " not initialized yet. Call InitializeUnit first.";
+
+  // All the updates are committed in a single batch transaction. The entries
+  // added to the transaction are freed together with it.
+  bcmlt_transaction_hdl_t trans_hdl;
+  RETURN_IF_BCM_ERROR(
+      bcmlt_transaction_allocate(BCMLT_TRANS_TYPE_BATCH, &trans_hdl));
+  auto free_trans = absl::MakeCleanup(
+      [trans_hdl]() { bcmlt_transaction_free(trans_hdl); });
+  for (const auto& e : egress_intf_id_to_member_ids) {
+    const int egress_intf_id = e.first;
+    const std::vector<int>& member_ids = e.second;
+    // Check if egress interface is valid
+    auto it = ecmp_intfs->find(egress_intf_id);
+    if (it == ecmp_intfs->end()) {
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Invalid ECMP egress interface " << egress_intf_id << ".";
+    }
+    if (!it->second) {
+      return MAKE_ERROR(ERR_INTERNAL) << "ECMP egress interface "
+                                      << egress_intf_id << " is not created.";
+    }
+    RET_CHECK(member_ids.size() <= static_cast<size_t>(kMaxEcmpGroupSize))
+        << "Too many members (" << member_ids.size()
+        << ") for ECMP egress interface " << egress_intf_id << ".";
+    uint64 members_array[kMaxEcmpGroupSize] = {};
+    for (size_t i = 0; i < member_ids.size(); ++i) {
+      members_array[i] = static_cast<uint64>(member_ids[i]);
+    }
+    int members_count = static_cast<int>(member_ids.size());
+
+    bcmlt_entry_handle_t entry_hdl;
+    RETURN_IF_BCM_ERROR(bcmlt_entry_allocate(unit, ECMPs, &entry_hdl));
+    ::util::Status status = [&]() -> ::util::Status {
+      RETURN_IF_BCM_ERROR(
+          bcmlt_entry_field_add(entry_hdl, ECMP_IDs, egress_intf_id));
+      RETURN_IF_BCM_ERROR(
+          bcmlt_entry_field_add(entry_hdl, NUM_PATHSs, members_count));
+      RETURN_IF_BCM_ERROR(bcmlt_entry_field_array_add(
+          entry_hdl, NHOP_IDs, 0, members_array, members_count));
+      RETURN_IF_BCM_ERROR(bcmlt_transaction_entry_add(
+          trans_hdl, BCMLT_OPCODE_UPDATE, entry_hdl));
+      return ::util::OkStatus();
+    }();
+    if (!status.ok()) {
+      bcmlt_entry_free(entry_hdl);
+      return status;
+    }
+  }
+  RETURN_IF_BCM_ERROR(
+      bcmlt_transaction_commit(trans_hdl, BCMLT_PRIORITY_NORMAL));
+
+  VLOG(1) << "Modified " << egress_intf_id_to_member_ids.size()
+          << " ECMP groups in a single transaction on unit " << unit << ".";
+  return ::util::OkStatus();
+}
+
 ::util::Status BcmSdkWrapper::DeleteEcmpEgressIntf(int unit,
                                                    int egress_intf_id) {
   bcmlt_entry_handle_t entry_hdl;
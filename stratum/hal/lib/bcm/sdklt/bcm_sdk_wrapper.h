@@ -107,6 +107,10 @@ class BcmSdkWrapper : public BcmSdkInterface {
   ::util::Status GetPortOptions(int unit, int port,
                                 BcmPortOptions* options) override;
   ::util::Status GetPortCounters(int unit, int port, PortCounters* pc) override;
+  ::util::StatusOr<std::map<int, PortCounters>> GetAllPortCounters(
+      int unit) override LOCKS_EXCLUDED(data_lock_);
+  ::util::StatusOr<std::map<int, std::vector<PortQosCounters>>>
+  GetPortQueueCounters(int unit) override;
   ::util::Status StartDiagShellServer() override;
   ::util::Status StartLinkscan(int unit) override LOCKS_EXCLUDED(data_lock_);
   ::util::Status StopLinkscan(int unit) override LOCKS_EXCLUDED(data_lock_);
@@ -146,6 +150,9 @@ class BcmSdkWrapper : public BcmSdkInterface {
   ::util::Status ModifyEcmpEgressIntf(
       int unit, int egress_intf_id,
       const std::vector<int>& member_ids) override;
+  ::util::Status ModifyEcmpEgressIntfs(
+      int unit, const std::map<int, std::vector<int>>&
+                    egress_intf_id_to_member_ids) override;
   ::util::Status DeleteEcmpEgressIntf(int unit, int egress_intf_id) override;
   ::util::Status AddL3RouteIpv4(int unit, int vrf, uint32 subnet, uint32 mask,
                                 int class_id, int egress_intf_id,
@@ -0,0 +1,616 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/bcm/sim_knet_libc_proxy.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <net/ethernet.h>
+#include <net/if_arp.h>
+#include <netpacket/packet.h>
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/time/clock.h"
+#include "stratum/glue/gtl/map_util.h"
+#include "stratum/glue/logging.h"
+#include "stratum/hal/lib/bcm/constants.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+constexpr size_t SimKnetLibcProxy::kRxKnetHeaderSize;
+
+namespace {
+
+// The first emulated fd and ifindex.
+constexpr int kFirstSimFd = 1 << 20;
+constexpr int kFirstSimIfindex = 100;
+
+// Size of the RCPU header, i.e. the ethernet header, the RCPU VLAN tag and the
+// RCPU data. See the RcpuHeader struct in the BCM SDK wrappers.
+constexpr size_t kRcpuHeaderSize = 32;
+
+// Offsets of the RCPU header fields.
+constexpr size_t kRcpuEtherTypeOffset = 12;
+constexpr size_t kRcpuVlanIdOffset = 14;
+constexpr size_t kRcpuTypeOffset = 16;
+constexpr size_t kRcpuOpcodeOffset = 20;
+constexpr size_t kRcpuFlagsOffset = 21;
+constexpr size_t kRcpuPayloadLenOffset = 24;
+
+static_assert(kRcpuHeaderSize + kRcpuRxMetaSize ==
+                  SimKnetLibcProxy::kRxKnetHeaderSize,
+              "Unexpected RX KNET header size.");
+
+// Sets a field of the RX metadata (DCB). Same conventions as GetDcbField() in
+// the BCM SDK wrappers: the DCB is made of 32-bit words in network byte order,
+// the first two of which are consumed by the KNET module.
+void SetDcbField(char* dcb, int word, int start_bit, int end_bit,
+                 uint32 value) {
+  uint32* data = reinterpret_cast<uint32*>(dcb);
+  uint32 mask = ((static_cast<uint64>(1) << (start_bit + 1)) - 1) &
+                ~((static_cast<uint64>(1) << end_bit) - 1);
+  uint32 host = ntohl(data[word - 2]);
+  host = (host & ~mask) | ((value << end_bit) & mask);
+  data[word - 2] = htonl(host);
+}
+
+uint32 GetDcbField(const char* dcb, int word, int start_bit, int end_bit) {
+  const uint32* data = reinterpret_cast<const uint32*>(dcb);
+  uint32 mask = ((static_cast<uint64>(1) << (start_bit + 1)) - 1) &
+                ~((static_cast<uint64>(1) << end_bit) - 1);
+  return (ntohl(data[word - 2]) & mask) >> end_bit;
+}
+
+void SetUint16(char* buf, uint16 value) {
+  value = htons(value);
+  memcpy(buf, &value, sizeof(value));
+}
+
+uint16 GetUint16(const char* buf) {
+  uint16 value;
+  memcpy(&value, buf, sizeof(value));
+  return ntohs(value);
+}
+
+}  // namespace
+
+SimKnetLibcProxy::SimKnetLibcProxy(const Options& options)
+    : options_(options),
+      next_fd_(kFirstSimFd),
+      generator_stop_(false),
+      generator_done_(true),
+      generator_sent_(0) {}
+
+SimKnetLibcProxy::~SimKnetLibcProxy() {
+  StopTrafficGenerator(absl::ZeroDuration());
+}
+
+int SimKnetLibcProxy::close(int fd) {
+  {
+    absl::MutexLock l(&lock_);
+    if (fds_.erase(fd)) {
+      // Like the kernel, remove the closed fd from all epoll instances.
+      for (auto& e : fds_) e.second.interests.erase(fd);
+      rx_cond_var_.SignalAll();
+      return 0;
+    }
+  }
+  return PassthroughLibcProxy::close(fd);
+}
+
+int SimKnetLibcProxy::socket(int domain, int type, int protocol) {
+  SocketType socket_type;
+  if (domain == AF_INET && (type & SOCK_DGRAM)) {
+    socket_type = kControlSocket;
+  } else if (domain == AF_PACKET && (type & SOCK_RAW)) {
+    socket_type = kPacketSocket;
+  } else {
+    return PassthroughLibcProxy::socket(domain, type, protocol);
+  }
+  absl::MutexLock l(&lock_);
+  int fd = next_fd_++;
+  SimFd& sim_fd = fds_[fd];
+  sim_fd.type = socket_type;
+  sim_fd.rcvbuf = options_.default_rcvbuf;
+  return fd;
+}
+
+int SimKnetLibcProxy::setsockopt(int sockfd, int level, int optname,
+                                 const void* optval, socklen_t optlen) {
+  {
+    absl::MutexLock l(&lock_);
+    SimFd* sim_fd = FindSimFd(sockfd);
+    if (sim_fd != nullptr) {
+      if (level == SOL_SOCKET &&
+          (optname == SO_RCVBUF || optname == SO_RCVBUFFORCE)) {
+        if (optval == nullptr || optlen < sizeof(int)) {
+          errno = EINVAL;
+          return -1;
+        }
+        // The kernel doubles the given value to account for its overhead.
+        int rcvbuf = std::max(*static_cast<const int*>(optval), 0);
+        sim_fd->rcvbuf = 2 * static_cast<size_t>(rcvbuf);
+      }
+      // Other options (e.g. the BPF filter dropping outgoing packets) are
+      // accepted and ignored: sent packets are never looped back to RX
+      // sockets.
+      return 0;
+    }
+  }
+  return PassthroughLibcProxy::setsockopt(sockfd, level, optname, optval,
+                                          optlen);
+}
+
+int SimKnetLibcProxy::ioctl(int fd, uint64 request, void* arg) {
+  {
+    absl::MutexLock l(&lock_);
+    SimFd* sim_fd = FindSimFd(fd);
+    if (sim_fd != nullptr) {
+      if (sim_fd->type != kControlSocket || arg == nullptr) {
+        errno = EINVAL;
+        return -1;
+      }
+      return NetifIoctl(request, static_cast<struct ifreq*>(arg));
+    }
+  }
+  return PassthroughLibcProxy::ioctl(fd, request, arg);
+}
+
+int SimKnetLibcProxy::bind(int sockfd, const struct sockaddr* my_addr,
+                           socklen_t addrlen) {
+  {
+    absl::MutexLock l(&lock_);
+    SimFd* sim_fd = FindSimFd(sockfd);
+    if (sim_fd != nullptr) {
+      if (sim_fd->type != kPacketSocket || my_addr == nullptr ||
+          addrlen < sizeof(struct sockaddr_ll) ||
+          my_addr->sa_family != AF_PACKET) {
+        errno = EINVAL;
+        return -1;
+      }
+      const auto* addr = reinterpret_cast<const struct sockaddr_ll*>(my_addr);
+      if (FindNetifByIndex(addr->sll_ifindex) == nullptr) {
+        errno = ENODEV;
+        return -1;
+      }
+      sim_fd->ifindex = addr->sll_ifindex;
+      return 0;
+    }
+  }
+  return PassthroughLibcProxy::bind(sockfd, my_addr, addrlen);
+}
+
+ssize_t SimKnetLibcProxy::sendmsg(int sockfd, const struct msghdr* msg,
+                                  int flags) {
+  {
+    absl::MutexLock l(&lock_);
+    SimFd* sim_fd = FindSimFd(sockfd);
+    if (sim_fd != nullptr) {
+      if (sim_fd->type != kPacketSocket || msg == nullptr) {
+        errno = EINVAL;
+        return -1;
+      }
+      // The destination netif is given by the message address, or by the
+      // netif the socket is bound to.
+      int ifindex = sim_fd->ifindex;
+      if (msg->msg_name != nullptr &&
+          msg->msg_namelen >= sizeof(struct sockaddr_ll)) {
+        const auto* addr =
+            static_cast<const struct sockaddr_ll*>(msg->msg_name);
+        if (addr->sll_ifindex != 0) ifindex = addr->sll_ifindex;
+      }
+      Netif* netif = FindNetifByIndex(ifindex);
+      if (netif == nullptr) {
+        errno = ENXIO;
+        return -1;
+      }
+      if (!(netif->flags & IFF_UP)) {
+        errno = ENETDOWN;
+        return -1;
+      }
+      std::string packet;
+      for (size_t i = 0; i < msg->msg_iovlen; ++i) {
+        packet.append(static_cast<const char*>(msg->msg_iov[i].iov_base),
+                      msg->msg_iov[i].iov_len);
+      }
+      netif->stats.tx_packets++;
+      netif->stats.tx_bytes += packet.size();
+      ssize_t len = packet.size();
+      netif->tx_packets.push_back(std::move(packet));
+      while (netif->tx_packets.size() >
+             static_cast<size_t>(std::max(options_.max_tx_packets_kept, 0))) {
+        netif->tx_packets.pop_front();
+      }
+      return len;
+    }
+  }
+  return PassthroughLibcProxy::sendmsg(sockfd, msg, flags);
+}
+
+ssize_t SimKnetLibcProxy::recvmsg(int sockfd, struct msghdr* msg, int flags) {
+  {
+    absl::MutexLock l(&lock_);
+    SimFd* sim_fd = FindSimFd(sockfd);
+    if (sim_fd != nullptr) {
+      if (sim_fd->type != kPacketSocket || msg == nullptr) {
+        errno = EINVAL;
+        return -1;
+      }
+      // All the emulated sockets are non-blocking.
+      if (sim_fd->rx_queue.empty()) {
+        errno = EAGAIN;
+        return -1;
+      }
+      std::string packet = std::move(sim_fd->rx_queue.front());
+      sim_fd->rx_queue.pop_front();
+      sim_fd->rx_bytes -= packet.size();
+      Netif* netif = FindNetifByIndex(sim_fd->ifindex);
+      if (netif != nullptr) netif->stats.rx_delivered++;
+
+      // Scatter the packet over the given buffers.
+      size_t copied = 0;
+      for (size_t i = 0; i < msg->msg_iovlen && copied < packet.size(); ++i) {
+        size_t len = std::min(msg->msg_iov[i].iov_len, packet.size() - copied);
+        memcpy(msg->msg_iov[i].iov_base, packet.data() + copied, len);
+        copied += len;
+      }
+      msg->msg_flags = copied < packet.size() ? MSG_TRUNC : 0;
+      if (msg->msg_name != nullptr &&
+          msg->msg_namelen >= sizeof(struct sockaddr_ll)) {
+        auto* addr = static_cast<struct sockaddr_ll*>(msg->msg_name);
+        memset(addr, 0, sizeof(*addr));
+        addr->sll_family = AF_PACKET;
+        addr->sll_protocol = htons(ETH_P_ALL);
+        addr->sll_ifindex = sim_fd->ifindex;
+        addr->sll_pkttype = PACKET_HOST;
+        msg->msg_namelen = sizeof(*addr);
+      }
+      return copied;
+    }
+  }
+  return PassthroughLibcProxy::recvmsg(sockfd, msg, flags);
+}
+
+int SimKnetLibcProxy::epoll_create1(int flags) {
+  absl::MutexLock l(&lock_);
+  int fd = next_fd_++;
+  fds_[fd].type = kEpollInstance;
+  return fd;
+}
+
+int SimKnetLibcProxy::epoll_ctl(int efd, int op, int fd,
+                                struct epoll_event* event) {
+  absl::MutexLock l(&lock_);
+  SimFd* epoll = FindSimFd(efd);
+  SimFd* sim_fd = FindSimFd(fd);
+  if (epoll == nullptr || epoll->type != kEpollInstance || sim_fd == nullptr) {
+    errno = EBADF;
+    return -1;
+  }
+  switch (op) {
+    case EPOLL_CTL_ADD:
+      if (event == nullptr) {
+        errno = EINVAL;
+        return -1;
+      }
+      if (!epoll->interests.emplace(fd, *event).second) {
+        errno = EEXIST;
+        return -1;
+      }
+      break;
+    case EPOLL_CTL_MOD:
+      if (event == nullptr) {
+        errno = EINVAL;
+        return -1;
+      }
+      if (!epoll->interests.count(fd)) {
+        errno = ENOENT;
+        return -1;
+      }
+      epoll->interests[fd] = *event;
+      break;
+    case EPOLL_CTL_DEL:
+      if (!epoll->interests.erase(fd)) {
+        errno = ENOENT;
+        return -1;
+      }
+      break;
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+  rx_cond_var_.SignalAll();
+  return 0;
+}
+
+int SimKnetLibcProxy::epoll_wait(int efd, struct epoll_event* events,
+                                 int maxevents, int timeout) {
+  if (events == nullptr || maxevents <= 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  const absl::Time deadline = timeout < 0
+                                  ? absl::InfiniteFuture()
+                                  : absl::Now() + absl::Milliseconds(timeout);
+  absl::MutexLock l(&lock_);
+  while (true) {
+    SimFd* epoll = FindSimFd(efd);
+    if (epoll == nullptr || epoll->type != kEpollInstance) {
+      errno = EBADF;
+      return -1;
+    }
+    int num_events = GetReadyEvents(*epoll, events, maxevents);
+    if (num_events > 0) return num_events;
+    if (rx_cond_var_.WaitWithDeadline(&lock_, deadline)) {
+      // Timed out. Check one last time.
+      epoll = FindSimFd(efd);
+      if (epoll == nullptr) {
+        errno = EBADF;
+        return -1;
+      }
+      return GetReadyEvents(*epoll, events, maxevents);
+    }
+  }
+}
+
+bool SimKnetLibcProxy::ShouldProxyEpollCreate() { return true; }
+
+int SimKnetLibcProxy::AddNetif(const std::string& name, uint64 mac) {
+  absl::MutexLock l(&lock_);
+  Netif* netif = FindNetifByName(name);
+  if (netif != nullptr) return netif->ifindex;
+  int ifindex =
+      netifs_.empty() ? kFirstSimIfindex : netifs_.rbegin()->first + 1;
+  Netif& new_netif = netifs_[ifindex];
+  new_netif.name = name;
+  new_netif.ifindex = ifindex;
+  new_netif.mac = mac;
+  return ifindex;
+}
+
+bool SimKnetLibcProxy::InjectPacket(const std::string& netif_name,
+                                    const std::string& packet) {
+  absl::MutexLock l(&lock_);
+  Netif* netif = FindNetifByName(netif_name);
+  if (netif == nullptr) return false;
+  netif->stats.rx_injected++;
+  bool queued = false;
+  if (netif->flags & IFF_UP) {
+    for (auto& e : fds_) {
+      SimFd& sim_fd = e.second;
+      if (sim_fd.type != kPacketSocket || sim_fd.ifindex != netif->ifindex) {
+        continue;
+      }
+      // Like the kernel, drop the packet only once the buffer is already
+      // full, so a single packet larger than the buffer still goes through.
+      if (sim_fd.rx_bytes >= sim_fd.rcvbuf) continue;
+      sim_fd.rx_bytes += packet.size();
+      sim_fd.rx_queue.push_back(packet);
+      queued = true;
+    }
+  }
+  if (!queued) {
+    netif->stats.rx_dropped++;
+    return false;
+  }
+  rx_cond_var_.SignalAll();
+  return true;
+}
+
+::util::Status SimKnetLibcProxy::StartTrafficGenerator(
+    const std::string& netif_name, const std::string& packet,
+    int64 num_packets, int64 rate_pps) {
+  absl::MutexLock l(&lock_);
+  RET_CHECK(generator_done_) << "Traffic generator is already running.";
+  RET_CHECK(num_packets >= 0 && rate_pps >= 0);
+  if (FindNetifByName(netif_name) == nullptr) {
+    return MAKE_ERROR(ERR_INVALID_PARAM) << "Unknown netif " << netif_name;
+  }
+  if (generator_.joinable()) generator_.join();
+  generator_stop_ = false;
+  generator_done_ = false;
+  generator_sent_ = 0;
+  generator_ = std::thread(&SimKnetLibcProxy::TrafficGeneratorLoop, this,
+                           netif_name, packet, num_packets, rate_pps);
+  return ::util::OkStatus();
+}
+
+int64 SimKnetLibcProxy::StopTrafficGenerator(absl::Duration timeout) {
+  int64 sent = 0;
+  {
+    absl::MutexLock l(&lock_);
+    lock_.AwaitWithTimeout(absl::Condition(&generator_done_), timeout);
+    generator_stop_ = true;
+  }
+  if (generator_.joinable()) generator_.join();
+  {
+    absl::MutexLock l(&lock_);
+    sent = generator_sent_;
+  }
+  return sent;
+}
+
+std::vector<std::string> SimKnetLibcProxy::GetTxPackets(
+    const std::string& netif_name) const {
+  absl::MutexLock l(&lock_);
+  for (const auto& e : netifs_) {
+    if (e.second.name == netif_name) {
+      return std::vector<std::string>(e.second.tx_packets.begin(),
+                                      e.second.tx_packets.end());
+    }
+  }
+  return {};
+}
+
+SimKnetLibcProxy::NetifStats SimKnetLibcProxy::GetNetifStats(
+    const std::string& netif_name) const {
+  absl::MutexLock l(&lock_);
+  for (const auto& e : netifs_) {
+    if (e.second.name == netif_name) return e.second.stats;
+  }
+  return NetifStats();
+}
+
+std::string SimKnetLibcProxy::BuildRxKnetPacket(const RxMetadata& meta,
+                                                const std::string& payload) {
+  std::string packet(kRxKnetHeaderSize, '\0');
+  char* buf = &packet[0];
+
+  // RCPU header. The MACs are not looked at by the SDK, so left zeroed out.
+  SetUint16(buf + kRcpuEtherTypeOffset, kRcpuVlanEthertype);
+  SetUint16(buf + kRcpuVlanIdOffset, kRcpuVlanId);
+  SetUint16(buf + kRcpuTypeOffset, kRcpuEthertype);
+  buf[kRcpuOpcodeOffset] = kRcpuOpcodeToCpuPkt;
+  buf[kRcpuFlagsOffset] = kRcpuFlagModhdr;
+  SetUint16(buf + kRcpuPayloadLenOffset, payload.size());
+
+  // RX metadata, with the same field layout for Tomahawk and Trident2.
+  char* dcb = buf + kRcpuHeaderSize;
+  SetDcbField(dcb, 9, 10, 8, meta.op_code);  // OPCODE
+  SetDcbField(dcb, 7, 31, 24, meta.module);  // SRC_MODID
+  SetDcbField(dcb, 6, 15, 8, meta.module);   // DST_MODID
+  SetDcbField(dcb, 7, 23, 16, meta.src_port);  // SRC_PORT
+  SetDcbField(dcb, 6, 7, 0, meta.dst_port);    // DST_PORT
+  SetDcbField(dcb, 4, 5, 0, meta.cos);         // COS
+
+  packet.append(payload);
+  return packet;
+}
+
+::util::Status SimKnetLibcProxy::ParseRxKnetHeader(const std::string& header,
+                                                   RxMetadata* meta) {
+  RET_CHECK(meta != nullptr);
+  RET_CHECK(header.size() >= kRxKnetHeaderSize)
+      << "Invalid KNET header size for RX (" << header.size() << " < "
+      << kRxKnetHeaderSize << ").";
+  const char* buf = header.data();
+  RET_CHECK(GetUint16(buf + kRcpuEtherTypeOffset) == kRcpuVlanEthertype);
+  RET_CHECK((GetUint16(buf + kRcpuVlanIdOffset) & 0xfff) == kRcpuVlanId);
+  RET_CHECK(GetUint16(buf + kRcpuTypeOffset) == kRcpuEthertype);
+  RET_CHECK(static_cast<uint8>(buf[kRcpuOpcodeOffset]) ==
+            kRcpuOpcodeToCpuPkt);
+  RET_CHECK(static_cast<uint8>(buf[kRcpuFlagsOffset]) == kRcpuFlagModhdr);
+
+  const char* dcb = buf + kRcpuHeaderSize;
+  meta->op_code = GetDcbField(dcb, 9, 10, 8);
+  meta->module = GetDcbField(dcb, 7, 31, 24);
+  meta->src_port = GetDcbField(dcb, 7, 23, 16);
+  meta->dst_port = GetDcbField(dcb, 6, 7, 0);
+  meta->cos = GetDcbField(dcb, 4, 5, 0);
+  RET_CHECK(GetDcbField(dcb, 6, 15, 8) == static_cast<uint32>(meta->module))
+      << "Invalid dst_module.";
+
+  return ::util::OkStatus();
+}
+
+std::unique_ptr<SimKnetLibcProxy> SimKnetLibcProxy::CreateInstance(
+    const Options& options) {
+  return absl::WrapUnique(new SimKnetLibcProxy(options));
+}
+
+SimKnetLibcProxy::SimFd* SimKnetLibcProxy::FindSimFd(int fd) {
+  return gtl::FindOrNull(fds_, fd);
+}
+
+SimKnetLibcProxy::Netif* SimKnetLibcProxy::FindNetifByName(
+    const std::string& name) {
+  for (auto& e : netifs_) {
+    if (e.second.name == name) return &e.second;
+  }
+  return nullptr;
+}
+
+SimKnetLibcProxy::Netif* SimKnetLibcProxy::FindNetifByIndex(int ifindex) {
+  return gtl::FindOrNull(netifs_, ifindex);
+}
+
+int SimKnetLibcProxy::NetifIoctl(uint64 request, struct ifreq* ifr) {
+  Netif* netif = FindNetifByName(
+      std::string(ifr->ifr_name, strnlen(ifr->ifr_name, IFNAMSIZ)));
+  if (netif == nullptr) {
+    errno = ENODEV;
+    return -1;
+  }
+  switch (request) {
+    case SIOCGIFFLAGS:
+      ifr->ifr_flags = netif->flags;
+      break;
+    case SIOCSIFFLAGS:
+      netif->flags = ifr->ifr_flags;
+      break;
+    case SIOCGIFMTU:
+      ifr->ifr_mtu = netif->mtu;
+      break;
+    case SIOCSIFMTU:
+      netif->mtu = ifr->ifr_mtu;
+      break;
+    case SIOCGIFINDEX:
+      ifr->ifr_ifindex = netif->ifindex;
+      break;
+    case SIOCGIFHWADDR: {
+      uint64 mac = netif->mac;
+      for (int i = ETH_ALEN - 1; i >= 0; --i) {
+        ifr->ifr_hwaddr.sa_data[i] = mac & 0xff;
+        mac >>= 8;
+      }
+      ifr->ifr_hwaddr.sa_family = ARPHRD_ETHER;
+      break;
+    }
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+  return 0;
+}
+
+int SimKnetLibcProxy::GetReadyEvents(const SimFd& epoll,
+                                     struct epoll_event* events,
+                                     int maxevents) {
+  int num_events = 0;
+  for (const auto& e : epoll.interests) {
+    if (num_events >= maxevents) break;
+    const SimFd* sim_fd = gtl::FindOrNull(fds_, e.first);
+    if (sim_fd == nullptr || sim_fd->rx_queue.empty() ||
+        !(e.second.events & EPOLLIN)) {
+      continue;
+    }
+    events[num_events].events = EPOLLIN;
+    events[num_events].data = e.second.data;
+    ++num_events;
+  }
+  return num_events;
+}
+
+void SimKnetLibcProxy::TrafficGeneratorLoop(std::string netif_name,
+                                            std::string packet,
+                                            int64 num_packets,
+                                            int64 rate_pps) {
+  const absl::Time start = absl::Now();
+  for (int64 i = 0; i < num_packets; ++i) {
+    if (rate_pps > 0) {
+      // Pace the packets against the start time, so that the rate does not
+      // drift with the time spent injecting them.
+      absl::Duration wait = start + i * absl::Seconds(1) / rate_pps -
+                            absl::Now();
+      if (wait > absl::ZeroDuration()) absl::SleepFor(wait);
+    }
+    InjectPacket(netif_name, packet);
+    absl::MutexLock l(&lock_);
+    ++generator_sent_;
+    if (generator_stop_) break;
+  }
+  absl::MutexLock l(&lock_);
+  generator_done_ = true;
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
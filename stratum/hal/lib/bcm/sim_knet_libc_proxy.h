@@ -0,0 +1,252 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_BCM_SIM_KNET_LIBC_PROXY_H_
+#define STRATUM_HAL_LIB_BCM_SIM_KNET_LIBC_PROXY_H_
+
+#include <net/if.h>
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/lib/libcproxy/passthrough_proxy.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+// SimKnetLibcProxy is a libc proxy which emulates, entirely in user space, the
+// KNET netdevs and the AF_PACKET sockets BcmPacketioManager uses for packet
+// I/O. Once installed with LibcWrapper::SetLibcProxy(), BcmPacketioManager can
+// be exercised (and benchmarked) without the KNET kernel module:
+// - AF_INET control sockets support the ioctls used to bring up the netifs
+//   and to read their ifindex and MAC.
+// - AF_PACKET sockets can be bound to a netif. Packets injected on a netif are
+//   queued on every socket bound to it, up to the socket receive buffer size
+//   (SO_RCVBUF/SO_RCVBUFFORCE), and dropped otherwise, like the kernel does.
+// - sendmsg() on an AF_PACKET socket captures the frame on the target netif.
+// - epoll instances report EPOLLIN (level triggered) on the sockets which have
+//   queued packets.
+// File descriptors not created by the class are passed through to libc.
+//
+// The class also includes a traffic generator which injects packets carrying
+// RCPU headers and RX metadata, as laid out by the KNET module for Tomahawk
+// and Trident2 chips, at a given rate.
+class SimKnetLibcProxy : public PassthroughLibcProxy {
+ public:
+  struct Options {
+    // Receive buffer size of the AF_PACKET sockets, unless set otherwise with
+    // setsockopt(). Matches the Linux default (net.core.rmem_default).
+    int default_rcvbuf;
+    // Max number of transmitted packets kept per netif for GetTxPackets().
+    // The oldest packets are discarded first. All packets are counted anyway.
+    int max_tx_packets_kept;
+    Options() : default_rcvbuf(212992), max_tx_packets_kept(1024) {}
+  };
+
+  // Packet statistics of a single netif.
+  struct NetifStats {
+    // Number of packets injected on the netif.
+    uint64 rx_injected;
+    // Number of packets read by recvmsg().
+    uint64 rx_delivered;
+    // Number of packets dropped because the receive buffer of the socket was
+    // full, or because no socket was bound to the netif.
+    uint64 rx_dropped;
+    // Number of packets and bytes sent with sendmsg().
+    uint64 tx_packets;
+    uint64 tx_bytes;
+    NetifStats()
+        : rx_injected(0),
+          rx_delivered(0),
+          rx_dropped(0),
+          tx_packets(0),
+          tx_bytes(0) {}
+  };
+
+  // The metadata carried in the RX metadata (DCB) of a KNET packet.
+  struct RxMetadata {
+    // BCM_PKT_OPCODE_* of the packet: 0 (CPU), 1 (UC) or 2 (BC).
+    int op_code;
+    int module;
+    int src_port;
+    int dst_port;
+    int cos;
+    RxMetadata() : op_code(0), module(0), src_port(0), dst_port(0), cos(0) {}
+  };
+
+  // Size of the RCPU header plus RX metadata preceding the payload of the
+  // packets sent to the CPU.
+  static constexpr size_t kRxKnetHeaderSize = 96;
+
+  ~SimKnetLibcProxy() override;
+
+  // PassthroughLibcProxy overrides.
+  int close(int fd) override LOCKS_EXCLUDED(lock_);
+  int socket(int domain, int type, int protocol) override
+      LOCKS_EXCLUDED(lock_);
+  int setsockopt(int sockfd, int level, int optname, const void* optval,
+                 socklen_t optlen) override LOCKS_EXCLUDED(lock_);
+  int ioctl(int fd, uint64 request, void* arg) override LOCKS_EXCLUDED(lock_);
+  int bind(int sockfd, const struct sockaddr* my_addr,
+           socklen_t addrlen) override LOCKS_EXCLUDED(lock_);
+  ssize_t sendmsg(int sockfd, const struct msghdr* msg, int flags) override
+      LOCKS_EXCLUDED(lock_);
+  ssize_t recvmsg(int sockfd, struct msghdr* msg, int flags) override
+      LOCKS_EXCLUDED(lock_);
+  int epoll_create1(int flags) override LOCKS_EXCLUDED(lock_);
+  int epoll_ctl(int efd, int op, int fd, struct epoll_event* event) override
+      LOCKS_EXCLUDED(lock_);
+  int epoll_wait(int efd, struct epoll_event* events, int maxevents,
+                 int timeout) override LOCKS_EXCLUDED(lock_);
+  bool ShouldProxyEpollCreate() override;
+
+  // Adds a netif with the given name and MAC address, in the down state. This
+  // is typically called from BcmSdkInterface::CreateKnetIntf(). Returns the
+  // ifindex of the netif.
+  int AddNetif(const std::string& name, uint64 mac) LOCKS_EXCLUDED(lock_);
+
+  // Injects a packet (RCPU header, RX metadata and payload) on a netif. Returns
+  // false if the packet was dropped by all the sockets bound to the netif.
+  bool InjectPacket(const std::string& netif_name, const std::string& packet)
+      LOCKS_EXCLUDED(lock_);
+
+  // Starts a thread injecting num_packets copies of a packet on a netif at the
+  // given rate, or as fast as possible if rate_pps is 0. Only one generator
+  // can run at a time.
+  ::util::Status StartTrafficGenerator(const std::string& netif_name,
+                                       const std::string& packet,
+                                       int64 num_packets, int64 rate_pps)
+      LOCKS_EXCLUDED(lock_);
+
+  // Waits for the traffic generator to inject all its packets, or stops it
+  // after the given timeout. Returns the number of packets injected.
+  int64 StopTrafficGenerator(absl::Duration timeout) LOCKS_EXCLUDED(lock_);
+
+  // Returns the last packets sent on a netif, oldest first.
+  std::vector<std::string> GetTxPackets(const std::string& netif_name) const
+      LOCKS_EXCLUDED(lock_);
+
+  // Returns the statistics of a netif. All zero if the netif does not exist.
+  NetifStats GetNetifStats(const std::string& netif_name) const
+      LOCKS_EXCLUDED(lock_);
+
+  // Builds a packet as sent to the CPU by a Tomahawk/Trident2 chip: RCPU
+  // header, RX metadata (DCB) and the given payload.
+  static std::string BuildRxKnetPacket(const RxMetadata& meta,
+                                       const std::string& payload);
+
+  // Parses the RCPU header and RX metadata (the first kRxKnetHeaderSize bytes)
+  // of a packet built by BuildRxKnetPacket. Can be used to emulate
+  // BcmSdkInterface::ParseKnetHeaderForRx() in tests.
+  static ::util::Status ParseRxKnetHeader(const std::string& header,
+                                          RxMetadata* meta);
+
+  // Creates an instance of the class. The instance needs to be installed with
+  // LibcWrapper::SetLibcProxy() and outlive all the users of the proxied calls.
+  static std::unique_ptr<SimKnetLibcProxy> CreateInstance(
+      const Options& options);
+
+  // SimKnetLibcProxy is neither copyable nor movable.
+  SimKnetLibcProxy(const SimKnetLibcProxy&) = delete;
+  SimKnetLibcProxy& operator=(const SimKnetLibcProxy&) = delete;
+
+ private:
+  enum SocketType {
+    kControlSocket,
+    kPacketSocket,
+    kEpollInstance,
+  };
+
+  // An emulated file descriptor.
+  struct SimFd {
+    SocketType type;
+    // For packet sockets: the ifindex the socket is bound to (0 if unbound),
+    // the receive buffer size and the queued packets.
+    int ifindex;
+    size_t rcvbuf;
+    size_t rx_bytes;
+    std::deque<std::string> rx_queue;
+    // For epoll instances: map from fd to the registered event.
+    std::map<int, struct epoll_event> interests;
+    SimFd() : type(kControlSocket), ifindex(0), rcvbuf(0), rx_bytes(0) {}
+  };
+
+  // An emulated KNET netif.
+  struct Netif {
+    std::string name;
+    int ifindex;
+    uint64 mac;
+    int16 flags;
+    int mtu;
+    NetifStats stats;
+    std::deque<std::string> tx_packets;
+    Netif() : ifindex(0), mac(0), flags(0), mtu(1500) {}
+  };
+
+  // Private constructor, we can create the instance by using `CreateInstance`
+  // function only.
+  explicit SimKnetLibcProxy(const Options& options);
+
+  // Returns the emulated fd, or nullptr if the fd was not created by the class.
+  SimFd* FindSimFd(int fd) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Returns the netif with the given name/ifindex, or nullptr if not found.
+  Netif* FindNetifByName(const std::string& name)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+  Netif* FindNetifByIndex(int ifindex) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Handles an ioctl on a control socket.
+  int NetifIoctl(uint64 request, struct ifreq* ifr)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Returns the number of fds of the epoll instance ready for reading, and
+  // fills up to maxevents events for them.
+  int GetReadyEvents(const SimFd& epoll, struct epoll_event* events,
+                     int maxevents) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Body of the traffic generator thread.
+  void TrafficGeneratorLoop(std::string netif_name, std::string packet,
+                            int64 num_packets, int64 rate_pps)
+      LOCKS_EXCLUDED(lock_);
+
+  // The options, set upon construction and never changed afterwards.
+  const Options options_;
+
+  // Mutex protecting the emulated fds and netifs.
+  mutable absl::Mutex lock_;
+
+  // Signaled every time a packet is queued on a socket, or an fd is closed.
+  absl::CondVar rx_cond_var_;
+
+  // Map from fd to the emulated fd.
+  std::map<int, SimFd> fds_ GUARDED_BY(lock_);
+
+  // The next fd to allocate. Emulated fds are allocated well above the fds
+  // normally used by the process, so they do not collide with real ones.
+  int next_fd_ GUARDED_BY(lock_);
+
+  // Map from ifindex to netif.
+  std::map<int, Netif> netifs_ GUARDED_BY(lock_);
+
+  // The traffic generator thread, its stop flag and number of packets sent.
+  std::thread generator_;
+  bool generator_stop_ GUARDED_BY(lock_);
+  bool generator_done_ GUARDED_BY(lock_);
+  int64 generator_sent_ GUARDED_BY(lock_);
+};
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_BCM_SIM_KNET_LIBC_PROXY_H_
@@ -0,0 +1,243 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/bcm/sim_knet_libc_proxy.h"
+
+#include <errno.h>
+#include <net/if.h>
+#include <netpacket/packet.h>
+#include <string.h>
+
+#include <string>
+
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/bcm/constants.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+class SimKnetLibcProxyTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    SimKnetLibcProxy::Options options;
+    options.default_rcvbuf = 1000;
+    options.max_tx_packets_kept = 2;
+    sim_ = SimKnetLibcProxy::CreateInstance(options);
+    ifindex_ = sim_->AddNetif(kNetifName, kMac);
+  }
+
+  // Brings the netif up and returns a packet socket bound to it.
+  int SetUpRxSocket() {
+    int sock = sim_->socket(AF_INET, SOCK_DGRAM, 0);
+    EXPECT_GT(sock, 0);
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, kNetifName, IFNAMSIZ);
+    EXPECT_EQ(0, sim_->ioctl(sock, SIOCGIFFLAGS, &ifr));
+    ifr.ifr_flags |= IFF_UP;
+    EXPECT_EQ(0, sim_->ioctl(sock, SIOCSIFFLAGS, &ifr));
+    EXPECT_EQ(0, sim_->close(sock));
+
+    int rx_sock = sim_->socket(AF_PACKET, SOCK_RAW, 0);
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_ifindex = ifindex_;
+    EXPECT_EQ(0, sim_->bind(rx_sock, reinterpret_cast<struct sockaddr*>(&addr),
+                            sizeof(addr)));
+    return rx_sock;
+  }
+
+  // Reads a packet from the socket. Returns the recvmsg() result.
+  ssize_t Receive(int sock, std::string* packet) {
+    char buf[2048];
+    struct iovec iov = {buf, sizeof(buf)};
+    struct sockaddr_ll sa;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_name = &sa;
+    msg.msg_namelen = sizeof(sa);
+    ssize_t res = sim_->recvmsg(sock, &msg, MSG_DONTWAIT);
+    if (res > 0) {
+      EXPECT_EQ(ifindex_, sa.sll_ifindex);
+      EXPECT_EQ(PACKET_HOST, sa.sll_pkttype);
+      packet->assign(buf, res);
+    }
+    return res;
+  }
+
+  static constexpr char kNetifName[] = "knet-0-1";
+  static constexpr uint64 kMac = 0x112233445566ULL;
+
+  std::unique_ptr<SimKnetLibcProxy> sim_;
+  int ifindex_;
+};
+
+constexpr char SimKnetLibcProxyTest::kNetifName[];
+constexpr uint64 SimKnetLibcProxyTest::kMac;
+
+TEST_F(SimKnetLibcProxyTest, NetifIoctls) {
+  int sock = sim_->socket(AF_INET, SOCK_DGRAM, 0);
+  struct ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  strncpy(ifr.ifr_name, kNetifName, IFNAMSIZ);
+  ASSERT_EQ(0, sim_->ioctl(sock, SIOCGIFINDEX, &ifr));
+  EXPECT_EQ(ifindex_, ifr.ifr_ifindex);
+  ASSERT_EQ(0, sim_->ioctl(sock, SIOCGIFHWADDR, &ifr));
+  EXPECT_EQ(0, memcmp("\x11\x22\x33\x44\x55\x66", ifr.ifr_hwaddr.sa_data, 6));
+
+  strncpy(ifr.ifr_name, "unknown", IFNAMSIZ);
+  EXPECT_EQ(-1, sim_->ioctl(sock, SIOCGIFINDEX, &ifr));
+  EXPECT_EQ(ENODEV, errno);
+  EXPECT_EQ(0, sim_->close(sock));
+}
+
+TEST_F(SimKnetLibcProxyTest, InjectAndReceive) {
+  int sock = SetUpRxSocket();
+  int efd = sim_->epoll_create1(0);
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.fd = sock;
+  ASSERT_EQ(0, sim_->epoll_ctl(efd, EPOLL_CTL_ADD, sock, &event));
+
+  // Nothing to read yet.
+  struct epoll_event events[1];
+  EXPECT_EQ(0, sim_->epoll_wait(efd, events, 1, 10));
+  std::string packet;
+  EXPECT_EQ(-1, Receive(sock, &packet));
+  EXPECT_EQ(EAGAIN, errno);
+
+  EXPECT_TRUE(sim_->InjectPacket(kNetifName, "packet1"));
+  ASSERT_EQ(1, sim_->epoll_wait(efd, events, 1, -1));
+  EXPECT_EQ(sock, events[0].data.fd);
+  EXPECT_TRUE(events[0].events & EPOLLIN);
+  EXPECT_EQ(7, Receive(sock, &packet));
+  EXPECT_EQ("packet1", packet);
+  EXPECT_EQ(0, sim_->epoll_wait(efd, events, 1, 0));
+
+  auto stats = sim_->GetNetifStats(kNetifName);
+  EXPECT_EQ(1U, stats.rx_injected);
+  EXPECT_EQ(1U, stats.rx_delivered);
+  EXPECT_EQ(0U, stats.rx_dropped);
+  EXPECT_EQ(0, sim_->close(efd));
+  EXPECT_EQ(0, sim_->close(sock));
+}
+
+TEST_F(SimKnetLibcProxyTest, DropsWhenReceiveBufferIsFull) {
+  // No socket bound to the netif.
+  EXPECT_FALSE(sim_->InjectPacket(kNetifName, std::string(600, 'x')));
+
+  int sock = SetUpRxSocket();
+  EXPECT_TRUE(sim_->InjectPacket(kNetifName, std::string(600, 'x')));
+  EXPECT_TRUE(sim_->InjectPacket(kNetifName, std::string(600, 'x')));
+  // The 1000 bytes buffer is full.
+  EXPECT_FALSE(sim_->InjectPacket(kNetifName, std::string(600, 'x')));
+
+  auto stats = sim_->GetNetifStats(kNetifName);
+  EXPECT_EQ(4U, stats.rx_injected);
+  EXPECT_EQ(2U, stats.rx_dropped);
+
+  // Reading a packet makes room for the next one.
+  std::string packet;
+  EXPECT_EQ(600, Receive(sock, &packet));
+  EXPECT_TRUE(sim_->InjectPacket(kNetifName, std::string(600, 'x')));
+
+  // A larger buffer can be configured.
+  int rcvbuf = 1000;
+  EXPECT_EQ(0, sim_->setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf,
+                                sizeof(rcvbuf)));
+  EXPECT_TRUE(sim_->InjectPacket(kNetifName, std::string(600, 'x')));
+  EXPECT_EQ(0, sim_->close(sock));
+}
+
+TEST_F(SimKnetLibcProxyTest, Transmit) {
+  int sock = SetUpRxSocket();
+  int tx_sock = sim_->socket(AF_PACKET, SOCK_RAW, 0);
+  std::string header = "header";
+  std::string payload = "payload";
+  struct iovec iov[2] = {{&header[0], header.size()},
+                         {&payload[0], payload.size()}};
+  struct sockaddr_ll sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sll_family = AF_PACKET;
+  sa.sll_ifindex = ifindex_;
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+  msg.msg_name = &sa;
+  msg.msg_namelen = sizeof(sa);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(13, sim_->sendmsg(tx_sock, &msg, MSG_DONTWAIT));
+  }
+
+  // Only the last 2 packets are kept.
+  EXPECT_EQ(std::vector<std::string>({"headerpayload", "headerpayload"}),
+            sim_->GetTxPackets(kNetifName));
+  auto stats = sim_->GetNetifStats(kNetifName);
+  EXPECT_EQ(3U, stats.tx_packets);
+  EXPECT_EQ(39U, stats.tx_bytes);
+  // Sent packets are not looped back.
+  std::string packet;
+  EXPECT_EQ(-1, Receive(sock, &packet));
+
+  sa.sll_ifindex = ifindex_ + 1;
+  EXPECT_EQ(-1, sim_->sendmsg(tx_sock, &msg, MSG_DONTWAIT));
+  EXPECT_EQ(ENXIO, errno);
+  EXPECT_EQ(0, sim_->close(tx_sock));
+  EXPECT_EQ(0, sim_->close(sock));
+}
+
+TEST_F(SimKnetLibcProxyTest, BuildAndParseRxKnetPacket) {
+  SimKnetLibcProxy::RxMetadata meta;
+  meta.op_code = 1;
+  meta.module = 3;
+  meta.src_port = 33;
+  meta.dst_port = 34;
+  meta.cos = 5;
+  std::string packet = SimKnetLibcProxy::BuildRxKnetPacket(meta, "payload");
+  ASSERT_EQ(SimKnetLibcProxy::kRxKnetHeaderSize + 7, packet.size());
+  EXPECT_EQ("payload", packet.substr(SimKnetLibcProxy::kRxKnetHeaderSize));
+  // RCPU ethertype and opcode.
+  EXPECT_EQ('\xde', packet[16]);
+  EXPECT_EQ('\x08', packet[17]);
+  EXPECT_EQ(kRcpuOpcodeToCpuPkt, packet[20]);
+
+  SimKnetLibcProxy::RxMetadata parsed;
+  ASSERT_OK(SimKnetLibcProxy::ParseRxKnetHeader(
+      packet.substr(0, SimKnetLibcProxy::kRxKnetHeaderSize), &parsed));
+  EXPECT_EQ(1, parsed.op_code);
+  EXPECT_EQ(3, parsed.module);
+  EXPECT_EQ(33, parsed.src_port);
+  EXPECT_EQ(34, parsed.dst_port);
+  EXPECT_EQ(5, parsed.cos);
+
+  packet[20] = kRcpuOpcodeFromCpuPkt;
+  EXPECT_FALSE(SimKnetLibcProxy::ParseRxKnetHeader(packet, &parsed).ok());
+}
+
+TEST_F(SimKnetLibcProxyTest, TrafficGenerator) {
+  int sock = SetUpRxSocket();
+  int rcvbuf = 1 << 20;
+  ASSERT_EQ(0, sim_->setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf,
+                                sizeof(rcvbuf)));
+  ASSERT_OK(sim_->StartTrafficGenerator(kNetifName, "packet", 100, 0));
+  EXPECT_FALSE(
+      sim_->StartTrafficGenerator(kNetifName, "packet", 100, 0).ok());
+  EXPECT_EQ(100, sim_->StopTrafficGenerator(absl::Seconds(10)));
+  EXPECT_EQ(100U, sim_->GetNetifStats(kNetifName).rx_injected);
+
+  // A slow generator is stopped on timeout.
+  ASSERT_OK(sim_->StartTrafficGenerator(kNetifName, "packet", 1000, 100));
+  EXPECT_LT(sim_->StopTrafficGenerator(absl::Milliseconds(50)), 1000);
+  EXPECT_EQ(0, sim_->close(sock));
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
@@ -66,6 +66,12 @@ Bmv2Switch::~Bmv2Switch() {}
   return status;
 }
 
+::util::Status Bmv2Switch::PlanChassisConfig(const ChassisConfig& config,
+                                              ChassisConfigPlan* plan) {
+  return MAKE_ERROR(ERR_UNIMPLEMENTED)
+         << "Planning a chassis config is not supported.";
+}
+
 ::util::Status Bmv2Switch::PushForwardingPipelineConfig(
     uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
   ASSIGN_OR_RETURN(auto* pi_node, GetPINodeFromNodeId(node_id));
@@ -0,0 +1,169 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/admission_controller.h"
+
+#include <algorithm>
+
+#include "absl/memory/memory.h"
+#include "absl/time/clock.h"
+#include "stratum/glue/gtl/map_util.h"
+#include "stratum/glue/logging.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+
+AdmissionController::AdmissionController(const Options& options)
+    : options_(options),
+      controller_usage_(),
+      total_usage_(),
+      controller_drop_state_(),
+      num_priority_admitted_(0),
+      num_bulk_admitted_(0),
+      num_rejected_(0) {}
+
+std::unique_ptr<AdmissionController> AdmissionController::CreateInstance(
+    const Options& options) {
+  return absl::WrapUnique(new AdmissionController(options));
+}
+
+::util::Status AdmissionController::Admit(const std::string& controller,
+                                          Lane lane, int64 num_updates,
+                                          int64 num_bytes,
+                                          absl::Duration* retry_hint) {
+  absl::MutexLock l(&lock_);
+  if (lane == kPriorityLane) {
+    ++num_priority_admitted_;
+    return ::util::OkStatus();
+  }
+
+  const Usage* usage = gtl::FindOrNull(controller_usage_, controller);
+  const DropState* drop_state =
+      gtl::FindOrNull(controller_drop_state_, controller);
+  if (drop_state != nullptr && drop_state->dropping && usage != nullptr) {
+    // The queue of the controller has been persistently too long. Keep a
+    // single request of the controller in flight, which tells us when the
+    // queue has drained.
+    ++num_rejected_;
+    if (retry_hint != nullptr) *retry_hint = RetryHint(drop_state);
+    return MAKE_ERROR(ERR_NO_RESOURCE).without_logging()
+           << "P4Runtime queue delay of "
+           << absl::ToInt64Milliseconds(drop_state->last_queue_delay)
+           << " ms is above target for controller " << controller
+           << ". Retry after "
+           << absl::ToInt64Milliseconds(RetryHint(drop_state)) << " ms.";
+  }
+  if (!Fits(usage ? *usage : Usage(), num_updates, num_bytes,
+            options_.max_updates_per_controller,
+            options_.max_bytes_per_controller) ||
+      !Fits(total_usage_, num_updates, num_bytes, options_.max_updates,
+            options_.max_bytes)) {
+    ++num_rejected_;
+    if (retry_hint != nullptr) *retry_hint = RetryHint(drop_state);
+    return MAKE_ERROR(ERR_NO_RESOURCE).without_logging()
+           << "Too much P4Runtime work in flight for controller "
+           << controller << ". Retry after "
+           << absl::ToInt64Milliseconds(RetryHint(drop_state)) << " ms.";
+  }
+
+  Usage& new_usage = controller_usage_[controller];
+  new_usage.updates += num_updates;
+  new_usage.bytes += num_bytes;
+  total_usage_.updates += num_updates;
+  total_usage_.bytes += num_bytes;
+  ++num_bulk_admitted_;
+
+  return ::util::OkStatus();
+}
+
+void AdmissionController::Release(const std::string& controller,
+                                  int64 num_updates, int64 num_bytes,
+                                  absl::Duration queue_delay) {
+  absl::MutexLock l(&lock_);
+  auto it = controller_usage_.find(controller);
+  if (it == controller_usage_.end()) {
+    LOG(ERROR) << "Releasing work of controller " << controller
+               << " which has nothing in flight.";
+    return;
+  }
+  it->second.updates -= num_updates;
+  it->second.bytes -= num_bytes;
+  if (it->second.updates <= 0 && it->second.bytes <= 0) {
+    controller_usage_.erase(it);
+  }
+  total_usage_.updates -= num_updates;
+  total_usage_.bytes -= num_bytes;
+  UpdateDropState(controller, queue_delay, absl::Now());
+}
+
+uint64 AdmissionController::GetNumAdmitted(Lane lane) const {
+  absl::MutexLock l(&lock_);
+  return lane == kPriorityLane ? num_priority_admitted_ : num_bulk_admitted_;
+}
+
+uint64 AdmissionController::GetNumRejected() const {
+  absl::MutexLock l(&lock_);
+  return num_rejected_;
+}
+
+bool AdmissionController::IsDropping(const std::string& controller) const {
+  absl::MutexLock l(&lock_);
+  const DropState* drop_state =
+      gtl::FindOrNull(controller_drop_state_, controller);
+  return drop_state != nullptr && drop_state->dropping;
+}
+
+bool AdmissionController::Fits(const Usage& usage, int64 num_updates,
+                               int64 num_bytes, int64 max_updates,
+                               int64 max_bytes) {
+  // Nothing in flight: always admit, so that oversized requests still make
+  // progress.
+  if (usage.updates <= 0 && usage.bytes <= 0) return true;
+  if (max_updates > 0 && usage.updates + num_updates > max_updates) {
+    return false;
+  }
+  if (max_bytes > 0 && usage.bytes + num_bytes > max_bytes) return false;
+
+  return true;
+}
+
+void AdmissionController::UpdateDropState(const std::string& controller,
+                                          absl::Duration queue_delay,
+                                          absl::Time now) {
+  if (options_.target_queue_delay <= absl::ZeroDuration()) return;
+  if (queue_delay < options_.target_queue_delay) {
+    // The queue drained below target, stop dropping.
+    auto it = controller_drop_state_.find(controller);
+    if (it == controller_drop_state_.end()) return;
+    if (it->second.dropping) {
+      VLOG(1) << "P4Runtime queue delay of controller " << controller
+              << " back below target.";
+    }
+    controller_drop_state_.erase(it);
+    return;
+  }
+  DropState& drop_state = controller_drop_state_[controller];
+  drop_state.last_queue_delay = queue_delay;
+  if (drop_state.first_above_time == absl::InfiniteFuture()) {
+    drop_state.first_above_time = now + options_.interval;
+  } else if (!drop_state.dropping && now >= drop_state.first_above_time) {
+    LOG(WARNING) << "P4Runtime queue delay of controller " << controller
+                 << " stayed above " << options_.target_queue_delay
+                 << " for " << options_.interval
+                 << ". Rejecting its requests early.";
+    drop_state.dropping = true;
+  }
+}
+
+absl::Duration AdmissionController::RetryHint(
+    const DropState* drop_state) const {
+  const absl::Duration last_queue_delay =
+      drop_state ? drop_state->last_queue_delay : absl::ZeroDuration();
+  return std::min(std::max(last_queue_delay, options_.target_queue_delay),
+                  options_.interval);
+}
+
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,171 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_COMMON_ADMISSION_CONTROLLER_H_
+#define STRATUM_HAL_LIB_COMMON_ADMISSION_CONTROLLER_H_
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+
+namespace stratum {
+namespace hal {
+
+// AdmissionController bounds the amount of work the P4Runtime service accepts
+// concurrently. Requests are classified into one of two lanes:
+// - The priority lane (arbitration, and PacketOut and digest acks from the
+//   primary) bypasses the bulk lane: it is never rejected and does not
+//   consume the bulk budget. The StreamChannel messages are handled one at a
+//   time by the thread of their stream, and the number of streams is bounded
+//   by --max_num_controller_connections, so they need no limit of their own.
+// - The bulk lane (Write RPCs) is subject to per-controller and global limits
+//   on the number of in-flight updates and bytes. A request that does not fit
+//   is rejected right away with ERR_NO_RESOURCE (mapped to RESOURCE_EXHAUSTED)
+//   and a retry hint. It never waits, so an overloaded switch cannot park the
+//   gRPC server threads needed by the other RPCs and by arbitration.
+// The time from the arrival of a bulk request to the start of its switch write
+// is its queue delay. Like in CoDel, once the queue delay of a controller has
+// stayed above the target for a whole interval, the controller enters a
+// dropping state where it may only have one request in flight. Any further
+// request of that controller is rejected early. The dropping state is left as
+// soon as a request of the controller starts below target. The other
+// controllers are not affected.
+class AdmissionController {
+ public:
+  // The lane a request is admitted through.
+  enum Lane {
+    kPriorityLane,
+    kBulkLane,
+  };
+
+  // Admission limits. A limit of zero means no limit.
+  struct Options {
+    // Max number of updates/bytes in flight for a single controller.
+    int64 max_updates_per_controller;
+    int64 max_bytes_per_controller;
+    // Max number of updates/bytes in flight for all the controllers combined.
+    int64 max_updates;
+    int64 max_bytes;
+    // The acceptable queue delay. A zero target disables the early rejection.
+    absl::Duration target_queue_delay;
+    // The interval the queue delay must stay above target before requests are
+    // rejected early. Also caps the retry hint.
+    absl::Duration interval;
+    Options()
+        : max_updates_per_controller(0),
+          max_bytes_per_controller(0),
+          max_updates(0),
+          max_bytes(0),
+          target_queue_delay(absl::ZeroDuration()),
+          interval(absl::Seconds(1)) {}
+  };
+
+  // Admits a request of num_updates updates and num_bytes bytes on behalf of
+  // the given controller through the given lane. Never blocks. Priority
+  // requests are always admitted and need no Release(). A bulk request larger
+  // than a limit is admitted if nothing else is in flight within the scope of
+  // that limit. Returns ERR_NO_RESOURCE if the request was rejected, in which
+  // case retry_hint (if not nullptr) is set to the time after which the
+  // controller is advised to retry. Every admitted bulk request must be
+  // released with the same arguments by calling Release().
+  ::util::Status Admit(const std::string& controller, Lane lane,
+                       int64 num_updates, int64 num_bytes,
+                       absl::Duration* retry_hint) LOCKS_EXCLUDED(lock_);
+
+  // Releases a bulk request previously admitted by Admit(). queue_delay is the
+  // time from the arrival of the request to the start of its switch write.
+  void Release(const std::string& controller, int64 num_updates,
+               int64 num_bytes, absl::Duration queue_delay)
+      LOCKS_EXCLUDED(lock_);
+
+  // Returns the number of requests admitted so far through the given lane.
+  uint64 GetNumAdmitted(Lane lane) const LOCKS_EXCLUDED(lock_);
+
+  // Returns the number of bulk requests rejected so far.
+  uint64 GetNumRejected() const LOCKS_EXCLUDED(lock_);
+
+  // Returns true if the requests of the controller are currently rejected
+  // early.
+  bool IsDropping(const std::string& controller) const LOCKS_EXCLUDED(lock_);
+
+  // Creates an admission controller instance with the given limits.
+  static std::unique_ptr<AdmissionController> CreateInstance(
+      const Options& options);
+
+  // AdmissionController is neither copyable nor movable.
+  AdmissionController(const AdmissionController&) = delete;
+  AdmissionController& operator=(const AdmissionController&) = delete;
+
+ private:
+  // Amount of bulk work in flight.
+  struct Usage {
+    int64 updates;
+    int64 bytes;
+    Usage() : updates(0), bytes(0) {}
+  };
+
+  // CoDel state of a controller: whether it is in the dropping state, the
+  // time at which it enters it if the queue delay stays above target until
+  // then, and the queue delay of its last completed request.
+  struct DropState {
+    bool dropping;
+    absl::Time first_above_time;
+    absl::Duration last_queue_delay;
+    DropState()
+        : dropping(false),
+          first_above_time(absl::InfiniteFuture()),
+          last_queue_delay(absl::ZeroDuration()) {}
+  };
+
+  // Private constructor, we can create the instance by using `CreateInstance`
+  // function only.
+  explicit AdmissionController(const Options& options);
+
+  // Returns true if a request of the given size fits within the limits, given
+  // the current usage.
+  static bool Fits(const Usage& usage, int64 num_updates, int64 num_bytes,
+                   int64 max_updates, int64 max_bytes);
+
+  // Updates the CoDel state of the controller after one of its requests
+  // waited queue_delay before its switch write.
+  void UpdateDropState(const std::string& controller,
+                       absl::Duration queue_delay, absl::Time now)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Returns the retry hint given to the rejected requests of a controller
+  // with the given CoDel state, or without one if nullptr.
+  absl::Duration RetryHint(const DropState* drop_state) const;
+
+  // The admission limits, set upon construction and never changed afterwards.
+  const Options options_;
+
+  // Mutex protecting the internal state.
+  mutable absl::Mutex lock_;
+
+  // Map from controller to its bulk work in flight. Entries are removed once
+  // the controller has nothing in flight.
+  std::map<std::string, Usage> controller_usage_ GUARDED_BY(lock_);
+
+  // Bulk work in flight for all the controllers combined.
+  Usage total_usage_ GUARDED_BY(lock_);
+
+  // Map from controller to its CoDel state. Entries are removed once the
+  // queue delay of the controller is back below target.
+  std::map<std::string, DropState> controller_drop_state_ GUARDED_BY(lock_);
+
+  // Statistics.
+  uint64 num_priority_admitted_ GUARDED_BY(lock_);
+  uint64 num_bulk_admitted_ GUARDED_BY(lock_);
+  uint64 num_rejected_ GUARDED_BY(lock_);
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_COMMON_ADMISSION_CONTROLLER_H_
@@ -0,0 +1,165 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/admission_controller.h"
+
+#include <memory>
+
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+
+using ::testing::HasSubstr;
+
+class AdmissionControllerTest : public ::testing::Test {
+ protected:
+  static AdmissionController::Options GetOptions() {
+    AdmissionController::Options options;
+    options.max_updates_per_controller = 10;
+    options.max_bytes_per_controller = 1000;
+    options.max_updates = 15;
+    options.max_bytes = 1500;
+    options.target_queue_delay = absl::Milliseconds(10);
+    options.interval = absl::Milliseconds(100);
+    return options;
+  }
+
+  static constexpr char kController1[] = "controller1";
+  static constexpr char kController2[] = "controller2";
+  static constexpr AdmissionController::Lane kBulk =
+      AdmissionController::kBulkLane;
+  static constexpr AdmissionController::Lane kPriority =
+      AdmissionController::kPriorityLane;
+};
+
+constexpr char AdmissionControllerTest::kController1[];
+constexpr char AdmissionControllerTest::kController2[];
+constexpr AdmissionController::Lane AdmissionControllerTest::kBulk;
+constexpr AdmissionController::Lane AdmissionControllerTest::kPriority;
+
+TEST_F(AdmissionControllerTest, PerControllerLimits) {
+  auto admission = AdmissionController::CreateInstance(GetOptions());
+  EXPECT_OK(admission->Admit(kController1, kBulk, 8, 100, nullptr));
+
+  // Too many updates for controller 1. Nothing completed yet, so the retry
+  // hint is the target queue delay.
+  absl::Duration retry_hint;
+  ::util::Status status =
+      admission->Admit(kController1, kBulk, 3, 100, &retry_hint);
+  EXPECT_EQ(ERR_NO_RESOURCE, status.error_code());
+  EXPECT_THAT(status.error_message(), HasSubstr("Too much P4Runtime work"));
+  EXPECT_EQ(GetOptions().target_queue_delay, retry_hint);
+  // Too many bytes for controller 1.
+  status = admission->Admit(kController1, kBulk, 1, 901, nullptr);
+  EXPECT_EQ(ERR_NO_RESOURCE, status.error_code());
+  // Controller 2 has its own budget.
+  EXPECT_OK(admission->Admit(kController2, kBulk, 5, 100, nullptr));
+  EXPECT_EQ(2, admission->GetNumAdmitted(kBulk));
+  EXPECT_EQ(2, admission->GetNumRejected());
+}
+
+TEST_F(AdmissionControllerTest, GlobalLimits) {
+  auto admission = AdmissionController::CreateInstance(GetOptions());
+  EXPECT_OK(admission->Admit(kController1, kBulk, 10, 100, nullptr));
+  EXPECT_OK(admission->Admit(kController2, kBulk, 5, 100, nullptr));
+
+  // Controller 2 is within its own limits, but the global limit is hit.
+  ::util::Status status =
+      admission->Admit(kController2, kBulk, 1, 100, nullptr);
+  EXPECT_EQ(ERR_NO_RESOURCE, status.error_code());
+  admission->Release(kController1, 10, 100, absl::ZeroDuration());
+  EXPECT_OK(admission->Admit(kController2, kBulk, 1, 100, nullptr));
+}
+
+TEST_F(AdmissionControllerTest, OversizedRequestIsAdmittedWhenIdle) {
+  auto admission = AdmissionController::CreateInstance(GetOptions());
+  EXPECT_OK(admission->Admit(kController1, kBulk, 100, 10000, nullptr));
+  EXPECT_EQ(ERR_NO_RESOURCE,
+            admission->Admit(kController1, kBulk, 1, 1, nullptr).error_code());
+  admission->Release(kController1, 100, 10000, absl::ZeroDuration());
+  EXPECT_OK(admission->Admit(kController1, kBulk, 100, 10000, nullptr));
+}
+
+TEST_F(AdmissionControllerTest, PersistentQueueDelayRejectsEarly) {
+  const AdmissionController::Options options = GetOptions();
+  const absl::Duration kSlow = 5 * options.target_queue_delay;
+  auto admission = AdmissionController::CreateInstance(options);
+
+  // A slow write alone does not trigger the dropping state.
+  EXPECT_OK(admission->Admit(kController1, kBulk, 1, 10, nullptr));
+  admission->Release(kController1, 1, 10, kSlow);
+  EXPECT_FALSE(admission->IsDropping(kController1));
+  // Writes still slow after a whole interval do.
+  absl::SleepFor(options.interval);
+  EXPECT_OK(admission->Admit(kController1, kBulk, 1, 10, nullptr));
+  admission->Release(kController1, 1, 10, kSlow);
+  EXPECT_TRUE(admission->IsDropping(kController1));
+
+  // Once dropping, each controller may only have one write in flight, even
+  // within the limits. The others are rejected with a retry hint.
+  EXPECT_OK(admission->Admit(kController1, kBulk, 1, 10, nullptr));
+  absl::Duration retry_hint;
+  ::util::Status status =
+      admission->Admit(kController1, kBulk, 1, 10, &retry_hint);
+  EXPECT_EQ(ERR_NO_RESOURCE, status.error_code());
+  EXPECT_THAT(status.error_message(), HasSubstr("above target"));
+  EXPECT_EQ(kSlow, retry_hint);
+  // The other controllers are not affected.
+  EXPECT_FALSE(admission->IsDropping(kController2));
+  EXPECT_OK(admission->Admit(kController2, kBulk, 1, 10, nullptr));
+  EXPECT_OK(admission->Admit(kController2, kBulk, 1, 10, nullptr));
+
+  // A write starting below target ends the dropping state.
+  admission->Release(kController1, 1, 10, absl::ZeroDuration());
+  EXPECT_FALSE(admission->IsDropping(kController1));
+  EXPECT_OK(admission->Admit(kController1, kBulk, 1, 10, nullptr));
+  EXPECT_OK(admission->Admit(kController1, kBulk, 1, 10, nullptr));
+}
+
+TEST_F(AdmissionControllerTest, ZeroTargetNeverRejectsEarly) {
+  AdmissionController::Options options = GetOptions();
+  options.target_queue_delay = absl::ZeroDuration();
+  options.interval = absl::ZeroDuration();
+  auto admission = AdmissionController::CreateInstance(options);
+
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_OK(admission->Admit(kController1, kBulk, 1, 10, nullptr));
+    admission->Release(kController1, 1, 10, absl::Seconds(10));
+  }
+  EXPECT_FALSE(admission->IsDropping(kController1));
+  EXPECT_OK(admission->Admit(kController1, kBulk, 1, 10, nullptr));
+  EXPECT_OK(admission->Admit(kController1, kBulk, 1, 10, nullptr));
+}
+
+TEST_F(AdmissionControllerTest, PriorityLaneBypassesBulkLimits) {
+  const AdmissionController::Options options = GetOptions();
+  auto admission = AdmissionController::CreateInstance(options);
+
+  // Saturate the bulk budget and make controller 1 drop.
+  EXPECT_OK(admission->Admit(kController1, kBulk, 10, 1000, nullptr));
+  admission->Release(kController1, 10, 1000, 5 * options.target_queue_delay);
+  absl::SleepFor(options.interval);
+  EXPECT_OK(admission->Admit(kController1, kBulk, 10, 1000, nullptr));
+  admission->Release(kController1, 10, 1000, 5 * options.target_queue_delay);
+  EXPECT_TRUE(admission->IsDropping(kController1));
+  EXPECT_OK(admission->Admit(kController1, kBulk, 10, 1000, nullptr));
+  EXPECT_EQ(ERR_NO_RESOURCE,
+            admission->Admit(kController1, kBulk, 1, 1, nullptr).error_code());
+
+  // The priority lane is neither limited nor rejected early.
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_OK(admission->Admit(kController1, kPriority, 10, 1000, nullptr));
+  }
+  EXPECT_EQ(3, admission->GetNumAdmitted(kPriority));
+  EXPECT_EQ(3, admission->GetNumAdmitted(kBulk));
+  EXPECT_EQ(1, admission->GetNumRejected());
+}
+
+}  // namespace hal
+}  // namespace stratum
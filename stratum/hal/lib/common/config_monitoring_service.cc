@@ -4,11 +4,14 @@
 
 #include "stratum/hal/lib/common/config_monitoring_service.h"
 
+#include <algorithm>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_set.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/str_split.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/clock.h"
 #include "gflags/gflags.h"
@@ -23,6 +26,7 @@
 #include "stratum/lib/macros.h"
 #include "stratum/lib/utils.h"
 #include "stratum/public/lib/error.h"
+#include "stratum/public/proto/gnmi_extensions.pb.h"
 
 DEFINE_string(chassis_config_file, "",
               "The latest verified ChassisConfig proto pushed to the switch. "
@@ -32,25 +36,139 @@ DEFINE_string(chassis_config_file, "",
               "flags.");
 DEFINE_string(gnmi_capabilities_file, "/etc/stratum/gnmi_caps.pb.txt",
               "Path to the file containing the gNMI capabilities proto.");
+DEFINE_string(gnmi_history_paths, "",
+              "Comma-separated list of gNMI paths, e.g. "
+              "/interfaces/interface[name=*]/state/counters, whose values are "
+              "periodically sampled into the on-box telemetry history. Empty "
+              "disables the history.");
+DEFINE_int32(gnmi_history_sample_period_ms, 10000,
+             "The period at which the telemetry history paths are sampled.");
+DEFINE_int32(gnmi_history_retention_s, 900,
+             "How long the samples of the telemetry history are kept.");
+DEFINE_int64(gnmi_history_max_bytes, 16 << 20,
+             "Max number of bytes of encoded samples kept by the telemetry "
+             "history.");
+DEFINE_string(gnmi_history_file, "/tmp/stratum_telemetry_history.pb.txt",
+              "The file the telemetry history is written to when requested.");
+DEFINE_int32(gnmi_config_history_size, 10,
+             "Number of recently pushed chassis configs kept in memory for "
+             "rollback by a gNMI Set.");
 
 namespace stratum {
 namespace hal {
 
+namespace {
+
+// Creates the telemetry history from the flags, or returns nullptr if no path
+// is to be sampled.
+std::unique_ptr<TelemetryHistory> CreateTelemetryHistory(
+    GnmiPublisher* gnmi_publisher) {
+  if (FLAGS_gnmi_history_paths.empty()) return nullptr;
+  TelemetryHistory::Options options;
+  options.sample_period =
+      absl::Milliseconds(FLAGS_gnmi_history_sample_period_ms);
+  options.retention = absl::Seconds(FLAGS_gnmi_history_retention_s);
+  options.max_bytes = FLAGS_gnmi_history_max_bytes;
+  auto history = TelemetryHistory::CreateInstance(gnmi_publisher, options);
+  for (const auto& str : absl::StrSplit(FLAGS_gnmi_history_paths, ',',
+                                        absl::SkipWhitespace())) {
+    auto path = TelemetryHistory::ParsePath(std::string(str));
+    if (!path.ok()) {
+      LOG(ERROR) << "Ignoring telemetry history path: " << path.status();
+      continue;
+    }
+    history->AddPath(path.ValueOrDie());
+  }
+
+  return history;
+}
+
+// Looks for a Stratum gNMI extension of the given kind in the extensions of a
+// gNMI request. Returns true and fills 'gnmi_extension' if one is found.
+template <typename T>
+bool FindGnmiExtension(const T& req,
+                       GnmiExtension::ExtensionCase extension_case,
+                       GnmiExtension* gnmi_extension) {
+  for (const auto& extension : req.extension()) {
+    if (!extension.has_registered_ext() ||
+        extension.registered_ext().id() != ::gnmi_ext::EID_EXPERIMENTAL) {
+      continue;
+    }
+    if (gnmi_extension->ParseFromString(extension.registered_ext().msg()) &&
+        gnmi_extension->extension_case() == extension_case) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Returns the telemetry history request carried in the extensions of a gNMI
+// request, or nullptr if there is none.
+template <typename T>
+std::unique_ptr<TelemetryHistoryRequest> FindTelemetryHistoryRequest(
+    const T& req) {
+  GnmiExtension gnmi_extension;
+  if (!FindGnmiExtension(req, GnmiExtension::kHistory, &gnmi_extension)) {
+    return nullptr;
+  }
+
+  return absl::make_unique<TelemetryHistoryRequest>(gnmi_extension.history());
+}
+
+// Returns true if a Set request carries any change to the config.
+bool HasChanges(const ::gnmi::SetRequest& req) {
+  return req.delete__size() > 0 || req.replace_size() > 0 ||
+         req.update_size() > 0;
+}
+
+// Returns a gRPC status with the same code and message as 'status'.
+::grpc::Status ToGrpcStatus(const ::util::Status& status) {
+  return ::grpc::Status(ToGrpcCode(status.CanonicalCode()),
+                        status.error_message());
+}
+
+// Returns the recorded values of a path in the requested time range.
+::util::StatusOr<std::vector<::gnmi::Notification>> QueryTelemetryHistory(
+    const TelemetryHistory* history, const TelemetryHistoryRequest& request,
+    const ::gnmi::Path& path) {
+  if (history == nullptr) {
+    return MAKE_ERROR(ERR_FEATURE_UNAVAILABLE)
+           << "The telemetry history is disabled.";
+  }
+  const absl::Time end = request.end_time_ns() == 0
+                             ? absl::InfiniteFuture()
+                             : absl::FromUnixNanos(request.end_time_ns());
+
+  return history->Query(path, absl::FromUnixNanos(request.start_time_ns()),
+                        end);
+}
+
+}  // namespace
+
 ConfigMonitoringService::ConfigMonitoringService(
     OperationMode mode, SwitchInterface* switch_interface,
     AuthPolicyChecker* auth_policy_checker, ErrorBuffer* error_buffer)
     : running_chassis_config_(nullptr),
+      next_config_version_(1),
+      pending_commit_(nullptr),
+      next_commit_id_(1),
+      rollback_thread_running_(false),
       mode_(mode),
       switch_interface_(ABSL_DIE_IF_NULL(switch_interface)),
       auth_policy_checker_(ABSL_DIE_IF_NULL(auth_policy_checker)),
       error_buffer_(ABSL_DIE_IF_NULL(error_buffer)),
-      gnmi_publisher_(switch_interface) {
+      gnmi_publisher_(switch_interface),
+      telemetry_history_(CreateTelemetryHistory(&gnmi_publisher_)) {
   if (TimerDaemon::Start() != ::util::OkStatus()) {
     LOG(ERROR) << "Could not start the timer subsystem.";
   }
 }
 
 ConfigMonitoringService::~ConfigMonitoringService() {
+  StopRollbackThread();
+  // Cancel the sampling before stopping the timers.
+  telemetry_history_ = nullptr;
   if (TimerDaemon::Stop() != ::util::OkStatus()) {
     LOG(ERROR) << "Could not stop the timer subsystem.";
   }
@@ -63,6 +181,15 @@ ConfigMonitoringService::~ConfigMonitoringService() {
         status, "Could not start the gNMI notification subsystem: ", GTL_LOC);
     return status;
   }
+  if (telemetry_history_ != nullptr) {
+    // Paths cannot be sampled until a config is pushed, which is tolerated.
+    status = telemetry_history_->Start();
+    if (!status.ok()) {
+      error_buffer_->AddError(
+          status, "Could not start the gNMI telemetry history: ", GTL_LOC);
+      return status;
+    }
+  }
 
   // If we are coupled mode and are coldbooting, we do not do anything here.
   // TODO(unknown): This will be removed when we completely move to
@@ -77,9 +204,17 @@ ConfigMonitoringService::~ConfigMonitoringService() {
 }
 
 ::util::Status ConfigMonitoringService::Teardown() {
+  // A rollback in progress needs config_lock_ to complete.
+  StopRollbackThread();
   absl::WriterMutexLock l(&config_lock_);
   running_chassis_config_ = nullptr;
+  // Dropping the pending commit cancels its rollback timer.
+  pending_commit_ = nullptr;
+  config_history_.clear();
 
+  if (telemetry_history_ != nullptr) {
+    RETURN_IF_ERROR(telemetry_history_->Stop());
+  }
   if (gnmi_publisher_.UnregisterEventWriter() != ::util::OkStatus()) {
     return MAKE_ERROR(ERR_INTERNAL)
            << "Could not stop the gNMI notification subsystem.";
@@ -88,6 +223,11 @@ ConfigMonitoringService::~ConfigMonitoringService() {
   return ::util::OkStatus();
 }
 
+void ConfigMonitoringService::SetEntryQuotaUsageReader(
+    EntryQuotaUsageReader reader) {
+  gnmi_publisher_.SetEntryQuotaUsageReader(std::move(reader));
+}
+
 ::util::Status ConfigMonitoringService::PushSavedChassisConfig(bool warmboot) {
   // Try to read the saved chassis config and push it to the switch. The
   // config push will initialize the switch if it is done for the first time.
@@ -128,6 +268,7 @@ ConfigMonitoringService::~ConfigMonitoringService() {
 
   // Save running_chassis_config_ after everything went OK.
   running_chassis_config_ = std::move(config);
+  AddRunningConfigToHistory();
 
   // Notify the gNMI GnmiPublisher that the config has changed.
   RETURN_IF_ERROR(gnmi_publisher_.HandleChange(
@@ -198,7 +339,26 @@ bool ContainsUniqueNames(const T& values) {
                                               ::gnmi::SetResponse* resp) {
   absl::WriterMutexLock l(&config_lock_);
 
+  // A Set without CommitRequest is handled as an immediate commit.
+  CommitRequest commit_req;
+  GnmiExtension gnmi_extension;
+  const bool has_commit_req =
+      FindGnmiExtension(*req, GnmiExtension::kCommit, &gnmi_extension);
+  if (has_commit_req) commit_req = gnmi_extension.commit();
+  // A Set with PlanRequest only reports what the edits would do.
+  const bool has_plan_req =
+      FindGnmiExtension(*req, GnmiExtension::kPlan, &gnmi_extension);
+  if (has_plan_req && has_commit_req) {
+    return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
+                          "A Set cannot carry both a PlanRequest and a "
+                          "CommitRequest.");
+  }
+
   CopyOnWriteChassisConfig config(running_chassis_config_.get());
+  if (!has_plan_req) {
+    ::util::Status commit_status = PrepareCommit(*req, commit_req, &config);
+    if (!commit_status.ok()) return ToGrpcStatus(commit_status);
+  }
 
   for (const auto& path : req->delete_()) {
     VLOG(1) << "SET(DELETE): " << path.ShortDebugString();
@@ -243,7 +403,16 @@ bool ContainsUniqueNames(const T& values) {
     res->set_op(::gnmi::UpdateResult_Operation::UpdateResult_Operation_UPDATE);
   }
 
-  if (config.HasBeenChanged()) {
+  ChassisConfigPlan plan;
+  if (has_plan_req) {
+    if (config.HasBeenChanged()) {
+      ::util::Status status = VerifyChassisConfig(*config);
+      if (status.ok()) {
+        status = switch_interface_->PlanChassisConfig(*config, &plan);
+      }
+      if (!status.ok()) return ToGrpcStatus(status);
+    }
+  } else if (config.HasBeenChanged()) {
     // ChassisConfig has changed, so, we need to push it now!
     ::util::Status status = VerifyChassisConfig(*config);
     if (!status.ok()) {
@@ -265,8 +434,20 @@ bool ContainsUniqueNames(const T& values) {
                             status.error_message());
     }
 
-    // Save running_chassis_config_ after everything went OK.
+    // Save running_chassis_config_ after everything went OK. The previous
+    // config is kept if the commit has to be confirmed.
+    std::unique_ptr<ChassisConfig> previous_config =
+        std::move(running_chassis_config_);
     running_chassis_config_.reset(config.PassOwnership());
+    AddRunningConfigToHistory();
+    if (commit_req.confirm_timeout_ms() > 0) {
+      status = StartPendingCommit(commit_req, std::move(previous_config));
+      if (!status.ok()) {
+        error_buffer_->AddError(
+            status, "Starting the chassis config commit failed: ", GTL_LOC);
+        return ToGrpcStatus(status);
+      }
+    }
 
     // Notify the gNMI GnmiPublisher that the config has changed.
     APPEND_STATUS_IF_ERROR(
@@ -283,10 +464,213 @@ bool ContainsUniqueNames(const T& values) {
   // Add data to SetResponse Object
   resp->mutable_prefix()->CopyFrom(req->prefix());
   resp->mutable_extension()->CopyFrom(req->extension());
+  if (has_commit_req || has_plan_req) {
+    GnmiExtension result_extension;
+    if (has_plan_req) {
+      *result_extension.mutable_plan_result() = plan;
+    } else {
+      CommitResult* result = result_extension.mutable_commit_result();
+      if (!config_history_.empty()) {
+        result->set_version(config_history_.back().version);
+      }
+      if (pending_commit_ != nullptr) {
+        result->set_confirm_deadline_ns(
+            absl::ToUnixNanos(pending_commit_->deadline));
+      }
+    }
+    auto* registered_ext = resp->add_extension()->mutable_registered_ext();
+    registered_ext->set_id(::gnmi_ext::EID_EXPERIMENTAL);
+    result_extension.SerializeToString(registered_ext->mutable_msg());
+  }
   resp->set_timestamp(absl::GetCurrentTimeNanos());
   return ::grpc::Status::OK;
 }
 
+::util::Status ConfigMonitoringService::PrepareCommit(
+    const ::gnmi::SetRequest& req, const CommitRequest& commit_req,
+    CopyOnWriteChassisConfig* config) {
+  const bool has_changes = HasChanges(req);
+  if (commit_req.confirm()) {
+    if (pending_commit_ == nullptr) {
+      return MAKE_ERROR(ERR_FAILED_PRECONDITION)
+             << "No chassis config commit is pending confirmation. It may "
+             << "have been rolled back already.";
+    }
+    LOG(INFO) << "Chassis config commit " << pending_commit_->commit_id
+              << " has been confirmed.";
+    // Dropping the pending commit cancels its rollback timer.
+    pending_commit_ = nullptr;
+  } else if (pending_commit_ != nullptr &&
+             (has_changes || commit_req.rollback_to_version() != 0)) {
+    return MAKE_ERROR(ERR_FAILED_PRECONDITION)
+           << "Chassis config commit " << pending_commit_->commit_id
+           << " is pending confirmation until "
+           << absl::FormatTime(pending_commit_->deadline)
+           << ". It must be confirmed before the config can be changed.";
+  }
+
+  if (commit_req.rollback_to_version() != 0) {
+    if (has_changes) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "A Set rolling back the chassis config cannot carry other "
+             << "changes.";
+    }
+    auto it = std::find_if(config_history_.begin(), config_history_.end(),
+                           [&commit_req](const ConfigVersion& entry) {
+                             return entry.version ==
+                                    commit_req.rollback_to_version();
+                           });
+    if (it == config_history_.end()) {
+      return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+             << "Chassis config version " << commit_req.rollback_to_version()
+             << " is not in the config history.";
+    }
+    LOG(INFO) << "Rolling back the chassis config to version " << it->version
+              << " pushed at " << absl::FormatTime(it->push_time) << ".";
+    *config->writable() = it->config;
+  }
+
+  if (commit_req.confirm_timeout_ms() > 0 &&
+      running_chassis_config_ == nullptr) {
+    return MAKE_ERROR(ERR_FAILED_PRECONDITION)
+           << "A chassis config commit cannot be confirmed when there is no "
+           << "previous config to roll back to.";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status ConfigMonitoringService::StartPendingCommit(
+    const CommitRequest& commit_req,
+    std::unique_ptr<ChassisConfig> previous_config) {
+  auto commit = absl::make_unique<PendingCommit>();
+  commit->commit_id = next_commit_id_++;
+  commit->deadline =
+      absl::Now() + absl::Milliseconds(commit_req.confirm_timeout_ms());
+  commit->previous_config = std::move(previous_config);
+  // The rollback runs on its own thread, where it blocks on config_lock_
+  // until this Set is complete.
+  const uint64 commit_id = commit->commit_id;
+  ::util::Status status = StartRollbackThread();
+  if (status.ok()) {
+    status = TimerDaemon::RequestOneShotTimer(
+        commit_req.confirm_timeout_ms(),
+        [this, commit_id]() { return ScheduleRollback(commit_id); },
+        &commit->timer);
+  }
+  if (!status.ok()) {
+    // The commit could never be rolled back without its timer or thread.
+    APPEND_STATUS_IF_ERROR(status,
+                           RestoreChassisConfig(*commit->previous_config));
+    return status;
+  }
+  LOG(INFO) << "Chassis config commit " << commit_id << " must be confirmed "
+            << "before " << absl::FormatTime(commit->deadline) << ".";
+  pending_commit_ = std::move(commit);
+
+  return ::util::OkStatus();
+}
+
+::util::Status ConfigMonitoringService::ScheduleRollback(uint64 commit_id) {
+  absl::MutexLock l(&rollback_lock_);
+  rollback_commit_ids_.push_back(commit_id);
+  rollback_cond_var_.Signal();
+
+  return ::util::OkStatus();
+}
+
+::util::Status ConfigMonitoringService::HandleCommitTimeout(uint64 commit_id) {
+  absl::WriterMutexLock l(&config_lock_);
+  if (pending_commit_ == nullptr || pending_commit_->commit_id != commit_id) {
+    // The commit has been confirmed while the timer was firing.
+    return ::util::OkStatus();
+  }
+  std::unique_ptr<PendingCommit> commit = std::move(pending_commit_);
+  LOG(WARNING) << "Chassis config commit " << commit_id << " has not been "
+               << "confirmed in time. Rolling back to the previous config.";
+  ::util::Status status = RestoreChassisConfig(*commit->previous_config);
+  if (!status.ok()) {
+    error_buffer_->AddError(
+        status, "Rolling back the unconfirmed chassis config failed: ",
+        GTL_LOC);
+  }
+
+  return status;
+}
+
+::util::Status ConfigMonitoringService::StartRollbackThread() {
+  absl::MutexLock l(&rollback_lock_);
+  if (rollback_thread_running_) return ::util::OkStatus();
+  int ret = pthread_create(&rollback_thread_id_, nullptr, RollbackThreadFunc,
+                           this);
+  if (ret != 0) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to create the chassis config rollback thread. Err: "
+           << ret << ".";
+  }
+  rollback_thread_running_ = true;
+
+  return ::util::OkStatus();
+}
+
+void ConfigMonitoringService::StopRollbackThread() {
+  {
+    absl::MutexLock l(&rollback_lock_);
+    if (!rollback_thread_running_) return;
+    rollback_thread_running_ = false;
+    rollback_commit_ids_.clear();
+    rollback_cond_var_.SignalAll();
+  }
+  pthread_join(rollback_thread_id_, nullptr);
+}
+
+void* ConfigMonitoringService::RollbackThreadFunc(void* arg) {
+  CHECK(arg != nullptr);
+  static_cast<ConfigMonitoringService*>(arg)->RollbackLoop();
+  return nullptr;
+}
+
+void ConfigMonitoringService::RollbackLoop() {
+  while (true) {
+    uint64 commit_id;
+    {
+      absl::MutexLock l(&rollback_lock_);
+      while (rollback_thread_running_ && rollback_commit_ids_.empty()) {
+        rollback_cond_var_.Wait(&rollback_lock_);
+      }
+      if (!rollback_thread_running_) break;
+      commit_id = rollback_commit_ids_.front();
+      rollback_commit_ids_.pop_front();
+    }
+    // Failures are reported to the error buffer by HandleCommitTimeout().
+    HandleCommitTimeout(commit_id).IgnoreError();
+  }
+}
+
+::util::Status ConfigMonitoringService::RestoreChassisConfig(
+    const ChassisConfig& config) {
+  ::util::Status status = switch_interface_->PushChassisConfig(config);
+  if (status.ok() || status.error_code() == ERR_REBOOT_REQUIRED) {
+    APPEND_STATUS_IF_ERROR(
+        status, WriteProtoToTextFile(config, FLAGS_chassis_config_file));
+  }
+  RETURN_IF_ERROR(status);
+  running_chassis_config_ = absl::make_unique<ChassisConfig>(config);
+  AddRunningConfigToHistory();
+
+  return gnmi_publisher_.HandleChange(
+      ConfigHasBeenPushedEvent(*running_chassis_config_));
+}
+
+void ConfigMonitoringService::AddRunningConfigToHistory() {
+  config_history_.push_back(
+      {next_config_version_++, absl::Now(), *running_chassis_config_});
+  const size_t max_size = std::max(FLAGS_gnmi_config_history_size, 1);
+  while (config_history_.size() > max_size) {
+    config_history_.pop_front();
+  }
+}
+
 ::grpc::Status ConfigMonitoringService::Get(::grpc::ServerContext* context,
                                             const ::gnmi::GetRequest* req,
                                             ::gnmi::GetResponse* resp) {
@@ -309,6 +693,38 @@ bool ContainsUniqueNames(const T& values) {
                           "Get response can only be encoded as PROTO.");
   }
 
+  // Past values of the paths are retrieved from the telemetry history.
+  std::unique_ptr<TelemetryHistoryRequest> history_req =
+      FindTelemetryHistoryRequest(*req);
+  if (history_req != nullptr) {
+    if (telemetry_history_ == nullptr) {
+      return ::grpc::Status(::grpc::StatusCode::UNAVAILABLE,
+                            "The telemetry history is disabled.");
+    }
+    for (const auto& path : req->path()) {
+      VLOG(1) << "GET history: " << path.ShortDebugString();
+      auto notifications = QueryTelemetryHistory(telemetry_history_.get(),
+                                                 *history_req, path);
+      if (!notifications.ok()) {
+        return ::grpc::Status(
+            ToGrpcCode(notifications.status().CanonicalCode()),
+            notifications.status().error_message());
+      }
+      for (auto& notification : notifications.ValueOrDie()) {
+        *resp->add_notification() = std::move(notification);
+      }
+    }
+    if (history_req->flush_to_file()) {
+      ::util::Status status =
+          telemetry_history_->FlushToFile(FLAGS_gnmi_history_file);
+      if (!status.ok()) {
+        return ::grpc::Status(ToGrpcCode(status.CanonicalCode()),
+                              status.error_message());
+      }
+    }
+    return ::grpc::Status::OK;
+  }
+
   for (const auto& path : req->path()) {
     VLOG(1) << "GET: " << path.ShortDebugString();
     if (path == GetPath()()) {
@@ -392,8 +808,37 @@ void ReportError(const std::string& msg,
 
 constexpr int kThousandMilliseconds = 1000 /* milliseconds */;
 
+// Sends the values of the subscribed paths recorded in the telemetry history,
+// for a ONCE subscription carrying a telemetry history request.
+void HandleTelemetryHistorySubscribeRequest(
+    const TelemetryHistory* history, const TelemetryHistoryRequest& history_req,
+    const ::gnmi::SubscribeRequest& req,
+    ServerSubscribeReaderWriterInterface* stream) {
+  if (req.subscribe().mode() != ::gnmi::SubscriptionList::ONCE) {
+    ReportError("Telemetry history is only supported in ONCE mode.", stream);
+    return;
+  }
+  for (const auto& subscription : req.subscribe().subscription()) {
+    auto notifications =
+        QueryTelemetryHistory(history, history_req, subscription.path());
+    if (!notifications.ok()) {
+      ReportError(notifications.status().ToString(), stream);
+      return;
+    }
+    for (auto& notification : notifications.ValueOrDie()) {
+      ::gnmi::SubscribeResponse resp;
+      *resp.mutable_update() = std::move(notification);
+      if (!stream->Write(resp, ::grpc::WriteOptions())) return;
+    }
+  }
+  ::gnmi::SubscribeResponse resp;
+  resp.set_sync_response(true);
+  stream->Write(resp, ::grpc::WriteOptions());
+}
+
 ::util::Status HandleInitialSubscribeRequest(
-    GnmiPublisher* publisher, ::grpc::ServerContext* context,
+    GnmiPublisher* publisher, const TelemetryHistory* history,
+    ::grpc::ServerContext* context,
     ServerSubscribeReaderWriterInterface* stream,
     PathToHandleMap* subscriptions, PathToHandleMap* polls) {
   // Setting send_sync_response to `true` triggers sending a notification to the
@@ -420,7 +865,20 @@ constexpr int kThousandMilliseconds = 1000 /* milliseconds */;
   LOG(INFO) << "Initial Subscribe request from " << uri << " over stream "
             << stream << ".";
   VLOG(1) << "SubscribeRequest: " << req.ShortDebugString();
+  std::unique_ptr<TelemetryHistoryRequest> history_req =
+      FindTelemetryHistoryRequest(req);
+  if (history_req != nullptr) {
+    HandleTelemetryHistorySubscribeRequest(history, *history_req, req, stream);
+    return ::util::OkStatus();
+  }
   int problems_found = 0;
+  // With updates_only, the current state of the paths is not sent. Only the
+  // sync_response is sent right away, followed by the updates.
+  const bool updates_only = req.subscribe().updates_only();
+  if (updates_only &&
+      req.subscribe().mode() != ::gnmi::SubscriptionList::POLL) {
+    send_sync_response = true;
+  }
   for (::gnmi::Subscription subscription : req.subscribe().subscription()) {
     // Note that 'subscription' is a non-const copy of the one stored in the
     // 'req' request. It has to be non-const in case it is a TARGET_DEFINED
@@ -455,12 +913,15 @@ constexpr int kThousandMilliseconds = 1000 /* milliseconds */;
         uint64 heartbeat_interval = subscription.heartbeat_interval() == 0
                                         ? kThousandMilliseconds
                                         : subscription.heartbeat_interval();
+        // The first sample would be the current state.
+        uint64 delay = updates_only ? sample_interval : 0;
         if (!subscription.suppress_redundant()) {
           status = publisher->SubscribePeriodic(
-              Periodic(sample_interval), subscription.path(), stream, &h);
+              Periodic(sample_interval, delay), subscription.path(), stream,
+              &h);
         } else {
           status = publisher->SubscribePeriodic(
-              PeriodicWithHeartbeat(sample_interval, heartbeat_interval),
+              PeriodicWithHeartbeat(sample_interval, heartbeat_interval, delay),
               subscription.path(), stream, &h);
         }
         if (status == ::util::OkStatus()) {
@@ -478,7 +939,8 @@ constexpr int kThousandMilliseconds = 1000 /* milliseconds */;
           (*subscriptions)[subscription.path()] = h;
           // In ON_CHANGE subscription mode, before any updates can be sent, the
           // switch has to sent the current state of the leaf/node, so, prepare
-          // and transmit the data.
+          // and transmit the data. Unless the client asked for updates only.
+          if (updates_only) continue;
           if (publisher->SubscribePoll(subscription.path(), stream, &h) !=
               ::util::OkStatus()) {
             // Report error.
@@ -526,7 +988,9 @@ constexpr int kThousandMilliseconds = 1000 /* milliseconds */;
       // A one-shot request.
       if (publisher->SubscribePoll(subscription.path(), stream, &h) ==
           ::util::OkStatus()) {
-        // Prepare and transmit the data.
+        // Prepare and transmit the data. With updates_only, there is nothing
+        // but the sync_response to send.
+        if (updates_only) continue;
         if (publisher->HandlePoll(h) != ::util::OkStatus()) {
           ReportError("Error while executing ONCE.", stream);
           ++problems_found;
@@ -567,8 +1031,9 @@ constexpr int kThousandMilliseconds = 1000 /* milliseconds */;
   ::util::Status status;
   // First process the subscription request. According to the spec there can be
   // only one!
-  if ((status = HandleInitialSubscribeRequest(publisher, context, stream,
-                                              &subscriptions, &polls)) !=
+  if ((status = HandleInitialSubscribeRequest(
+           publisher, telemetry_history_.get(), context, stream,
+           &subscriptions, &polls)) !=
       ::util::OkStatus()) {
     return ::grpc::Status(::grpc::StatusCode::INTERNAL, status.ToString());
   }
@@ -5,10 +5,14 @@
 #ifndef STRATUM_HAL_LIB_COMMON_CONFIG_MONITORING_SERVICE_H_
 #define STRATUM_HAL_LIB_COMMON_CONFIG_MONITORING_SERVICE_H_
 
+#include <pthread.h>
+
+#include <deque>
 #include <memory>
 
 #include "absl/base/thread_annotations.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "gnmi/gnmi.grpc.pb.h"
 #include "grpcpp/grpcpp.h"
 #include "stratum/glue/integral_types.h"
@@ -17,7 +21,10 @@
 #include "stratum/hal/lib/common/error_buffer.h"
 #include "stratum/hal/lib/common/gnmi_publisher.h"
 #include "stratum/hal/lib/common/switch_interface.h"
+#include "stratum/hal/lib/common/telemetry_history.h"
 #include "stratum/lib/security/auth_policy_checker.h"
+#include "stratum/lib/timer_daemon.h"
+#include "stratum/public/proto/gnmi_extensions.pb.h"
 
 namespace stratum {
 namespace hal {
@@ -49,6 +56,10 @@ class ConfigMonitoringService final : public ::gnmi::gNMI::Service {
   // not alter any state on the hardware when called.
   ::util::Status Teardown() LOCKS_EXCLUDED(config_lock_);
 
+  // Sets the function used to publish the entry quota usage of the P4 roles,
+  // which is tracked by P4Service, over gNMI.
+  void SetEntryQuotaUsageReader(EntryQuotaUsageReader reader);
+
   // Public helper function called in Setup(). It deserializes the contents
   // of the FLAGS_chassis_config_file file and calls PushChassisConfig().
   ::util::Status PushSavedChassisConfig(bool warmboot);
@@ -135,9 +146,104 @@ class ConfigMonitoringService final : public ::gnmi::gNMI::Service {
                        const ::gnmi::SetRequest* req, ::gnmi::SetResponse* resp)
       LOCKS_EXCLUDED(config_lock_);
 
+  // A ChassisConfig pushed to the switch, as saved in the config history.
+  struct ConfigVersion {
+    uint64 version;
+    absl::Time push_time;
+    ChassisConfig config;
+  };
+
+  // A commit which is rolled back unless confirmed before its deadline.
+  struct PendingCommit {
+    uint64 commit_id;
+    absl::Time deadline;
+    // The running config before the commit, restored on rollback.
+    std::unique_ptr<ChassisConfig> previous_config;
+    // Fires the rollback at the deadline. Cancelled when reset.
+    TimerDaemon::DescriptorPtr timer;
+  };
+
+  // Handles the CommitRequest of a Set before the changes of the Set are
+  // applied. Confirms the pending commit if requested and rejects changes
+  // while a commit is pending. For a manual rollback, loads the requested
+  // config version into 'config'.
+  ::util::Status PrepareCommit(const ::gnmi::SetRequest& req,
+                               const CommitRequest& commit_req,
+                               CopyOnWriteChassisConfig* config)
+      EXCLUSIVE_LOCKS_REQUIRED(config_lock_);
+
+  // Starts the confirm timer of a commit-confirmed Set which has just replaced
+  // 'previous_config' as the running config.
+  ::util::Status StartPendingCommit(const CommitRequest& commit_req,
+                                    std::unique_ptr<ChassisConfig>
+                                        previous_config)
+      EXCLUSIVE_LOCKS_REQUIRED(config_lock_);
+
+  // Called by the confirm timer of the given commit. Only hands the rollback
+  // over to the rollback thread, so that the TimerDaemon thread shared by all
+  // the timers never waits on config_lock_ or on the switch.
+  ::util::Status ScheduleRollback(uint64 commit_id)
+      LOCKS_EXCLUDED(rollback_lock_);
+
+  // Called by the rollback thread for a commit whose confirm timer fired.
+  // Restores the config saved before the commit, unless the commit has been
+  // confirmed or cancelled in the meantime.
+  ::util::Status HandleCommitTimeout(uint64 commit_id)
+      LOCKS_EXCLUDED(config_lock_);
+
+  // Starts the rollback thread if it is not running yet.
+  ::util::Status StartRollbackThread() LOCKS_EXCLUDED(rollback_lock_);
+
+  // Stops the rollback thread, if running, and waits for it to exit. Any
+  // scheduled rollback which has not started yet is dropped.
+  void StopRollbackThread() LOCKS_EXCLUDED(config_lock_, rollback_lock_);
+
+  // Thread function for the rollback thread. Invoked with "this" as the
+  // argument in pthread_create.
+  static void* RollbackThreadFunc(void* arg);
+
+  // Waits for scheduled rollbacks and runs them one at a time. Runs until
+  // StopRollbackThread() is called. Called by RollbackThreadFunc.
+  void RollbackLoop() LOCKS_EXCLUDED(config_lock_, rollback_lock_);
+
+  // Pushes a config saved by this class back to the switch and to the
+  // FLAGS_chassis_config_file file, and makes it the running config.
+  ::util::Status RestoreChassisConfig(const ChassisConfig& config)
+      EXCLUSIVE_LOCKS_REQUIRED(config_lock_);
+
+  // Saves the running config as a new version in the config history.
+  void AddRunningConfigToHistory() EXCLUSIVE_LOCKS_REQUIRED(config_lock_);
+
   // Mutex lock for protecting the internal chassis config pushed to the switch.
   mutable absl::Mutex config_lock_;
 
+  // The configs recently pushed to the switch, oldest first. The last one is
+  // the running config. At most FLAGS_gnmi_config_history_size are kept.
+  std::deque<ConfigVersion> config_history_ GUARDED_BY(config_lock_);
+
+  // The version given to the next config added to config_history_.
+  uint64 next_config_version_ GUARDED_BY(config_lock_);
+
+  // The commit waiting for confirmation, or nullptr if there is none.
+  std::unique_ptr<PendingCommit> pending_commit_ GUARDED_BY(config_lock_);
+
+  // The ID given to the next commit-confirmed Set.
+  uint64 next_commit_id_ GUARDED_BY(config_lock_);
+
+  // Mutex and CondVar protecting the state shared with the rollback thread.
+  // Never held while acquiring config_lock_.
+  absl::Mutex rollback_lock_ ACQUIRED_AFTER(config_lock_);
+  absl::CondVar rollback_cond_var_;
+
+  // IDs of the commits whose confirm timer fired, in firing order.
+  std::deque<uint64> rollback_commit_ids_ GUARDED_BY(rollback_lock_);
+
+  // Set while the rollback thread is running. Cleared to ask it to exit.
+  bool rollback_thread_running_ GUARDED_BY(rollback_lock_);
+
+  // The rollback thread, started with the first commit-confirmed Set.
+  pthread_t rollback_thread_id_;
+
   // Hold the ChassisConfig which is currently running on the switch.
   std::unique_ptr<ChassisConfig> running_chassis_config_
       GUARDED_BY(config_lock_);
@@ -166,6 +272,10 @@ class ConfigMonitoringService final : public ::gnmi::gNMI::Service {
   // An object handling gNMI Subscribe, Set and Get requests.
   GnmiPublisher gnmi_publisher_;
 
+  // The on-box history of the values of the gNMI paths given by flags, or
+  // nullptr if disabled.
+  std::unique_ptr<TelemetryHistory> telemetry_history_;
+
   friend class ConfigMonitoringServiceTest;
 };
 
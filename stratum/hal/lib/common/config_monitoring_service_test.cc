@@ -6,10 +6,14 @@
 
 #include <memory>
 #include <string>
+#include <thread>  // NOLINT
 
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
 #include "gflags/gflags.h"
 #include "gmock/gmock.h"
 #include "google/protobuf/text_format.h"
@@ -23,13 +27,16 @@
 #include "stratum/hal/lib/common/gnmi_publisher_mock.h"
 #include "stratum/hal/lib/common/subscribe_reader_writer_mock.h"
 #include "stratum/hal/lib/common/switch_mock.h"
+#include "stratum/lib/constants.h"
 #include "stratum/lib/security/auth_policy_checker_mock.h"
 #include "stratum/lib/test_utils/matchers.h"
 #include "stratum/lib/utils.h"
 #include "stratum/public/lib/error.h"
+#include "stratum/public/proto/gnmi_extensions.pb.h"
 
 DECLARE_string(chassis_config_file);
 DECLARE_string(gnmi_capabilities_file);
+DECLARE_string(gnmi_history_paths);
 DECLARE_string(test_tmpdir);
 
 namespace stratum {
@@ -40,6 +47,7 @@ using ::testing::DoAll;
 using ::testing::HasSubstr;
 using ::testing::Invoke;
 using ::testing::NiceMock;
+using ::testing::Not;
 using ::testing::Return;
 using ::testing::SaveArg;
 using ::testing::SetArgPointee;
@@ -55,6 +63,7 @@ class ConfigMonitoringServiceTest
   void SetUp() override {
     FLAGS_chassis_config_file = FLAGS_test_tmpdir + "/config.pb.txt";
     FLAGS_gnmi_capabilities_file = "stratum/hal/lib/common/gnmi_caps.pb.txt";
+    FLAGS_gnmi_history_paths = "";
     mode_ = GetParam();
     switch_mock_ = absl::make_unique<SwitchMock>();
     auth_policy_checker_mock_ = absl::make_unique<AuthPolicyCheckerMock>();
@@ -88,6 +97,20 @@ class ConfigMonitoringServiceTest
     }
   }
 
+  // Re-creates the service with the telemetry history sampling the given
+  // paths.
+  void EnableTelemetryHistory(const std::string& paths) {
+    FLAGS_gnmi_history_paths = paths;
+    config_monitoring_service_ = absl::make_unique<ConfigMonitoringService>(
+        mode_, switch_mock_.get(), auth_policy_checker_mock_.get(),
+        error_buffer_.get());
+  }
+
+  // Returns the telemetry history of the service.
+  TelemetryHistory* GetTelemetryHistory() {
+    return config_monitoring_service_->telemetry_history_.get();
+  }
+
   // A proxy to private method of ConfigMonitoringService class.
   ::grpc::Status DoSubscribe(::grpc::ServerContext* context,
                              ServerSubscribeReaderWriterInterface* stream) {
@@ -95,6 +118,13 @@ class ConfigMonitoringServiceTest
                                                    context, stream);
   }
 
+  // A proxy to private method of ConfigMonitoringService class.
+  ::grpc::Status DoSubscribe(GnmiPublisher* publisher,
+                             ::grpc::ServerContext* context,
+                             ServerSubscribeReaderWriterInterface* stream) {
+    return config_monitoring_service_->DoSubscribe(publisher, context, stream);
+  }
+
   // A proxy to private method of ConfigMonitoringService class.
   ::grpc::Status DoGet(::grpc::ServerContext* context,
                        const ::gnmi::GetRequest* req,
@@ -109,6 +139,73 @@ class ConfigMonitoringServiceTest
     return config_monitoring_service_->DoSet(context, req, resp);
   }
 
+  // A proxy to private method of ConfigMonitoringService class.
+  ::util::Status HandleCommitTimeout(uint64 commit_id) {
+    return config_monitoring_service_->HandleCommitTimeout(commit_id);
+  }
+
+  // Returns the ID of the commit pending confirmation, or 0 if there is none.
+  uint64 GetPendingCommitId() {
+    absl::ReaderMutexLock l(&config_monitoring_service_->config_lock_);
+    if (config_monitoring_service_->pending_commit_ == nullptr) return 0;
+    return config_monitoring_service_->pending_commit_->commit_id;
+  }
+
+  // Fills a Set request replacing the whole config by the test device.
+  void FillReplaceRequest(::gnmi::SetRequest* req) {
+    openconfig::Device device;
+    ASSERT_OK(ReadProtoFromTextFile(
+        "stratum/hal/lib/common/testdata/simple_oc_device.pb.txt", &device));
+    std::string msg_bytes;
+    ASSERT_TRUE(device.SerializeToString(&msg_bytes));
+    req->add_replace()->mutable_val()->set_bytes_val(msg_bytes);
+  }
+
+  // Adds the given commit request as an extension of a Set request.
+  void AddCommitRequest(const CommitRequest& commit_req,
+                        ::gnmi::SetRequest* req) {
+    GnmiExtension extension;
+    *extension.mutable_commit() = commit_req;
+    auto* registered_ext = req->add_extension()->mutable_registered_ext();
+    registered_ext->set_id(::gnmi_ext::EID_EXPERIMENTAL);
+    ASSERT_TRUE(extension.SerializeToString(registered_ext->mutable_msg()));
+  }
+
+  // Adds a plan request as an extension of a Set request.
+  void AddPlanRequest(::gnmi::SetRequest* req) {
+    GnmiExtension extension;
+    extension.mutable_plan();
+    auto* registered_ext = req->add_extension()->mutable_registered_ext();
+    registered_ext->set_id(::gnmi_ext::EID_EXPERIMENTAL);
+    ASSERT_TRUE(extension.SerializeToString(registered_ext->mutable_msg()));
+  }
+
+  // Returns the plan result added to the extensions of a Set response.
+  ChassisConfigPlan GetPlanResult(const ::gnmi::SetResponse& resp) {
+    for (const auto& extension : resp.extension()) {
+      GnmiExtension gnmi_extension;
+      if (gnmi_extension.ParseFromString(extension.registered_ext().msg()) &&
+          gnmi_extension.has_plan_result()) {
+        return gnmi_extension.plan_result();
+      }
+    }
+    ADD_FAILURE() << "No plan result in " << resp.ShortDebugString();
+    return ChassisConfigPlan();
+  }
+
+  // Returns the commit result added to the extensions of a Set response.
+  CommitResult GetCommitResult(const ::gnmi::SetResponse& resp) {
+    for (const auto& extension : resp.extension()) {
+      GnmiExtension gnmi_extension;
+      if (gnmi_extension.ParseFromString(extension.registered_ext().msg()) &&
+          gnmi_extension.has_commit_result()) {
+        return gnmi_extension.commit_result();
+      }
+    }
+    ADD_FAILURE() << "No commit result in " << resp.ShortDebugString();
+    return CommitResult();
+  }
+
   // A proxy to private method of ConfigMonitoringService class.
   ::grpc::Status DoCapabilities(::grpc::ServerContext* context,
                                 const ::gnmi::CapabilityRequest* req,
@@ -692,6 +789,123 @@ TEST_P(ConfigMonitoringServiceTest, SubscribeOnChangeWithInitialValueSuccess) {
   EXPECT_TRUE(resp.sync_response());
 }
 
+// With updates_only, only the sync_response is sent upon subscription, without
+// retrieving the current state of the subscribed leaves of all the ports.
+TEST_P(ConfigMonitoringServiceTest, SubscribeOnChangeUpdatesOnly) {
+  constexpr int kNumPorts = 1024;
+  ChassisConfig config;
+  config.mutable_chassis()->set_name("device1.domain.net.com");
+  config.add_nodes()->set_id(kNodeId1);
+  for (int i = 1; i <= kNumPorts; ++i) {
+    auto* port = config.add_singleton_ports();
+    port->set_id(i);
+    port->set_name(absl::StrCat("device1.domain.net.com:ce-1/", i));
+    port->set_slot(1);
+    port->set_port(i);
+    port->set_speed_bps(kHundredGigBps);
+    port->set_node(kNodeId1);
+  }
+  GnmiPublisher publisher(switch_mock_.get());
+  ASSERT_OK(publisher.HandleChange(ConfigHasBeenPushedEvent(config)));
+
+  ::gnmi::SubscribeRequest req;
+  constexpr char kReq[] = R"pb(
+  subscribe {
+    mode: STREAM
+    subscription {
+      path {
+        elem { name: "interfaces" }
+        elem { name: "interface" key { key: "name" value: "*" } }
+        elem { name: "..." }
+        elem { name: "oper-status" }
+      }
+      mode: ON_CHANGE
+    }
+  }
+  )pb";
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(kReq, &req))
+      << "Failed to parse proto from the following string: " << kReq;
+
+  // Without updates_only, the state of every port is retrieved and sent,
+  // followed by the sync_response.
+  {
+    SubscribeReaderWriterMock stream;
+    ::grpc::ServerContext context;
+    EXPECT_CALL(stream, Read(_))
+        .WillOnce(DoAll(SetArgPointee<0>(req), Return(true)))
+        .WillOnce(Return(false));
+    int num_updates = 0;
+    ::gnmi::SubscribeResponse resp;
+    EXPECT_CALL(stream, Write(_, _))
+        .WillRepeatedly(DoAll(SaveArg<0>(&resp),
+                              Invoke([&num_updates](
+                                         const ::gnmi::SubscribeResponse& r,
+                                         ::grpc::WriteOptions) {
+                                if (r.has_update()) ++num_updates;
+                              }),
+                              Return(true)));
+    EXPECT_CALL(*switch_mock_, RetrieveValue(_, _, _, _))
+        .Times(kNumPorts)
+        .WillRepeatedly(Return(::util::OkStatus()));
+    EXPECT_TRUE(DoSubscribe(&publisher, &context, &stream).ok());
+    EXPECT_EQ(kNumPorts, num_updates);
+    EXPECT_TRUE(resp.sync_response());
+  }
+  ::testing::Mock::VerifyAndClearExpectations(switch_mock_.get());
+
+  // With updates_only, only the sync_response is sent.
+  req.mutable_subscribe()->set_updates_only(true);
+  {
+    SubscribeReaderWriterMock stream;
+    ::grpc::ServerContext context;
+    EXPECT_CALL(stream, Read(_))
+        .WillOnce(DoAll(SetArgPointee<0>(req), Return(true)))
+        .WillOnce(Return(false));
+    ::gnmi::SubscribeResponse resp;
+    EXPECT_CALL(stream, Write(_, _))
+        .WillOnce(DoAll(SaveArg<0>(&resp), Return(true)));
+    EXPECT_CALL(*switch_mock_, RetrieveValue(_, _, _, _)).Times(0);
+    EXPECT_TRUE(DoSubscribe(&publisher, &context, &stream).ok());
+    EXPECT_TRUE(resp.sync_response());
+  }
+}
+
+// With updates_only, a ONCE subscription only gets the sync_response.
+TEST_P(ConfigMonitoringServiceTest, SubscribeOnceUpdatesOnly) {
+  SubscribeReaderWriterMock stream;
+  ::grpc::ServerContext context;
+
+  ::gnmi::SubscribeRequest req;
+  constexpr char kReq[] = R"pb(
+  subscribe {
+    mode: ONCE
+    updates_only: true
+    subscription {
+      path {
+        elem { name: "interfaces" }
+        elem { name: "interface" key { key: "name" value: "*" } }
+      }
+    }
+  }
+  )pb";
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(kReq, &req))
+      << "Failed to parse proto from the following string: " << kReq;
+  EXPECT_CALL(stream, Read(_))
+      .WillOnce(DoAll(SetArgPointee<0>(req), Return(true)))
+      .WillOnce(Return(false));
+
+  // The path is checked, but not polled.
+  EXPECT_CALL(*gnmi_publisher_, SubscribePoll(_, _, _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*gnmi_publisher_, HandlePoll(_)).Times(0);
+  ::gnmi::SubscribeResponse resp;
+  EXPECT_CALL(stream, Write(_, _))
+      .WillOnce(DoAll(SaveArg<0>(&resp), Return(true)));
+
+  EXPECT_TRUE(DoSubscribe(&context, &stream).ok());
+  EXPECT_TRUE(resp.sync_response());
+}
+
 TEST_P(ConfigMonitoringServiceTest, CheckConvertTargetDefinedToOnChange) {
   SubscribeReaderWriterMock stream;
   ::grpc::ServerContext context;
@@ -870,6 +1084,107 @@ TEST_P(ConfigMonitoringServiceTest, GnmiGetRootConfig) {
   EXPECT_TRUE(resp.notification(0).update(0).path() == GetPath()());
 }
 
+// DoGet() returns the recorded values when given a telemetry history request.
+TEST_P(ConfigMonitoringServiceTest, GnmiGetTelemetryHistory) {
+  if (mode_ == OPERATION_MODE_COUPLED) return;
+
+  EnableTelemetryHistory(
+      "/interfaces/interface[name=*]/state/counters/in-octets");
+  ChassisConfig config;
+  FillTestChassisConfigAndSave(&config);
+  ASSERT_OK(config_monitoring_service_->Setup(false));
+  ASSERT_NE(nullptr, GetTelemetryHistory());
+
+  // Record 10 samples, one every second.
+  const ::gnmi::Path path = GetPath("interfaces")(
+      "interface", "device1.domain.net.com:ce-1/1")("state")("counters")(
+      "in-octets")();
+  const absl::Time start = absl::FromUnixSeconds(1600000000);
+  for (int i = 0; i < 10; ++i) {
+    ::gnmi::Notification notification;
+    notification.set_timestamp(absl::ToUnixNanos(start + absl::Seconds(i)));
+    auto* update = notification.add_update();
+    *update->mutable_path() = path;
+    update->mutable_val()->set_uint_val(100 * i);
+    GetTelemetryHistory()->Record({notification});
+  }
+
+  // Ask for the samples recorded between 2s and 4s.
+  GnmiExtension extension;
+  extension.mutable_history()->set_start_time_ns(
+      absl::ToUnixNanos(start + absl::Seconds(2)));
+  extension.mutable_history()->set_end_time_ns(
+      absl::ToUnixNanos(start + absl::Seconds(4)));
+  ::gnmi::GetRequest req;
+  *req.add_path() = path;
+  req.set_type(::gnmi::GetRequest::STATE);
+  req.set_encoding(::gnmi::Encoding::PROTO);
+  auto* registered_ext = req.add_extension()->mutable_registered_ext();
+  registered_ext->set_id(::gnmi_ext::EID_EXPERIMENTAL);
+  ASSERT_TRUE(extension.SerializeToString(registered_ext->mutable_msg()));
+
+  ::grpc::ServerContext context;
+  ::gnmi::GetResponse resp;
+  auto grpc_status = DoGet(&context, &req, &resp);
+  ASSERT_TRUE(grpc_status.ok()) << grpc_status.error_message();
+  ASSERT_EQ(3, resp.notification_size());
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(absl::ToUnixNanos(start + absl::Seconds(2 + i)),
+              resp.notification(i).timestamp());
+    EXPECT_THAT(resp.notification(i).update(0).path(), EqualsProto(path));
+    EXPECT_EQ(100 * (2 + i), resp.notification(i).update(0).val().uint_val());
+  }
+}
+
+// DoGet() should fail if given a telemetry history request while the history
+// is disabled.
+TEST_P(ConfigMonitoringServiceTest, GnmiGetTelemetryHistoryDisabled) {
+  if (mode_ == OPERATION_MODE_COUPLED) return;
+
+  ChassisConfig config;
+  FillTestChassisConfigAndSave(&config);
+  ASSERT_OK(config_monitoring_service_->Setup(false));
+
+  GnmiExtension extension;
+  extension.mutable_history();
+  ::gnmi::GetRequest req;
+  *req.add_path() = GetPath("interfaces")("interface", "*")();
+  req.set_encoding(::gnmi::Encoding::PROTO);
+  auto* registered_ext = req.add_extension()->mutable_registered_ext();
+  registered_ext->set_id(::gnmi_ext::EID_EXPERIMENTAL);
+  ASSERT_TRUE(extension.SerializeToString(registered_ext->mutable_msg()));
+
+  ::grpc::ServerContext context;
+  ::gnmi::GetResponse resp;
+  EXPECT_EQ(::grpc::StatusCode::UNAVAILABLE,
+            DoGet(&context, &req, &resp).error_code());
+}
+
+// A request to flush the telemetry history without any path should fail
+// cleanly while the history is disabled.
+TEST_P(ConfigMonitoringServiceTest, GnmiGetFlushTelemetryHistoryDisabled) {
+  if (mode_ == OPERATION_MODE_COUPLED) return;
+
+  ChassisConfig config;
+  FillTestChassisConfigAndSave(&config);
+  ASSERT_OK(config_monitoring_service_->Setup(false));
+  ASSERT_EQ(nullptr, GetTelemetryHistory());
+
+  GnmiExtension extension;
+  extension.mutable_history()->set_flush_to_file(true);
+  ::gnmi::GetRequest req;
+  req.set_encoding(::gnmi::Encoding::PROTO);
+  auto* registered_ext = req.add_extension()->mutable_registered_ext();
+  registered_ext->set_id(::gnmi_ext::EID_EXPERIMENTAL);
+  ASSERT_TRUE(extension.SerializeToString(registered_ext->mutable_msg()));
+
+  ::grpc::ServerContext context;
+  ::gnmi::GetResponse resp;
+  ::grpc::Status status = DoGet(&context, &req, &resp);
+  EXPECT_EQ(::grpc::StatusCode::UNAVAILABLE, status.error_code());
+  EXPECT_EQ(0, resp.notification_size());
+}
+
 // DoGet() should fail if requested to handle not-existent path.
 TEST_P(ConfigMonitoringServiceTest, GnmiGetBlah) {
   if (mode_ == OPERATION_MODE_COUPLED) return;
@@ -1173,6 +1488,340 @@ TEST_P(ConfigMonitoringServiceTest,
   ASSERT_OK(config_monitoring_service_->Teardown());
 }
 
+// A commit-confirmed Set is kept once confirmed.
+TEST_P(ConfigMonitoringServiceTest, GnmiSetCommitConfirmed) {
+  if (mode_ == OPERATION_MODE_COUPLED) return;
+
+  ChassisConfig config;
+  FillTestChassisConfigAndSave(&config);
+  EXPECT_CALL(*switch_mock_, RegisterEventNotifyWriter(_))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, PushChassisConfig(_))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(config_monitoring_service_->Setup(false));
+
+  // The new config is pushed once and not rolled back.
+  ::gnmi::SetRequest req;
+  FillReplaceRequest(&req);
+  CommitRequest commit_req;
+  commit_req.set_confirm_timeout_ms(60000);
+  AddCommitRequest(commit_req, &req);
+  ChassisConfig new_config;
+  EXPECT_CALL(*switch_mock_, PushChassisConfig(_))
+      .WillOnce(DoAll(SaveArg<0>(&new_config), Return(::util::OkStatus())));
+  ::grpc::ServerContext context;
+  ::gnmi::SetResponse resp;
+  auto grpc_status = DoSet(&context, &req, &resp);
+  ASSERT_TRUE(grpc_status.ok()) << grpc_status.error_message();
+  CommitResult result = GetCommitResult(resp);
+  EXPECT_EQ(2U, result.version());
+  EXPECT_GT(result.confirm_deadline_ns(), absl::GetCurrentTimeNanos());
+  const uint64 commit_id = GetPendingCommitId();
+  EXPECT_NE(0U, commit_id);
+
+  ::gnmi::SetRequest confirm_req;
+  commit_req.Clear();
+  commit_req.set_confirm(true);
+  AddCommitRequest(commit_req, &confirm_req);
+  ::gnmi::SetResponse confirm_resp;
+  grpc_status = DoSet(&context, &confirm_req, &confirm_resp);
+  ASSERT_TRUE(grpc_status.ok()) << grpc_status.error_message();
+  EXPECT_EQ(0, GetCommitResult(confirm_resp).confirm_deadline_ns());
+  EXPECT_EQ(0U, GetPendingCommitId());
+
+  // A late timeout of the confirmed commit does nothing.
+  EXPECT_OK(HandleCommitTimeout(commit_id));
+  CheckRunningChassisConfig(&new_config);
+
+  // A second confirm has no commit to confirm.
+  ::gnmi::SetResponse second_confirm_resp;
+  grpc_status = DoSet(&context, &confirm_req, &second_confirm_resp);
+  EXPECT_EQ(::grpc::StatusCode::FAILED_PRECONDITION, grpc_status.error_code());
+
+  // Clean-up.
+  EXPECT_CALL(*switch_mock_, UnregisterEventNotifyWriter())
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(config_monitoring_service_->Teardown());
+}
+
+// A commit-confirmed Set is rolled back if not confirmed in time.
+TEST_P(ConfigMonitoringServiceTest, GnmiSetCommitConfirmedTimeout) {
+  if (mode_ == OPERATION_MODE_COUPLED) return;
+
+  ChassisConfig config;
+  FillTestChassisConfigAndSave(&config);
+  EXPECT_CALL(*switch_mock_, RegisterEventNotifyWriter(_))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, PushChassisConfig(_))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(config_monitoring_service_->Setup(false));
+
+  // The saved config is pushed again by the rollback timer.
+  absl::Notification rolled_back;
+  EXPECT_CALL(*switch_mock_, PushChassisConfig(EqualsProto(config)))
+      .WillOnce(DoAll(Invoke([&rolled_back](const ChassisConfig&) {
+                        rolled_back.Notify();
+                      }),
+                      Return(::util::OkStatus())));
+  EXPECT_CALL(*switch_mock_, PushChassisConfig(Not(EqualsProto(config))))
+      .WillOnce(Return(::util::OkStatus()));
+  ::gnmi::SetRequest req;
+  FillReplaceRequest(&req);
+  CommitRequest commit_req;
+  commit_req.set_confirm_timeout_ms(10);
+  AddCommitRequest(commit_req, &req);
+  ::grpc::ServerContext context;
+  ::gnmi::SetResponse resp;
+  auto grpc_status = DoSet(&context, &req, &resp);
+  ASSERT_TRUE(grpc_status.ok()) << grpc_status.error_message();
+
+  ASSERT_TRUE(rolled_back.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  // The rollback completes under the config lock, once it has pushed.
+  EXPECT_EQ(0U, GetPendingCommitId());
+  CheckRunningChassisConfig(&config);
+  ChassisConfig saved_config;
+  ASSERT_OK(ReadProtoFromTextFile(FLAGS_chassis_config_file, &saved_config));
+  EXPECT_THAT(saved_config, EqualsProto(config));
+
+  // A confirm arriving after the rollback fails.
+  ::gnmi::SetRequest confirm_req;
+  commit_req.Clear();
+  commit_req.set_confirm(true);
+  AddCommitRequest(commit_req, &confirm_req);
+  ::gnmi::SetResponse confirm_resp;
+  grpc_status = DoSet(&context, &confirm_req, &confirm_resp);
+  EXPECT_EQ(::grpc::StatusCode::FAILED_PRECONDITION, grpc_status.error_code());
+
+  // Clean-up.
+  EXPECT_CALL(*switch_mock_, UnregisterEventNotifyWriter())
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(config_monitoring_service_->Teardown());
+}
+
+// A rollback in progress neither blocks the shared timer thread, nor can be
+// overtaken by a concurrent confirm.
+TEST_P(ConfigMonitoringServiceTest, GnmiSetConfirmConcurrentWithRollback) {
+  if (mode_ == OPERATION_MODE_COUPLED) return;
+
+  ChassisConfig config;
+  FillTestChassisConfigAndSave(&config);
+  EXPECT_CALL(*switch_mock_, RegisterEventNotifyWriter(_))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, PushChassisConfig(_))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(config_monitoring_service_->Setup(false));
+
+  // The rollback blocks in the switch, under the config lock, until released.
+  absl::Notification rollback_started;
+  absl::Notification release_rollback;
+  EXPECT_CALL(*switch_mock_, PushChassisConfig(EqualsProto(config)))
+      .WillOnce(DoAll(Invoke([&](const ChassisConfig&) {
+                        rollback_started.Notify();
+                        release_rollback.WaitForNotification();
+                      }),
+                      Return(::util::OkStatus())));
+  EXPECT_CALL(*switch_mock_, PushChassisConfig(Not(EqualsProto(config))))
+      .WillOnce(Return(::util::OkStatus()));
+  ::gnmi::SetRequest req;
+  FillReplaceRequest(&req);
+  CommitRequest commit_req;
+  commit_req.set_confirm_timeout_ms(1);
+  AddCommitRequest(commit_req, &req);
+  ::grpc::ServerContext context;
+  ::gnmi::SetResponse resp;
+  auto grpc_status = DoSet(&context, &req, &resp);
+  ASSERT_TRUE(grpc_status.ok()) << grpc_status.error_message();
+  ASSERT_TRUE(
+      rollback_started.WaitForNotificationWithTimeout(absl::Seconds(10)));
+
+  // Other timers still fire while the rollback is in progress.
+  absl::Notification timer_fired;
+  TimerDaemon::DescriptorPtr timer;
+  ASSERT_OK(TimerDaemon::RequestOneShotTimer(
+      1,
+      [&timer_fired]() {
+        timer_fired.Notify();
+        return ::util::OkStatus();
+      },
+      &timer));
+  EXPECT_TRUE(timer_fired.WaitForNotificationWithTimeout(absl::Seconds(10)));
+
+  // A confirm racing with the rollback waits for it, then fails.
+  ::grpc::Status confirm_status;
+  std::thread confirm_thread([this, &confirm_status]() {
+    ::gnmi::SetRequest confirm_req;
+    CommitRequest confirm;
+    confirm.set_confirm(true);
+    AddCommitRequest(confirm, &confirm_req);
+    ::grpc::ServerContext confirm_context;
+    ::gnmi::SetResponse confirm_resp;
+    confirm_status = DoSet(&confirm_context, &confirm_req, &confirm_resp);
+  });
+  release_rollback.Notify();
+  confirm_thread.join();
+  EXPECT_EQ(::grpc::StatusCode::FAILED_PRECONDITION,
+            confirm_status.error_code());
+  EXPECT_EQ(0U, GetPendingCommitId());
+  CheckRunningChassisConfig(&config);
+
+  // Clean-up.
+  EXPECT_CALL(*switch_mock_, UnregisterEventNotifyWriter())
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(config_monitoring_service_->Teardown());
+}
+
+// Other config changes are rejected while a commit is pending confirmation.
+TEST_P(ConfigMonitoringServiceTest, GnmiSetWhileCommitPending) {
+  if (mode_ == OPERATION_MODE_COUPLED) return;
+
+  ChassisConfig config;
+  FillTestChassisConfigAndSave(&config);
+  EXPECT_CALL(*switch_mock_, RegisterEventNotifyWriter(_))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, PushChassisConfig(_))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(config_monitoring_service_->Setup(false));
+
+  ::gnmi::SetRequest req;
+  FillReplaceRequest(&req);
+  CommitRequest commit_req;
+  commit_req.set_confirm_timeout_ms(60000);
+  AddCommitRequest(commit_req, &req);
+  EXPECT_CALL(*switch_mock_, PushChassisConfig(_))
+      .WillOnce(Return(::util::OkStatus()));
+  ::grpc::ServerContext context;
+  ::gnmi::SetResponse resp;
+  auto grpc_status = DoSet(&context, &req, &resp);
+  ASSERT_TRUE(grpc_status.ok()) << grpc_status.error_message();
+  const uint64 commit_id = GetPendingCommitId();
+
+  // Neither a plain Set nor a rollback can overtake the pending commit.
+  ::gnmi::SetRequest plain_req;
+  FillReplaceRequest(&plain_req);
+  ::gnmi::SetResponse plain_resp;
+  grpc_status = DoSet(&context, &plain_req, &plain_resp);
+  EXPECT_EQ(::grpc::StatusCode::FAILED_PRECONDITION, grpc_status.error_code());
+  EXPECT_THAT(grpc_status.error_message(), HasSubstr("pending confirmation"));
+  ::gnmi::SetRequest rollback_req;
+  commit_req.Clear();
+  commit_req.set_rollback_to_version(1);
+  AddCommitRequest(commit_req, &rollback_req);
+  ::gnmi::SetResponse rollback_resp;
+  grpc_status = DoSet(&context, &rollback_req, &rollback_resp);
+  EXPECT_EQ(::grpc::StatusCode::FAILED_PRECONDITION, grpc_status.error_code());
+  EXPECT_EQ(commit_id, GetPendingCommitId());
+
+  // The pending commit still rolls back at its deadline.
+  EXPECT_CALL(*switch_mock_, PushChassisConfig(EqualsProto(config)))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_OK(HandleCommitTimeout(commit_id));
+  EXPECT_EQ(0U, GetPendingCommitId());
+  CheckRunningChassisConfig(&config);
+
+  // Clean-up.
+  EXPECT_CALL(*switch_mock_, UnregisterEventNotifyWriter())
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(config_monitoring_service_->Teardown());
+}
+
+// A Set can roll back to a config version from the config history.
+TEST_P(ConfigMonitoringServiceTest, GnmiSetRollbackToVersion) {
+  if (mode_ == OPERATION_MODE_COUPLED) return;
+
+  ChassisConfig config;
+  FillTestChassisConfigAndSave(&config);
+  EXPECT_CALL(*switch_mock_, RegisterEventNotifyWriter(_))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, PushChassisConfig(_))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(config_monitoring_service_->Setup(false));
+
+  ::gnmi::SetRequest req;
+  FillReplaceRequest(&req);
+  EXPECT_CALL(*switch_mock_, PushChassisConfig(_))
+      .WillOnce(Return(::util::OkStatus()));
+  ::grpc::ServerContext context;
+  ::gnmi::SetResponse resp;
+  auto grpc_status = DoSet(&context, &req, &resp);
+  ASSERT_TRUE(grpc_status.ok()) << grpc_status.error_message();
+
+  // Unknown versions and rollbacks with other changes are rejected.
+  ::gnmi::SetRequest bad_req;
+  CommitRequest commit_req;
+  commit_req.set_rollback_to_version(42);
+  AddCommitRequest(commit_req, &bad_req);
+  ::gnmi::SetResponse bad_resp;
+  grpc_status = DoSet(&context, &bad_req, &bad_resp);
+  EXPECT_FALSE(grpc_status.ok());
+  EXPECT_THAT(grpc_status.error_message(), HasSubstr("version 42"));
+  bad_req.Clear();
+  FillReplaceRequest(&bad_req);
+  commit_req.set_rollback_to_version(1);
+  AddCommitRequest(commit_req, &bad_req);
+  grpc_status = DoSet(&context, &bad_req, &bad_resp);
+  EXPECT_FALSE(grpc_status.ok());
+
+  // The config pushed by Setup() is version 1.
+  ::gnmi::SetRequest rollback_req;
+  AddCommitRequest(commit_req, &rollback_req);
+  EXPECT_CALL(*switch_mock_, PushChassisConfig(EqualsProto(config)))
+      .WillOnce(Return(::util::OkStatus()));
+  ::gnmi::SetResponse rollback_resp;
+  grpc_status = DoSet(&context, &rollback_req, &rollback_resp);
+  ASSERT_TRUE(grpc_status.ok()) << grpc_status.error_message();
+  EXPECT_EQ(3U, GetCommitResult(rollback_resp).version());
+  CheckRunningChassisConfig(&config);
+
+  // Clean-up.
+  EXPECT_CALL(*switch_mock_, UnregisterEventNotifyWriter())
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(config_monitoring_service_->Teardown());
+}
+
+// A Set with a plan request returns the plan and does not push the config.
+TEST_P(ConfigMonitoringServiceTest, GnmiSetPlanOnly) {
+  if (mode_ == OPERATION_MODE_COUPLED) return;
+
+  ChassisConfig config;
+  FillTestChassisConfigAndSave(&config);
+  EXPECT_CALL(*switch_mock_, RegisterEventNotifyWriter(_))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, PushChassisConfig(_))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(config_monitoring_service_->Setup(false));
+
+  ::gnmi::SetRequest req;
+  FillReplaceRequest(&req);
+  AddPlanRequest(&req);
+  ChassisConfigPlan plan;
+  auto* operation = plan.add_operations();
+  operation->set_type(ChassisConfigPlan::Operation::REMOVE);
+  operation->set_node_id(1);
+  operation->set_port_id(2);
+  operation->set_disruptive(true);
+  plan.set_disruptive(true);
+  EXPECT_CALL(*switch_mock_, PlanChassisConfig(_, _))
+      .WillOnce(DoAll(SetArgPointee<1>(plan), Return(::util::OkStatus())));
+  EXPECT_CALL(*switch_mock_, PushChassisConfig(_)).Times(0);
+  ::grpc::ServerContext context;
+  ::gnmi::SetResponse resp;
+  auto grpc_status = DoSet(&context, &req, &resp);
+  ASSERT_TRUE(grpc_status.ok()) << grpc_status.error_message();
+  EXPECT_TRUE(ProtoEqual(plan, GetPlanResult(resp)));
+  CheckRunningChassisConfig(&config);
+
+  // A plan request cannot be combined with a commit request.
+  AddCommitRequest(CommitRequest(), &req);
+  ::gnmi::SetResponse bad_resp;
+  grpc_status = DoSet(&context, &req, &bad_resp);
+  EXPECT_EQ(::grpc::StatusCode::INVALID_ARGUMENT, grpc_status.error_code());
+
+  // Clean-up.
+  EXPECT_CALL(*switch_mock_, UnregisterEventNotifyWriter())
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(config_monitoring_service_->Teardown());
+}
+
 TEST_P(ConfigMonitoringServiceTest, CapabilitiesTest) {
   ::gnmi::CapabilityResponse expected_resp;
   ASSERT_OK(
@@ -440,6 +440,20 @@ class OpticalOutputPowerChangedEvent
   const OpticalTransceiverInfo::Power new_output_power_;
 };
 
+// A P4 table's occupancy has crossed a threshold event.
+class TableOccupancyChangedEvent
+    : public PerNodeGnmiEvent<TableOccupancyChangedEvent> {
+ public:
+  TableOccupancyChangedEvent(uint64 node_id, const TableOccupancy::Table& table)
+      : PerNodeGnmiEvent(node_id), table_(table) {}
+  ~TableOccupancyChangedEvent() override {}
+
+  const TableOccupancy::Table& GetTable() const { return table_; }
+
+ private:
+  const TableOccupancy::Table table_;
+};
+
 // Console log severity has been changed event.
 class ConsoleLogSeverityChangedEvent
     : public GnmiEventProcess<ConsoleLogSeverityChangedEvent> {
@@ -7,6 +7,7 @@
 #include <list>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/synchronization/mutex.h"
 #include "gnmi/gnmi.pb.h"
@@ -114,7 +115,8 @@ GnmiPublisher::~GnmiPublisher() {}
                                                 GnmiSubscribeStream* stream,
                                                 SubscriptionHandle* h) {
   auto status = Subscribe(&TreeNode::AllSubtreeLeavesSupportOnTimer,
-                          &TreeNode::GetOnTimerHandler, path, stream, h);
+                          &TreeNode::GetOnTimerHandler, path, stream, h,
+                          nullptr);
   if (status != ::util::OkStatus()) {
     return status;
   }
@@ -134,14 +136,16 @@ GnmiPublisher::~GnmiPublisher() {}
                                             GnmiSubscribeStream* stream,
                                             SubscriptionHandle* h) {
   return Subscribe(&TreeNode::AllSubtreeLeavesSupportOnPoll,
-                   &TreeNode::GetOnPollHandler, path, stream, h);
+                   &TreeNode::GetOnPollHandler, path, stream, h, nullptr);
 }
 
 ::util::Status GnmiPublisher::SubscribeOnChange(const ::gnmi::Path& path,
                                                 GnmiSubscribeStream* stream,
                                                 SubscriptionHandle* h) {
+  std::vector<const TreeNode*> nodes;
   auto status = Subscribe(&TreeNode::AllSubtreeLeavesSupportOnChange,
-                          &TreeNode::GetOnChangeHandler, path, stream, h);
+                          &TreeNode::GetOnChangeHandler, path, stream, h,
+                          &nodes);
   if (status != ::util::OkStatus()) {
     return status;
   }
@@ -149,14 +153,17 @@ GnmiPublisher::~GnmiPublisher() {}
   // all event handler lists that handle events of the type this handler is
   // prepared to handle.
   absl::WriterMutexLock l(&access_lock_);
-  return parse_tree_.FindNodeOrNull(path)->DoOnChangeRegistration(
-      EventHandlerRecordPtr(*h));
+  for (const auto* node : nodes) {
+    RETURN_IF_ERROR(node->DoOnChangeRegistration(EventHandlerRecordPtr(*h)));
+  }
+  return ::util::OkStatus();
 }
 
 ::util::Status GnmiPublisher::Subscribe(
     const SupportOnPtr& all_leaves_support_mode,
     const GetHandlerFunc& get_handler, const ::gnmi::Path& path,
-    GnmiSubscribeStream* stream, SubscriptionHandle* h) {
+    GnmiSubscribeStream* stream, SubscriptionHandle* h,
+    std::vector<const TreeNode*>* matched_nodes) {
   absl::WriterMutexLock l(&access_lock_);
 
   // Check input parameters.
@@ -169,23 +176,43 @@ GnmiPublisher::~GnmiPublisher() {}
   if (path.elem_size() == 0) {
     return MAKE_ERROR(ERR_INVALID_PARAM) << "path is empty!";
   }
-  // Map the input path to the supported one - walk the tree of known elements
-  // element by element starting from the root and if the element is found the
-  // move to the next one. If not found, return an error.
-  const TreeNode* node = parse_tree_.FindNodeOrNull(path);
-  if (node == nullptr) {
+  // Map the input path to the supported one(s) - walk the tree of known
+  // elements element by element starting from the root and if the element is
+  // found the move to the next one. Paths with "..." wildcards may map to
+  // many nodes. If not found, return an error.
+  std::vector<const TreeNode*> nodes = parse_tree_.FindMatchingNodes(path);
+  if (nodes.empty()) {
     // Ooops... This path is not supported.
     return MAKE_ERROR(ERR_INVALID_PARAM)
            << "The path (" << path.ShortDebugString() << ") is unsupported!";
   }
-  if (!(node->*all_leaves_support_mode)()) {
-    // Ooops... Not all leaves in this subtree support this mode!
-    return MAKE_ERROR(ERR_INVALID_PARAM)
-           << "Not all leaves on the path (" << path.ShortDebugString()
-           << ") support this mode!";
+  for (const auto* node : nodes) {
+    if (!(node->*all_leaves_support_mode)()) {
+      // Ooops... Not all leaves in this subtree support this mode!
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Not all leaves on the path (" << path.ShortDebugString()
+             << ") support this mode!";
+    }
+  }
+  // All good! Save the handler that handles this leaf, or the handlers of all
+  // the matching nodes.
+  if (nodes.size() == 1) {
+    h->reset(new EventHandlerRecord((nodes[0]->*get_handler)(), stream));
+  } else {
+    std::vector<GnmiEventHandler> handlers;
+    handlers.reserve(nodes.size());
+    for (const auto* node : nodes) handlers.push_back((node->*get_handler)());
+    h->reset(new EventHandlerRecord(
+        [handlers](const GnmiEvent& event, GnmiSubscribeStream* stream) {
+          ::util::Status status = ::util::OkStatus();
+          for (const auto& handler : handlers) {
+            APPEND_STATUS_IF_ERROR(status, handler(event, stream));
+          }
+          return status;
+        },
+        stream));
   }
-  // All good! Save the handler that handles this leaf.
-  h->reset(new EventHandlerRecord((node->*get_handler)(), stream));
+  if (matched_nodes != nullptr) *matched_nodes = std::move(nodes);
   return ::util::OkStatus();
 }
 
@@ -260,6 +287,11 @@ void* GnmiPublisher::ThreadReadGnmiEvents(void* arg) {
   return nullptr;
 }
 
+void GnmiPublisher::SetEntryQuotaUsageReader(EntryQuotaUsageReader reader) {
+  absl::WriterMutexLock l(&access_lock_);
+  parse_tree_.SetEntryQuotaUsageReader(std::move(reader));
+}
+
 ::util::Status GnmiPublisher::RegisterEventWriter() {
   absl::WriterMutexLock l(&access_lock_);
   // If we have not done that yet, create notification event Channel, register
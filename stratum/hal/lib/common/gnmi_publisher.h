@@ -12,6 +12,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/synchronization/mutex.h"
@@ -47,20 +48,24 @@ class Frequency {
 };
 
 // Specialization of the Frequency container to be used by subscriptions that
-// require updates every 'period_ms' milliseconds.
+// require updates every 'period_ms' milliseconds. The first update is sent
+// after 'delay_ms' milliseconds.
 class Periodic : public Frequency {
  public:
-  explicit Periodic(uint64 period_ms) : Frequency(0, period_ms, 0) {}
+  explicit Periodic(uint64 period_ms, uint64 delay_ms = 0)
+      : Frequency(delay_ms, period_ms, 0) {}
 };
 
 // Specialization of the Frequency container to be used by subscriptions that
 // require updates every 'period_ms' milliseconds. The current state is _only_
 // reported if there is change in the value of the node unless since last update
-// 'heartbeat_ms' milliseconds have elapsed.
+// 'heartbeat_ms' milliseconds have elapsed. The first update is sent after
+// 'delay_ms' milliseconds.
 class PeriodicWithHeartbeat : public Frequency {
  public:
-  PeriodicWithHeartbeat(uint64 period_ms, uint64 heartbeat_ms)
-      : Frequency(0, period_ms, heartbeat_ms) {}
+  PeriodicWithHeartbeat(uint64 period_ms, uint64 heartbeat_ms,
+                        uint64 delay_ms = 0)
+      : Frequency(delay_ms, period_ms, heartbeat_ms) {}
 };
 
 // The main class responsible for handling all aspects of gNMI subscriptions and
@@ -130,6 +135,11 @@ class GnmiPublisher {
   // The method sends a gNMI message denoting the end of initial set of values.
   virtual ::util::Status SendSyncResponse(GnmiSubscribeStream* stream);
 
+  // Sets the function used to read the entry quota usage of the nodes,
+  // published under /debug/nodes/node[name=<name>]/entry-quotas.
+  void SetEntryQuotaUsageReader(EntryQuotaUsageReader reader)
+      LOCKS_EXCLUDED(access_lock_);
+
   // Method creating the channel to be used to receive notifications from
   // the switch.
   virtual ::util::Status RegisterEventWriter() LOCKS_EXCLUDED(access_lock_);
@@ -161,11 +171,13 @@ class GnmiPublisher {
 
   // A generic method handling all types of subscriptions. Requires long list of
   // parameters, so, it has been hidden here and specialized methods calling it
-  // have been exposed as public interface.
+  // have been exposed as public interface. If 'matched_nodes' is not nullptr,
+  // it is set to the nodes handling the path.
   ::util::Status Subscribe(const SupportOnPtr& supports_on,
                            const GetHandlerFunc& get_handler,
                            const ::gnmi::Path& path,
-                           GnmiSubscribeStream* stream, SubscriptionHandle* h)
+                           GnmiSubscribeStream* stream, SubscriptionHandle* h,
+                           std::vector<const TreeNode*>* matched_nodes)
       LOCKS_EXCLUDED(access_lock_);
 
   // A handler of events received over the event_channel_ channel.
@@ -4,6 +4,11 @@
 
 #include "stratum/hal/lib/common/gnmi_publisher.h"
 
+#include <set>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
 #include "gmock/gmock.h"
 #include "gnmi/gnmi.pb.h"
@@ -11,6 +16,7 @@
 #include "stratum/glue/status/status_test_util.h"
 #include "stratum/hal/lib/common/subscribe_reader_writer_mock.h"
 #include "stratum/hal/lib/common/switch_mock.h"
+#include "stratum/lib/constants.h"
 #include "stratum/lib/utils.h"
 
 namespace stratum {
@@ -23,6 +29,7 @@ using ::testing::Invoke;
 using ::testing::Not;
 using ::testing::Return;
 using ::testing::SaveArg;
+using ::testing::SizeIs;
 using ::testing::WithArgs;
 
 // There are two types of tests in this file, namely: ones that can be executed
@@ -101,6 +108,11 @@ class SubscriptionTestBase {
     }
   }
 
+  std::vector<const TreeNode*> FindMatchingNodes(const ::gnmi::Path& path) {
+    absl::WriterMutexLock l(&gnmi_publisher_->access_lock_);
+    return gnmi_publisher_->parse_tree_.FindMatchingNodes(path);
+  }
+
   void PrintNodeWithOnChange() {
     absl::WriterMutexLock l(&gnmi_publisher_->access_lock_);
     PrintNodeWithOnChange(*gnmi_publisher_->parse_tree_.GetRoot(), "");
@@ -342,6 +354,182 @@ TEST_F(SubscriptionTest, PromisedOnPollOnlyLeafsAreSupported) {
       &stream, &h));
 }
 
+// Tests of paths with "..." wildcards on a switch with many ports.
+class MultiLevelWildcardTest : public SubscriptionTestBase,
+                               public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ChassisConfig config = hal_config_;
+    config.clear_singleton_ports();
+    for (int i = 1; i <= kNumPorts; ++i) {
+      auto* port = config.add_singleton_ports();
+      port->set_id(i);
+      port->set_name(PortName(i));
+      port->set_slot(1);
+      port->set_port(i);
+      port->set_speed_bps(kHundredGigBps);
+      port->set_node(1);
+    }
+    ASSERT_OK(gnmi_publisher_->HandleChange(ConfigHasBeenPushedEvent(config)));
+  }
+
+  static std::string PortName(int port) {
+    return absl::StrCat("device1.domain.net.com:ce-1/", port);
+  }
+
+  static constexpr int kNumPorts = 1024;
+};
+
+constexpr int MultiLevelWildcardTest::kNumPorts;
+
+TEST_F(MultiLevelWildcardTest, FindMatchingNodes) {
+  // A "..." before the last element matches the leaf of every port.
+  std::vector<const TreeNode*> nodes =
+      FindMatchingNodes(GetPath("...")("in-octets")());
+  ASSERT_THAT(nodes, SizeIs(kNumPorts));
+  std::set<std::string> names;
+  for (const auto* node : nodes) {
+    ::gnmi::Path path = node->GetPath();
+    ASSERT_EQ(5, path.elem_size());
+    EXPECT_EQ("in-octets", path.elem(4).name());
+    names.insert(path.elem(1).key().at("name"));
+  }
+  EXPECT_THAT(names, SizeIs(kNumPorts));
+
+  // Keys and "*" may be mixed with "...", and repeated "..." do not match
+  // the same node twice.
+  EXPECT_THAT(FindMatchingNodes(GetPath("interfaces")("interface", "*")("...")(
+                  "in-octets")()),
+              SizeIs(kNumPorts));
+  EXPECT_THAT(FindMatchingNodes(GetPath("interfaces")("...")("...")(
+                  "counters")("in-octets")()),
+              SizeIs(kNumPorts));
+  EXPECT_THAT(
+      FindMatchingNodes(GetPath("interfaces")("interface", PortName(7))("...")(
+          "in-octets")()),
+      SizeIs(1));
+
+  // A trailing "..." matches the subtree of the node, but not its descendants
+  // separately.
+  nodes = FindMatchingNodes(GetPath("interfaces")("...")("counters")("...")());
+  ASSERT_THAT(nodes, SizeIs(kNumPorts));
+  EXPECT_EQ("counters", nodes[0]->name());
+  nodes = FindMatchingNodes(
+      GetPath("interfaces")("interface", PortName(7))("...")());
+  ASSERT_THAT(nodes, SizeIs(1));
+  EXPECT_EQ(PortName(7), nodes[0]->name());
+
+  // Paths with a dedicated node still map to that node only.
+  EXPECT_THAT(FindMatchingNodes(GetPath("interfaces")("interface")("...")()),
+              SizeIs(1));
+  EXPECT_THAT(FindMatchingNodes(
+                  GetPath("interfaces")("interface", "*")("state")("name")()),
+              SizeIs(1));
+
+  // No match.
+  EXPECT_THAT(FindMatchingNodes(GetPath("interfaces")("...")("blah")()),
+              SizeIs(0));
+  EXPECT_THAT(FindMatchingNodes(GetPath("interfaces")("interface", "blah")(
+                  "...")("in-octets")()),
+              SizeIs(0));
+}
+
+TEST_F(MultiLevelWildcardTest, PollLeafOfAllPorts) {
+  // Every port reports its ID as its in-octets counter.
+  EXPECT_CALL(switch_mock_, RetrieveValue(_, _, _, _))
+      .Times(kNumPorts)
+      .WillRepeatedly(DoAll(
+          WithArgs<1, 2>(Invoke(
+              [](const DataRequest& req, WriterInterface<DataResponse>* w) {
+                DataResponse resp;
+                resp.mutable_port_counters()->set_in_octets(
+                    req.requests(0).port_counters().port_id());
+                w->Write(resp);
+              })),
+          Return(::util::OkStatus())));
+  SubscribeReaderWriterMock stream;
+  std::vector<::gnmi::SubscribeResponse> responses;
+  EXPECT_CALL(stream, Write(_, _))
+      .WillRepeatedly(
+          DoAll(WithArgs<0>(Invoke(
+                    [&responses](const ::gnmi::SubscribeResponse& resp) {
+                      responses.push_back(resp);
+                    })),
+                Return(true)));
+
+  SubscriptionHandle h;
+  ASSERT_OK(gnmi_publisher_->SubscribePoll(
+      GetPath("interfaces")("interface", "*")("...")("in-octets")(), &stream,
+      &h));
+  ASSERT_OK(gnmi_publisher_->HandlePoll(h));
+
+  ASSERT_THAT(responses, SizeIs(kNumPorts));
+  std::set<uint64> values;
+  for (const auto& resp : responses) {
+    ASSERT_TRUE(resp.has_update());
+    const auto& update = resp.update().update(0);
+    EXPECT_EQ("in-octets", update.path().elem(4).name());
+    EXPECT_EQ(PortName(update.val().uint_val()),
+              update.path().elem(1).key().at("name"));
+    values.insert(update.val().uint_val());
+  }
+  EXPECT_THAT(values, SizeIs(kNumPorts));
+}
+
+TEST_F(MultiLevelWildcardTest, PollSubtreeOfOnePort) {
+  EXPECT_CALL(switch_mock_, RetrieveValue(_, _, _, _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  SubscribeReaderWriterMock stream;
+  int num_writes = 0;
+  EXPECT_CALL(stream, Write(_, _))
+      .WillRepeatedly(DoAll(
+          Invoke([&num_writes](const ::gnmi::SubscribeResponse&,
+                               ::grpc::WriteOptions) { ++num_writes; }),
+          Return(true)));
+
+  // A trailing "..." polls the same leaves as the node itself.
+  SubscriptionHandle h;
+  ASSERT_OK(gnmi_publisher_->SubscribePoll(
+      GetPath("interfaces")("interface", PortName(7))(), &stream, &h));
+  ASSERT_OK(gnmi_publisher_->HandlePoll(h));
+  const int expected_writes = num_writes;
+  EXPECT_GT(expected_writes, 0);
+  num_writes = 0;
+  ASSERT_OK(gnmi_publisher_->SubscribePoll(
+      GetPath("interfaces")("interface", PortName(7))("...")(), &stream, &h));
+  ASSERT_OK(gnmi_publisher_->HandlePoll(h));
+  EXPECT_EQ(expected_writes, num_writes);
+}
+
+TEST_F(MultiLevelWildcardTest, UnsupportedPath) {
+  SubscribeReaderWriterMock stream;
+  SubscriptionHandle h;
+  EXPECT_THAT(gnmi_publisher_
+                  ->SubscribePoll(GetPath("interfaces")("...")("blah")(),
+                                  &stream, &h)
+                  .ToString(),
+              HasSubstr("unsupported"));
+}
+
+TEST_F(MultiLevelWildcardTest, SubscribeOnChangeToLeafOfAllPorts) {
+  SubscribeReaderWriterMock stream;
+  SubscriptionHandle h;
+  ASSERT_OK(gnmi_publisher_->SubscribeOnChange(
+      GetPath("interfaces")("interface", "*")("...")("oper-status")(), &stream,
+      &h));
+
+  // A change of one port is reported once, for that port only.
+  ::gnmi::SubscribeResponse resp;
+  EXPECT_CALL(stream, Write(_, _))
+      .WillOnce(DoAll(SaveArg<0>(&resp), Return(true)));
+  ASSERT_OK(gnmi_publisher_->HandleChange(
+      PortOperStateChangedEvent(1, 7, PORT_STATE_UP, 0)));
+  ASSERT_TRUE(resp.has_update());
+  EXPECT_EQ(PortName(7), resp.update().update(0).path().elem(1).key().at(
+                             "name"));
+  EXPECT_EQ("UP", resp.update().update(0).val().string_val());
+}
+
 // All remaining paths support all modes and can be tested by this parametrized
 // test that takes the path as a parameter.
 class SubscriptionSupportedPathsTest
@@ -14,8 +14,10 @@
 #include "absl/strings/str_split.h"
 #include "absl/synchronization/mutex.h"
 #include "gflags/gflags.h"
+#include "grpcpp/health_check_service_interface.h"
 #include "stratum/glue/logging.h"
 #include "stratum/lib/constants.h"
+#include "stratum/lib/liveness_watchdog.h"
 #include "stratum/lib/macros.h"
 #include "stratum/lib/utils.h"
 
@@ -163,6 +165,10 @@ Hal::~Hal() {
   // AdminService, which itself calls Freeze() method in SwitchInterface class.
   LOG(INFO) << "Shutting down HAL...";
   ::util::Status status = ::util::OkStatus();
+  // The worker threads are expected to stop from here on.
+  LivenessWatchdog* watchdog = LivenessWatchdog::GetInstance();
+  APPEND_STATUS_IF_ERROR(status, watchdog->Stop());
+  watchdog->SetHealthCallback(nullptr);
   APPEND_STATUS_IF_ERROR(status, config_monitoring_service_->Teardown());
   APPEND_STATUS_IF_ERROR(status, p4_service_->Teardown());
   APPEND_STATUS_IF_ERROR(status, certificate_management_service_->Teardown());
@@ -190,6 +196,7 @@ Hal::~Hal() {
   {
     std::shared_ptr<::grpc::ServerCredentials> server_credentials =
         credentials_manager_->GenerateExternalFacingServerCredentials();
+    ::grpc::EnableDefaultHealthCheckService(true);
     ::grpc::ServerBuilder builder;
     SetGrpcServerKeepAliveArgs(&builder);
     builder.AddListeningPort(FLAGS_local_stratum_url,
@@ -220,6 +227,18 @@ Hal::~Hal() {
     LOG(ERROR) << "Stratum external facing services are listening to "
                << absl::StrJoin(external_stratum_urls, ", ") << ", "
                << FLAGS_local_stratum_url << "...";
+    // The standard gRPC health service (grpc.health.v1.Health) reports
+    // NOT_SERVING while any of the worker threads is stalled.
+    ::grpc::HealthCheckServiceInterface* health_service =
+        external_server_->GetHealthCheckService();
+    LivenessWatchdog* watchdog = LivenessWatchdog::GetInstance();
+    if (health_service != nullptr) {
+      watchdog->SetHealthCallback([health_service](bool healthy) {
+        health_service->SetServingStatus(healthy);
+      });
+      health_service->SetServingStatus(watchdog->IsHealthy());
+    }
+    RETURN_IF_ERROR(watchdog->Start());
   }
 
   external_server_->Wait();  // blocking until external_server_->Shutdown()
@@ -292,6 +311,13 @@ Hal* Hal::GetSingleton() {
       mode_, switch_interface_, auth_policy_checker_, error_buffer_.get());
   p4_service_ = absl::make_unique<P4Service>(
       mode_, switch_interface_, auth_policy_checker_, error_buffer_.get());
+  // The entry quotas of the P4 roles are tracked by P4Service and published
+  // over gNMI by ConfigMonitoringService.
+  P4Service* p4_service = p4_service_.get();
+  config_monitoring_service_->SetEntryQuotaUsageReader(
+      [p4_service](uint64 node_id, EntryQuotaUsage* usage) {
+        return p4_service->GetEntryQuotaUsage(node_id, usage);
+      });
   admin_service_ = absl::make_unique<AdminService>(
       mode_, switch_interface_, auth_policy_checker_, error_buffer_.get(),
       SignalRcvCallback);
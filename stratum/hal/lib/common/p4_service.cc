@@ -4,11 +4,13 @@
 
 #include "stratum/hal/lib/common/p4_service.h"
 
+#include <algorithm>
 #include <functional>
 #include <sstream>  // IWYU pragma: keep
 #include <utility>
 
 #include "absl/cleanup/cleanup.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
 #include "absl/numeric/int128.h"
 #include "absl/strings/str_cat.h"
@@ -22,6 +24,7 @@
 #include "stratum/glue/logging.h"
 #include "stratum/glue/status/status_macros.h"
 #include "stratum/hal/lib/common/server_writer_wrapper.h"
+#include "stratum/hal/lib/common/writer_interface.h"
 #include "stratum/lib/channel/channel.h"
 #include "stratum/lib/macros.h"
 #include "stratum/lib/utils.h"
@@ -46,10 +49,91 @@ DEFINE_int32(max_num_controllers_per_node, 5,
 DEFINE_int32(max_num_controller_connections, 20,
              "Max number of active/inactive streaming connections from outside "
              "controllers (for all of the nodes combined).");
+DEFINE_int64(p4_write_max_inflight_updates_per_controller, 0,
+             "Max number of P4Runtime updates being written at the same time "
+             "on behalf of a single controller. 0 means no limit.");
+DEFINE_int64(p4_write_max_inflight_bytes_per_controller, 0,
+             "Max number of bytes of P4Runtime write requests being processed "
+             "at the same time on behalf of a single controller. 0 means no "
+             "limit.");
+DEFINE_int64(p4_write_max_inflight_updates, 0,
+             "Max number of P4Runtime updates being written at the same time "
+             "(for all of the controllers combined). 0 means no limit.");
+DEFINE_int64(p4_write_max_inflight_bytes, 0,
+             "Max number of bytes of P4Runtime write requests being processed "
+             "at the same time (for all of the controllers combined). 0 means "
+             "no limit.");
+DEFINE_int32(p4_write_target_queue_delay_ms, 0,
+             "Acceptable time from the arrival of a P4Runtime write request "
+             "to the start of its switch write. Once exceeded for "
+             "p4_write_admission_interval_ms by the writes of a controller, "
+             "that controller may only have one write in flight and its "
+             "further writes are rejected early with RESOURCE_EXHAUSTED. 0 "
+             "disables the early rejection.");
+DEFINE_int32(p4_write_admission_interval_ms, 1000,
+             "The time the P4Runtime write queue delay must stay above target "
+             "before writes are rejected early. Also caps the retry hint.");
 
 namespace stratum {
 namespace hal {
 
+namespace {
+
+// The trailing metadata key used to tell the client when to retry a rejected
+// request. Honored by the gRPC client retry logic.
+constexpr char kRetryPushbackMetadataKey[] = "grpc-retry-pushback-ms";
+
+AdmissionController::Options GetAdmissionOptionsFromFlags() {
+  AdmissionController::Options options;
+  options.max_updates_per_controller =
+      FLAGS_p4_write_max_inflight_updates_per_controller;
+  options.max_bytes_per_controller =
+      FLAGS_p4_write_max_inflight_bytes_per_controller;
+  options.max_updates = FLAGS_p4_write_max_inflight_updates;
+  options.max_bytes = FLAGS_p4_write_max_inflight_bytes;
+  options.target_queue_delay =
+      absl::Milliseconds(FLAGS_p4_write_target_queue_delay_ms);
+  options.interval = absl::Milliseconds(FLAGS_p4_write_admission_interval_ms);
+  return options;
+}
+
+// A WriterInterface which counts the entries of a wildcard read per P4 ID.
+// P4Service uses it to recount the entry usage of the controller roles.
+class EntryCountingWriter : public WriterInterface<::p4::v1::ReadResponse> {
+ public:
+  EntryCountingWriter() {}
+  ~EntryCountingWriter() override {}
+
+  bool Write(const ::p4::v1::ReadResponse& msg) override {
+    for (const auto& entity : msg.entities()) {
+      switch (entity.entity_case()) {
+        case ::p4::v1::Entity::kTableEntry:
+          if (entity.table_entry().is_default_action()) break;
+          ++entry_counts_[entity.table_entry().table_id()];
+          break;
+        case ::p4::v1::Entity::kActionProfileMember:
+          ++entry_counts_[entity.action_profile_member().action_profile_id()];
+          break;
+        case ::p4::v1::Entity::kActionProfileGroup:
+          ++entry_counts_[entity.action_profile_group().action_profile_id()];
+          break;
+        default:
+          break;
+      }
+    }
+    return true;
+  }
+
+  const absl::flat_hash_map<uint32_t, uint64_t>& entry_counts() const {
+    return entry_counts_;
+  }
+
+ private:
+  absl::flat_hash_map<uint32_t, uint64_t> entry_counts_;
+};
+
+}  // namespace
+
 // TODO(unknown): This class move possibly big configs in memory. See if there
 // is a way to make this more efficient.
 
@@ -62,7 +146,10 @@ P4Service::P4Service(OperationMode mode, SwitchInterface* switch_interface,
       mode_(mode),
       switch_interface_(ABSL_DIE_IF_NULL(switch_interface)),
       auth_policy_checker_(ABSL_DIE_IF_NULL(auth_policy_checker)),
-      error_buffer_(ABSL_DIE_IF_NULL(error_buffer)) {}
+      error_buffer_(ABSL_DIE_IF_NULL(error_buffer)),
+      admission_controller_(
+          AdmissionController::CreateInstance(GetAdmissionOptionsFromFlags())) {
+}
 
 P4Service::~P4Service() {}
 
@@ -292,6 +379,7 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
 ::grpc::Status P4Service::Write(::grpc::ServerContext* context,
                                 const ::p4::v1::WriteRequest* req,
                                 ::p4::v1::WriteResponse* resp) {
+  const absl::Time arrival = absl::Now();
   RETURN_IF_NOT_AUTHORIZED(auth_policy_checker_, P4Service, Write, context);
 
   if (!req->updates_size()) return ::grpc::Status::OK;  // Nothing to do.
@@ -324,14 +412,84 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
                           "Write from non-master is not permitted.");
   }
 
+  // Writes go through the bulk lane of the admission controller, so that a
+  // controller storm cannot starve the rest of the service. Writes beyond the
+  // limits are rejected instead of holding a server thread. Only one primary
+  // exists per role, so (node, role) identifies the writing controller.
+  const std::string controller = absl::StrCat(node_id, "/", req->role());
+  const int64 num_updates = req->updates_size();
+  const int64 num_bytes = req->ByteSizeLong();
+  absl::Duration retry_hint;
+  ::util::Status admission = admission_controller_->Admit(
+      controller, AdmissionController::kBulkLane, num_updates, num_bytes,
+      &retry_hint);
+  if (!admission.ok()) {
+    LOG_EVERY_N(WARNING, 100) << "Rejected write to node " << node_id << ": "
+                              << admission.error_message();
+    context->AddTrailingMetadata(
+        kRetryPushbackMetadataKey,
+        absl::StrCat(absl::ToInt64Milliseconds(retry_hint)));
+    return ::grpc::Status(ToGrpcCode(admission.CanonicalCode()),
+                          admission.error_message());
+  }
+  // The queue delay is the time the write waited, e.g. on the service and
+  // switch locks, before its switch write started. The duration of the switch
+  // write itself is not part of it.
+  absl::Duration queue_delay = absl::ZeroDuration();
+  auto release = absl::MakeCleanup([&]() {
+    admission_controller_->Release(controller, num_updates, num_bytes,
+                                   queue_delay);
+  });
+
+  // Inserts beyond the entry quota of the role are rejected here, and only
+  // the admitted updates are sent to the switch. The common case of a
+  // request without rejected updates is passed through without a copy.
+  std::vector<::util::Status> quota_results = ReserveEntryQuota(node_id, *req);
+  bool over_quota = std::any_of(
+      quota_results.begin(), quota_results.end(),
+      [](const ::util::Status& quota_result) { return !quota_result.ok(); });
+  const ::p4::v1::WriteRequest* admitted_req = req;
+  ::p4::v1::WriteRequest filtered_req;
+  if (over_quota) {
+    filtered_req = *req;
+    filtered_req.clear_updates();
+    for (int i = 0; i < req->updates_size(); ++i) {
+      if (quota_results[i].ok()) *filtered_req.add_updates() = req->updates(i);
+    }
+    admitted_req = &filtered_req;
+  }
+
   std::vector<::util::Status> results = {};
   absl::Time timestamp = absl::Now();
-  ::util::Status status =
-      switch_interface_->WriteForwardingEntries(*req, &results);
+  queue_delay = timestamp - arrival;
+  ::util::Status status = ::util::OkStatus();
+  if (admitted_req->updates_size() > 0) {
+    status = switch_interface_->WriteForwardingEntries(*admitted_req, &results);
+  }
   if (!status.ok()) {
     LOG(ERROR) << "Failed to write forwarding entries to node " << node_id
                << ": " << status.error_message();
   }
+  bool have_details =
+      results.size() == static_cast<size_t>(admitted_req->updates_size());
+  std::vector<bool> applied(admitted_req->updates_size());
+  for (int i = 0; i < admitted_req->updates_size(); ++i) {
+    applied[i] = have_details ? results[i].ok() : status.ok();
+  }
+  SettleEntryQuota(node_id, *admitted_req, applied);
+
+  // Merge the switch results back into the order of the original request.
+  if (over_quota) {
+    for (int i = 0, j = 0; i < req->updates_size(); ++i) {
+      if (!quota_results[i].ok()) continue;
+      quota_results[i] = have_details ? results[j++] : status;
+    }
+    results = std::move(quota_results);
+    if (status.ok()) {
+      status = MAKE_ERROR(ERR_AT_LEAST_ONE_OPER_FAILED)
+               << "One or more write operations failed.";
+    }
+  }
 
   // Log debug info for future debugging.
   LogWriteRequest(node_id, *req, results, timestamp);
@@ -504,6 +662,21 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
                           status.error_message());
   }
 
+  // A committed pipeline starts with new tables, so the entry usage of the
+  // roles is recounted from the switch.
+  if (req->action() ==
+          ::p4::v1::SetForwardingPipelineConfigRequest::VERIFY_AND_COMMIT ||
+      req->action() == ::p4::v1::SetForwardingPipelineConfigRequest::COMMIT) {
+    {
+      absl::ReaderMutexLock l(&controller_lock_);
+      auto it = node_id_to_controller_manager_.find(node_id);
+      if (it != node_id_to_controller_manager_.end()) {
+        it->second.MarkEntryUsageStale();
+      }
+    }
+    ReconcileEntryUsage(node_id);
+  }
+
   return ::grpc::Status::OK;
 }
 
@@ -608,6 +781,12 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
           return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
                                 "Invalid election ID.");
         }
+        // Arbitration goes through the priority lane and is never rejected
+        // because of bulk writes.
+        admission_controller_->Admit(sdn_connection->GetName(),
+                                     AdmissionController::kPriorityLane, 0, 0,
+                                     nullptr)
+            .IgnoreError();
         // Try to add the controller to controllers_.
         auto status = AddOrModifyController(node_id, req.arbitration(),
                                             sdn_connection.get());
@@ -633,7 +812,12 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
                    << "Controller " << sdn_connection->GetName()
                    << " is not a master";
         } else {
-          // If master, try to transmit the packet.
+          // If master, try to transmit the packet. Traffic from the primary
+          // goes through the priority lane.
+          admission_controller_->Admit(sdn_connection->GetName(),
+                                       AdmissionController::kPriorityLane, 0,
+                                       0, nullptr)
+              .IgnoreError();
           status = switch_interface_->HandleStreamMessageRequest(node_id, req);
         }
         if (!status.ok()) {
@@ -655,6 +839,10 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
                    << " is not a master";
         } else {
           // If master, try to ack the digest.
+          admission_controller_->Admit(sdn_connection->GetName(),
+                                       AdmissionController::kPriorityLane, 0,
+                                       0, nullptr)
+              .IgnoreError();
           status = switch_interface_->HandleStreamMessageRequest(node_id, req);
         }
         if (!status.ok()) {
@@ -704,7 +892,20 @@ void LogReadRequest(uint64 node_id, const ::p4::v1::ReadRequest& req,
     uint64 node_id, const ::p4::v1::MasterArbitrationUpdate& update,
     p4runtime::SdnConnection* controller) {
   // To be called by all the threads handling controller connections.
-  absl::WriterMutexLock l(&controller_lock_);
+  {
+    absl::WriterMutexLock l(&controller_lock_);
+    RETURN_IF_ERROR(DoAddOrModifyController(node_id, update, controller));
+  }
+  // The arbitration update may carry a new role config with entry quotas. The
+  // entries are read back from the switch without blocking the other streams.
+  ReconcileEntryUsage(node_id);
+
+  return ::util::OkStatus();
+}
+
+::util::Status P4Service::DoAddOrModifyController(
+    uint64 node_id, const ::p4::v1::MasterArbitrationUpdate& update,
+    p4runtime::SdnConnection* controller) {
   auto it = node_id_to_controller_manager_.find(node_id);
   if (it == node_id_to_controller_manager_.end()) {
     absl::WriterMutexLock lg(&stream_response_thread_lock_);
@@ -767,6 +968,94 @@ void P4Service::RemoveController(uint64 node_id,
   it->second.Disconnect(connection);
 }
 
+std::vector<::util::Status> P4Service::ReserveEntryQuota(
+    uint64 node_id, const ::p4::v1::WriteRequest& req) {
+  absl::ReaderMutexLock l(&controller_lock_);
+  auto it = node_id_to_controller_manager_.find(node_id);
+  if (it == node_id_to_controller_manager_.end()) {
+    return std::vector<::util::Status>(req.updates_size());
+  }
+  std::vector<::util::Status> quota_results;
+  quota_results.reserve(req.updates_size());
+  for (const auto& status : it->second.ReserveEntryQuota(req)) {
+    quota_results.emplace_back(
+        static_cast<::util::error::Code>(status.error_code()),
+        status.error_message());
+  }
+  return quota_results;
+}
+
+void P4Service::SettleEntryQuota(uint64 node_id,
+                                 const ::p4::v1::WriteRequest& req,
+                                 const std::vector<bool>& applied) {
+  absl::ReaderMutexLock l(&controller_lock_);
+  auto it = node_id_to_controller_manager_.find(node_id);
+  if (it == node_id_to_controller_manager_.end()) return;
+  it->second.SettleEntryQuota(req, applied);
+}
+
+void P4Service::ReconcileEntryUsage(uint64 node_id) {
+  {
+    absl::ReaderMutexLock l(&controller_lock_);
+    auto it = node_id_to_controller_manager_.find(node_id);
+    if (it == node_id_to_controller_manager_.end() ||
+        !it->second.TakeStaleEntryUsage()) {
+      return;
+    }
+  }
+
+  // The switch is read without controller_lock_ held. The writes in flight
+  // meanwhile are accounted for by the controller manager.
+  ::p4::v1::ReadRequest req;
+  req.set_device_id(node_id);
+  req.add_entities()->mutable_table_entry();
+  req.add_entities()->mutable_action_profile_member();
+  req.add_entities()->mutable_action_profile_group();
+  EntryCountingWriter writer;
+  std::vector<::util::Status> details = {};
+  ::util::Status status =
+      switch_interface_->ReadForwardingEntries(req, &writer, &details);
+
+  absl::ReaderMutexLock l(&controller_lock_);
+  auto it = node_id_to_controller_manager_.find(node_id);
+  if (it == node_id_to_controller_manager_.end()) return;
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to read the forwarding entries of node " << node_id
+               << " to reconcile entry quotas: " << status.error_message();
+    // Retried on the next arbitration or pipeline push.
+    it->second.MarkEntryUsageStale();
+    return;
+  }
+  it->second.ReconcileEntryUsage(writer.entry_counts());
+
+  for (const auto& usage : it->second.GetEntryQuotaUsage()) {
+    VLOG(1) << "Role " << usage.role_name.value_or("<default>") << " of node "
+            << node_id << " uses " << usage.entries << " of "
+            << usage.max_entries << " entries for P4 entity " << usage.p4_id
+            << ".";
+  }
+}
+
+::util::Status P4Service::GetEntryQuotaUsage(uint64 node_id,
+                                             EntryQuotaUsage* usage) {
+  absl::ReaderMutexLock l(&controller_lock_);
+  auto it = node_id_to_controller_manager_.find(node_id);
+  if (it == node_id_to_controller_manager_.end()) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND).without_logging()
+           << "No controller has connected to node " << node_id << " yet.";
+  }
+  usage->Clear();
+  for (const auto& quota_usage : it->second.GetEntryQuotaUsage()) {
+    auto* quota = usage->add_quotas();
+    quota->set_role(quota_usage.role_name.value_or(""));
+    quota->set_p4_id(quota_usage.p4_id);
+    quota->set_entries(quota_usage.entries);
+    quota->set_max_entries(quota_usage.max_entries);
+  }
+
+  return ::util::OkStatus();
+}
+
 bool P4Service::IsWritePermitted(uint64 node_id,
                                  const ::p4::v1::WriteRequest& req) const {
   absl::ReaderMutexLock l(&controller_lock_);
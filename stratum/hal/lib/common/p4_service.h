@@ -23,6 +23,7 @@
 #include "stratum/glue/integral_types.h"
 #include "stratum/glue/status/status.h"
 #include "stratum/glue/status/statusor.h"
+#include "stratum/hal/lib/common/admission_controller.h"
 #include "stratum/hal/lib/common/channel_writer_wrapper.h"
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/hal/lib/common/error_buffer.h"
@@ -104,6 +105,12 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
       const ::p4::v1::CapabilitiesRequest* request,
       ::p4::v1::CapabilitiesResponse* response) override;
 
+  // Returns the usage of the entry quotas of the controller roles of a node,
+  // as published over gNMI. Returns ERR_ENTRY_NOT_FOUND if no controller has
+  // connected to the node yet.
+  ::util::Status GetEntryQuotaUsage(uint64 node_id, EntryQuotaUsage* usage)
+      LOCKS_EXCLUDED(controller_lock_);
+
   // P4Service is neither copyable nor movable.
   P4Service(const P4Service&) = delete;
   P4Service& operator=(const P4Service&) = delete;
@@ -139,6 +146,12 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
       uint64 node_id, const ::p4::v1::MasterArbitrationUpdate& update,
       p4runtime::SdnConnection* controller) LOCKS_EXCLUDED(controller_lock_);
 
+  // Non-locking internal version of AddOrModifyController().
+  ::util::Status DoAddOrModifyController(
+      uint64 node_id, const ::p4::v1::MasterArbitrationUpdate& update,
+      p4runtime::SdnConnection* controller)
+      EXCLUSIVE_LOCKS_REQUIRED(controller_lock_);
+
   // Removes an existing controller from the controller manager given its
   // stream. To be called after stream from an existing controller is broken
   // (e.g. controller is disconnected).
@@ -158,6 +171,26 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
   bool IsReadPermitted(uint64 node_id, const ::p4::v1::ReadRequest& req) const
       LOCKS_EXCLUDED(controller_lock_);
 
+  // Reserves the entry quotas of the writing role for the inserts in a Write
+  // request. Returns one status per update, which is not OK for the updates
+  // that exceed a quota and must not be written to the switch.
+  std::vector<::util::Status> ReserveEntryQuota(
+      uint64 node_id, const ::p4::v1::WriteRequest& req)
+      LOCKS_EXCLUDED(controller_lock_);
+
+  // Returns the quota reservations of the updates which were not applied, and
+  // frees the quota of the applied deletes. 'applied' has one element per
+  // update of the request.
+  void SettleEntryQuota(uint64 node_id, const ::p4::v1::WriteRequest& req,
+                        const std::vector<bool>& applied)
+      LOCKS_EXCLUDED(controller_lock_);
+
+  // Recounts the entry usage of the controller roles of a node from the
+  // entries read back from the switch. Does nothing unless the usage was
+  // marked stale, e.g. by a role config change, and a role of the node has
+  // entry quotas. controller_lock_ is not held while reading the switch.
+  void ReconcileEntryUsage(uint64 node_id) LOCKS_EXCLUDED(controller_lock_);
+
   // Returns true if the given role and election_id belongs to the master
   // controller stream for a node given by its node ID.
   bool IsMasterController(
@@ -258,6 +291,10 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
   // by this class.
   ErrorBuffer* error_buffer_;
 
+  // Admission controller bounding the concurrent P4Runtime writes, with a
+  // priority lane for the StreamChannel messages. Owned by this class.
+  std::unique_ptr<AdmissionController> admission_controller_;
+
   friend class P4ServiceTest;
 };
 
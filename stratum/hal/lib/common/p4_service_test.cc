@@ -5,18 +5,25 @@
 #include "stratum/hal/lib/common/p4_service.h"
 
 #include <memory>
+#include <thread>  // NOLINT
 #include <tuple>
+#include <vector>
 
 #include "absl/memory/memory.h"
 #include "absl/numeric/int128.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "gflags/gflags.h"
 #include "gmock/gmock.h"
 #include "google/rpc/code.pb.h"
 #include "grpcpp/grpcpp.h"
 #include "gtest/gtest.h"
 #include "stratum/glue/integral_types.h"
+#include "stratum/glue/logging.h"
 #include "stratum/glue/net_util/ports.h"
 #include "stratum/glue/status/status_test_util.h"
 #include "stratum/hal/lib/common/error_buffer.h"
@@ -140,20 +147,53 @@ class P4ServiceTest
   void AddFakeMasterController(
       uint64 node_id, p4runtime::SdnConnection* controller,
       const P4RoleConfig& role_config = GetRoleConfig()) {
+    AddFakeMasterController(node_id, controller, role_name_, role_config);
+  }
+
+  void AddFakeMasterController(uint64 node_id,
+                               p4runtime::SdnConnection* controller,
+                               const std::string& role_name,
+                               const P4RoleConfig& role_config) {
     p4::v1::MasterArbitrationUpdate request;
     request.set_device_id(node_id);
     request.mutable_election_id()->set_high(
         absl::Uint128High64(controller->GetElectionId().value()));
     request.mutable_election_id()->set_low(
         absl::Uint128Low64(controller->GetElectionId().value()));
-    if (!role_name_.empty()) {
-      request.mutable_role()->set_name(role_name_);
+    if (!role_name.empty()) {
+      request.mutable_role()->set_name(role_name);
       ASSERT_TRUE(
           request.mutable_role()->mutable_config()->PackFrom(role_config));
     }
     ASSERT_OK(p4_service_->AddOrModifyController(node_id, request, controller));
   }
 
+  // Adds an update of the given type for an entry in the given table.
+  static void AddTableEntryUpdate(::p4::v1::WriteRequest* req,
+                                  ::p4::v1::Update::Type type,
+                                  uint32 table_id) {
+    auto* update = req->add_updates();
+    update->set_type(type);
+    update->mutable_entity()->mutable_table_entry()->set_table_id(table_id);
+  }
+
+  // Expects a wildcard read from the entry quota reconciliation, which finds
+  // the given number of entries in kTableId1.
+  void ExpectEntryCountRead(int num_entries) {
+    ::p4::v1::ReadResponse resp;
+    for (int i = 0; i < num_entries; ++i) {
+      resp.add_entities()->mutable_table_entry()->set_table_id(kTableId1);
+    }
+    EXPECT_CALL(*switch_mock_, ReadForwardingEntries(_, _, _))
+        .WillOnce(DoAll(
+            WithArgs<1>(Invoke(
+                [resp](WriterInterface<::p4::v1::ReadResponse>* writer) {
+                  writer->Write(resp);
+                })),
+            Return(::util::OkStatus())))
+        .RetiresOnSaturation();
+  }
+
   int GetNumberOfActiveConnections(uint64 node_id) {
     absl::WriterMutexLock l(&p4_service_->controller_lock_);
     if (!p4_service_->node_id_to_controller_manager_.count(node_id)) return 0;
@@ -161,6 +201,20 @@ class P4ServiceTest
         .ActiveConnections();
   }
 
+  void SetAdmissionOptions(const AdmissionController::Options& options) {
+    p4_service_->admission_controller_ =
+        AdmissionController::CreateInstance(options);
+  }
+
+  uint64 GetNumAdmitted(AdmissionController::Lane lane) {
+    return p4_service_->admission_controller_->GetNumAdmitted(lane);
+  }
+
+  bool IsWriteDropping(uint64 node_id) {
+    return p4_service_->admission_controller_->IsDropping(
+        absl::StrCat(node_id, "/", role_name_));
+  }
+
   int GetNumberOfConnections() {
     absl::WriterMutexLock l(&p4_service_->controller_lock_);
     return p4_service_->num_controller_connections_;
@@ -244,6 +298,13 @@ class P4ServiceTest
       receives_packet_ins: true
       can_push_pipeline: true
   )pb";
+  static constexpr char kQuotaRoleConfigText[] = R"pb(
+      exclusive_p4_ids: 12  # kTableId1
+      shared_p4_ids: 13  # kTableId2
+      entry_quotas { p4_id: 12 max_entries: 2 }
+      entry_quotas { p4_id: 13 max_entries: 1 }
+      can_push_pipeline: true
+  )pb";
   static constexpr char kRoleName1[] = "TestRole1";
   static constexpr char kRoleName2[] = "TestRole2";
   static constexpr char kOperErrorMsg[] = "Some error";
@@ -256,6 +317,7 @@ class P4ServiceTest
   static constexpr absl::uint128 kElectionId2 = 2222;
   static constexpr absl::uint128 kElectionId3 = 1212;
   static constexpr uint32 kTableId1 = 12;
+  static constexpr uint32 kTableId2 = 13;
   static constexpr uint64 kCookie1 = 123;
   static constexpr uint64 kCookie2 = 321;
   OperationMode mode_;
@@ -277,6 +339,7 @@ constexpr char P4ServiceTest::kTestPacketMetadata5[];
 constexpr char P4ServiceTest::kTestDigestList1[];
 constexpr char P4ServiceTest::kTestDigestListAck1[];
 constexpr char P4ServiceTest::kRoleConfigText[];
+constexpr char P4ServiceTest::kQuotaRoleConfigText[];
 constexpr char P4ServiceTest::kRoleName1[];
 constexpr char P4ServiceTest::kRoleName2[];
 constexpr char P4ServiceTest::kOperErrorMsg[];
@@ -289,6 +352,7 @@ constexpr absl::uint128 P4ServiceTest::kElectionId1;
 constexpr absl::uint128 P4ServiceTest::kElectionId2;
 constexpr absl::uint128 P4ServiceTest::kElectionId3;
 constexpr uint32 P4ServiceTest::kTableId1;
+constexpr uint32 P4ServiceTest::kTableId2;
 
 TEST_P(P4ServiceTest, ColdbootSetupSuccessForSavedConfigs) {
   if (mode_ == OPERATION_MODE_COUPLED) return;
@@ -996,6 +1060,504 @@ TEST_P(P4ServiceTest, WriteFailureForWritingOutsideRoleAllowedTable) {
   EXPECT_TRUE(status.error_details().empty());
 }
 
+TEST_P(P4ServiceTest, WriteFailureForEntryQuotaExceeded) {
+  // This test is specific to role configs.
+  if (role_name_.empty()) {
+    GTEST_SKIP();
+  }
+
+  SetTestForwardingPipelineConfigs();
+  ::grpc::ServerContext server_context;
+  StreamMessageReaderWriterMock stream;
+  p4runtime::SdnConnection controller(&server_context, &stream);
+  controller.SetElectionId(kElectionId1);
+  controller.SetRoleName(kRoleName1);
+  P4RoleConfig role_config;
+  ASSERT_OK(ParseProtoFromString(kQuotaRoleConfigText, &role_config));
+  // One entry of kTableId1 is already on the switch when the role connects.
+  ExpectEntryCountRead(1);
+  AddFakeMasterController(kNodeId1, &controller, role_config);
+
+  ::p4::v1::WriteRequest req;
+  req.set_device_id(kNodeId1);
+  req.mutable_election_id()->set_high(absl::Uint128High64(kElectionId1));
+  req.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+  req.set_role(role_name_);
+  AddTableEntryUpdate(&req, ::p4::v1::Update::INSERT, kTableId1);
+  AddTableEntryUpdate(&req, ::p4::v1::Update::INSERT, kTableId1);
+  AddTableEntryUpdate(&req, ::p4::v1::Update::MODIFY, kTableId1);
+
+  // Only the first insert fits into the quota.
+  ::p4::v1::WriteRequest admitted_req = req;
+  admitted_req.mutable_updates()->DeleteSubrange(1, 1);
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", "Write", _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  const std::vector<::util::Status> kExpectedResults = {::util::OkStatus(),
+                                                        ::util::OkStatus()};
+  EXPECT_CALL(*switch_mock_,
+              WriteForwardingEntries(EqualsProto(admitted_req), _))
+      .WillOnce(DoAll(SetArgPointee<1>(kExpectedResults),
+                      Return(::util::OkStatus())));
+
+  // Invoke the RPC and validate the results.
+  {
+    ::grpc::ClientContext context;
+    ::p4::v1::WriteResponse resp;
+    ::grpc::Status status = stub_->Write(&context, req, &resp);
+    EXPECT_FALSE(status.ok());
+    ::google::rpc::Status details;
+    ASSERT_TRUE(details.ParseFromString(status.error_details()));
+    ASSERT_EQ(3, details.details_size());
+    ::p4::v1::Error detail;
+    ASSERT_TRUE(details.details(0).UnpackTo(&detail));
+    EXPECT_EQ(::google::rpc::OK, detail.canonical_code());
+    ASSERT_TRUE(details.details(1).UnpackTo(&detail));
+    EXPECT_EQ(::google::rpc::RESOURCE_EXHAUSTED, detail.canonical_code());
+    EXPECT_THAT(detail.message(), HasSubstr("quota of 2 entries"));
+    ASSERT_TRUE(details.details(2).UnpackTo(&detail));
+    EXPECT_EQ(::google::rpc::OK, detail.canonical_code());
+  }
+
+  // A delete frees the quota for the next insert.
+  ::p4::v1::WriteRequest delete_req = req;
+  delete_req.clear_updates();
+  AddTableEntryUpdate(&delete_req, ::p4::v1::Update::DELETE, kTableId1);
+  ::p4::v1::WriteRequest insert_req = req;
+  insert_req.clear_updates();
+  AddTableEntryUpdate(&insert_req, ::p4::v1::Update::INSERT, kTableId1);
+  const std::vector<::util::Status> kExpectedResult = {::util::OkStatus()};
+  EXPECT_CALL(*switch_mock_, WriteForwardingEntries(EqualsProto(delete_req), _))
+      .WillOnce(DoAll(SetArgPointee<1>(kExpectedResult),
+                      Return(::util::OkStatus())));
+  EXPECT_CALL(*switch_mock_, WriteForwardingEntries(EqualsProto(insert_req), _))
+      .WillOnce(DoAll(SetArgPointee<1>(kExpectedResult),
+                      Return(::util::OkStatus())));
+  for (const auto& next_req : {delete_req, insert_req}) {
+    ::grpc::ClientContext context;
+    ::p4::v1::WriteResponse resp;
+    EXPECT_TRUE(stub_->Write(&context, next_req, &resp).ok());
+  }
+}
+
+TEST_P(P4ServiceTest, WriteEntryQuotasAreSeparatePerRole) {
+  // This test is specific to role configs.
+  if (role_name_.empty()) {
+    GTEST_SKIP();
+  }
+
+  SetTestForwardingPipelineConfigs();
+  P4RoleConfig role_config;
+  ASSERT_OK(ParseProtoFromString(kQuotaRoleConfigText, &role_config));
+  ::grpc::ServerContext server_context;
+  StreamMessageReaderWriterMock stream1;
+  p4runtime::SdnConnection controller1(&server_context, &stream1);
+  controller1.SetElectionId(kElectionId1);
+  controller1.SetRoleName(kRoleName1);
+  ExpectEntryCountRead(0);
+  AddFakeMasterController(kNodeId1, &controller1, role_config);
+
+  // The second role shares kTableId2 and has its own quota for it.
+  role_config.clear_exclusive_p4_ids();
+  role_config.mutable_entry_quotas()->DeleteSubrange(0, 1);
+  StreamMessageReaderWriterMock stream2;
+  p4runtime::SdnConnection controller2(&server_context, &stream2);
+  controller2.SetElectionId(kElectionId1);
+  controller2.SetRoleName(kRoleName2);
+  ExpectEntryCountRead(0);
+  AddFakeMasterController(kNodeId1, &controller2, kRoleName2, role_config);
+
+  ::p4::v1::WriteRequest req1;
+  req1.set_device_id(kNodeId1);
+  req1.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+  req1.set_role(kRoleName1);
+  AddTableEntryUpdate(&req1, ::p4::v1::Update::INSERT, kTableId2);
+  ::p4::v1::WriteRequest req2 = req1;
+  req2.set_role(kRoleName2);
+
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", "Write", _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  const std::vector<::util::Status> kExpectedResult = {::util::OkStatus()};
+  EXPECT_CALL(*switch_mock_, WriteForwardingEntries(EqualsProto(req1), _))
+      .WillOnce(DoAll(SetArgPointee<1>(kExpectedResult),
+                      Return(::util::OkStatus())));
+  EXPECT_CALL(*switch_mock_, WriteForwardingEntries(EqualsProto(req2), _))
+      .WillOnce(DoAll(SetArgPointee<1>(kExpectedResult),
+                      Return(::util::OkStatus())));
+
+  // Both roles fill their own quota, and the next insert of the first role
+  // does not reach the switch.
+  for (const auto& req : {req1, req2}) {
+    ::grpc::ClientContext context;
+    ::p4::v1::WriteResponse resp;
+    EXPECT_TRUE(stub_->Write(&context, req, &resp).ok());
+  }
+  ::grpc::ClientContext context;
+  ::p4::v1::WriteResponse resp;
+  ::grpc::Status status = stub_->Write(&context, req1, &resp);
+  EXPECT_FALSE(status.ok());
+  ::google::rpc::Status details;
+  ASSERT_TRUE(details.ParseFromString(status.error_details()));
+  ASSERT_EQ(1, details.details_size());
+  ::p4::v1::Error detail;
+  ASSERT_TRUE(details.details(0).UnpackTo(&detail));
+  EXPECT_EQ(::google::rpc::RESOURCE_EXHAUSTED, detail.canonical_code());
+  EXPECT_THAT(detail.message(), HasSubstr(kRoleName1));
+}
+
+TEST_P(P4ServiceTest, WriteEntryQuotaIsReturnedForFailedInserts) {
+  // This test is specific to role configs.
+  if (role_name_.empty()) {
+    GTEST_SKIP();
+  }
+
+  SetTestForwardingPipelineConfigs();
+  ::grpc::ServerContext server_context;
+  StreamMessageReaderWriterMock stream;
+  p4runtime::SdnConnection controller(&server_context, &stream);
+  controller.SetElectionId(kElectionId1);
+  controller.SetRoleName(kRoleName1);
+  P4RoleConfig role_config;
+  ASSERT_OK(ParseProtoFromString(kQuotaRoleConfigText, &role_config));
+  ExpectEntryCountRead(0);
+  AddFakeMasterController(kNodeId1, &controller, role_config);
+
+  ::p4::v1::WriteRequest req;
+  req.set_device_id(kNodeId1);
+  req.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+  req.set_role(role_name_);
+  AddTableEntryUpdate(&req, ::p4::v1::Update::INSERT, kTableId2);
+
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", "Write", _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  const std::vector<::util::Status> kFailedResult = {
+      ::util::Status(StratumErrorSpace(), ERR_TABLE_FULL, kOperErrorMsg)};
+  const std::vector<::util::Status> kExpectedResult = {::util::OkStatus()};
+  EXPECT_CALL(*switch_mock_, WriteForwardingEntries(EqualsProto(req), _))
+      .WillOnce(DoAll(
+          SetArgPointee<1>(kFailedResult),
+          Return(::util::Status(StratumErrorSpace(),
+                                ERR_AT_LEAST_ONE_OPER_FAILED, kAggrErrorMsg))))
+      .WillOnce(DoAll(SetArgPointee<1>(kExpectedResult),
+                      Return(::util::OkStatus())));
+
+  // The failed insert does not use up the quota of one entry.
+  {
+    ::grpc::ClientContext context;
+    ::p4::v1::WriteResponse resp;
+    EXPECT_FALSE(stub_->Write(&context, req, &resp).ok());
+  }
+  ::grpc::ClientContext context;
+  ::p4::v1::WriteResponse resp;
+  EXPECT_TRUE(stub_->Write(&context, req, &resp).ok());
+}
+
+TEST_P(P4ServiceTest, WriteEntryQuotaIsReconciledOnPipelinePush) {
+  // This test is specific to role configs.
+  if (role_name_.empty()) {
+    GTEST_SKIP();
+  }
+
+  SetTestForwardingPipelineConfigs();
+  ::grpc::ServerContext server_context;
+  StreamMessageReaderWriterMock stream;
+  p4runtime::SdnConnection controller(&server_context, &stream);
+  controller.SetElectionId(kElectionId1);
+  controller.SetRoleName(kRoleName1);
+  P4RoleConfig role_config;
+  ASSERT_OK(ParseProtoFromString(kQuotaRoleConfigText, &role_config));
+  // The switch already holds the full quota when the role connects.
+  ExpectEntryCountRead(2);
+  AddFakeMasterController(kNodeId1, &controller, role_config);
+
+  ::p4::v1::WriteRequest req;
+  req.set_device_id(kNodeId1);
+  req.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+  req.set_role(role_name_);
+  AddTableEntryUpdate(&req, ::p4::v1::Update::INSERT, kTableId1);
+
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", "Write", _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  {
+    ::grpc::ClientContext context;
+    ::p4::v1::WriteResponse resp;
+    ::grpc::Status status = stub_->Write(&context, req, &resp);
+    EXPECT_FALSE(status.ok());
+  }
+
+  // The new pipeline starts with empty tables.
+  ::p4::v1::SetForwardingPipelineConfigRequest push_req;
+  push_req.set_device_id(kNodeId1);
+  push_req.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+  push_req.set_role(role_name_);
+  push_req.set_action(
+      ::p4::v1::SetForwardingPipelineConfigRequest::VERIFY_AND_COMMIT);
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("P4Service", "SetForwardingPipelineConfig", _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, PushForwardingPipelineConfig(kNodeId1, _))
+      .WillOnce(Return(::util::OkStatus()));
+  ExpectEntryCountRead(0);
+  {
+    ::grpc::ClientContext context;
+    ::p4::v1::SetForwardingPipelineConfigResponse resp;
+    EXPECT_TRUE(
+        stub_->SetForwardingPipelineConfig(&context, push_req, &resp).ok());
+  }
+
+  const std::vector<::util::Status> kExpectedResult = {::util::OkStatus()};
+  EXPECT_CALL(*switch_mock_, WriteForwardingEntries(EqualsProto(req), _))
+      .WillOnce(DoAll(SetArgPointee<1>(kExpectedResult),
+                      Return(::util::OkStatus())));
+  ::grpc::ClientContext context;
+  ::p4::v1::WriteResponse resp;
+  EXPECT_TRUE(stub_->Write(&context, req, &resp).ok());
+}
+
+TEST_P(P4ServiceTest, EntryQuotaUsageIsOnlyReconciledOnRoleConfigChange) {
+  // This test is specific to role configs.
+  if (role_name_.empty()) {
+    GTEST_SKIP();
+  }
+
+  SetTestForwardingPipelineConfigs();
+  ::grpc::ServerContext server_context;
+  StreamMessageReaderWriterMock stream;
+  p4runtime::SdnConnection controller(&server_context, &stream);
+  controller.SetElectionId(kElectionId1);
+  controller.SetRoleName(kRoleName1);
+  P4RoleConfig role_config;
+  ASSERT_OK(ParseProtoFromString(kQuotaRoleConfigText, &role_config));
+  EXPECT_CALL(*switch_mock_, ReadForwardingEntries(_, _, _)).Times(0);
+  ExpectEntryCountRead(1);
+  AddFakeMasterController(kNodeId1, &controller, role_config);
+
+  // The same role config does not need the switch to be read again.
+  AddFakeMasterController(kNodeId1, &controller, role_config);
+  EntryQuotaUsage usage;
+  ASSERT_OK(p4_service_->GetEntryQuotaUsage(kNodeId1, &usage));
+  ASSERT_EQ(2, usage.quotas_size());
+  EXPECT_EQ(kRoleName1, usage.quotas(0).role());
+  EXPECT_EQ(kTableId1, usage.quotas(0).p4_id());
+  EXPECT_EQ(1U, usage.quotas(0).entries());
+  EXPECT_EQ(2U, usage.quotas(0).max_entries());
+
+  // A changed role config does.
+  role_config.mutable_entry_quotas(0)->set_max_entries(3);
+  ExpectEntryCountRead(2);
+  AddFakeMasterController(kNodeId1, &controller, role_config);
+  ASSERT_OK(p4_service_->GetEntryQuotaUsage(kNodeId1, &usage));
+  ASSERT_EQ(2, usage.quotas_size());
+  EXPECT_EQ(2U, usage.quotas(0).entries());
+  EXPECT_EQ(3U, usage.quotas(0).max_entries());
+}
+
+TEST_P(P4ServiceTest, EntryQuotaUsageReconcileCountsWritesInFlight) {
+  // This test is specific to role configs.
+  if (role_name_.empty()) {
+    GTEST_SKIP();
+  }
+
+  SetTestForwardingPipelineConfigs();
+  ::grpc::ServerContext server_context;
+  StreamMessageReaderWriterMock stream;
+  p4runtime::SdnConnection controller(&server_context, &stream);
+  controller.SetElectionId(kElectionId1);
+  controller.SetRoleName(kRoleName1);
+  P4RoleConfig role_config;
+  ASSERT_OK(ParseProtoFromString(kQuotaRoleConfigText, &role_config));
+  ExpectEntryCountRead(0);
+  AddFakeMasterController(kNodeId1, &controller, role_config);
+
+  ::p4::v1::WriteRequest req;
+  req.set_device_id(kNodeId1);
+  req.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+  req.set_role(role_name_);
+  AddTableEntryUpdate(&req, ::p4::v1::Update::INSERT, kTableId1);
+
+  // A new role config arrives while the insert is being written, and the
+  // read of its reconciliation does not see the insert yet.
+  P4RoleConfig new_role_config = role_config;
+  new_role_config.mutable_entry_quotas(0)->set_max_entries(3);
+  ExpectEntryCountRead(0);
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", "Write", _))
+      .WillOnce(Return(::util::OkStatus()));
+  const std::vector<::util::Status> kExpectedResult = {::util::OkStatus()};
+  EXPECT_CALL(*switch_mock_, WriteForwardingEntries(EqualsProto(req), _))
+      .WillOnce(DoAll(Invoke([&](const ::p4::v1::WriteRequest&,
+                                 std::vector<::util::Status>*) {
+                        AddFakeMasterController(kNodeId1, &controller,
+                                                new_role_config);
+                      }),
+                      SetArgPointee<1>(kExpectedResult),
+                      Return(::util::OkStatus())));
+  {
+    ::grpc::ClientContext context;
+    ::p4::v1::WriteResponse resp;
+    EXPECT_TRUE(stub_->Write(&context, req, &resp).ok());
+  }
+
+  EntryQuotaUsage usage;
+  ASSERT_OK(p4_service_->GetEntryQuotaUsage(kNodeId1, &usage));
+  ASSERT_EQ(2, usage.quotas_size());
+  EXPECT_EQ(kTableId1, usage.quotas(0).p4_id());
+  EXPECT_EQ(1U, usage.quotas(0).entries());
+  EXPECT_EQ(3U, usage.quotas(0).max_entries());
+}
+
+TEST_P(P4ServiceTest, GetEntryQuotaUsageFailsForUnknownNode) {
+  EntryQuotaUsage usage;
+  ::util::Status status = p4_service_->GetEntryQuotaUsage(kNodeId1, &usage);
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, status.error_code());
+}
+
+TEST_P(P4ServiceTest, WriteOverloadIsRejectedWithoutDelayingArbitration) {
+  constexpr int kNumWriters = 8;
+  // Only one update in flight at a time.
+  AdmissionController::Options options;
+  options.max_updates_per_controller = 1;
+  options.max_updates = 1;
+  options.target_queue_delay = absl::Milliseconds(10);
+  options.interval = absl::Milliseconds(50);
+  SetAdmissionOptions(options);
+  SetTestForwardingPipelineConfigs();
+  ::grpc::ServerContext server_context;
+  StreamMessageReaderWriterMock stream;
+  p4runtime::SdnConnection controller(&server_context, &stream);
+  controller.SetElectionId(kElectionId1);
+  AddFakeMasterController(kNodeId1, &controller);
+
+  ::p4::v1::WriteRequest req;
+  req.set_device_id(kNodeId1);
+  req.mutable_election_id()->set_high(absl::Uint128High64(kElectionId1));
+  req.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+  req.set_role(role_name_);
+  req.add_updates()->set_type(::p4::v1::Update::INSERT);
+  req.mutable_updates(0)->mutable_entity()->mutable_table_entry()->set_table_id(
+      kTableId1);
+
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", "Write", _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("P4Service", "StreamChannel", _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  // The switch is stuck on the admitted write until released.
+  absl::Notification write_started, write_release;
+  EXPECT_CALL(*switch_mock_, WriteForwardingEntries(EqualsProto(req), _))
+      .WillOnce(WithArgs<1>(Invoke([&](std::vector<::util::Status>* results) {
+        write_started.Notify();
+        write_release.WaitForNotification();
+        results->push_back(::util::OkStatus());
+        return ::util::OkStatus();
+      })));
+  EXPECT_CALL(*switch_mock_, RegisterStreamMessageResponseWriter(kNodeId2, _))
+      .WillOnce(Return(::util::OkStatus()));
+
+  // Saturate the write budget.
+  ::grpc::Status admitted_status;
+  std::thread admitted_writer([&]() {
+    ::grpc::ClientContext context;
+    ::p4::v1::WriteResponse resp;
+    admitted_status = stub_->Write(&context, req, &resp);
+  });
+  write_started.WaitForNotification();
+
+  // Further writes are rejected with a retry hint. They all complete while
+  // the admitted write is still stuck, i.e. none of them waits for it.
+  std::vector<::grpc::Status> statuses(kNumWriters);
+  std::vector<std::string> retry_hints(kNumWriters);
+  std::vector<std::thread> writers;
+  for (int i = 0; i < kNumWriters; ++i) {
+    writers.emplace_back([&, i]() {
+      ::grpc::ClientContext context;
+      ::p4::v1::WriteResponse resp;
+      statuses[i] = stub_->Write(&context, req, &resp);
+      const auto& metadata = context.GetServerTrailingMetadata();
+      auto it = metadata.find("grpc-retry-pushback-ms");
+      if (it != metadata.end()) {
+        retry_hints[i] = std::string(it->second.data(), it->second.length());
+      }
+    });
+  }
+  for (auto& writer : writers) writer.join();
+  for (int i = 0; i < kNumWriters; ++i) {
+    EXPECT_EQ(::grpc::StatusCode::RESOURCE_EXHAUSTED, statuses[i].error_code());
+    EXPECT_THAT(statuses[i].error_message(), HasSubstr("Retry after"));
+    EXPECT_FALSE(retry_hints[i].empty());
+  }
+
+  // Arbitration completes while the switch is still stuck on the write.
+  ::grpc::ClientContext stream_context;
+  ::p4::v1::StreamMessageRequest arbitration;
+  ::p4::v1::StreamMessageResponse resp;
+  arbitration.mutable_arbitration()->set_device_id(kNodeId2);
+  arbitration.mutable_arbitration()->mutable_election_id()->set_high(
+      absl::Uint128High64(kElectionId2));
+  arbitration.mutable_arbitration()->mutable_election_id()->set_low(
+      absl::Uint128Low64(kElectionId2));
+  const absl::Time start = absl::Now();
+  std::unique_ptr<ClientStreamChannelReaderWriter> stream_channel =
+      stub_->StreamChannel(&stream_context);
+  ASSERT_TRUE(stream_channel->Write(arbitration));
+  ASSERT_TRUE(stream_channel->Read(&resp));
+  LOG(INFO) << "Arbitration took " << absl::Now() - start
+            << " with the write budget saturated.";
+  EXPECT_EQ(::google::rpc::OK, resp.arbitration().status().code());
+
+  write_release.Notify();
+  admitted_writer.join();
+  EXPECT_TRUE(admitted_status.ok());
+  stream_channel->WritesDone();
+  ASSERT_TRUE(stream_channel->Finish().ok());
+  EXPECT_EQ(1, GetNumAdmitted(AdmissionController::kBulkLane));
+  EXPECT_EQ(1, GetNumAdmitted(AdmissionController::kPriorityLane));
+}
+
+// The queue delay is the time before the switch write starts, so writes which
+// are slow in the switch but never wait do not trigger the early rejection.
+TEST_P(P4ServiceTest, SlowSwitchWritesAreNotRejectedEarly) {
+  AdmissionController::Options options;
+  options.target_queue_delay = absl::Milliseconds(10);
+  options.interval = absl::Milliseconds(20);
+  SetAdmissionOptions(options);
+  SetTestForwardingPipelineConfigs();
+  ::grpc::ServerContext server_context;
+  StreamMessageReaderWriterMock stream;
+  p4runtime::SdnConnection controller(&server_context, &stream);
+  controller.SetElectionId(kElectionId1);
+  AddFakeMasterController(kNodeId1, &controller);
+
+  ::p4::v1::WriteRequest req;
+  req.set_device_id(kNodeId1);
+  req.mutable_election_id()->set_high(absl::Uint128High64(kElectionId1));
+  req.mutable_election_id()->set_low(absl::Uint128Low64(kElectionId1));
+  req.set_role(role_name_);
+  req.add_updates()->set_type(::p4::v1::Update::INSERT);
+  req.mutable_updates(0)->mutable_entity()->mutable_table_entry()->set_table_id(
+      kTableId1);
+
+  constexpr int kNumWrites = 4;
+  EXPECT_CALL(*auth_policy_checker_mock_, Authorize("P4Service", "Write", _))
+      .Times(kNumWrites)
+      .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, WriteForwardingEntries(EqualsProto(req), _))
+      .Times(kNumWrites)
+      .WillRepeatedly(
+          WithArgs<1>(Invoke([](std::vector<::util::Status>* results) {
+            absl::SleepFor(absl::Milliseconds(50));
+            results->push_back(::util::OkStatus());
+            return ::util::OkStatus();
+          })));
+
+  for (int i = 0; i < kNumWrites; ++i) {
+    ::grpc::ClientContext context;
+    ::p4::v1::WriteResponse resp;
+    ::grpc::Status status = stub_->Write(&context, req, &resp);
+    EXPECT_TRUE(status.ok()) << status.error_message();
+  }
+  EXPECT_FALSE(IsWriteDropping(kNodeId1));
+  EXPECT_EQ(kNumWrites, GetNumAdmitted(AdmissionController::kBulkLane));
+}
+
 TEST_P(P4ServiceTest, ReadSuccess) {
   SetTestForwardingPipelineConfigs();
   ::grpc::ClientContext context;
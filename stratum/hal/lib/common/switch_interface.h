@@ -16,6 +16,7 @@
 #include "stratum/hal/lib/common/gnmi_events.h"
 #include "stratum/hal/lib/common/writer_interface.h"
 #include "stratum/lib/channel/channel.h"
+#include "stratum/public/proto/gnmi_extensions.pb.h"
 
 namespace stratum {
 namespace hal {
@@ -59,6 +60,14 @@ class SwitchInterface {
   // coldboot/warmboot mode.
   virtual ::util::Status VerifyChassisConfig(const ChassisConfig& config) = 0;
 
+  // Computes the node and port operations that pushing the given ChassisConfig
+  // proto would perform, and whether they are disruptive, without pushing
+  // anything to the hardware. The config is verified as in
+  // VerifyChassisConfig(), except that a config which needs a reboot to be
+  // applied is reported in the plan rather than as an error.
+  virtual ::util::Status PlanChassisConfig(const ChassisConfig& config,
+                                           ChassisConfigPlan* plan) = 0;
+
   // Pushes the P4-based forwarding pipeline configuration of a switching node.
   // ::p4::ForwardingPipelineConfig proto passed to this method is generated by
   // a P4 compiler and is conceptually different from ChassisConfig passed to
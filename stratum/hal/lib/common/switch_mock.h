@@ -21,6 +21,8 @@ class SwitchMock : public SwitchInterface {
   MOCK_METHOD1(PushChassisConfig, ::util::Status(const ChassisConfig& config));
   MOCK_METHOD1(VerifyChassisConfig,
                ::util::Status(const ChassisConfig& config));
+  MOCK_METHOD2(PlanChassisConfig, ::util::Status(const ChassisConfig& config,
+                                                 ChassisConfigPlan* plan));
   MOCK_METHOD2(
       PushForwardingPipelineConfig,
       ::util::Status(uint64 node_id,
@@ -0,0 +1,448 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/telemetry_history.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "stratum/glue/logging.h"
+#include "stratum/hal/lib/common/gnmi_events.h"
+#include "stratum/lib/macros.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+
+namespace {
+
+void PutVarint(uint64 value, std::string* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+bool GetVarint(const std::string& data, size_t* offset, uint64* value) {
+  *value = 0;
+  for (int shift = 0; shift < 64 && *offset < data.size(); shift += 7) {
+    const uint8 byte = static_cast<uint8>(data[(*offset)++]);
+    *value |= static_cast<uint64>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+uint64 ZigZagEncode(int64 value) {
+  return (static_cast<uint64>(value) << 1) ^ static_cast<uint64>(value >> 63);
+}
+
+int64 ZigZagDecode(uint64 value) {
+  return static_cast<int64>(value >> 1) ^ -static_cast<int64>(value & 1);
+}
+
+}  // namespace
+
+TelemetryHistory::TelemetryHistory(GnmiPublisher* gnmi_publisher,
+                                   const Options& options)
+    : gnmi_publisher_(ABSL_DIE_IF_NULL(gnmi_publisher)),
+      options_(options),
+      paths_(),
+      timer_(nullptr),
+      leaves_(),
+      memory_usage_(0),
+      newest_timestamp_(std::numeric_limits<int64>::min()) {}
+
+TelemetryHistory::~TelemetryHistory() { Stop().IgnoreError(); }
+
+std::unique_ptr<TelemetryHistory> TelemetryHistory::CreateInstance(
+    GnmiPublisher* gnmi_publisher, const Options& options) {
+  return absl::WrapUnique(new TelemetryHistory(gnmi_publisher, options));
+}
+
+void TelemetryHistory::AddPath(const ::gnmi::Path& path) {
+  absl::WriterMutexLock l(&lock_);
+  paths_.push_back(path);
+}
+
+::util::Status TelemetryHistory::Start() {
+  absl::WriterMutexLock l(&lock_);
+  if (paths_.empty() || timer_ != nullptr) return ::util::OkStatus();
+  const uint64 period_ms = absl::ToInt64Milliseconds(options_.sample_period);
+  RET_CHECK(period_ms > 0) << "Invalid telemetry history sample period "
+                           << options_.sample_period << ".";
+  RETURN_IF_ERROR(TimerDaemon::RequestPeriodicTimer(
+      period_ms, period_ms,
+      [this]() {
+        ::util::Status status = Sample();
+        LOG_IF(WARNING, !status.ok())
+            << "Failed to sample telemetry history: " << status;
+        return ::util::OkStatus();
+      },
+      &timer_));
+  LOG(INFO) << "Sampling " << paths_.size() << " gNMI path(s) every "
+            << options_.sample_period << " into the telemetry history.";
+
+  return ::util::OkStatus();
+}
+
+::util::Status TelemetryHistory::Stop() {
+  absl::WriterMutexLock l(&lock_);
+  // Destroying the descriptor cancels the timer.
+  timer_ = nullptr;
+
+  return ::util::OkStatus();
+}
+
+::util::Status TelemetryHistory::Sample() {
+  std::vector<::gnmi::Path> paths;
+  {
+    absl::ReaderMutexLock l(&lock_);
+    paths = paths_;
+  }
+  std::vector<::gnmi::Notification> notifications;
+  InlineGnmiSubscribeStream stream(
+      [&notifications](const ::gnmi::SubscribeResponse& msg) {
+        if (msg.has_update()) notifications.push_back(msg.update());
+        return true;
+      });
+  ::util::Status status = ::util::OkStatus();
+  for (const auto& path : paths) {
+    SubscriptionHandle h;
+    ::util::Status poll_status =
+        gnmi_publisher_->SubscribePoll(path, &stream, &h);
+    if (poll_status.ok()) poll_status = gnmi_publisher_->HandlePoll(h);
+    if (!poll_status.ok()) {
+      VLOG(1) << "Cannot sample " << PathToString(path) << ": " << poll_status;
+      APPEND_STATUS_IF_ERROR(status, poll_status);
+    }
+  }
+  Record(notifications);
+
+  return status;
+}
+
+void TelemetryHistory::Record(
+    const std::vector<::gnmi::Notification>& notifications) {
+  absl::WriterMutexLock l(&lock_);
+  for (const auto& notification : notifications) {
+    for (const auto& update : notification.update()) {
+      ::gnmi::Path path = notification.prefix();
+      for (const auto& elem : update.path().elem()) *path.add_elem() = elem;
+      Leaf& leaf = leaves_[PathToString(path)];
+      if (leaf.num_samples == 0) leaf.path = path;
+      Append(notification.timestamp(), update.val(), &leaf);
+    }
+  }
+  EnforceLimits();
+}
+
+::util::StatusOr<std::vector<::gnmi::Notification>> TelemetryHistory::Query(
+    const ::gnmi::Path& path, absl::Time start, absl::Time end) const {
+  const int64 start_ns = absl::ToUnixNanos(start);
+  const int64 end_ns = absl::ToUnixNanos(end);
+  std::vector<::gnmi::Notification> notifications;
+  {
+    absl::ReaderMutexLock l(&lock_);
+    for (const auto& e : leaves_) {
+      const Leaf& leaf = e.second;
+      if (!PathMatches(path, leaf.path)) continue;
+      ASSIGN_OR_RETURN(auto samples, DecodeAll(leaf));
+      for (auto& sample : samples) {
+        if (sample.timestamp < start_ns || sample.timestamp > end_ns) continue;
+        ::gnmi::Notification notification;
+        notification.set_timestamp(sample.timestamp);
+        auto* update = notification.add_update();
+        *update->mutable_path() = leaf.path;
+        *update->mutable_val() = std::move(sample.value);
+        notifications.push_back(std::move(notification));
+      }
+    }
+  }
+  std::stable_sort(
+      notifications.begin(), notifications.end(),
+      [](const ::gnmi::Notification& a, const ::gnmi::Notification& b) {
+        return a.timestamp() < b.timestamp();
+      });
+
+  return notifications;
+}
+
+::util::Status TelemetryHistory::FlushToFile(
+    const std::string& filename) const {
+  ::gnmi::Path root;
+  ASSIGN_OR_RETURN(auto notifications,
+                   Query(root, absl::InfinitePast(), absl::InfiniteFuture()));
+  ::gnmi::GetResponse resp;
+  for (auto& notification : notifications) {
+    *resp.add_notification() = std::move(notification);
+  }
+  RETURN_IF_ERROR(WriteProtoToTextFile(resp, filename));
+  LOG(INFO) << "Flushed " << resp.notification_size()
+            << " telemetry history sample(s) to " << filename << ".";
+
+  return ::util::OkStatus();
+}
+
+int64 TelemetryHistory::GetMemoryUsage() const {
+  absl::ReaderMutexLock l(&lock_);
+  return memory_usage_;
+}
+
+int64 TelemetryHistory::GetNumSamples() const {
+  absl::ReaderMutexLock l(&lock_);
+  int64 num_samples = 0;
+  for (const auto& e : leaves_) num_samples += e.second.num_samples;
+  return num_samples;
+}
+
+::util::StatusOr<::gnmi::Path> TelemetryHistory::ParsePath(
+    const std::string& str) {
+  if (str.empty() || str[0] != '/') {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Path '" << str << "' is not absolute.";
+  }
+  ::gnmi::Path path;
+  ::gnmi::PathElem* elem = nullptr;
+  size_t i = 0;
+  while (i < str.size()) {
+    const char c = str[i];
+    if (c == '/') {
+      elem = path.add_elem();
+      ++i;
+    } else if (c == '[') {
+      const size_t eq = str.find('=', i);
+      const size_t close = str.find(']', i);
+      if (elem->name().empty() || eq == std::string::npos ||
+          close == std::string::npos || eq > close) {
+        return MAKE_ERROR(ERR_INVALID_PARAM)
+               << "Invalid key in path '" << str << "'.";
+      }
+      (*elem->mutable_key())[str.substr(i + 1, eq - i - 1)] =
+          str.substr(eq + 1, close - eq - 1);
+      i = close + 1;
+    } else {
+      const size_t end = str.find_first_of("/[", i);
+      elem->mutable_name()->append(
+          str.substr(i, end == std::string::npos ? end : end - i));
+      i = end == std::string::npos ? str.size() : end;
+    }
+  }
+  for (const auto& e : path.elem()) {
+    if (e.name().empty()) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Empty element in path '" << str << "'.";
+    }
+  }
+
+  return path;
+}
+
+void TelemetryHistory::Append(int64 timestamp, const ::gnmi::TypedValue& value,
+                              Leaf* leaf) {
+  if (leaf->num_samples == 0) {
+    // Start the deltas from the first sample kept.
+    leaf->base_timestamp = timestamp;
+    leaf->last_timestamp = timestamp;
+  }
+  const size_t old_size = leaf->data.size();
+  ValueEncoding encoding = kTypedValue;
+  if (value.value_case() == ::gnmi::TypedValue::kUintVal) {
+    encoding = kUintDelta;
+  } else if (value.value_case() == ::gnmi::TypedValue::kIntVal) {
+    encoding = kIntDelta;
+  }
+  PutVarint((ZigZagEncode(timestamp - leaf->last_timestamp) << 2) | encoding,
+            &leaf->data);
+  switch (encoding) {
+    case kUintDelta:
+      // Counters may wrap or be reset, so the delta may be negative.
+      PutVarint(ZigZagEncode(static_cast<int64>(value.uint_val() -
+                                                leaf->last_uint)),
+                &leaf->data);
+      leaf->last_uint = value.uint_val();
+      break;
+    case kIntDelta:
+      PutVarint(ZigZagEncode(static_cast<int64>(
+                    static_cast<uint64>(value.int_val()) -
+                    static_cast<uint64>(leaf->last_int))),
+                &leaf->data);
+      leaf->last_int = value.int_val();
+      break;
+    case kTypedValue: {
+      std::string bytes;
+      value.SerializeToString(&bytes);
+      PutVarint(bytes.size(), &leaf->data);
+      leaf->data.append(bytes);
+      break;
+    }
+  }
+  leaf->last_timestamp = timestamp;
+  ++leaf->num_samples;
+  memory_usage_ += leaf->data.size() - old_size;
+  newest_timestamp_ = std::max(newest_timestamp_, timestamp);
+}
+
+::util::Status TelemetryHistory::DecodeNext(const Leaf& leaf, size_t* offset,
+                                            int64* timestamp, uint64* last_uint,
+                                            int64* last_int,
+                                            ::gnmi::TypedValue* value) {
+  uint64 header = 0;
+  uint64 payload = 0;
+  if (!GetVarint(leaf.data, offset, &header) ||
+      !GetVarint(leaf.data, offset, &payload)) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Corrupted telemetry history for " << PathToString(leaf.path)
+           << ".";
+  }
+  *timestamp += ZigZagDecode(header >> 2);
+  switch (header & 0x3) {
+    case kUintDelta:
+      *last_uint += static_cast<uint64>(ZigZagDecode(payload));
+      if (value != nullptr) value->set_uint_val(*last_uint);
+      break;
+    case kIntDelta:
+      *last_int =
+          static_cast<int64>(static_cast<uint64>(*last_int) +
+                             static_cast<uint64>(ZigZagDecode(payload)));
+      if (value != nullptr) value->set_int_val(*last_int);
+      break;
+    case kTypedValue:
+      if (*offset + payload > leaf.data.size()) {
+        return MAKE_ERROR(ERR_INTERNAL)
+               << "Corrupted telemetry history for " << PathToString(leaf.path)
+               << ".";
+      }
+      if (value != nullptr) {
+        RET_CHECK(value->ParseFromArray(leaf.data.data() + *offset, payload));
+      }
+      *offset += payload;
+      break;
+    default:
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Unknown value encoding " << (header & 0x3) << " in telemetry "
+             << "history for " << PathToString(leaf.path) << ".";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<std::vector<TelemetryHistory::DecodedSample>>
+TelemetryHistory::DecodeAll(const Leaf& leaf) {
+  std::vector<DecodedSample> samples(leaf.num_samples);
+  size_t offset = leaf.head;
+  int64 timestamp = leaf.base_timestamp;
+  uint64 last_uint = leaf.base_uint;
+  int64 last_int = leaf.base_int;
+  for (auto& sample : samples) {
+    RETURN_IF_ERROR(DecodeNext(leaf, &offset, &timestamp, &last_uint,
+                               &last_int, &sample.value));
+    sample.timestamp = timestamp;
+  }
+
+  return samples;
+}
+
+void TelemetryHistory::DropSamplesUpTo(int64 timestamp) {
+  for (auto it = leaves_.begin(); it != leaves_.end();) {
+    Leaf& leaf = it->second;
+    while (leaf.num_samples > 0) {
+      size_t offset = leaf.head;
+      int64 sample_timestamp = leaf.base_timestamp;
+      uint64 last_uint = leaf.base_uint;
+      int64 last_int = leaf.base_int;
+      ::util::Status status = DecodeNext(leaf, &offset, &sample_timestamp,
+                                         &last_uint, &last_int, nullptr);
+      if (!status.ok()) {
+        // Should never happen. Drop the whole leaf.
+        LOG(ERROR) << status;
+        memory_usage_ -= leaf.data.size() - leaf.head;
+        leaf.num_samples = 0;
+        break;
+      }
+      if (sample_timestamp > timestamp) break;
+      memory_usage_ -= offset - leaf.head;
+      leaf.head = offset;
+      leaf.base_timestamp = sample_timestamp;
+      leaf.base_uint = last_uint;
+      leaf.base_int = last_int;
+      --leaf.num_samples;
+    }
+    if (leaf.num_samples == 0) {
+      it = leaves_.erase(it);
+      continue;
+    }
+    // Reclaim the space of the dropped samples once it is worth it.
+    if (leaf.head > leaf.data.size() / 2) {
+      leaf.data.erase(0, leaf.head);
+      leaf.head = 0;
+    }
+    ++it;
+  }
+}
+
+void TelemetryHistory::EnforceLimits() {
+  if (leaves_.empty()) return;
+  if (options_.retention > absl::ZeroDuration()) {
+    DropSamplesUpTo(newest_timestamp_ -
+                    absl::ToInt64Nanoseconds(options_.retention) - 1);
+  }
+  while (options_.max_bytes > 0 && memory_usage_ > options_.max_bytes &&
+         !leaves_.empty()) {
+    // Drop the oldest samples of all the leaves.
+    int64 oldest_timestamp = std::numeric_limits<int64>::max();
+    for (const auto& e : leaves_) {
+      const Leaf& leaf = e.second;
+      size_t offset = leaf.head;
+      int64 timestamp = leaf.base_timestamp;
+      uint64 last_uint = leaf.base_uint;
+      int64 last_int = leaf.base_int;
+      if (DecodeNext(leaf, &offset, &timestamp, &last_uint, &last_int, nullptr)
+              .ok()) {
+        oldest_timestamp = std::min(oldest_timestamp, timestamp);
+      }
+    }
+    DropSamplesUpTo(oldest_timestamp);
+  }
+}
+
+bool TelemetryHistory::PathMatches(const ::gnmi::Path& query,
+                                   const ::gnmi::Path& leaf) {
+  if (query.elem_size() > leaf.elem_size()) return false;
+  for (int i = 0; i < query.elem_size(); ++i) {
+    const ::gnmi::PathElem& q = query.elem(i);
+    const ::gnmi::PathElem& l = leaf.elem(i);
+    if (q.name() == "...") return true;
+    if (q.name() != "*" && q.name() != l.name()) return false;
+    for (const auto& key : q.key()) {
+      if (key.second == "*") continue;
+      auto it = l.key().find(key.first);
+      if (it == l.key().end() || it->second != key.second) return false;
+    }
+  }
+
+  return true;
+}
+
+std::string TelemetryHistory::PathToString(const ::gnmi::Path& path) {
+  std::string str;
+  for (const auto& elem : path.elem()) {
+    absl::StrAppend(&str, "/", elem.name());
+    // Sort the keys, as the order of a proto map is unspecified.
+    std::map<std::string, std::string> keys(elem.key().begin(),
+                                            elem.key().end());
+    for (const auto& key : keys) {
+      absl::StrAppend(&str, "[", key.first, "=", key.second, "]");
+    }
+  }
+
+  return str;
+}
+
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,211 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_HAL_LIB_COMMON_TELEMETRY_HISTORY_H_
+#define STRATUM_HAL_LIB_COMMON_TELEMETRY_HISTORY_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "gnmi/gnmi.pb.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
+#include "stratum/hal/lib/common/gnmi_publisher.h"
+#include "stratum/lib/timer_daemon.h"
+
+namespace stratum {
+namespace hal {
+
+// TelemetryHistory keeps a bounded, on-box history of the values of a set of
+// gNMI paths, so that what e.g. interface counters or optics readings looked
+// like during the previous minutes can be retrieved after the fact.
+//
+// The configured paths are periodically polled through the GnmiPublisher and
+// every leaf returned is appended to its own ring of samples. The samples are
+// compactly encoded: timestamps are stored as varint deltas from the previous
+// sample, and so are uint_val and int_val values (e.g. counters), which turns
+// slowly increasing counters into one or two bytes per sample. Other values
+// are stored as serialized TypedValue protos.
+//
+// The history is bounded in time (samples older than the retention period
+// with respect to the newest sample are dropped) and in memory (the oldest
+// samples of all leaves are dropped once the encoded samples exceed the
+// memory cap).
+class TelemetryHistory {
+ public:
+  struct Options {
+    // The period at which the paths are sampled.
+    absl::Duration sample_period;
+    // How long samples are kept.
+    absl::Duration retention;
+    // Max number of bytes of encoded samples kept for all the leaves combined.
+    int64 max_bytes;
+    Options()
+        : sample_period(absl::Seconds(10)),
+          retention(absl::Minutes(15)),
+          max_bytes(16 << 20) {}
+  };
+
+  ~TelemetryHistory();
+
+  // Adds a path to be sampled. The path may contain wildcards, as long as the
+  // GnmiPublisher supports polling it.
+  void AddPath(const ::gnmi::Path& path) LOCKS_EXCLUDED(lock_);
+
+  // Starts sampling the paths periodically. No-op if no path was added.
+  ::util::Status Start() LOCKS_EXCLUDED(lock_);
+
+  // Stops sampling the paths. The recorded history is kept.
+  ::util::Status Stop() LOCKS_EXCLUDED(lock_);
+
+  // Polls all the paths once and records the values returned. Paths which
+  // cannot be polled (e.g. before the chassis config is pushed) are skipped.
+  ::util::Status Sample() LOCKS_EXCLUDED(lock_);
+
+  // Records the updates carried in the given notifications, then enforces the
+  // retention and memory limits.
+  void Record(const std::vector<::gnmi::Notification>& notifications)
+      LOCKS_EXCLUDED(lock_);
+
+  // Returns the recorded samples of all the leaves matching the given path,
+  // whose timestamp is within [start, end], as one notification per sample
+  // sorted by timestamp. The path matches all the leaves below it and may use
+  // "*" as element name or key value, and "..." to match any sub-path.
+  ::util::StatusOr<std::vector<::gnmi::Notification>> Query(
+      const ::gnmi::Path& path, absl::Time start, absl::Time end) const
+      LOCKS_EXCLUDED(lock_);
+
+  // Writes the whole recorded history to the given file, as a text
+  // ::gnmi::GetResponse proto.
+  ::util::Status FlushToFile(const std::string& filename) const
+      LOCKS_EXCLUDED(lock_);
+
+  // Returns the number of bytes of encoded samples kept.
+  int64 GetMemoryUsage() const LOCKS_EXCLUDED(lock_);
+
+  // Returns the number of samples kept for all the leaves combined.
+  int64 GetNumSamples() const LOCKS_EXCLUDED(lock_);
+
+  // Parses a path in the "/elem/elem[key=value]/elem" format, as used in
+  // flags. Values may contain '/' (e.g. port names).
+  static ::util::StatusOr<::gnmi::Path> ParsePath(const std::string& str);
+
+  // Creates a history instance sampling the paths through the given
+  // GnmiPublisher, which is not owned by the class.
+  static std::unique_ptr<TelemetryHistory> CreateInstance(
+      GnmiPublisher* gnmi_publisher, const Options& options);
+
+  // TelemetryHistory is neither copyable nor movable.
+  TelemetryHistory(const TelemetryHistory&) = delete;
+  TelemetryHistory& operator=(const TelemetryHistory&) = delete;
+
+ private:
+  // The ring of encoded samples of a single leaf. Each sample is encoded as a
+  // varint holding the zigzag encoded timestamp delta (in nanoseconds) shifted
+  // left by two bits, ORed with the ValueEncoding of the value, followed by
+  // the encoded value. The base_* fields hold the state preceding the oldest
+  // sample kept, from which the deltas are accumulated when decoding.
+  struct Leaf {
+    ::gnmi::Path path;
+    std::string data;
+    // Offset of the oldest sample kept in data.
+    size_t head;
+    int64 num_samples;
+    int64 base_timestamp;
+    uint64 base_uint;
+    int64 base_int;
+    // State after the newest sample, used to encode the next one.
+    int64 last_timestamp;
+    uint64 last_uint;
+    int64 last_int;
+    Leaf()
+        : head(0),
+          num_samples(0),
+          base_timestamp(0),
+          base_uint(0),
+          base_int(0),
+          last_timestamp(0),
+          last_uint(0),
+          last_int(0) {}
+  };
+
+  // How a value is encoded in a sample.
+  enum ValueEncoding {
+    kUintDelta = 0,
+    kIntDelta = 1,
+    kTypedValue = 2,
+  };
+
+  // A decoded sample.
+  struct DecodedSample {
+    int64 timestamp;
+    ::gnmi::TypedValue value;
+  };
+
+  // Private constructor, we can create the instance by using `CreateInstance`
+  // function only.
+  TelemetryHistory(GnmiPublisher* gnmi_publisher, const Options& options);
+
+  // Appends a sample to a leaf.
+  void Append(int64 timestamp, const ::gnmi::TypedValue& value, Leaf* leaf)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Decodes the sample at the given offset of the leaf data, starting from
+  // the given state. Updates the offset and state to the next sample.
+  static ::util::Status DecodeNext(const Leaf& leaf, size_t* offset,
+                                   int64* timestamp, uint64* last_uint,
+                                   int64* last_int, ::gnmi::TypedValue* value);
+
+  // Decodes all the samples of a leaf.
+  static ::util::StatusOr<std::vector<DecodedSample>> DecodeAll(
+      const Leaf& leaf);
+
+  // Drops the samples of all the leaves whose timestamp is not after the given
+  // timestamp.
+  void DropSamplesUpTo(int64 timestamp) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Drops the oldest samples until the retention and memory limits are met.
+  void EnforceLimits() EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Returns true if the leaf path is matched by the query path.
+  static bool PathMatches(const ::gnmi::Path& query,
+                          const ::gnmi::Path& leaf);
+
+  // Returns a canonical string for a path, used as key of the leaves.
+  static std::string PathToString(const ::gnmi::Path& path);
+
+  // The publisher used to poll the paths. Not owned by this class.
+  GnmiPublisher* const gnmi_publisher_;
+
+  // The history limits, set upon construction and never changed afterwards.
+  const Options options_;
+
+  // Mutex protecting the internal state. Never held while polling the paths.
+  mutable absl::Mutex lock_;
+
+  // The paths to sample.
+  std::vector<::gnmi::Path> paths_ GUARDED_BY(lock_);
+
+  // The timer sampling the paths, or nullptr if stopped.
+  TimerDaemon::DescriptorPtr timer_ GUARDED_BY(lock_);
+
+  // Map from canonical leaf path to the samples of the leaf.
+  std::map<std::string, Leaf> leaves_ GUARDED_BY(lock_);
+
+  // Total number of bytes of encoded samples kept.
+  int64 memory_usage_ GUARDED_BY(lock_);
+
+  // Timestamp of the newest sample recorded.
+  int64 newest_timestamp_ GUARDED_BY(lock_);
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_COMMON_TELEMETRY_HISTORY_H_
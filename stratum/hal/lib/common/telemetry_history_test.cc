@@ -0,0 +1,368 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/common/telemetry_history.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/time/time.h"
+#include "gflags/gflags.h"
+#include "gmock/gmock.h"
+#include "gnmi/gnmi.pb.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/common/switch_mock.h"
+#include "stratum/lib/test_utils/matchers.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+DECLARE_string(test_tmpdir);
+
+namespace stratum {
+namespace hal {
+
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::Invoke;
+using ::testing::Return;
+using ::testing::SizeIs;
+using ::testing::WithArgs;
+
+MATCHER_P(EqualsProto, proto, "") { return ProtoEqual(arg, proto); }
+
+class TelemetryHistoryTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    gnmi_publisher_ = absl::make_unique<GnmiPublisher>(&switch_mock_);
+    ChassisConfig config;
+    ASSERT_OK(ParseProtoFromString(kChassisConfig, &config));
+    ASSERT_OK(gnmi_publisher_->HandleChange(ConfigHasBeenPushedEvent(config)));
+  }
+
+  std::unique_ptr<TelemetryHistory> CreateHistory(absl::Duration retention,
+                                                  int64 max_bytes) {
+    TelemetryHistory::Options options;
+    options.retention = retention;
+    options.max_bytes = max_bytes;
+    return TelemetryHistory::CreateInstance(gnmi_publisher_.get(), options);
+  }
+
+  // Makes the switch report synthetic counters: the in-octets counter of a
+  // port increases by 1000 * port ID every time it is read.
+  void SetUpSyntheticCounters() {
+    EXPECT_CALL(switch_mock_, RetrieveValue(_, _, _, _))
+        .WillRepeatedly(DoAll(
+            WithArgs<1, 2>(Invoke([this](const DataRequest& req,
+                                         WriterInterface<DataResponse>* w) {
+              for (const auto& request : req.requests()) {
+                const uint32 port_id = request.port_counters().port_id();
+                in_octets_[port_id] += 1000 * port_id;
+                DataResponse resp;
+                resp.mutable_port_counters()->set_in_octets(
+                    in_octets_[port_id]);
+                w->Write(resp);
+              }
+            })),
+            Return(::util::OkStatus())));
+  }
+
+  static ::gnmi::Path InOctetsPath(const std::string& interface) {
+    return GetPath("interfaces")("interface", interface)("state")("counters")(
+        "in-octets")();
+  }
+
+  // Returns a notification carrying a single update.
+  static ::gnmi::Notification MakeNotification(const ::gnmi::Path& path,
+                                               absl::Time timestamp,
+                                               const ::gnmi::TypedValue& val) {
+    ::gnmi::Notification notification;
+    notification.set_timestamp(absl::ToUnixNanos(timestamp));
+    auto* update = notification.add_update();
+    *update->mutable_path() = path;
+    *update->mutable_val() = val;
+    return notification;
+  }
+
+  static ::gnmi::TypedValue UintValue(uint64 value) {
+    ::gnmi::TypedValue val;
+    val.set_uint_val(value);
+    return val;
+  }
+
+  // Records counter samples for the given interface, one every second from
+  // kStart, with the counter increasing by 100 every sample.
+  static void RecordCounterSamples(TelemetryHistory* history,
+                                   const std::string& interface,
+                                   int num_samples) {
+    for (int i = 0; i < num_samples; ++i) {
+      history->Record({MakeNotification(InOctetsPath(interface),
+                                        kStart + absl::Seconds(i),
+                                        UintValue(100 * i))});
+    }
+  }
+
+  static constexpr char kChassisConfig[] = R"pb(
+    chassis { platform: PLT_GENERIC_TOMAHAWK name: "device1.domain.net.com" }
+    nodes { id: 1 slot: 1 index: 1 }
+    singleton_ports {
+      id: 1
+      name: "device1.domain.net.com:ce-1/1"
+      slot: 1
+      port: 1
+      speed_bps: 100000000000
+      node: 1
+    }
+    singleton_ports {
+      id: 2
+      name: "device1.domain.net.com:ce-1/2"
+      slot: 1
+      port: 2
+      speed_bps: 100000000000
+      node: 1
+    }
+  )pb";
+  static constexpr char kInterface1[] = "device1.domain.net.com:ce-1/1";
+  static constexpr char kInterface2[] = "device1.domain.net.com:ce-1/2";
+  static const absl::Time kStart;
+
+  SwitchMock switch_mock_;
+  std::unique_ptr<GnmiPublisher> gnmi_publisher_;
+  std::map<uint32, uint64> in_octets_;
+};
+
+constexpr char TelemetryHistoryTest::kChassisConfig[];
+constexpr char TelemetryHistoryTest::kInterface1[];
+constexpr char TelemetryHistoryTest::kInterface2[];
+const absl::Time TelemetryHistoryTest::kStart =
+    absl::FromUnixSeconds(1600000000);
+
+TEST_F(TelemetryHistoryTest, SampleRecordsSwitchCounters) {
+  constexpr int kNumSamples = 5;
+  SetUpSyntheticCounters();
+  auto history = CreateHistory(absl::Hours(1), 1 << 20);
+  history->AddPath(InOctetsPath(kInterface1));
+  history->AddPath(InOctetsPath(kInterface2));
+
+  for (int i = 0; i < kNumSamples; ++i) ASSERT_OK(history->Sample());
+  EXPECT_EQ(2 * kNumSamples, history->GetNumSamples());
+
+  ASSERT_OK_AND_ASSIGN(auto notifications,
+                       history->Query(InOctetsPath(kInterface2),
+                                      absl::InfinitePast(),
+                                      absl::InfiniteFuture()));
+  ASSERT_THAT(notifications, SizeIs(kNumSamples));
+  for (int i = 0; i < kNumSamples; ++i) {
+    ASSERT_THAT(notifications[i].update(), SizeIs(1));
+    EXPECT_THAT(notifications[i].update(0).path(),
+                EqualsProto(InOctetsPath(kInterface2)));
+    EXPECT_EQ(2000 * (i + 1), notifications[i].update(0).val().uint_val());
+    if (i > 0) {
+      EXPECT_GE(notifications[i].timestamp(),
+                notifications[i - 1].timestamp());
+    }
+  }
+
+  // A wildcard query returns the samples of both interfaces.
+  ASSERT_OK_AND_ASSIGN(
+      notifications,
+      history->Query(GetPath("interfaces")("interface", "*")(),
+                     absl::InfinitePast(), absl::InfiniteFuture()));
+  EXPECT_THAT(notifications, SizeIs(2 * kNumSamples));
+}
+
+TEST_F(TelemetryHistoryTest, SampleSkipsUnsupportedPaths) {
+  SetUpSyntheticCounters();
+  auto history = CreateHistory(absl::Hours(1), 1 << 20);
+  history->AddPath(GetPath("unsupported")("path")());
+  history->AddPath(InOctetsPath(kInterface1));
+
+  EXPECT_EQ(ERR_INVALID_PARAM, history->Sample().error_code());
+  EXPECT_EQ(1, history->GetNumSamples());
+}
+
+TEST_F(TelemetryHistoryTest, EncodingRoundTrip) {
+  auto history = CreateHistory(absl::Hours(1), 1 << 20);
+  const ::gnmi::Path path = GetPath("some")("leaf")();
+  std::vector<::gnmi::TypedValue> values(12);
+  values[0].set_uint_val(0);
+  values[1].set_uint_val(kuint64max);  // Counter about to wrap.
+  values[2].set_uint_val(5);           // Counter wrapped.
+  values[3].set_uint_val(5);
+  values[4].set_int_val(kint64min);
+  values[5].set_int_val(kint64max);
+  values[6].set_int_val(-42);
+  values[7].set_string_val("UP");
+  values[8].set_bool_val(true);
+  values[9].mutable_decimal_val()->set_digits(-12345);
+  values[9].mutable_decimal_val()->set_precision(2);
+  values[10].set_float_val(3.5);
+  values[11].set_uint_val(7);
+  // Irregular timestamps, including two samples at the same time.
+  const std::vector<absl::Duration> offsets = {
+      absl::ZeroDuration(),   absl::Nanoseconds(1), absl::Nanoseconds(1),
+      absl::Milliseconds(3),  absl::Seconds(1),     absl::Seconds(10),
+      absl::Seconds(11),      absl::Minutes(2),     absl::Minutes(3),
+      absl::Minutes(4),       absl::Minutes(5),     absl::Minutes(59)};
+  std::vector<::gnmi::Notification> recorded;
+  for (size_t i = 0; i < values.size(); ++i) {
+    recorded.push_back(MakeNotification(path, kStart + offsets[i], values[i]));
+  }
+  history->Record(recorded);
+
+  ASSERT_OK_AND_ASSIGN(
+      auto notifications,
+      history->Query(path, absl::InfinitePast(), absl::InfiniteFuture()));
+  ASSERT_THAT(notifications, SizeIs(recorded.size()));
+  for (size_t i = 0; i < recorded.size(); ++i) {
+    EXPECT_THAT(notifications[i], EqualsProto(recorded[i]));
+  }
+}
+
+TEST_F(TelemetryHistoryTest, CountersAreDeltaEncoded) {
+  constexpr int kNumSamples = 1000;
+  auto history = CreateHistory(absl::Hours(1), 1 << 20);
+  RecordCounterSamples(history.get(), kInterface1, kNumSamples);
+
+  // Each sample takes 5 bytes for a timestamp delta of 1s, and 2 bytes for a
+  // counter delta of 100. Uncompressed, the timestamp and value alone would
+  // take 16 bytes.
+  EXPECT_EQ(kNumSamples, history->GetNumSamples());
+  EXPECT_LE(history->GetMemoryUsage(), 7 * kNumSamples);
+}
+
+TEST_F(TelemetryHistoryTest, RetentionDropsOldSamples) {
+  constexpr int kNumSamples = 100;
+  auto history = CreateHistory(absl::Seconds(30), 1 << 20);
+  RecordCounterSamples(history.get(), kInterface1, kNumSamples);
+
+  // Only the samples within 30s of the newest one are kept, and they still
+  // decode to the right values.
+  ASSERT_OK_AND_ASSIGN(auto notifications,
+                       history->Query(InOctetsPath(kInterface1),
+                                      absl::InfinitePast(),
+                                      absl::InfiniteFuture()));
+  ASSERT_THAT(notifications, SizeIs(31));
+  for (int i = 0; i < 31; ++i) {
+    const int sample = kNumSamples - 31 + i;
+    EXPECT_EQ(absl::ToUnixNanos(kStart + absl::Seconds(sample)),
+              notifications[i].timestamp());
+    EXPECT_EQ(100 * sample, notifications[i].update(0).val().uint_val());
+  }
+}
+
+TEST_F(TelemetryHistoryTest, MemoryCapDropsOldestSamples) {
+  constexpr int kNumSamples = 100;
+  constexpr int64 kMaxBytes = 200;
+  auto history = CreateHistory(absl::Hours(1), kMaxBytes);
+  for (int i = 0; i < kNumSamples; ++i) {
+    const absl::Time timestamp = kStart + absl::Seconds(i);
+    history->Record({
+        MakeNotification(InOctetsPath(kInterface1), timestamp,
+                         UintValue(100 * i)),
+        MakeNotification(InOctetsPath(kInterface2), timestamp,
+                         UintValue(200 * i)),
+    });
+    ASSERT_LE(history->GetMemoryUsage(), kMaxBytes);
+  }
+
+  // The oldest samples of both interfaces are dropped, the newest are kept.
+  ASSERT_OK_AND_ASSIGN(auto notifications1,
+                       history->Query(InOctetsPath(kInterface1),
+                                      absl::InfinitePast(),
+                                      absl::InfiniteFuture()));
+  ASSERT_OK_AND_ASSIGN(auto notifications2,
+                       history->Query(InOctetsPath(kInterface2),
+                                      absl::InfinitePast(),
+                                      absl::InfiniteFuture()));
+  ASSERT_FALSE(notifications1.empty());
+  ASSERT_EQ(notifications1.size(), notifications2.size());
+  EXPECT_LT(notifications1.size(), static_cast<size_t>(kNumSamples));
+  EXPECT_EQ(notifications1.front().timestamp(),
+            notifications2.front().timestamp());
+  EXPECT_EQ(100 * (kNumSamples - 1),
+            notifications1.back().update(0).val().uint_val());
+  EXPECT_EQ(200 * (kNumSamples - 1),
+            notifications2.back().update(0).val().uint_val());
+}
+
+TEST_F(TelemetryHistoryTest, TimeRangeQuery) {
+  auto history = CreateHistory(absl::Hours(1), 1 << 20);
+  RecordCounterSamples(history.get(), kInterface1, 10);
+  RecordCounterSamples(history.get(), kInterface2, 10);
+
+  // Both ends of the range are inclusive.
+  ASSERT_OK_AND_ASSIGN(
+      auto notifications,
+      history->Query(InOctetsPath(kInterface1), kStart + absl::Seconds(3),
+                     kStart + absl::Seconds(6)));
+  ASSERT_THAT(notifications, SizeIs(4));
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(absl::ToUnixNanos(kStart + absl::Seconds(3 + i)),
+              notifications[i].timestamp());
+    EXPECT_EQ(100 * (3 + i), notifications[i].update(0).val().uint_val());
+  }
+
+  // Wildcards and sub-paths.
+  ASSERT_OK_AND_ASSIGN(
+      notifications,
+      history->Query(GetPath("interfaces")("interface", "*")("...")(),
+                     kStart + absl::Seconds(8), absl::InfiniteFuture()));
+  EXPECT_THAT(notifications, SizeIs(4));
+  ASSERT_OK_AND_ASSIGN(
+      notifications,
+      history->Query(GetPath("interfaces")("interface", kInterface2)("state")(),
+                     absl::InfinitePast(), kStart));
+  EXPECT_THAT(notifications, SizeIs(1));
+
+  // No match.
+  ASSERT_OK_AND_ASSIGN(
+      notifications,
+      history->Query(GetPath("components")(), absl::InfinitePast(),
+                     absl::InfiniteFuture()));
+  EXPECT_THAT(notifications, SizeIs(0));
+  ASSERT_OK_AND_ASSIGN(
+      notifications,
+      history->Query(InOctetsPath(kInterface1), kStart + absl::Seconds(10),
+                     absl::InfiniteFuture()));
+  EXPECT_THAT(notifications, SizeIs(0));
+}
+
+TEST_F(TelemetryHistoryTest, FlushToFile) {
+  auto history = CreateHistory(absl::Hours(1), 1 << 20);
+  RecordCounterSamples(history.get(), kInterface1, 10);
+  RecordCounterSamples(history.get(), kInterface2, 5);
+
+  const std::string filename =
+      FLAGS_test_tmpdir + "/telemetry_history.pb.txt";
+  ASSERT_OK(history->FlushToFile(filename));
+  ::gnmi::GetResponse resp;
+  ASSERT_OK(ReadProtoFromTextFile(filename, &resp));
+  EXPECT_EQ(15, resp.notification_size());
+  // Flushing does not drop the history.
+  EXPECT_EQ(15, history->GetNumSamples());
+}
+
+TEST_F(TelemetryHistoryTest, ParsePath) {
+  ASSERT_OK_AND_ASSIGN(
+      auto path,
+      TelemetryHistory::ParsePath("/interfaces/interface[name="
+                                  "device1.domain.net.com:ce-1/1]/state/"
+                                  "counters/in-octets"));
+  EXPECT_THAT(path, EqualsProto(InOctetsPath(kInterface1)));
+  ASSERT_OK_AND_ASSIGN(
+      path, TelemetryHistory::ParsePath("/interfaces/interface[name=*]"));
+  EXPECT_THAT(path, EqualsProto(GetPath("interfaces")("interface", "*")()));
+
+  EXPECT_FALSE(TelemetryHistory::ParsePath("").ok());
+  EXPECT_FALSE(TelemetryHistory::ParsePath("interfaces").ok());
+  EXPECT_FALSE(TelemetryHistory::ParsePath("/interfaces/").ok());
+  EXPECT_FALSE(TelemetryHistory::ParsePath("/interfaces[name]").ok());
+  EXPECT_FALSE(TelemetryHistory::ParsePath("/[name=x]").ok());
+}
+
+}  // namespace hal
+}  // namespace stratum
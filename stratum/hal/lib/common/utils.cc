@@ -134,6 +134,36 @@ SingletonPort BuildSingletonPort(int slot, int port, int channel,
   return singleton_port;
 }
 
+ChassisConfigPlan::Operation* AddChassisConfigPlanOperation(
+    ChassisConfigPlan::Operation::Type type, uint64 node_id, uint32 port_id,
+    bool disruptive, ChassisConfigPlan* plan) {
+  auto* operation = plan->add_operations();
+  operation->set_type(type);
+  operation->set_node_id(node_id);
+  operation->set_port_id(port_id);
+  if (disruptive) {
+    operation->set_disruptive(true);
+    plan->set_disruptive(true);
+  }
+  return operation;
+}
+
+void AddChassisConfigPlanChange(const std::string& field,
+                                const std::string& old_value,
+                                const std::string& new_value, bool disruptive,
+                                ChassisConfigPlan::Operation* operation,
+                                ChassisConfigPlan* plan) {
+  auto* change = operation->add_changes();
+  change->set_field(field);
+  change->set_old_value(old_value);
+  change->set_new_value(new_value);
+  if (disruptive) {
+    change->set_disruptive(true);
+    operation->set_disruptive(true);
+    plan->set_disruptive(true);
+  }
+}
+
 PortLedConfig FindPortLedColorAndState(AdminState admin_state,
                                        PortState oper_state,
                                        HealthState health_state,
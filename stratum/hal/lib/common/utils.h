@@ -17,6 +17,7 @@
 #include "stratum/glue/status/statusor.h"
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/hal/lib/common/constants.h"
+#include "stratum/public/proto/gnmi_extensions.pb.h"
 
 namespace stratum {
 namespace hal {
@@ -141,6 +142,21 @@ std::string PrintPortState(PortState state);
 SingletonPort BuildSingletonPort(int slot, int port, int channel,
                                  uint64 speed_bps);
 
+// Appends a node or port operation to a ChassisConfigPlan. The port_id is 0
+// for operations on the node itself. A disruptive operation makes the whole
+// plan disruptive.
+ChassisConfigPlan::Operation* AddChassisConfigPlanOperation(
+    ChassisConfigPlan::Operation::Type type, uint64 node_id, uint32 port_id,
+    bool disruptive, ChassisConfigPlan* plan);
+
+// Records the change of one attribute in an operation of a ChassisConfigPlan.
+// A disruptive change makes the operation and the whole plan disruptive.
+void AddChassisConfigPlanChange(const std::string& field,
+                                const std::string& old_value,
+                                const std::string& new_value, bool disruptive,
+                                ChassisConfigPlan::Operation* operation,
+                                ChassisConfigPlan* plan);
+
 // An alias for the pair of (LedColor, LedState) for a front panel port LED.
 using PortLedConfig = std::pair<LedColor, LedState>;
 
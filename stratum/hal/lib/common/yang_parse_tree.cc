@@ -8,10 +8,12 @@
 #include <string>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/synchronization/mutex.h"
 #include "grpcpp/grpcpp.h"
+#include "stratum/glue/gtl/map_util.h"
 #include "stratum/glue/status/status_macros.h"
 #include "stratum/hal/lib/common/gnmi_publisher.h"
 #include "stratum/hal/lib/common/yang_parse_tree_paths.h"
@@ -19,6 +21,17 @@
 namespace stratum {
 namespace hal {
 
+namespace {
+
+// Returns true if 'name' is the name of a node implementing a wildcard path.
+// Such nodes are skipped while matching paths against the tree, as their
+// concrete siblings are matched instead.
+bool IsWildcardNodeName(const std::string& name) {
+  return name == "*" || name == "...";
+}
+
+}  // namespace
+
 TreeNode::TreeNode(const TreeNode& src) {
   name_ = src.name_;
   // Deep-copy children.
@@ -117,6 +130,61 @@ const TreeNode* TreeNode::FindNodeOrNull(const ::gnmi::Path& path) const {
   return node;
 }
 
+void TreeNode::FindMatchingNodes(const ::gnmi::Path& path, int element,
+                                 std::vector<const TreeNode*>* nodes) const {
+  if (element == path.elem_size()) {
+    nodes->push_back(this);
+    return;
+  }
+  const ::gnmi::PathElem& elem = path.elem(element);
+  if (elem.name() == "...") {
+    // A trailing "..." matches the whole subtree, which this node handles.
+    if (element + 1 == path.elem_size()) {
+      nodes->push_back(this);
+      return;
+    }
+    // Either the "..." matches no more elements, or it matches at least one
+    // more and stays active in the subtree.
+    FindMatchingNodes(path, element + 1, nodes);
+    for (const auto& entry : children_) {
+      if (IsWildcardNodeName(entry.first)) continue;
+      entry.second.FindMatchingNodes(path, element, nodes);
+    }
+    return;
+  }
+
+  // Match the element name. Key nodes only match the key of an element.
+  std::vector<const TreeNode*> named;
+  if (elem.name() == "*") {
+    for (const auto& entry : children_) {
+      if (IsWildcardNodeName(entry.first) || entry.second.is_name_a_key_) {
+        continue;
+      }
+      named.push_back(&entry.second);
+    }
+  } else {
+    const TreeNode* child = gtl::FindOrNull(children_, elem.name());
+    if (child != nullptr && !child->is_name_a_key_) named.push_back(child);
+  }
+  // Match the element key, if any.
+  const std::string* key = gtl::FindOrNull(elem.key(), "name");
+  for (const TreeNode* node : named) {
+    if (key == nullptr) {
+      node->FindMatchingNodes(path, element + 1, nodes);
+    } else if (*key == "*") {
+      for (const auto& entry : node->children_) {
+        if (IsWildcardNodeName(entry.first)) continue;
+        entry.second.FindMatchingNodes(path, element + 1, nodes);
+      }
+    } else {
+      const TreeNode* child = gtl::FindOrNull(node->children_, *key);
+      if (child != nullptr) {
+        child->FindMatchingNodes(path, element + 1, nodes);
+      }
+    }
+  }
+}
+
 void YangParseTree::SendNotification(const GnmiEventPtr& event) {
   absl::WriterMutexLock r(&root_access_lock_);
   if (!gnmi_event_writer_) return;
@@ -287,12 +355,71 @@ const TreeNode* YangParseTree::FindNodeOrNull(const ::gnmi::Path& path) const {
   return root_.FindNodeOrNull(path);
 }
 
+std::vector<const TreeNode*> YangParseTree::FindMatchingNodes(
+    const ::gnmi::Path& path) const {
+  absl::WriterMutexLock l(&root_access_lock_);
+
+  // Paths without "..." before their last element are handled by a single
+  // node, as before. This includes wildcard paths with a dedicated node, like
+  // "/interfaces/interface/...".
+  bool multi_level = false;
+  for (int i = 0; i + 1 < path.elem_size(); ++i) {
+    if (path.elem(i).name() == "...") multi_level = true;
+  }
+  if (!multi_level) {
+    const TreeNode* node = root_.FindNodeOrNull(path);
+    if (node != nullptr) return {node};
+    if (path.elem_size() == 0 ||
+        path.elem(path.elem_size() - 1).name() != "...") {
+      return {};
+    }
+  }
+
+  std::vector<const TreeNode*> matches;
+  root_.FindMatchingNodes(path, 0, &matches);
+
+  // Several "..." may match the same node more than once, and a node may be
+  // matched together with some of its ancestors. As a node handles its whole
+  // subtree, keep only the topmost matches.
+  const absl::flat_hash_set<const TreeNode*> matched(matches.begin(),
+                                                     matches.end());
+  absl::flat_hash_set<const TreeNode*> added;
+  std::vector<const TreeNode*> nodes;
+  for (const TreeNode* node : matches) {
+    bool covered = false;
+    for (const TreeNode* p = node; p != &root_ && !covered;) {
+      p = &p->parent();
+      covered = matched.contains(p);
+    }
+    if (!covered && added.insert(node).second) nodes.push_back(node);
+  }
+
+  return nodes;
+}
+
 const TreeNode* YangParseTree::GetRoot() const {
   absl::WriterMutexLock l(&root_access_lock_);
 
   return &root_;
 }
 
+::util::Status YangParseTree::ReadEntryQuotaUsage(uint64 node_id,
+                                                  EntryQuotaUsage* usage) {
+  EntryQuotaUsageReader reader;
+  {
+    absl::ReaderMutexLock l(&root_access_lock_);
+    reader = entry_quota_usage_reader_;
+  }
+  // The reader is called without the lock, as it takes the locks of the
+  // P4Runtime service.
+  if (!reader) {
+    return MAKE_ERROR(ERR_UNIMPLEMENTED).without_logging()
+           << "Entry quota usage is not available.";
+  }
+
+  return reader(node_id, usage);
+}
+
 void YangParseTree::AddSubtreeInterfaceFromTrunk(
     const std::string& name, uint64 node_id, uint32 port_id,
     const NodeConfigParams& node_config) {
@@ -5,11 +5,13 @@
 #ifndef STRATUM_HAL_LIB_COMMON_YANG_PARSE_TREE_H_
 #define STRATUM_HAL_LIB_COMMON_YANG_PARSE_TREE_H_
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "absl/synchronization/mutex.h"
 #include "gnmi/gnmi.grpc.pb.h"
@@ -149,6 +151,16 @@ class TreeNode {
   // Returns a node that handles the YANG path starting from this node.
   const TreeNode* FindNodeOrNull(const ::gnmi::Path& path) const;
 
+  // Appends to 'nodes' all the nodes below this one that match the elements of
+  // 'path' starting from 'element'. Element names and key values may be "*",
+  // which matches any single element, and element names may be "...", which
+  // matches any number of elements (including none). The subtree is only
+  // descended into as far as the path may still match, and the wildcard nodes
+  // stored in the tree are skipped, so every concrete node is matched at most
+  // once per "...".
+  void FindMatchingNodes(const ::gnmi::Path& path, int element,
+                         std::vector<const TreeNode*>* nodes) const;
+
   // A generic method that checks if the subtree starting from this node
   // supports a particular type of events. The input parameter is a pointer to
   // the mameber variable that keeps information if this node supports the
@@ -368,6 +380,11 @@ class TreeNode {
   friend class stratum::hal::SubscriptionTestBase;
 };
 
+// A function reading the usage of the entry quotas of the P4 roles on a node.
+// The entry quotas are enforced by the P4Runtime service, not by the switch.
+using EntryQuotaUsageReader =
+    std::function<::util::Status(uint64 node_id, EntryQuotaUsage* usage)>;
+
 // A class implementing a YANG model tree. It uses TreeNode objects to
 // represents nodes and leafs of the tree and provides additional methods to
 // work with the tree.
@@ -434,6 +451,14 @@ class YangParseTree {
   const TreeNode* FindNodeOrNull(const ::gnmi::Path& path) const
       LOCKS_EXCLUDED(root_access_lock_);
 
+  // Returns all the nodes that handle the YANG path. Paths handled by a
+  // dedicated node, e.g. "/interfaces/interface[name=*]/state/name", return
+  // that node, while paths using "..." before their last element, e.g.
+  // "/interfaces/interface[name=*]/.../in-octets", return all the matching
+  // nodes of the tree. Returns an empty vector if the path is not supported.
+  std::vector<const TreeNode*> FindMatchingNodes(const ::gnmi::Path& path) const
+      LOCKS_EXCLUDED(root_access_lock_);
+
   // Returns the root node of the parse tree. Access to this node is useful when
   // an action on all nodes is needed.
   const TreeNode* GetRoot() const LOCKS_EXCLUDED(root_access_lock_);
@@ -444,6 +469,19 @@ class YangParseTree {
     return switch_interface_;
   }
 
+  // Sets the function used to read the entry quota usage of the nodes.
+  void SetEntryQuotaUsageReader(EntryQuotaUsageReader reader)
+      LOCKS_EXCLUDED(root_access_lock_) {
+    absl::WriterMutexLock r(&root_access_lock_);
+
+    entry_quota_usage_reader_ = std::move(reader);
+  }
+
+  // Reads the entry quota usage of a node. Returns ERR_UNIMPLEMENTED if no
+  // reader was set.
+  ::util::Status ReadEntryQuotaUsage(uint64 node_id, EntryQuotaUsage* usage)
+      LOCKS_EXCLUDED(root_access_lock_);
+
   // A getter providing a functor setting TARGET_DEFINED mode of a leaf to be
   // STREAM:SAMPLE.
   const TreeNode::TargetDefinedModeFunc& GetStreamSampleModeFunc() {
@@ -486,6 +524,10 @@ class YangParseTree {
 
   SwitchInterface* switch_interface_ GUARDED_BY(root_access_lock_);
 
+  // Reads the entry quota usage of the nodes, if set.
+  EntryQuotaUsageReader entry_quota_usage_reader_
+      GUARDED_BY(root_access_lock_);
+
   // A channel between YangParseTree object and GnmiPublisher objest.
   // It is used to send notifications that a leaf has changed.
   std::shared_ptr<WriterInterface<GnmiEventPtr>> gnmi_event_writer_
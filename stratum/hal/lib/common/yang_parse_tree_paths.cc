@@ -3226,6 +3226,139 @@ void SetUpDebugNodesNodePacketIoDebugString(uint64 node_id, TreeNode* node,
       ->SetOnChangeHandler(on_change_functor);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// /debug/nodes/node[name=<name>]/tables
+//
+// A helper method that builds a response with the occupancy of the tables in
+// 'tables'. Each table yields two updates under 'path':
+// .../tables/table[name=<table>]/state/entries
+// .../tables/table[name=<table>]/state/capacity
+::gnmi::SubscribeResponse GetTableOccupancyResponse(
+    const ::gnmi::Path& path,
+    const ::google::protobuf::RepeatedPtrField<TableOccupancy::Table>&
+        tables) {
+  ::gnmi::Notification notification;
+  notification.set_timestamp(absl::GetCurrentTimeNanos());
+  for (const auto& table : tables) {
+    ::gnmi::Path table_path = path;
+    auto* elem = table_path.add_elem();
+    elem->set_name("table");
+    (*elem->mutable_key())["name"] = table.name();
+    table_path.add_elem()->set_name("state");
+    ::gnmi::Update* update = notification.add_update();
+    *update->mutable_path() = table_path;
+    update->mutable_path()->add_elem()->set_name("entries");
+    update->mutable_val()->set_uint_val(table.entries());
+    update = notification.add_update();
+    *update->mutable_path() = table_path;
+    update->mutable_path()->add_elem()->set_name("capacity");
+    update->mutable_val()->set_uint_val(table.capacity());
+  }
+  ::gnmi::SubscribeResponse resp;
+  *resp.mutable_update() = notification;
+  return resp;
+}
+
+// The OnChange handler only receives events when a table crosses one of the
+// --table_occupancy_thresholds, so subscribers are not flooded with an update
+// for every table write.
+void SetUpDebugNodesNodeTables(uint64 node_id, TreeNode* node,
+                               YangParseTree* tree) {
+  auto poll_functor = [node_id, tree](const GnmiEvent& event,
+                                      const ::gnmi::Path& path,
+                                      GnmiSubscribeStream* stream) {
+    // Create a data retrieval request.
+    DataRequest req;
+    auto* request = req.add_requests()->mutable_table_occupancy();
+    request->set_node_id(node_id);
+    // In-place definition of method retrieving data from generic response
+    // and saving into 'resp' local variable.
+    TableOccupancy resp{};
+    DataResponseWriter writer([&resp](const DataResponse& in) {
+      if (!in.has_table_occupancy()) return false;
+      resp = in.table_occupancy();
+      return true;
+    });
+    // Query the switch. The returned status is ignored as there is no way to
+    // notify the controller that something went wrong. The error is logged when
+    // it is created.
+    tree->GetSwitchInterface()
+        ->RetrieveValue(node_id, req, &writer, /* details= */ nullptr)
+        .IgnoreError();
+    return SendResponse(GetTableOccupancyResponse(path, resp.tables()),
+                        stream);
+  };
+  auto on_change_functor = [node_id](const GnmiEvent& event,
+                                     const ::gnmi::Path& path,
+                                     GnmiSubscribeStream* stream) {
+    const auto* change =
+        dynamic_cast<const TableOccupancyChangedEvent*>(&event);
+    if (change == nullptr || change->GetNodeId() != node_id) {
+      // This is not the event you are looking for...
+      return ::util::OkStatus();
+    }
+    ::google::protobuf::RepeatedPtrField<TableOccupancy::Table> tables;
+    *tables.Add() = change->GetTable();
+    return SendResponse(GetTableOccupancyResponse(path, tables), stream);
+  };
+  auto register_functor = RegisterFunc<TableOccupancyChangedEvent>();
+  node->SetOnTimerHandler(poll_functor)
+      ->SetOnPollHandler(poll_functor)
+      ->SetOnChangeRegistration(register_functor)
+      ->SetOnChangeHandler(on_change_functor);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// /debug/nodes/node[name=<name>]/entry-quotas
+//
+// A helper method that builds a response with the usage of the entry quotas
+// in 'usage'. Each quota yields two updates under 'path':
+// .../entry-quotas/entry-quota[role=<role>][id=<p4_id>]/state/entries
+// .../entry-quotas/entry-quota[role=<role>][id=<p4_id>]/state/max-entries
+::gnmi::SubscribeResponse GetEntryQuotaUsageResponse(
+    const ::gnmi::Path& path, const EntryQuotaUsage& usage) {
+  ::gnmi::Notification notification;
+  notification.set_timestamp(absl::GetCurrentTimeNanos());
+  for (const auto& quota : usage.quotas()) {
+    ::gnmi::Path quota_path = path;
+    auto* elem = quota_path.add_elem();
+    elem->set_name("entry-quota");
+    (*elem->mutable_key())["role"] = quota.role();
+    (*elem->mutable_key())["id"] = absl::StrFormat("%d", quota.p4_id());
+    quota_path.add_elem()->set_name("state");
+    ::gnmi::Update* update = notification.add_update();
+    *update->mutable_path() = quota_path;
+    update->mutable_path()->add_elem()->set_name("entries");
+    update->mutable_val()->set_uint_val(quota.entries());
+    update = notification.add_update();
+    *update->mutable_path() = quota_path;
+    update->mutable_path()->add_elem()->set_name("max-entries");
+    update->mutable_val()->set_uint_val(quota.max_entries());
+  }
+  ::gnmi::SubscribeResponse resp;
+  *resp.mutable_update() = notification;
+  return resp;
+}
+
+// The entry quotas are tracked by the P4Runtime service, so the usage is read
+// through the tree instead of the switch.
+void SetUpDebugNodesNodeEntryQuotas(uint64 node_id, TreeNode* node,
+                                    YangParseTree* tree) {
+  auto poll_functor = [node_id, tree](const GnmiEvent& event,
+                                      const ::gnmi::Path& path,
+                                      GnmiSubscribeStream* stream) {
+    EntryQuotaUsage usage;
+    // The returned status is ignored as there is no way to notify the
+    // controller that something went wrong. An empty usage is sent instead.
+    tree->ReadEntryQuotaUsage(node_id, &usage).IgnoreError();
+    return SendResponse(GetEntryQuotaUsageResponse(path, usage), stream);
+  };
+  auto on_change_functor = UnsupportedFunc();
+  node->SetOnTimerHandler(poll_functor)
+      ->SetOnPollHandler(poll_functor)
+      ->SetOnChangeHandler(on_change_functor);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // /components/component[name=<name>]/integrated-circuit/config/node-id
 void SetUpComponentsComponentIntegratedCircuitConfigNodeId(
@@ -3788,6 +3921,12 @@ void YangParseTreePaths::AddSubtreeNode(const Node& node, YangParseTree* tree) {
   TreeNode* tree_node = tree->AddNode(
       GetPath("debug")("nodes")("node", name)("packet-io")("debug-string")());
   SetUpDebugNodesNodePacketIoDebugString(node.id(), tree_node, tree);
+  tree_node =
+      tree->AddNode(GetPath("debug")("nodes")("node", name)("tables")());
+  SetUpDebugNodesNodeTables(node.id(), tree_node, tree);
+  tree_node =
+      tree->AddNode(GetPath("debug")("nodes")("node", name)("entry-quotas")());
+  SetUpDebugNodesNodeEntryQuotas(node.id(), tree_node, tree);
   tree_node = tree->AddNode(GetPath("components")(
       "component", name)("integrated-circuit")("config")("node-id")());
   SetUpComponentsComponentIntegratedCircuitConfigNodeId(node.id(), tree_node,
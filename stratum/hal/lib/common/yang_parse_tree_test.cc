@@ -23,6 +23,7 @@
 namespace stratum {
 namespace hal {
 
+using test_utils::EqualsProto;
 using test_utils::StatusIs;
 using ::testing::_;
 using ::testing::ContainsRegex;
@@ -30,6 +31,7 @@ using ::testing::DoAll;
 using ::testing::HasSubstr;
 using ::testing::Invoke;
 using ::testing::Return;
+using ::testing::SaveArg;
 using ::testing::SizeIs;
 using ::testing::WithArg;
 using ::testing::WithArgs;
@@ -3404,6 +3406,30 @@ TEST_F(YangParseTreeTest,
   EXPECT_EQ(resp.update().update(0).val().uint_val(), kDroppedPkts);
 }
 
+// Check if the /qos/interfaces/interface/output/queues/queue/state counters
+// request the counters of their own node, port and queue.
+TEST_F(YangParseTreeTest,
+       QosInterfacesInterfaceOutputQueuesQueueStateOnPollRequestsQueue) {
+  DataRequest expected_req;
+  auto* port_queue = expected_req.add_requests()->mutable_port_qos_counters();
+  port_queue->set_node_id(kInterface1NodeId);
+  port_queue->set_port_id(kInterface1PortId);
+  port_queue->set_queue_id(kInterface1QueueId);
+
+  for (const char* leaf :
+       {"transmit-pkts", "transmit-octets", "dropped-pkts"}) {
+    auto path = GetPath("qos")("interfaces")("interface", "interface-1")(
+        "output")("queues")("queue", "BE1")("state")(leaf)();
+    DataRequest req;
+    EXPECT_CALL(switch_, RetrieveValue(kInterface1NodeId, _, _, _))
+        .WillOnce(DoAll(SaveArg<1>(&req), Return(::util::OkStatus())));
+
+    ::gnmi::SubscribeResponse resp;
+    EXPECT_OK(ExecuteOnPoll(path, &resp));
+    EXPECT_THAT(req, EqualsProto(expected_req)) << leaf;
+  }
+}
+
 // Check if /debug/nodes/node/packet-io/debug-string
 // OnPoll action works correctly.
 TEST_F(YangParseTreeTest, DebugNodesNodePacketIoDebugStringOnPollSuccess) {
@@ -3435,6 +3461,126 @@ TEST_F(YangParseTreeTest, DebugNodesNodePacketIoDebugStringOnPollSuccess) {
   EXPECT_EQ(resp.update().update(0).val().string_val(), kTestString);
 }
 
+// Check if /debug/nodes/node/tables OnPoll action works correctly.
+TEST_F(YangParseTreeTest, DebugNodesNodeTablesOnPollSuccess) {
+  auto path = GetPath("debug")("nodes")("node", "node-1")("tables")();
+
+  // Mock implementation of RetrieveValue() that sends the occupancy of two
+  // tables.
+  EXPECT_CALL(switch_, RetrieveValue(kInterface1NodeId, _, _, _))
+      .WillOnce(
+          DoAll(WithArg<2>(Invoke([](WriterInterface<DataResponse>* w) {
+                  DataResponse resp;
+                  auto* table = resp.mutable_table_occupancy()->add_tables();
+                  table->set_name("ingress.table_1");
+                  table->set_entries(10);
+                  table->set_capacity(1024);
+                  table = resp.mutable_table_occupancy()->add_tables();
+                  table->set_name("ingress.table_2");
+                  table->set_entries(3);
+                  w->Write(resp);
+                })),
+                Return(::util::OkStatus())));
+
+  // Call the event handler. 'resp' will contain the message that is sent to the
+  // controller.
+  ::gnmi::SubscribeResponse resp;
+  EXPECT_OK(ExecuteOnPoll(path, &resp));
+
+  // Check that the result of the call is what is expected.
+  ASSERT_EQ(resp.update().update_size(), 4);
+  const auto& entries_path = resp.update().update(0).path();
+  ASSERT_EQ(entries_path.elem_size(), 7);
+  EXPECT_EQ(entries_path.elem(4).name(), "table");
+  EXPECT_EQ(entries_path.elem(4).key().at("name"), "ingress.table_1");
+  EXPECT_EQ(entries_path.elem(5).name(), "state");
+  EXPECT_EQ(entries_path.elem(6).name(), "entries");
+  EXPECT_EQ(resp.update().update(0).val().uint_val(), 10U);
+  EXPECT_EQ(resp.update().update(1).path().elem(6).name(), "capacity");
+  EXPECT_EQ(resp.update().update(1).val().uint_val(), 1024U);
+  EXPECT_EQ(resp.update().update(2).path().elem(4).key().at("name"),
+            "ingress.table_2");
+  EXPECT_EQ(resp.update().update(2).val().uint_val(), 3U);
+  EXPECT_EQ(resp.update().update(3).val().uint_val(), 0U);
+}
+
+// Check if /debug/nodes/node/tables OnChange action works correctly.
+TEST_F(YangParseTreeTest, DebugNodesNodeTablesOnChangeSuccess) {
+  auto path = GetPath("debug")("nodes")("node", "node-1")("tables")();
+  TableOccupancy::Table table;
+  table.set_name("ingress.table_1");
+  table.set_entries(900);
+  table.set_capacity(1000);
+
+  // Call the event handler. 'resp' will contain the message that is sent to the
+  // controller.
+  ::gnmi::SubscribeResponse resp;
+  EXPECT_OK(ExecuteOnChange(
+      path, TableOccupancyChangedEvent(kInterface1NodeId, table), &resp));
+
+  // Check that the result of the call is what is expected.
+  ASSERT_EQ(resp.update().update_size(), 2);
+  EXPECT_EQ(resp.update().update(0).path().elem(4).key().at("name"),
+            "ingress.table_1");
+  EXPECT_EQ(resp.update().update(0).val().uint_val(), 900U);
+  EXPECT_EQ(resp.update().update(1).val().uint_val(), 1000U);
+}
+
+// Check if /debug/nodes/node/tables OnChange action ignores events from other
+// nodes.
+TEST_F(YangParseTreeTest, DebugNodesNodeTablesOnChangeOtherNode) {
+  auto path = GetPath("debug")("nodes")("node", "node-1")("tables")();
+  TableOccupancy::Table table;
+  table.set_name("ingress.table_1");
+
+  ::gnmi::SubscribeResponse resp;
+  EXPECT_OK(ExecuteOnChange(
+      path, TableOccupancyChangedEvent(kInterface1NodeId + 1, table), &resp));
+  EXPECT_EQ(resp.update().update_size(), 0);
+}
+
+// Check if /debug/nodes/node/entry-quotas OnPoll action works correctly.
+TEST_F(YangParseTreeTest, DebugNodesNodeEntryQuotasOnPollSuccess) {
+  auto path = GetPath("debug")("nodes")("node", "node-1")("entry-quotas")();
+  parse_tree_.SetEntryQuotaUsageReader(
+      [](uint64 node_id, EntryQuotaUsage* usage) {
+        EXPECT_EQ(node_id, static_cast<uint64>(kInterface1NodeId));
+        auto* quota = usage->add_quotas();
+        quota->set_role("role_1");
+        quota->set_p4_id(12);
+        quota->set_entries(10);
+        quota->set_max_entries(100);
+        return ::util::OkStatus();
+      });
+
+  // Call the event handler. 'resp' will contain the message that is sent to the
+  // controller.
+  ::gnmi::SubscribeResponse resp;
+  EXPECT_OK(ExecuteOnPoll(path, &resp));
+
+  // Check that the result of the call is what is expected.
+  ASSERT_EQ(resp.update().update_size(), 2);
+  const auto& entries_path = resp.update().update(0).path();
+  ASSERT_EQ(entries_path.elem_size(), 7);
+  EXPECT_EQ(entries_path.elem(4).name(), "entry-quota");
+  EXPECT_EQ(entries_path.elem(4).key().at("role"), "role_1");
+  EXPECT_EQ(entries_path.elem(4).key().at("id"), "12");
+  EXPECT_EQ(entries_path.elem(6).name(), "entries");
+  EXPECT_EQ(resp.update().update(0).val().uint_val(), 10U);
+  EXPECT_EQ(resp.update().update(1).path().elem(6).name(), "max-entries");
+  EXPECT_EQ(resp.update().update(1).val().uint_val(), 100U);
+}
+
+// Check if /debug/nodes/node/entry-quotas OnPoll action sends an empty
+// response when the usage is not available.
+TEST_F(YangParseTreeTest, DebugNodesNodeEntryQuotasOnPollWithoutReader) {
+  auto path = GetPath("debug")("nodes")("node", "node-1")("entry-quotas")();
+
+  ::gnmi::SubscribeResponse resp;
+  EXPECT_OK(ExecuteOnPoll(path, &resp));
+  EXPECT_EQ(resp.update().update_size(), 0);
+}
+
 // Check if the '/components/component/optical-channel/config/frequency'
 // OnUpdate action works correctly.
 TEST_F(YangParseTreeOpticalChannelTest,
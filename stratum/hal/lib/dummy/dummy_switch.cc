@@ -65,6 +65,14 @@ namespace dummy_switch {
   return ::util::OkStatus();
 }
 
+::util::Status DummySwitch::PlanChassisConfig(const ChassisConfig& config,
+                                              ChassisConfigPlan* plan) {
+  absl::ReaderMutexLock l(&chassis_lock);
+  LOG(INFO) << __FUNCTION__;
+  return MAKE_ERROR(ERR_UNIMPLEMENTED)
+         << "Planning a chassis config is not supported.";
+}
+
 ::util::Status DummySwitch::PushForwardingPipelineConfig(
     uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
   absl::ReaderMutexLock l(&chassis_lock);
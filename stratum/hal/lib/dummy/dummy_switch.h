@@ -31,6 +31,9 @@ class DummySwitch : public SwitchInterface {
       LOCKS_EXCLUDED(chassis_lock) override;
   ::util::Status VerifyChassisConfig(const ChassisConfig& config)
       LOCKS_EXCLUDED(chassis_lock) override;
+  ::util::Status PlanChassisConfig(const ChassisConfig& config,
+                                   ChassisConfigPlan* plan)
+      LOCKS_EXCLUDED(chassis_lock) override;
   ::util::Status Shutdown() LOCKS_EXCLUDED(chassis_lock) override;
   ::util::Status Freeze() LOCKS_EXCLUDED(chassis_lock) override;
   ::util::Status Unfreeze() LOCKS_EXCLUDED(chassis_lock) override;
@@ -74,6 +74,12 @@ NP4Switch::~NP4Switch() {}
   return status;
 }
 
+::util::Status NP4Switch::PlanChassisConfig(const ChassisConfig& config,
+                                             ChassisConfigPlan* plan) {
+  return MAKE_ERROR(ERR_UNIMPLEMENTED)
+         << "Planning a chassis config is not supported.";
+}
+
 ::util::Status NP4Switch::PushForwardingPipelineConfig(
     uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config) {
   ASSIGN_OR_RETURN(auto* pi_node, GetPINodeFromNodeId(node_id));
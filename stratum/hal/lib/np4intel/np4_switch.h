@@ -28,6 +28,8 @@ class NP4Switch : public SwitchInterface {
   // SwitchInterface public methods.
   ::util::Status PushChassisConfig(const ChassisConfig& config) override;
   ::util::Status VerifyChassisConfig(const ChassisConfig& config) override;
+  ::util::Status PlanChassisConfig(const ChassisConfig& config,
+                                   ChassisConfigPlan* plan) override;
   ::util::Status PushForwardingPipelineConfig(
       uint64 node_id,
       const ::p4::v1::ForwardingPipelineConfig& config) override;
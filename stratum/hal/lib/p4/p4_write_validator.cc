@@ -0,0 +1,581 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+// P4WriteValidator implementation.
+
+#include "stratum/hal/lib/p4/p4_write_validator.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "absl/container/inlined_vector.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
+#include "stratum/glue/logging.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+
+namespace {
+
+constexpr char kRefersToAnnotation[] = "@refers_to";
+constexpr char kMulticastGroupTable[] = "builtin::multicast_group_table";
+constexpr char kCloneSessionTable[] = "builtin::clone_session_table";
+
+// Returns the number of bytes of a value with the given bit width.
+size_t NumBytes(int32 bitwidth) { return (bitwidth + 7) / 8; }
+
+// Removes the leading zero bytes of a byte string.
+absl::string_view StripLeadingZeros(absl::string_view value) {
+  while (!value.empty() && value.front() == '\0') value.remove_prefix(1);
+  return value;
+}
+
+// Returns the number of significant bits of a byte string.
+int32 SignificantBits(absl::string_view value) {
+  value = StripLeadingZeros(value);
+  if (value.empty()) return 0;
+  int32 bits = (value.size() - 1) * 8;
+  for (uint8 byte = value.front(); byte != 0; byte >>= 1) ++bits;
+  return bits;
+}
+
+// Returns true if the byte string has no leading zero byte, except for the
+// single zero byte that encodes 0.
+bool IsCanonical(absl::string_view value) {
+  return value.size() == 1 || (!value.empty() && value.front() != '\0');
+}
+
+// Returns true if all the bits of value outside of mask are zero.
+bool IsMaskedBy(absl::string_view value, absl::string_view mask) {
+  for (size_t i = 0; i < value.size(); ++i) {
+    uint8 value_byte = value[value.size() - 1 - i];
+    uint8 mask_byte = i < mask.size() ? mask[mask.size() - 1 - i] : 0;
+    if (value_byte & ~mask_byte) return false;
+  }
+  return true;
+}
+
+// Returns true if the lowest num_bits bits of value are zero.
+bool LowBitsAreZero(absl::string_view value, int32 num_bits) {
+  for (size_t i = 0; num_bits > 0 && i < value.size(); ++i, num_bits -= 8) {
+    uint8 mask = num_bits >= 8 ? 0xff : (1 << num_bits) - 1;
+    if (value[value.size() - 1 - i] & mask) return false;
+  }
+  return true;
+}
+
+// Returns true if the byte string has all the lowest bitwidth bits set.
+bool IsAllOnes(absl::string_view value, int32 bitwidth) {
+  int32 ones = 0;
+  for (uint8 byte : StripLeadingZeros(value)) {
+    for (; byte != 0; byte >>= 1) ones += byte & 1;
+  }
+  return ones == bitwidth && SignificantBits(value) == bitwidth;
+}
+
+// Compares two byte strings as unsigned integers, like memcmp.
+int CompareValues(absl::string_view a, absl::string_view b) {
+  a = StripLeadingZeros(a);
+  b = StripLeadingZeros(b);
+  if (a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+  return std::memcmp(a.data(), b.data(), a.size());
+}
+
+// Parses a "@refers_to(table, field)" annotation.  Returns false if the
+// annotation is of another kind or malformed.
+bool ParseRefersTo(absl::string_view annotation, std::string* table,
+                   std::string* field) {
+  if (!absl::ConsumePrefix(&annotation, kRefersToAnnotation)) return false;
+  if (!absl::ConsumePrefix(&annotation, "(") ||
+      !absl::ConsumeSuffix(&annotation, ")")) {
+    return false;
+  }
+  std::vector<std::string> args =
+      absl::StrSplit(annotation, ',', absl::SkipWhitespace());
+  if (args.size() != 2) return false;
+  *table = std::string(absl::StripAsciiWhitespace(args[0]));
+  *field = std::string(absl::StripAsciiWhitespace(args[1]));
+  return true;
+}
+
+}  // namespace
+
+P4WriteValidator::P4WriteValidator(const ::p4::config::v1::P4Info& p4_info) {
+  for (const auto& action : p4_info.actions()) {
+    ActionConstraint& constraint = actions_[action.preamble().id()];
+    constraint.name = action.preamble().name();
+    for (const auto& param : action.params()) {
+      ParamConstraint param_constraint;
+      param_constraint.id = param.id();
+      param_constraint.name = param.name();
+      param_constraint.value =
+          CompileValue(param.bitwidth(), param.type_name().name(),
+                       param.annotations(), p4_info);
+      constraint.params.push_back(param_constraint);
+    }
+  }
+
+  for (const auto& table : p4_info.tables()) {
+    TableConstraint& constraint = tables_[table.preamble().id()];
+    constraint.name = table.preamble().name();
+    constraint.is_const = table.is_const_table();
+    constraint.has_implementation = table.implementation_id() != 0;
+    constraint.const_default_action_id = table.const_default_action_id();
+    for (const auto& match_field : table.match_fields()) {
+      FieldConstraint field;
+      field.id = match_field.id();
+      field.name = match_field.name();
+      field.match_type = match_field.match_type();
+      field.value =
+          CompileValue(match_field.bitwidth(), match_field.type_name().name(),
+                       match_field.annotations(), p4_info);
+      switch (field.match_type) {
+        case ::p4::config::v1::MatchField::EXACT:
+          ++constraint.num_exact_fields;
+          break;
+        case ::p4::config::v1::MatchField::TERNARY:
+        case ::p4::config::v1::MatchField::RANGE:
+        case ::p4::config::v1::MatchField::OPTIONAL:
+          constraint.requires_priority = true;
+          break;
+        default:
+          break;
+      }
+      constraint.fields.push_back(field);
+    }
+    for (const auto& action_ref : table.action_refs()) {
+      constraint.actions[action_ref.id()] = action_ref.scope();
+    }
+  }
+}
+
+P4WriteValidator::ValueConstraint P4WriteValidator::CompileValue(
+    int32 bitwidth, const std::string& type_name,
+    const ::google::protobuf::RepeatedPtrField<std::string>& annotations,
+    const ::p4::config::v1::P4Info& p4_info) const {
+  ValueConstraint constraint;
+  constraint.bitwidth = bitwidth;
+  if (!type_name.empty()) {
+    const auto& new_types = p4_info.type_info().new_types();
+    auto iter = new_types.find(type_name);
+    if (iter != new_types.end() &&
+        iter->second.representation_case() ==
+            ::p4::config::v1::P4NewTypeSpec::kTranslatedType) {
+      const auto& translated_type = iter->second.translated_type();
+      constraint.translated = true;
+      if (translated_type.sdn_type_case() ==
+          ::p4::config::v1::P4NewTypeTranslation::kSdnBitwidth) {
+        constraint.bitwidth =
+            std::max(bitwidth, translated_type.sdn_bitwidth());
+      } else {
+        constraint.bitwidth = 0;  // SDN strings have no width.
+      }
+    }
+  }
+
+  for (const auto& annotation : annotations) {
+    std::string table_name, field_name;
+    if (!ParseRefersTo(annotation, &table_name, &field_name)) continue;
+    Reference& reference = constraint.reference;
+    reference.target = absl::StrCat(table_name, ".", field_name);
+    if (table_name == kMulticastGroupTable) {
+      reference.bitwidth = 32;
+      reference.nonzero = true;
+      constraint.has_reference = true;
+      continue;
+    }
+    if (table_name == kCloneSessionTable) {
+      reference.bitwidth = 32;
+      constraint.has_reference = true;
+      continue;
+    }
+    for (const auto& table : p4_info.tables()) {
+      if (table.preamble().name() != table_name &&
+          table.preamble().alias() != table_name) {
+        continue;
+      }
+      for (const auto& match_field : table.match_fields()) {
+        if (match_field.name() != field_name) continue;
+        reference.bitwidth =
+            match_field.type_name().name().empty() ? match_field.bitwidth() : 0;
+        constraint.has_reference = true;
+      }
+    }
+    if (!constraint.has_reference) {
+      LOG(WARNING) << "Ignoring annotation " << annotation
+                   << " with an unknown target.";
+    }
+  }
+
+  return constraint;
+}
+
+::util::Status P4WriteValidator::ValidateUpdate(
+    const ::p4::v1::Update& update) const {
+  if (update.type() == ::p4::v1::Update::UNSPECIFIED) {
+    return MAKE_ERROR(ERR_INVALID_PARAM) << "Invalid update type "
+                                         << ::p4::v1::Update::Type_Name(
+                                                update.type())
+                                         << ".";
+  }
+  if (update.entity().entity_case() == ::p4::v1::Entity::kTableEntry) {
+    return ValidateTableEntry(update.type(), update.entity().table_entry());
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status P4WriteValidator::ValidateTableEntry(
+    ::p4::v1::Update::Type type,
+    const ::p4::v1::TableEntry& table_entry) const {
+  auto iter = tables_.find(table_entry.table_id());
+  if (iter == tables_.end()) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "Unknown table ID " << table_entry.table_id() << ".";
+  }
+  const TableConstraint& table = iter->second;
+
+  if (table_entry.is_default_action()) {
+    if (type != ::p4::v1::Update::MODIFY) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "The default entry of table '" << table.name
+             << "' can only be modified.";
+    }
+    if (table.const_default_action_id != 0) {
+      return MAKE_ERROR(ERR_PERMISSION_DENIED)
+             << "Table '" << table.name << "' has a const default action.";
+    }
+    if (table_entry.match_size() > 0 || table_entry.priority() != 0) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "The default entry of table '" << table.name
+             << "' must not have match fields or a priority.";
+    }
+    // An unset action resets the default entry.
+    if (!table_entry.has_action()) return ::util::OkStatus();
+    if (table_entry.action().type_case() != ::p4::v1::TableAction::kAction) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "The default entry of table '" << table.name
+             << "' must have a direct action.";
+    }
+    return ValidateDirectAction(table, table_entry.action().action(), true);
+  }
+
+  if (table.is_const) {
+    return MAKE_ERROR(ERR_PERMISSION_DENIED)
+           << "Can't write to table '" << table.name
+           << "' because it has const entries.";
+  }
+  RETURN_IF_ERROR(ValidateMatch(table, table_entry));
+  // Deletes only need the key.
+  if (type == ::p4::v1::Update::DELETE) return ::util::OkStatus();
+
+  return ValidateAction(table, table_entry);
+}
+
+::util::Status P4WriteValidator::ValidateMatch(
+    const TableConstraint& table,
+    const ::p4::v1::TableEntry& table_entry) const {
+  if (table.requires_priority && table_entry.priority() <= 0) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Entries of table '" << table.name
+           << "' need a positive priority.";
+  }
+  if (!table.requires_priority && table_entry.priority() != 0) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Entries of table '" << table.name
+           << "' must not have a priority.";
+  }
+
+  absl::InlinedVector<bool, 16> seen(table.fields.size(), false);
+  int num_exact_fields = 0;
+  for (const auto& match : table_entry.match()) {
+    auto field_iter = std::find_if(
+        table.fields.begin(), table.fields.end(),
+        [&match](const FieldConstraint& f) {
+          return f.id == match.field_id();
+        });
+    if (field_iter == table.fields.end()) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Unknown match field ID " << match.field_id() << " in table '"
+             << table.name << "'.";
+    }
+    const FieldConstraint& field = *field_iter;
+    size_t index = field_iter - table.fields.begin();
+    if (seen[index]) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Duplicate match field '" << field.name << "' in table '"
+             << table.name << "'.";
+    }
+    seen[index] = true;
+
+    const int32 bitwidth = field.value.bitwidth;
+    bool type_matches = false;
+    switch (match.field_match_type_case()) {
+      case ::p4::v1::FieldMatch::kExact:
+        type_matches = field.match_type == ::p4::config::v1::MatchField::EXACT;
+        if (!type_matches) break;
+        ++num_exact_fields;
+        RETURN_IF_ERROR_WITH_APPEND(
+            ValidateValue(field.value, match.exact().value(), field.name))
+            << " in table '" << table.name << "'.";
+        RETURN_IF_ERROR_WITH_APPEND(
+            ValidateReference(field.value, match.exact().value(), field.name))
+            << " in table '" << table.name << "'.";
+        break;
+      case ::p4::v1::FieldMatch::kTernary: {
+        type_matches =
+            field.match_type == ::p4::config::v1::MatchField::TERNARY;
+        if (!type_matches) break;
+        const auto& value = match.ternary().value();
+        const auto& mask = match.ternary().mask();
+        RETURN_IF_ERROR_WITH_APPEND(
+            ValidateValue(field.value, value, field.name))
+            << " in table '" << table.name << "'.";
+        RETURN_IF_ERROR_WITH_APPEND(
+            ValidateValue(field.value, mask, field.name))
+            << " in table '" << table.name << "'.";
+        if (SignificantBits(mask) == 0) {
+          return MAKE_ERROR(ERR_INVALID_PARAM)
+                 << "Don't care match on field '" << field.name
+                 << "' in table '" << table.name << "' must be omitted.";
+        }
+        if (!IsMaskedBy(value, mask)) {
+          return MAKE_ERROR(ERR_INVALID_PARAM)
+                 << "Ternary value of field '" << field.name << "' in table '"
+                 << table.name << "' has bits set outside of the mask.";
+        }
+        break;
+      }
+      case ::p4::v1::FieldMatch::kLpm: {
+        type_matches = field.match_type == ::p4::config::v1::MatchField::LPM;
+        if (!type_matches) break;
+        const auto& value = match.lpm().value();
+        const int32 prefix_len = match.lpm().prefix_len();
+        RETURN_IF_ERROR_WITH_APPEND(
+            ValidateValue(field.value, value, field.name))
+            << " in table '" << table.name << "'.";
+        if (prefix_len == 0) {
+          return MAKE_ERROR(ERR_INVALID_PARAM)
+                 << "Don't care match on field '" << field.name
+                 << "' in table '" << table.name << "' must be omitted.";
+        }
+        if (prefix_len < 0 || (bitwidth > 0 && prefix_len > bitwidth)) {
+          return MAKE_ERROR(ERR_INVALID_PARAM)
+                 << "Invalid prefix length " << prefix_len << " for field '"
+                 << field.name << "' in table '" << table.name << "'.";
+        }
+        if (bitwidth > 0 && !LowBitsAreZero(value, bitwidth - prefix_len)) {
+          return MAKE_ERROR(ERR_INVALID_PARAM)
+                 << "LPM value of field '" << field.name << "' in table '"
+                 << table.name << "' has bits set after the prefix.";
+        }
+        break;
+      }
+      case ::p4::v1::FieldMatch::kRange: {
+        type_matches = field.match_type == ::p4::config::v1::MatchField::RANGE;
+        if (!type_matches) break;
+        const auto& low = match.range().low();
+        const auto& high = match.range().high();
+        RETURN_IF_ERROR_WITH_APPEND(ValidateValue(field.value, low, field.name))
+            << " in table '" << table.name << "'.";
+        RETURN_IF_ERROR_WITH_APPEND(
+            ValidateValue(field.value, high, field.name))
+            << " in table '" << table.name << "'.";
+        if (CompareValues(low, high) > 0) {
+          return MAKE_ERROR(ERR_INVALID_PARAM)
+                 << "Range of field '" << field.name << "' in table '"
+                 << table.name << "' has a low bound above the high bound.";
+        }
+        if (bitwidth > 0 && SignificantBits(low) == 0 &&
+            IsAllOnes(high, bitwidth)) {
+          return MAKE_ERROR(ERR_INVALID_PARAM)
+                 << "Don't care match on field '" << field.name
+                 << "' in table '" << table.name << "' must be omitted.";
+        }
+        break;
+      }
+      case ::p4::v1::FieldMatch::kOptional:
+        type_matches =
+            field.match_type == ::p4::config::v1::MatchField::OPTIONAL;
+        if (!type_matches) break;
+        RETURN_IF_ERROR_WITH_APPEND(
+            ValidateValue(field.value, match.optional().value(), field.name))
+            << " in table '" << table.name << "'.";
+        RETURN_IF_ERROR_WITH_APPEND(ValidateReference(
+            field.value, match.optional().value(), field.name))
+            << " in table '" << table.name << "'.";
+        break;
+      case ::p4::v1::FieldMatch::kOther:
+        return MAKE_ERROR(ERR_UNIMPLEMENTED)
+               << "Architecture-specific match on field '" << field.name
+               << "' in table '" << table.name << "' is not supported.";
+      default:
+        break;
+    }
+    if (!type_matches) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Match on field '" << field.name << "' in table '"
+             << table.name << "' does not have the match type "
+             << ::p4::config::v1::MatchField::MatchType_Name(field.match_type)
+             << ".";
+    }
+  }
+
+  if (num_exact_fields != table.num_exact_fields) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Entries of table '" << table.name << "' need all "
+           << table.num_exact_fields << " exact match fields.";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status P4WriteValidator::ValidateAction(
+    const TableConstraint& table,
+    const ::p4::v1::TableEntry& table_entry) const {
+  const auto& action = table_entry.action();
+  switch (action.type_case()) {
+    case ::p4::v1::TableAction::kAction:
+      if (table.has_implementation) {
+        return MAKE_ERROR(ERR_INVALID_PARAM)
+               << "Entries of table '" << table.name
+               << "' need an action profile member or group.";
+      }
+      return ValidateDirectAction(table, action.action(), false);
+    case ::p4::v1::TableAction::kActionProfileMemberId:
+    case ::p4::v1::TableAction::kActionProfileGroupId:
+    case ::p4::v1::TableAction::kActionProfileActionSet:
+      if (!table.has_implementation) {
+        return MAKE_ERROR(ERR_INVALID_PARAM)
+               << "Table '" << table.name << "' has no action profile.";
+      }
+      if (action.type_case() ==
+          ::p4::v1::TableAction::kActionProfileActionSet) {
+        for (const auto& profile_action :
+             action.action_profile_action_set().action_profile_actions()) {
+          RETURN_IF_ERROR(
+              ValidateDirectAction(table, profile_action.action(), false));
+        }
+      }
+      return ::util::OkStatus();
+    default:
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Entry of table '" << table.name << "' has no action.";
+  }
+}
+
+::util::Status P4WriteValidator::ValidateDirectAction(
+    const TableConstraint& table, const ::p4::v1::Action& action,
+    bool is_default_action) const {
+  auto scope_iter = table.actions.find(action.action_id());
+  if (scope_iter == table.actions.end()) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Action ID " << action.action_id()
+           << " is not an action of table '" << table.name << "'.";
+  }
+  auto action_iter = actions_.find(action.action_id());
+  if (action_iter == actions_.end()) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Unknown action ID " << action.action_id() << " in table '"
+           << table.name << "'.";
+  }
+  const ActionConstraint& constraint = action_iter->second;
+  if (is_default_action &&
+      scope_iter->second == ::p4::config::v1::ActionRef::TABLE_ONLY) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Action '" << constraint.name << "' of table '" << table.name
+           << "' can't be the default action.";
+  }
+  if (!is_default_action &&
+      scope_iter->second == ::p4::config::v1::ActionRef::DEFAULT_ONLY) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Action '" << constraint.name << "' of table '" << table.name
+           << "' can only be the default action.";
+  }
+
+  absl::InlinedVector<bool, 16> seen(constraint.params.size(), false);
+  for (const auto& param : action.params()) {
+    auto param_iter = std::find_if(
+        constraint.params.begin(), constraint.params.end(),
+        [&param](const ParamConstraint& p) {
+          return p.id == param.param_id();
+        });
+    if (param_iter == constraint.params.end()) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Unknown param ID " << param.param_id() << " of action '"
+             << constraint.name << "'.";
+    }
+    size_t index = param_iter - constraint.params.begin();
+    if (seen[index]) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Duplicate param '" << param_iter->name << "' of action '"
+             << constraint.name << "'.";
+    }
+    seen[index] = true;
+    RETURN_IF_ERROR_WITH_APPEND(
+        ValidateValue(param_iter->value, param.value(), param_iter->name))
+        << " of action '" << constraint.name << "'.";
+    RETURN_IF_ERROR_WITH_APPEND(
+        ValidateReference(param_iter->value, param.value(), param_iter->name))
+        << " of action '" << constraint.name << "'.";
+  }
+  if (static_cast<size_t>(action.params_size()) != constraint.params.size()) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Action '" << constraint.name << "' needs all its "
+           << constraint.params.size() << " params.";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status P4WriteValidator::ValidateValue(
+    const ValueConstraint& constraint, absl::string_view value,
+    absl::string_view name) {
+  if (value.empty()) {
+    return MAKE_ERROR(ERR_INVALID_PARAM) << "Value of '" << name
+                                         << "' is an empty byte string";
+  }
+  if (constraint.bitwidth == 0) return ::util::OkStatus();
+  if (!constraint.translated && !IsCanonical(value) &&
+      value.size() != NumBytes(constraint.bitwidth)) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Value of '" << name << "' is neither canonical nor padded to "
+           << NumBytes(constraint.bitwidth) << " bytes";
+  }
+  if (SignificantBits(value) > constraint.bitwidth) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Value of '" << name << "' does not fit in "
+           << constraint.bitwidth << " bits";
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status P4WriteValidator::ValidateReference(
+    const ValueConstraint& constraint, absl::string_view value,
+    absl::string_view name) {
+  if (constraint.has_reference) {
+    const Reference& reference = constraint.reference;
+    const int32 bits = SignificantBits(value);
+    if (reference.nonzero && bits == 0) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Value of '" << name << "' refers to " << reference.target
+             << ", which does not allow 0";
+    }
+    if (reference.bitwidth > 0 && bits > reference.bitwidth) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Value of '" << name << "' does not fit in the "
+             << reference.bitwidth << "-bit " << reference.target
+             << " it refers to";
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
+}  // namespace hal
+}  // namespace stratum
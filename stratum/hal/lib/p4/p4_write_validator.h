@@ -0,0 +1,154 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+// The P4WriteValidator checks P4Runtime write updates against the P4Info
+// before a switch does any target work for them.
+
+#ifndef STRATUM_HAL_LIB_P4_P4_WRITE_VALIDATOR_H_
+#define STRATUM_HAL_LIB_P4_P4_WRITE_VALIDATOR_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "p4/config/v1/p4info.pb.h"
+#include "p4/v1/p4runtime.pb.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+
+namespace stratum {
+namespace hal {
+
+// A P4WriteValidator compiles the constraints of each table and action in a
+// P4Info into flat descriptors once, when a switch pushes a new pipeline.  The
+// switch then calls ValidateUpdate for each update of a WriteRequest before
+// it makes any SDK call.  Invalid updates fail with the error codes that the
+// P4Runtime specification requires:
+//  - ERR_ENTRY_NOT_FOUND (NOT_FOUND) for unknown table IDs.
+//  - ERR_PERMISSION_DENIED (PERMISSION_DENIED) for writes to const tables
+//    and const default actions.
+//  - ERR_UNIMPLEMENTED (UNIMPLEMENTED) for architecture-specific match kinds.
+//  - ERR_INVALID_PARAM (INVALID_ARGUMENT) for everything else, e.g.
+//    non-canonical or oversized byte strings, ternary value bits outside the
+//    mask, don't care matches, missing or unexpected priorities, actions that
+//    the table does not list, missing action params, and values that do not
+//    fit the field a @refers_to annotation references.
+//
+// Byte strings are valid in their canonical form or padded to the full byte
+// width of their field.  Fields and params with a translated P4Runtime type
+// are checked against the SDN bit width, in any padding.  The validator has
+// no entry state, so it can't tell if a referenced entry exists.  Updates of
+// other entities than table entries are not checked yet.
+//
+// A P4WriteValidator is immutable after construction, so all its methods
+// are thread-safe.
+class P4WriteValidator {
+ public:
+  explicit P4WriteValidator(const ::p4::config::v1::P4Info& p4_info);
+  virtual ~P4WriteValidator() {}
+
+  // Validates one update of a WriteRequest.
+  ::util::Status ValidateUpdate(const ::p4::v1::Update& update) const;
+
+  // Validates a table entry for the given update type.
+  ::util::Status ValidateTableEntry(
+      ::p4::v1::Update::Type type,
+      const ::p4::v1::TableEntry& table_entry) const;
+
+  // P4WriteValidator is neither copyable nor movable.
+  P4WriteValidator(const P4WriteValidator&) = delete;
+  P4WriteValidator& operator=(const P4WriteValidator&) = delete;
+
+ private:
+  // The value that a @refers_to annotation references.
+  struct Reference {
+    std::string target;  // "table.field" for error messages.
+    int32 bitwidth = 0;  // 0 if the target width is unknown.
+    bool nonzero = false;  // True if the value 0 is reserved by the target.
+  };
+
+  // The constraints of one byte string value.  A bitwidth of 0 disables the
+  // width checks, e.g. for translated string types.
+  struct ValueConstraint {
+    int32 bitwidth = 0;
+    // Translated values may come in SDN or SDK width, in any padding.
+    bool translated = false;
+    // Set if the value refers to another entity.
+    bool has_reference = false;
+    Reference reference;
+  };
+
+  struct FieldConstraint {
+    uint32 id = 0;
+    std::string name;
+    ::p4::config::v1::MatchField::MatchType match_type =
+        ::p4::config::v1::MatchField::UNSPECIFIED;
+    ValueConstraint value;
+  };
+
+  struct ParamConstraint {
+    uint32 id = 0;
+    std::string name;
+    ValueConstraint value;
+  };
+
+  struct ActionConstraint {
+    std::string name;
+    std::vector<ParamConstraint> params;
+  };
+
+  struct TableConstraint {
+    std::string name;
+    // The fields are in P4Info order.  Tables have few fields, so a linear
+    // search is faster than a map lookup.
+    std::vector<FieldConstraint> fields;
+    int num_exact_fields = 0;
+    bool requires_priority = false;
+    bool is_const = false;
+    bool has_implementation = false;
+    uint32 const_default_action_id = 0;
+    // Maps the action IDs of the table to their scope.
+    absl::flat_hash_map<uint32, ::p4::config::v1::ActionRef::Scope> actions;
+  };
+
+  // Compiles the value constraint of a match field or action param.
+  ValueConstraint CompileValue(
+      int32 bitwidth, const std::string& type_name,
+      const ::google::protobuf::RepeatedPtrField<std::string>& annotations,
+      const ::p4::config::v1::P4Info& p4_info) const;
+
+  // Validates the match fields and the priority of a table entry.
+  ::util::Status ValidateMatch(const TableConstraint& table,
+                               const ::p4::v1::TableEntry& table_entry) const;
+
+  // Validates the action of an INSERT or MODIFY.
+  ::util::Status ValidateAction(const TableConstraint& table,
+                                const ::p4::v1::TableEntry& table_entry) const;
+
+  // Validates a direct action against the table's action list.
+  ::util::Status ValidateDirectAction(const TableConstraint& table,
+                                      const ::p4::v1::Action& action,
+                                      bool is_default_action) const;
+
+  // Validates the encoding and the width of one byte string value.  The
+  // name is only used for errors.
+  static ::util::Status ValidateValue(const ValueConstraint& constraint,
+                                      absl::string_view value,
+                                      absl::string_view name);
+
+  // Validates an exact match value or an action param value against the
+  // target of its @refers_to annotation, if any.
+  static ::util::Status ValidateReference(const ValueConstraint& constraint,
+                                          absl::string_view value,
+                                          absl::string_view name);
+
+  // Maps P4 IDs to the compiled constraints.
+  absl::flat_hash_map<uint32, TableConstraint> tables_;
+  absl::flat_hash_map<uint32, ActionConstraint> actions_;
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_P4_P4_WRITE_VALIDATOR_H_
@@ -0,0 +1,532 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+// Contains unit tests for P4WriteValidator.
+
+#include "stratum/hal/lib/p4/p4_write_validator.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+
+namespace {
+
+constexpr char kP4InfoText[] = R"pb(
+  tables {
+    preamble { id: 1 name: "ingress.exact_table" }
+    match_fields { id: 1 name: "port" bitwidth: 9 match_type: EXACT }
+    match_fields { id: 2 name: "vrf" bitwidth: 12 match_type: EXACT }
+    action_refs { id: 10 }
+    action_refs { id: 11 scope: TABLE_ONLY }
+    action_refs { id: 12 scope: DEFAULT_ONLY }
+  }
+  tables {
+    preamble { id: 2 name: "ingress.acl_table" }
+    match_fields { id: 1 name: "ether_type" bitwidth: 16 match_type: TERNARY }
+    match_fields { id: 2 name: "ipv4_dst" bitwidth: 32 match_type: LPM }
+    match_fields { id: 3 name: "l4_port" bitwidth: 16 match_type: RANGE }
+    match_fields { id: 4 name: "ip_proto" bitwidth: 8 match_type: OPTIONAL }
+    action_refs { id: 13 }
+    action_refs { id: 14 }
+  }
+  tables {
+    preamble { id: 3 name: "ingress.profile_table" }
+    match_fields { id: 1 name: "hash" bitwidth: 16 match_type: EXACT }
+    action_refs { id: 10 }
+    implementation_id: 100
+  }
+  tables {
+    preamble { id: 4 name: "ingress.const_table" }
+    match_fields { id: 1 name: "port" bitwidth: 9 match_type: EXACT }
+    action_refs { id: 11 }
+    const_default_action_id: 11
+    is_const_table: true
+  }
+  tables {
+    preamble { id: 5 name: "ingress.translated_table" }
+    match_fields {
+      id: 1
+      name: "port"
+      bitwidth: 9
+      match_type: EXACT
+      type_name { name: "PortId_t" }
+    }
+    action_refs { id: 11 }
+  }
+  actions {
+    preamble { id: 10 name: "set_port" }
+    params { id: 1 name: "port" bitwidth: 9 }
+    params { id: 2 name: "vlan" bitwidth: 12 }
+  }
+  actions { preamble { id: 11 name: "drop" } }
+  actions { preamble { id: 12 name: "default_only" } }
+  actions {
+    preamble { id: 13 name: "set_mcast_group" }
+    params {
+      id: 1
+      name: "group"
+      bitwidth: 16
+      annotations: "@refers_to(builtin::multicast_group_table, "
+                   "multicast_group_id)"
+    }
+  }
+  actions {
+    preamble { id: 14 name: "set_vrf" }
+    params {
+      id: 1
+      name: "vrf"
+      bitwidth: 16
+      annotations: "@refers_to(ingress.exact_table, vrf)"
+    }
+  }
+  type_info {
+    new_types {
+      key: "PortId_t"
+      value { translated_type { uri: "tna/PortId_t" sdn_bitwidth: 32 } }
+    }
+  }
+)pb";
+
+// A table-driven test case.  The table entry is in text format.
+struct ValidatorTestCase {
+  std::string name;
+  ::p4::v1::Update::Type type;
+  std::string table_entry;
+  ErrorCode expected_error;
+};
+
+const std::vector<ValidatorTestCase>& TestCases() {
+  static const auto* test_cases = new std::vector<ValidatorTestCase>({
+      // Exact matches and direct actions.
+      {"ValidExactEntry", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 1
+            match { field_id: 1 exact { value: "\x01" } }
+            match { field_id: 2 exact { value: "\x0f\xff" } }
+            action {
+              action {
+                action_id: 10
+                params { param_id: 1 value: "\x01\xff" }
+                params { param_id: 2 value: "\x00" }
+              }
+            })pb",
+       ERR_SUCCESS},
+      {"PaddedValueIsValid", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 1
+            match { field_id: 1 exact { value: "\x00\x01" } }
+            match { field_id: 2 exact { value: "\x01" } }
+            action { action { action_id: 11 } })pb",
+       ERR_SUCCESS},
+      {"UnknownTable", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 99 action { action { action_id: 11 } })pb",
+       ERR_ENTRY_NOT_FOUND},
+      {"UnknownField", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 1
+            match { field_id: 1 exact { value: "\x01" } }
+            match { field_id: 2 exact { value: "\x01" } }
+            match { field_id: 3 exact { value: "\x01" } }
+            action { action { action_id: 11 } })pb",
+       ERR_INVALID_PARAM},
+      {"DuplicateField", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 1
+            match { field_id: 1 exact { value: "\x01" } }
+            match { field_id: 1 exact { value: "\x02" } }
+            action { action { action_id: 11 } })pb",
+       ERR_INVALID_PARAM},
+      {"MissingExactField", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 1
+            match { field_id: 1 exact { value: "\x01" } }
+            action { action { action_id: 11 } })pb",
+       ERR_INVALID_PARAM},
+      {"WrongMatchType", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 1
+            match { field_id: 1 ternary { value: "\x01" mask: "\x01" } }
+            match { field_id: 2 exact { value: "\x01" } }
+            action { action { action_id: 11 } })pb",
+       ERR_INVALID_PARAM},
+      {"NonCanonicalValue", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 1
+            match { field_id: 1 exact { value: "\x01" } }
+            match { field_id: 2 exact { value: "\x00\x00\x01" } }
+            action { action { action_id: 11 } })pb",
+       ERR_INVALID_PARAM},
+      {"EmptyValue", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 1
+            match { field_id: 1 exact { value: "" } }
+            match { field_id: 2 exact { value: "\x01" } }
+            action { action { action_id: 11 } })pb",
+       ERR_INVALID_PARAM},
+      {"OversizedValue", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 1
+            match { field_id: 1 exact { value: "\x02\x00" } }
+            match { field_id: 2 exact { value: "\x01" } }
+            action { action { action_id: 11 } })pb",
+       ERR_INVALID_PARAM},
+      {"PriorityOnExactTable", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 1
+            match { field_id: 1 exact { value: "\x01" } }
+            match { field_id: 2 exact { value: "\x01" } }
+            priority: 10
+            action { action { action_id: 11 } })pb",
+       ERR_INVALID_PARAM},
+      {"MissingAction", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 1
+            match { field_id: 1 exact { value: "\x01" } }
+            match { field_id: 2 exact { value: "\x01" } })pb",
+       ERR_INVALID_PARAM},
+      {"ActionNotInTable", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 1
+            match { field_id: 1 exact { value: "\x01" } }
+            match { field_id: 2 exact { value: "\x01" } }
+            action { action { action_id: 13 } })pb",
+       ERR_INVALID_PARAM},
+      {"DefaultOnlyActionInEntry", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 1
+            match { field_id: 1 exact { value: "\x01" } }
+            match { field_id: 2 exact { value: "\x01" } }
+            action { action { action_id: 12 } })pb",
+       ERR_INVALID_PARAM},
+      {"MissingActionParam", ::p4::v1::Update::MODIFY,
+       R"pb(table_id: 1
+            match { field_id: 1 exact { value: "\x01" } }
+            match { field_id: 2 exact { value: "\x01" } }
+            action {
+              action {
+                action_id: 10
+                params { param_id: 1 value: "\x01" }
+              }
+            })pb",
+       ERR_INVALID_PARAM},
+      {"UnknownActionParam", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 1
+            match { field_id: 1 exact { value: "\x01" } }
+            match { field_id: 2 exact { value: "\x01" } }
+            action {
+              action {
+                action_id: 10
+                params { param_id: 1 value: "\x01" }
+                params { param_id: 2 value: "\x01" }
+                params { param_id: 3 value: "\x01" }
+              }
+            })pb",
+       ERR_INVALID_PARAM},
+      {"DuplicateActionParam", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 1
+            match { field_id: 1 exact { value: "\x01" } }
+            match { field_id: 2 exact { value: "\x01" } }
+            action {
+              action {
+                action_id: 10
+                params { param_id: 1 value: "\x01" }
+                params { param_id: 1 value: "\x01" }
+              }
+            })pb",
+       ERR_INVALID_PARAM},
+      {"OversizedActionParam", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 1
+            match { field_id: 1 exact { value: "\x01" } }
+            match { field_id: 2 exact { value: "\x01" } }
+            action {
+              action {
+                action_id: 10
+                params { param_id: 1 value: "\x01" }
+                params { param_id: 2 value: "\x10\x00" }
+              }
+            })pb",
+       ERR_INVALID_PARAM},
+      {"DeleteIgnoresAction", ::p4::v1::Update::DELETE,
+       R"pb(table_id: 1
+            match { field_id: 1 exact { value: "\x01" } }
+            match { field_id: 2 exact { value: "\x01" } })pb",
+       ERR_SUCCESS},
+      {"DeleteChecksMatch", ::p4::v1::Update::DELETE,
+       R"pb(table_id: 1 match { field_id: 1 exact { value: "\x01" } })pb",
+       ERR_INVALID_PARAM},
+
+      // Default entries.
+      {"ModifyDefaultEntry", ::p4::v1::Update::MODIFY,
+       R"pb(table_id: 1
+            is_default_action: true
+            action { action { action_id: 12 } })pb",
+       ERR_SUCCESS},
+      {"ResetDefaultEntry", ::p4::v1::Update::MODIFY,
+       R"pb(table_id: 1 is_default_action: true)pb", ERR_SUCCESS},
+      {"InsertDefaultEntry", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 1
+            is_default_action: true
+            action { action { action_id: 12 } })pb",
+       ERR_INVALID_PARAM},
+      {"TableOnlyDefaultAction", ::p4::v1::Update::MODIFY,
+       R"pb(table_id: 1
+            is_default_action: true
+            action { action { action_id: 11 } })pb",
+       ERR_INVALID_PARAM},
+      {"DefaultEntryWithMatch", ::p4::v1::Update::MODIFY,
+       R"pb(table_id: 1
+            is_default_action: true
+            match { field_id: 1 exact { value: "\x01" } }
+            action { action { action_id: 12 } })pb",
+       ERR_INVALID_PARAM},
+      {"ConstDefaultAction", ::p4::v1::Update::MODIFY,
+       R"pb(table_id: 4
+            is_default_action: true
+            action { action { action_id: 11 } })pb",
+       ERR_PERMISSION_DENIED},
+      {"ConstTable", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 4
+            match { field_id: 1 exact { value: "\x01" } }
+            action { action { action_id: 11 } })pb",
+       ERR_PERMISSION_DENIED},
+
+      // Ternary, LPM, range, and optional matches.
+      {"ValidAclEntry", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 2
+            match { field_id: 1 ternary { value: "\x08\x00" mask: "\xff\xff" } }
+            match {
+              field_id: 2
+              lpm { value: "\x0a\x00\x00\x00" prefix_len: 8 }
+            }
+            match { field_id: 3 range { low: "\x50" high: "\x01\xbb" } }
+            match { field_id: 4 optional { value: "\x06" } }
+            priority: 10
+            action {
+              action {
+                action_id: 13
+                params { param_id: 1 value: "\x01" }
+              }
+            })pb",
+       ERR_SUCCESS},
+      {"AllFieldsOmitted", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 2
+            priority: 1
+            action {
+              action {
+                action_id: 14
+                params { param_id: 1 value: "\x0f\xff" }
+              }
+            })pb",
+       ERR_SUCCESS},
+      {"MissingPriority", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 2
+            match { field_id: 4 optional { value: "\x06" } }
+            action {
+              action {
+                action_id: 13
+                params { param_id: 1 value: "\x01" }
+              }
+            })pb",
+       ERR_INVALID_PARAM},
+      {"NegativePriority", ::p4::v1::Update::DELETE,
+       R"pb(table_id: 2 priority: -1)pb", ERR_INVALID_PARAM},
+      {"TernaryValueOutsideMask", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 2
+            match { field_id: 1 ternary { value: "\x08\x01" mask: "\xff\x00" } }
+            priority: 10
+            action {
+              action {
+                action_id: 13
+                params { param_id: 1 value: "\x01" }
+              }
+            })pb",
+       ERR_INVALID_PARAM},
+      {"TernaryDontCare", ::p4::v1::Update::DELETE,
+       R"pb(table_id: 2
+            match { field_id: 1 ternary { value: "\x00" mask: "\x00" } }
+            priority: 10)pb",
+       ERR_INVALID_PARAM},
+      {"LpmDontCare", ::p4::v1::Update::DELETE,
+       R"pb(table_id: 2
+            match {
+              field_id: 2
+              lpm { value: "\x00" prefix_len: 0 }
+            }
+            priority: 10)pb",
+       ERR_INVALID_PARAM},
+      {"LpmBitsAfterPrefix", ::p4::v1::Update::DELETE,
+       R"pb(table_id: 2
+            match {
+              field_id: 2
+              lpm { value: "\x0a\x00\x01\x00" prefix_len: 16 }
+            }
+            priority: 10)pb",
+       ERR_INVALID_PARAM},
+      {"LpmPrefixTooLong", ::p4::v1::Update::DELETE,
+       R"pb(table_id: 2
+            match {
+              field_id: 2
+              lpm { value: "\x0a\x00\x00\x01" prefix_len: 33 }
+            }
+            priority: 10)pb",
+       ERR_INVALID_PARAM},
+      {"RangeLowAboveHigh", ::p4::v1::Update::DELETE,
+       R"pb(table_id: 2
+            match { field_id: 3 range { low: "\x01\x00" high: "\xff" } }
+            priority: 10)pb",
+       ERR_INVALID_PARAM},
+      {"RangeDontCare", ::p4::v1::Update::DELETE,
+       R"pb(table_id: 2
+            match { field_id: 3 range { low: "\x00" high: "\xff\xff" } }
+            priority: 10)pb",
+       ERR_INVALID_PARAM},
+
+      // @refers_to references.
+      {"MulticastGroupZero", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 2
+            priority: 1
+            action {
+              action {
+                action_id: 13
+                params { param_id: 1 value: "\x00" }
+              }
+            })pb",
+       ERR_INVALID_PARAM},
+      {"ReferencedFieldTooNarrow", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 2
+            priority: 1
+            action {
+              action {
+                action_id: 14
+                params { param_id: 1 value: "\x10\x00" }
+              }
+            })pb",
+       ERR_INVALID_PARAM},
+
+      // Action profiles.
+      {"ProfileMember", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 3
+            match { field_id: 1 exact { value: "\x01" } }
+            action { action_profile_member_id: 1 })pb",
+       ERR_SUCCESS},
+      {"DirectActionInProfileTable", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 3
+            match { field_id: 1 exact { value: "\x01" } }
+            action { action { action_id: 11 } })pb",
+       ERR_INVALID_PARAM},
+      {"ProfileMemberInDirectTable", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 1
+            match { field_id: 1 exact { value: "\x01" } }
+            match { field_id: 2 exact { value: "\x01" } }
+            action { action_profile_group_id: 1 })pb",
+       ERR_INVALID_PARAM},
+      {"ActionSetParamsChecked", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 3
+            match { field_id: 1 exact { value: "\x01" } }
+            action {
+              action_profile_action_set {
+                action_profile_actions {
+                  action { action_id: 10 }
+                  weight: 1
+                }
+              }
+            })pb",
+       ERR_INVALID_PARAM},
+
+      // Translated types.
+      {"TranslatedSdnValue", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 5
+            match { field_id: 1 exact { value: "\x00\x00\x01\x00" } }
+            action { action { action_id: 11 } })pb",
+       ERR_SUCCESS},
+      {"TranslatedValueTooWide", ::p4::v1::Update::INSERT,
+       R"pb(table_id: 5
+            match { field_id: 1 exact { value: "\x01\x00\x00\x00\x00" } }
+            action { action { action_id: 11 } })pb",
+       ERR_INVALID_PARAM},
+  });
+  return *test_cases;
+}
+
+}  // namespace
+
+class P4WriteValidatorTest : public testing::TestWithParam<ValidatorTestCase> {
+ protected:
+  void SetUp() override {
+    ::p4::config::v1::P4Info p4_info;
+    ASSERT_OK(ParseProtoFromString(kP4InfoText, &p4_info));
+    validator_ = absl::make_unique<P4WriteValidator>(p4_info);
+  }
+
+  std::unique_ptr<P4WriteValidator> validator_;
+};
+
+TEST_P(P4WriteValidatorTest, ValidateUpdate) {
+  const ValidatorTestCase& test_case = GetParam();
+  ::p4::v1::Update update;
+  update.set_type(test_case.type);
+  ASSERT_OK(ParseProtoFromString(
+      test_case.table_entry, update.mutable_entity()->mutable_table_entry()));
+  ::util::Status status = validator_->ValidateUpdate(update);
+  if (test_case.expected_error == ERR_SUCCESS) {
+    EXPECT_OK(status);
+  } else {
+    EXPECT_EQ(test_case.expected_error, status.error_code()) << status;
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    P4WriteValidatorTestCases, P4WriteValidatorTest,
+    testing::ValuesIn(TestCases()),
+    [](const testing::TestParamInfo<ValidatorTestCase>& info) {
+      return info.param.name;
+    });
+
+// Verifies that updates of an unspecified type are rejected.
+TEST(P4WriteValidatorUpdateTest, UnspecifiedUpdateType) {
+  P4WriteValidator validator(::p4::config::v1::P4Info{});
+  ::p4::v1::Update update;
+  update.mutable_entity()->mutable_table_entry()->set_table_id(1);
+  EXPECT_EQ(ERR_INVALID_PARAM, validator.ValidateUpdate(update).error_code());
+}
+
+// Verifies that updates of other entities pass unchecked.
+TEST(P4WriteValidatorUpdateTest, OtherEntitiesPass) {
+  P4WriteValidator validator(::p4::config::v1::P4Info{});
+  ::p4::v1::Update update;
+  update.set_type(::p4::v1::Update::INSERT);
+  update.mutable_entity()->mutable_action_profile_member()->set_member_id(1);
+  EXPECT_OK(validator.ValidateUpdate(update));
+}
+
+#ifdef BENCHMARK
+// Measures the validation of a typical ACL entry insert.
+static void BM_ValidateAclEntry(int iters) {
+  StopBenchmarkTiming();
+  ::p4::config::v1::P4Info p4_info;
+  CHECK_OK(ParseProtoFromString(kP4InfoText, &p4_info));
+  P4WriteValidator validator(p4_info);
+  ::p4::v1::Update update;
+  update.set_type(::p4::v1::Update::INSERT);
+  CHECK_OK(ParseProtoFromString(
+      R"pb(table_id: 2
+           match { field_id: 1 ternary { value: "\x08\x00" mask: "\xff\xff" } }
+           match {
+             field_id: 2
+             lpm { value: "\x0a\x00\x00\x00" prefix_len: 8 }
+           }
+           match { field_id: 3 range { low: "\x50" high: "\x01\xbb" } }
+           priority: 10
+           action {
+             action {
+               action_id: 13
+               params { param_id: 1 value: "\x01" }
+             }
+           })pb",
+      update.mutable_entity()->mutable_table_entry()));
+  StartBenchmarkTiming();
+  for (int i = 0; i != iters; ++i) {
+    CHECK_OK(validator.ValidateUpdate(update));
+  }
+}
+BENCHMARK(BM_ValidateAclEntry);
+#endif  // BENCHMARK
+
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,151 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+// TableOccupancyTracker implementation.
+
+#include "stratum/hal/lib/p4/table_occupancy_tracker.h"
+
+#include <algorithm>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "gflags/gflags.h"
+#include "stratum/glue/logging.h"
+
+DEFINE_string(table_occupancy_thresholds, "80,90,100",
+              "Comma-separated list of table fill percentages. Crossing "
+              "any of them publishes a table occupancy event.");
+
+namespace stratum {
+namespace hal {
+
+namespace {
+
+// Parses the --table_occupancy_thresholds flag.  Invalid values are logged
+// and skipped.
+std::vector<uint64> ParseThresholds() {
+  std::vector<uint64> thresholds;
+  for (const auto& str : absl::StrSplit(FLAGS_table_occupancy_thresholds, ',',
+                                        absl::SkipWhitespace())) {
+    uint64 threshold;
+    if (!absl::SimpleAtoi(str, &threshold) || threshold == 0) {
+      LOG(ERROR) << "Ignoring invalid table occupancy threshold '" << str
+                 << "'.";
+      continue;
+    }
+    thresholds.push_back(threshold);
+  }
+  std::sort(thresholds.begin(), thresholds.end());
+  thresholds.erase(std::unique(thresholds.begin(), thresholds.end()),
+                   thresholds.end());
+  return thresholds;
+}
+
+}  // namespace
+
+TableOccupancyTracker::TableOccupancyTracker()
+    : thresholds_(ParseThresholds()) {}
+
+void TableOccupancyTracker::Reset(const ::p4::config::v1::P4Info& p4_info) {
+  absl::WriterMutexLock l(&lock_);
+  resources_.clear();
+  for (const auto& table : p4_info.tables()) {
+    AddResource(table.preamble(), table.size());
+  }
+  for (const auto& action_profile : p4_info.action_profiles()) {
+    AddResource(action_profile.preamble(), action_profile.size());
+  }
+}
+
+void TableOccupancyTracker::SetCapacity(uint32 id, uint64 capacity) {
+  absl::WriterMutexLock l(&lock_);
+  auto iter = resources_.find(id);
+  if (iter == resources_.end()) return;
+  iter->second.occupancy.set_capacity(capacity);
+  iter->second.level = FillLevel(iter->second.occupancy);
+}
+
+bool TableOccupancyTracker::RecordInsert(uint32 id,
+                                         TableOccupancy::Table* table) {
+  return UpdateCount(id, true, table);
+}
+
+bool TableOccupancyTracker::RecordDelete(uint32 id,
+                                         TableOccupancy::Table* table) {
+  return UpdateCount(id, false, table);
+}
+
+std::vector<uint32> TableOccupancyTracker::GetIds() const {
+  absl::ReaderMutexLock l(&lock_);
+  std::vector<uint32> ids;
+  ids.reserve(resources_.size());
+  for (const auto& e : resources_) ids.push_back(e.first);
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+TableOccupancy TableOccupancyTracker::GetOccupancy() const {
+  absl::ReaderMutexLock l(&lock_);
+  TableOccupancy occupancy;
+  for (const auto& e : resources_) {
+    *occupancy.add_tables() = e.second.occupancy;
+  }
+  std::sort(occupancy.mutable_tables()->begin(),
+            occupancy.mutable_tables()->end(),
+            [](const TableOccupancy::Table& a, const TableOccupancy::Table& b) {
+              return a.id() < b.id();
+            });
+  return occupancy;
+}
+
+void TableOccupancyTracker::AddResource(
+    const ::p4::config::v1::Preamble& preamble, int64 size) {
+  Resource& resource = resources_[preamble.id()];
+  resource.occupancy.set_id(preamble.id());
+  resource.occupancy.set_name(preamble.name());
+  resource.occupancy.set_capacity(size > 0 ? size : 0);
+}
+
+bool TableOccupancyTracker::UpdateCount(uint32 id, bool insert,
+                                        TableOccupancy::Table* table) {
+  absl::WriterMutexLock l(&lock_);
+  auto iter = resources_.find(id);
+  if (iter == resources_.end()) {
+    VLOG(1) << "Table occupancy of unknown P4 ID " << id << " is not tracked.";
+    return false;
+  }
+  Resource& resource = iter->second;
+  uint64 entries = resource.occupancy.entries();
+  if (insert) {
+    ++entries;
+  } else if (entries > 0) {
+    --entries;
+  } else {
+    LOG(ERROR) << "Table occupancy of " << resource.occupancy.name()
+               << " is already zero.";
+  }
+  resource.occupancy.set_entries(entries);
+
+  int level = FillLevel(resource.occupancy);
+  if (level == resource.level) return false;
+  resource.level = level;
+  VLOG(1) << "Table " << resource.occupancy.name() << " now has "
+          << resource.occupancy.entries() << " of "
+          << resource.occupancy.capacity() << " entries.";
+  if (table != nullptr) *table = resource.occupancy;
+  return true;
+}
+
+int TableOccupancyTracker::FillLevel(
+    const TableOccupancy::Table& occupancy) const {
+  if (occupancy.capacity() == 0) return 0;
+  int level = 0;
+  for (uint64 threshold : thresholds_) {
+    if (occupancy.entries() * 100 < threshold * occupancy.capacity()) break;
+    ++level;
+  }
+  return level;
+}
+
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,105 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+// The TableOccupancyTracker keeps a running count of the entries that a
+// switch has written to each P4 table and action profile, and it compares
+// these counts to the capacity of each resource.
+
+#ifndef STRATUM_HAL_LIB_P4_TABLE_OCCUPANCY_TRACKER_H_
+#define STRATUM_HAL_LIB_P4_TABLE_OCCUPANCY_TRACKER_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "p4/config/v1/p4info.pb.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/hal/lib/common/common.pb.h"
+
+namespace stratum {
+namespace hal {
+
+// A switch's table manager owns one TableOccupancyTracker instance.  The
+// tracker learns the tables, action profiles, and their P4Info sizes from
+// Reset, which the table manager calls after each P4 pipeline push.  The
+// table manager then calls RecordInsert and RecordDelete after every
+// successful write of a new or removed entry.  Modifications of existing
+// entries do not change the occupancy.
+//
+// The capacity of each resource is initially its P4Info size.  Switches that
+// can query the actual size from the SDK override it with SetCapacity.  When
+// a resource's fill level crosses one of the percentages in the
+// --table_occupancy_thresholds flag, in either direction, RecordInsert or
+// RecordDelete returns true so the caller can publish an event.  Resources
+// with unknown capacity never cross a threshold.
+//
+// All TableOccupancyTracker methods are thread-safe.
+class TableOccupancyTracker {
+ public:
+  TableOccupancyTracker();
+  virtual ~TableOccupancyTracker() {}
+
+  // Clears all counts and loads the tables and action profiles in p4_info
+  // with zero entries.
+  void Reset(const ::p4::config::v1::P4Info& p4_info) LOCKS_EXCLUDED(lock_);
+
+  // Replaces the capacity of the resource with the given P4 ID.  Unknown IDs
+  // are ignored.
+  void SetCapacity(uint32 id, uint64 capacity) LOCKS_EXCLUDED(lock_);
+
+  // Updates the entry count of the resource with the given P4 ID after an
+  // insert or a delete.  The return value is true when the update crosses
+  // an occupancy threshold, in which case the table output contains the
+  // updated occupancy of the resource.  Unknown IDs are ignored.
+  bool RecordInsert(uint32 id, TableOccupancy::Table* table)
+      LOCKS_EXCLUDED(lock_);
+  bool RecordDelete(uint32 id, TableOccupancy::Table* table)
+      LOCKS_EXCLUDED(lock_);
+
+  // Returns the P4 IDs of all tracked resources.
+  std::vector<uint32> GetIds() const LOCKS_EXCLUDED(lock_);
+
+  // Returns the occupancy of all tracked resources, ordered by P4 ID.
+  TableOccupancy GetOccupancy() const LOCKS_EXCLUDED(lock_);
+
+  // TableOccupancyTracker is neither copyable nor movable.
+  TableOccupancyTracker(const TableOccupancyTracker&) = delete;
+  TableOccupancyTracker& operator=(const TableOccupancyTracker&) = delete;
+
+ private:
+  // The internal state of one tracked resource.
+  struct Resource {
+    TableOccupancy::Table occupancy;
+    // The number of thresholds at or below the current fill level.
+    int level = 0;
+  };
+
+  // Starts tracking a resource from the P4Info with zero entries.
+  void AddResource(const ::p4::config::v1::Preamble& preamble, int64 size)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Common implementation of RecordInsert and RecordDelete.
+  bool UpdateCount(uint32 id, bool insert, TableOccupancy::Table* table)
+      LOCKS_EXCLUDED(lock_);
+
+  // Returns the number of thresholds at or below the fill level of the
+  // resource.  The level is always zero when the capacity is unknown.
+  int FillLevel(const TableOccupancy::Table& occupancy) const;
+
+  // Protects all the tracked resources.
+  mutable absl::Mutex lock_;
+
+  // The threshold percentages from --table_occupancy_thresholds in
+  // ascending order.
+  const std::vector<uint64> thresholds_;
+
+  // Maps P4 ID to the state of each tracked resource.
+  absl::flat_hash_map<uint32, Resource> resources_ GUARDED_BY(lock_);
+};
+
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_P4_TABLE_OCCUPANCY_TRACKER_H_
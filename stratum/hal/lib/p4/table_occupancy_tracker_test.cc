@@ -0,0 +1,166 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+// Contains unit tests for TableOccupancyTracker.
+
+#include "stratum/hal/lib/p4/table_occupancy_tracker.h"
+
+#include <memory>
+#include <string>
+
+#include "absl/memory/memory.h"
+#include "gflags/gflags.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/lib/utils.h"
+
+DECLARE_string(table_occupancy_thresholds);
+
+namespace stratum {
+namespace hal {
+
+class TableOccupancyTrackerTest : public testing::Test {
+ protected:
+  static constexpr uint32 kTableId = 0x02000001;
+  static constexpr uint32 kUnsizedTableId = 0x02000002;
+  static constexpr uint32 kActionProfileId = 0x11000001;
+
+  void SetUp() override {
+    FLAGS_table_occupancy_thresholds = "50,100";
+    tracker_ = absl::make_unique<TableOccupancyTracker>();
+    const std::string kP4InfoText = R"pb(
+      tables {
+        preamble { id: 0x02000001 name: "ingress.table_1" }
+        size: 4
+      }
+      tables {
+        preamble { id: 0x02000002 name: "ingress.table_2" }
+      }
+      action_profiles {
+        preamble { id: 0x11000001 name: "ingress.profile" }
+        size: 10
+      }
+    )pb";
+    ASSERT_OK(ParseProtoFromString(kP4InfoText, &p4_info_));
+    tracker_->Reset(p4_info_);
+  }
+
+  void TearDown() override { FLAGS_table_occupancy_thresholds = "80,90,100"; }
+
+  // Returns the current entry count of the resource with the given ID.
+  uint64 GetEntries(uint32 id) {
+    TableOccupancy occupancy = tracker_->GetOccupancy();
+    for (const auto& table : occupancy.tables()) {
+      if (table.id() == id) return table.entries();
+    }
+    return 0;
+  }
+
+  ::p4::config::v1::P4Info p4_info_;
+  std::unique_ptr<TableOccupancyTracker> tracker_;
+};
+
+constexpr uint32 TableOccupancyTrackerTest::kTableId;
+constexpr uint32 TableOccupancyTrackerTest::kUnsizedTableId;
+constexpr uint32 TableOccupancyTrackerTest::kActionProfileId;
+
+TEST_F(TableOccupancyTrackerTest, TestResetLoadsP4Info) {
+  TableOccupancy occupancy = tracker_->GetOccupancy();
+  ASSERT_EQ(3, occupancy.tables_size());
+  EXPECT_EQ(kTableId, occupancy.tables(0).id());
+  EXPECT_EQ("ingress.table_1", occupancy.tables(0).name());
+  EXPECT_EQ(0U, occupancy.tables(0).entries());
+  EXPECT_EQ(4U, occupancy.tables(0).capacity());
+  EXPECT_EQ(kUnsizedTableId, occupancy.tables(1).id());
+  EXPECT_EQ(0U, occupancy.tables(1).capacity());
+  EXPECT_EQ(kActionProfileId, occupancy.tables(2).id());
+  EXPECT_EQ(10U, occupancy.tables(2).capacity());
+}
+
+// Verifies counts through a sequence of inserts and deletes.
+TEST_F(TableOccupancyTrackerTest, TestInsertDeleteChurn) {
+  for (int i = 0; i < 3; ++i) {
+    tracker_->RecordInsert(kTableId, nullptr);
+    tracker_->RecordInsert(kActionProfileId, nullptr);
+  }
+  tracker_->RecordDelete(kTableId, nullptr);
+  tracker_->RecordInsert(kTableId, nullptr);
+  tracker_->RecordDelete(kActionProfileId, nullptr);
+  EXPECT_EQ(3U, GetEntries(kTableId));
+  EXPECT_EQ(2U, GetEntries(kActionProfileId));
+  EXPECT_EQ(0U, GetEntries(kUnsizedTableId));
+}
+
+// Verifies that a delete from an empty table does not underflow.
+TEST_F(TableOccupancyTrackerTest, TestDeleteFromEmptyTable) {
+  EXPECT_FALSE(tracker_->RecordDelete(kTableId, nullptr));
+  EXPECT_EQ(0U, GetEntries(kTableId));
+}
+
+// Verifies that threshold crossings are reported in both directions.
+TEST_F(TableOccupancyTrackerTest, TestThresholdCrossings) {
+  TableOccupancy::Table table;
+  EXPECT_FALSE(tracker_->RecordInsert(kTableId, &table));
+  EXPECT_TRUE(tracker_->RecordInsert(kTableId, &table));
+  EXPECT_EQ(2U, table.entries());
+  EXPECT_EQ(4U, table.capacity());
+  EXPECT_FALSE(tracker_->RecordInsert(kTableId, &table));
+  EXPECT_TRUE(tracker_->RecordInsert(kTableId, &table));
+  EXPECT_EQ(4U, table.entries());
+  EXPECT_TRUE(tracker_->RecordDelete(kTableId, &table));
+  EXPECT_EQ(3U, table.entries());
+  EXPECT_FALSE(tracker_->RecordDelete(kTableId, &table));
+  EXPECT_TRUE(tracker_->RecordDelete(kTableId, &table));
+  EXPECT_EQ(1U, table.entries());
+}
+
+// Verifies that tables with unknown capacity never cross thresholds.
+TEST_F(TableOccupancyTrackerTest, TestUnknownCapacity) {
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_FALSE(tracker_->RecordInsert(kUnsizedTableId, nullptr));
+  }
+  EXPECT_EQ(10U, GetEntries(kUnsizedTableId));
+}
+
+// Verifies that SetCapacity overrides the P4Info size without reporting a
+// crossing.
+TEST_F(TableOccupancyTrackerTest, TestSetCapacity) {
+  tracker_->RecordInsert(kTableId, nullptr);
+  tracker_->SetCapacity(kTableId, 2);
+  TableOccupancy::Table table;
+  EXPECT_TRUE(tracker_->RecordInsert(kTableId, &table));
+  EXPECT_EQ(2U, table.capacity());
+  tracker_->SetCapacity(kUnsizedTableId, 2);
+  EXPECT_TRUE(tracker_->RecordInsert(kUnsizedTableId, &table));
+  EXPECT_EQ(kUnsizedTableId, table.id());
+}
+
+// Verifies that unknown IDs are ignored.
+TEST_F(TableOccupancyTrackerTest, TestUnknownId) {
+  EXPECT_FALSE(tracker_->RecordInsert(0x02000099, nullptr));
+  tracker_->SetCapacity(0x02000099, 1);
+  EXPECT_EQ(3, tracker_->GetOccupancy().tables_size());
+}
+
+// Verifies that Reset clears all counts.
+TEST_F(TableOccupancyTrackerTest, TestResetClearsCounts) {
+  tracker_->RecordInsert(kTableId, nullptr);
+  tracker_->Reset(p4_info_);
+  EXPECT_EQ(0U, GetEntries(kTableId));
+  EXPECT_EQ(3U, tracker_->GetIds().size());
+}
+
+// Verifies that invalid threshold flag values are skipped.
+TEST_F(TableOccupancyTrackerTest, TestInvalidThresholds) {
+  FLAGS_table_occupancy_thresholds = "abc,0,100";
+  tracker_ = absl::make_unique<TableOccupancyTracker>();
+  tracker_->Reset(p4_info_);
+  TableOccupancy::Table table;
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_FALSE(tracker_->RecordInsert(kTableId, &table));
+  }
+  EXPECT_TRUE(tracker_->RecordInsert(kTableId, &table));
+}
+
+}  // namespace hal
+}  // namespace stratum
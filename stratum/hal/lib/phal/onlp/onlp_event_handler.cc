@@ -15,6 +15,7 @@
 #include "stratum/glue/gtl/map_util.h"
 #include "stratum/glue/status/status.h"
 #include "stratum/glue/status/statusor.h"
+#include "stratum/lib/liveness_watchdog.h"
 #include "stratum/lib/macros.h"
 
 // Note: We want to keep this polling interval relatively short. Unlike with
@@ -125,7 +126,10 @@ void* OnlpEventHandler::RunPollingThread(void* onlp_event_handler_ptr) {
   OnlpEventHandler* handler =
       static_cast<OnlpEventHandler*>(onlp_event_handler_ptr);
   absl::Time last_polling_time = absl::InfinitePast();
+  auto worker =
+      LivenessWatchdog::GetInstance()->RegisterWorker("OnlpEventHandler");
   while (true) {
+    worker->Heartbeat();
     // We keep the polling time as consistent as possible.
     absl::SleepFor(last_polling_time +
                    absl::Milliseconds(FLAGS_onlp_polling_interval_ms) -
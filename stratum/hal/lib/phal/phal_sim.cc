@@ -4,10 +4,29 @@
 
 #include "stratum/hal/lib/phal/phal_sim.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "absl/base/macros.h"
+#include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gflags/gflags.h"
+#include "stratum/glue/gtl/map_util.h"
+#include "stratum/glue/logging.h"
 #include "stratum/hal/lib/common/constants.h"
 #include "stratum/lib/macros.h"
+#include "stratum/lib/utils.h"
+
+DEFINE_string(phal_sim_scenario_file, "",
+              "Path to a PhalSimScenario text proto replayed by PhalSim in the "
+              "background, starting on the first config push. Empty means no "
+              "scenario.");
+DEFINE_double(phal_sim_scenario_speedup, 1.0,
+              "Factor by which the time of the scenario given with "
+              "--phal_sim_scenario_file is compressed. 0 replays the events "
+              "back to back.");
 
 namespace stratum {
 namespace hal {
@@ -18,15 +37,30 @@ ABSL_CONST_INIT absl::Mutex PhalSim::init_lock_(absl::kConstInit);
 /* static */
 constexpr int PhalSim::kMaxNumTransceiverEventWriters;
 
-PhalSim::PhalSim() {}
+PhalSim::PhalSim() : initialized_(false), scenario_generation_(0) {}
 
-PhalSim::~PhalSim() {}
+PhalSim::~PhalSim() {
+  ::util::Status status = StopScenario();
+  if (!status.ok()) LOG(ERROR) << status;
+}
 
 ::util::Status PhalSim::PushChassisConfig(const ChassisConfig& config) {
-  absl::WriterMutexLock l(&config_lock_);
-  if (!initialized_) {
-    // TODO(unknown): Implement this function.
-    initialized_ = true;
+  bool start_scenario = false;
+  {
+    absl::WriterMutexLock l(&config_lock_);
+    if (!initialized_) {
+      // TODO(unknown): Implement this function.
+      initialized_ = true;
+      start_scenario = !FLAGS_phal_sim_scenario_file.empty();
+    }
+  }
+  if (start_scenario) {
+    PhalSimScenario scenario;
+    RETURN_IF_ERROR(
+        ReadProtoFromTextFile(FLAGS_phal_sim_scenario_file, &scenario));
+    RETURN_IF_ERROR(StartScenario(scenario, FLAGS_phal_sim_scenario_speedup));
+    LOG(INFO) << "Started PhalSim scenario from "
+              << FLAGS_phal_sim_scenario_file << ".";
   }
 
   return ::util::OkStatus();
@@ -38,10 +72,16 @@ PhalSim::~PhalSim() {}
 }
 
 ::util::Status PhalSim::Shutdown() {
+  // The scenario thread needs config_lock_ to make progress.
+  ::util::Status status = StopScenario();
   absl::WriterMutexLock l(&config_lock_);
+  slot_port_to_front_panel_port_info_.clear();
+  module_netif_to_optical_transceiver_info_.clear();
+  fan_tray_fan_to_rpm_.clear();
+  psu_to_state_.clear();
   initialized_ = false;
 
-  return ::util::OkStatus();
+  return status;
 }
 
 ::util::StatusOr<int> PhalSim::RegisterTransceiverEventWriter(
@@ -52,6 +92,7 @@ PhalSim::~PhalSim() {}
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
 
+  absl::WriterMutexLock wl(&writers_lock_);
   RET_CHECK(transceiver_event_writers_.size() <
             static_cast<size_t>(kMaxNumTransceiverEventWriters))
       << "Can only support " << kMaxNumTransceiverEventWriters
@@ -73,7 +114,17 @@ PhalSim::~PhalSim() {}
   RET_CHECK(next_id != kInvalidWriterId)
       << "Could not find a new ID for the Writer. next_id=" << next_id << ".";
 
-  transceiver_event_writers_.insert({std::move(writer), priority, next_id});
+  auto it =
+      transceiver_event_writers_.insert({std::move(writer), priority, next_id});
+
+  // One-time write of all the present transceiver modules, as done by the
+  // real PHAL. Short timeout and no error handling.
+  for (const auto& e : slot_port_to_front_panel_port_info_) {
+    if (e.second.hw_state() != HW_STATE_PRESENT) continue;
+    it->writer->Write(
+        TransceiverEvent{e.first.first, e.first.second, HW_STATE_PRESENT},
+        absl::Milliseconds(10));
+  }
 
   return next_id;
 }
@@ -85,6 +136,7 @@ PhalSim::~PhalSim() {}
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
 
+  absl::WriterMutexLock wl(&writers_lock_);
   auto it = std::find_if(
       transceiver_event_writers_.begin(), transceiver_event_writers_.end(),
       [id](const TransceiverEventWriter& h) { return h.id == id; });
@@ -98,19 +150,35 @@ PhalSim::~PhalSim() {}
 
 ::util::Status PhalSim::GetFrontPanelPortInfo(
     int slot, int port, FrontPanelPortInfo* fp_port_info) {
-  // TODO(unknown): Implement this function.
+  absl::ReaderMutexLock l(&config_lock_);
+  const auto* info = gtl::FindOrNull(slot_port_to_front_panel_port_info_,
+                                     std::make_pair(slot, port));
+  if (info != nullptr) *fp_port_info = *info;
+
   return ::util::OkStatus();
 }
 
 ::util::Status PhalSim::GetOpticalTransceiverInfo(
     int module, int network_interface, OpticalTransceiverInfo* ot_info) {
-  // TODO(unknown): Implement this function.
+  absl::ReaderMutexLock l(&config_lock_);
+  const auto* info =
+      gtl::FindOrNull(module_netif_to_optical_transceiver_info_,
+                      std::make_pair(module, network_interface));
+  if (info != nullptr) *ot_info = *info;
+
   return ::util::OkStatus();
 }
 
 ::util::Status PhalSim::SetOpticalTransceiverInfo(
     int module, int network_interface, const OpticalTransceiverInfo& ot_info) {
-  // TODO(unknown): Implement this function.
+  absl::WriterMutexLock l(&config_lock_);
+  // Only the configurable fields are kept, the readings come from scenarios.
+  auto& info = module_netif_to_optical_transceiver_info_[std::make_pair(
+      module, network_interface)];
+  info.set_frequency(ot_info.frequency());
+  info.set_target_output_power(ot_info.target_output_power());
+  info.set_operational_mode(ot_info.operational_mode());
+
   return ::util::OkStatus();
 }
 
@@ -120,6 +188,255 @@ PhalSim::~PhalSim() {}
   return ::util::OkStatus();
 }
 
+::util::Status PhalSim::RunScenario(const PhalSimScenario& scenario,
+                                    double speedup) {
+  uint64 generation;
+  {
+    absl::MutexLock l(&scenario_lock_);
+    generation = scenario_generation_;
+  }
+
+  return DoRunScenario(scenario, speedup, generation);
+}
+
+::util::Status PhalSim::StartScenario(const PhalSimScenario& scenario,
+                                      double speedup) {
+  absl::MutexLock l(&scenario_lock_);
+  if (scenario_thread_.joinable()) {
+    return MAKE_ERROR(ERR_OPER_STILL_RUNNING)
+           << "A PhalSim scenario is already running in the background.";
+  }
+  uint64 generation = scenario_generation_;
+  scenario_thread_ = std::thread([this, scenario, speedup, generation]() {
+    ::util::Status status = DoRunScenario(scenario, speedup, generation);
+    if (!status.ok()) {
+      LOG(ERROR) << "PhalSim scenario '" << scenario.description()
+                 << "' did not complete: " << status;
+    }
+  });
+
+  return ::util::OkStatus();
+}
+
+::util::Status PhalSim::StopScenario() {
+  std::thread scenario_thread;
+  {
+    absl::MutexLock l(&scenario_lock_);
+    ++scenario_generation_;
+    scenario_stop_cond_var_.SignalAll();
+    scenario_thread = std::move(scenario_thread_);
+  }
+  if (scenario_thread.joinable()) scenario_thread.join();
+
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<int> PhalSim::GetFanSpeedRpm(int fan_tray, int fan) {
+  absl::ReaderMutexLock l(&config_lock_);
+  const auto* rpm =
+      gtl::FindOrNull(fan_tray_fan_to_rpm_, std::make_pair(fan_tray, fan));
+  if (rpm == nullptr) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "No speed known for fan " << fan << " in fan tray " << fan_tray
+           << ".";
+  }
+
+  return *rpm;
+}
+
+::util::StatusOr<HwState> PhalSim::GetPsuState(int psu) {
+  absl::ReaderMutexLock l(&config_lock_);
+  const auto* state = gtl::FindOrNull(psu_to_state_, psu);
+  if (state == nullptr) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << "No state known for PSU " << psu << ".";
+  }
+
+  return *state;
+}
+
+::util::Status PhalSim::DoRunScenario(const PhalSimScenario& scenario,
+                                      double speedup, uint64 generation) {
+  {
+    absl::ReaderMutexLock l(&config_lock_);
+    if (!initialized_) {
+      return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
+    }
+  }
+  if (speedup < 0) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Invalid speedup " << speedup << ".";
+  }
+
+  // Expand the repeated events and the ramps into single occurrences, sorted
+  // by time. Events at the same time keep their order in the scenario.
+  struct Occurrence {
+    uint64 time_ms;
+    uint64 offset_ms;
+    const PhalSimScenario::Event* event;
+  };
+  std::vector<Occurrence> occurrences;
+  for (const auto& event : scenario.events()) {
+    if (event.event_case() == PhalSimScenario::Event::EVENT_NOT_SET) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Scenario event without event: " << event.ShortDebugString();
+    }
+    if (event.repeat_count() < 0 ||
+        (event.repeat_count() > 0 && event.repeat_period_ms() == 0)) {
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Invalid repetition of scenario event: "
+             << event.ShortDebugString();
+    }
+    std::vector<uint64> offsets = {0};
+    if (event.has_dom_ramp() && event.dom_ramp().duration_ms() > 0) {
+      const auto& ramp = event.dom_ramp();
+      if (ramp.step_ms() == 0) {
+        return MAKE_ERROR(ERR_INVALID_PARAM)
+               << "DOM ramp without step: " << event.ShortDebugString();
+      }
+      for (uint64 offset = ramp.step_ms(); offset < ramp.duration_ms();
+           offset += ramp.step_ms()) {
+        offsets.push_back(offset);
+      }
+      offsets.push_back(ramp.duration_ms());
+    }
+    for (int i = 0; i <= event.repeat_count(); ++i) {
+      uint64 time_ms = event.time_ms() + i * event.repeat_period_ms();
+      for (uint64 offset : offsets) {
+        occurrences.push_back({time_ms + offset, offset, &event});
+      }
+    }
+  }
+  std::stable_sort(occurrences.begin(), occurrences.end(),
+                   [](const Occurrence& a, const Occurrence& b) {
+                     return a.time_ms < b.time_ms;
+                   });
+
+  LOG(INFO) << "Running PhalSim scenario '" << scenario.description()
+            << "' with " << occurrences.size() << " events and a speedup of "
+            << speedup << ".";
+  absl::Time start = absl::Now();
+  for (const auto& occurrence : occurrences) {
+    {
+      absl::MutexLock l(&scenario_lock_);
+      if (speedup > 0) {
+        absl::Time deadline =
+            start + absl::Milliseconds(occurrence.time_ms) / speedup;
+        while (scenario_generation_ == generation &&
+               !scenario_stop_cond_var_.WaitWithDeadline(&scenario_lock_,
+                                                         deadline)) {
+        }
+      }
+      if (scenario_generation_ != generation) {
+        return MAKE_ERROR(ERR_CANCELLED)
+               << "PhalSim scenario '" << scenario.description()
+               << "' stopped.";
+      }
+    }
+    ApplyScenarioEvent(*occurrence.event, occurrence.offset_ms);
+  }
+
+  return ::util::OkStatus();
+}
+
+void PhalSim::ApplyScenarioEvent(const PhalSimScenario::Event& event,
+                                 uint64 offset_ms) {
+  VLOG(1) << "Applying PhalSim scenario event " << event.ShortDebugString()
+          << " at offset " << offset_ms << "ms.";
+  // The transceiver events are sent after releasing config_lock_, so that the
+  // readers handling them (or any other caller) are not blocked on the state
+  // while the writes wait for slow readers.
+  std::vector<TransceiverEvent> transceiver_events;
+  {
+    absl::WriterMutexLock l(&config_lock_);
+    UpdateScenarioState(event, offset_ms, &transceiver_events);
+  }
+  for (const auto& transceiver_event : transceiver_events) {
+    SendTransceiverEvent(transceiver_event);
+  }
+}
+
+void PhalSim::UpdateScenarioState(
+    const PhalSimScenario::Event& event, uint64 offset_ms,
+    std::vector<TransceiverEvent>* transceiver_events) {
+  switch (event.event_case()) {
+    case PhalSimScenario::Event::kTransceiverInserted: {
+      const auto& inserted = event.transceiver_inserted();
+      auto& info = slot_port_to_front_panel_port_info_[std::make_pair(
+          inserted.slot(), inserted.port())];
+      info = inserted.info();
+      info.set_hw_state(HW_STATE_PRESENT);
+      transceiver_events->push_back(
+          TransceiverEvent{inserted.slot(), inserted.port(), HW_STATE_PRESENT});
+      break;
+    }
+    case PhalSimScenario::Event::kTransceiverRemoved: {
+      const auto& removed = event.transceiver_removed();
+      // Like the real PHAL, only the state is known for an absent module.
+      auto& info = slot_port_to_front_panel_port_info_[std::make_pair(
+          removed.slot(), removed.port())];
+      info.Clear();
+      info.set_hw_state(HW_STATE_NOT_PRESENT);
+      transceiver_events->push_back(TransceiverEvent{
+          removed.slot(), removed.port(), HW_STATE_NOT_PRESENT});
+      break;
+    }
+    case PhalSimScenario::Event::kDomRamp: {
+      const auto& ramp = event.dom_ramp();
+      double fraction =
+          ramp.duration_ms() > 0
+              ? std::min(1.0, static_cast<double>(offset_ms) /
+                                  ramp.duration_ms())
+              : 1.0;
+      auto& info = module_netif_to_optical_transceiver_info_[std::make_pair(
+          ramp.module(), ramp.network_interface())];
+      info.mutable_input_power()->set_instant(
+          ramp.start_input_power() +
+          fraction * (ramp.end_input_power() - ramp.start_input_power()));
+      info.mutable_output_power()->set_instant(
+          ramp.start_output_power() +
+          fraction * (ramp.end_output_power() - ramp.start_output_power()));
+      break;
+    }
+    case PhalSimScenario::Event::kFanSpeedChanged: {
+      const auto& fan = event.fan_speed_changed();
+      fan_tray_fan_to_rpm_[std::make_pair(fan.fan_tray(), fan.fan())] =
+          fan.rpm();
+      if (fan.rpm() == 0) {
+        LOG(WARNING) << "Fan " << fan.fan() << " in fan tray "
+                     << fan.fan_tray() << " stopped.";
+      }
+      break;
+    }
+    case PhalSimScenario::Event::kPsuStateChanged: {
+      const auto& psu = event.psu_state_changed();
+      psu_to_state_[psu.psu()] = psu.state();
+      if (psu.state() != HW_STATE_READY) {
+        LOG(WARNING) << "PSU " << psu.psu() << " is now "
+                     << HwState_Name(psu.state()) << ".";
+      }
+      break;
+    }
+    case PhalSimScenario::Event::EVENT_NOT_SET:
+      break;
+  }
+}
+
+void PhalSim::SendTransceiverEvent(const TransceiverEvent& event) {
+  absl::ReaderMutexLock l(&writers_lock_);
+  for (const auto& writer : transceiver_event_writers_) {
+    // Short timeout, as done by the real PHAL. A slow reader loses events.
+    ::util::Status status =
+        writer.writer->Write(event, absl::Milliseconds(10));
+    if (!status.ok()) {
+      LOG(WARNING) << "Dropped transceiver event (slot: " << event.slot
+                   << ", port: " << event.port
+                   << ", state: " << HwState_Name(event.state)
+                   << ") for writer " << writer.id << ": " << status;
+    }
+  }
+}
+
 PhalSim* PhalSim::CreateSingleton() {
   absl::WriterMutexLock l(&init_lock_);
   if (!singleton_) {
@@ -129,5 +446,9 @@ PhalSim* PhalSim::CreateSingleton() {
   return singleton_;
 }
 
+std::unique_ptr<PhalSim> PhalSim::CreateInstance() {
+  return absl::WrapUnique(new PhalSim());
+}
+
 }  // namespace hal
 }  // namespace stratum
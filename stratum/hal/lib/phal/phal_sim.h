@@ -9,9 +9,15 @@
 #include <map>
 #include <memory>
 #include <set>
+#include <thread>  // NOLINT
 #include <utility>
+#include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/synchronization/mutex.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
 #include "stratum/hal/lib/common/phal_interface.h"
 #include "stratum/hal/lib/phal/phal.pb.h"
 #include "stratum/hal/lib/phal/sfp_configurator.h"
@@ -20,7 +26,11 @@ namespace stratum {
 namespace hal {
 
 // Class "PhalSim" is an implementation of PhalInterface which is used to
-// simulate the PHAL events to Stratum.
+// simulate the PHAL events to Stratum. The simulated hardware is driven by
+// PhalSimScenario scripts, replayed through the registered transceiver event
+// writers and the state returned by the Get*() methods. A scenario can be
+// given with --phal_sim_scenario_file, in which case it is started on the
+// first config push.
 class PhalSim : public PhalInterface {
  public:
   ~PhalSim() override;
@@ -33,9 +43,9 @@ class PhalSim : public PhalInterface {
   ::util::Status Shutdown() override LOCKS_EXCLUDED(config_lock_);
   ::util::StatusOr<int> RegisterTransceiverEventWriter(
       std::unique_ptr<ChannelWriter<TransceiverEvent>> writer,
-      int priority) override LOCKS_EXCLUDED(config_lock_);
+      int priority) override LOCKS_EXCLUDED(config_lock_, writers_lock_);
   ::util::Status UnregisterTransceiverEventWriter(int id) override
-      LOCKS_EXCLUDED(config_lock_);
+      LOCKS_EXCLUDED(config_lock_, writers_lock_);
   ::util::Status GetFrontPanelPortInfo(
       int slot, int port, FrontPanelPortInfo* fp_port_info) override
       LOCKS_EXCLUDED(config_lock_);
@@ -50,10 +60,37 @@ class PhalSim : public PhalInterface {
                                  LedColor color, LedState state) override
       LOCKS_EXCLUDED(config_lock_);
 
+  // Replays the events of the given scenario and returns once the last one
+  // was replayed. The scenario time is compressed by the given speedup factor,
+  // e.g. 10 replays a 10s scenario in 1s. A speedup of 0 replays the events
+  // back to back. Returns ERR_CANCELLED if stopped by StopScenario() or
+  // Shutdown() before the end.
+  ::util::Status RunScenario(const PhalSimScenario& scenario, double speedup)
+      LOCKS_EXCLUDED(config_lock_, scenario_lock_);
+
+  // Replays a scenario like RunScenario(), but in a background thread. Only
+  // one background scenario can be started until StopScenario() is called.
+  ::util::Status StartScenario(const PhalSimScenario& scenario, double speedup)
+      LOCKS_EXCLUDED(config_lock_, scenario_lock_);
+
+  // Stops the scenarios being replayed, if any, and waits for the background
+  // one to exit.
+  ::util::Status StopScenario() LOCKS_EXCLUDED(scenario_lock_);
+
+  // Returns the speed of a fan, as set by the last scenario event about it.
+  ::util::StatusOr<int> GetFanSpeedRpm(int fan_tray, int fan)
+      LOCKS_EXCLUDED(config_lock_);
+
+  // Returns the state of a PSU, as set by the last scenario event about it.
+  ::util::StatusOr<HwState> GetPsuState(int psu) LOCKS_EXCLUDED(config_lock_);
+
   // Creates the singleton instance. Expected to be called once to initialize
   // the instance.
   static PhalSim* CreateSingleton() LOCKS_EXCLUDED(config_lock_);
 
+  // Creates a standalone instance, e.g. for tests.
+  static std::unique_ptr<PhalSim> CreateInstance();
+
   // PhalSim is neither copyable nor movable.
   PhalSim(const PhalSim&) = delete;
   PhalSim& operator=(const PhalSim&) = delete;
@@ -64,6 +101,27 @@ class PhalSim : public PhalInterface {
 
   static constexpr int kMaxNumTransceiverEventWriters = 8;
 
+  // Replays a scenario, until scenario_generation_ moves past the given one.
+  ::util::Status DoRunScenario(const PhalSimScenario& scenario, double speedup,
+                               uint64 generation)
+      LOCKS_EXCLUDED(config_lock_, scenario_lock_);
+
+  // Applies one occurrence of a scenario event. offset_ms is the time elapsed
+  // since the first step of the event, used for the ramps.
+  void ApplyScenarioEvent(const PhalSimScenario::Event& event, uint64 offset_ms)
+      LOCKS_EXCLUDED(config_lock_, writers_lock_);
+
+  // Applies the state change of a scenario event, and collects the
+  // transceiver events to send for it.
+  void UpdateScenarioState(const PhalSimScenario::Event& event,
+                           uint64 offset_ms,
+                           std::vector<TransceiverEvent>* transceiver_events)
+      EXCLUSIVE_LOCKS_REQUIRED(config_lock_);
+
+  // Sends a transceiver event to all the registered writers.
+  void SendTransceiverEvent(const TransceiverEvent& event)
+      LOCKS_EXCLUDED(config_lock_, writers_lock_);
+
   // Internal mutex lock for protecting the internal maps and initializing the
   // singleton instance.
   static absl::Mutex init_lock_;
@@ -76,20 +134,56 @@ class PhalSim : public PhalInterface {
   // the are being changed.
   mutable absl::Mutex config_lock_;
 
+  // Mutex lock protecting the transceiver event writers, so that the events
+  // can be written without holding config_lock_. Acquired after config_lock_
+  // when both are needed.
+  absl::Mutex writers_lock_ ACQUIRED_AFTER(config_lock_);
+
   // Writers to forward the Transceiver events to. They are registered by
   // external manager classes to receive the SFP Transceiver events. The
   // managers can be running in different threads. The is sorted based on the
   // the priority of the TransceiverEventWriter intances.
   std::multiset<TransceiverEventWriter, TransceiverEventWriterComp>
-      transceiver_event_writers_ GUARDED_BY(config_lock_);
+      transceiver_event_writers_ GUARDED_BY(writers_lock_);
 
   // Map from std::pair<int, int> representing (slot, port) of singleton port
   // to the vector of sfp datasource id
   std::map<std::pair<int, int>, ::stratum::hal::phal::SfpConfigurator*>
       slot_port_to_configurator_;
 
+  // Map from (slot, port) to the info of the transceiver modules inserted or
+  // removed by the scenarios. The ports not found here were never touched by
+  // a scenario and get an empty info.
+  std::map<std::pair<int, int>, FrontPanelPortInfo>
+      slot_port_to_front_panel_port_info_ GUARDED_BY(config_lock_);
+
+  // Map from (module, network_interface) to the optical transceiver info, as
+  // set by the scenarios and SetOpticalTransceiverInfo().
+  std::map<std::pair<int, int>, OpticalTransceiverInfo>
+      module_netif_to_optical_transceiver_info_ GUARDED_BY(config_lock_);
+
+  // Map from (fan tray, fan) to the fan speed in RPM.
+  std::map<std::pair<int, int>, int> fan_tray_fan_to_rpm_
+      GUARDED_BY(config_lock_);
+
+  // Map from PSU to its state.
+  std::map<int, HwState> psu_to_state_ GUARDED_BY(config_lock_);
+
   // Determines if PHAL is fully initialized.
   bool initialized_ GUARDED_BY(config_lock_);
+
+  // Mutex lock protecting the scenario thread and its stop flag. Never
+  // acquired after config_lock_.
+  absl::Mutex scenario_lock_;
+
+  // Signaled when the scenarios have to stop.
+  absl::CondVar scenario_stop_cond_var_;
+
+  // The thread replaying the background scenario, if any.
+  std::thread scenario_thread_ GUARDED_BY(scenario_lock_);
+
+  // Incremented by StopScenario(), to stop the scenarios started before.
+  uint64 scenario_generation_ GUARDED_BY(scenario_lock_);
 };
 
 }  // namespace hal
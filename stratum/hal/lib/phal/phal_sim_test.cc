@@ -0,0 +1,221 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/hal/lib/phal/phal_sim.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/lib/channel/channel.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+
+using TransceiverEvent = PhalInterface::TransceiverEvent;
+
+class PhalSimTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    phal_sim_ = PhalSim::CreateInstance();
+    ASSERT_OK(phal_sim_->PushChassisConfig(ChassisConfig()));
+    channel_ = Channel<TransceiverEvent>::Create(kChannelDepth);
+    ASSERT_OK(phal_sim_->RegisterTransceiverEventWriter(
+        ChannelWriter<TransceiverEvent>::Create(channel_),
+        PhalInterface::kTransceiverEventWriterPriorityHigh));
+    reader_ = ChannelReader<TransceiverEvent>::Create(channel_);
+  }
+
+  void TearDown() override { ASSERT_OK(phal_sim_->Shutdown()); }
+
+  void LoadScenario(const std::string& name, PhalSimScenario* scenario) {
+    ASSERT_OK(ReadProtoFromTextFile(
+        "stratum/hal/lib/phal/sim_scenarios/" + name + ".pb.txt", scenario));
+  }
+
+  // Reads all the transceiver events sent so far.
+  std::vector<TransceiverEvent> ReadEvents() {
+    std::vector<TransceiverEvent> events;
+    EXPECT_OK(reader_->ReadAll(&events));
+    return events;
+  }
+
+  static constexpr int kChannelDepth = 64;
+
+  std::unique_ptr<PhalSim> phal_sim_;
+  std::shared_ptr<Channel<TransceiverEvent>> channel_;
+  std::unique_ptr<ChannelReader<TransceiverEvent>> reader_;
+};
+
+constexpr int PhalSimTest::kChannelDepth;
+
+TEST_F(PhalSimTest, InsertionStorm) {
+  PhalSimScenario scenario;
+  LoadScenario("insertion_storm", &scenario);
+  ASSERT_OK(phal_sim_->RunScenario(scenario, 0));
+
+  auto events = ReadEvents();
+  ASSERT_EQ(32U, events.size());
+  for (int i = 0; i < 32; ++i) {
+    EXPECT_EQ(1, events[i].slot);
+    EXPECT_EQ(i + 1, events[i].port);
+    EXPECT_EQ(HW_STATE_PRESENT, events[i].state);
+  }
+  FrontPanelPortInfo info;
+  ASSERT_OK(phal_sim_->GetFrontPanelPortInfo(1, 32, &info));
+  EXPECT_EQ(HW_STATE_PRESENT, info.hw_state());
+  EXPECT_EQ(MEDIA_TYPE_QSFP_SR4, info.media_type());
+  EXPECT_EQ("SIM00032", info.serial_number());
+}
+
+TEST_F(PhalSimTest, FlappingModule) {
+  PhalSimScenario scenario;
+  LoadScenario("flapping_module", &scenario);
+  ASSERT_OK(phal_sim_->RunScenario(scenario, 0));
+
+  auto events = ReadEvents();
+  ASSERT_EQ(21U, events.size());
+  for (size_t i = 0; i < events.size(); ++i) {
+    EXPECT_EQ(i % 2 ? HW_STATE_NOT_PRESENT : HW_STATE_PRESENT,
+              events[i].state);
+  }
+  FrontPanelPortInfo info;
+  ASSERT_OK(phal_sim_->GetFrontPanelPortInfo(1, 1, &info));
+  EXPECT_EQ(HW_STATE_PRESENT, info.hw_state());
+  EXPECT_EQ("SimVendor", info.vendor_name());
+}
+
+TEST_F(PhalSimTest, DomDrift) {
+  PhalSimScenario scenario;
+  LoadScenario("dom_drift", &scenario);
+  ASSERT_OK(phal_sim_->RunScenario(scenario, 0));
+
+  OpticalTransceiverInfo info;
+  ASSERT_OK(phal_sim_->GetOpticalTransceiverInfo(1, 1, &info));
+  EXPECT_DOUBLE_EQ(-1200, info.input_power().instant());
+  EXPECT_DOUBLE_EQ(100, info.output_power().instant());
+  EXPECT_TRUE(ReadEvents().empty());
+}
+
+TEST_F(PhalSimTest, FanAndPsuFailure) {
+  PhalSimScenario scenario;
+  LoadScenario("fan_and_psu_failure", &scenario);
+  ASSERT_OK(phal_sim_->RunScenario(scenario, 0));
+
+  auto rpm = phal_sim_->GetFanSpeedRpm(2, 1);
+  ASSERT_OK(rpm);
+  EXPECT_EQ(0, rpm.ValueOrDie());
+  rpm = phal_sim_->GetFanSpeedRpm(1, 1);
+  ASSERT_OK(rpm);
+  EXPECT_EQ(18000, rpm.ValueOrDie());
+  auto state = phal_sim_->GetPsuState(2);
+  ASSERT_OK(state);
+  EXPECT_EQ(HW_STATE_READY, state.ValueOrDie());
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND,
+            phal_sim_->GetPsuState(3).status().error_code());
+}
+
+TEST_F(PhalSimTest, DomRampSteps) {
+  PhalSimScenario scenario;
+  auto* ramp = scenario.add_events()->mutable_dom_ramp();
+  ramp->set_module(1);
+  ramp->set_network_interface(1);
+  ramp->set_start_input_power(0);
+  ramp->set_end_input_power(-100);
+  ramp->set_duration_ms(1000);
+  ramp->set_step_ms(250);
+  // Stop in the middle of the ramp by running the scenario up to a later
+  // event which is never reached.
+  auto* fan = scenario.add_events();
+  fan->set_time_ms(10 * 1000);
+  fan->mutable_fan_speed_changed()->set_rpm(1);
+  ASSERT_OK(phal_sim_->StartScenario(scenario, 1));
+
+  // Steps at 0, 250, 500, 750 and 1000ms.
+  absl::SleepFor(absl::Milliseconds(600));
+  OpticalTransceiverInfo info;
+  ASSERT_OK(phal_sim_->GetOpticalTransceiverInfo(1, 1, &info));
+  EXPECT_DOUBLE_EQ(-50, info.input_power().instant());
+  ASSERT_OK(phal_sim_->StopScenario());
+  EXPECT_FALSE(phal_sim_->GetFanSpeedRpm(0, 0).ok());
+}
+
+TEST_F(PhalSimTest, TimeCompression) {
+  PhalSimScenario scenario;
+  auto* event = scenario.add_events();
+  event->set_time_ms(2000);
+  event->mutable_psu_state_changed()->set_psu(1);
+  event->mutable_psu_state_changed()->set_state(HW_STATE_FAILED);
+
+  absl::Time start = absl::Now();
+  ASSERT_OK(phal_sim_->RunScenario(scenario, 100));
+  absl::Duration elapsed = absl::Now() - start;
+  EXPECT_GE(elapsed, absl::Milliseconds(20));
+  EXPECT_LT(elapsed, absl::Milliseconds(2000));
+  auto state = phal_sim_->GetPsuState(1);
+  ASSERT_OK(state);
+  EXPECT_EQ(HW_STATE_FAILED, state.ValueOrDie());
+}
+
+TEST_F(PhalSimTest, StopBackgroundScenario) {
+  PhalSimScenario scenario;
+  LoadScenario("flapping_module", &scenario);
+  ASSERT_OK(phal_sim_->StartScenario(scenario, 1));
+  EXPECT_EQ(ERR_OPER_STILL_RUNNING,
+            phal_sim_->StartScenario(scenario, 1).error_code());
+  absl::SleepFor(absl::Milliseconds(50));
+  ASSERT_OK(phal_sim_->StopScenario());
+
+  // Only the first insertion happened before the stop.
+  auto events = ReadEvents();
+  ASSERT_EQ(1U, events.size());
+  EXPECT_EQ(HW_STATE_PRESENT, events[0].state);
+  // The stop does not affect the next scenarios.
+  ASSERT_OK(phal_sim_->RunScenario(scenario, 0));
+  EXPECT_EQ(21U, ReadEvents().size());
+}
+
+TEST_F(PhalSimTest, NewWriterGetsPresentModules) {
+  PhalSimScenario scenario;
+  LoadScenario("flapping_module", &scenario);
+  ASSERT_OK(phal_sim_->RunScenario(scenario, 0));
+
+  std::shared_ptr<Channel<TransceiverEvent>> channel =
+      Channel<TransceiverEvent>::Create(kChannelDepth);
+  ASSERT_OK(phal_sim_->RegisterTransceiverEventWriter(
+      ChannelWriter<TransceiverEvent>::Create(channel),
+      PhalInterface::kTransceiverEventWriterPriorityLow));
+  auto reader = ChannelReader<TransceiverEvent>::Create(channel);
+  TransceiverEvent event;
+  ASSERT_OK(reader->TryRead(&event));
+  EXPECT_EQ(1, event.slot);
+  EXPECT_EQ(1, event.port);
+  EXPECT_EQ(HW_STATE_PRESENT, event.state);
+  EXPECT_FALSE(reader->TryRead(&event).ok());
+}
+
+TEST_F(PhalSimTest, InvalidScenario) {
+  PhalSimScenario scenario;
+  scenario.add_events()->set_time_ms(1);
+  EXPECT_EQ(ERR_INVALID_PARAM,
+            phal_sim_->RunScenario(scenario, 0).error_code());
+
+  scenario.Clear();
+  auto* event = scenario.add_events();
+  event->set_repeat_count(2);
+  event->mutable_transceiver_removed()->set_slot(1);
+  EXPECT_EQ(ERR_INVALID_PARAM,
+            phal_sim_->RunScenario(scenario, 0).error_code());
+  EXPECT_EQ(ERR_INVALID_PARAM,
+            phal_sim_->RunScenario(PhalSimScenario(), -1).error_code());
+  EXPECT_TRUE(ReadEvents().empty());
+}
+
+}  // namespace hal
+}  // namespace stratum
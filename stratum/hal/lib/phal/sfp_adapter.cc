@@ -87,6 +87,7 @@ SfpAdapter::~SfpAdapter() {
   fp_port_info->set_physical_port_type(actual_val);
 
   fp_port_info->set_media_type(sfp.media_type());
+  fp_port_info->set_cable_length(sfp.cable_length());
 
   if (sfp.has_info()) {
     fp_port_info->set_vendor_name(sfp.info().mfg_name());
@@ -58,6 +58,7 @@ class SfpAdapterTest : public ::testing::Test {
           media_type: MEDIA_TYPE_SFP
           connector_type: SFP_TYPE_SFP
           module_type: SFP_MODULE_TYPE_10G_BASE_CR
+          cable_length: 3
           info {
             mfg_name: "test_vendor"
             part_no: "test part #"
@@ -89,6 +90,7 @@ TEST_F(SfpAdapterTest, OnlpPhalGetFrontPanelPortInfoSuccess) {
   EXPECT_EQ(fp_port_info.vendor_name(), "test_vendor");
   EXPECT_EQ(fp_port_info.part_number(), "test part #");
   EXPECT_EQ(fp_port_info.serial_number(), "test1234");
+  EXPECT_EQ(fp_port_info.cable_length(), 3);
 }
 
 TEST_F(SfpAdapterTest, OnlpPhalGetFrontPanelPortInfoFailureInvalidPort) {
@@ -10,6 +10,7 @@
 #include "gflags/gflags.h"
 #include "stratum/glue/gtl/map_util.h"
 #include "stratum/hal/lib/common/constants.h"
+#include "stratum/lib/liveness_watchdog.h"
 #include "stratum/lib/macros.h"
 
 DEFINE_int32(udev_polling_interval_ms, 200,
@@ -192,7 +193,10 @@ void* UdevEventHandler::RunUdevMonitorLoop(void* udev_event_handler_ptr) {
 }
 
 void UdevEventHandler::UdevMonitorLoop() {
+  auto worker =
+      LivenessWatchdog::GetInstance()->RegisterWorker("UdevEventHandler");
   while (true) {
+    worker->Heartbeat();
     {
       // Check if the thread should stop.
       absl::MutexLock lock(&udev_lock_);
@@ -0,0 +1,288 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/lib/liveness_watchdog.h"
+
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/base/call_once.h"
+#include "absl/memory/memory.h"
+#include "absl/time/clock.h"
+#include "gflags/gflags.h"
+#include "stratum/glue/logging.h"
+#include "stratum/lib/macros.h"
+
+DEFINE_int32(liveness_watchdog_check_period_ms, 1000,
+             "Period at which the liveness watchdog checks the worker "
+             "threads. 0 disables the watchdog.");
+DEFINE_int32(liveness_watchdog_default_deadline_ms, 30000,
+             "Max time a worker thread can go without a heartbeat before the "
+             "liveness watchdog reports it as stalled.");
+DEFINE_bool(liveness_watchdog_dump_stacks, true,
+            "Dump the stack of the stalled worker threads to stderr.");
+DEFINE_bool(liveness_watchdog_abort_on_stall, false,
+            "Abort the process when a worker thread stalls.");
+
+namespace stratum {
+
+namespace {
+
+// The signal sent to a stalled thread to make it dump its own stack. SIGURG
+// is ignored by default, so a stray one is harmless.
+constexpr int kStackDumpSignal = SIGURG;
+
+// Max number of frames dumped.
+constexpr int kMaxStackFrames = 64;
+
+// Number of stacks dumped so far, used to wait for a dump to complete.
+std::atomic<int> stack_dumps_done(0);
+
+// Handler of kStackDumpSignal, run by the stalled thread. Only uses
+// async-signal-safe calls, assuming backtrace() was called once beforehand
+// (its first call may load libgcc).
+void StackDumpSignalHandler(int signal) {
+  int saved_errno = errno;
+  static const char kHeader[] = "*** Stack of stalled thread ***\n";
+  // No reasonable error handling possible.
+  write(STDERR_FILENO, kHeader, sizeof(kHeader) - 1);
+  void* frames[kMaxStackFrames];
+  int num_frames = backtrace(frames, kMaxStackFrames);
+  backtrace_symbols_fd(frames, num_frames, STDERR_FILENO);
+  stack_dumps_done.fetch_add(1);
+  errno = saved_errno;
+}
+
+::util::Status InstallStackDumpSignalHandler() {
+  static absl::once_flag once;
+  static ::util::Status status;
+  absl::call_once(once, []() {
+    void* frames[1];
+    backtrace(frames, 1);
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = StackDumpSignalHandler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(kStackDumpSignal, &action, nullptr) != 0) {
+      status = MAKE_ERROR(ERR_INTERNAL)
+               << "Failed to install the stack dump signal handler: "
+               << strerror(errno);
+    }
+  });
+  return status;
+}
+
+// Makes the given thread dump its stack and waits (for a bounded time) for the
+// dump to complete.
+void DumpThreadStack(pthread_t thread_id) {
+  ::util::Status status = InstallStackDumpSignalHandler();
+  if (!status.ok()) {
+    LOG(ERROR) << status;
+    return;
+  }
+  int dumps_done = stack_dumps_done.load();
+  if (pthread_kill(thread_id, kStackDumpSignal) != 0) return;
+  absl::Time deadline = absl::Now() + absl::Seconds(1);
+  while (stack_dumps_done.load() == dumps_done && absl::Now() < deadline) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+}
+
+}  // namespace
+
+LivenessWatchdog::Worker::Worker(LivenessWatchdog* watchdog,
+                                 const std::string& name,
+                                 absl::Duration deadline)
+    : watchdog_(watchdog),
+      name_(name),
+      deadline_(deadline),
+      thread_id_(pthread_self()),
+      last_heartbeat_ns_(absl::GetCurrentTimeNanos()),
+      progress_(0) {}
+
+LivenessWatchdog::Worker::~Worker() { watchdog_->Unregister(this); }
+
+void LivenessWatchdog::Worker::Heartbeat() {
+  last_heartbeat_ns_.store(absl::GetCurrentTimeNanos(),
+                           std::memory_order_relaxed);
+}
+
+void LivenessWatchdog::Worker::ReportProgress(uint64 count) {
+  progress_.fetch_add(count, std::memory_order_relaxed);
+  Heartbeat();
+}
+
+LivenessWatchdog::LivenessWatchdog(const Options& options)
+    : options_(options), healthy_(true), stop_(false) {}
+
+LivenessWatchdog::~LivenessWatchdog() {
+  ::util::Status status = Stop();
+  if (!status.ok()) LOG(ERROR) << status;
+}
+
+std::unique_ptr<LivenessWatchdog::Worker> LivenessWatchdog::RegisterWorker(
+    const std::string& name) {
+  return RegisterWorker(name, options_.default_deadline);
+}
+
+std::unique_ptr<LivenessWatchdog::Worker> LivenessWatchdog::RegisterWorker(
+    const std::string& name, absl::Duration deadline) {
+  auto worker = absl::WrapUnique(new Worker(this, name, deadline));
+  absl::MutexLock l(&lock_);
+  workers_.insert(worker.get());
+  VLOG(1) << "Registered worker " << name << " with a deadline of "
+          << deadline << ".";
+  return worker;
+}
+
+void LivenessWatchdog::Unregister(Worker* worker) {
+  absl::MutexLock l(&lock_);
+  workers_.erase(worker);
+  // The health recovers on the next check if this worker was the last stalled
+  // one.
+  stalled_workers_.erase(worker);
+}
+
+::util::Status LivenessWatchdog::Start() {
+  if (options_.check_period <= absl::ZeroDuration()) {
+    LOG(INFO) << "Liveness watchdog is disabled.";
+    return ::util::OkStatus();
+  }
+  if (options_.dump_stacks) RETURN_IF_ERROR(InstallStackDumpSignalHandler());
+  absl::MutexLock l(&lock_);
+  if (watchdog_thread_.joinable()) return ::util::OkStatus();
+  stop_ = false;
+  watchdog_thread_ = std::thread([this]() { WatchdogLoop(); });
+
+  return ::util::OkStatus();
+}
+
+::util::Status LivenessWatchdog::Stop() {
+  {
+    absl::MutexLock l(&lock_);
+    if (!watchdog_thread_.joinable()) return ::util::OkStatus();
+    stop_ = true;
+    stop_cond_var_.SignalAll();
+  }
+  watchdog_thread_.join();
+
+  return ::util::OkStatus();
+}
+
+void LivenessWatchdog::WatchdogLoop() {
+  while (true) {
+    {
+      absl::MutexLock l(&lock_);
+      absl::Time deadline = absl::Now() + options_.check_period;
+      while (!stop_ && !stop_cond_var_.WaitWithDeadline(&lock_, deadline)) {
+      }
+      if (stop_) break;
+    }
+    CheckNow();
+  }
+}
+
+bool LivenessWatchdog::CheckNow() {
+  bool healthy;
+  bool health_changed;
+  bool abort = false;
+  HealthCallback callback;
+  {
+    absl::MutexLock l(&lock_);
+    absl::Time now = absl::Now();
+    for (Worker* worker : workers_) {
+      absl::Time last_heartbeat = absl::FromUnixNanos(
+          worker->last_heartbeat_ns_.load(std::memory_order_relaxed));
+      bool stalled = now - last_heartbeat > worker->deadline_;
+      if (stalled && !stalled_workers_.count(worker)) {
+        stalled_workers_.insert(worker);
+        LOG(ERROR) << "Worker " << worker->name_ << " stalled: no heartbeat "
+                   << "since " << now - last_heartbeat << " (deadline "
+                   << worker->deadline_ << "), "
+                   << worker->progress_.load(std::memory_order_relaxed)
+                   << " work items processed so far.";
+        // The lock keeps the worker (and, in practice, its thread) alive
+        // while its stack is dumped.
+        if (options_.dump_stacks) DumpThreadStack(worker->thread_id_);
+        abort = options_.abort_on_stall;
+      } else if (!stalled && stalled_workers_.erase(worker)) {
+        LOG(INFO) << "Worker " << worker->name_ << " recovered.";
+      }
+    }
+    healthy = stalled_workers_.empty();
+    health_changed = healthy != healthy_;
+    healthy_ = healthy;
+    callback = health_callback_;
+  }
+  if (abort) {
+    LOG(FATAL) << "Aborting as a worker thread stalled.";
+  }
+  if (health_changed) {
+    LOG(INFO) << "Process is now " << (healthy ? "healthy" : "unhealthy")
+              << ".";
+    if (callback) callback(healthy);
+  }
+
+  return healthy;
+}
+
+bool LivenessWatchdog::IsHealthy() const {
+  absl::MutexLock l(&lock_);
+  return healthy_;
+}
+
+void LivenessWatchdog::SetHealthCallback(HealthCallback callback) {
+  absl::MutexLock l(&lock_);
+  health_callback_ = std::move(callback);
+}
+
+std::vector<LivenessWatchdog::WorkerState> LivenessWatchdog::GetWorkerStates()
+    const {
+  std::vector<WorkerState> states;
+  absl::MutexLock l(&lock_);
+  for (Worker* worker : workers_) {
+    WorkerState state;
+    state.name = worker->name_;
+    state.deadline = worker->deadline_;
+    state.last_heartbeat = absl::FromUnixNanos(
+        worker->last_heartbeat_ns_.load(std::memory_order_relaxed));
+    state.progress = worker->progress_.load(std::memory_order_relaxed);
+    state.stalled = stalled_workers_.count(worker) > 0;
+    states.push_back(state);
+  }
+  std::sort(states.begin(), states.end(),
+            [](const WorkerState& a, const WorkerState& b) {
+              return a.name < b.name;
+            });
+
+  return states;
+}
+
+LivenessWatchdog* LivenessWatchdog::GetInstance() {
+  static LivenessWatchdog* singleton = []() {
+    Options options;
+    options.check_period =
+        absl::Milliseconds(FLAGS_liveness_watchdog_check_period_ms);
+    options.default_deadline =
+        absl::Milliseconds(FLAGS_liveness_watchdog_default_deadline_ms);
+    options.dump_stacks = FLAGS_liveness_watchdog_dump_stacks;
+    options.abort_on_stall = FLAGS_liveness_watchdog_abort_on_stall;
+    return new LivenessWatchdog(options);
+  }();
+
+  return singleton;
+}
+
+std::unique_ptr<LivenessWatchdog> LivenessWatchdog::CreateInstance(
+    const Options& options) {
+  return absl::WrapUnique(new LivenessWatchdog(options));
+}
+
+}  // namespace stratum
@@ -0,0 +1,187 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef STRATUM_LIB_LIVENESS_WATCHDOG_H_
+#define STRATUM_LIB_LIVENESS_WATCHDOG_H_
+
+#include <pthread.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+
+namespace stratum {
+
+// LivenessWatchdog keeps a registry of the long-running worker threads of the
+// process (RX loops, event readers, timers, etc.) and detects the ones which
+// stop making progress, e.g. because they are deadlocked or blocked in an SDK
+// call which never returns.
+//
+// Every worker registers itself and reports a heartbeat on each iteration of
+// its loop, including the idle ones (which means blocking calls must use a
+// finite timeout). A watchdog thread periodically checks that every worker
+// heartbeated within its deadline. When a worker stalls, the watchdog logs it,
+// dumps the stack of the stalled thread, marks the process unhealthy (which is
+// reported e.g. through the gRPC health service) and optionally aborts the
+// process, so that it is restarted by its supervisor.
+class LivenessWatchdog {
+ public:
+  struct Options {
+    // The period at which the workers are checked. Zero disables the watchdog
+    // thread; CheckNow() can still be used.
+    absl::Duration check_period;
+    // The deadline of the workers registered without an explicit one.
+    absl::Duration default_deadline;
+    // Whether to dump the stack of the stalled threads to stderr.
+    bool dump_stacks;
+    // Whether to abort the process when a worker stalls.
+    bool abort_on_stall;
+    Options()
+        : check_period(absl::Seconds(1)),
+          default_deadline(absl::Seconds(30)),
+          dump_stacks(true),
+          abort_on_stall(false) {}
+  };
+
+  // The state of a worker, as returned by GetWorkerStates().
+  struct WorkerState {
+    std::string name;
+    absl::Duration deadline;
+    absl::Time last_heartbeat;
+    // Number of work items reported by the worker.
+    uint64 progress;
+    // Whether the worker was found stalled by the last check.
+    bool stalled;
+  };
+
+  // Called when the health of the process changes, with the new health.
+  using HealthCallback = std::function<void(bool healthy)>;
+
+  // A worker registered with the watchdog. Heartbeat() and ReportProgress()
+  // are lock-free and cheap enough to be called on every loop iteration. The
+  // worker is unregistered when destroyed.
+  class Worker {
+   public:
+    ~Worker();
+
+    // Reports the worker is alive.
+    void Heartbeat();
+
+    // Reports the worker processed some work items. Implies a heartbeat.
+    void ReportProgress(uint64 count);
+
+    const std::string& name() const { return name_; }
+
+    // Worker is neither copyable nor movable.
+    Worker(const Worker&) = delete;
+    Worker& operator=(const Worker&) = delete;
+
+   private:
+    friend class LivenessWatchdog;
+
+    Worker(LivenessWatchdog* watchdog, const std::string& name,
+           absl::Duration deadline);
+
+    // The watchdog this worker is registered with. Not owned by this class.
+    LivenessWatchdog* const watchdog_;
+    const std::string name_;
+    const absl::Duration deadline_;
+    // The thread which registered the worker, whose stack is dumped on stall.
+    const pthread_t thread_id_;
+    // Time of the last heartbeat, in nanoseconds since the Unix epoch.
+    std::atomic<int64> last_heartbeat_ns_;
+    std::atomic<uint64> progress_;
+  };
+
+  ~LivenessWatchdog();
+
+  // Registers the calling thread as a worker with the given deadline, or the
+  // default one. The registration counts as the first heartbeat.
+  std::unique_ptr<Worker> RegisterWorker(const std::string& name)
+      LOCKS_EXCLUDED(lock_);
+  std::unique_ptr<Worker> RegisterWorker(const std::string& name,
+                                         absl::Duration deadline)
+      LOCKS_EXCLUDED(lock_);
+
+  // Starts the watchdog thread. No-op if the check period is zero or the
+  // thread is already running.
+  ::util::Status Start() LOCKS_EXCLUDED(lock_);
+
+  // Stops the watchdog thread and waits until it joins.
+  ::util::Status Stop() LOCKS_EXCLUDED(lock_);
+
+  // Checks all the workers once, and runs the health callback if the health
+  // changed. Returns true if no worker is stalled.
+  bool CheckNow() LOCKS_EXCLUDED(lock_);
+
+  // Returns the health as of the last check.
+  bool IsHealthy() const LOCKS_EXCLUDED(lock_);
+
+  // Sets the callback run when the health changes, replacing the previous one.
+  // A nullptr callback removes it. The callback is not run while holding the
+  // internal lock, but is run from the watchdog thread.
+  void SetHealthCallback(HealthCallback callback) LOCKS_EXCLUDED(lock_);
+
+  // Returns the state of all the registered workers, sorted by name.
+  std::vector<WorkerState> GetWorkerStates() const LOCKS_EXCLUDED(lock_);
+
+  // Returns the process-wide watchdog, configured from the command line flags.
+  // Never deleted.
+  static LivenessWatchdog* GetInstance();
+
+  // Creates a standalone watchdog. It needs to outlive all its workers.
+  static std::unique_ptr<LivenessWatchdog> CreateInstance(
+      const Options& options);
+
+  // LivenessWatchdog is neither copyable nor movable.
+  LivenessWatchdog(const LivenessWatchdog&) = delete;
+  LivenessWatchdog& operator=(const LivenessWatchdog&) = delete;
+
+ private:
+  // Private constructor, we can create the instance by using `CreateInstance`
+  // or `GetInstance` functions only.
+  explicit LivenessWatchdog(const Options& options);
+
+  // Removes a worker from the registry. Called by the Worker destructor.
+  void Unregister(Worker* worker) LOCKS_EXCLUDED(lock_);
+
+  // Body of the watchdog thread.
+  void WatchdogLoop() LOCKS_EXCLUDED(lock_);
+
+  // The options, set upon construction and never changed afterwards.
+  const Options options_;
+
+  // Mutex protecting the internal state.
+  mutable absl::Mutex lock_;
+
+  // Signaled when the watchdog thread has to stop.
+  absl::CondVar stop_cond_var_;
+
+  // The registered workers and the subset found stalled by the last check.
+  // Not owned by this class.
+  std::set<Worker*> workers_ GUARDED_BY(lock_);
+  std::set<Worker*> stalled_workers_ GUARDED_BY(lock_);
+
+  // The health as of the last check.
+  bool healthy_ GUARDED_BY(lock_);
+
+  HealthCallback health_callback_ GUARDED_BY(lock_);
+
+  // The watchdog thread and its stop flag.
+  std::thread watchdog_thread_;
+  bool stop_ GUARDED_BY(lock_);
+};
+
+}  // namespace stratum
+
+#endif  // STRATUM_LIB_LIVENESS_WATCHDOG_H_
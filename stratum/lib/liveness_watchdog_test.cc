@@ -0,0 +1,168 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/lib/liveness_watchdog.h"
+
+#include <atomic>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/status/status_test_util.h"
+
+namespace stratum {
+
+// A worker thread which heartbeats every millisecond until told to stall, then
+// until told to stop.
+class FakeWorker {
+ public:
+  FakeWorker(LivenessWatchdog* watchdog, const std::string& name,
+             absl::Duration deadline)
+      : stall_(false), stop_(false) {
+    absl::Notification registered;
+    thread_ = std::thread([=, &registered]() {
+      auto worker = watchdog->RegisterWorker(name, deadline);
+      registered.Notify();
+      while (!stop_) {
+        if (!stall_) worker->ReportProgress(1);
+        absl::SleepFor(absl::Milliseconds(1));
+      }
+    });
+    registered.WaitForNotification();
+  }
+
+  ~FakeWorker() {
+    stop_ = true;
+    thread_.join();
+  }
+
+  void SetStalled(bool stalled) { stall_ = stalled; }
+
+ private:
+  std::atomic<bool> stall_;
+  std::atomic<bool> stop_;
+  std::thread thread_;
+};
+
+class LivenessWatchdogTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    LivenessWatchdog::Options options;
+    options.check_period = kCheckPeriod;
+    options.default_deadline = kDeadline;
+    watchdog_ = LivenessWatchdog::CreateInstance(options);
+    watchdog_->SetHealthCallback([this](bool healthy) {
+      absl::MutexLock l(&lock_);
+      health_transitions_.push_back(healthy);
+      transition_times_.push_back(absl::Now());
+    });
+  }
+
+  // Waits until the health callback was run the given number of times.
+  bool WaitForTransitions(size_t count) {
+    absl::MutexLock l(&lock_);
+    auto done = [this, count]() {
+      lock_.AssertHeld();
+      return health_transitions_.size() >= count;
+    };
+    return lock_.AwaitWithTimeout(absl::Condition(&done), absl::Seconds(10));
+  }
+
+  static constexpr absl::Duration kCheckPeriod = absl::Milliseconds(10);
+  static constexpr absl::Duration kDeadline = absl::Milliseconds(100);
+
+  std::unique_ptr<LivenessWatchdog> watchdog_;
+  absl::Mutex lock_;
+  std::vector<bool> health_transitions_ GUARDED_BY(lock_);
+  std::vector<absl::Time> transition_times_ GUARDED_BY(lock_);
+};
+
+constexpr absl::Duration LivenessWatchdogTest::kCheckPeriod;
+constexpr absl::Duration LivenessWatchdogTest::kDeadline;
+
+TEST_F(LivenessWatchdogTest, HealthyWorkers) {
+  FakeWorker worker1(watchdog_.get(), "worker1", kDeadline);
+  FakeWorker worker2(watchdog_.get(), "worker2", kDeadline);
+  ASSERT_OK(watchdog_->Start());
+  absl::SleepFor(3 * kDeadline);
+  EXPECT_TRUE(watchdog_->IsHealthy());
+  ASSERT_OK(watchdog_->Stop());
+
+  auto states = watchdog_->GetWorkerStates();
+  ASSERT_EQ(2U, states.size());
+  EXPECT_EQ("worker1", states[0].name);
+  EXPECT_EQ("worker2", states[1].name);
+  for (const auto& state : states) {
+    EXPECT_EQ(kDeadline, state.deadline);
+    EXPECT_GT(state.progress, 0U);
+    EXPECT_FALSE(state.stalled);
+  }
+  absl::MutexLock l(&lock_);
+  EXPECT_TRUE(health_transitions_.empty());
+}
+
+TEST_F(LivenessWatchdogTest, DetectsStallAndRecovery) {
+  FakeWorker healthy_worker(watchdog_.get(), "healthy", kDeadline);
+  FakeWorker worker(watchdog_.get(), "stalling", kDeadline);
+  ASSERT_OK(watchdog_->Start());
+
+  absl::Time stall_time = absl::Now();
+  worker.SetStalled(true);
+  ASSERT_TRUE(WaitForTransitions(1));
+  EXPECT_FALSE(watchdog_->IsHealthy());
+  {
+    absl::MutexLock l(&lock_);
+    // The stall is detected within a few check periods past the deadline. The
+    // margin accounts for the stack dump and slow test machines.
+    absl::Duration latency = transition_times_[0] - stall_time;
+    EXPECT_GE(latency, kDeadline - absl::Milliseconds(1));
+    EXPECT_LT(latency, kDeadline + 10 * kCheckPeriod + absl::Seconds(1));
+  }
+  auto states = watchdog_->GetWorkerStates();
+  ASSERT_EQ(2U, states.size());
+  EXPECT_FALSE(states[0].stalled);
+  EXPECT_TRUE(states[1].stalled);
+
+  worker.SetStalled(false);
+  ASSERT_TRUE(WaitForTransitions(2));
+  EXPECT_TRUE(watchdog_->IsHealthy());
+  ASSERT_OK(watchdog_->Stop());
+  absl::MutexLock l(&lock_);
+  EXPECT_EQ(std::vector<bool>({false, true}), health_transitions_);
+}
+
+TEST_F(LivenessWatchdogTest, PerWorkerDeadlines) {
+  // No watchdog thread, the checks are run manually.
+  FakeWorker slow_worker(watchdog_.get(), "slow", absl::Seconds(60));
+  slow_worker.SetStalled(true);
+  absl::SleepFor(kDeadline + kCheckPeriod);
+  EXPECT_TRUE(watchdog_->CheckNow());
+
+  auto fast_worker = absl::make_unique<FakeWorker>(watchdog_.get(), "fast",
+                                                   absl::Milliseconds(20));
+  fast_worker->SetStalled(true);
+  absl::SleepFor(absl::Milliseconds(50));
+  EXPECT_FALSE(watchdog_->CheckNow());
+  // A stalled worker which exits no longer affects the health.
+  fast_worker.reset();
+  EXPECT_TRUE(watchdog_->CheckNow());
+  absl::MutexLock l(&lock_);
+  EXPECT_EQ(std::vector<bool>({false, true}), health_transitions_);
+}
+
+TEST_F(LivenessWatchdogTest, DefaultDeadline) {
+  auto worker = watchdog_->RegisterWorker("main");
+  auto states = watchdog_->GetWorkerStates();
+  ASSERT_EQ(1U, states.size());
+  EXPECT_EQ(kDeadline, states[0].deadline);
+  EXPECT_EQ(0U, states[0].progress);
+  worker.reset();
+  EXPECT_TRUE(watchdog_->GetWorkerStates().empty());
+}
+
+}  // namespace stratum
@@ -13,6 +13,7 @@
 #include "absl/strings/str_join.h"
 #include "absl/types/optional.h"
 #include "glog/logging.h"
+#include "google/protobuf/util/message_differencer.h"
 #include "p4/v1/p4runtime.pb.h"
 
 namespace stratum {
@@ -117,6 +118,24 @@ grpc::Status VerifyRoleConfig(
     }
   }
 
+  absl::flat_hash_set<uint32_t> quota_ids;
+  for (const auto& quota : role_config->entry_quotas()) {
+    if (std::find(role_config->exclusive_p4_ids().begin(),
+                  role_config->exclusive_p4_ids().end(),
+                  quota.p4_id()) == role_config->exclusive_p4_ids().end() &&
+        std::find(role_config->shared_p4_ids().begin(),
+                  role_config->shared_p4_ids().end(),
+                  quota.p4_id()) == role_config->shared_p4_ids().end()) {
+      return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                          "Role config contains an entry quota for an ID "
+                          "which the role cannot access.");
+    }
+    if (!quota_ids.insert(quota.p4_id()).second) {
+      return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                          "Role config contains duplicate entry quotas.");
+    }
+  }
+
   // TODO(max): verify packet filters for valid metadata
 
   return grpc::Status::OK;
@@ -197,6 +216,34 @@ std::vector<uint32_t> GetP4IdsFromRequest(const p4::v1::WriteRequest& request) {
   return ids;
 }
 
+// Returns true if the entity counts against the entry quotas of a role.
+bool IsQuotaEntity(const p4::v1::Entity& entity) {
+  switch (entity.entity_case()) {
+    case p4::v1::Entity::kTableEntry:
+      return !entity.table_entry().is_default_action();
+    case p4::v1::Entity::kActionProfileMember:
+    case p4::v1::Entity::kActionProfileGroup:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Returns the entry quota for a P4 ID in the role config, or nullptr if the
+// role has no quota for it.
+const P4RoleConfig::EntryQuota* FindEntryQuota(
+    const absl::optional<P4RoleConfig>* role_config, uint32_t id) {
+  if (role_config == nullptr || !role_config->has_value()) return nullptr;
+  for (const auto& quota : (*role_config)->entry_quotas()) {
+    if (quota.p4_id() == id) return &quota;
+  }
+  return nullptr;
+}
+
+void DecrementEntryUsage(uint64_t* usage) {
+  if (*usage > 0) --*usage;
+}
+
 grpc::Status VerifyRoleCanAccessIds(
     const absl::optional<std::string>& role_name,
     const std::vector<uint32_t>& ids,
@@ -377,8 +424,16 @@ grpc::Status SdnControllerManager::HandleArbitrationUpdate(
 
   if (connection_is_new_primary) {
     election_id_past_for_role = new_election_id_for_connection;
-    // Update the configuration for this controllers role.
-    role_config_by_name_[role_name] = role_config;
+    // Update the configuration for this controllers role. A changed config
+    // with entry quotas needs the usage of the role recounted.
+    auto& role_config_for_role = role_config_by_name_[role_name];
+    if (role_config.has_value() && role_config->entry_quotas_size() > 0 &&
+        (!role_config_for_role.has_value() ||
+         !google::protobuf::util::MessageDifferencer::Equals(
+             *role_config_for_role, *role_config))) {
+      entry_usage_stale_ = true;
+    }
+    role_config_for_role = role_config;
     // The spec demands we send a notifcation even if the old & new primary
     // match.
     InformConnectionsAboutPrimaryChange(role_name);
@@ -602,6 +657,167 @@ p4::v1::ReadRequest SdnControllerManager::ExpandWildcardsInReadRequest(
   return ret;
 }
 
+std::vector<grpc::Status> SdnControllerManager::ReserveEntryQuota(
+    const p4::v1::WriteRequest& request) {
+  absl::MutexLock l(&lock_);
+
+  absl::optional<std::string> role_name;
+  if (!request.role().empty()) {
+    role_name = request.role();
+  }
+  const absl::optional<P4RoleConfig>* role_config = nullptr;
+  const auto& role_config_iter = role_config_by_name_.find(role_name);
+  if (role_config_iter != role_config_by_name_.end()) {
+    role_config = &role_config_iter->second;
+  }
+
+  std::vector<grpc::Status> results(request.updates_size(),
+                                    grpc::Status::OK);
+  auto& entry_usage = entry_usage_by_role_[role_name];
+  auto& pending_entries = pending_entries_by_role_[role_name];
+  for (int i = 0; i < request.updates_size(); ++i) {
+    const auto& update = request.updates(i);
+    if ((update.type() != p4::v1::Update::INSERT &&
+         update.type() != p4::v1::Update::DELETE) ||
+        !IsQuotaEntity(update.entity())) {
+      continue;
+    }
+    uint32_t id = GetP4IdFromEntity(update.entity());
+    if (update.type() == p4::v1::Update::DELETE) {
+      ++pending_entries[id];
+      continue;
+    }
+    const auto* quota = FindEntryQuota(role_config, id);
+    if (quota != nullptr && entry_usage[id] >= quota->max_entries()) {
+      VLOG(1) << "Role " << PrettyPrintRoleName(role_name)
+              << " exceeds its quota of " << quota->max_entries()
+              << " entries for " << id << ".";
+      results[i] = grpc::Status(
+          grpc::StatusCode::RESOURCE_EXHAUSTED,
+          absl::StrCat("Role ", PrettyPrintRoleName(role_name),
+                       " has reached its quota of ", quota->max_entries(),
+                       " entries for P4 entity ", id, "."));
+      continue;
+    }
+    ++entry_usage[id];
+    ++pending_entries[id];
+  }
+
+  return results;
+}
+
+void SdnControllerManager::SettleEntryQuota(
+    const p4::v1::WriteRequest& request, const std::vector<bool>& applied) {
+  absl::MutexLock l(&lock_);
+
+  absl::optional<std::string> role_name;
+  if (!request.role().empty()) {
+    role_name = request.role();
+  }
+
+  auto& entry_usage = entry_usage_by_role_[role_name];
+  auto& pending_entries = pending_entries_by_role_[role_name];
+  for (int i = 0; i < request.updates_size(); ++i) {
+    const auto& update = request.updates(i);
+    if ((update.type() != p4::v1::Update::INSERT &&
+         update.type() != p4::v1::Update::DELETE) ||
+        !IsQuotaEntity(update.entity())) {
+      continue;
+    }
+    uint32_t id = GetP4IdFromEntity(update.entity());
+    DecrementEntryUsage(&pending_entries[id]);
+    if (i >= static_cast<int>(applied.size())) continue;
+    if (update.type() == p4::v1::Update::INSERT && !applied[i]) {
+      DecrementEntryUsage(&entry_usage[id]);
+    } else if (update.type() == p4::v1::Update::DELETE && applied[i]) {
+      DecrementEntryUsage(&entry_usage[id]);
+    }
+  }
+}
+
+bool SdnControllerManager::HasEntryQuotas() const {
+  absl::MutexLock l(&lock_);
+  for (const auto& e : role_config_by_name_) {
+    if (e.second.has_value() && e.second->entry_quotas_size() > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void SdnControllerManager::MarkEntryUsageStale() {
+  absl::MutexLock l(&lock_);
+  entry_usage_stale_ = true;
+}
+
+bool SdnControllerManager::TakeStaleEntryUsage() {
+  absl::MutexLock l(&lock_);
+  if (!entry_usage_stale_) return false;
+  entry_usage_stale_ = false;
+  for (const auto& e : role_config_by_name_) {
+    if (e.second.has_value() && e.second->entry_quotas_size() > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void SdnControllerManager::ReconcileEntryUsage(
+    const absl::flat_hash_map<uint32_t, uint64_t>& entry_counts) {
+  absl::MutexLock l(&lock_);
+
+  // Returns the entries read for an ID, plus the pending updates of a role,
+  // which the read may or may not have seen.
+  auto count_with_pending =
+      [this, &entry_counts](const absl::optional<std::string>& role_name,
+                            uint32_t id) -> uint64_t {
+    uint64_t count = 0;
+    const auto& entry_count = entry_counts.find(id);
+    if (entry_count != entry_counts.end()) count = entry_count->second;
+    const auto& pending_entries = pending_entries_by_role_.find(role_name);
+    if (pending_entries != pending_entries_by_role_.end()) {
+      const auto& pending = pending_entries->second.find(id);
+      if (pending != pending_entries->second.end()) count += pending->second;
+    }
+    return count;
+  };
+  for (auto& e : entry_usage_by_role_) {
+    for (auto& usage : e.second) {
+      usage.second =
+          std::min(usage.second, count_with_pending(e.first, usage.first));
+    }
+  }
+  for (const auto& e : role_config_by_name_) {
+    if (!e.second.has_value()) continue;
+    auto& entry_usage = entry_usage_by_role_[e.first];
+    for (const auto& id : e.second->exclusive_p4_ids()) {
+      entry_usage[id] = count_with_pending(e.first, id);
+    }
+  }
+}
+
+std::vector<SdnControllerManager::EntryQuotaUsage>
+SdnControllerManager::GetEntryQuotaUsage() const {
+  absl::MutexLock l(&lock_);
+
+  std::vector<EntryQuotaUsage> quota_usage;
+  for (const auto& e : role_config_by_name_) {
+    if (!e.second.has_value()) continue;
+    const auto& entry_usage = entry_usage_by_role_.find(e.first);
+    for (const auto& quota : e.second->entry_quotas()) {
+      uint64_t entries = 0;
+      if (entry_usage != entry_usage_by_role_.end()) {
+        const auto& usage = entry_usage->second.find(quota.p4_id());
+        if (usage != entry_usage->second.end()) entries = usage->second;
+      }
+      quota_usage.push_back(
+          {e.first, quota.p4_id(), entries, quota.max_entries()});
+    }
+  }
+
+  return quota_usage;
+}
+
 void SdnControllerManager::InformConnectionsAboutPrimaryChange(
     const absl::optional<std::string>& role_name) {
   VLOG(1) << "Informing all connections about primary connection change.";
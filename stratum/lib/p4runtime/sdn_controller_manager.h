@@ -105,6 +105,56 @@ class SdnControllerManager {
   absl::Status SendStreamMessageToPrimary(
       const p4::v1::StreamMessageResponse& response) ABSL_LOCKS_EXCLUDED(lock_);
 
+  // Checks the inserts of a write request against the entry quotas of its
+  // role, and returns one status per update. Inserts within the quota are
+  // counted right away, so that concurrent writes cannot exceed it. Inserts
+  // beyond the quota get a RESOURCE_EXHAUSTED status and must not be written.
+  std::vector<grpc::Status> ReserveEntryQuota(
+      const p4::v1::WriteRequest& request) ABSL_LOCKS_EXCLUDED(lock_);
+
+  // Settles the entry usage after the switch has processed a write request,
+  // which must only contain the updates admitted by ReserveEntryQuota(). The
+  // failed inserts return their reservation and the successful deletes free
+  // up quota. The applied vector has one element per update.
+  void SettleEntryQuota(const p4::v1::WriteRequest& request,
+                        const std::vector<bool>& applied)
+      ABSL_LOCKS_EXCLUDED(lock_);
+
+  // Returns true if the config of any role sets an entry quota.
+  bool HasEntryQuotas() const ABSL_LOCKS_EXCLUDED(lock_);
+
+  // Marks the entry usage as no longer matching the switch, e.g. after a new
+  // pipeline was committed. A role config change with entry quotas in
+  // HandleArbitrationUpdate() marks it too.
+  void MarkEntryUsageStale() ABSL_LOCKS_EXCLUDED(lock_);
+
+  // Returns true if the entry usage was marked stale since the last call and
+  // some role has entry quotas, in which case the caller is expected to call
+  // ReconcileEntryUsage().
+  bool TakeStaleEntryUsage() ABSL_LOCKS_EXCLUDED(lock_);
+
+  // Replaces the entry usage of all roles with the number of entries per P4
+  // ID that are actually on the switch. The counts can be read without any
+  // lock held, while writes are in flight: the updates reserved but not yet
+  // settled are added to them, as the read may or may not have seen these.
+  // The usage of an exclusive ID is set to the result. The entries of a shared
+  // ID cannot be attributed to a role, so its usage is only capped at it.
+  void ReconcileEntryUsage(
+      const absl::flat_hash_map<uint32_t, uint64_t>& entry_counts)
+      ABSL_LOCKS_EXCLUDED(lock_);
+
+  // The current usage of one entry quota.
+  struct EntryQuotaUsage {
+    absl::optional<std::string> role_name;
+    uint32_t p4_id;
+    uint64_t entries;
+    uint64_t max_entries;
+  };
+
+  // Returns the current usage of the entry quotas of all roles.
+  std::vector<EntryQuotaUsage> GetEntryQuotaUsage() const
+      ABSL_LOCKS_EXCLUDED(lock_);
+
  private:
   SdnControllerManager() : device_id_(0) {}
 
@@ -169,6 +219,27 @@ class SdnControllerManager {
   absl::flat_hash_map<absl::optional<std::string>,
                       absl::optional<absl::uint128>>
       election_id_past_by_role_ ABSL_GUARDED_BY(lock_);
+
+  // We maintain the number of table entries, action profile members and
+  // action profile groups that each role has inserted, to enforce the entry
+  // quotas of the role configs. The usage outlives the connections of a role,
+  // as the entries stay on the switch.
+  //
+  // key:   role_name   (no value indicates the default/root role)
+  // value: map from P4 ID to the number of entries
+  absl::flat_hash_map<absl::optional<std::string>,
+                      absl::flat_hash_map<uint32_t, uint64_t>>
+      entry_usage_by_role_ ABSL_GUARDED_BY(lock_);
+
+  // The number of inserts and deletes that each role has reserved with
+  // ReserveEntryQuota() and not yet settled with SettleEntryQuota(), per P4
+  // ID. Merged with the entries read by ReconcileEntryUsage().
+  absl::flat_hash_map<absl::optional<std::string>,
+                      absl::flat_hash_map<uint32_t, uint64_t>>
+      pending_entries_by_role_ ABSL_GUARDED_BY(lock_);
+
+  // Set when the entry usage needs to be reconciled with the switch.
+  bool entry_usage_stale_ ABSL_GUARDED_BY(lock_) = false;
 };
 
 }  // namespace p4runtime
@@ -5,6 +5,7 @@
 #include "stratum/lib/timer_daemon.h"
 
 #include "absl/synchronization/mutex.h"
+#include "stratum/lib/liveness_watchdog.h"
 
 namespace stratum {
 namespace hal {
@@ -13,9 +14,12 @@ namespace {
 // A function that is executed by the thread created by TimerDaemon::Start().
 // It provides a timer resolution of 1ms.
 static void* Timer(void* arg) {
+  // A timer action which does not return stalls all the other timers.
+  auto worker = LivenessWatchdog::GetInstance()->RegisterWorker("TimerDaemon");
   while (true) {
     // Sleep for 1ms.
     absl::SleepFor(absl::Milliseconds(1));
+    worker->Heartbeat();
 
     // Call the method that will process the list of timers.
     // If the method returns 'false' it means that this thread should be
@@ -63,18 +63,28 @@ def _generate_p4c_stratum_config(ctx):
             annotation_map_files += ","
         annotation_map_files += map_file.path
 
+    p4c_args = [
+        "--p4c_fe_options=" + p4c_native_options,
+        "--p4_info_file=" + gen_files[2].path,
+        "--p4_pipeline_config_binary_file=" + gen_files[0].path,
+        "--p4_pipeline_config_text_file=" + gen_files[1].path,
+        "--p4c_annotation_map_files=" + annotation_map_files,
+        "--slice_map_file=" + ctx.file.slice_map.path,
+        "--target_parser_map_file=" + ctx.file.parser_map.path,
+    ]
+
+    # The ACL resource estimates only run when the rule names a target chip.
+    if ctx.attr.target_chip:
+        p4c_args += [
+            "--target_chip_type=" + ctx.attr.target_chip,
+            "--target_hardware_specs_file=" + ctx.file.hardware_specs.path,
+        ]
+
     ctx.actions.run(
-        arguments = [
-            "--p4c_fe_options=" + p4c_native_options,
-            "--p4_info_file=" + gen_files[2].path,
-            "--p4_pipeline_config_binary_file=" + gen_files[0].path,
-            "--p4_pipeline_config_text_file=" + gen_files[1].path,
-            "--p4c_annotation_map_files=" + annotation_map_files,
-            "--slice_map_file=" + ctx.file.slice_map.path,
-            "--target_parser_map_file=" + ctx.file.parser_map.path,
-        ],
+        arguments = p4c_args,
         inputs = ([p4_preprocessed_file] + [ctx.file.parser_map] +
-                  [ctx.file.slice_map] + ctx.files.annotation_maps),
+                  [ctx.file.slice_map] + [ctx.file.hardware_specs] +
+                  ctx.files.annotation_maps),
         # Disable ASAN check, because P4C is known to leak memory b/63128624.
         env = {"ASAN_OPTIONS": "halt_on_error=0:detect_leaks=0"},
         outputs = gen_files,
@@ -86,7 +96,9 @@ def _generate_p4c_stratum_config(ctx):
 
 # Compiles P4_16 source into P4 info and P4 pipeline config files. The
 # output file names are <name>_p4_info.pb.txt and <name>_p4_pipeline.pb.txt
-# in the appropriate path under the genfiles directory.
+# in the appropriate path under the genfiles directory.  When target_chip names
+# a BcmChipType, the compiler also checks that the ACL tables fit the chip model
+# in hardware_specs.
 p4_fpm_compile = rule(
     implementation = _generate_p4c_stratum_config,
     fragments = ["cpp"],
@@ -116,6 +128,12 @@ p4_fpm_compile = rule(
             mandatory = False,
             default = Label("//stratum/p4c_backends/fpm:slice_map_files"),
         ),
+        "hardware_specs": attr.label(
+            allow_single_file = True,
+            mandatory = False,
+            default = Label("//stratum/hal/config:bcm_hardware_specs.pb.txt"),
+        ),
+        "target_chip": attr.string(),
         "copts": attr.string_list(),
         "_model": attr.label(
             allow_single_file = True,
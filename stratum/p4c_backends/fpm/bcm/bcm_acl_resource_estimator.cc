@@ -0,0 +1,321 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+// This file contains the BcmAclResourceEstimator implementation.
+
+#include "stratum/p4c_backends/fpm/bcm/bcm_acl_resource_estimator.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "absl/strings/str_join.h"
+#include "external/com_github_p4lang_p4c/lib/error.h"
+#include "stratum/glue/logging.h"
+#include "stratum/p4c_backends/fpm/utils.h"
+
+namespace stratum {
+namespace p4c_backends {
+
+using FieldProcessor =
+    hal::BcmHardwareSpecs::ChipModelSpec::AclSpec::FieldProcessor;
+
+namespace {
+
+// Maps P4 ACL pipeline stages to field processor stages, as in
+// hal::bcm::AclTable::P4PipelineToBcmAclStage.  Non-ACL stages map to
+// FP_UNKNOWN.
+FieldProcessor::FieldProcessorStage GetFieldProcessorStage(
+    P4Annotation::PipelineStage stage) {
+  switch (stage) {
+    case P4Annotation::VLAN_ACL:
+      return FieldProcessor::VLAN;
+    case P4Annotation::INGRESS_ACL:
+      return FieldProcessor::INGRESS;
+    case P4Annotation::EGRESS_ACL:
+      return FieldProcessor::EGRESS;
+    default:
+      return FieldProcessor::FP_UNKNOWN;
+  }
+}
+
+// The switch extracts these fields with UDFs instead of native qualifiers,
+// as in hal::bcm::BcmUdfManager::DefaultIsUdfEligible.
+bool IsUdfField(const hal::P4FieldDescriptor& field_descriptor) {
+  return field_descriptor.type() == P4_FIELD_TYPE_ARP_TPA;
+}
+
+// Returns the name of the TCAM key segment where a qualifier goes.  IPv4 and
+// IPv6 qualifiers never match the same packet, so they share key bits.
+// Fields without a known type get their own segments.
+std::string GetKeySegment(const std::string& field_name, P4FieldType type) {
+  switch (type) {
+    case P4_FIELD_TYPE_UNKNOWN:
+    case P4_FIELD_TYPE_ANNOTATED:
+      return field_name;
+    case P4_FIELD_TYPE_IPV4_SRC:
+      type = P4_FIELD_TYPE_IPV6_SRC;
+      break;
+    case P4_FIELD_TYPE_IPV4_DST:
+      type = P4_FIELD_TYPE_IPV6_DST;
+      break;
+    case P4_FIELD_TYPE_IPV4_PROTO:
+      type = P4_FIELD_TYPE_IPV6_NEXT_HDR;
+      break;
+    case P4_FIELD_TYPE_IPV4_DIFFSERV:
+      type = P4_FIELD_TYPE_IPV6_TRAFFIC_CLASS;
+      break;
+    default:
+      break;
+  }
+  return P4FieldType_Name(type);
+}
+
+int DivideRoundUp(int64 dividend, int64 divisor) {
+  return static_cast<int>((dividend + divisor - 1) / divisor);
+}
+
+}  // namespace
+
+BcmAclResourceEstimator::BcmAclResourceEstimator(
+    const hal::BcmHardwareSpecs::ChipModelSpec& chip_spec)
+    : chip_spec_(chip_spec) {}
+
+bool BcmAclResourceEstimator::EstimateResources(
+    const hal::P4InfoManager& p4_info_manager,
+    hal::P4PipelineConfig* p4_pipeline_config) {
+  hal::P4AclResourceReport acl_report;
+  acl_report.set_chip_type(
+      hal::BcmChip::BcmChipType_Name(chip_spec_.chip_type()));
+  bool fits = true;
+
+  for (const auto& control : p4_pipeline_config->p4_controls()) {
+    auto processor_status =
+        hal::bcm::PipelineProcessor::CreateInstance(control.main());
+    if (!processor_status.ok()) {
+      ::error("Backend: Unable to find the physical ACL tables in control "
+              "%s: %s",
+              control.name().c_str(),
+              processor_status.status().error_message().c_str());
+      fits = false;
+      continue;
+    }
+    auto pipeline_processor = processor_status.ConsumeValueOrDie();
+    for (const auto& physical_table : pipeline_processor->PhysicalPipeline()) {
+      // Like the BcmAclManager, this skips physical tables that do not start
+      // in an ACL stage.
+      if (physical_table.empty()) continue;
+      if (GetFieldProcessorStage(physical_table[0].table.pipeline_stage()) ==
+          FieldProcessor::FP_UNKNOWN) {
+        continue;
+      }
+      if (!EstimatePhysicalTable(p4_info_manager, *p4_pipeline_config,
+                                 physical_table, &acl_report)) {
+        fits = false;
+      }
+    }
+  }
+  if (!EstimateStages(&acl_report)) fits = false;
+
+  const int udf_chunks_available = static_cast<int>(
+      chip_spec_.udf().chunks_per_set() * chip_spec_.udf().set_count());
+  acl_report.set_udf_chunks_used(all_udf_chunks_.size());
+  acl_report.set_udf_chunks_available(udf_chunks_available);
+  if (acl_report.udf_chunks_used() > udf_chunks_available) {
+    ::error("Backend: ACL tables need %d UDF chunks, but chip %s only has %d",
+            acl_report.udf_chunks_used(), acl_report.chip_type().c_str(),
+            udf_chunks_available);
+    fits = false;
+  }
+
+  *p4_pipeline_config->mutable_acl_resource_report() = acl_report;
+  return fits;
+}
+
+int BcmAclResourceEstimator::MaxWideFactor(
+    FieldProcessor::FieldProcessorStage stage) {
+  // The IFP supports triple-wide entries, whereas the VFP and EFP only go up
+  // to double-wide entries.
+  return stage == FieldProcessor::INGRESS ? 3 : 2;
+}
+
+bool BcmAclResourceEstimator::EstimatePhysicalTable(
+    const hal::P4InfoManager& p4_info_manager,
+    const hal::P4PipelineConfig& p4_pipeline_config,
+    const hal::bcm::PipelineProcessor::PhysicalTableAsVector& physical_table,
+    hal::P4AclResourceReport* acl_report) {
+  const P4Annotation::PipelineStage stage =
+      physical_table[0].table.pipeline_stage();
+  auto* table_report = acl_report->add_physical_tables();
+  table_report->set_stage(stage);
+  for (const auto& pipeline_table : physical_table) {
+    table_report->add_tables(pipeline_table.table.table_name());
+  }
+  const std::string table_names = absl::StrJoin(table_report->tables(), ", ");
+  const int chunk_bits = chip_spec_.udf().chunk_bits();
+  bool fits = true;
+
+  // The key width is the sum of the widest field in each key segment plus
+  // the UDF chunks.
+  std::map<std::string, int> key_segment_widths;
+  std::set<P4FieldType> qualifiers;
+  std::set<UdfChunk> udf_chunks;
+  int64 total_size = 0;
+  for (const auto& pipeline_table : physical_table) {
+    auto table_status =
+        p4_info_manager.FindTableByID(pipeline_table.table.table_id());
+    if (!table_status.ok()) {
+      ::error("Backend: Unable to find ACL table %s in P4Info: %s",
+              pipeline_table.table.table_name().c_str(),
+              table_status.status().error_message().c_str());
+      fits = false;
+      continue;
+    }
+    const auto& p4_table = table_status.ValueOrDie();
+    total_size += p4_table.size();
+    for (const auto& match_field : p4_table.match_fields()) {
+      const hal::P4FieldDescriptor* field_descriptor =
+          FindFieldDescriptorOrNull(match_field.name(), p4_pipeline_config);
+      P4FieldType type = P4_FIELD_TYPE_UNKNOWN;
+      if (field_descriptor != nullptr) type = field_descriptor->type();
+      qualifiers.insert(type);
+      if (field_descriptor != nullptr && IsUdfField(*field_descriptor)) {
+        if (chunk_bits == 0) {
+          ::error("Backend: ACL table %s match field %s needs a UDF, but "
+                  "chip %s has no UDF support",
+                  pipeline_table.table.table_name().c_str(),
+                  match_field.name().c_str(), acl_report->chip_type().c_str());
+          fits = false;
+          continue;
+        }
+        const int first_bit = field_descriptor->bit_offset();
+        const int last_bit = first_bit + match_field.bitwidth() - 1;
+        for (int chunk = first_bit / chunk_bits; chunk <= last_bit / chunk_bits;
+             ++chunk) {
+          udf_chunks.emplace(field_descriptor->header_type(), chunk);
+        }
+        continue;
+      }
+      int& segment_width =
+          key_segment_widths[GetKeySegment(match_field.name(), type)];
+      segment_width = std::max(segment_width, match_field.bitwidth());
+    }
+  }
+  for (auto qualifier : qualifiers) table_report->add_qualifiers(qualifier);
+  int key_width = udf_chunks.size() * chunk_bits;
+  for (const auto& iter : key_segment_widths) key_width += iter.second;
+  table_report->set_key_width(key_width);
+  table_report->set_udf_chunks(udf_chunks.size());
+  all_udf_chunks_.insert(udf_chunks.begin(), udf_chunks.end());
+
+  if (udf_chunks.size() > chip_spec_.udf().chunks_per_set()) {
+    ::error("Backend: ACL tables %s need %d UDF chunks, but chip %s only "
+            "has %d chunks per UDF set",
+            table_names.c_str(), table_report->udf_chunks(),
+            acl_report->chip_type().c_str(),
+            chip_spec_.udf().chunks_per_set());
+    fits = false;
+  }
+
+  const FieldProcessor* field_processor = FindFieldProcessor(stage);
+  if (field_processor == nullptr || field_processor->slices_size() == 0) {
+    ::error("Backend: ACL tables %s are in pipeline stage %s, which chip %s "
+            "does not support",
+            table_names.c_str(),
+            P4Annotation::PipelineStage_Name(stage).c_str(),
+            acl_report->chip_type().c_str());
+    return false;
+  }
+
+  // Wide entries go in the widest slices.  Each group of wide_factor slices
+  // holds one slice's worth of entries, and the SDK creates the first group
+  // along with the table.
+  const FieldProcessor::Slice* widest_slice = &field_processor->slices(0);
+  for (const auto& slice : field_processor->slices()) {
+    if (slice.width() > widest_slice->width()) widest_slice = &slice;
+  }
+  const int wide_factor =
+      std::max(1, DivideRoundUp(key_width, widest_slice->width()));
+  const int64 slice_entries = std::max(widest_slice->size(), 1U);
+  const int slice_groups =
+      std::max(1, DivideRoundUp(total_size, slice_entries));
+  table_report->set_wide_factor(wide_factor);
+  table_report->set_min_slices(wide_factor);
+  table_report->set_full_slices(wide_factor * slice_groups);
+
+  const int max_wide_factor = MaxWideFactor(field_processor->stage());
+  if (wide_factor > max_wide_factor) {
+    ::error("Backend: ACL tables %s need a %d-bit TCAM key, which exceeds "
+            "the %d bits that chip %s allows in pipeline stage %s",
+            table_names.c_str(), key_width,
+            max_wide_factor * widest_slice->width(),
+            acl_report->chip_type().c_str(),
+            P4Annotation::PipelineStage_Name(stage).c_str());
+    fits = false;
+  }
+
+  return fits;
+}
+
+bool BcmAclResourceEstimator::EstimateStages(
+    hal::P4AclResourceReport* acl_report) {
+  std::map<P4Annotation::PipelineStage, hal::P4AclResourceReport::StageUsage>
+      stage_usages;
+  for (const auto& table_report : acl_report->physical_tables()) {
+    auto& stage_usage = stage_usages[table_report.stage()];
+    stage_usage.set_stage(table_report.stage());
+    stage_usage.set_min_slices(stage_usage.min_slices() +
+                               table_report.min_slices());
+    stage_usage.set_full_slices(stage_usage.full_slices() +
+                                table_report.full_slices());
+  }
+
+  bool fits = true;
+  for (auto& iter : stage_usages) {
+    auto& stage_usage = iter.second;
+    const std::string stage_name =
+        P4Annotation::PipelineStage_Name(stage_usage.stage());
+    const FieldProcessor* field_processor =
+        FindFieldProcessor(stage_usage.stage());
+    int slices_available = 0;
+    if (field_processor != nullptr) {
+      for (const auto& slice : field_processor->slices()) {
+        slices_available += slice.count();
+      }
+    }
+    stage_usage.set_slices_available(slices_available);
+    *acl_report->add_stages() = stage_usage;
+
+    // Tables in unsupported stages have already been reported.
+    if (field_processor == nullptr) continue;
+    if (stage_usage.min_slices() > slices_available) {
+      ::error("Backend: ACL tables in pipeline stage %s need at least %d TCAM "
+              "slices, but chip %s only has %d",
+              stage_name.c_str(), stage_usage.min_slices(),
+              acl_report->chip_type().c_str(), slices_available);
+      fits = false;
+    } else if (stage_usage.full_slices() > slices_available) {
+      LOG(WARNING) << "ACL tables in pipeline stage " << stage_name
+                   << " need " << stage_usage.full_slices()
+                   << " TCAM slices to hold all entries, but chip "
+                   << acl_report->chip_type() << " only has "
+                   << slices_available;
+    }
+  }
+
+  return fits;
+}
+
+const FieldProcessor* BcmAclResourceEstimator::FindFieldProcessor(
+    P4Annotation::PipelineStage stage) const {
+  const FieldProcessor::FieldProcessorStage fp_stage =
+      GetFieldProcessorStage(stage);
+  for (const auto& field_processor : chip_spec_.acl().field_processors()) {
+    if (field_processor.stage() == fp_stage) return &field_processor;
+  }
+  return nullptr;
+}
+
+}  // namespace p4c_backends
+}  // namespace stratum
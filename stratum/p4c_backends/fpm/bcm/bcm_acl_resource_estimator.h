@@ -0,0 +1,94 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+// The BcmAclResourceEstimator models the way a BCM switch lays out the P4
+// program's ACL tables in the chip's field processor TCAMs.  It estimates the
+// number of TCAM slices and UDF chunks that the tables need, and it reports
+// errors when the program exceeds the limits of the chip model given by
+// the BCM hardware specs.  The estimates follow the BcmAclManager and
+// BcmUdfManager logic:
+//  - Logical P4 tables group into physical tables as the PipelineProcessor
+//    decides for each P4Control.
+//  - A physical table's qualifier set is the union of the match fields in
+//    its logical tables.
+//  - UDF-eligible fields are extracted in UDF chunks, and each physical
+//    table uses one UDF set.
+// The TCAM key width is a heuristic.  Actual key widths depend on the SDK's
+// qualifier encodings, so the estimator only fails when a table cannot be
+// created at all.  It logs a warning when the sum of the P4 table sizes
+// exceeds the stage's TCAM entries.
+
+#ifndef STRATUM_P4C_BACKENDS_FPM_BCM_BCM_ACL_RESOURCE_ESTIMATOR_H_
+#define STRATUM_P4C_BACKENDS_FPM_BCM_BCM_ACL_RESOURCE_ESTIMATOR_H_
+
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "stratum/hal/lib/bcm/bcm.pb.h"
+#include "stratum/hal/lib/bcm/pipeline_processor.h"
+#include "stratum/hal/lib/p4/p4_info_manager.h"
+#include "stratum/hal/lib/p4/p4_pipeline_config.pb.h"
+#include "stratum/public/proto/p4_annotation.pb.h"
+#include "stratum/public/proto/p4_table_defs.pb.h"
+
+namespace stratum {
+namespace p4c_backends {
+
+class BcmAclResourceEstimator {
+ public:
+  // The chip_spec describes the target chip's ACL and UDF hardware.
+  explicit BcmAclResourceEstimator(
+      const hal::BcmHardwareSpecs::ChipModelSpec& chip_spec);
+  virtual ~BcmAclResourceEstimator() {}
+
+  // Estimates the resources for all ACL tables in the p4_pipeline_config's
+  // P4Controls and stores the results in the p4_pipeline_config's
+  // acl_resource_report.  The return value is false if any table exceeds the
+  // chip's limits, in which case the p4c error count also increases.
+  // EstimateResources expects to run once per BcmAclResourceEstimator
+  // instance.
+  bool EstimateResources(const hal::P4InfoManager& p4_info_manager,
+                         hal::P4PipelineConfig* p4_pipeline_config);
+
+  // The maximum number of slices that an entry can span in the given field
+  // processor stage.
+  static int MaxWideFactor(
+      hal::BcmHardwareSpecs::ChipModelSpec::AclSpec::FieldProcessor::
+          FieldProcessorStage stage);
+
+  // BcmAclResourceEstimator is neither copyable nor movable.
+  BcmAclResourceEstimator(const BcmAclResourceEstimator&) = delete;
+  BcmAclResourceEstimator& operator=(const BcmAclResourceEstimator&) = delete;
+
+ private:
+  // A UDF chunk is identified by the header it comes from and its index
+  // within the header.
+  typedef std::pair<P4HeaderType, int> UdfChunk;
+
+  // Estimates the resources for one physical table, adding its report to
+  // acl_report.  Returns false if the table does not fit the chip.
+  bool EstimatePhysicalTable(
+      const hal::P4InfoManager& p4_info_manager,
+      const hal::P4PipelineConfig& p4_pipeline_config,
+      const hal::bcm::PipelineProcessor::PhysicalTableAsVector& physical_table,
+      hal::P4AclResourceReport* acl_report);
+
+  // Checks the total slice usage of each stage.
+  bool EstimateStages(hal::P4AclResourceReport* acl_report);
+
+  // Finds the field processor spec for a P4 pipeline stage, returning nullptr
+  // if the chip has no such stage.
+  const hal::BcmHardwareSpecs::ChipModelSpec::AclSpec::FieldProcessor*
+  FindFieldProcessor(P4Annotation::PipelineStage stage) const;
+
+  const hal::BcmHardwareSpecs::ChipModelSpec chip_spec_;
+
+  // Accumulates the UDF chunks of all physical tables.
+  std::set<UdfChunk> all_udf_chunks_;
+};
+
+}  // namespace p4c_backends
+}  // namespace stratum
+
+#endif  // STRATUM_P4C_BACKENDS_FPM_BCM_BCM_ACL_RESOURCE_ESTIMATOR_H_
@@ -0,0 +1,331 @@
+// Copyright 2020-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+// This file contains unit tests for the BcmAclResourceEstimator.
+
+#include "stratum/p4c_backends/fpm/bcm/bcm_acl_resource_estimator.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "external/com_github_p4lang_p4c/frontends/common/options.h"
+#include "external/com_github_p4lang_p4c/lib/compile_context.h"
+#include "external/com_github_p4lang_p4c/lib/error.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "p4/config/v1/p4info.pb.h"
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/p4/p4_info_manager.h"
+#include "stratum/hal/lib/p4/p4_pipeline_config.pb.h"
+#include "stratum/lib/utils.h"
+
+namespace stratum {
+namespace p4c_backends {
+
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+using ::testing::UnorderedElementsAre;
+
+// Describes a match field for the tables that tests set up.
+struct TestField {
+  std::string name;
+  P4FieldType type;
+  int bit_width;
+  int bit_offset;
+};
+
+// The test fixture sets up P4Info and P4PipelineConfig content for
+// ACL tables, which it estimates for a TOMAHAWK chip.  The TOMAHAWK
+// specs give its IFP 12 slices of 160 bits and 256 entries, and it has
+// 2 UDF sets of 8 16-bit chunks.
+class BcmAclResourceEstimatorTest : public testing::Test {
+ protected:
+  static constexpr uint32 kActionId = 1;
+
+  BcmAclResourceEstimatorTest()
+      : next_table_id_(100),
+        test_p4c_context_(new P4CContextWithOptions<CompilerOptions>) {}
+
+  void SetUp() override {
+    hal::BcmHardwareSpecs hardware_specs;
+    ASSERT_OK(ReadProtoFromTextFile(
+        "stratum/hal/config/bcm_hardware_specs.pb.txt", &hardware_specs));
+    for (const auto& chip_spec : hardware_specs.chip_specs()) {
+      if (chip_spec.chip_type() == hal::BcmChip::TOMAHAWK) {
+        chip_spec_ = chip_spec;
+      }
+    }
+    ASSERT_EQ(hal::BcmChip::TOMAHAWK, chip_spec_.chip_type());
+    auto* action = test_p4_info_.add_actions();
+    action->mutable_preamble()->set_id(kActionId);
+    action->mutable_preamble()->set_name("NoAction");
+    test_p4_pipeline_config_.add_p4_controls()->set_name("ingress");
+  }
+
+  // Adds a table with the given match fields to the P4Info and the
+  // P4PipelineConfig.  The tables apply in sequence, so each one becomes
+  // a separate physical table.
+  void AddTable(const std::string& name, P4Annotation::PipelineStage stage,
+                int64 size, const std::vector<TestField>& fields) {
+    const uint32 table_id = next_table_id_++;
+    auto* table = test_p4_info_.add_tables();
+    table->mutable_preamble()->set_id(table_id);
+    table->mutable_preamble()->set_name(name);
+    table->add_action_refs()->set_id(kActionId);
+    table->set_size(size);
+    uint32 field_id = 1;
+    for (const auto& field : fields) {
+      auto* match_field = table->add_match_fields();
+      match_field->set_id(field_id++);
+      match_field->set_name(field.name);
+      match_field->set_bitwidth(field.bit_width);
+      match_field->set_match_type(::p4::config::v1::MatchField::TERNARY);
+      auto* field_descriptor =
+          (*test_p4_pipeline_config_.mutable_table_map())[field.name]
+              .mutable_field_descriptor();
+      field_descriptor->set_type(field.type);
+      field_descriptor->set_bit_width(field.bit_width);
+      field_descriptor->set_bit_offset(field.bit_offset);
+      if (field.type == P4_FIELD_TYPE_ARP_TPA) {
+        field_descriptor->set_header_type(P4_HEADER_ARP);
+      }
+    }
+    auto* apply = test_p4_pipeline_config_.mutable_p4_controls(0)
+                      ->mutable_main()
+                      ->add_statements()
+                      ->mutable_apply();
+    apply->set_table_name(name);
+    apply->set_table_id(table_id);
+    apply->set_pipeline_stage(stage);
+  }
+
+  // Adds a table with untyped match fields, one per element of widths.
+  void AddTableWithKeyWidths(const std::string& name,
+                             P4Annotation::PipelineStage stage,
+                             const std::vector<int>& widths) {
+    std::vector<TestField> fields;
+    for (int width : widths) {
+      fields.push_back({absl::StrCat(name, ".field", fields.size()),
+                        P4_FIELD_TYPE_UNKNOWN, width, 0});
+    }
+    AddTable(name, stage, kSliceEntries, fields);
+  }
+
+  // Adds a table that matches 32-bit ARP TPA fields at the given bit offsets.
+  // Each field at a 16-bit aligned offset needs 2 UDF chunks.
+  void AddUdfTable(const std::string& name,
+                   const std::vector<int>& bit_offsets) {
+    std::vector<TestField> fields;
+    for (int bit_offset : bit_offsets) {
+      fields.push_back({absl::StrCat("hdr.arp.field", bit_offset),
+                        P4_FIELD_TYPE_ARP_TPA, 32, bit_offset});
+    }
+    AddTable(name, P4Annotation::INGRESS_ACL, kSliceEntries, fields);
+  }
+
+  // Runs the tested estimator on the test inputs.
+  bool Estimate() {
+    test_p4_info_manager_ =
+        absl::make_unique<hal::P4InfoManager>(test_p4_info_);
+    CHECK_OK(test_p4_info_manager_->InitializeAndVerify());
+    BcmAclResourceEstimator estimator(chip_spec_);
+    return estimator.EstimateResources(*test_p4_info_manager_,
+                                       &test_p4_pipeline_config_);
+  }
+
+  const hal::P4AclResourceReport& report() const {
+    return test_p4_pipeline_config_.acl_resource_report();
+  }
+
+  static constexpr int kSliceEntries = 256;
+
+  hal::BcmHardwareSpecs::ChipModelSpec chip_spec_;
+  ::p4::config::v1::P4Info test_p4_info_;
+  hal::P4PipelineConfig test_p4_pipeline_config_;
+  std::unique_ptr<hal::P4InfoManager> test_p4_info_manager_;
+  uint32 next_table_id_;
+
+  // This test uses its own p4c context since it doesn't have the context
+  // that IRTestHelperJson commonly provides to many backend unit tests.
+  AutoCompileContext test_p4c_context_;
+};
+
+constexpr uint32 BcmAclResourceEstimatorTest::kActionId;
+constexpr int BcmAclResourceEstimatorTest::kSliceEntries;
+
+// Tests the output of the p4c backend for the main sample pipeline.
+TEST_F(BcmAclResourceEstimatorTest, TestMainPipeline) {
+  test_p4_info_.Clear();
+  test_p4_pipeline_config_.Clear();
+  ASSERT_OK(ReadProtoFromTextFile("stratum/pipelines/main/fpm/main.p4info",
+                                  &test_p4_info_));
+  ASSERT_OK(ReadProtoFromTextFile("stratum/pipelines/main/fpm/main.pb.txt",
+                                  &test_p4_pipeline_config_));
+  EXPECT_TRUE(Estimate());
+  EXPECT_EQ(0, ::errorCount());
+  EXPECT_EQ("TOMAHAWK", report().chip_type());
+  ASSERT_EQ(1, report().physical_tables_size());
+  const auto& punt_table = report().physical_tables(0);
+  EXPECT_EQ(P4Annotation::INGRESS_ACL, punt_table.stage());
+  EXPECT_THAT(punt_table.tables(), ElementsAre(HasSubstr("punt_table")));
+  EXPECT_LE(punt_table.wide_factor(), 3);
+  EXPECT_EQ(0, report().udf_chunks_used());
+  ASSERT_EQ(1, report().stages_size());
+  EXPECT_EQ(12, report().stages(0).slices_available());
+}
+
+// Tests the qualifier set and key width of a table with IPv4 and IPv6 fields.
+TEST_F(BcmAclResourceEstimatorTest, TestIpQualifierOverlays) {
+  AddTable("acl_ip", P4Annotation::INGRESS_ACL, 1024,
+           {{"hdr.ipv4.src", P4_FIELD_TYPE_IPV4_SRC, 32, 96},
+            {"hdr.ipv4.dst", P4_FIELD_TYPE_IPV4_DST, 32, 128},
+            {"hdr.ipv6.src", P4_FIELD_TYPE_IPV6_SRC, 128, 64},
+            {"hdr.ipv6.dst", P4_FIELD_TYPE_IPV6_DST, 128, 192},
+            {"hdr.ethernet.type", P4_FIELD_TYPE_ETH_TYPE, 16, 96}});
+  EXPECT_TRUE(Estimate());
+  EXPECT_EQ(0, ::errorCount());
+  ASSERT_EQ(1, report().physical_tables_size());
+  const auto& table_report = report().physical_tables(0);
+  EXPECT_THAT(table_report.tables(), ElementsAre("acl_ip"));
+  EXPECT_THAT(table_report.qualifiers(),
+              UnorderedElementsAre(P4_FIELD_TYPE_IPV4_SRC,
+                                   P4_FIELD_TYPE_IPV4_DST,
+                                   P4_FIELD_TYPE_IPV6_SRC,
+                                   P4_FIELD_TYPE_IPV6_DST,
+                                   P4_FIELD_TYPE_ETH_TYPE));
+  EXPECT_EQ(128 + 128 + 16, table_report.key_width());
+  EXPECT_EQ(2, table_report.wide_factor());
+  EXPECT_EQ(2, table_report.min_slices());
+  EXPECT_EQ(2 * 4, table_report.full_slices());
+}
+
+// Tests an IFP table at the maximum key width.
+TEST_F(BcmAclResourceEstimatorTest, TestIngressKeyAtLimit) {
+  AddTableWithKeyWidths("acl_wide", P4Annotation::INGRESS_ACL,
+                        {160, 160, 160});
+  EXPECT_TRUE(Estimate());
+  EXPECT_EQ(0, ::errorCount());
+  ASSERT_EQ(1, report().physical_tables_size());
+  EXPECT_EQ(480, report().physical_tables(0).key_width());
+  EXPECT_EQ(3, report().physical_tables(0).wide_factor());
+}
+
+// Tests an IFP table one bit over the maximum key width.
+TEST_F(BcmAclResourceEstimatorTest, TestIngressKeyAboveLimit) {
+  AddTableWithKeyWidths("acl_wide", P4Annotation::INGRESS_ACL,
+                        {160, 160, 161});
+  EXPECT_FALSE(Estimate());
+  EXPECT_EQ(1, ::errorCount());
+  ASSERT_EQ(1, report().physical_tables_size());
+  EXPECT_EQ(4, report().physical_tables(0).wide_factor());
+}
+
+// Tests a VFP table one bit over its double-wide limit.
+TEST_F(BcmAclResourceEstimatorTest, TestVlanKeyAboveLimit) {
+  AddTableWithKeyWidths("vlan_acl", P4Annotation::VLAN_ACL, {234, 235});
+  EXPECT_FALSE(Estimate());
+  EXPECT_EQ(1, ::errorCount());
+}
+
+// Tests an IFP that uses all of its slices.
+TEST_F(BcmAclResourceEstimatorTest, TestIngressSlicesAtLimit) {
+  for (int i = 0; i < 12; ++i) {
+    AddTableWithKeyWidths(absl::StrCat("acl", i), P4Annotation::INGRESS_ACL,
+                          {160});
+  }
+  EXPECT_TRUE(Estimate());
+  EXPECT_EQ(0, ::errorCount());
+  EXPECT_EQ(12, report().physical_tables_size());
+  ASSERT_EQ(1, report().stages_size());
+  EXPECT_EQ(P4Annotation::INGRESS_ACL, report().stages(0).stage());
+  EXPECT_EQ(12, report().stages(0).min_slices());
+  EXPECT_EQ(12, report().stages(0).slices_available());
+}
+
+// Tests an IFP that needs one slice too many.
+TEST_F(BcmAclResourceEstimatorTest, TestIngressSlicesAboveLimit) {
+  for (int i = 0; i < 6; ++i) {
+    AddTableWithKeyWidths(absl::StrCat("acl_double", i),
+                          P4Annotation::INGRESS_ACL, {161});
+  }
+  AddTableWithKeyWidths("acl_single", P4Annotation::INGRESS_ACL, {1});
+  EXPECT_FALSE(Estimate());
+  EXPECT_EQ(1, ::errorCount());
+  ASSERT_EQ(1, report().stages_size());
+  EXPECT_EQ(13, report().stages(0).min_slices());
+}
+
+// Tests that table sizes beyond the TCAM capacity do not cause errors.
+TEST_F(BcmAclResourceEstimatorTest, TestTableSizeOverCapacity) {
+  AddTable("acl_big", P4Annotation::INGRESS_ACL, 12 * kSliceEntries + 1,
+           {{"hdr.ethernet.type", P4_FIELD_TYPE_ETH_TYPE, 16, 96}});
+  EXPECT_TRUE(Estimate());
+  EXPECT_EQ(0, ::errorCount());
+  ASSERT_EQ(1, report().stages_size());
+  EXPECT_EQ(1, report().stages(0).min_slices());
+  EXPECT_EQ(13, report().stages(0).full_slices());
+}
+
+// Tests a table that uses all chunks in a UDF set.
+TEST_F(BcmAclResourceEstimatorTest, TestUdfChunksAtSetLimit) {
+  AddUdfTable("acl_udf", {0, 32, 64, 96});
+  EXPECT_TRUE(Estimate());
+  EXPECT_EQ(0, ::errorCount());
+  ASSERT_EQ(1, report().physical_tables_size());
+  EXPECT_EQ(8, report().physical_tables(0).udf_chunks());
+  EXPECT_EQ(8 * 16, report().physical_tables(0).key_width());
+  EXPECT_EQ(8, report().udf_chunks_used());
+  EXPECT_EQ(16, report().udf_chunks_available());
+}
+
+// Tests a table that needs more chunks than a UDF set has.
+TEST_F(BcmAclResourceEstimatorTest, TestUdfChunksAboveSetLimit) {
+  AddUdfTable("acl_udf", {0, 32, 64, 104});
+  EXPECT_FALSE(Estimate());
+  EXPECT_EQ(1, ::errorCount());
+  EXPECT_EQ(9, report().physical_tables(0).udf_chunks());
+}
+
+// Tests that tables matching the same fields share UDF chunks.
+TEST_F(BcmAclResourceEstimatorTest, TestUdfChunksShared) {
+  AddUdfTable("acl_udf1", {0, 32, 64, 96});
+  AddUdfTable("acl_udf2", {0, 32, 64, 96});
+  AddUdfTable("acl_udf3", {0, 32, 64, 96});
+  EXPECT_TRUE(Estimate());
+  EXPECT_EQ(0, ::errorCount());
+  EXPECT_EQ(8, report().udf_chunks_used());
+}
+
+// Tests tables that need more UDF chunks than the chip has.
+TEST_F(BcmAclResourceEstimatorTest, TestUdfChunksAboveChipLimit) {
+  AddUdfTable("acl_udf1", {0, 32, 64});
+  AddUdfTable("acl_udf2", {96, 128, 160});
+  AddUdfTable("acl_udf3", {192, 224, 256});
+  EXPECT_FALSE(Estimate());
+  EXPECT_EQ(1, ::errorCount());
+  EXPECT_EQ(18, report().udf_chunks_used());
+}
+
+// Tests a table in a stage that the chip does not have.
+TEST_F(BcmAclResourceEstimatorTest, TestUnsupportedStage) {
+  chip_spec_.mutable_acl()->clear_field_processors();
+  AddTableWithKeyWidths("egress_acl", P4Annotation::EGRESS_ACL, {16});
+  EXPECT_FALSE(Estimate());
+  EXPECT_EQ(1, ::errorCount());
+}
+
+// Tests that tables outside the ACL stages are not estimated.
+TEST_F(BcmAclResourceEstimatorTest, TestNonAclTable) {
+  AddTableWithKeyWidths("l3_table", P4Annotation::L3_LPM, {1024});
+  EXPECT_TRUE(Estimate());
+  EXPECT_EQ(0, ::errorCount());
+  EXPECT_EQ(0, report().physical_tables_size());
+  EXPECT_EQ(0, report().stages_size());
+}
+
+}  // namespace p4c_backends
+}  // namespace stratum
@@ -5,8 +5,21 @@
 
 #include "stratum/p4c_backends/fpm/bcm/bcm_target_info.h"
 
+#include "external/com_github_p4lang_p4c/lib/error.h"
+#include "gflags/gflags.h"
+#include "stratum/glue/logging.h"
+#include "stratum/hal/lib/bcm/bcm.pb.h"
+#include "stratum/lib/utils.h"
+#include "stratum/p4c_backends/fpm/bcm/bcm_acl_resource_estimator.h"
 #include "stratum/public/proto/p4_annotation.pb.h"
 
+DEFINE_string(target_hardware_specs_file,
+              "stratum/hal/config/bcm_hardware_specs.pb.txt",
+              "Path to text file that defines the target chip models");
+DEFINE_string(target_chip_type, "",
+              "BcmChip type name of the target chip for resource estimates, "
+              "i.e. TOMAHAWK; no estimates are done when empty");
+
 namespace stratum {
 namespace p4c_backends {
 
@@ -27,5 +40,39 @@ bool BcmTargetInfo::IsPipelineStageFixed(
   return is_fixed;
 }
 
+bool BcmTargetInfo::EstimateResources(
+    const hal::P4InfoManager& p4_info_manager,
+    hal::P4PipelineConfig* p4_pipeline_config) {
+  if (FLAGS_target_chip_type.empty()) {
+    VLOG(1) << "Skipping ACL resource estimates without a target chip type";
+    return true;
+  }
+  hal::BcmChip::BcmChipType chip_type;
+  if (!hal::BcmChip::BcmChipType_Parse(FLAGS_target_chip_type, &chip_type)) {
+    ::error("Backend: Unknown target chip type %s",
+            FLAGS_target_chip_type.c_str());
+    return false;
+  }
+  hal::BcmHardwareSpecs hardware_specs;
+  ::util::Status status =
+      ReadProtoFromTextFile(FLAGS_target_hardware_specs_file, &hardware_specs);
+  if (!status.ok()) {
+    ::error("Backend: Unable to read target hardware specs from %s: %s",
+            FLAGS_target_hardware_specs_file.c_str(),
+            status.error_message().c_str());
+    return false;
+  }
+  for (const auto& chip_spec : hardware_specs.chip_specs()) {
+    if (chip_spec.chip_type() != chip_type) continue;
+    BcmAclResourceEstimator acl_estimator(chip_spec);
+    return acl_estimator.EstimateResources(p4_info_manager,
+                                           p4_pipeline_config);
+  }
+  ::error("Backend: Target hardware specs in %s have no %s chip model",
+          FLAGS_target_hardware_specs_file.c_str(),
+          FLAGS_target_chip_type.c_str());
+  return false;
+}
+
 }  // namespace p4c_backends
 }  // namespace stratum
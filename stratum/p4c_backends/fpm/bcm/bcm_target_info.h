@@ -19,6 +19,12 @@ class BcmTargetInfo : public TargetInfo {
   // This override returns true for BCM pipeline stages with fixed logic.
   bool IsPipelineStageFixed(P4Annotation::PipelineStage stage) const override;
 
+  // This override uses a BcmAclResourceEstimator to check the ACL tables
+  // against the chip model selected by the --target_chip_type flag.  It
+  // does nothing when the flag is empty.
+  bool EstimateResources(const hal::P4InfoManager& p4_info_manager,
+                         hal::P4PipelineConfig* p4_pipeline_config) override;
+
   // BcmTargetInfo is neither copyable nor movable.
   BcmTargetInfo(const BcmTargetInfo&) = delete;
   BcmTargetInfo& operator=(const BcmTargetInfo&) = delete;
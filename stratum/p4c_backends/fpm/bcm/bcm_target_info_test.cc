@@ -5,7 +5,12 @@
 
 #include "stratum/p4c_backends/fpm/bcm/bcm_target_info.h"
 
+#include "gflags/gflags.h"
 #include "gtest/gtest.h"
+#include "stratum/hal/lib/p4/p4_info_manager.h"
+#include "stratum/hal/lib/p4/p4_pipeline_config.pb.h"
+
+DECLARE_string(target_chip_type);
 
 namespace stratum {
 namespace p4c_backends {
@@ -32,5 +37,14 @@ TEST_F(BcmTargetInfoTest, TestNonFixedPipelineStages) {
       P4Annotation::DEFAULT_STAGE));
 }
 
+TEST_F(BcmTargetInfoTest, TestNoResourceEstimatesWithoutChipType) {
+  FLAGS_target_chip_type = "";
+  hal::P4InfoManager p4_info_manager((::p4::config::v1::P4Info()));
+  hal::P4PipelineConfig p4_pipeline_config;
+  EXPECT_TRUE(bcm_target_info_.EstimateResources(p4_info_manager,
+                                                 &p4_pipeline_config));
+  EXPECT_FALSE(p4_pipeline_config.has_acl_resource_report());
+}
+
 }  // namespace p4c_backends
 }  // namespace stratum
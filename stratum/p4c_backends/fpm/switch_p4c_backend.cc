@@ -26,6 +26,7 @@
 #include "stratum/p4c_backends/fpm/table_hit_inspector.h"
 #include "stratum/p4c_backends/fpm/table_map_generator.h"
 #include "stratum/p4c_backends/fpm/table_type_mapper.h"
+#include "stratum/p4c_backends/fpm/target_info.h"
 #include "stratum/p4c_backends/fpm/tunnel_type_mapper.h"
 #include "stratum/p4c_backends/fpm/utils.h"
 #include "absl/debugging/leak_check.h"
@@ -210,6 +211,11 @@ void SwitchP4cBackend::Compile(
   hidden_static_mapper.ProcessStaticEntries(
       hidden_table_mapper.action_redirects(), &output_pipeline_cfg);
 
+  // The target gets the last look at the output to make sure the program
+  // fits its hardware resources.
+  TargetInfo::GetSingleton()->EstimateResources(*p4_info_manager_,
+                                                &output_pipeline_cfg);
+
   // P4PipelineConfig output goes to the selected files, if any, after
   // all backend work completes error free.
   if (front_mid_interface_->GetErrorCount()) return;
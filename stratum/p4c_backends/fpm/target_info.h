@@ -10,6 +10,8 @@
 #ifndef STRATUM_P4C_BACKENDS_FPM_TARGET_INFO_H_
 #define STRATUM_P4C_BACKENDS_FPM_TARGET_INFO_H_
 
+#include "stratum/hal/lib/p4/p4_info_manager.h"
+#include "stratum/hal/lib/p4/p4_pipeline_config.pb.h"
 #include "stratum/public/proto/p4_annotation.pb.h"
 
 namespace stratum {
@@ -36,6 +38,17 @@ class TargetInfo {
   virtual bool IsPipelineStageFixed(
       P4Annotation::PipelineStage stage) const = 0;
 
+  // EstimateResources runs after the backend has produced the full
+  // p4_pipeline_config.  It evaluates the hardware resources that the P4
+  // program needs on the target, and it can add a report of its findings
+  // to p4_pipeline_config.  It reports any resources that exceed the target's
+  // limits via p4c's ::error and returns false.  The default implementation
+  // is for targets without resource models, and it always returns true.
+  virtual bool EstimateResources(const hal::P4InfoManager& p4_info_manager,
+                                 hal::P4PipelineConfig* p4_pipeline_config) {
+    return true;
+  }
+
  private:
   static TargetInfo* singleton_;  // Singleton instance of this class.
 };
@@ -0,0 +1,856 @@
+// Copyright 2021-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "stratum/tools/tv_runner/tv_runner.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <numeric>
+#include <random>
+#include <utility>
+
+#include "absl/cleanup/cleanup.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "absl/time/clock.h"
+#include "gflags/gflags.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/util/message_differencer.h"
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/hal/lib/p4/utils.h"
+#include "stratum/lib/macros.h"
+#include "stratum/lib/utils.h"
+
+DEFINE_int32(tv_timeout_ms, 5000,
+             "Deadline of each RPC of the TestVector runner, and timeout of "
+             "each streaming expectation, in milliseconds.");
+DEFINE_uint64(tv_random_seed, 0,
+              "Seed of the schedules of the randomized action groups. 0 "
+              "picks a random seed, which the report records.");
+DEFINE_int32(tv_random_max_delay_ms, 10,
+             "Maximum random delay before the start of an action of a "
+             "randomized action group, in milliseconds.");
+DEFINE_uint64(tv_device_id, 1,
+              "P4Runtime device ID of the packet-outs and packet-ins of the "
+              "test vectors.");
+DEFINE_string(tv_election_id, "0,1",
+              "Election ID (high,low) of the StreamChannel for packet I/O if "
+              "no write or pipeline push has opened it.");
+
+namespace stratum {
+namespace tools {
+namespace tv_runner {
+
+using ::google::stratum::testing::Action;
+using ::google::stratum::testing::ActionGroup;
+using ::google::stratum::testing::ConfigExpectation;
+using ::google::stratum::testing::ConfigOperation;
+using ::google::stratum::testing::ControlPlaneExpectation;
+using ::google::stratum::testing::ControlPlaneOperation;
+using ::google::stratum::testing::Expectation;
+using ::google::stratum::testing::TelemetryExpectation;
+using ::google::stratum::testing::TestCase;
+using ::google::stratum::testing::TestVector;
+using ::google::protobuf::Message;
+
+namespace {
+
+// Returns the deadline of an RPC that starts now.
+std::chrono::system_clock::time_point RpcDeadline() {
+  return std::chrono::system_clock::now() +
+         std::chrono::milliseconds(FLAGS_tv_timeout_ms);
+}
+
+absl::uint128 ToUint128(const ::p4::v1::Uint128& value) {
+  return absl::MakeUint128(value.high(), value.low());
+}
+
+::util::StatusOr<absl::uint128> ParseElectionId(const std::string& text) {
+  std::vector<std::string> parts = absl::StrSplit(text, ',');
+  uint64 high;
+  uint64 low;
+  RET_CHECK(parts.size() == 2 && absl::SimpleAtoi(parts[0], &high) &&
+            absl::SimpleAtoi(parts[1], &low))
+      << "Invalid election ID '" << text << "'.";
+  return absl::MakeUint128(high, low);
+}
+
+// Returns the name of the field that is set in a oneof of the message, or
+// "none" if the oneof is empty.
+std::string OneofCaseName(const Message& message, const std::string& oneof) {
+  const auto* oneof_descriptor =
+      message.GetDescriptor()->FindOneofByName(oneof);
+  const auto* field = message.GetReflection()->GetOneofFieldDescriptor(
+      message, oneof_descriptor);
+  return field != nullptr ? field->name() : "none";
+}
+
+// Returns the name of the action, using the operation name for control plane
+// operations.
+std::string ActionType(const Action& action) {
+  if (action.has_control_plane_operation()) {
+    return OneofCaseName(action.control_plane_operation(), "operations");
+  }
+  return OneofCaseName(action, "actions");
+}
+
+// Returns the name of the expectation, using the inner name for control
+// plane expectations.
+std::string ExpectationType(const Expectation& expectation) {
+  if (expectation.has_control_plane_expectation()) {
+    return OneofCaseName(expectation.control_plane_expectation(),
+                         "expectations");
+  }
+  return OneofCaseName(expectation, "expectations");
+}
+
+::util::Status P4RuntimeError(const ::grpc::Status& status,
+                              const std::string& rpc) {
+  return MAKE_ERROR(ERR_INTERNAL).without_logging()
+         << rpc << " failed: " << hal::P4RuntimeGrpcStatusToString(status);
+}
+
+::util::Status GnmiError(const ::grpc::Status& status,
+                         const std::string& rpc) {
+  return MAKE_ERROR(ERR_INTERNAL).without_logging()
+         << rpc << " failed with code " << status.error_code() << ": "
+         << status.error_message();
+}
+
+// Returns the differences between the expected and the actual message, or
+// an empty string if they are equal.
+std::string Diff(const Message& expected, const Message& actual) {
+  std::string diff;
+  {
+    // The reporter flushes to the string when the differencer is destroyed.
+    ::google::protobuf::util::MessageDifferencer differencer;
+    differencer.ReportDifferencesToString(&diff);
+    differencer.Compare(expected, actual);
+  }
+  return diff;
+}
+
+// Returns a key that is equal for equal messages.
+std::string DeterministicKey(const Message& message) {
+  std::string key;
+  {
+    ::google::protobuf::io::StringOutputStream output(&key);
+    ::google::protobuf::io::CodedOutputStream coded_output(&output);
+    coded_output.SetSerializationDeterministic(true);
+    message.SerializeToCodedStream(&coded_output);
+  }
+  return key;
+}
+
+// The gNMI timestamps change on every run, so they are not compared.
+void ClearTimestamps(::gnmi::SetResponse* resp) { resp->set_timestamp(0); }
+
+void ClearTimestamps(::gnmi::GetResponse* resp) {
+  for (auto& notification : *resp->mutable_notification()) {
+    notification.set_timestamp(0);
+  }
+}
+
+void ClearTimestamps(::gnmi::SubscribeResponse* resp) {
+  if (resp->has_update()) resp->mutable_update()->set_timestamp(0);
+}
+
+}  // namespace
+
+TestVectorRunner::TestVectorRunner(
+    std::shared_ptr<::grpc::ChannelInterface> channel, uint64 random_seed)
+    : p4_stub_(::p4::v1::P4Runtime::NewStub(channel)),
+      gnmi_stub_(::gnmi::gNMI::NewStub(channel)),
+      random_seed_(random_seed) {}
+
+TestVectorRunner::~TestVectorRunner() { CloseStreams(); }
+
+std::unique_ptr<TestVectorRunner> TestVectorRunner::CreateInstance(
+    std::shared_ptr<::grpc::ChannelInterface> channel) {
+  uint64 random_seed = FLAGS_tv_random_seed;
+  if (random_seed == 0) {
+    std::random_device random_device;
+    random_seed = (static_cast<uint64>(random_device()) << 32) |
+                  static_cast<uint64>(random_device());
+  }
+  return absl::WrapUnique(new TestVectorRunner(channel, random_seed));
+}
+
+TestVectorReport TestVectorRunner::Run(const TestVector& vector) {
+  TestVectorReport report;
+  report.set_random_seed(random_seed_);
+  bool passed = true;
+  for (const auto& test_case : vector.test_cases()) {
+    TestCaseReport* test_case_report = report.add_test_cases();
+    *test_case_report = RunTestCase(test_case);
+    if (test_case_report->result() == FAILED) passed = false;
+  }
+  CloseStreams();
+  report.set_result(passed ? PASSED : FAILED);
+
+  // Summarizes the latencies of all executed actions by action type.
+  std::map<std::string, std::vector<int64>> latencies;
+  auto add_latencies = [&latencies](
+      const ::google::protobuf::RepeatedPtrField<ActionReport>& actions) {
+    for (const auto& action : actions) {
+      if (action.result() == SKIPPED) continue;
+      latencies[action.action_type()].push_back(action.latency_us());
+    }
+  };
+  for (const auto& test_case : report.test_cases()) {
+    add_latencies(test_case.actions());
+    for (const auto& expectation : test_case.expectations()) {
+      add_latencies(expectation.actions());
+    }
+  }
+  for (auto& e : latencies) {
+    std::vector<int64>& values = e.second;
+    std::sort(values.begin(), values.end());
+    // Nearest-rank percentiles.
+    auto percentile = [&values](size_t p) {
+      return values[(values.size() * p + 99) / 100 - 1];
+    };
+    LatencySummary* summary = report.add_latencies();
+    summary->set_action_type(e.first);
+    summary->set_count(values.size());
+    summary->set_min_us(values.front());
+    summary->set_mean_us(std::accumulate(values.begin(), values.end(),
+                                         int64{0}) /
+                         static_cast<int64>(values.size()));
+    summary->set_p50_us(percentile(50));
+    summary->set_p99_us(percentile(99));
+    summary->set_max_us(values.back());
+  }
+
+  return report;
+}
+
+TestCaseReport TestVectorRunner::RunTestCase(const TestCase& test_case) {
+  TestCaseReport report;
+  report.set_test_case_id(test_case.test_case_id());
+  std::vector<ActionReport> actions;
+  // The schedule keys are the positions of the groups in the test case.
+  for (int i = 0; i < test_case.action_groups_size(); ++i) {
+    RunActionGroup(test_case.action_groups(i),
+                   absl::StrCat(test_case.test_case_id(), "/action_groups/", i),
+                   &actions);
+  }
+  bool action_failed = false;
+  for (auto& action : actions) {
+    if (action.result() == FAILED) action_failed = true;
+    *report.add_actions() = std::move(action);
+  }
+
+  bool passed = !action_failed;
+  for (int i = 0; i < test_case.expectations_size(); ++i) {
+    const Expectation& expectation = test_case.expectations(i);
+    ExpectationReport* expectation_report = report.add_expectations();
+    expectation_report->set_expectation_id(expectation.expectation_id());
+    expectation_report->set_expectation_type(ExpectationType(expectation));
+    if (action_failed) {
+      expectation_report->set_result(SKIPPED);
+      expectation_report->set_error("An action of the test case failed.");
+      continue;
+    }
+    CheckExpectation(
+        expectation,
+        absl::StrCat(test_case.test_case_id(), "/expectations/", i),
+        expectation_report);
+    if (expectation_report->result() == FAILED) passed = false;
+  }
+  report.set_result(passed ? PASSED : FAILED);
+  LOG(INFO) << "Test case " << test_case.test_case_id() << ": "
+            << Result_Name(report.result()) << ".";
+
+  return report;
+}
+
+void TestVectorRunner::RunActionGroup(const ActionGroup& group,
+                                      const std::string& schedule_key,
+                                      std::vector<ActionReport>* reports) {
+  const ::google::protobuf::RepeatedPtrField<Action>* actions = nullptr;
+  switch (group.action_group_case()) {
+    case ActionGroup::kSequentialActionGroup:
+      actions = &group.sequential_action_group().actions();
+      break;
+    case ActionGroup::kParallelActionGroup:
+      actions = &group.parallel_action_group().actions();
+      break;
+    case ActionGroup::kRandomizedActionGroup:
+      actions = &group.randomized_action_group().actions();
+      break;
+    default:
+      LOG(WARNING) << "Action group " << group.action_group_id()
+                   << " has no actions.";
+      return;
+  }
+
+  // Each action writes to its own report, so the concurrent actions need
+  // no lock.
+  std::vector<ActionReport> group_reports(actions->size());
+  for (int i = 0; i < actions->size(); ++i) {
+    group_reports[i].set_action_group_id(group.action_group_id());
+    group_reports[i].set_action_index(i);
+  }
+  std::vector<std::thread> threads;
+  switch (group.action_group_case()) {
+    case ActionGroup::kSequentialActionGroup:
+      for (int i = 0; i < actions->size(); ++i) {
+        RunAction(actions->Get(i), &group_reports[i]);
+      }
+      break;
+    case ActionGroup::kParallelActionGroup:
+      for (int i = 0; i < actions->size(); ++i) {
+        threads.emplace_back([this, actions, i, &group_reports]() {
+          RunAction(actions->Get(i), &group_reports[i]);
+        });
+      }
+      break;
+    case ActionGroup::kRandomizedActionGroup: {
+      std::vector<int> order;
+      std::vector<absl::Duration> delays;
+      MakeSchedule(schedule_key, actions->size(), &order, &delays);
+      for (int k = 0; k < actions->size(); ++k) {
+        const int i = order[k];
+        const absl::Duration delay = delays[k];
+        group_reports[i].set_start_delay_us(absl::ToInt64Microseconds(delay));
+        threads.emplace_back([this, actions, i, delay, &group_reports]() {
+          absl::SleepFor(delay);
+          RunAction(actions->Get(i), &group_reports[i]);
+        });
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  for (auto& thread : threads) thread.join();
+
+  for (auto& report : group_reports) reports->push_back(std::move(report));
+}
+
+void TestVectorRunner::RunAction(const Action& action, ActionReport* report) {
+  report->set_action_type(ActionType(action));
+  const absl::Time start = absl::Now();
+  ::util::Status status;
+  if (action.has_config_operation()) {
+    status = RunConfigOperation(action.config_operation());
+  } else if (action.has_control_plane_operation()) {
+    const auto& op = action.control_plane_operation();
+    switch (op.operations_case()) {
+      case ControlPlaneOperation::kWriteOperation:
+        status = RunWriteOperation(op.write_operation());
+        break;
+      case ControlPlaneOperation::kPipelineConfigOperation:
+        status = RunPipelineConfigOperation(op.pipeline_config_operation());
+        break;
+      case ControlPlaneOperation::kPacketOutOperation:
+        status = RunPacketOutOperation(op.packet_out_operation());
+        break;
+      default:
+        status = MAKE_ERROR(ERR_UNIMPLEMENTED).without_logging()
+                 << "Empty control plane operation.";
+        break;
+    }
+  } else {
+    status = MAKE_ERROR(ERR_UNIMPLEMENTED).without_logging()
+             << "Unsupported action type " << report->action_type() << ".";
+  }
+  report->set_latency_us(absl::ToInt64Microseconds(absl::Now() - start));
+
+  if (status.error_code() == ERR_UNIMPLEMENTED) {
+    report->set_result(SKIPPED);
+    report->set_error(status.error_message());
+  } else if (!status.ok()) {
+    report->set_result(FAILED);
+    report->set_error(status.error_message());
+    LOG(ERROR) << "Action " << report->action_index() << " of action group "
+               << report->action_group_id() << " failed: "
+               << status.error_message();
+  } else {
+    report->set_result(PASSED);
+  }
+}
+
+::util::Status TestVectorRunner::RunConfigOperation(
+    const ConfigOperation& op) {
+  ::grpc::ClientContext context;
+  context.set_deadline(RpcDeadline());
+  ::gnmi::SetResponse resp;
+  ::grpc::Status status =
+      gnmi_stub_->Set(&context, op.gnmi_set_request(), &resp);
+  if (!status.ok()) return GnmiError(status, "Set");
+  if (op.has_gnmi_set_response()) {
+    ::gnmi::SetResponse expected = op.gnmi_set_response();
+    ClearTimestamps(&expected);
+    ClearTimestamps(&resp);
+    std::string diff = Diff(expected, resp);
+    if (!diff.empty()) {
+      return MAKE_ERROR(ERR_INTERNAL).without_logging()
+             << "Unexpected SetResponse:\n" << diff;
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
+// The WriteResponse and SetForwardingPipelineConfigResponse messages have no
+// fields, so only the RPC status of these operations is checked.
+::util::Status TestVectorRunner::RunWriteOperation(
+    const ControlPlaneOperation::WriteOperation& op) {
+  const ::p4::v1::WriteRequest& req = op.p4_write_request();
+  // Requests without device or election ID are sent as is, for the switch
+  // to reject them.
+  if (req.device_id() != 0 && ToUint128(req.election_id()) != 0) {
+    RETURN_IF_ERROR(
+        GetOrOpenStream(req.device_id(), ToUint128(req.election_id()))
+            .status());
+  }
+  ::grpc::ClientContext context;
+  context.set_deadline(RpcDeadline());
+  ::p4::v1::WriteResponse resp;
+  ::grpc::Status status = p4_stub_->Write(&context, req, &resp);
+  if (!status.ok()) return P4RuntimeError(status, "Write");
+
+  return ::util::OkStatus();
+}
+
+::util::Status TestVectorRunner::RunPipelineConfigOperation(
+    const ControlPlaneOperation::PipelineConfigOperation& op) {
+  const ::p4::v1::SetForwardingPipelineConfigRequest& req =
+      op.p4_set_pipeline_config_request();
+  if (req.device_id() != 0 && ToUint128(req.election_id()) != 0) {
+    RETURN_IF_ERROR(
+        GetOrOpenStream(req.device_id(), ToUint128(req.election_id()))
+            .status());
+  }
+  ::grpc::ClientContext context;
+  context.set_deadline(RpcDeadline());
+  ::p4::v1::SetForwardingPipelineConfigResponse resp;
+  ::grpc::Status status =
+      p4_stub_->SetForwardingPipelineConfig(&context, req, &resp);
+  if (!status.ok()) {
+    return P4RuntimeError(status, "SetForwardingPipelineConfig");
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status TestVectorRunner::RunPacketOutOperation(
+    const ControlPlaneOperation::PacketOutOperation& op) {
+  if (op.num_of_packets() < 0) {
+    return MAKE_ERROR(ERR_UNIMPLEMENTED).without_logging()
+           << "Continuous packet-outs are not supported.";
+  }
+  ASSIGN_OR_RETURN(absl::uint128 election_id,
+                   ParseElectionId(FLAGS_tv_election_id));
+  ASSIGN_OR_RETURN(DeviceStream * device_stream,
+                   GetOrOpenStream(FLAGS_tv_device_id, election_id));
+  ::p4::v1::StreamMessageRequest req;
+  *req.mutable_packet() = op.p4_packet_out();
+  // The speed and CoS of the packets are not controlled.
+  const int64 num_packets = std::max<int64>(op.num_of_packets(), 1);
+  absl::MutexLock l(&device_stream->write_lock);
+  for (int64 i = 0; i < num_packets; ++i) {
+    if (!device_stream->stream->Write(req)) {
+      return MAKE_ERROR(ERR_INTERNAL).without_logging()
+             << "Failed to send packet-out " << i
+             << " on the StreamChannel of device " << FLAGS_tv_device_id
+             << ".";
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
+void TestVectorRunner::CheckExpectation(const Expectation& expectation,
+                                        const std::string& schedule_key,
+                                        ExpectationReport* report) {
+  std::string diff;
+  ::util::Status status;
+  if (expectation.has_config_expectation()) {
+    status = CheckConfigExpectation(expectation.config_expectation(), &diff);
+  } else if (expectation.has_control_plane_expectation()) {
+    const auto& exp = expectation.control_plane_expectation();
+    switch (exp.expectations_case()) {
+      case ControlPlaneExpectation::kReadExpectation:
+        status = CheckReadExpectation(exp.read_expectation(), &diff);
+        break;
+      case ControlPlaneExpectation::kPipelineConfigExpectation:
+        status = CheckPipelineConfigExpectation(
+            exp.pipeline_config_expectation(), &diff);
+        break;
+      case ControlPlaneExpectation::kPacketInExpectation:
+        status = CheckPacketInExpectation(exp.packet_in_expectation(), &diff);
+        break;
+      default:
+        status = MAKE_ERROR(ERR_UNIMPLEMENTED).without_logging()
+                 << "Empty control plane expectation.";
+        break;
+    }
+  } else if (expectation.has_telemetry_expectation()) {
+    status = CheckTelemetryExpectation(
+        schedule_key, expectation.telemetry_expectation(), report, &diff);
+  } else {
+    status = MAKE_ERROR(ERR_UNIMPLEMENTED).without_logging()
+             << "Unsupported expectation type " << report->expectation_type()
+             << ".";
+  }
+
+  if (status.error_code() == ERR_UNIMPLEMENTED) {
+    report->set_result(SKIPPED);
+    report->set_error(status.error_message());
+  } else if (!status.ok()) {
+    report->set_result(FAILED);
+    report->set_error(status.error_message());
+  } else if (!diff.empty()) {
+    report->set_result(FAILED);
+    report->set_error("The response does not match the expected response.");
+    report->set_diff(diff);
+  } else {
+    report->set_result(PASSED);
+  }
+  if (report->result() == FAILED) {
+    LOG(ERROR) << "Expectation " << report->expectation_id()
+               << " failed: " << report->error() << "\n"
+               << report->diff();
+  }
+}
+
+::util::Status TestVectorRunner::CheckConfigExpectation(
+    const ConfigExpectation& exp, std::string* diff) {
+  ::grpc::ClientContext context;
+  context.set_deadline(RpcDeadline());
+  ::gnmi::GetResponse resp;
+  ::grpc::Status status =
+      gnmi_stub_->Get(&context, exp.gnmi_get_request(), &resp);
+  if (!status.ok()) return GnmiError(status, "Get");
+  ::gnmi::GetResponse expected = exp.gnmi_get_response();
+  ClearTimestamps(&expected);
+  ClearTimestamps(&resp);
+  *diff = Diff(expected, resp);
+
+  return ::util::OkStatus();
+}
+
+::util::Status TestVectorRunner::CheckReadExpectation(
+    const ControlPlaneExpectation::ReadExpectation& exp, std::string* diff) {
+  ::grpc::ClientContext context;
+  context.set_deadline(RpcDeadline());
+  auto reader = p4_stub_->Read(&context, exp.p4_read_request());
+  // The switch may return the entities in any order and split them over any
+  // number of responses, so they are compared as a multiset.
+  std::multimap<std::string, ::p4::v1::Entity> actual;
+  ::p4::v1::ReadResponse resp;
+  while (reader->Read(&resp)) {
+    for (const auto& entity : resp.entities()) {
+      actual.emplace(DeterministicKey(entity), entity);
+    }
+  }
+  ::grpc::Status status = reader->Finish();
+  if (!status.ok()) return P4RuntimeError(status, "Read");
+
+  std::vector<std::string> diffs;
+  for (const auto& expected_resp : exp.p4_read_responses()) {
+    for (const auto& entity : expected_resp.entities()) {
+      auto it = actual.find(DeterministicKey(entity));
+      if (it == actual.end()) {
+        diffs.push_back(absl::StrCat("missing: ", entity.ShortDebugString()));
+      } else {
+        actual.erase(it);
+      }
+    }
+  }
+  for (const auto& e : actual) {
+    diffs.push_back(absl::StrCat("unexpected: ", e.second.ShortDebugString()));
+  }
+  *diff = absl::StrJoin(diffs, "\n");
+
+  return ::util::OkStatus();
+}
+
+::util::Status TestVectorRunner::CheckPipelineConfigExpectation(
+    const ControlPlaneExpectation::PipelineConfigExpectation& exp,
+    std::string* diff) {
+  ::grpc::ClientContext context;
+  context.set_deadline(RpcDeadline());
+  ::p4::v1::GetForwardingPipelineConfigResponse resp;
+  ::grpc::Status status = p4_stub_->GetForwardingPipelineConfig(
+      &context, exp.p4_get_pipeline_config_request(), &resp);
+  if (!status.ok()) {
+    return P4RuntimeError(status, "GetForwardingPipelineConfig");
+  }
+  *diff = Diff(exp.p4_get_pipeline_config_response(), resp);
+
+  return ::util::OkStatus();
+}
+
+::util::Status TestVectorRunner::CheckPacketInExpectation(
+    const ControlPlaneExpectation::PacketInExpectation& exp,
+    std::string* diff) {
+  if (exp.num_of_packets() < 0) {
+    return MAKE_ERROR(ERR_UNIMPLEMENTED).without_logging()
+           << "Continuous packet-ins are not supported.";
+  }
+  DeviceStream* device_stream = FindStream(FLAGS_tv_device_id);
+  if (device_stream == nullptr) {
+    return MAKE_ERROR(ERR_INTERNAL).without_logging()
+           << "No StreamChannel is open for device " << FLAGS_tv_device_id
+           << ".";
+  }
+  const int64 num_packets = std::max<int64>(exp.num_of_packets(), 1);
+  const absl::Time deadline =
+      absl::Now() + absl::Milliseconds(FLAGS_tv_timeout_ms);
+  int64 num_matched = 0;
+  bool timed_out = false;
+  absl::MutexLock l(&device_stream->lock);
+  while (true) {
+    // Takes the matching packets off the queue and leaves the others for
+    // later expectations.
+    auto& packets = device_stream->packets;
+    for (auto it = packets.begin();
+         it != packets.end() && num_matched < num_packets;) {
+      if (ProtoEqual(*it, exp.p4_packet_in())) {
+        it = packets.erase(it);
+        ++num_matched;
+      } else {
+        ++it;
+      }
+    }
+    if (num_matched == num_packets || device_stream->closed || timed_out) {
+      break;
+    }
+    timed_out =
+        device_stream->changed.WaitWithDeadline(&device_stream->lock, deadline);
+  }
+  if (num_matched < num_packets) {
+    *diff = absl::StrCat("received ", num_matched, " of ", num_packets,
+                         " packet-ins ", exp.p4_packet_in().ShortDebugString(),
+                         ", with ", device_stream->packets.size(),
+                         " other packet-ins pending");
+  }
+
+  return ::util::OkStatus();
+}
+
+::util::Status TestVectorRunner::CheckTelemetryExpectation(
+    const std::string& schedule_key, const TelemetryExpectation& exp,
+    ExpectationReport* report, std::string* diff) {
+  // The responses that the reader thread reads from the subscription.
+  struct Subscription {
+    absl::Mutex lock;
+    absl::CondVar changed;
+    std::vector<::gnmi::SubscribeResponse> responses GUARDED_BY(lock);
+    bool closed GUARDED_BY(lock) = false;
+  } subscription;
+
+  ::grpc::ClientContext context;
+  auto stream = gnmi_stub_->Subscribe(&context);
+  // The reader starts before the request is sent, as tv.proto requires.
+  std::thread reader([&stream, &subscription]() {
+    ::gnmi::SubscribeResponse resp;
+    while (stream->Read(&resp)) {
+      absl::MutexLock l(&subscription.lock);
+      subscription.responses.push_back(resp);
+      subscription.changed.Signal();
+    }
+    absl::MutexLock l(&subscription.lock);
+    subscription.closed = true;
+    subscription.changed.Signal();
+  });
+  // The subscription is cancelled on every return.
+  auto cleaner = absl::MakeCleanup([&context, &reader, &stream]() {
+    context.TryCancel();
+    reader.join();
+    stream->Finish();
+  });
+
+  if (!stream->Write(exp.gnmi_subscribe_request())) {
+    return MAKE_ERROR(ERR_INTERNAL).without_logging()
+           << "Failed to send the SubscribeRequest.";
+  }
+  if (exp.has_action_group()) {
+    std::vector<ActionReport> actions;
+    RunActionGroup(exp.action_group(), schedule_key, &actions);
+    bool action_failed = false;
+    for (auto& action : actions) {
+      if (action.result() == FAILED) action_failed = true;
+      *report->add_actions() = std::move(action);
+    }
+    if (action_failed) {
+      return MAKE_ERROR(ERR_INTERNAL).without_logging()
+             << "An action of the telemetry expectation failed.";
+    }
+  }
+
+  const int num_expected = exp.gnmi_subscribe_response_size();
+  const absl::Time deadline =
+      absl::Now() + absl::Milliseconds(FLAGS_tv_timeout_ms);
+  std::vector<::gnmi::SubscribeResponse> responses;
+  {
+    absl::MutexLock l(&subscription.lock);
+    bool timed_out = false;
+    while (subscription.responses.size() < static_cast<size_t>(num_expected) &&
+           !subscription.closed && !timed_out) {
+      timed_out =
+          subscription.changed.WaitWithDeadline(&subscription.lock, deadline);
+    }
+    responses = subscription.responses;
+  }
+
+  // The expected responses must be the first ones, in order.  Any later
+  // responses are ignored.
+  std::vector<std::string> diffs;
+  for (int i = 0; i < num_expected; ++i) {
+    ::gnmi::SubscribeResponse expected = exp.gnmi_subscribe_response(i);
+    if (i >= static_cast<int>(responses.size())) {
+      diffs.push_back(absl::StrCat("missing response ", i, ": ",
+                                   expected.ShortDebugString()));
+      continue;
+    }
+    ClearTimestamps(&expected);
+    ClearTimestamps(&responses[i]);
+    std::string response_diff = Diff(expected, responses[i]);
+    if (!response_diff.empty()) {
+      diffs.push_back(absl::StrCat("response ", i, ":\n", response_diff));
+    }
+  }
+  *diff = absl::StrJoin(diffs, "\n");
+
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<TestVectorRunner::DeviceStream*>
+TestVectorRunner::GetOrOpenStream(uint64 device_id,
+                                  absl::uint128 election_id) {
+  DeviceStream* s = nullptr;
+  bool opened = false;
+  {
+    absl::MutexLock l(&streams_lock_);
+    auto it = streams_.find(device_id);
+    if (it != streams_.end()) {
+      s = it->second.get();
+    } else {
+      // The stream is kept even if the arbitration fails, so that
+      // CloseStreams joins its reader and the later calls get the error.
+      auto& device_stream = streams_[device_id];
+      device_stream = absl::make_unique<DeviceStream>();
+      s = device_stream.get();
+      s->stream = p4_stub_->StreamChannel(&s->context);
+      s->reader = std::thread([s]() {
+        ::p4::v1::StreamMessageResponse resp;
+        while (s->stream->Read(&resp)) {
+          absl::MutexLock l(&s->lock);
+          if (resp.has_arbitration()) {
+            s->arbitrated = true;
+          } else if (resp.has_packet()) {
+            s->packets.push_back(resp.packet());
+          }
+          s->changed.Signal();
+        }
+        absl::MutexLock l(&s->lock);
+        s->closed = true;
+        s->changed.Signal();
+      });
+      opened = true;
+    }
+  }
+  // Only the call that opened the stream arbitrates, and it does so without
+  // streams_lock_, so that the actions on other devices are not blocked.
+  if (opened) {
+    s->arbitration_status = Arbitrate(s, device_id, election_id);
+    s->arbitration_done.Notify();
+  }
+  s->arbitration_done.WaitForNotification();
+  if (!s->arbitration_status.ok()) return s->arbitration_status;
+
+  return s;
+}
+
+::util::Status TestVectorRunner::Arbitrate(DeviceStream* s, uint64 device_id,
+                                           absl::uint128 election_id) {
+  ::p4::v1::StreamMessageRequest req;
+  req.mutable_arbitration()->set_device_id(device_id);
+  req.mutable_arbitration()->mutable_election_id()->set_high(
+      absl::Uint128High64(election_id));
+  req.mutable_arbitration()->mutable_election_id()->set_low(
+      absl::Uint128Low64(election_id));
+  bool sent;
+  {
+    absl::MutexLock wl(&s->write_lock);
+    sent = s->stream->Write(req);
+  }
+  if (!sent) {
+    return MAKE_ERROR(ERR_INTERNAL).without_logging()
+           << "Failed to send the arbitration request for device "
+           << device_id << ".";
+  }
+  const absl::Time deadline =
+      absl::Now() + absl::Milliseconds(FLAGS_tv_timeout_ms);
+  absl::MutexLock l(&s->lock);
+  bool timed_out = false;
+  while (!s->arbitrated && !s->closed && !timed_out) {
+    timed_out = s->changed.WaitWithDeadline(&s->lock, deadline);
+  }
+  if (!s->arbitrated) {
+    return MAKE_ERROR(ERR_INTERNAL).without_logging()
+           << "No arbitration response from device " << device_id << ".";
+  }
+
+  return ::util::OkStatus();
+}
+
+TestVectorRunner::DeviceStream* TestVectorRunner::FindStream(
+    uint64 device_id) {
+  absl::MutexLock l(&streams_lock_);
+  auto it = streams_.find(device_id);
+  return it != streams_.end() ? it->second.get() : nullptr;
+}
+
+void TestVectorRunner::CloseStreams() {
+  std::map<uint64, std::unique_ptr<DeviceStream>> streams;
+  {
+    absl::MutexLock l(&streams_lock_);
+    streams.swap(streams_);
+  }
+  for (auto& e : streams) {
+    DeviceStream* s = e.second.get();
+    {
+      absl::MutexLock l(&s->write_lock);
+      s->stream->WritesDone();
+    }
+    s->context.TryCancel();
+    s->reader.join();
+    s->stream->Finish();
+  }
+}
+
+void TestVectorRunner::MakeSchedule(const std::string& schedule_key, int n,
+                                    std::vector<int>* order,
+                                    std::vector<absl::Duration>* delays) const {
+  // The generator depends only on the seed and the key, so that concurrent
+  // groups replay the same schedules whatever order they run in.
+  std::vector<uint32> seed_data = {static_cast<uint32>(random_seed_ >> 32),
+                                   static_cast<uint32>(random_seed_)};
+  for (char c : schedule_key) seed_data.push_back(static_cast<uint8>(c));
+  std::seed_seq seed(seed_data.begin(), seed_data.end());
+  std::mt19937_64 random(seed);
+  order->resize(n);
+  std::iota(order->begin(), order->end(), 0);
+  std::shuffle(order->begin(), order->end(), random);
+  delays->clear();
+  std::uniform_int_distribution<int64> delay_us(
+      0, int64{FLAGS_tv_random_max_delay_ms} * 1000);
+  for (int i = 0; i < n; ++i) {
+    delays->push_back(absl::Microseconds(delay_us(random)));
+  }
+}
+
+}  // namespace tv_runner
+}  // namespace tools
+}  // namespace stratum
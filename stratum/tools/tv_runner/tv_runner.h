@@ -0,0 +1,207 @@
+// Copyright 2021-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+// The TestVectorRunner executes TestVector suites (see
+// stratum/public/proto/tv.proto) against the P4Runtime and gNMI services of
+// a Stratum switch.
+
+#ifndef STRATUM_TOOLS_TV_RUNNER_TV_RUNNER_H_
+#define STRATUM_TOOLS_TV_RUNNER_TV_RUNNER_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/numeric/int128.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "gnmi/gnmi.grpc.pb.h"
+#include "grpcpp/grpcpp.h"
+#include "p4/v1/p4runtime.grpc.pb.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
+#include "stratum/public/proto/tv.pb.h"
+#include "stratum/tools/tv_runner/tv_runner.pb.h"
+
+namespace stratum {
+namespace tools {
+namespace tv_runner {
+
+// A TestVectorRunner runs the test cases of a TestVector in order.  For each
+// test case, it runs the action groups one after another and then checks the
+// expectations:
+//  - The actions of a sequential group run one at a time, in order.
+//  - The actions of a parallel group all start at once, each in its own
+//    thread, and the group completes when the last one completes.
+//  - The actions of a randomized group also run concurrently, but they start
+//    in a shuffled order, each after a random delay of up to
+//    --tv_random_max_delay_ms.  Each group draws its shuffle and delays
+//    from its own generator, seeded from the run seed and the position of
+//    the group in the vector, so the schedule of a group does not depend
+//    on the groups that run before or beside it.  The report records the
+//    seed so a failing schedule can be replayed with --tv_random_seed.
+// If an action of a test case fails, the expectations of the test case are
+// skipped, as tv.proto requires.
+//
+// The runner supports the P4Runtime and gNMI operations and expectations.
+// An action passes if its RPC succeeds and its response matches the expected
+// one, if the vector has any.  Writes, pipeline pushes and packet-outs share
+// one StreamChannel per device.  The runner opens it with the election ID of
+// the first request for the device and keeps it open until the vector
+// completes, so that it stays master and queues the packet-ins for the
+// PacketInExpectations.  Data plane, port, alarm and management actions need
+// an external test harness, and the runner reports them as SKIPPED.
+//
+// The report contains the outcome and the latency of each action, and the
+// differences for each failed expectation.  Read results are compared as
+// unordered sets of entities, and gNMI notifications are compared without
+// their timestamps.
+class TestVectorRunner {
+ public:
+  virtual ~TestVectorRunner();
+
+  // Runs all the test cases of the test vector and returns the report.
+  TestVectorReport Run(const ::google::stratum::testing::TestVector& vector)
+      LOCKS_EXCLUDED(streams_lock_);
+
+  // Creates a runner for the switch behind the given gRPC channel.  The
+  // randomized groups use the seed from --tv_random_seed, or a random seed
+  // if the flag is 0.
+  static std::unique_ptr<TestVectorRunner> CreateInstance(
+      std::shared_ptr<::grpc::ChannelInterface> channel);
+
+  // TestVectorRunner is neither copyable nor movable.
+  TestVectorRunner(const TestVectorRunner&) = delete;
+  TestVectorRunner& operator=(const TestVectorRunner&) = delete;
+
+ private:
+  // The StreamChannel of one device.  The reader thread consumes all stream
+  // responses and keeps the packet-ins until an expectation takes them.
+  struct DeviceStream {
+    ::grpc::ClientContext context;
+    std::unique_ptr<::grpc::ClientReaderWriter<
+        ::p4::v1::StreamMessageRequest, ::p4::v1::StreamMessageResponse>>
+        stream;
+    std::thread reader;
+    // Serializes the writes to the stream of the concurrent actions.
+    absl::Mutex write_lock;
+    absl::Mutex lock;
+    // Signaled on each response and when the stream closes.
+    absl::CondVar changed;
+    bool arbitrated GUARDED_BY(lock) = false;
+    bool closed GUARDED_BY(lock) = false;
+    std::vector<::p4::v1::PacketIn> packets GUARDED_BY(lock);
+    // Notified once the arbitration completed or failed.  The status is set
+    // before the notification and never changes after it.
+    absl::Notification arbitration_done;
+    ::util::Status arbitration_status;
+  };
+
+  // Private constructor. Use CreateInstance() to create an instance.
+  TestVectorRunner(std::shared_ptr<::grpc::ChannelInterface> channel,
+                   uint64 random_seed);
+
+  // Runs one test case.
+  TestCaseReport RunTestCase(const ::google::stratum::testing::TestCase& tc);
+
+  // Runs the actions of an action group according to the group type and
+  // appends one report per action to reports.  The schedule key identifies
+  // the group within the vector and seeds the schedule of randomized groups.
+  void RunActionGroup(const ::google::stratum::testing::ActionGroup& group,
+                      const std::string& schedule_key,
+                      std::vector<ActionReport>* reports);
+
+  // Runs one action and fills the result, error and latency of the report.
+  void RunAction(const ::google::stratum::testing::Action& action,
+                 ActionReport* report);
+
+  // The handlers for each supported action.  They return an error if the
+  // action failed.
+  ::util::Status RunConfigOperation(
+      const ::google::stratum::testing::ConfigOperation& op);
+  ::util::Status RunWriteOperation(
+      const ::google::stratum::testing::ControlPlaneOperation::WriteOperation&
+          op);
+  ::util::Status RunPipelineConfigOperation(
+      const ::google::stratum::testing::ControlPlaneOperation::
+          PipelineConfigOperation& op);
+  ::util::Status RunPacketOutOperation(
+      const ::google::stratum::testing::ControlPlaneOperation::
+          PacketOutOperation& op);
+
+  // Checks one expectation and fills the result, error and diff of the
+  // report.  The schedule key is the one of the nested action group, if any.
+  void CheckExpectation(const ::google::stratum::testing::Expectation& exp,
+                        const std::string& schedule_key,
+                        ExpectationReport* report);
+
+  // The handlers for each supported expectation.  They return an error if
+  // the RPC failed, and they set diff if the response did not match.
+  ::util::Status CheckConfigExpectation(
+      const ::google::stratum::testing::ConfigExpectation& exp,
+      std::string* diff);
+  ::util::Status CheckReadExpectation(
+      const ::google::stratum::testing::ControlPlaneExpectation::
+          ReadExpectation& exp,
+      std::string* diff);
+  ::util::Status CheckPipelineConfigExpectation(
+      const ::google::stratum::testing::ControlPlaneExpectation::
+          PipelineConfigExpectation& exp,
+      std::string* diff);
+  ::util::Status CheckPacketInExpectation(
+      const ::google::stratum::testing::ControlPlaneExpectation::
+          PacketInExpectation& exp,
+      std::string* diff);
+  ::util::Status CheckTelemetryExpectation(
+      const std::string& schedule_key,
+      const ::google::stratum::testing::TelemetryExpectation& exp,
+      ExpectationReport* report, std::string* diff);
+
+  // Returns the StreamChannel of the device.  The first call for a device
+  // opens the stream and waits for the arbitration response for the given
+  // election ID, without holding streams_lock_.  Concurrent and later calls
+  // for the device wait for that arbitration and return its error, if any.
+  ::util::StatusOr<DeviceStream*> GetOrOpenStream(uint64 device_id,
+                                                  absl::uint128 election_id)
+      LOCKS_EXCLUDED(streams_lock_);
+
+  // Sends the arbitration request on the new stream of the device and waits
+  // for the response.
+  ::util::Status Arbitrate(DeviceStream* s, uint64 device_id,
+                           absl::uint128 election_id);
+
+  // Returns the StreamChannel of the device if it is open, or nullptr.
+  DeviceStream* FindStream(uint64 device_id) LOCKS_EXCLUDED(streams_lock_);
+
+  // Closes all StreamChannels and joins their reader threads.
+  void CloseStreams() LOCKS_EXCLUDED(streams_lock_);
+
+  // Returns the shuffled start order and the start delays of the n actions
+  // of the randomized group with the given schedule key.
+  void MakeSchedule(const std::string& schedule_key, int n,
+                    std::vector<int>* order,
+                    std::vector<absl::Duration>* delays) const;
+
+  // The stubs of the services of the switch.  Stubs are thread-safe.
+  std::unique_ptr<::p4::v1::P4Runtime::Stub> p4_stub_;
+  std::unique_ptr<::gnmi::gNMI::Stub> gnmi_stub_;
+
+  // The seed of the schedules of the randomized groups.
+  const uint64 random_seed_;
+
+  // Maps device ID to its open StreamChannel.
+  absl::Mutex streams_lock_;
+  std::map<uint64, std::unique_ptr<DeviceStream>> streams_
+      GUARDED_BY(streams_lock_);
+};
+
+}  // namespace tv_runner
+}  // namespace tools
+}  // namespace stratum
+
+#endif  // STRATUM_TOOLS_TV_RUNNER_TV_RUNNER_H_
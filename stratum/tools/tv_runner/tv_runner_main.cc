@@ -0,0 +1,83 @@
+// Copyright 2021-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+#include <memory>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "grpcpp/grpcpp.h"
+#include "stratum/glue/init_google.h"
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/lib/constants.h"
+#include "stratum/lib/macros.h"
+#include "stratum/lib/security/credentials_manager.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/proto/tv.pb.h"
+#include "stratum/tools/tv_runner/tv_runner.h"
+
+DEFINE_string(grpc_addr, stratum::kLocalStratumUrl,
+              "P4Runtime and gNMI server address.");
+DEFINE_string(tv_report_file, "",
+              "If set, the file to which the report is written as a text "
+              "proto.");
+
+namespace stratum {
+namespace tools {
+namespace tv_runner {
+
+const char kUsage[] = R"USAGE(
+Usage: stratum_tv_runner [options] [test vector file]
+  This tool runs the test cases of a TestVector text proto file against the
+  P4Runtime and gNMI services of a Stratum switch, and reports the result and
+  latency of each action and the mismatches of each expectation.
+)USAGE";
+
+::util::Status Main(int argc, char** argv) {
+  if (argc < 2) {
+    LOG(INFO) << kUsage;
+    return MAKE_ERROR(ERR_INVALID_PARAM).without_logging() << "";
+  }
+
+  ::google::stratum::testing::TestVector vector;
+  RETURN_IF_ERROR(ReadProtoFromTextFile(argv[1], &vector));
+
+  ASSIGN_OR_RETURN(auto credentials_manager,
+                   CredentialsManager::CreateInstance());
+  auto channel = ::grpc::CreateChannel(
+      FLAGS_grpc_addr,
+      credentials_manager->GenerateExternalFacingClientCredentials());
+  auto runner = TestVectorRunner::CreateInstance(channel);
+  TestVectorReport report = runner->Run(vector);
+
+  for (const auto& latency : report.latencies()) {
+    LOG(INFO) << latency.action_type() << ": count " << latency.count()
+              << ", min " << latency.min_us() << "us, mean "
+              << latency.mean_us() << "us, p50 " << latency.p50_us()
+              << "us, p99 " << latency.p99_us() << "us, max "
+              << latency.max_us() << "us.";
+  }
+  if (!FLAGS_tv_report_file.empty()) {
+    RETURN_IF_ERROR(WriteProtoToTextFile(report, FLAGS_tv_report_file));
+  }
+  if (report.result() != PASSED) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Test vector " << argv[1] << " failed with random seed "
+           << report.random_seed() << ".";
+  }
+
+  LOG(INFO) << "Done";
+  return ::util::OkStatus();
+}
+
+}  // namespace tv_runner
+}  // namespace tools
+}  // namespace stratum
+
+int main(int argc, char** argv) {
+  ::gflags::SetUsageMessage(stratum::tools::tv_runner::kUsage);
+  InitGoogle(argv[0], &argc, &argv, true);
+  stratum::InitStratumLogging();
+  return stratum::tools::tv_runner::Main(argc, argv).error_code();
+}
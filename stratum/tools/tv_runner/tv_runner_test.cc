@@ -0,0 +1,486 @@
+// Copyright 2021-present Open Networking Foundation
+// SPDX-License-Identifier: Apache-2.0
+
+// Runs test vectors against an in-process Stratum, built from the P4Runtime
+// and gNMI services on top of a switch mock.
+
+#include "stratum/tools/tv_runner/tv_runner.h"
+
+#include <memory>
+#include <string>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "gflags/gflags.h"
+#include "gmock/gmock.h"
+#include "grpcpp/grpcpp.h"
+#include "gtest/gtest.h"
+#include "stratum/glue/net_util/ports.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/hal/lib/common/config_monitoring_service.h"
+#include "stratum/hal/lib/common/error_buffer.h"
+#include "stratum/hal/lib/common/p4_service.h"
+#include "stratum/hal/lib/common/switch_mock.h"
+#include "stratum/lib/security/auth_policy_checker_mock.h"
+#include "stratum/lib/utils.h"
+#include "stratum/public/lib/error.h"
+
+DECLARE_string(chassis_config_file);
+DECLARE_string(forwarding_pipeline_configs_file);
+DECLARE_string(write_req_log_file);
+DECLARE_string(read_req_log_file);
+DECLARE_string(test_tmpdir);
+DECLARE_int32(tv_timeout_ms);
+DECLARE_uint64(tv_random_seed);
+DECLARE_int32(tv_random_max_delay_ms);
+DECLARE_string(tv_election_id);
+
+namespace stratum {
+namespace tools {
+namespace tv_runner {
+
+using ::google::stratum::testing::TestVector;
+using ::stratum::hal::AuthPolicyCheckerMock;
+using ::stratum::hal::ConfigMonitoringService;
+using ::stratum::hal::ErrorBuffer;
+using ::stratum::hal::P4Service;
+using ::stratum::hal::SwitchMock;
+using ::stratum::hal::WriterInterface;
+using ::testing::_;
+using ::testing::HasSubstr;
+using ::testing::Invoke;
+using ::testing::NiceMock;
+using ::testing::Return;
+
+// Pushes a pipeline to node 1 and becomes master with election ID 1.
+constexpr char kPipelinePushGroup[] = R"pb(
+  action_group_id: "push"
+  sequential_action_group {
+    actions {
+      control_plane_operation {
+        pipeline_config_operation {
+          p4_set_pipeline_config_request {
+            device_id: 1
+            election_id { low: 1 }
+            action: VERIFY_AND_COMMIT
+            config { p4_device_config: "\x01" }
+          }
+        }
+      }
+    }
+  }
+)pb";
+
+// A write action of one table entry to node 1.
+constexpr char kWriteAction[] = R"pb(
+  control_plane_operation {
+    write_operation {
+      p4_write_request {
+        device_id: 1
+        election_id { low: 1 }
+        updates {
+          type: INSERT
+          entity {
+            table_entry {
+              table_id: 1
+              match { field_id: 1 exact { value: "\x01" } }
+              action { action { action_id: 1 } }
+            }
+          }
+        }
+      }
+    }
+  }
+)pb";
+
+// Reads back the table entry of kWriteAction.
+constexpr char kReadExpectation[] = R"pb(
+  expectation_id: "read"
+  control_plane_expectation {
+    read_expectation {
+      p4_read_request {
+        device_id: 1
+        entities { table_entry {} }
+      }
+      p4_read_responses {
+        entities {
+          table_entry {
+            table_id: 1
+            match { field_id: 1 exact { value: "\x01" } }
+            action { action { action_id: 1 } }
+          }
+        }
+      }
+    }
+  }
+)pb";
+
+class TestVectorRunnerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    FLAGS_chassis_config_file = FLAGS_test_tmpdir + "/chassis_config.pb.txt";
+    FLAGS_forwarding_pipeline_configs_file =
+        FLAGS_test_tmpdir + "/forwarding_pipeline_configs_file.pb.txt";
+    FLAGS_write_req_log_file = FLAGS_test_tmpdir + "/write_req_log_file.csv";
+    FLAGS_read_req_log_file = FLAGS_test_tmpdir + "/read_req_log_file.csv";
+    FLAGS_tv_timeout_ms = 2000;
+    FLAGS_tv_random_seed = 0;
+    FLAGS_tv_election_id = "0,1";
+    switch_mock_ = absl::make_unique<NiceMock<SwitchMock>>();
+    auth_policy_checker_mock_ =
+        absl::make_unique<NiceMock<AuthPolicyCheckerMock>>();
+    error_buffer_ = absl::make_unique<ErrorBuffer>();
+    p4_service_ = absl::make_unique<P4Service>(
+        hal::OPERATION_MODE_STANDALONE, switch_mock_.get(),
+        auth_policy_checker_mock_.get(), error_buffer_.get());
+    config_monitoring_service_ = absl::make_unique<ConfigMonitoringService>(
+        hal::OPERATION_MODE_STANDALONE, switch_mock_.get(),
+        auth_policy_checker_mock_.get(), error_buffer_.get());
+    std::string url =
+        "localhost:" + std::to_string(stratum::PickUnusedPortOrDie());
+    ::grpc::ServerBuilder builder;
+    builder.AddListeningPort(url, ::grpc::InsecureServerCredentials());
+    builder.RegisterService(p4_service_.get());
+    builder.RegisterService(config_monitoring_service_.get());
+    server_ = builder.BuildAndStart();
+    ASSERT_NE(server_, nullptr);
+    channel_ = ::grpc::CreateChannel(url, ::grpc::InsecureChannelCredentials());
+  }
+
+  void TearDown() override { server_->Shutdown(); }
+
+  // Parses the test vector and runs it with a new runner.
+  TestVectorReport RunVector(const std::string& vector_text) {
+    TestVector vector;
+    EXPECT_OK(ParseProtoFromString(vector_text, &vector));
+    return TestVectorRunner::CreateInstance(channel_)->Run(vector);
+  }
+
+  // Makes the switch mock return one table entry for every read.
+  void ExpectReadReturns(const std::string& entity_text) {
+    ::p4::v1::ReadResponse resp;
+    ASSERT_OK(ParseProtoFromString(entity_text, resp.add_entities()));
+    EXPECT_CALL(*switch_mock_, ReadForwardingEntries(_, _, _))
+        .WillRepeatedly(
+            Invoke([resp](const ::p4::v1::ReadRequest& req,
+                          WriterInterface<::p4::v1::ReadResponse>* writer,
+                          std::vector<::util::Status>* details) {
+              writer->Write(resp);
+              return ::util::OkStatus();
+            }));
+  }
+
+  std::unique_ptr<NiceMock<SwitchMock>> switch_mock_;
+  std::unique_ptr<NiceMock<AuthPolicyCheckerMock>> auth_policy_checker_mock_;
+  std::unique_ptr<ErrorBuffer> error_buffer_;
+  std::unique_ptr<P4Service> p4_service_;
+  std::unique_ptr<ConfigMonitoringService> config_monitoring_service_;
+  std::unique_ptr<::grpc::Server> server_;
+  std::shared_ptr<::grpc::Channel> channel_;
+};
+
+TEST_F(TestVectorRunnerTest, RunPipelinePushWritesAndReadSuccess) {
+  EXPECT_CALL(*switch_mock_, PushForwardingPipelineConfig(1, _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, WriteForwardingEntries(_, _))
+      .Times(2)
+      .WillRepeatedly(Return(::util::OkStatus()));
+  ExpectReadReturns(R"pb(
+    table_entry {
+      table_id: 1
+      match { field_id: 1 exact { value: "\x01" } }
+      action { action { action_id: 1 } }
+    }
+  )pb");
+
+  TestVectorReport report = RunVector(absl::StrCat(
+      "test_cases { test_case_id: \"tc\" action_groups {", kPipelinePushGroup,
+      "} action_groups { action_group_id: \"writes\" parallel_action_group {",
+      " actions {", kWriteAction, "} actions {", kWriteAction, "} } }",
+      " expectations {", kReadExpectation, "} }"));
+
+  EXPECT_EQ(PASSED, report.result());
+  ASSERT_EQ(1, report.test_cases_size());
+  const TestCaseReport& test_case = report.test_cases(0);
+  EXPECT_EQ("tc", test_case.test_case_id());
+  ASSERT_EQ(3, test_case.actions_size());
+  EXPECT_EQ("pipeline_config_operation", test_case.actions(0).action_type());
+  for (const auto& action : test_case.actions()) {
+    EXPECT_EQ(PASSED, action.result()) << action.error();
+  }
+  EXPECT_EQ("writes", test_case.actions(2).action_group_id());
+  EXPECT_EQ(1, test_case.actions(2).action_index());
+  ASSERT_EQ(1, test_case.expectations_size());
+  EXPECT_EQ("read_expectation", test_case.expectations(0).expectation_type());
+  EXPECT_EQ(PASSED, test_case.expectations(0).result());
+  ASSERT_EQ(2, report.latencies_size());
+  EXPECT_EQ("pipeline_config_operation", report.latencies(0).action_type());
+  EXPECT_EQ(1, report.latencies(0).count());
+  EXPECT_EQ("write_operation", report.latencies(1).action_type());
+  EXPECT_EQ(2, report.latencies(1).count());
+  EXPECT_LE(report.latencies(1).min_us(), report.latencies(1).p50_us());
+  EXPECT_LE(report.latencies(1).p99_us(), report.latencies(1).max_us());
+}
+
+TEST_F(TestVectorRunnerTest, ReadMismatchReportsDiff) {
+  ExpectReadReturns(R"pb(
+    table_entry {
+      table_id: 1
+      match { field_id: 1 exact { value: "\x02" } }
+      action { action { action_id: 1 } }
+    }
+  )pb");
+
+  TestVectorReport report = RunVector(absl::StrCat(
+      "test_cases { test_case_id: \"tc\" action_groups {", kPipelinePushGroup,
+      "} expectations {", kReadExpectation, "} }"));
+
+  EXPECT_EQ(FAILED, report.result());
+  ASSERT_EQ(1, report.test_cases(0).expectations_size());
+  const ExpectationReport& expectation = report.test_cases(0).expectations(0);
+  EXPECT_EQ("read", expectation.expectation_id());
+  EXPECT_EQ(FAILED, expectation.result());
+  EXPECT_THAT(expectation.diff(), HasSubstr("missing: "));
+  EXPECT_THAT(expectation.diff(), HasSubstr("unexpected: "));
+}
+
+// The mock only lets the writes complete once all of them are in the switch
+// at the same time.
+TEST_F(TestVectorRunnerTest, ParallelActionsRunConcurrently) {
+  absl::Mutex lock;
+  int num_writes = 0;
+  EXPECT_CALL(*switch_mock_, WriteForwardingEntries(_, _))
+      .Times(4)
+      .WillRepeatedly(Invoke([&lock, &num_writes](
+                                 const ::p4::v1::WriteRequest& req,
+                                 std::vector<::util::Status>* results)
+                                 -> ::util::Status {
+        absl::MutexLock l(&lock);
+        ++num_writes;
+        if (!lock.AwaitWithTimeout(
+                absl::Condition(+[](int* n) { return *n == 4; }, &num_writes),
+                absl::Seconds(1))) {
+          return MAKE_ERROR(ERR_INTERNAL) << "The writes did not overlap.";
+        }
+        return ::util::OkStatus();
+      }));
+
+  TestVectorReport report = RunVector(absl::StrCat(
+      "test_cases { action_groups {", kPipelinePushGroup,
+      "} action_groups { parallel_action_group {", " actions {", kWriteAction,
+      "} actions {", kWriteAction, "} actions {", kWriteAction, "} actions {",
+      kWriteAction, "} } } }"));
+
+  EXPECT_EQ(PASSED, report.result());
+  for (const auto& action : report.test_cases(0).actions()) {
+    EXPECT_EQ(PASSED, action.result()) << action.error();
+  }
+}
+
+TEST_F(TestVectorRunnerTest, RandomizedScheduleIsReproducible) {
+  FLAGS_tv_random_seed = 42;
+  FLAGS_tv_random_max_delay_ms = 5;
+  const std::string vector_text = absl::StrCat(
+      "test_cases { action_groups {", kPipelinePushGroup,
+      "} action_groups { randomized_action_group {", " actions {",
+      kWriteAction, "} actions {", kWriteAction, "} actions {", kWriteAction,
+      "} } } }");
+
+  TestVectorReport report1 = RunVector(vector_text);
+  TestVectorReport report2 = RunVector(vector_text);
+
+  EXPECT_EQ(PASSED, report1.result());
+  EXPECT_EQ(42U, report1.random_seed());
+  ASSERT_EQ(4, report1.test_cases(0).actions_size());
+  ASSERT_EQ(4, report2.test_cases(0).actions_size());
+  for (int i = 1; i < 4; ++i) {
+    EXPECT_EQ(PASSED, report1.test_cases(0).actions(i).result());
+    EXPECT_EQ(report1.test_cases(0).actions(i).start_delay_us(),
+              report2.test_cases(0).actions(i).start_delay_us());
+  }
+  FLAGS_tv_random_max_delay_ms = 10;
+}
+
+// The schedule of a group does not depend on the groups that ran before.
+TEST_F(TestVectorRunnerTest, RandomizedScheduleIsIndependentOfOtherGroups) {
+  FLAGS_tv_random_seed = 42;
+  const std::string test_case_text = absl::StrCat(
+      " action_groups {", kPipelinePushGroup,
+      "} action_groups { randomized_action_group {", " actions {",
+      kWriteAction, "} actions {", kWriteAction, "} actions {", kWriteAction,
+      "} } } }");
+
+  TestVectorReport report1 = RunVector(
+      absl::StrCat("test_cases { test_case_id: \"a\"", test_case_text,
+                   "test_cases { test_case_id: \"b\"", test_case_text));
+  TestVectorReport report2 = RunVector(
+      absl::StrCat("test_cases { test_case_id: \"b\"", test_case_text));
+
+  ASSERT_EQ(2, report1.test_cases_size());
+  ASSERT_EQ(1, report2.test_cases_size());
+  const TestCaseReport& test_case1 = report1.test_cases(1);
+  const TestCaseReport& test_case2 = report2.test_cases(0);
+  ASSERT_EQ(4, test_case1.actions_size());
+  ASSERT_EQ(4, test_case2.actions_size());
+  for (int i = 1; i < 4; ++i) {
+    EXPECT_EQ(test_case1.actions(i).start_delay_us(),
+              test_case2.actions(i).start_delay_us());
+  }
+}
+
+// The switch rejects the election ID 0, so the arbitration fails, and the
+// later actions on the same device get the same error.
+TEST_F(TestVectorRunnerTest, FailedArbitrationFailsLaterActions) {
+  FLAGS_tv_election_id = "0,0";
+
+  TestVectorReport report = RunVector(R"pb(
+    test_cases {
+      action_groups {
+        sequential_action_group {
+          actions {
+            control_plane_operation {
+              packet_out_operation { p4_packet_out { payload: "abc" } }
+            }
+          }
+          actions {
+            control_plane_operation {
+              packet_out_operation { p4_packet_out { payload: "abc" } }
+            }
+          }
+        }
+      }
+    })pb");
+
+  EXPECT_EQ(FAILED, report.result());
+  ASSERT_EQ(2, report.test_cases(0).actions_size());
+  for (const auto& action : report.test_cases(0).actions()) {
+    EXPECT_EQ(FAILED, action.result());
+    EXPECT_THAT(action.error(), HasSubstr("No arbitration response"));
+  }
+}
+
+TEST_F(TestVectorRunnerTest, FailedActionSkipsExpectations) {
+  EXPECT_CALL(*switch_mock_, WriteForwardingEntries(_, _))
+      .WillOnce(Return(::util::Status(StratumErrorSpace(), ERR_INVALID_PARAM,
+                                      "Bad entry.")));
+  EXPECT_CALL(*switch_mock_, ReadForwardingEntries(_, _, _)).Times(0);
+
+  TestVectorReport report = RunVector(absl::StrCat(
+      "test_cases { action_groups {", kPipelinePushGroup,
+      "} action_groups { sequential_action_group { actions {", kWriteAction,
+      "} } } expectations {", kReadExpectation, "} }"));
+
+  EXPECT_EQ(FAILED, report.result());
+  const TestCaseReport& test_case = report.test_cases(0);
+  ASSERT_EQ(2, test_case.actions_size());
+  EXPECT_EQ(FAILED, test_case.actions(1).result());
+  EXPECT_THAT(test_case.actions(1).error(), HasSubstr("Write failed"));
+  ASSERT_EQ(1, test_case.expectations_size());
+  EXPECT_EQ(SKIPPED, test_case.expectations(0).result());
+}
+
+// Without a pushed chassis config, the gNMI Get fails.
+TEST_F(TestVectorRunnerTest, ConfigExpectationFailsOnGetError) {
+  TestVectorReport report = RunVector(R"pb(
+    test_cases {
+      expectations {
+        expectation_id: "get"
+        config_expectation {
+          gnmi_get_request { path { elem { name: "interfaces" } } }
+        }
+      }
+    }
+  )pb");
+
+  EXPECT_EQ(FAILED, report.result());
+  const ExpectationReport& expectation = report.test_cases(0).expectations(0);
+  EXPECT_EQ("config_expectation", expectation.expectation_type());
+  EXPECT_EQ(FAILED, expectation.result());
+  EXPECT_THAT(expectation.error(), HasSubstr("Get failed"));
+}
+
+TEST_F(TestVectorRunnerTest, UnsupportedActionIsSkipped) {
+  TestVectorReport report = RunVector(R"pb(
+    test_cases {
+      action_groups {
+        sequential_action_group {
+          actions { port_stimulus { state: STATE_DOWN } }
+        }
+      }
+    }
+  )pb");
+
+  EXPECT_EQ(PASSED, report.result());
+  ASSERT_EQ(1, report.test_cases(0).actions_size());
+  EXPECT_EQ("port_stimulus", report.test_cases(0).actions(0).action_type());
+  EXPECT_EQ(SKIPPED, report.test_cases(0).actions(0).result());
+  EXPECT_EQ(0, report.latencies_size());
+}
+
+// The switch mock loops every packet-out back as a packet-in.
+TEST_F(TestVectorRunnerTest, PacketOutLoopbackMatchesPacketIn) {
+  std::shared_ptr<WriterInterface<::p4::v1::StreamMessageResponse>> writer;
+  EXPECT_CALL(*switch_mock_, RegisterStreamMessageResponseWriter(1, _))
+      .WillOnce(Invoke(
+          [&writer](uint64 node_id,
+                    std::shared_ptr<WriterInterface<
+                        ::p4::v1::StreamMessageResponse>> w) {
+            writer = w;
+            return ::util::OkStatus();
+          }));
+  EXPECT_CALL(*switch_mock_, HandleStreamMessageRequest(1, _))
+      .Times(2)
+      .WillRepeatedly(Invoke([&writer](
+                                 uint64 node_id,
+                                 const ::p4::v1::StreamMessageRequest& req) {
+        ::p4::v1::StreamMessageResponse resp;
+        resp.mutable_packet()->set_payload(req.packet().payload());
+        writer->Write(resp);
+        return ::util::OkStatus();
+      }));
+
+  TestVectorReport report = RunVector(absl::StrCat(
+      "test_cases { action_groups {", kPipelinePushGroup, R"pb(
+        }
+        action_groups {
+          sequential_action_group {
+            actions {
+              control_plane_operation {
+                packet_out_operation {
+                  p4_packet_out { payload: "abc" }
+                  num_of_packets: 2
+                }
+              }
+            }
+          }
+        }
+        expectations {
+          control_plane_expectation {
+            packet_in_expectation {
+              p4_packet_in { payload: "abc" }
+              num_of_packets: 2
+            }
+          }
+        }
+      })pb"));
+
+  EXPECT_EQ(PASSED, report.result());
+  EXPECT_EQ(PASSED, report.test_cases(0).expectations(0).result())
+      << report.test_cases(0).expectations(0).diff();
+}
+
+TEST(TestVectorSamplesTest, SamplesParse) {
+  for (const std::string& filename :
+       {"stratum/tools/tv_runner/testdata/pipeline_and_parallel_writes.pb.txt",
+        "stratum/tools/tv_runner/testdata/randomized_writes.pb.txt"}) {
+    TestVector vector;
+    EXPECT_OK(ReadProtoFromTextFile(filename, &vector)) << filename;
+    EXPECT_EQ(1, vector.test_cases_size()) << filename;
+  }
+}
+
+}  // namespace tv_runner
+}  // namespace tools
+}  // namespace stratum